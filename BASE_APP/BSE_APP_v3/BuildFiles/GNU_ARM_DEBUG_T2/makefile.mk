@@ -389,6 +389,17 @@ $(OBJ_PATH)/Cless_TransactionFile.o \
 $(OBJ_PATH)/Cless_VisaWave.o \
 $(OBJ_PATH)/Cless_XML.o \
 $(OBJ_PATH)/perf_log.o \
+$(OBJ_PATH)/Ecr.o \
+$(OBJ_PATH)/ComStatus.o \
+$(OBJ_PATH)/BatchUp.o \
+$(OBJ_PATH)/RecvTmo.o \
+$(OBJ_PATH)/DnsCache.o \
+$(OBJ_PATH)/SimPred.o \
+$(OBJ_PATH)/EchoSched.o \
+$(OBJ_PATH)/NetTiming.o \
+$(OBJ_PATH)/ComFrame.o \
+$(OBJ_PATH)/HostSel.o \
+$(OBJ_PATH)/BgLink.o \
 $(OBJ_PATH)/UserInterfaceHelpers.o \
 $(OBJ_PATH)/CLESS_lang.o \
 $(OBJ_PATH)/fnc.o \
@@ -1537,6 +1548,116 @@ ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/perf_log.o)
 	@echo "done!"
 endif
 
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/Ecr.d
+endif
+$(OBJ_PATH)/Ecr.o: Src/Ecr.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/Ecr.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/Ecr.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/ComStatus.d
+endif
+$(OBJ_PATH)/ComStatus.o: Src/ComStatus.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/ComStatus.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/ComStatus.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/BatchUp.d
+endif
+$(OBJ_PATH)/BatchUp.o: Src/BatchUp.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/BatchUp.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/BatchUp.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/RecvTmo.d
+endif
+$(OBJ_PATH)/RecvTmo.o: Src/RecvTmo.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/RecvTmo.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/RecvTmo.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/DnsCache.d
+endif
+$(OBJ_PATH)/DnsCache.o: Src/DnsCache.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/DnsCache.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/DnsCache.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/SimPred.d
+endif
+$(OBJ_PATH)/SimPred.o: Src/SimPred.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/SimPred.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/SimPred.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/EchoSched.d
+endif
+$(OBJ_PATH)/EchoSched.o: Src/EchoSched.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/EchoSched.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/EchoSched.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/NetTiming.d
+endif
+$(OBJ_PATH)/NetTiming.o: Src/NetTiming.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/NetTiming.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/NetTiming.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/ComFrame.d
+endif
+$(OBJ_PATH)/ComFrame.o: Src/ComFrame.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/ComFrame.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/ComFrame.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/HostSel.d
+endif
+$(OBJ_PATH)/HostSel.o: Src/HostSel.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/HostSel.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/HostSel.o)
+	@echo "done!"
+endif
+
+ifneq ($(MAKECMDGOALS), clean)
+-include $(OBJ_PATH)/BgLink.d
+endif
+$(OBJ_PATH)/BgLink.o: Src/BgLink.c $(DEPENDENCIES) $(EXTRA_DEPENDENCIES)
+	@echo "'Src/BgLink.c' compilation in progress..."
+	$(CC) $(CC_OPTS) -MMD -MP -o "$@" "$<"
+ifeq ($(MAKECMDGOALS), $(OBJ_PATH)/BgLink.o)
+	@echo "done!"
+endif
+
 ifneq ($(MAKECMDGOALS), clean)
 -include $(OBJ_PATH)/UserInterfaceHelpers.d
 endif
@@ -1,12 +1,156 @@
 #ifndef __SQLITE_H_
 #define __SQLITE_H_
 
+// Totals of the transaction log, see sqlite_Log_Totals
+enum {
+	logTotDebit,
+	logTotDebitReversal,
+	logTotCredit,
+	logTotCreditReversal,
+	logTotEnd
+};
+
+typedef struct {
+	char Count[10 + 1];
+	char Sum[20 + 1];
+} tLogTot;
+
+// Retention of the closed batches, see sqlite_Log_Prune
+#define LOG_KEEP_BATCHES    3          // Closed batches kept after their settlement
+#define LOG_PRUNE_ROWS      200        // Records removed per call, the handle held a few ms
+#define LOG_PRUNE_CALLS     50         // Calls per pass of the store and forward task
+#define LOG_PRUNE_SHORT     20         // Records removed per call when the disk is short, the WAL checkpointed after each
+
+// Room of the database disk, see sqlite_Vacuum_Step and sqlite_Capacity
+#define LOG_VACUUM_PAGES    16         // Free pages given back to the disk per call
+#define LOG_VACUUM_CALLS    64         // Calls per pass of the store and forward task
+#define CAP_RATE_DAYS       7          // Days the rate of the records is taken over
+#define CAP_WARN_DAYS       3          // Days left before the sales are held when the merchant is asked to settle
+#define CAP_WARN_RECORDS    100        // Records left when the merchant is asked to settle
+#define CAP_FULL_RECORDS    20         // Records left when the sales wait for a settlement
+
+enum {
+	capOk,
+	capWarn,
+	capFull
+};
+
+typedef struct {
+	long DiskFree;                     // Bytes free on the disk
+	long DbFree;                       // Bytes of the free pages of the database
+	long Room;                         // Bytes left to the log: both, less the reserve of a sale and of the settlement
+	long RecordBytes;                  // Bytes a record takes
+	long Records;                      // Records in the log
+	long RecordsLeft;                  // Records the room left holds
+	int PerDay;                        // Records a day of late
+	int DaysLeft;                      // Days before the sales are held, at that rate
+	int Level;                         // capOk, capWarn, capFull
+} tSqlCap;
+
+// Export of the log to the host disk, see sqlite_Export
+typedef struct {
+	long From;                         // Last change acknowledged by the host, 0 for a full export
+	long To;                           // Last change exported
+	long Rows;                         // Rows written
+	long Deletes;                      // Rows deleted since From
+	long Bytes;                        // Bytes of the export
+	card Crc;                          // CRC-32 of the export, given back by the host
+	byte Full;                         // Every row exported, the host makes the tables again
+	byte Acked;                        // The previous export was acknowledged
+} tSqlExp;
+
+// Row given to the callback of a cursor, see sqlite_Log_Each
+#define SQL_ROW_COLS    8
+typedef struct {
+	int Cols;
+	long long Int[SQL_ROW_COLS];       // Column as an integer, 0 when NULL
+	const char *Text[SQL_ROW_COLS];    // Column as text, "" when NULL
+	char Data[256];                    // Texts of the row, each cut to the space left
+} tSqlRow;
+
+// Called for each row: >0 for the next one, 0 to stop, <0 to stop on error
+typedef int (*tSqlRowFn)(const tSqlRow *Row, void *Ctx);
+
+// Columns of sqlite_Log_Each
+enum {
+	logRowMenuItem,
+	logRowAmount,
+	logRowDatTim,
+	logRowAutCod,
+	logRowEnd
+};
+
+// Columns of sqlite_Log_Groups
+enum {
+	logGrpMenuItem,
+	logGrpName,
+	logGrpCount,
+	logGrpAmount,
+	logGrpEnd
+};
+
+// Columns of sqlite_Menu_Each
+enum {
+	mnuRowId,
+	mnuRowParent,
+	mnuRowHidden,
+	mnuRowSecure,
+	mnuRowLevel,
+	mnuRowDrCr,
+	mnuRowName,
+	mnuRowIcon,
+	mnuRowEnd
+};
+
+// Reads of the parameters kept in RAM, see sqlite_Param_Stats
+typedef struct {
+	card Hits;                         // Reads served from RAM
+	card Avoided;                      // Queries those reads would have made
+	card Queries;                      // Queries made: tables read, reads left to SQLite
+} tSqlParamStat;
+
+// Told of a parameter changed, Name NULL when all of them may have changed
+typedef void (*tSqlParamFn)(const char *Name, const char *Value);
+
 int SqliteDB_Init(void);
-int Sqlite_Get_Menu(const char * parentID,char * data);
+int SqliteApp_CopyFileToHost(void);
+int Sqlite_Put_Menu(word Id, const char *Name, word Parent, byte Hidden, byte Secure, byte Level, const char *DrCr, const char *Icon);
+int sqlite_Menu_Each(tSqlRowFn Row, void *Ctx);
 int Sqlite_Run_Statement_MultiRecord(const char * SqlStatement,char * data);
 int Sqlite_Run_Statement_MultiRecord_NoColumnName(const char * SqlStatement,char * data);
 int Sqlite_Run_Statement(const char * statement,char * data);
+int Sqlite_Get_Parameter(const char * parameter,char * data);
+int Sqlite_Update_Parameter(const char * parameter,char * data);
+int sqlite_Param_Watch(tSqlParamFn Fn);
+void sqlite_Param_Stats(tSqlParamStat *Stat);
+int sqlite_Aid_Get(const char *Col, const char *Aid, char *Data, int iDim);
+int sqlite_Txn_Begin(void);
+int sqlite_Txn_End(int Ok);
+int sqlite_Checkpoint(void);
 int sqlite_Get_LOG_Record(word RRN,word APPRVCODE,word STAN);
 int sqlite_CloseVoid(char * STAN);
+int sqlite_Log_Save(void);
+int sqlite_Log_Close(void);
+int sqlite_Log_Prune(int Keep, int Rows);
+int sqlite_Vacuum_Step(int Pages);
+int sqlite_Capacity(tSqlCap *Cap);
+int sqlite_Log_Totals(const char *Curr, tLogTot *Tot);
+int sqlite_Log_Check(void);
+int sqlite_Export(int Full, tSqlExp *Exp);
+void sqlite_Export_Stop(void);
+int sqlite_Log_Each(const char *Curr, tSqlRowFn Row, void *Ctx);
+int sqlite_Log_Groups(const char *Curr, tSqlRowFn Row, void *Ctx);
+int sqlite_Advice_Put(const char *STAN, const char *MenuItem, const char *Request, int MaxEntries);
+int sqlite_Advice_Peek(char *STAN, char *Request, int iDim);
+int sqlite_Advice_Update(const char *STAN, int Delivered, int MaxRetries);
+int sqlite_Advice_Parked(void);
+int sqlite_Reversal_Put(const char *STAN, const char *CardKey, const char *Request, int Status);
+int sqlite_Reversal_Release(const char *STAN);
+int sqlite_Reversal_Peek(char *STAN, char *Request, int iDim, int *Retries);
+int sqlite_Reversal_Update(const char *STAN, int Delivered);
+int sqlite_Reversal_Pending(const char *STAN, const char *CardKey);
+int sqlite_Batch_Open(const char *TID, long AfterId);
+int sqlite_Batch_Next(long *Id);
+void sqlite_Batch_Close(void);
 
 #endif
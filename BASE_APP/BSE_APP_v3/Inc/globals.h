@@ -119,6 +119,7 @@ void fncProcessTemrinalModes(void);
 int FUN_EncryptPin(void) ;
 int GenerateKeyAndCSR( void );
 void TaskSimSlot(void);
+void TaskStoreForward(void);
 void RefreshDB(void);
 void confirmGraphicLibHandle(void);
 int fncWriteStatusOfConnection(char Status_1_or_0);
@@ -139,6 +140,13 @@ void ShortCutEnhanced(void);
 void ShortCutAdminEnhanced(void);
 char kbdKey(void);
 int AutoSwitchSimSlots(void);
+void DualSimNote(card ulAttach, card ulConnect, int iOk);
+void simPredInit(void);
+void simPredRadio(int iSim, int iRadio, card ulNow);
+void simPredSample(int iSim, card ulAttach, card ulConnect, int iOk, card ulNow);
+card simPredScore(int iSim, card ulNow);
+int simPredChoose(int iCur, card ulNow);
+void simPredSwitched(card ulNow);
 void ManualSwitchSimSlots(int SelectedSlot);
 void IdleImageDisplay(void);
 void ShortCutMenu_Management_Reports(void);
@@ -302,6 +310,20 @@ enum
 	appBillerSurcharge,
 	appTerminalMode,
 
+	///HOST SELECTION
+	appHostIpSecondary,  // Secondary host IP address
+	appHostPortSecondary,// Secondary host port number
+
+	///ECHO SCHEDULER
+	appEchoPeriod,       // Idle minutes between two echo tests (0: off)
+	appDnsTtl,           // Seconds a resolved host address is kept
+	appRcvTmoMin,        // Floor of the adaptive receive timeout (s)
+	appRcvTmoMax,        // Ceiling of the adaptive receive timeout (s)
+	appBatchWindow,      // Batch upload requests in flight
+	appBatchUpAck,       // Batch upload resume point "TID|id"
+	appEcrPort,          // Cash register link: "" off, "0".."3" serial channel, "U" USB
+	appEcrInit,          // Cash register serial settings (appSerialInit format)
+
 	appEnd
 };
 
@@ -361,6 +383,7 @@ enum {
 	mnuSwapSimSlot,          // Manual SIM Slot swapping
 	mnuCvmMode,              // Terminal CVM mode Force PIN or card CVM
 	mnuUsbTraces,
+	mnuNetTiming,            // Network timing percentiles
 
 	/////--------- PLACE HOLDERS ------------
 
@@ -368,6 +391,7 @@ enum {
 	mnuBillerPayment,
 	mnuBillerAdvice,
 	mnuTerminalMode,
+	mnuLogExport,            // Log exported to the host disk, after the place holders: MenuItem of the records kept
 
 	mnuEnd
 };
@@ -559,6 +583,9 @@ enum {
 	traSurchargeAmt,
 	traBillerPaymentDetails,
 
+	traNetTiming,                               // Per stage timing of the online exchange
+	traAdviceBuild,                             // Request built for the advice queue: no PIN block or track data
+
 	traEnd
 };
 
@@ -795,6 +822,7 @@ enum {
 	lenTraName = 8,
 	lenLogo = 6,
 	lenCommRoute = 1,
+	lenNetTim = 64,
 	//=====================================================
 
 	lenprtW = prtW,
@@ -940,6 +968,7 @@ char isoField125[999 + 1];
 char isoField126[999 + 1];
 char isoField127[999 + 1];
 char isoField128[999 + 1];
+char isoNetTiming[lenNetTim + 1];
 
 ///====================================================
 
@@ -1063,6 +1092,12 @@ void TaskInitiateGPRS(void);
 int isReversibleSend(void);
 byte isSorted(word a, word b, word c);
 void revAutoReversal(void);
+int revQueueArm(void);
+void revQueueDisarm(void);
+void revQueueRecover(void);
+int revQueueCheck(void);
+void revQueueReset(void);
+int RevQueueDrain(byte Foreground);
 int incCard(word key);
 void CommsGetChannel(byte CommsChannelNow);
 int isApproved(void);
@@ -1149,16 +1184,79 @@ void IsoError(int iSta, char *pcTrk);
 void Magnetic(void);
 void Smart(void);
 void PromptSerial(void);
+typedef int (*tComRead)(void *pvSession, byte *pucDst, word usLen, long lTmo); ///< Transport reader used by comRecvFrame
+int comReadLL(void *pvSession, byte *pucDst, word usLen, long lTmo);
+int comRecvFrame(tComRead pfRead, void *pvSession, T_GL_HWIDGET hScreen, byte *pucMsg, word usLen, byte ucDly);
+int comSendLL(void *pvSession, const byte *pucMsg, word usLen);
 int ComSerial(tBuffer * req,tBuffer * rsp, word SSL);
+void *comSerialOpen(const char *pcInit, byte ucChn);
+void comSerialClose(void *pvSession);
 void PromptModem(void);
 int ComModem(tBuffer * req,tBuffer * rsp, word SSL);
 int ComUSB(tBuffer * req,tBuffer * rsp, word SSL);
+void *comUsbOpen(void);
 void PromptEthernet(void);
 int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL);
 int ComEthernetCheck(int SSL);
+void *comEthSessionOpen(word SSL, char *pcHost);
+void comEthSessionClose(void *pvSession);
 void PromptGPRS(void);
 int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL);
 int ComGPRSCheck(int SSL);
+void *comGprsSessionOpen(word SSL, char *pcHost);
+void comGprsSessionClose(void *pvSession);
+int hostSelLoad(const char *pcIp, const char *pcPort);
+int hostSelPick(byte *pucTried, char *pcIp, char *pcPort);
+void hostSelOk(int iIdx, card ulRtt);
+void hostSelFail(int iIdx);
+int hostSelProbeDue(void);
+void hostSelForce(int iIdx);
+
+byte rcvTmoGet(byte ucRoute, const char *pcHost);
+void rcvTmoSample(byte ucRoute, const char *pcHost, card ulRtt);
+void rcvTmoExpired(byte ucRoute, const char *pcHost);
+int dnsCacheResolve(const char *pcHost, char *pcIp, word usDim);
+void dnsCacheRefresh(void);
+
+void echoSchedTraffic(void);
+void echoSchedRun(void);
+enum {                                 // Stages of an online exchange (NetTiming.c)
+	netStgBuild,                       // Request building
+	netStgAttach,                      // Network attachment (GPRS, WiFi...)
+	netStgDns,                         // Host name resolution
+	netStgConnect,                     // TCP connection
+	netStgTls,                         // TLS handshake (TCP included when done by the same call)
+	netStgSend,                        // Request sending
+	netStgHost,                        // Host processing (sent -> first byte)
+	netStgRecv,                        // Response reception (first byte -> complete)
+	netStgEnd
+};
+void netTimBegin(void);
+void netTimMark(int iStg);
+void netTimCharge(int iStg, card ulFrom);
+void netTimTimeout(card ulTmo);
+int netTimEnd(char *pcTim, word usDim);
+card netTimStage(int iStg);
+card netTimPercentile(int iStg, int iPct);
+void netTimMenu(void);
+enum {                                 // Stages shown by the progress screen (ComStatus.c)
+	comStaBuild,                       // Request building
+	comStaWait,                        // Waiting for the background exchange holding the link
+	comStaAttach,                      // Network attachment
+	comStaConnect,                     // Connection to the host
+	comStaSend,                        // Request sending: from here the request may have left
+	comStaRecv,                        // Waiting for the answer
+	comStaEnd
+};
+T_GL_HWIDGET comStaOpen(void);
+T_GL_HWIDGET comStaScreen(void);
+void comStaShow(int iSta);
+int comStaCancel(T_GL_HWIDGET hScreen);
+int comStaCancelled(void);
+void comStaClose(void);
+int comStaCost(card *pulScreen, card *pulSaved);
+void ecrStart(void);
+void ecrSaleEnd(void);
 void PromptPPP(void);
 int ComPPP(tBuffer * req,tBuffer * rsp, word SSL);
 void VFSWrite(int VFSType);
@@ -1256,6 +1354,17 @@ int FUN_PinEntry(void);
 /** @} */
 /** @} */
 
+int onlSendRaw(tBuffer *req, tBuffer *rsp);
+int onlBgTake(void);
+void onlBgGive(void);
+void onlBgExpect(card ulTmo);
+int onlBgWait(void);
+int onlBatchOpen(void);
+int onlBatchSend(tBuffer *req);
+int onlBatchRecv(tBuffer *rsp);
+void onlBatchClose(void);
+int batchUpRun(void);
+void batchUpReset(void);
 int performOlineTransaction(void);
 int checkOlineServer(void);
 int TransactionFlow(void);
@@ -1300,6 +1409,8 @@ void fncPanRemove_F(char * PAN_Number);
 /** @} */
 /** @} */
 void AdviseTransactionManager(void);
+void AdviseQueueDrain(void);
+int AdviseQueueBusy(void);
 /** @} */
 /** @} */
 
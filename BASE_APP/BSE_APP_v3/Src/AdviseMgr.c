@@ -1,30 +1,39 @@
 #include <globals.h>
 #include "Sqlite.h"
+#include "perf_log.h"
 
-//static char ProcCode[(lenPrcCod * 2) + 2];
-//static char BitMap[(lenBitmap*4) + 2];
-//static char MTI[lenMti + 2];
+extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
+
+#define ADV_QUEUE_MAX   200  // Advices kept on disk before new ones are refused
+#define ADV_RETRY_MAX   20   // Attempts before an advice is parked
+#define ADV_DRAIN_MAX   10   // Advices sent by one background run
+
+static char ProcCode[(lenPrcCod * 2) + 2];
+static char BitMap[(lenBitmap*4) + 2];
+static char MTI[lenMti + 2];
+
+static volatile byte AdviseDrainBusy = 0;
 
 
 /**
  * To capture the Details on current transaction state
  */
 static void AdviseManage_Init(void){
-//	int ret = 0;
-//
-//	//------------------------Processing code
-//	memset(ProcCode, 0, sizeof(ProcCode));
-//	MAPGET(traRqsProcessingCode, ProcCode,lblKO);
-//
-//	//------------------------MTI
-//	memset(MTI, 0, sizeof(MTI));
-//	MAPGET(traRqsMTI, MTI,lblKO);
-//
-//	//------------------------MTI
-//	memset(BitMap, 0, sizeof(BitMap));
-//	MAPGET(traRqsBitMap, BitMap,lblKO);
-//
-//	lblKO:;
+	int ret = 0;
+
+	//------------------------Processing code
+	memset(ProcCode, 0, sizeof(ProcCode));
+	MAPGET(traRqsProcessingCode, ProcCode,lblKO);
+
+	//------------------------MTI
+	memset(MTI, 0, sizeof(MTI));
+	MAPGET(traRqsMTI, MTI,lblKO);
+
+	//------------------------MTI
+	memset(BitMap, 0, sizeof(BitMap));
+	MAPGET(traRqsBitMap, BitMap,lblKO);
+
+	lblKO:;
 }
 
 
@@ -32,21 +41,148 @@ static void AdviseManage_Init(void){
  * To restore the status of the current transaction Selection
  */
 static void AdviseManage_Complete(void){
-//	int ret = 0;
-//
-//	//------------------------Processing code
-//	memset(ProcCode, 0, sizeof(ProcCode));
-//	MAPPUTSTR(traRqsProcessingCode, ProcCode,lblKO);
-//
-//	//------------------------MTI
-//	memset(MTI, 0, sizeof(MTI));
-//	MAPPUTSTR(traRqsMTI, MTI,lblKO);
-//
-//	//------------------------MTI
-//	memset(BitMap, 0, sizeof(BitMap));
-//	MAPPUTSTR(traRqsBitMap, BitMap,lblKO);
-//
-//	lblKO:;
+	int ret = 0;
+
+	//------------------------Processing code
+	MAPPUTSTR(traRqsProcessingCode, ProcCode,lblKO);
+
+	//------------------------MTI
+	MAPPUTSTR(traRqsMTI, MTI,lblKO);
+
+	//------------------------MTI
+	MAPPUTSTR(traRqsBitMap, BitMap,lblKO);
+
+	lblKO:;
+}
+
+/**
+ * Build the 0220 advice of the current transaction and store it in the
+ * advice queue. Nothing is sent here, the background sender delivers it.
+ * The advice outlives the authorisation: it is built without the PIN block,
+ * its key or the track data, the card given by its PAN and expiry date.
+ */
+static int AdviseQueue_Put(void){
+	int ret = 0;
+	tBuffer bReq;
+	static byte dReq[(1024 * 3) + 1];              // Static: the task stack is small
+	static char Request[(sizeof(dReq) * 2) + 1];
+	char STAN[lenSTAN + 1];
+	char OldBitmap[4 + (lenBitmap*4)];
+	char AdvBitmap[4 + (lenBitmap*4)];
+	byte Bitmap[1 + (lenBitmap*2)];
+	char Message[64];
+	int iMapLen = 0, iParked = 0;
+
+	memset(dReq, 0, sizeof(dReq));
+	memset(STAN, 0, sizeof(STAN));
+	memset(Request, 0, sizeof(Request));
+	memset(OldBitmap, 0, sizeof(OldBitmap));
+	memset(AdvBitmap, 0, sizeof(AdvBitmap));
+	memset(Bitmap, 0, sizeof(Bitmap));
+	bufInit(&bReq, dReq, sizeof(dReq));
+
+	MAPGET(traSTAN, STAN, lblKO);
+	MAPGET(traRqsBitMap, OldBitmap, lblKO);
+	MAPPUTSTR(traRqsMTI, "020220", lblKO);
+
+	//Bitmap of the advice: length byte then the bitmap, as reqBuild reads it
+	iMapLen = strlen(OldBitmap) / 2;
+	if (iMapLen > (int)sizeof(Bitmap))
+		iMapLen = sizeof(Bitmap);
+	if (iMapLen >= 1 + lenBitmap) {
+		hex2bin(Bitmap, OldBitmap, iMapLen);
+		bitOff(Bitmap + 1, isoPinDat);
+		bitOff(Bitmap + 1, isoSecCtl);
+		bitOff(Bitmap + 1, isoTrk2);
+		bitOff(Bitmap + 1, iso045);
+		bin2hex(AdvBitmap, Bitmap, iMapLen);
+		MAPPUTSTR(traRqsBitMap, AdvBitmap, lblKO);
+	}
+	MAPPUTBYTE(traAdviceBuild, 1, lblKO);          //modifyBitmap adds none of them back
+
+	ret = reqBuild(&bReq);
+	mapPutByte(traAdviceBuild, 0);                 //Cleared by reqBuild, unless it failed before
+	mapPutStr(traRqsBitMap, OldBitmap);
+	CHECK(ret > 0, lblKO);
+	bin2hex(Request, bufPtr(&bReq), bufLen(&bReq));
+
+	ret = sqlite_Advice_Put(STAN, isoMnuItm, Request, ADV_QUEUE_MAX);
+	CHECK(ret >= 0, lblKO);
+	if (ret == 0) {
+		perflog("ADV queue full");
+		iParked = sqlite_Advice_Parked();          //Kept in the queue, the host refused them
+		if (iParked > 0)
+			Telium_Sprintf(Message, "Advice queue full""\n""%d refused by host""\n""Call help desk", iParked);
+		else
+			strcpy(Message, "Advice queue full""\n""Please connect");
+		if (isApp_Already_in_Session() != 0)       //Sale in progress: the merchant is told
+			GL_Dialog_Message(hGoal, NULL, Message, GL_ICON_WARNING, GL_BUTTON_NONE, 2*1000);
+	}
+
+	return ret;
+	lblKO:
+	return -1;
+}
+
+/**
+ * Deliver the queued advices in order, oldest first.
+ * Runs from the background task: it stops at the first failure so the
+ * order is kept, and steps aside as soon as a transaction is in session.
+ */
+void AdviseQueueDrain(void){
+	int ret = 0, iLen = 0, iCnt = 0;
+	tBuffer bReq;
+	static byte dReq[(1024 * 3) + 1];              // Static: the task stack is small
+	tBuffer bRsp;
+	static byte dRsp[(1024 * 3) + 3];
+	static char Request[(sizeof(dReq) * 2) + 1];
+	char STAN[lenSTAN + 1];
+
+	if (AdviseDrainBusy)
+		return;
+	AdviseDrainBusy = 1;
+
+	for (iCnt = 0; iCnt < ADV_DRAIN_MAX; iCnt++) {
+		CHECK(onlBgTake() > 0, lblEnd);                    // Foreground has the link
+
+		memset(STAN, 0, sizeof(STAN));
+		memset(Request, 0, sizeof(Request));
+		ret = sqlite_Advice_Peek(STAN, Request, sizeof(Request));
+		CHECK(ret > 0, lblEnd);                            // Empty or DB error
+
+		memset(dReq, 0, sizeof(dReq));
+		memset(dRsp, 0, sizeof(dRsp));
+		bufInit(&bReq, dReq, sizeof(dReq));
+		bufInit(&bRsp, dRsp, sizeof(dRsp));
+
+		iLen = hex2bin(dRsp, Request, strlen(Request) / 2);
+		CHECK(iLen > 0, lblBad);
+		bufApp(&bReq, dRsp, iLen);
+		bufReset(&bRsp);
+
+		ret = onlSendRaw(&bReq, &bRsp);
+		onlBgGive();
+		CHECK(ret >= 2, lblBad);
+		CHECK((bufPtr(&bRsp)[0] == 0x02) && (bufPtr(&bRsp)[1] == 0x30), lblBad); // 0230 acknowledgement
+
+		sqlite_Advice_Update(STAN, 1, ADV_RETRY_MAX);
+	}
+	goto lblEnd;
+
+	lblBad:
+	sqlite_Advice_Update(STAN, 0, ADV_RETRY_MAX);
+	goto lblEnd;
+
+	lblEnd:
+	onlBgGive();
+	AdviseDrainBusy = 0;
+}
+
+/**
+ * Tell whether the advice sender is running (it holds the link).
+ */
+int AdviseQueueBusy(void){
+	return AdviseDrainBusy;
 }
 
 ///Send PosIris Advise after transaction
@@ -82,9 +218,14 @@ void AdviseTransactionManager(void){
 	case mnuCompletion:
 	case mnuSale: // Can either do Final Advise(Online approve) or Information Advise(Offline declined)
 		if (strncmp(responseCode,"00",2) == 0) {        /// Final Advise
-
+			AdviseQueue_Put();
 		} else if (strncmp(responseCode,"Z1",2) == 0) { /// Information Advise
-
+			AdviseQueue_Put();
+		}
+		break;
+	case mnuOffline: // Offline approved, the host only learns about it through the advice
+		if ((strncmp(responseCode,"Y1",2) == 0) || (strncmp(responseCode,"Y3",2) == 0) || (strncmp(responseCode,"00",2) == 0)) {
+			AdviseQueue_Put();
 		}
 		break;
 	default:
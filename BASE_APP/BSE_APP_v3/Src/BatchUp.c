@@ -0,0 +1,300 @@
+/*
+ * BatchUp.c
+ *
+ *  Batch upload (0320) of the settlement, sent when the host answers the
+ *  settlement with 95 (totals not matching). The approved records of the
+ *  terminal are streamed from the log on one connection with up to
+ *  appBatchWindow requests in flight, instead of a connection and a full
+ *  round trip per record; each answer is matched to its request by the
+ *  STAN it echoes, so the host may answer out of order.
+ *  The record up to which everything was acknowledged is kept in
+ *  appBatchUpAck: an upload broken by the link or a power failure goes on
+ *  from there, on a new connection or at the next settlement attempt,
+ *  instead of from the first record.
+ */
+#include <globals.h>
+#include "Sqlite.h"
+#include "perf_log.h"
+
+//****************************************************************************
+//      EXTERN
+//****************************************************************************
+extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define BATCH_WIN_DFT    4             // Requests in flight when appBatchWindow is not set
+#define BATCH_WIN_MAX    16
+#define BATCH_SAVE       16            // Acknowledgements between two saves of the resume point
+#define BATCH_RETRY      2             // New connections after a broken one
+#define BATCH_DSP        50            // Records between two progress displays
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	char tcStan[lenSTAN + 1];          // STAN the request was sent with
+	long lId;                          // Log record
+	byte ucAck;                        // Answer received
+} tBatchFly;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tBatchFly tzFly[BATCH_WIN_MAX]; // Requests in flight, in send order
+static int iFlyHead = 0;
+static int iFlyCnt = 0;
+static int iSent = 0;                  // Requests sent by the current upload
+
+static int batchUpWindow(void) {
+	char tcWin[2 + 1];
+	int iWin = 0;
+
+	memset(tcWin, 0, sizeof(tcWin));
+	if (appGet(appBatchWindow, tcWin, sizeof(tcWin)) >= 0)
+		iWin = atoi(tcWin);
+	if (iWin <= 0)
+		iWin = BATCH_WIN_DFT;
+	if (iWin > BATCH_WIN_MAX)
+		iWin = BATCH_WIN_MAX;
+	return iWin;
+}
+
+// Resume point of a terminal: id of the last record acknowledged in order, 0 if none.
+static long batchUpResume(const char *pcTid) {
+	char tcAck[lenTID + 1 + 10 + 1];
+	char *pcSep;
+
+	memset(tcAck, 0, sizeof(tcAck));
+	if (appGet(appBatchUpAck, tcAck, sizeof(tcAck)) < 0)
+		return 0;
+	pcSep = strchr(tcAck, '|');
+	if (pcSep == NULL)
+		return 0;
+	*pcSep = 0;
+	if (strcmp(tcAck, pcTid) != 0)             // Left by the other terminal id
+		return 0;
+	return atol(pcSep + 1);
+}
+
+static void batchUpSave(const char *pcTid, long lAck) {
+	char tcAck[lenTID + 1 + 10 + 1];
+	int ret;
+
+	memset(tcAck, 0, sizeof(tcAck));
+	Telium_Sprintf(tcAck, "%s|%ld", pcTid, lAck);
+	MAPPUTSTR(appBatchUpAck, tcAck, lblKO);
+
+	lblKO:;
+}
+
+// Build the 0320 of the record loaded in the transaction and send it.
+static int batchUpSend(long lId) {
+	tBuffer bReq;
+	static byte dReq[(1024 * 3) + 1];
+	tBatchFly *pxFly;
+	card ulStan = 0;
+	int ret;
+
+	MAPPUTSTR(traRqsBitMap, "083038078020C80006", lblKO);
+	MAPPUTSTR(traRqsMTI, "020320", lblKO);
+
+	memset(dReq, 0, sizeof(dReq));
+	bufInit(&bReq, dReq, sizeof(dReq));
+	ret = reqBuild(&bReq);
+	CHECK(ret > 0, lblKO);
+
+	pxFly = &tzFly[(iFlyHead + iFlyCnt) % BATCH_WIN_MAX];
+	memset(pxFly, 0, sizeof(*pxFly));
+	MAPGETCARD(appSTAN, ulStan, lblKO);        // Field 11 of the request just built
+	num2dec(pxFly->tcStan, ulStan, lenSTAN);
+	pxFly->lId = lId;
+
+	ret = onlBatchSend(&bReq);
+	CHECK(ret >= 0, lblKO);
+	iFlyCnt++;
+	incCard(appSTAN);
+
+	if ((++iSent % BATCH_DSP) == 0) {
+		char tcDsp[32 + 1];
+
+		Telium_Sprintf(tcDsp, "Batch upload\n%d records", iSent);
+		GL_Dialog_Message(hGoal, NULL, tcDsp, GL_ICON_INFORMATION, GL_BUTTON_NONE, 0);
+	}
+
+	return 1;
+	lblKO:
+	return -1;
+}
+
+// Wait for the next 0330 and mark its request as acknowledged.
+static int batchUpRecv(void) {
+	tBuffer bRsp;
+	static byte dRsp[(1024 * 3) + 3];
+	char tcStan[lenSTAN + 1];
+	char tcRspCod[lenRspCod + 1];
+	int iIdx, ret;
+
+	memset(dRsp, 0, sizeof(dRsp));
+	memset(tcStan, 0, sizeof(tcStan));
+	memset(tcRspCod, 0, sizeof(tcRspCod));
+	bufInit(&bRsp, dRsp, sizeof(dRsp));
+
+	ret = onlBatchRecv(&bRsp);
+	CHECK(ret >= 2, lblKO);
+	if ((bufPtr(&bRsp)[0] != 0x03) || (bufPtr(&bRsp)[1] != 0x30)) {
+		perflog("BATCH unexpected message");
+		return 0;
+	}
+
+	rspParse(bufPtr(&bRsp), bufLen(&bRsp));
+	MAPGET(traSTAN, tcStan, lblKO);
+	MAPGET(traRspCod, tcRspCod, lblKO);
+
+	for (iIdx = 0; iIdx < iFlyCnt; iIdx++) {
+		tBatchFly *pxFly = &tzFly[(iFlyHead + iIdx) % BATCH_WIN_MAX];
+
+		if (pxFly->ucAck || (strcmp(pxFly->tcStan, tcStan) != 0))
+			continue;
+		pxFly->ucAck = 1;
+		if (strncmp(tcRspCod, "00", 2) != 0)
+			perflog("BATCH record refused");           // Delivered all the same: the host decides
+		return 1;
+	}
+
+	perflog("BATCH answer matches no request");
+	return 0;
+	lblKO:
+	return -1;
+}
+
+// One connection: send from the resume point until the end of the log or a failure.
+static int batchUpPass(const char *pcTid, long *plAck, int iWin) {
+	long lId = 0;
+	int iEof = 0, iAcked = 0, ret;
+
+	iFlyHead = 0;
+	iFlyCnt = 0;
+
+	ret = onlBatchOpen();
+	CHECK(ret >= 0, lblKO);
+	if (ret == 0)
+		iWin = 1;                                      // Route without session: no pipelining
+
+	ret = sqlite_Batch_Open(pcTid, *plAck);
+	CHECK(ret > 0, lblKO);
+
+	while (1) {
+		while (!iEof && (iFlyCnt < iWin)) {           // Fill the window
+			ret = sqlite_Batch_Next(&lId);
+			CHECK(ret >= 0, lblKO);
+			if (ret == 0) {
+				iEof = 1;
+				break;
+			}
+			ret = batchUpSend(lId);
+			CHECK(ret > 0, lblKO);
+		}
+		if (iFlyCnt == 0)
+			break;
+
+		ret = batchUpRecv();
+		CHECK(ret >= 0, lblKO);
+
+		while ((iFlyCnt > 0) && tzFly[iFlyHead].ucAck) { // Slide over the requests answered in order
+			*plAck = tzFly[iFlyHead].lId;
+			iFlyHead = (iFlyHead + 1) % BATCH_WIN_MAX;
+			iFlyCnt--;
+			if ((++iAcked % BATCH_SAVE) == 0)
+				batchUpSave(pcTid, *plAck);
+		}
+	}
+
+	ret = 1;
+	goto lblEnd;
+	lblKO:
+	ret = -1;
+	lblEnd:
+	sqlite_Batch_Close();
+	onlBatchClose();
+	batchUpSave(pcTid, *plAck);
+	return ret;
+}
+
+//****************************************************************************
+//                       int batchUpRun (void)
+//  This function uploads the approved records of the terminal (appTID)
+//  not acknowledged yet. A broken connection is opened again up to
+//  BATCH_RETRY times, from the last record acknowledged in order; requests
+//  in flight past it are sent again. The resume point is kept only when
+//  the upload is interrupted. The transaction data used to build the
+//  requests are given back when done.
+//  This function has no parameters.
+//  This function has return value
+//    >0 : All records acknowledged
+//    <0 : Upload interrupted, resume point saved
+//****************************************************************************
+int batchUpRun(void) {
+	char tcTid[lenTID + 1];
+	char tcMti[(lenMti * 2) + 1];
+	char tcBitmap[100];
+	char tcPrcCod[(lenPrcCod * 2) + 1];
+	char tcStan[lenSTAN + 1];
+	long lAck;
+	int iWin, iTry, iRet = -1, ret = 0;
+
+	memset(tcTid, 0, sizeof(tcTid));
+	memset(tcMti, 0, sizeof(tcMti));
+	memset(tcBitmap, 0, sizeof(tcBitmap));
+	memset(tcPrcCod, 0, sizeof(tcPrcCod));
+	memset(tcStan, 0, sizeof(tcStan));
+
+	//Hold the settlement details
+	MAPGET(appTID, tcTid, lblKO);
+	MAPGET(traRqsMTI, tcMti, lblKO);
+	MAPGET(traRqsBitMap, tcBitmap, lblKO);
+	MAPGET(traRqsProcessingCode, tcPrcCod, lblKO);
+	MAPGET(traSTAN, tcStan, lblKO);
+
+	iWin = batchUpWindow();
+	lAck = batchUpResume(tcTid);
+	if (lAck > 0)
+		perflog("BATCH upload resumed");
+	iSent = 0;
+
+	onlBgWait();                                       // A background exchange may hold the link
+	for (iTry = 0; iTry <= BATCH_RETRY; iTry++) {
+		iRet = batchUpPass(tcTid, &lAck, iWin);
+		if (iRet > 0)
+			break;
+		perflog("BATCH connection lost");
+	}
+	if (iRet > 0)
+		batchUpReset();                                // Complete: a new 95 asks for the whole batch
+
+	//Give back the settlement details
+	MAPPUTSTR(traRqsMTI, tcMti, lblKO);
+	MAPPUTSTR(traRqsBitMap, tcBitmap, lblKO);
+	MAPPUTSTR(traRqsProcessingCode, tcPrcCod, lblKO);
+	MAPPUTSTR(traSTAN, tcStan, lblKO);
+
+	return iRet;
+	lblKO:
+	return -1;
+}
+
+//****************************************************************************
+//                       void batchUpReset (void)
+//  This function forgets the resume point. Called when the batch is closed:
+//  the upload of the next one starts from its first record.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void batchUpReset(void) {
+	int ret;
+
+	MAPPUTSTR(appBatchUpAck, "", lblKO);
+
+	lblKO:;
+}
@@ -0,0 +1,148 @@
+/*
+ * BgLink.c
+ *
+ *  Link ownership between the foreground transaction and the background
+ *  senders (reversals, advices, echo, DNS refresh, SIM switch). The
+ *  foreground announces itself in SESSION.txt before going online; a
+ *  background sender takes the link only when no session is open and the
+ *  foreground waits for it to give it back. The link is one unit of an OS
+ *  semaphore: the background tasks run concurrently, and only one of them
+ *  may hold it. Once the sender is waiting for its answer, the foreground
+ *  waits no longer than the receive timeout the sender was given.
+ */
+#include <globals.h>
+#include "perf_log.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define ONL_BG_WAIT  60  // Seconds the foreground waits for a sender not receiving yet
+#define ONL_BG_CLOSE 2   // Seconds left to the sender to hang up after its receive timeout
+#define ONL_BG_SLICE 100 // ms between two polls of the cancel key
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static T_OSL_HSEMAPHORE hBgSem = NULL;
+static volatile word usBgOwner = 0;    // Task holding the link
+static volatile byte ucBgLink = 0;     // Link held by usBgOwner
+static volatile card ulBgEnd = 0;      // Tick the sender hangs up by, once receiving
+static volatile byte ucBgRecv = 0;     // ulBgEnd set by the sender holding the link
+
+static T_OSL_HSEMAPHORE onlBgSem(void){
+	if (hBgSem == NULL)                // Opened by name: tasks racing on the first call get the same one
+		hBgSem = OSL_Semaphore_Create("SEM_ONLBG", 1, OSL_OPEN_CREATE, OSL_SECURITY_LOCAL);
+	return hBgSem;
+}
+
+//****************************************************************************
+//                      int onlBgTake (void)
+//  This function takes the link for a background exchange, without
+//  waiting: the link is left to the foreground session or to the
+//  background sender holding it.
+//  This function has no parameters.
+//  This function has return value
+//    1 : Link taken, to be given back by onlBgGive() from the same task
+//    0 : Foreground session open or link already taken
+//****************************************************************************
+int onlBgTake(void){
+	T_OSL_HSEMAPHORE hSem = onlBgSem();
+
+	CHECK(hSem!=NULL, lblKO);
+	CHECK(isApp_Already_in_Session()==0, lblKO);
+	CHECK(OSL_Semaphore_Acquire(hSem, 0)==OSL_SUCCESS, lblKO);   // Another background sender has it
+	ucBgRecv = 0;
+	usBgOwner = Telium_CurrentTask();  // Owner before the flag: another task never sees itself as owner
+	ucBgLink = 1;
+
+	if (isApp_Already_in_Session() != 0) {                        // Session opened meanwhile, leave it the link
+		onlBgGive();
+		goto lblKO;
+	}
+	return 1;
+
+	lblKO:
+	return 0;
+}
+
+//****************************************************************************
+//                      void onlBgGive (void)
+//  This function gives back the link taken by onlBgTake(). It does nothing
+//  when the calling task does not hold the link, so a sender may give it
+//  on every exit path.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void onlBgGive(void){
+	if (!ucBgLink || (usBgOwner != Telium_CurrentTask()))
+		return;                        // Not taken by this task
+	ucBgLink = 0;
+	OSL_Semaphore_Release(hBgSem);
+}
+
+//****************************************************************************
+//                    void onlBgExpect (card ulTmo)
+//  This function records that the sender holding the link waits for its
+//  answer: the foreground waits for it until that receive timeout is over,
+//  and ONL_BG_CLOSE seconds more. Called for every exchange; it does
+//  nothing when the calling task does not hold the link.
+//  This function has parameters.
+//    ulTmo (I-) : Receive timeout of the exchange (ms)
+//  This function has no return value
+//****************************************************************************
+void onlBgExpect(card ulTmo){
+	if (!ucBgLink || (usBgOwner != Telium_CurrentTask()))
+		return;                        // Foreground exchange
+	ulBgEnd = GTL_StdTimer_GetCurrent() + ulTmo / 10 + ONL_BG_CLOSE * 100;
+	ucBgRecv = 1;
+}
+
+//****************************************************************************
+//                      int onlBgWait (void)
+//  This function makes the foreground wait until the background exchange
+//  in progress is over: until the receive timeout of the sender is over
+//  once it waits for its answer (see onlBgExpect), ONL_BG_WAIT seconds at
+//  most before. The wait is shown on the progress screen, where the cancel
+//  key stops it.
+//  This function has no parameters.
+//  This function has return value
+//    1 : Link free
+//    0 : Link still held when the wait was over
+//   -1 : Cancelled
+//****************************************************************************
+int onlBgWait(void){
+	T_OSL_HSEMAPHORE hSem = onlBgSem();
+	T_GL_HWIDGET hScreen;
+	card ulEnd;
+	int iRet = 1;
+
+	CHECK(hSem!=NULL, lblEnd);
+	CHECK(OSL_Semaphore_Acquire(hSem, 0)!=OSL_SUCCESS, lblFree);
+
+	hScreen = comStaScreen();          // NULL without a foreground exchange: not cancellable
+	comStaShow(comStaWait);
+	ulEnd = GTL_StdTimer_GetCurrent() + ONL_BG_WAIT * 100;
+	for (;;) {
+		if (ucBgRecv)
+			ulEnd = ulBgEnd;           // Sender receiving: its own timeout is the bound
+		CHECK(comStaCancel(hScreen)==0, lblCancel);
+		CHECK((long)(ulEnd - GTL_StdTimer_GetCurrent()) > 0, lblOver);
+		if (OSL_Semaphore_Acquire(hSem, ONL_BG_SLICE) == OSL_SUCCESS)
+			break;
+	}
+
+	lblFree:
+	OSL_Semaphore_Release(hSem);       // Not kept: the open session keeps the senders off
+	goto lblEnd;
+
+	lblOver:
+	perflog("ONLBG wait over");
+	iRet = 0;
+	goto lblEnd;
+
+	lblCancel:
+	iRet = -1;
+
+	lblEnd:
+	return iRet;
+}
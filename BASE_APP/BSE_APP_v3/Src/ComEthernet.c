@@ -39,6 +39,7 @@
 #include "TlvTree.h"
 #include "LinkLayer.h"
 #include "SSL_.h"
+#include "perf_log.h"
 
 //****************************************************************************
 //      EXTERN                                                              
@@ -444,8 +445,7 @@ static int SendEthernet(LL_HANDLE hSession, const byte *pcMsg, word usLen){
 //                             char *pcMsg, word usLen, byte ucDly)
 //  This function receives data through the Ethernet layer.
 //   - LL_ClearReceiveBuffer() : Clear receiving buffer
-//   - LL_Receive() : Wait and receive data
-//   - LL_GetLastError() : Retrieve the last error
+//   - comRecvFrame() : Wait and receive one length framed message
 //  This function has parameters.  
 //    hSession (I-) : Handle of the session
 //    hScreen (I-) : Handle of the screen
@@ -457,64 +457,9 @@ static int SendEthernet(LL_HANDLE hSession, const byte *pcMsg, word usLen){
 //     <0 : Reception failed                                       
 //****************************************************************************
 static int ReceiveEthernet(LL_HANDLE hSession, T_GL_HWIDGET hScreen, byte *pcMsg, word usLen, byte ucDly){
-	// Local variables 
-	// ***************
-	int iKey;
-	long lSec, lTimeOut=LL_INFINITE;
-	int iRet, iLength=0, iNbrBytes;
-
-	// Timeout setting
-	// ***************
-	if(ucDly != 0xFF)
-		lSec = ucDly*1000;
-	else
-		lSec = LL_INFINITE;
-
-	// Receiving first block
-	// *********************
-	//	ResetPeripherals(KEYBOARD | TSCREEN);                                  // Reset peripherals FIFO
-	iRet = TimerStart(0, lSec);                                            // Timer0 starts
-	CHECK(iRet>=0, lblTimeOut);
-
-	do{
-		iNbrBytes = LL_Receive(hSession, usLen, pcMsg+iLength, 1*100);     // Check reception
-		if (iNbrBytes != 0)
-			break;                                                         // Bytes received
-		iKey = GoalGetKey(hScreen, hGoal, true, 0, false);                 // Get key pressed/touched (shortcut)
-		CHECK(iKey!=GL_KEY_CANCEL, lblTimeOut);                            // Exit on cancel key
-		if (lSec != LL_INFINITE)
-			lTimeOut = TimerGet(0);                                        // Retrieve timer value
-	} while (lTimeOut>0);
-
-	CHECK(lTimeOut!=0, lblTimeOut);                                        // Exit on timeout
-
-	iLength += iNbrBytes;
-	iRet = LL_GetLastError(hSession);
-	CHECK (iRet==LL_ERROR_OK, lblEnd);
-	if ((iNbrBytes != 0) && (iNbrBytes < usLen))	{
-		// Receiving next block until timeout (Inter block 500ms)
-		// ======================================================
-		while(1){
-			iNbrBytes = LL_Receive(hSession, usLen-iLength, pcMsg+iLength, 50);
-			iLength += iNbrBytes;
-			iRet = LL_GetLastError(hSession);
-			CHECK ((iRet==LL_ERROR_OK) || (iRet==LL_ERROR_TIMEOUT), lblEnd);
-			if ((iRet==LL_ERROR_TIMEOUT) || (iNbrBytes==0))
-				break;
-		}
-	}
-
-	iRet = iLength;
-	goto lblEnd;
-
-	// Errors treatment 
-	// ****************
-	lblTimeOut:                                                                // Timeout expired
-	iRet = LL_ERROR_TIMEOUT;
-	goto lblEnd;
-	lblEnd:
-	TimerStop(0);
-	return iRet;
+	// Length framed reception (header first, then exactly the announced bytes)
+	// ***********************************************************************
+	return comRecvFrame(comReadLL, hSession, hScreen, (byte *)pcMsg, usLen, ucDly);
 }
 
 //****************************************************************************
@@ -751,6 +696,9 @@ int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL) {
 	char tcPort[lenEthPort+1];
 	char tcDisplay[50+1];
 	int iRet=0, iStatus=0,RetVal = -1;
+	int iHost = -1;
+	byte ucTried = 0;
+	card ulRtt = 0;
 	byte RespBuffer[4096];
 
 	// Transmission through Ethernet layer in progress
@@ -760,16 +708,11 @@ int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL) {
 	memset(RespBuffer, 0, sizeof(RespBuffer));
 	memset(tcIpAddress, 0, sizeof(tcIpAddress));
 
-	hScreen = GoalCreateScreen(hGoal, txEthernet, NUMBER_OF_LINES(txEthernet), GL_ENCODING_UTF8);
-	CHECK(hScreen!=NULL, lblKO);                                          // Create screen and clear it
-	iRet = GoalClrScreen(hScreen, GL_COLOR_BLACK, KEY_CANCEL, false);
-	CHECK(iRet>=0, lblKO);
+	hScreen = comStaScreen();                                             // Progress screen, NULL in background
 
 	// Open Ethernet layer
 	// ===================
-	pcStr = "      Connecting...";
-	iRet = GoalDspLine(hScreen, 2, pcStr, &txEthernet[1], 0, true);
-	CHECK(iRet>=0, lblKO);
+	comStaShow(comStaConnect);
 
 	iRet = appGet(appEthIpLocal, tcIpAddress, lenEthIpLocal+1);           // Retrieve local IP
 	CHECK(iRet>=0, lblDbaErr);
@@ -777,23 +720,32 @@ int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL) {
 	iRet = appGet(appEthPort, tcPort, lenEthPort+1);                      // Retrieve port number
 	CHECK(iRet>=0, lblDbaErr);
 
+	hostSelLoad(tcIpAddress, tcPort);                                     // Primary + secondary hosts
+
+	lblNextHost:
+	CHECK(comStaCancel(hScreen)==0, lblCancel);
+	iHost = hostSelPick(&ucTried, tcIpAddress, tcPort);                   // Best host not tried yet
+	CHECK(iHost>=0, lblComKO);
+
 	Telium_Sprintf (tcStr, "%s|%s", tcIpAddress, tcPort);
 
 	pcStr = "DHCP";
 	hETH = OpenEthernet(pcStr, tcStr, SSL);                                    // ** Open **
 	CHECK(hETH!=NULL, lblComKO);
+	netTimMark(netStgAttach);
 
 	// Connect Ethernet layer
 	// ======================
-	iRet = GoalClrScreen(hScreen, GL_COLOR_BLACK, KEY_CANCEL, false);
-	CHECK(iRet>=0, lblKO);
-
 	iRet = ConnectEthernet(hETH);                                         // ** Connect **
+	netTimMark(SSL ? netStgTls : netStgConnect);                          // Handshake done by LL_Connect
+	if ((iRet < 0) && (iRet != LL_ERROR_NETWORK_NOT_READY)) {             // Host side failure, try the next one
+		hostSelFail(iHost);
+		CloseEthernet(hETH);
+		hETH = NULL;
+		goto lblNextHost;
+	}
 	CHECK(iRet>=0, lblComKO);
 
-	iRet = GoalDspLine(hScreen, 2, "      Sending...", &txEthernet[1], 0, true);
-	CHECK(iRet>=0, lblKO);
-
 	// Clear sending/receiving buffers
 	// ===============================
 	iRet = LL_ClearSendBuffer(hETH);
@@ -804,22 +756,30 @@ int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL) {
 
 	// Send data through Ethernet layer
 	// ================================
+	CHECK(comStaCancel(hScreen)==0, lblCancel);                           // Last point where the request has not left
+	comStaShow(comStaSend);
+	ulRtt = GTL_StdTimer_GetCurrent();
 	iRet = SendEthernet(hETH, bufPtr(req), bufLen(req));               // ** Send data **
 	CHECK(iRet>=0, lblComKO);
+	netTimMark(netStgSend);
 
 	// Receive data through Ethernet layer
 	// ===================================
-	iRet = GoalDspLine(hScreen, 2, "      Receiving...", &txEthernet[4], 0, true);
-	CHECK(iRet>=0, lblKO);
-
-	iRet = ReceiveEthernet(hETH, hScreen, RespBuffer, bufDim(rsp), 30);      // ** Receive data **
+	comStaShow(comStaRecv);
+
+	iRet = ReceiveEthernet(hETH, hScreen, RespBuffer, bufDim(rsp), rcvTmoGet('T', tcStr));      // ** Receive data **
+	CHECK(comStaCancelled()<0, lblCancel);                                // Not the host's fault
+	if (iRet == LL_ERROR_TIMEOUT)
+		rcvTmoExpired('T', tcStr);
+	if (iRet < 0)                                                         // Request already sent, no failover
+		hostSelFail(iHost);
 	CHECK(iRet>=0, lblComKO);
+	ulRtt = (GTL_StdTimer_GetCurrent() - ulRtt) * 10;
+	hostSelOk(iHost, ulRtt);
+	rcvTmoSample('T', tcStr, ulRtt);
 	bufApp(rsp, RespBuffer, iRet);
 	RetVal = iRet;
 
-	iRet = GoalClrScreen(hScreen, GL_COLOR_BLACK, KEY_CANCEL, false);
-	CHECK(iRet>=0, lblKO);
-
 	// Disconnection
 	// =============
 	iRet = DisconnectEthernet(hETH);                                      // ** Disconnect **
@@ -833,7 +793,10 @@ int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL) {
 	// Errors treatment 
 	// ****************
 	lblKO:                                                                    // None-classified low level error
-	GL_Dialog_Message(hGoal, NULL, "Processing Error", GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	if (hScreen)                                                          // Background: nothing over the idle screen
+		GL_Dialog_Message(hGoal, NULL, "Processing Error", GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	else
+		perflog("ETH processing error");
 	goto lblEnd;
 
 
@@ -858,14 +821,23 @@ int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL) {
 		strcat(tcDisplay, LL_ErrorMsg(iStatus));                          // Link Layer status
 	}
 
-	if (iRet != LL_ERROR_TIMEOUT)                                         // Cancel or timeout ?
+	if (hScreen && (iRet != LL_ERROR_TIMEOUT))                            // Cancel or timeout ?
 		GL_Dialog_Message(hGoal, NULL, tcDisplay, GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	if (hScreen == NULL)                                                  // Background: nothing over the idle screen
+		perflog("ETH link error");
 	goto lblEnd;
 
 
 	lblDbaErr:                                                                // Data base error
 	Telium_Sprintf(tcDisplay, "%s\n%s", FMG_ErrorMsg(iRet), "Software Reset Needed");
-	GL_Dialog_Message(hGoal, NULL, tcDisplay, GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	if (hScreen)
+		GL_Dialog_Message(hGoal, NULL, tcDisplay, GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	else
+		perflog("ETH data base error");
+	goto lblEnd;
+
+
+	lblCancel:                                                                // Cancelled by the cashier, told by the caller
 	goto lblEnd;
 
 
@@ -874,14 +846,87 @@ int ComEthernet(tBuffer * req,tBuffer * rsp, word SSL) {
 		DisconnectEthernet(hETH);                                         // ** Disconnect **
 		CloseEthernet(hETH);                                              // ** Close **
 	}
-	if (hScreen)
-		GoalDestroyScreen(&hScreen);                                      // Destroy screen
 
 	return RetVal;
 }
 
 
 
+//****************************************************************************
+//              void *comEthSessionOpen (word SSL, char *pcHost)
+//  This function opens and connects an Ethernet session kept for several
+//  exchanges (batch upload), on the best host that accepts the connection.
+//  This function has parameters.
+//    SSL (I-) : 1 for TLS
+//    pcHost (-O) : Host dialled as "ip|port" (129 bytes)
+//  This function has return value
+//    Session handle, NULL when no host could be reached
+//****************************************************************************
+void *comEthSessionOpen(word SSL, char *pcHost) {
+	LL_HANDLE hETH=NULL;
+	char tcIpAddress[100+1];
+	char tcPort[100+1];
+	int iRet, iHost;
+	byte ucTried = 0;
+
+	memset(tcPort, 0, sizeof(tcPort));
+	memset(tcIpAddress, 0, sizeof(tcIpAddress));
+
+	iRet = appGet(appEthIpLocal, tcIpAddress, lenEthIpLocal+1);         // Retrieve host IP
+	CHECK(iRet>=0, lblKO);
+	iRet = appGet(appEthPort, tcPort, lenEthPort+1);                  // Retrieve port number
+	CHECK(iRet>=0, lblKO);
+
+	hostSelLoad(tcIpAddress, tcPort);                                 // Primary + secondary hosts
+
+	lblNextHost:
+	iHost = hostSelPick(&ucTried, tcIpAddress, tcPort);               // Best host not tried yet
+	CHECK(iHost>=0, lblKO);
+
+	Telium_Sprintf (pcHost, "%s|%s", tcIpAddress, tcPort);
+	hETH = OpenEthernet("DHCP", pcHost, SSL);                         // ** Open **
+	CHECK(hETH!=NULL, lblKO);
+
+	iRet = ConnectEthernet(hETH);                                     // ** Connect **
+	if ((iRet < 0) && (iRet != LL_ERROR_NETWORK_NOT_READY)) {         // Host side failure, try the next one
+		hostSelFail(iHost);
+		CloseEthernet(hETH);
+		hETH = NULL;
+		goto lblNextHost;
+	}
+	CHECK(iRet>=0, lblKOClose);
+
+	iRet = LL_ClearSendBuffer(hETH);
+	CHECK(iRet==LL_ERROR_OK, lblKODisconnect);
+	iRet = LL_ClearReceiveBuffer(hETH);
+	CHECK(iRet==LL_ERROR_OK, lblKODisconnect);
+
+	return hETH;
+
+	lblKODisconnect:
+	comEthSessionClose(hETH);
+	return NULL;
+	lblKOClose:
+	CloseEthernet(hETH);
+	lblKO:
+	return NULL;
+}
+
+//****************************************************************************
+//              void comEthSessionClose (void *pvSession)
+//  This function disconnects and closes a session opened by
+//  comEthSessionOpen().
+//  This function has parameters.
+//    pvSession (I-) : Session handle (NULL: nothing done)
+//  This function has no return value
+//****************************************************************************
+void comEthSessionClose(void *pvSession) {
+	if (pvSession == NULL)
+		return;
+	if (DisconnectEthernet((LL_HANDLE)pvSession) == LL_ERROR_OK)      // ** Disconnect **
+		CloseEthernet((LL_HANDLE)pvSession);                          // ** Close **
+}
+
 //****************************************************************************
 //                      void ComEthernet (void)
 //  This function communicates through the Ethernet layer.
@@ -0,0 +1,159 @@
+/*
+ * ComFrame.c
+ *
+ *  Length framed reception shared by all the transports.
+ *  The host answers with a 2 bytes binary length followed by the message
+ *  (TPDU + ISO), exactly like the request built by onlSendRaw(). The frame
+ *  is complete as soon as that many bytes arrived: no inter block timeout
+ *  is waited for and no byte past the frame is ever read. The timeout is a
+ *  deadline of its own on the tick counter: Timer0 is shared with the card
+ *  readers and the file system, which may restart it under a reception.
+ */
+#include <globals.h>
+#include "LinkLayer.h"
+
+//****************************************************************************
+//      EXTERN
+//****************************************************************************
+extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define FRAME_HDR  lenBCDMsg    // Binary length header
+#define FRAME_POLL (1*100)      // Read slice, keeps the cancel key responsive
+
+//****************************************************************************
+//         int comReadLL (void *pvSession, byte *pucDst, word usLen, long lTmo)
+//  This function is the Link Layer reader used by comRecvFrame().
+//  This function has parameters.
+//    pvSession (I-) : Link Layer session handle
+//    pucDst (-O) : Destination buffer
+//    usLen (I-) : Maximum number of bytes to read
+//    lTmo (I-) : Timeout in 10ms ticks
+//  This function has return value
+//    >0 : Number of bytes read
+//     0 : Nothing received before the timeout
+//    <0 : Link Layer error
+//****************************************************************************
+int comReadLL(void *pvSession, byte *pucDst, word usLen, long lTmo) {
+	int iNbrBytes, iRet;
+
+	iNbrBytes = LL_Receive((LL_HANDLE)pvSession, usLen, pucDst, lTmo);
+	if (iNbrBytes > 0)
+		return iNbrBytes;
+
+	iRet = LL_GetLastError((LL_HANDLE)pvSession);
+	if ((iRet == LL_ERROR_OK) || (iRet == LL_ERROR_TIMEOUT))
+		return 0;
+	return iRet;
+}
+
+//****************************************************************************
+//  int comRecvFrame (tComRead pfRead, void *pvSession, T_GL_HWIDGET hScreen,
+//                    byte *pucMsg, word usLen, byte ucDly)
+//  This function receives one length framed message.
+//   The header is read first, then exactly the announced number of bytes.
+//  This function has parameters.
+//    pfRead (I-) : Transport reader (comReadLL or transport specific)
+//    pvSession (I-) : Session handle given back to the reader
+//    hScreen (I-) : Screen checked for the cancel key (NULL: no check)
+//    pucMsg (-O) : Frame received, header included
+//    usLen (I-) : Size of pucMsg
+//    ucDly (I-) : Timeout of the whole frame (in second, 0xFF infinite)
+//  This function has return value
+//    >=0 : Number of bytes received (header included)
+//     <0 : Reception failed (LL_ERROR_TIMEOUT on timeout or cancel, see
+//          comStaCancelled(),
+//          LL_ERROR_PHYSICAL_FRAMING when the header announces no data,
+//          LL_ERROR_OUTPUT_BUFFER_TOO_SHORT when the frame is too long)
+//****************************************************************************
+int comRecvFrame(tComRead pfRead, void *pvSession, T_GL_HWIDGET hScreen, byte *pucMsg, word usLen, byte ucDly) {
+	// Local variables
+	// ***************
+	int iRet, iNbrBytes;
+	long lTimeOut, lSlice;
+	card ulEnd = 0;
+	word usWant=FRAME_HDR, usGot=0;
+
+	// Timeout setting
+	// ***************
+	lTimeOut = LL_INFINITE;
+	if(ucDly != 0xFF) {
+		ulEnd = GTL_StdTimer_GetCurrent() + ucDly*100;                // Deadline in 10ms ticks
+		lTimeOut = ucDly*1000;
+	}
+
+	if (hScreen)
+		ResetPeripherals(KEYBOARD | TSCREEN);                         // Reset peripherals FIFO
+
+	// Header then body, never asking for more than the frame
+	// *******************************************************
+	while (usGot < usWant) {
+		lSlice = FRAME_POLL;
+		if ((ucDly != 0xFF) && (lTimeOut < lSlice*10))
+			lSlice = (lTimeOut+9) / 10;                               // Never wait past the timeout
+		iNbrBytes = pfRead(pvSession, pucMsg+usGot, usWant-usGot, lSlice);
+		CHECK(iNbrBytes>=0, lblKO);
+
+		if (iNbrBytes > 0) {
+			if (usGot == 0)
+				netTimMark(netStgHost);                               // First byte: host answered
+			usGot += iNbrBytes;
+			if ((usWant == FRAME_HDR) && (usGot == FRAME_HDR)) {      // Header complete
+				usWant = (word)((pucMsg[0] << 8) | pucMsg[1]);
+				CHECK(usWant > 0, lblNoData);
+				CHECK(usWant <= usLen-FRAME_HDR, lblTooLong);
+				usWant += FRAME_HDR;
+			}
+		} else
+			CHECK(comStaCancel(hScreen)==0, lblTimeOut);              // Exit on cancel key
+
+		if ((usGot < usWant) && (ucDly != 0xFF)) {
+			lTimeOut = (long)(ulEnd - GTL_StdTimer_GetCurrent()) * 10; // On every pass: a drip fed frame times out too
+			CHECK(lTimeOut>0, lblTimeOut);                            // Exit on timeout
+		}
+	}
+
+	netTimMark(netStgRecv);
+	iRet = usGot;
+	goto lblEnd;
+
+	// Errors treatment
+	// ****************
+	lblNoData:                                                        // Header of an empty frame
+	iRet = LL_ERROR_PHYSICAL_FRAMING;
+	goto lblEnd;
+	lblTooLong:                                                       // Frame bigger than the buffer
+	iRet = LL_ERROR_OUTPUT_BUFFER_TOO_SHORT;
+	goto lblEnd;
+	lblTimeOut:                                                       // Timeout expired
+	iRet = LL_ERROR_TIMEOUT;
+	goto lblEnd;
+	lblKO:                                                            // Transport error
+	iRet = iNbrBytes;
+	goto lblEnd;
+	lblEnd:
+	return iRet;
+}
+
+//****************************************************************************
+//      int comSendLL (void *pvSession, const byte *pucMsg, word usLen)
+//  This function sends one frame on a Link Layer session kept open for
+//  several exchanges (comGprsSessionOpen, comEthSessionOpen).
+//  This function has parameters.
+//    pvSession (I-) : Link Layer session handle
+//    pucMsg (I-) : Frame to send, header included
+//    usLen (I-) : Number of bytes to send
+//  This function has return value
+//    >=0 : Number of bytes sent
+//     <0 : Transmission failed
+//****************************************************************************
+int comSendLL(void *pvSession, const byte *pucMsg, word usLen) {
+	int iRet;
+
+	iRet = LL_Send((LL_HANDLE)pvSession, usLen, (byte *)pucMsg, LL_INFINITE);
+	if (iRet != usLen)
+		iRet = LL_GetLastError((LL_HANDLE)pvSession);
+	return iRet;
+}
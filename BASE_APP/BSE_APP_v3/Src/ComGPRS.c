@@ -43,6 +43,7 @@
 #include "LinkLayer.h"
 #include "ExtraGPRS.h"
 #include "dll_wifi.h"
+#include "perf_log.h"
 
 //****************************************************************************
 //      EXTERN                                                              
@@ -53,7 +54,6 @@ extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
 //      PRIVATE CONSTANTS                                                   
 //****************************************************************************
 #define MAX_SND  2048
-#define MAX_RSP  2048
 
 #define GPRS_TIMEOUT  5*100
 #define TCPIP_TIMEOUT 10*100
@@ -624,8 +624,7 @@ static int SendGPRS(LL_HANDLE hSession, const byte *pcMsg, word usLen){
 //                           char *pcMsg, word usLen, byte ucDly)
 //  This function receives data through the GPRS layer.      
 //   - LL_ClearReceiveBuffer() : Clear receiving buffer
-//   - LL_Receive() : Wait and receive data
-//   - LL_GetLastError() : Retrieve the last error
+//   - comRecvFrame() : Wait and receive one length framed message
 //  This function has parameters.
 //    hSession (I-) : Handle of the session
 //    hScreen (I-) : Handle of the screen
@@ -637,63 +636,9 @@ static int SendGPRS(LL_HANDLE hSession, const byte *pcMsg, word usLen){
 //     <0 : Reception failed                                       
 //****************************************************************************
 static int ReceiveGPRS(LL_HANDLE hSession, T_GL_HWIDGET hScreen, byte *pcMsg, word usLen, byte ucDly){
-	// Local variables 
-	// ***************
-	int iKey;
-	long lSec, lTimeOut=LL_INFINITE;
-	int iRet, iLength=0, iNbrBytes;
-
-	// Timeout setting
-	// ***************
-	if(ucDly != 0xFF)
-		lSec = ucDly*1000;
-	else
-		lSec = LL_INFINITE;
-
-	// Receiving first block
-	// *********************
-	ResetPeripherals(KEYBOARD | TSCREEN);                                  // Reset peripherals FIFO
-	iRet = TimerStart(0, lSec);                                            // Timer0 starts
-	CHECK(iRet>=0, lblTimeOut);
-	do {
-		iNbrBytes = LL_Receive(hSession, usLen, pcMsg+iLength, 1*100);     // Check reception
-		if (iNbrBytes != 0)
-			break;                                                         // Bytes received
-		iKey = GoalGetKey(hScreen, hGoal, true, 0, false);                 // Get key pressed/touched (shortcut)
-		CHECK(iKey!=GL_KEY_CANCEL, lblTimeOut);                            // Exit on cancel key
-		if (lSec != LL_INFINITE)
-			lTimeOut = TimerGet(0);                                        // Retrieve timer value
-	} while (lTimeOut>0);
-
-	CHECK(lTimeOut!=0, lblTimeOut);                                        // Exit on timeout
-
-	iLength += iNbrBytes;
-	iRet = LL_GetLastError(hSession);
-	CHECK (iRet==LL_ERROR_OK, lblEnd);
-	if ((iNbrBytes != 0) && (iNbrBytes < usLen)){
-		// Receiving next block until timeout (Inter block 500ms)
-		// ======================================================
-		while(1) {
-			iNbrBytes = LL_Receive(hSession, usLen-iLength, pcMsg+iLength, 50);
-			iLength += iNbrBytes;
-			iRet = LL_GetLastError(hSession);
-			CHECK ((iRet==LL_ERROR_OK) || (iRet==LL_ERROR_TIMEOUT), lblEnd);
-			if ((iRet==LL_ERROR_TIMEOUT) || (iNbrBytes==0))
-				break;
-		}
-	}
-
-	iRet = iLength;
-	goto lblEnd;
-
-	// Errors treatment 
-	// ****************
-	lblTimeOut:                                                                // Timeout expired
-	iRet = LL_ERROR_TIMEOUT;
-	goto lblEnd;
-	lblEnd:
-	TimerStop(0);
-	return iRet;
+	// Length framed reception (header first, then exactly the announced bytes)
+	// ***********************************************************************
+	return comRecvFrame(comReadLL, hSession, hScreen, (byte *)pcMsg, usLen, ucDly);
 }
 
 //****************************************************************************
@@ -954,11 +899,17 @@ void ComGPRS_Prepare(void) {
 	// Local variables
 	// ***************
 	T_GL_HWIDGET hScreen=NULL;    // Screen handle
+	T_GL_HWIDGET hOwn=NULL;       // Screen created here, outside an exchange
 	char *pcStr, tcStr[128+1];
 	int iRet = 0;
 
-	hScreen = GoalCreateScreen(hGoal, txGPRS, NUMBER_OF_LINES(txGPRS), GL_ENCODING_UTF8);
-	CHECK(hScreen!=NULL, lblKO);                                    // Create screen and clear it
+	hScreen = comStaScreen();                                       // Progress screen of the exchange
+	if (hScreen == NULL) {
+		hOwn = GoalCreateScreen(hGoal, txGPRS, NUMBER_OF_LINES(txGPRS), GL_ENCODING_UTF8);
+		CHECK(hOwn!=NULL, lblKO);                                   // Create screen and clear it
+		hScreen = hOwn;
+	}
+	comStaShow(comStaAttach);
 
 	// Attachment to the GPRS network in progress
 	// ******************************************
@@ -986,8 +937,8 @@ void ComGPRS_Prepare(void) {
 	lblComKO:
 	lblEnd:
 	lblDbaErr:
-	if (hScreen)
-		GoalDestroyScreen(&hScreen);                                  // Destroy screen
+	if (hOwn)
+		GoalDestroyScreen(&hOwn);                                     // Destroy screen
 }
 
 //****************************************************************************
@@ -1009,6 +960,9 @@ int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL) {
 	char tcDisplay[50+1];
 	char TempData[5];
 	int iRet=0, iStatus=0,RetVal = -1,ret = 0;
+	int iHost = -1;
+	byte ucTried = 0;
+	card ulRtt = 0;
 	card mnuItem = 0;
 
 	memset(tcStr, 0, sizeof(tcStr));
@@ -1018,15 +972,11 @@ int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL) {
 	memset(RespBuffer, 0, sizeof(RespBuffer));
 	memset(tcIpAddress, 0, sizeof(tcIpAddress));
 
+	hScreen = comStaScreen();                                       // Progress screen, NULL in background
+
 	MAPGET(traMnuItm,TempData,lblKO);
 	dec2num(&mnuItem, TempData, 0);
 
-	hScreen = GoalCreateScreen(hGoal, txGPRS, NUMBER_OF_LINES(txGPRS), GL_ENCODING_UTF8);
-	CHECK(hScreen!=NULL, lblKO);                                    // Create screen and clear it
-
-	iRet = GoalClrScreen(hScreen, GL_COLOR_BLACK, KEY_CANCEL, false);
-	CHECK(iRet>=0, lblKO);
-
 	//
 	//	// Attachment to the GPRS network in progress
 	//	// ******************************************
@@ -1065,16 +1015,32 @@ int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL) {
 	iRet = appGet(appGprsPort, tcPort, lenGprsPort+1);                // Retrieve port number
 	CHECK(iRet>=0, lblDbaErr);
 
+	hostSelLoad(tcIpAddress, tcPort);                                 // Primary + secondary hosts
+
+	lblNextHost:
+	CHECK(comStaCancel(hScreen)==0, lblCancel);
+	iHost = hostSelPick(&ucTried, tcIpAddress, tcPort);               // Best host not tried yet
+	CHECK(iHost>=0, lblComKO);
+
+	comStaShow(comStaConnect);
 	Telium_Sprintf (tcStr, "%s|%s", tcIpAddress, tcPort);
 	hGPRS = OpenGPRS(tcStr, SSL);                                          // ** Open **
 	CHECK(hGPRS!=NULL, lblKO);
 
 	IsGPRS();
+	netTimMark(netStgAttach);
 
 	// Connect GPRS layer
 	// ==================
 	iRet = ConnectGPRS(hGPRS);                                        // ** Connect **
-	if(iRet == LL_ERROR_NETWORK_NOT_READY) { ComGPRS_Prepare(); iRet = ConnectGPRS(hGPRS); }
+	if(iRet == LL_ERROR_NETWORK_NOT_READY) { ComGPRS_Prepare(); netTimMark(netStgAttach); comStaShow(comStaConnect); iRet = ConnectGPRS(hGPRS); }
+	netTimMark(SSL ? netStgTls : netStgConnect);                      // Handshake done by LL_Connect
+	if ((iRet < 0) && (iRet != LL_ERROR_NETWORK_NOT_READY)) {         // Host side failure, try the next one
+		hostSelFail(iHost);
+		CloseGPRS(hGPRS);
+		hGPRS = NULL;
+		goto lblNextHost;
+	}
 	CHECK(iRet>=0, lblComKO);
 
 	// Clear sending/receiving buffers
@@ -1086,35 +1052,34 @@ int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL) {
 
 	// Send data through GPRS layer
 	// ============================
-	iRet = GoalClrScreen(hScreen, GL_COLOR_BLACK, KEY_CANCEL, false); // Clear screen
-	CHECK(iRet>=0, lblKO);
-
-	iRet = GoalDspLine(hScreen, 2, "Sending...", &txGPRS[1], 0, true);
-	CHECK(iRet>=0, lblKO);
+	CHECK(comStaCancel(hScreen)==0, lblCancel);                       // Last point where the request has not left
+	comStaShow(comStaSend);
 
 	/////iso message sending
+	ulRtt = GTL_StdTimer_GetCurrent();
 	iRet = SendGPRS(hGPRS, bufPtr(req), bufLen(req));              // ** Send data **
 	CHECK(iRet>=0, lblComKO);
-
-	iRet = GoalClrScreen(hScreen, GL_COLOR_BLACK, KEY_CANCEL, false); // Clear screen
-	CHECK(iRet>=0, lblKO);
+	netTimMark(netStgSend);
 
 	// Receive data through GPRS layer
 	// ===============================
-	iRet = GoalDspLine(hScreen, 2, "Receiving...", &txGPRS[4], 0, true);
-	CHECK(iRet>=0, lblKO);
+	comStaShow(comStaRecv);
 
 	buzzer(10);
 
-	iRet = ReceiveGPRS(hGPRS, hScreen,  RespBuffer, (int) bufDim(rsp), 30);     // ** Receive data **
+	iRet = ReceiveGPRS(hGPRS, hScreen,  RespBuffer, (int) bufDim(rsp), rcvTmoGet('G', tcStr));     // ** Receive data **
+	CHECK(comStaCancelled()<0, lblCancel);                            // Not the host's fault
+	if (iRet == LL_ERROR_TIMEOUT)
+		rcvTmoExpired('G', tcStr);
+	if (iRet < 0)                                                     // Request already sent, no failover
+		hostSelFail(iHost);
 	CHECK(iRet>=0, lblNoresp);
+	ulRtt = (GTL_StdTimer_GetCurrent() - ulRtt) * 10;
+	hostSelOk(iHost, ulRtt);
+	rcvTmoSample('G', tcStr, ulRtt);
 	bufApp(rsp, RespBuffer, iRet);
 
 	RetVal = iRet;
-	if (iRet > MAX_RSP) {
-		iRet = GoalDspLine(hScreen, 2, "Buffer overflow Max=512", &txGPRS[1], 0, true);
-		CHECK(iRet>=0, lblKO);
-	}
 
 	// Disconnection
 	// =============
@@ -1132,7 +1097,10 @@ int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL) {
 	// ****************
 	lblKO:                                                                // None-classified low level error
 	iRet = 0;
-	GL_Dialog_Message(hGoal, NULL, "Connection FAILED!!", GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	if (hScreen)                                                      // Background: nothing over the idle screen
+		GL_Dialog_Message(hGoal, NULL, "Connection FAILED!!", GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	else
+		perflog("GPRS connection failed");
 	goto lblEnd;
 	lblComKO:                                                             // Communication error
 	iRet = 0;
@@ -1147,19 +1115,30 @@ int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL) {
 		strcat(tcDisplay, "\n");
 		strcat(tcDisplay, LL_ErrorMsg(iStatus));                      // Link Layer status
 	}
-	if (iRet != LL_ERROR_TIMEOUT)                                     // Cancel or timeout ?
+	if (hScreen && (iRet != LL_ERROR_TIMEOUT))                        // Cancel or timeout ?
 		GL_Dialog_Message(hGoal, NULL, tcDisplay, GL_ICON_ERROR, GL_BUTTON_VALID, 3*1000);
+	if (hScreen == NULL)                                              // Background: nothing over the idle screen
+		perflog("GPRS link error");
 	goto lblEnd;
 
 	lblNoresp:  // Communication error
 	iRet = 0;
-	GL_Dialog_Message(hGoal, NULL, "NO RESPONSE", GL_ICON_ERROR, GL_BUTTON_VALID, 3*1000);
+	if (hScreen)
+		GL_Dialog_Message(hGoal, NULL, "NO RESPONSE", GL_ICON_ERROR, GL_BUTTON_VALID, 3*1000);
+	else
+		perflog("GPRS no response");
+	goto lblEnd;
+
+	lblCancel:                                                            // Cancelled by the cashier, told by the caller
 	goto lblEnd;
 
 	lblDbaErr:                                                            // Data base error
 	iRet = 0;
 	Telium_Sprintf(tcDisplay, "%s\n%s", FMG_ErrorMsg(iRet), "Software Reset Needed");
-	GL_Dialog_Message(hGoal, NULL, tcDisplay, GL_ICON_ERROR, GL_BUTTON_VALID, 3*1000);
+	if (hScreen)
+		GL_Dialog_Message(hGoal, NULL, tcDisplay, GL_ICON_ERROR, GL_BUTTON_VALID, 3*1000);
+	else
+		perflog("GPRS data base error");
 	goto lblEnd;
 	lblEnd:
 	if (hGPRS) {
@@ -1170,14 +1149,88 @@ int ComGPRS(tBuffer * req,tBuffer * rsp, word SSL) {
 		}
 	}
 	//StopGPRS();                                                       // ** Stop **
-	if (hScreen)
-		GoalDestroyScreen(&hScreen);                                  // Destroy screen
 
 	return RetVal;
 }
 
 
 
+//****************************************************************************
+//              void *comGprsSessionOpen (word SSL, char *pcHost)
+//  This function opens and connects a GPRS session kept for several
+//  exchanges (batch upload), on the best host that accepts the connection.
+//  This function has parameters.
+//    SSL (I-) : 1 for TLS
+//    pcHost (-O) : Host dialled as "ip|port" (129 bytes)
+//  This function has return value
+//    Session handle, NULL when no host could be reached
+//****************************************************************************
+void *comGprsSessionOpen(word SSL, char *pcHost) {
+	LL_HANDLE hGPRS=NULL;
+	char tcIpAddress[100+1];
+	char tcPort[100+1];
+	int iRet, iHost;
+	byte ucTried = 0;
+
+	memset(tcPort, 0, sizeof(tcPort));
+	memset(tcIpAddress, 0, sizeof(tcIpAddress));
+
+	iRet = appGet(appGprsIpRemote, tcIpAddress, lenGprsIpRemote+1);   // Retrieve remote IP
+	CHECK(iRet>=0, lblKO);
+	iRet = appGet(appGprsPort, tcPort, lenGprsPort+1);                // Retrieve port number
+	CHECK(iRet>=0, lblKO);
+
+	hostSelLoad(tcIpAddress, tcPort);                                 // Primary + secondary hosts
+
+	lblNextHost:
+	iHost = hostSelPick(&ucTried, tcIpAddress, tcPort);               // Best host not tried yet
+	CHECK(iHost>=0, lblKO);
+
+	Telium_Sprintf (pcHost, "%s|%s", tcIpAddress, tcPort);
+	hGPRS = OpenGPRS(pcHost, SSL);                                    // ** Open **
+	CHECK(hGPRS!=NULL, lblKO);
+
+	iRet = ConnectGPRS(hGPRS);                                        // ** Connect **
+	if(iRet == LL_ERROR_NETWORK_NOT_READY) { ComGPRS_Prepare(); iRet = ConnectGPRS(hGPRS); }
+	if ((iRet < 0) && (iRet != LL_ERROR_NETWORK_NOT_READY)) {         // Host side failure, try the next one
+		hostSelFail(iHost);
+		CloseGPRS(hGPRS);
+		hGPRS = NULL;
+		goto lblNextHost;
+	}
+	CHECK(iRet>=0, lblKOClose);
+
+	iRet = LL_ClearSendBuffer(hGPRS);
+	CHECK(iRet==LL_ERROR_OK, lblKODisconnect);
+	iRet = LL_ClearReceiveBuffer(hGPRS);
+	CHECK(iRet==LL_ERROR_OK, lblKODisconnect);
+
+	return hGPRS;
+
+	lblKODisconnect:
+	comGprsSessionClose(hGPRS);
+	return NULL;
+	lblKOClose:
+	CloseGPRS(hGPRS);
+	lblKO:
+	return NULL;
+}
+
+//****************************************************************************
+//              void comGprsSessionClose (void *pvSession)
+//  This function disconnects and closes a session opened by
+//  comGprsSessionOpen().
+//  This function has parameters.
+//    pvSession (I-) : Session handle (NULL: nothing done)
+//  This function has no return value
+//****************************************************************************
+void comGprsSessionClose(void *pvSession) {
+	if (pvSession == NULL)
+		return;
+	if (DisconnectGPRS((LL_HANDLE)pvSession) == LL_ERROR_OK)          // ** Disconnect **
+		CloseGPRS((LL_HANDLE)pvSession);                              // ** Close **
+}
+
 //****************************************************************************
 //                      void ComGPRSCheck (void)
 //  This function communicates through the GPRS layer.
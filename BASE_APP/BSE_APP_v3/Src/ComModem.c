@@ -552,6 +552,7 @@ static int SendModem(LL_HANDLE hSession, char *pcMsg, word usLen)
 //                           char *pcMsg, word usLen, byte ucDly)
 //  This function receives data through the modem port.      
 //   - LL_ClearReceiveBuffer() : Clear receiving buffer
+//   - comRecvFrame() : Wait and receive one length framed message (no parity)
 //   - LL_Receive() : Wait and receive data
 //   - LL_GetLastError() : Retrieve the last error
 //  This function has parameters.  
@@ -573,6 +574,11 @@ static int ReceiveModem(LL_HANDLE hSession, T_GL_HWIDGET hScreen, char *pcMsg, w
     long lSec, lTimeOut=LL_INFINITE;
     int iRet, iLength=0, iNbrBytes, iIdx;
 
+	// Length framed reception when the line carries 8 bits data
+	// *********************************************************
+	if (!xCom.parity)
+		return comRecvFrame(comReadLL, hSession, hScreen, (byte *)pcMsg, usLen, ucDly);
+
 	// Timeout setting
 	// ***************
     if(ucDly != 0xFF)  
@@ -43,6 +43,7 @@ typedef struct sComChn {
 	TLV_TREE_NODE hTransCfg;
 } tComChn;
 static tComChn com;
+static char tcSslHost[lenGprsIpRemote+lenGprsPort+1+1];   // "ip|port" dialed, key of the receive timeout
 
 
 
@@ -238,6 +239,10 @@ static int comDialSsl(void) {
 		ret = dec2num(&dPort, port, 0);
 	}
 
+	dnsCacheResolve(adr, adr, sizeof(adr));                   // Name kept when no address is known
+	memset(tcSslHost, 0, sizeof(tcSslHost));
+	Telium_Sprintf(tcSslHost, "%s|%s", adr, port);                 // Both read with their app lengths
+
 	ret = SSL_New(&com.prm.hdlSsl, com.prm.hdlProfile);
 	CHECK(ret == 0, lblKO);
 
@@ -369,6 +374,7 @@ static int SendReq(tTleParam * par, byte sta, tBuffer * req) {
 
 	ret = comSendBufSsl(bufPtr(req), bufLen(req)); //send the request
 	CHECK(ret == bufLen(req), lblKO);
+	netTimMark(netStgSend);
 
 	ret = sta += 1;
 	goto lblEnd;
@@ -381,6 +387,7 @@ static int SendReq(tTleParam * par, byte sta, tBuffer * req) {
 }
 
 static int recvRsp(tTleParam * par, byte sta,tBuffer * rsp) {
+	card ulRtt;
 	int ret,counter = 0/*,cntr_Exit = 0;
 	card totaltLength = 0;
 	byte dRsp2[1024];
@@ -390,8 +397,14 @@ static int recvRsp(tTleParam * par, byte sta,tBuffer * rsp) {
 
 	counter = counter + 2;
 
+	ulRtt = GTL_StdTimer_GetCurrent();
+	par->tmrF = rcvTmoGet('S', tcSslHost);
 	ret = comRecvBufSsl(rsp, NULL, par->tmrF);
+	if (ret <= 0)
+		rcvTmoExpired('S', tcSslHost);
 	CHECK(ret > 0, lblKO);
+	netTimMark(netStgHost);                 // Record based read: host and reception together
+	rcvTmoSample('S', tcSslHost, (GTL_StdTimer_GetCurrent() - ulRtt) * 10);
 	//	totaltLength = ret;
 
 	//	fncDisplayData_Goal("","","Please Wait...",500,0);
@@ -601,6 +614,7 @@ int ComSSL(tBuffer * req,tBuffer * rsp){
 
 	ret = sslConnect();
 	CHECK(ret >= 0, lblKO);
+	netTimMark(netStgTls);                  // TCP connection and handshake (SSL_Connect)
 
 	do {
 		memset(TLS_PositionMarker, 0, sizeof(TLS_PositionMarker));
@@ -344,8 +344,7 @@ static int SendSerial(LL_HANDLE hSession, const char *pcMsg, word usLen)
 //                           char *pcMsg, word usLen, byte ucDly)
 //  This function receives data through the serial port.      
 //   - LL_ClearReceiveBuffer() : Clear receiving buffer
-//   - LL_Receive() : Wait and receive data
-//   - LL_GetLastError() : Retrieve the last error
+//   - comRecvFrame() : Wait and receive one length framed message
 //  This function has parameters.  
 //    hSession (I-) : Handle of the session
 //    hScreen (I-) : Handle of the screen
@@ -359,66 +358,9 @@ static int SendSerial(LL_HANDLE hSession, const char *pcMsg, word usLen)
 
 static int ReceiveSerial(LL_HANDLE hSession, T_GL_HWIDGET hScreen, char *pcMsg, word usLen, byte ucDly)
 {
-	// Local variables 
-    // ***************
-    int iKey;
-    long lSec, lTimeOut=LL_INFINITE;
-    int iRet, iLength=0, iNbrBytes;
-
-	// Timeout setting
-	// ***************
-    if(ucDly != 0xFF)  
-        lSec = ucDly*1000;
-	else
-		lSec = LL_INFINITE;
-
-	// Receiving first block
-	// *********************
-	ResetPeripherals(KEYBOARD | TSCREEN);                                // Reset peripherals FIFO
-    iRet = TimerStart(0, lSec);                                          // Timer0 starts
-    CHECK(iRet>=0, lblTimeOut);
-	do
-    {
-    	iNbrBytes = LL_Receive(hSession, usLen, pcMsg+iLength, 1*100);   // Check reception
-    	if (iNbrBytes != 0)
-    		break;                                                       // Bytes received
-		iKey = GoalGetKey(hScreen, hGoal, true, 0, false);               // Get key pressed/touched (shortcut)
-		CHECK(iKey!=GL_KEY_CANCEL, lblTimeOut);                          // Exit on cancel key
-		if (lSec != LL_INFINITE)
-			lTimeOut = TimerGet(0);                                      // Retrieve timer value
-    } while (lTimeOut>0);
-
-    CHECK(lTimeOut!=0, lblTimeOut);                                      // Exit on timeout
-
-	iLength += iNbrBytes;
-	iRet = LL_GetLastError(hSession);
-	CHECK (iRet==LL_ERROR_OK, lblEnd);
-	if ((iNbrBytes != 0) && (iNbrBytes < usLen))
-	{
-		// Receiving next block until timeout (Inter block 500ms)
-		// ======================================================
-		while(1)
-		{
-			iNbrBytes = LL_Receive(hSession, usLen-iLength, pcMsg+iLength, 50);
-			iLength += iNbrBytes;
-			iRet = LL_GetLastError(hSession);
-			CHECK ((iRet==LL_ERROR_OK) || (iRet==LL_ERROR_TIMEOUT), lblEnd);
-			if ((iRet==LL_ERROR_TIMEOUT) || (iNbrBytes==0))
-				break;
-		}
-	}
-
-	iRet = iLength;
-    goto lblEnd;
-
-	// Errors treatment 
-    // ****************	
-lblTimeOut:                                                              // Timeout expired
-	iRet = LL_ERROR_TIMEOUT;
-	goto lblEnd;
-lblEnd:
-	TimerStop(0);
-    return iRet;
+	// Length framed reception (header first, then exactly the announced bytes)
+	// ***********************************************************************
+	return comRecvFrame(comReadLL, hSession, hScreen, (byte *)pcMsg, usLen, ucDly);
 }
 
 //****************************************************************************
@@ -469,6 +411,53 @@ static int CloseSerial(LL_HANDLE hSession)
     return iRet;
 }
 
+//****************************************************************************
+//         void *comSerialOpen (const char *pcInit, byte ucChn)
+//  This function opens and connects a serial port kept open by its user
+//  (cash register link), to be read with comReadLL and written with
+//  comSendLL.
+//  This function has parameters.
+//    pcInit (I-) : DPSB com channel(s) (ex: "8N1115200", see OpenSerial)
+//    ucChn (I-) : Channel, as the first byte of appSerialItem (0..3)
+//  This function has return value
+//    !NULL : Handle of the session
+//     NULL : Open or connection failed
+//****************************************************************************
+
+void *comSerialOpen(const char *pcInit, byte ucChn)
+{
+	LL_HANDLE hSession;
+
+	CHECK(ucChn<=chnComExt, lblKO);
+	hSession = OpenSerial(pcInit, (enum eChn)ucChn);
+	CHECK(hSession!=NULL, lblKO);
+	if (ConnectSerial(hSession) < 0) {
+		CloseSerial(hSession);
+		goto lblKO;
+	}
+	return (void *)hSession;
+
+	lblKO:
+	return NULL;
+}
+
+//****************************************************************************
+//                 void comSerialClose (void *pvSession)
+//  This function disconnects and deletes a port opened by comSerialOpen or
+//  comUsbOpen.
+//  This function has parameters.
+//    pvSession (I-) : Handle of the session
+//  This function has no return value
+//****************************************************************************
+
+void comSerialClose(void *pvSession)
+{
+	if (pvSession == NULL)
+		return;
+	DisconnectSerial((LL_HANDLE)pvSession);
+	CloseSerial((LL_HANDLE)pvSession);
+}
+
 //****************************************************************************
 //                      void PromptSerial (void)                            
 //  This function asks for the Serial's parameters.   
@@ -0,0 +1,199 @@
+/*
+ * ComStatus.c
+ *
+ *  Progress screen of the online exchanges. The foreground transaction
+ *  creates one screen before building the request and destroys it once the
+ *  answer is in; the transports report the stage they reach through
+ *  comStaShow() and only the status line is redrawn, where each layer used
+ *  to create, clear and destroy its own GOAL screen. Background exchanges
+ *  (reversals, advices, echo) find no screen and draw nothing.
+ *  The cancel key is polled between the stages and while the answer is
+ *  awaited. The stage reached when it was pressed tells whether the request
+ *  left: before, the transaction is simply dropped; after, the host may
+ *  have approved it and the reversal armed for it is released.
+ *  The time spent creating and destroying the screen is measured, to give
+ *  the time saved per exchange by the screens no longer created.
+ */
+#include <globals.h>
+#include "perf_log.h"
+
+//****************************************************************************
+//      EXTERN
+//****************************************************************************
+extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+static const ST_DSP_LINE txSta[] =
+{
+		{ {GL_ALIGN_LEFT, GL_ALIGN_CENTER, GL_COLOR_WHITE, GL_COLOR_BLACK, 100, FALSE, {1, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_WHITE}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}}, // Line0
+				{GL_ALIGN_LEFT, GL_ALIGN_CENTER, FALSE, 100, FALSE, {2, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_BLACK}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}} },
+				{ {GL_ALIGN_LEFT, GL_ALIGN_CENTER, GL_COLOR_WHITE, GL_COLOR_BLACK, 100, FALSE, {1, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_WHITE}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}}, // Line1
+						{GL_ALIGN_LEFT, GL_ALIGN_CENTER, FALSE, 100, FALSE, {2, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_BLACK}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}} },
+						{ {GL_ALIGN_LEFT, GL_ALIGN_CENTER, GL_COLOR_WHITE, GL_COLOR_BLACK, 100, FALSE, {1, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_WHITE}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}}, // Line2
+								{GL_ALIGN_LEFT, GL_ALIGN_CENTER, FALSE, 100, FALSE, {2, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_BLACK}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}} },
+								{ {GL_ALIGN_LEFT, GL_ALIGN_CENTER, GL_COLOR_WHITE, GL_COLOR_BLACK, 100, FALSE, {1, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_WHITE}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}}, // Line3
+										{GL_ALIGN_LEFT, GL_ALIGN_CENTER, FALSE, 100, FALSE, {2, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_BLACK}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}} },
+										{ {GL_ALIGN_LEFT, GL_ALIGN_CENTER, GL_COLOR_WHITE, GL_COLOR_BLACK, 100, FALSE, {1, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_WHITE}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}}, // Line4
+												{GL_ALIGN_LEFT, GL_ALIGN_CENTER, FALSE, 100, FALSE, {2, 0, 0, 0}, {0, 0, 0, 0, GL_COLOR_BLACK}, {0, 0, 0, 0}, {NULL, GL_FONT_STYLE_NORMAL, GL_SCALE_MEDIUM}} }
+};
+
+#define STA_LINE        2              // Status line
+#define STA_HINT        4              // Cancel hint line
+
+static const char *tzStaText[comStaEnd] = {
+		"Building Request...", "Line busy...", "Attaching...", "Connecting...", "Sending...", "Receiving..."
+};
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static T_GL_HWIDGET hSta = NULL;       // Progress screen, NULL outside a foreground exchange
+static int iStaCur = -1;               // Stage shown
+static int iStaCancel = -1;            // Stage at which cancel was pressed, -1 if not
+static card ulStaTck = 0;              // Ticks spent creating and destroying the screen
+static card ulStaPairs = 0;            // Screens created and destroyed (measured)
+static card ulStaSaved = 0;            // Screens the transports no longer create
+static card ulStaXchg = 0;             // Exchanges shown
+
+//****************************************************************************
+//                     T_GL_HWIDGET comStaOpen (void)
+//  This function creates the progress screen of a foreground exchange.
+//  This function has no parameters.
+//  This function has return value
+//    Screen handle, NULL when it could not be created
+//****************************************************************************
+T_GL_HWIDGET comStaOpen(void) {
+	card ulBeg;
+
+	comStaClose();
+	iStaCur = -1;
+	iStaCancel = -1;
+
+	ulBeg = GTL_StdTimer_GetCurrent();
+	hSta = GoalCreateScreen(hGoal, txSta, NUMBER_OF_LINES(txSta), GL_ENCODING_UTF8);
+	CHECK(hSta!=NULL, lblKO);
+	CHECK(GoalClrScreen(hSta, GL_COLOR_BLACK, KEY_CANCEL, false)>=0, lblKO);
+	ulStaTck += GTL_StdTimer_GetCurrent() - ulBeg;
+	ulStaXchg++;
+
+	GoalDspLine(hSta, STA_HINT, "Cancel to stop", &txSta[STA_HINT], 0, false);
+	ResetPeripherals(KEYBOARD | TSCREEN);                           // A key left from the entry is not a cancel
+	return hSta;
+
+	lblKO:
+	if (hSta)
+		GoalDestroyScreen(&hSta);
+	hSta = NULL;
+	return NULL;
+}
+
+//****************************************************************************
+//                       T_GL_HWIDGET comStaScreen (void)
+//  This function gives the progress screen to a transport that used to
+//  create its own; each call is counted as one screen saved.
+//  This function has no parameters.
+//  This function has return value
+//    Screen handle, NULL outside a foreground exchange
+//****************************************************************************
+T_GL_HWIDGET comStaScreen(void) {
+	if (hSta)
+		ulStaSaved++;
+	return hSta;
+}
+
+//****************************************************************************
+//                       void comStaShow (int iSta)
+//  This function is the status callback of the transports: it redraws the
+//  status line when the stage changes. Without a screen it does nothing.
+//  This function has parameters.
+//    iSta (I-) : Stage reached (comStaBuild..comStaRecv)
+//  This function has no return value
+//****************************************************************************
+void comStaShow(int iSta) {
+	if ((hSta == NULL) || (iSta == iStaCur) || (iSta < 0) || (iSta >= comStaEnd))
+		return;
+	iStaCur = iSta;
+	GoalDspLine(hSta, STA_LINE, (char *)tzStaText[iSta], &txSta[STA_LINE], 0, true);
+}
+
+//****************************************************************************
+//                  int comStaCancel (T_GL_HWIDGET hScreen)
+//  This function polls the cancel key without waiting. On the progress
+//  screen the cancel stays until the screen is closed.
+//  This function has parameters.
+//    hScreen (I-) : Screen to poll (the progress screen, or the transport's)
+//  This function has return value
+//    1 : Exchange cancelled
+//    0 : Go on (always without a screen: background exchange)
+//****************************************************************************
+int comStaCancel(T_GL_HWIDGET hScreen) {
+	if (hScreen == NULL)
+		return 0;
+	if ((hScreen == hSta) && (iStaCancel >= 0))
+		return 1;
+	if (GoalGetKey(hScreen, hGoal, true, 0, false) != GL_KEY_CANCEL)
+		return 0;
+
+	if (hScreen == hSta) {
+		iStaCancel = (iStaCur >= 0) ? iStaCur : comStaBuild;
+		perflog((iStaCancel < comStaSend) ? "COMSTA cancelled before send" : "COMSTA cancelled after send");
+	}
+	return 1;
+}
+
+//****************************************************************************
+//                       int comStaCancelled (void)
+//  This function tells whether the exchange in progress was cancelled, and
+//  where.
+//  This function has no parameters.
+//  This function has return value
+//    -1 : Not cancelled, or no progress screen
+//    >=0 : Stage shown when cancel was pressed (< comStaSend: request not sent)
+//****************************************************************************
+int comStaCancelled(void) {
+	if (hSta == NULL)
+		return -1;
+	return iStaCancel;
+}
+
+//****************************************************************************
+//                        void comStaClose (void)
+//  This function destroys the progress screen.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void comStaClose(void) {
+	card ulBeg;
+
+	if (hSta == NULL)
+		return;
+	ulBeg = GTL_StdTimer_GetCurrent();
+	GoalDestroyScreen(&hSta);
+	ulStaTck += GTL_StdTimer_GetCurrent() - ulBeg;
+	ulStaPairs++;
+	hSta = NULL;
+}
+
+//****************************************************************************
+//          int comStaCost (card *pulScreen, card *pulSaved)
+//  This function gives the measured cost of one screen (create, clear and
+//  destroy) and the time saved per exchange by the screens the transports
+//  no longer create.
+//  This function has parameters.
+//    pulScreen (-O) : ms per screen
+//    pulSaved (-O) : ms saved per exchange
+//  This function has return value
+//    Exchanges measured, 0 when none yet
+//****************************************************************************
+int comStaCost(card *pulScreen, card *pulSaved) {
+	*pulScreen = 0;
+	*pulSaved = 0;
+	if ((ulStaPairs == 0) || (ulStaXchg == 0))
+		return 0;
+
+	*pulScreen = (ulStaTck * 10) / ulStaPairs;
+	*pulSaved = (*pulScreen * ulStaSaved) / ulStaXchg;
+	return (int)ulStaXchg;
+}
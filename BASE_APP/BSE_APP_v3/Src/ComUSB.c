@@ -193,8 +193,7 @@ static int SendUSB(LL_HANDLE hSession, const char *pcMsg, word usLen) {
 //                        char *pcMsg, word usLen, byte ucDly)
 //  This function receives data through the USB port.      
 //       LL_ClearReceiveBuffer() : Clear receiving buffer
-//       LL_Receive() : Wait and receive data
-//       LL_GetLastError() : Retrieve the last error
+//       comRecvFrame() : Wait and receive one length framed message
 //  This function has parameters.
 //    hSession (I-) : Handle of the session
 //    hScreen (I-) : Handle of the screen
@@ -207,63 +206,9 @@ static int SendUSB(LL_HANDLE hSession, const char *pcMsg, word usLen) {
 //****************************************************************************
 
 static int ReceiveUSB(LL_HANDLE hSession, T_GL_HWIDGET hScreen, char *pcMsg, word usLen, byte ucDly) {
-	// Local variables 
-	// ***************
-	int iKey;
-	long lSec, lTimeOut=LL_INFINITE;
-	int iRet, iLength=0, iNbrBytes;
-
-	// Timeout setting
-	// ***************
-	if(ucDly != 0xFF)
-		lSec = ucDly*1000;
-	else
-		lSec = LL_INFINITE;
-
-	// Receiving first block
-	// *********************
-	ResetPeripherals(KEYBOARD | TSCREEN);                                  // Reset peripherals FIFO
-	iRet = TimerStart(0, lSec);                                            // Timer0 starts
-	CHECK(iRet>=0, lblTimeOut);
-	do {
-		iNbrBytes = LL_Receive(hSession, usLen, pcMsg+iLength, 1*100);     // Check reception
-		if (iNbrBytes != 0)
-			break;                                                         // Bytes received
-		iKey = GoalGetKey(hScreen, hGoal, true, 0, false);                 // Get key pressed/touched (shortcut)
-		CHECK(iKey!=GL_KEY_CANCEL, lblTimeOut);                            // Exit on cancel key
-		if (lSec != LL_INFINITE)
-			lTimeOut = TimerGet(0);                                        // Retrieve timer value
-	} while (lTimeOut>0);
-
-	CHECK(lTimeOut!=0, lblTimeOut);                                        // Exit on timeout
-
-	iLength += iNbrBytes;
-	iRet = LL_GetLastError(hSession);
-	CHECK (iRet==LL_ERROR_OK, lblEnd);
-	if ((iNbrBytes != 0) && (iNbrBytes < usLen)) {
-		// Receiving next block until timeout (Inter block 500ms)
-		// ======================================================
-		while(1) {
-			iNbrBytes = LL_Receive(hSession, usLen-iLength, pcMsg+iLength, 50);
-			iLength += iNbrBytes;
-			iRet = LL_GetLastError(hSession);
-			CHECK ((iRet==LL_ERROR_OK) || (iRet==LL_ERROR_TIMEOUT), lblEnd);
-			if ((iRet==LL_ERROR_TIMEOUT) || (iNbrBytes==0))
-				break;
-		}
-	}
-
-	iRet = iLength;
-	goto lblEnd;
-
-	// Errors treatment 
-	// ****************
-	lblTimeOut:                                                                // Configuration failed
-	iRet = LL_ERROR_TIMEOUT;
-	goto lblEnd;
-	lblEnd:
-	TimerStop(0);
-	return iRet;
+	// Length framed reception (header first, then exactly the announced bytes)
+	// ***********************************************************************
+	return comRecvFrame(comReadLL, hSession, hScreen, (byte *)pcMsg, usLen, ucDly);
 }
 
 //****************************************************************************
@@ -314,6 +259,31 @@ static int CloseUSB(LL_HANDLE hSession)
 	return iRet;
 }
 
+//****************************************************************************
+//                        void *comUsbOpen (void)
+//  This function opens and connects the USB port for a user keeping it
+//  open (cash register link). Closed by comSerialClose.
+//  This function has no parameters.
+//  This function has return value
+//    !NULL : Handle of the session
+//     NULL : Open or connection failed
+//****************************************************************************
+
+void *comUsbOpen(void) {
+	LL_HANDLE hSession;
+
+	hSession = OpenUSB();
+	CHECK(hSession!=NULL, lblKO);
+	if (ConnectUSB(hSession) < 0) {
+		CloseUSB(hSession);
+		goto lblKO;
+	}
+	return (void *)hSession;
+
+	lblKO:
+	return NULL;
+}
+
 //****************************************************************************
 //                      void ComUSB(void)                            
 //  This function communicates through USB port.   
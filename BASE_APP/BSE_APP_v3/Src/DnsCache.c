@@ -0,0 +1,181 @@
+/*
+ * DnsCache.c
+ *
+ *  Resolver cache for the hosts configured by name. Without it the link
+ *  layer resolves the name on each connection, a full round trip more on
+ *  GPRS. An address is kept for appDnsTtl seconds, refreshed ahead of its
+ *  expiry by the background task, and the last good address is still used
+ *  when the resolver fails.
+ */
+#include <globals.h>
+#include "IP_.h"
+#include "perf_log.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define DNS_CACHE_MAX     4            // Primary, secondary, spares
+#define DNS_TTL_DFT       300          // Seconds, when appDnsTtl is not set
+#define DNS_RETRY         (30*100)     // Failed lookup not retried before 30s (10ms ticks)
+#define DNS_TIMEOUT       5000         // Lookup timeout (ms)
+#define DNS_IDLE          (60*60*100)  // Name unused for an hour: no more background refresh
+#define DNS_IP_LEN        15           // xxx.xxx.xxx.xxx
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	char tcName[lenGprsIpRemote+1];
+	char tcIp[DNS_IP_LEN+1];           // Last good address, empty if none
+	card ulExpire;                     // Tick of the next lookup
+	card ulUsed;                       // Tick of the last use (replacement)
+	byte ucStale;                      // Last lookup failed, tcIp is the last good one
+} tDnsCache;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tDnsCache tzDns[DNS_CACHE_MAX];
+
+static int dnsNumeric(const char *pcHost) {
+	if (*pcHost == 0)
+		return 0;
+	while (*pcHost) {
+		if (((*pcHost < '0') || (*pcHost > '9')) && (*pcHost != '.'))
+			return 0;
+		pcHost++;
+	}
+	return 1;
+}
+
+static card dnsTtl(void) {
+	char tcTtl[6 + 1];
+	int iTtl = 0;
+
+	memset(tcTtl, 0, sizeof(tcTtl));
+	if (appGet(appDnsTtl, tcTtl, sizeof(tcTtl)) >= 0)
+		iTtl = atoi(tcTtl);
+	if (iTtl <= 0)
+		iTtl = DNS_TTL_DFT;
+	return (card)iTtl * 100;
+}
+
+// Ask the resolver of the IP stack. 1 when pcIp is filled.
+static int dnsLookup(const char *pcName, char *pcIp) {
+	unsigned int uiAddr = 0;
+	byte *pucAddr = (byte *)&uiAddr;   // Network order
+
+	if (DNS_GetIpAddress((char *)pcName, &uiAddr, DNS_TIMEOUT) != 0)
+		return 0;
+	if (uiAddr == 0)
+		return 0;
+	Telium_Sprintf(pcIp, "%d.%d.%d.%d", pucAddr[0], pucAddr[1], pucAddr[2], pucAddr[3]);
+	return 1;
+}
+
+static tDnsCache *dnsFind(const char *pcName, card ulNow) {
+	tDnsCache *pxOld = NULL;
+	int iIdx;
+
+	for (iIdx=0; iIdx<DNS_CACHE_MAX; iIdx++) {
+		if (strcmp(tzDns[iIdx].tcName, pcName) == 0)
+			return &tzDns[iIdx];
+		if ((pxOld != NULL) && (pxOld->tcName[0] == 0))
+			continue;                                  // Free slot found, keep it
+		if ((pxOld == NULL) || (tzDns[iIdx].tcName[0] == 0) || ((long)(tzDns[iIdx].ulUsed - pxOld->ulUsed) < 0))
+			pxOld = &tzDns[iIdx];
+	}
+
+	memset(pxOld, 0, sizeof(*pxOld));                  // Free or least recently used slot
+	strncpy(pxOld->tcName, pcName, lenGprsIpRemote);
+	pxOld->ulExpire = ulNow;
+	return pxOld;
+}
+
+// Lookup of an entry; on failure the last good address stays.
+static void dnsUpdate(tDnsCache *pxDns) {
+	char tcIp[DNS_IP_LEN+1];
+
+	memset(tcIp, 0, sizeof(tcIp));
+	if (dnsLookup(pxDns->tcName, tcIp)) {
+		strcpy(pxDns->tcIp, tcIp);
+		pxDns->ulExpire = GTL_StdTimer_GetCurrent() + dnsTtl();
+		pxDns->ucStale = 0;
+		return;
+	}
+	pxDns->ulExpire = GTL_StdTimer_GetCurrent() + DNS_RETRY;
+	pxDns->ucStale = 1;
+	perflog("DNS lookup failed");
+}
+
+//****************************************************************************
+//      int dnsCacheResolve (const char *pcHost, char *pcIp, word usDim)
+//  This function gives the address to dial for a host. A numeric address
+//  is returned as is; a name is looked up only when its cached address
+//  expired, and not while the resolver is failing and a last good address
+//  is known. The lookup time goes to the DNS stage of the net timing.
+//  This function has parameters.
+//    pcHost (I-) : Host name or IP address
+//    pcIp (-O) : IP address to dial
+//    usDim (I-) : Size of pcIp
+//  This function has return value
+//     1 : Address fresh (or numeric)
+//     0 : Lookup failed, last good address given
+//    -1 : No address known, pcIp untouched
+//****************************************************************************
+int dnsCacheResolve(const char *pcHost, char *pcIp, word usDim) {
+	tDnsCache *pxDns;
+	card ulNow = GTL_StdTimer_GetCurrent();
+
+	if (dnsNumeric(pcHost) || (strlen(pcHost) > lenGprsIpRemote)) {
+		if (pcIp != pcHost) {
+			strncpy(pcIp, pcHost, usDim - 1);
+			pcIp[usDim - 1] = 0;
+		}
+		return 1;
+	}
+
+	pxDns = dnsFind(pcHost, ulNow);
+	pxDns->ulUsed = ulNow;
+	if (((long)(pxDns->ulExpire - ulNow) <= 0) && !(pxDns->ucStale && pxDns->tcIp[0])) {
+		dnsUpdate(pxDns);                              // Resolver down: retries left to the background
+		netTimCharge(netStgDns, ulNow);
+	}
+
+	if ((pxDns->tcIp[0] == 0) || (strlen(pxDns->tcIp) >= usDim))
+		return -1;
+	strcpy(pcIp, pxDns->tcIp);
+	if (pxDns->ucStale) {
+		perflog("DNS last good address used");
+		return 0;
+	}
+	return 1;
+}
+
+//****************************************************************************
+//                     void dnsCacheRefresh (void)
+//  This function looks up again, in the background, the names in use whose
+//  address expires within the next quarter of the TTL, so a transaction
+//  seldom waits for the resolver. Called from the store and forward task.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void dnsCacheRefresh(void) {
+	card ulNow = GTL_StdTimer_GetCurrent();
+	card ulAhead = dnsTtl() / 4;
+	int iIdx;
+
+	for (iIdx=0; iIdx<DNS_CACHE_MAX; iIdx++) {
+		if (tzDns[iIdx].tcName[0] == 0)
+			continue;
+		if ((card)(ulNow - tzDns[iIdx].ulUsed) > DNS_IDLE)
+			continue;
+		if ((long)(tzDns[iIdx].ulExpire - ulNow) > (long)ulAhead)
+			continue;
+		CHECK(onlBgTake() > 0, lblEnd);              // Foreground transaction under way
+		dnsUpdate(&tzDns[iIdx]);
+		onlBgGive();
+	}
+
+	lblEnd:;
+}
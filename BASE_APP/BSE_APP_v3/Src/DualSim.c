@@ -172,113 +172,77 @@ static int DualSim_SwitchSIM(int slot){
 	return ret;
 }
 
-int AutoSwitchSimSlots(void){/*
-	T_EGPRS_GET_INFORMATION xInfo;
-	int switchNow = 0, iRet = 0;
-	Telium_File_t *hGprs = NULL;
-	int SimCheckDone = 0;
-	byte SwitchLoops = 0;
-	char TLS_Enabled[10];
+// SIM in use (0..1), -1 when unknown
+static int DualSim_CurrentSlot(void){
+	int iSlot = -1;
 
-	memset(TLS_Enabled, 0, sizeof(TLS_Enabled));
+	if (gprs_get_sim_slot(&iSlot) != CR_ENTRY_OK)
+		return -1;
+	return iSlot;
+}
 
-	CommsGetChannel(TLS_Enabled);
+/**
+ * Outcome of an exchange on GPRS, kept in the link history of the SIM in use
+ * (SimPred.c). Times are 0 when not measured.
+ */
+void DualSimNote(card ulAttach, card ulConnect, int iOk){
+	byte CommRoute = 0;
+	int iSlot;
+
+	mapGetByte(appCommRoute, CommRoute);
+	if (CommRoute != 'G')
+		return;
+	iSlot = DualSim_CurrentSlot();
+	simPredSample(iSlot, ulAttach, ulConnect, iOk, GTL_StdTimer_GetCurrent() * 10);
+}
 
-	if (strncmp(TLS_Enabled, "G", 1) != 0){
-		return 1;
-	}
+/**
+ * Background check of the SIM in use, about once a minute.
+ * \n The radio level feeds the link history; a missing SIM counts as a failed
+ * \n exchange. When the history says the other SIM will serve the next
+ * \n transactions clearly better, it is selected now, while the terminal is
+ * \n idle, instead of after a failed transaction. No display: the cashier may
+ * \n be using the terminal.
+ */
+int AutoSwitchSimSlots(void){
+	T_EGPRS_GET_INFORMATION xInfo;
+	Telium_File_t *hGprs = NULL;
+	byte CommRoute = 0;
+	int iCur, iBest, iRet = 0;
+	card ulNow;
 
-	//	if (fncTMSConnectionSession() == 0) { //check if the TMS is already doing something
-	//		return 1;
-	//	}
+	mapGetByte(appCommRoute, CommRoute);
+	CHECK(CommRoute == 'G', lblEnd);
+	iCur = DualSim_CurrentSlot();
+	CHECK(iCur >= 0, lblEnd);
+	ulNow = GTL_StdTimer_GetCurrent() * 10;
 
-	fncWriteStatusOfConnection('1');//Notify TMS transaction is in session
-	lblSimCheck:
-	////---- check if the terminal network or sim card is inserted in the SIM slot ----
 	hGprs = Telium_Stdperif((char*)"DGPRS", NULL);
-
 	iRet = gprs_GetInformation(hGprs,&xInfo,sizeof(xInfo));
-	CHECK(iRet==0, lblEnd);
-
-	// GPRS check report
-	// =================
-	switch (xInfo.start_report) {
-	case EGPRS_REPORT_SIM_NOT_PRESENT: //No sim card
-		switchNow = 1;
-		break;
-	}
-	if (xInfo.sim_status == EGPRS_SIM_NOT_INSERTED) {
-		switchNow = 1;
-	}
-	if ( xInfo.radio_level < 2) {
-		switchNow = 1;
+	if (iRet == 0) {
+		if ((xInfo.start_report == EGPRS_REPORT_SIM_NOT_PRESENT) || (xInfo.sim_status == EGPRS_SIM_NOT_INSERTED))
+			simPredSample(iCur, 0, 0, 0, ulNow);
+		else
+			simPredRadio(iCur, xInfo.radio_level, ulNow);
 	}
 
-	if (!switchNow) {
-
-		if ( xInfo.status_gprs == EGPRS_GPRS_DISCONNECTED) {
-			TaskInitiateGPRS();
-		} else if ( xInfo.network_connection == EGPRS_GSM_NETWORK_DISCONNECT) {
-			TaskInitiateGPRS();
-		} else if ( xInfo.status_gprs == EGPRS_GPRS_PDP_READY) {
-			TaskInitiateGPRS();
-		}else if ( xInfo.network_connection == EGPRS_GSM_NETWORK_NORMAL_CONNECT) {
+	iBest = simPredChoose(iCur, ulNow);
+	if (iBest == iCur) {
+		if ((iRet == 0) && ((xInfo.status_gprs == EGPRS_GPRS_DISCONNECTED) || (xInfo.network_connection == EGPRS_GSM_NETWORK_DISCONNECT)))
 			TaskInitiateGPRS();
-		}
-
-		//Check if port is down
-		if (checkOlineServer() == 0) {
-			switchNow = 1;
-		}
+		goto lblEnd;
 	}
 
-	//Check if the lapsed time is three minutes only to swap sim cards
-	if (switchNow) {
-		mapGetByte(appSwitchLoops, SwitchLoops);
-		if (SwitchLoops == 3) {
-			switchNow = 1;
-			SwitchLoops = 0;
-		}else{
-			switchNow = 0;
-		}
-		SwitchLoops++;
-		mapPutByte(appSwitchLoops, SwitchLoops);
-	}
-
-	//check if you need a switch
-	if (switchNow) {
-		GL_Dialog_Message(hGoal, NULL, "SIM Switching in Progress Please wait!!!", GL_ICON_NONE, GL_BUTTON_ALL, GL_TIME_SECOND);
-
-		DualSim_SwitchSIM(0);
-		tmrPause(3);
-
-		//make sure GPRS is started
-		//		ComGPRS_Prepare(); //Hangs the system
+	CHECK(onlBgTake() > 0, lblEnd);                 // Never under a transaction
+	iRet = gprs_select_sim_slot(iBest);
+	if (iRet == CR_ENTRY_OK) {
+		CurrentSimSlot = iBest;
+		simPredSwitched(ulNow);
 		TaskInitiateGPRS();
-
-		GL_Dialog_Message(hGoal, NULL, "SIM Switching in Progress Please wait!!!", GL_ICON_NONE, GL_BUTTON_ALL, GL_TIME_SECOND);
-
-		tmrPause(5);
-
-		//After switching check again for network
-		if ((SimCheckDone == 1) && (xInfo.sim_status != EGPRS_SIM_NOT_INSERTED)){
-			goto lblEnd;
-		}
-		switchNow = 0;
-		SimCheckDone = 1;
-		goto lblSimCheck;
-	} else {
-		if ( xInfo.status_gprs == EGPRS_GPRS_DISCONNECTED) {
-			TaskInitiateGPRS();
-		} else if ( xInfo.network_connection == EGPRS_GSM_NETWORK_DISCONNECT) {
-			TaskInitiateGPRS();
-		}
 	}
+	onlBgGive();
 
 	lblEnd:
-	//return the idle image just in case
-	IdleImageDisplay();
-	fncWriteStatusOfConnection('0');//Notify TMS transaction is in session*/
 	return 1;
 }
 
@@ -287,6 +251,7 @@ void ManualSwitchSimSlots(int SelectedSlot){
 
 	//Swap the SIM card
 	DualSim_SwitchSIM(SelectedSlot);
+	simPredSwitched(GTL_StdTimer_GetCurrent() * 10);   // The merchant's choice holds for a while
 
 	//make sure GPRS is started
 	ComGPRS_Prepare();
@@ -54,48 +54,22 @@ static void __EMV_ServicesEmv_MenuChooseLanguage(TLV_TREE_NODE inputTlvTree);
 ////  variables ///////////////////////////////////////////
 
 //// Functions //////////////////////////////////////////////////
-static int get_Bin_AID_Data(char * DBFieldName,unsigned char * BinData){
-	char AID_selected[20];
-	char Statement[256];
-	char DataResponse[256];
-	int aid_len = 0;
-	int ret = 0;
+// Column DBFieldName of the aid table for the AID selected, from the
+// parameters kept in RAM (see sqlite_Aid_Get); "" when not found.
+static int get_AID_Data(const char * DBFieldName, char * DataResponse, int iDim){
+	char AID_selected[lenAID + 1];
 
-	memset(Statement, 0, sizeof(Statement));
-	memset(DataResponse, 0, sizeof(DataResponse));
 	memset(AID_selected, 0, sizeof(AID_selected));
+	mapGet(traAID, AID_selected, lenAID);
 
-	AID_selected[0] = '%';
-	mapGet(traAID, &AID_selected[1], lenAID);
-	aid_len = strlen(AID_selected);
-	AID_selected[aid_len] = '%';
-
-	Telium_Sprintf(Statement, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", DBFieldName, AID_selected);
-
-	Sqlite_Run_Statement(Statement,DataResponse);
-
-	if (strlen(DataResponse) < 1) {
-		/// ----  here we use partial AID matching
-		char AID_selected_Temp[20];
-
-		memset(Statement, 0, sizeof(Statement));
-		memset(DataResponse, 0, sizeof(DataResponse));
-		memset(AID_selected, 0, sizeof(AID_selected));
-		memset(AID_selected_Temp, 0, sizeof(AID_selected_Temp));
-
-		AID_selected[0] = '%';
-		mapGet(traAID, AID_selected_Temp, lenAID);
-		strncat(&AID_selected[1], AID_selected_Temp, 10);
-		aid_len = strlen(AID_selected);
-		AID_selected[aid_len] = '%';
-
-		Telium_Sprintf(Statement, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", DBFieldName, AID_selected);
-
-		Sqlite_Run_Statement(Statement,DataResponse);
+	return sqlite_Aid_Get(DBFieldName, AID_selected, DataResponse, iDim);
+}
 
-	}
+static int get_Bin_AID_Data(char * DBFieldName,unsigned char * BinData){
+	char DataResponse[256];
+	int ret = 0;
 
-	ret = strlen(DataResponse);
+	ret = get_AID_Data(DBFieldName, DataResponse, sizeof(DataResponse));
 
 	if(ret == 0)
 		return 0;
@@ -108,48 +82,12 @@ static int get_Bin_AID_Data(char * DBFieldName,unsigned char * BinData){
 
 
 static int get_Hex_AID_Data(char * DBFieldName, char * HexData, word SaveTo){
-	char AID_selected[20];
-	char Statement[256];
 	char DataResponse[256];
-	int aid_len = 0;
 	int ret = 0;
 
-	memset(Statement, 0, sizeof(Statement));
-	memset(DataResponse, 0, sizeof(DataResponse));
-	memset(AID_selected, 0, sizeof(AID_selected));
-
-	AID_selected[0] = '%';
-	mapGet(traAID, &AID_selected[1], lenAID);
-	aid_len = strlen(AID_selected);
-	AID_selected[aid_len] = '%';
-
-	Telium_Sprintf(Statement, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", DBFieldName, AID_selected);
-
-	Sqlite_Run_Statement(Statement,DataResponse);
+	ret = get_AID_Data(DBFieldName, DataResponse, sizeof(DataResponse));
 
-	if (strlen(DataResponse) < 1) {
-		/// ----  here we use partial AID matching
-		char AID_selected_Temp[20];
-
-		memset(Statement, 0, sizeof(Statement));
-		memset(DataResponse, 0, sizeof(DataResponse));
-		memset(AID_selected, 0, sizeof(AID_selected));
-		memset(AID_selected_Temp, 0, sizeof(AID_selected_Temp));
-
-		AID_selected[0] = '%';
-		mapGet(traAID, AID_selected_Temp, lenAID);
-		strncat(&AID_selected[1], AID_selected_Temp, 10);
-		aid_len = strlen(AID_selected);
-		AID_selected[aid_len] = '%';
-
-		Telium_Sprintf(Statement, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", DBFieldName, AID_selected);
-
-		Sqlite_Run_Statement(Statement,DataResponse);
-
-	}
-
-	mapPut(SaveTo, DataResponse, strlen(DataResponse));
-	ret = strlen(DataResponse);
+	mapPut(SaveTo, DataResponse, ret);
 
 	if(ret == 0)
 		return 0;
@@ -160,10 +98,7 @@ static int get_Hex_AID_Data(char * DBFieldName, char * HexData, word SaveTo){
 }
 
 int mapGet_AID_Data(word emvkey ,unsigned char * BinData){
-	char AID_selected[lenAID + 3];
-	char Statement[256];
 	char DataResponse[256];
-	int aid_len = 0;
 	char DBFieldName[100];
 
 	memset(DBFieldName, 0, sizeof(DBFieldName));
@@ -214,39 +149,7 @@ int mapGet_AID_Data(word emvkey ,unsigned char * BinData){
 		break;
 	}
 
-	memset(Statement, 0, sizeof(Statement));
-	memset(DataResponse, 0, sizeof(DataResponse));
-	memset(AID_selected, 0, sizeof(AID_selected));
-
-	AID_selected[0] = '%';
-	mapGet(traAID, &AID_selected[1], lenAID);
-	aid_len = strlen(AID_selected);
-	AID_selected[aid_len] = '%';
-
-	Telium_Sprintf(Statement, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", DBFieldName, AID_selected);
-
-	Sqlite_Run_Statement(Statement,DataResponse);
-
-	if (strlen(DataResponse) < 1) {
-		/// ----  here we use partial AID matching
-		char AID_selected_Temp[lenAID + 3];
-
-		memset(Statement, 0, sizeof(Statement));
-		memset(DataResponse, 0, sizeof(DataResponse));
-		memset(AID_selected, 0, sizeof(AID_selected));
-		memset(AID_selected_Temp, 0, sizeof(AID_selected_Temp));
-
-		AID_selected[0] = '%';
-		mapGet(traAID, AID_selected_Temp, lenAID);
-		strncat(&AID_selected[1], AID_selected_Temp, 10);
-		aid_len = strlen(AID_selected);
-		AID_selected[aid_len] = '%';
-
-		Telium_Sprintf(Statement, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", DBFieldName, AID_selected);
-
-		Sqlite_Run_Statement(Statement,DataResponse);
-
-	}
+	get_AID_Data(DBFieldName, DataResponse, sizeof(DataResponse));
 
 	hex2bin(BinData, DataResponse, 0);
 
@@ -0,0 +1,138 @@
+/*
+ * EchoSched.c
+ *
+ *  Network management echo (0800) sent by the background task while the
+ *  terminal is idle, so a dead link or host is found before a sale needs
+ *  it. The echo goes through the normal route, its round trip feeds the
+ *  host selection scores, and a host whose back-off expired is re-probed.
+ */
+#include <globals.h>
+#include "perf_log.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define ECHO_TICK_MIN      (60*100)    // One minute in 10ms ticks
+#define ECHO_GPRS_SHIFT    3           // GPRS: period doubles up to 8 times the setting
+#define ECHO_LEN_MAX       64
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static card ulLastLink = 0;            // Tick of the last exchange with a host
+static byte ucLinkSeen = 0;            // ulLastLink is meaningful
+static byte ucGprsShift = 0;           // Current GPRS back-off
+
+//****************************************************************************
+//                    void echoSchedTraffic (void)
+//  This function records that the link just carried an exchange; a real
+//  transaction proves the link as well as an echo would.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void echoSchedTraffic(void) {
+	ulLastLink = GTL_StdTimer_GetCurrent();
+	ucLinkSeen = 1;
+}
+
+// 0800 with the fields of the echo test menu: 3 (990000), 24 (NII), 41 (TID).
+static int echoBuild(tBuffer *pxReq) {
+	char tcNii[lenNII + 5];
+	char tcTid[lenTID + 1];
+	byte tucNii[2];
+	int iRet;
+
+	memset(tcNii, 0, sizeof(tcNii));
+	memset(tcTid, 0, sizeof(tcTid));
+
+	iRet = appGet(appNII, tcNii, sizeof(tcNii));
+	CHECK(iRet>=0, lblKO);
+	fmtPad(tcNii, -(lenNII + 1), '0');
+	hex2bin(tucNii, tcNii, 0);
+
+	iRet = appGet(appTID, tcTid, sizeof(tcTid));
+	CHECK(iRet>=0, lblKO);
+	fmtPad(tcTid, lenTID, ' ');
+
+	iRet = bufApp(pxReq, (byte *)"\x08\x00", 2);                            // MTI
+	CHECK(iRet>0, lblKO);
+	iRet = bufApp(pxReq, (byte *)"\x20\x00\x01\x00\x00\x80\x00\x00", 8);    // Bitmap 3, 24, 41
+	CHECK(iRet>0, lblKO);
+	iRet = bufApp(pxReq, (byte *)"\x99\x00\x00", 3);                        // Processing code
+	CHECK(iRet>0, lblKO);
+	iRet = bufApp(pxReq, tucNii, 2);
+	CHECK(iRet>0, lblKO);
+	iRet = bufApp(pxReq, (byte *)tcTid, lenTID);
+	CHECK(iRet>0, lblKO);
+
+	return bufLen(pxReq);
+	lblKO:
+	return -1;
+}
+
+//****************************************************************************
+//                      void echoSchedRun (void)
+//  This function sends an echo when the link has been idle for the period
+//  set in appEchoPeriod (minutes, 0 disables the echo), or when a failed
+//  host is due for a re-probe. On GPRS the period doubles after each good
+//  echo (up to 8 times) to limit the data used, and falls back on failure.
+//  It never competes with a foreground transaction for the link.
+//  Called from the store and forward task, about once a minute.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void echoSchedRun(void) {
+	char tcPeriod[6 + 1];
+	byte ucRoute = 0;
+	tBuffer bReq, bRsp;
+	static byte dReq[ECHO_LEN_MAX];              // Static: the task stack is small
+	static byte dRsp[(1024 * 3) + 3];
+	card ulNow, ulPeriod;
+	int iProbe, iPeriod, iRet, iOk = 0;
+
+	memset(tcPeriod, 0, sizeof(tcPeriod));
+	iRet = appGet(appEchoPeriod, tcPeriod, sizeof(tcPeriod));
+	CHECK(iRet>=0, lblEnd);
+	iPeriod = atoi(tcPeriod);
+	CHECK(iPeriod>0, lblEnd);
+	mapGetByte(appCommRoute, ucRoute);
+
+	ulNow = GTL_StdTimer_GetCurrent();
+	ulPeriod = (card)iPeriod * ECHO_TICK_MIN;
+	if (ucRoute == 'G')
+		ulPeriod <<= ucGprsShift;
+
+	iProbe = hostSelProbeDue();
+	if ((iProbe < 0) && ucLinkSeen && ((long)(ulNow - ulLastLink) < (long)ulPeriod))
+		goto lblEnd;                             // Link proven recently
+
+	iRet = onlBgTake();
+	CHECK(iRet>0, lblEnd);                       // Foreground transaction under way
+
+	memset(dReq, 0, sizeof(dReq));
+	memset(dRsp, 0, sizeof(dRsp));
+	bufInit(&bReq, dReq, sizeof(dReq));
+	bufInit(&bRsp, dRsp, sizeof(dRsp));
+	iRet = echoBuild(&bReq);
+	CHECK(iRet>0, lblGive);
+
+	if (iProbe >= 0)
+		hostSelForce(iProbe);                    // Dial the host due for a re-probe
+	iRet = onlSendRaw(&bReq, &bRsp);
+	hostSelForce(-1);                            // Transport without host selection: drop it
+	iOk = (iRet >= 2) && (bufPtr(&bRsp)[0] == 0x08) && (bufPtr(&bRsp)[1] == 0x10);
+	DualSimNote(0, 0, iOk);                      // Not timed: outcome only
+
+	lblGive:
+	onlBgGive();
+	echoSchedTraffic();                          // Next echo one period from now, whatever the outcome
+	if (iOk) {
+		if ((ucRoute == 'G') && (ucGprsShift < ECHO_GPRS_SHIFT))
+			ucGprsShift++;
+	} else {
+		ucGprsShift = 0;
+		perflog("ECHO failed");
+	}
+
+	lblEnd:;
+}
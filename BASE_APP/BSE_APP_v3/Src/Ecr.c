@@ -0,0 +1,424 @@
+/*
+ * Ecr.c
+ *
+ *  Cash register (ECR) link on a serial or USB port (appEcrPort). The
+ *  register sends the amount, the terminal runs the sale as if it had been
+ *  keyed and sends the result back.
+ *  Frame: STX, length of the data (2 bytes binary), data, ETX, LRC (XOR of
+ *  the bytes from the length to ETX). Each frame is answered by ACK, or by
+ *  NAK when the length, ETX or LRC is wrong.
+ *  Data, in ASCII:
+ *    S ref(8) amount(12)                          sale, register -> terminal
+ *    R ref(8) rsp(2) stan(6) auth(6) amount(12)   result, terminal -> register
+ *    E any                                        echo, sent back as is
+ *  rsp is the host response code, or XB (busy, nothing done), XF (request
+ *  not understood) or XC (no answer from the host, or cancelled).
+ *  One task owns the port: each frame is read straight into its place in
+ *  the receive buffer, checked and parsed there, and the amount goes to the
+ *  transaction from it. Being the only writer, the task acknowledges without
+ *  waiting for anyone; the echo is sent back from the receive buffer itself.
+ *  The sale runs in a task of its own, forked per request, and leaves its
+ *  result in the send buffer. Only the results are sent again by the
+ *  terminal (on NAK, or without ACK within ECR_ACK_TMO); echo and refusals
+ *  are repeated by the register asking again. A sale asked again with the
+ *  reference of the last one (ACK lost) is not run twice: its result is
+ *  sent again.
+ */
+#include <globals.h>
+#include "perf_log.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define ECR_STX        0x02
+#define ECR_ETX        0x03
+#define ECR_ACK        0x06
+#define ECR_NAK        0x15
+
+#define ECR_HDR        3               // STX + length
+#define ECR_DATA_MAX   256
+#define ECR_FRAME_MAX  (ECR_HDR + ECR_DATA_MAX + 2)
+
+#define ECR_REF        8               // Register reference of the sale
+#define ECR_SALE_AMT   (1 + ECR_REF)
+#define ECR_SALE_LEN   (ECR_SALE_AMT + lenAmt)
+#define ECR_RES_RSP    (1 + ECR_REF)
+#define ECR_RES_STAN   (ECR_RES_RSP + 2)
+#define ECR_RES_AUT    (ECR_RES_STAN + lenSTAN)
+#define ECR_RES_AMT    (ECR_RES_AUT + lenAutCod)
+#define ECR_RES_LEN    (ECR_RES_AMT + lenAmt)
+
+#define ECR_TRIES      3               // Sends of a result
+#define ECR_ACK_TMO    100             // Wait for the ACK of a result (10ms ticks)
+#define ECR_CHR_TMO    20              // Wait between two bytes of a frame
+#define ECR_POLL       1               // Read slice while a sale runs: a result ready waits at most this long
+#define ECR_IDLE       50              // Read slice otherwise (the bytes received end it at once)
+#define ECR_REOPEN     500             // Wait before opening a failed port again
+
+enum {                                 // Sale asked by the register
+	ecrIdle,
+	ecrRunning,
+	ecrDone                            // Result in tucTx, to send
+};
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static void *pvEcr = NULL;             // Port session
+static byte ucTaskOn = 0;              // Receive task forked
+static byte tucRx[ECR_FRAME_MAX];      // Frame received, parsed in place
+static byte tucTx[ECR_FRAME_MAX];      // Result of the last sale
+static word usTxLen = 0;
+static int iTxTry = -1;                // Sends of tucTx, -1 when acknowledged or given up
+static card ulTxTck = 0;               // Time of the last send
+static byte ucTxLast = 0;              // Last frame sent was tucTx: an ACK is for it
+static char tcRef[ECR_REF];            // Reference of the last sale
+static volatile byte ucSale = ecrIdle;
+static word usSaleTask = 0xFFFF;       // Task running the sale
+
+static char ecrPort(void) {
+	char tcPort[1 + 1];
+
+	memset(tcPort, 0, sizeof(tcPort));
+	if (appGet(appEcrPort, tcPort, sizeof(tcPort)) < 0)
+		return 0;
+	if (((tcPort[0] >= '0') && (tcPort[0] <= '3')) || (tcPort[0] == 'U'))
+		return tcPort[0];
+	return 0;
+}
+
+static void *ecrOpen(char cPort) {
+	char tcInit[lenSerialInit + 1];
+
+	if (cPort == 'U')
+		return comUsbOpen();
+
+	memset(tcInit, 0, sizeof(tcInit));
+	if (appGet(appEcrInit, tcInit, sizeof(tcInit)) < 0)
+		return NULL;
+	return comSerialOpen(tcInit, (byte)(cPort - '0'));
+}
+
+static void ecrClose(void) {
+	perflog("ECR port closed");
+	comSerialClose(pvEcr);
+	pvEcr = NULL;
+}
+
+static byte ecrLrc(const byte *pucDat, word usLen) {
+	byte ucLrc = 0;
+
+	while (usLen--)
+		ucLrc ^= *pucDat++;
+	return ucLrc;
+}
+
+// Frame the data already in place after the header; gives the frame length.
+static word ecrSeal(byte *pucFrm, word usLen) {
+	pucFrm[0] = ECR_STX;
+	pucFrm[1] = (byte)(usLen >> 8);
+	pucFrm[2] = (byte)usLen;
+	pucFrm[ECR_HDR + usLen] = ECR_ETX;
+	pucFrm[ECR_HDR + usLen + 1] = ecrLrc(&pucFrm[1], usLen + 3);
+	return ECR_HDR + usLen + 2;
+}
+
+static void ecrWrite(const byte *pucFrm, word usLen) {
+	if (comSendLL(pvEcr, pucFrm, usLen) < 0)
+		ecrClose();
+	ucTxLast = (pucFrm == tucTx);
+}
+
+static void ecrCtl(byte ucCtl) {
+	if (comSendLL(pvEcr, &ucCtl, 1) < 0)
+		ecrClose();
+}
+
+// Exactly usLen bytes, each one within lTmo of the previous.
+static int ecrRead(byte *pucDst, word usLen, long lTmo) {
+	int iGot = 0, iRet;
+
+	while (iGot < usLen) {
+		iRet = comReadLL(pvEcr, &pucDst[iGot], usLen - iGot, lTmo);
+		if (iRet <= 0)
+			return iRet;
+		iGot += iRet;
+	}
+	return iGot;
+}
+
+// Rest of the frame whose STX is in tucRx[0], read in place.
+static int ecrFrame(void) {
+	word usLen;
+	int ret;
+
+	ret = ecrRead(&tucRx[1], 2, ECR_CHR_TMO);
+	CHECK(ret >= 0, lblLink);
+	CHECK(ret == 2, lblBad);
+	usLen = (word)((tucRx[1] << 8) | tucRx[2]);
+	CHECK((usLen > 0) && (usLen <= ECR_DATA_MAX), lblBad);
+
+	ret = ecrRead(&tucRx[ECR_HDR], usLen + 2, ECR_CHR_TMO);
+	CHECK(ret >= 0, lblLink);
+	CHECK(ret == usLen + 2, lblBad);
+	CHECK(tucRx[ECR_HDR + usLen] == ECR_ETX, lblBad);
+	CHECK(tucRx[ECR_HDR + usLen + 1] == ecrLrc(&tucRx[1], usLen + 3), lblBad);
+	return usLen;
+
+	lblBad:
+	while (comReadLL(pvEcr, tucRx, sizeof(tucRx), ECR_CHR_TMO) > 0);   // Rest of the bad frame
+	return -1;
+	lblLink:
+	return -2;
+}
+
+static void ecrFld(byte *pucDst, const char *pcSrc, int iLen, char cPad) {
+	int iSrc = strlen(pcSrc);
+
+	if (iSrc > iLen)
+		iSrc = iLen;
+	memset(pucDst, cPad, iLen);
+	if (cPad == '0')                                   // Numeric: right justified
+		memcpy(&pucDst[iLen - iSrc], pcSrc, iSrc);
+	else
+		memcpy(pucDst, pcSrc, iSrc);
+}
+
+static void ecrResult(const char *pcRsp, const char *pcStan, const char *pcAut, const char *pcAmt) {
+	byte *pucDat = &tucTx[ECR_HDR];
+
+	pucDat[0] = 'R';
+	memcpy(&pucDat[1], tcRef, ECR_REF);
+	ecrFld(&pucDat[ECR_RES_RSP], pcRsp, 2, ' ');
+	ecrFld(&pucDat[ECR_RES_STAN], pcStan, lenSTAN, ' ');
+	ecrFld(&pucDat[ECR_RES_AUT], pcAut, lenAutCod, ' ');
+	ecrFld(&pucDat[ECR_RES_AMT], pcAmt, lenAmt, '0');
+	usTxLen = ecrSeal(tucTx, ECR_RES_LEN);
+	ucSale = ecrDone;
+}
+
+// Answer a sale not run, in place of its request: the reference and the amount asked stay where they are.
+static void ecrRefuse(word usLen, const char *pcRsp) {
+	byte *pucDat = &tucRx[ECR_HDR];
+
+	perflog((pcRsp[1] == 'B') ? "ECR busy" : "ECR bad request");
+	if (usLen == ECR_SALE_LEN) {
+		memmove(&pucDat[ECR_RES_AMT], &pucDat[ECR_SALE_AMT], lenAmt);
+	} else {
+		memset(&pucDat[1], ' ', ECR_REF);
+		memset(&pucDat[ECR_RES_AMT], '0', lenAmt);
+	}
+	pucDat[0] = 'R';
+	memcpy(&pucDat[ECR_RES_RSP], pcRsp, 2);
+	memset(&pucDat[ECR_RES_STAN], ' ', lenSTAN + lenAutCod);
+	ecrWrite(tucRx, ecrSeal(tucRx, ECR_RES_LEN));
+}
+
+static void ecrSend(void) {
+	if (iTxTry >= ECR_TRIES) {                         // Kept: asked again, it is sent again
+		perflog("ECR result not acknowledged");
+		iTxTry = -1;
+		return;
+	}
+	if (iTxTry > 0)
+		perflog("ECR result sent again");
+	ecrWrite(tucTx, usTxLen);
+	ulTxTck = GTL_StdTimer_GetCurrent();
+	iTxTry++;
+}
+
+static word EcrSaleTask(void) {
+	char tcMnu[lenMnu + 1];
+
+	usSaleTask = Telium_CurrentTask();
+	num2dec(tcMnu, mnuSale, 0);
+	mapPutStr(traMnuItm, tcMnu);                       // As the menu sets it: reqBuild and the log read it
+	MenuProcessingSelect(mnuSale);                     // traAmt set: the amount is not asked
+	if (ucSale == ecrRunning)                          // Ended without reaching ecrSaleEnd()
+		ecrResult("XC", "", "", "");
+	usSaleTask = 0xFFFF;
+	return 0;
+}
+
+static void ecrSale(word usLen) {
+	byte *pucDat = &tucRx[ECR_HDR];
+	byte *pucAmt = &pucDat[ECR_SALE_AMT];
+	t_topstack *hTsk = NULL;
+	byte dum1;
+	int dum2 = 0, iIdx, iSkip = 0;
+
+	if (usLen != ECR_SALE_LEN) {
+		ecrRefuse(usLen, "XF");
+		return;
+	}
+	for (iIdx = 0; iIdx < lenAmt; iIdx++) {
+		if ((pucAmt[iIdx] < '0') || (pucAmt[iIdx] > '9')) {
+			ecrRefuse(usLen, "XF");
+			return;
+		}
+	}
+	while ((iSkip < lenAmt) && (pucAmt[iSkip] == '0'))
+		iSkip++;
+	if (iSkip == lenAmt) {
+		ecrRefuse(usLen, "XF");
+		return;
+	}
+
+	if (memcmp(&pucDat[1], tcRef, ECR_REF) == 0) {     // Asked again: the ACK was lost
+		perflog("ECR sale repeated");
+		if ((ucSale == ecrIdle) && (usTxLen > 0))
+			iTxTry = 0;                                // Its result once more; running: sent when done
+		return;
+	}
+	if ((ucSale != ecrIdle) || (isApp_Already_in_Session() != 0)) {
+		ecrRefuse(usLen, "XB");
+		return;
+	}
+
+	CHECK(mapPut(traAmt, pucAmt + iSkip, (word)(lenAmt - iSkip)) >= 0, lblKO); // Straight from the frame
+	ComputeTotAmt();
+	memcpy(tcRef, &pucDat[1], ECR_REF);
+	iTxTry = -1;                                       // A new reference: the previous result got there
+	usTxLen = 0;
+	ucSale = ecrRunning;
+	hTsk = Telium_Fork(EcrSaleTask, &dum1, dum2);
+	CHECK(hTsk!=NULL, lblKO);
+	return;
+
+	lblKO:
+	ucSale = ecrIdle;
+	memset(tcRef, 0, sizeof(tcRef));
+	ecrRefuse(usLen, "XB");
+}
+
+static void ecrDispatch(word usLen) {
+	switch (tucRx[ECR_HDR]) {
+	case 'E':
+		ecrWrite(tucRx, ECR_HDR + usLen + 2);          // The frame itself, LRC included
+		break;
+	case 'S':
+		ecrSale(usLen);
+		break;
+	default:
+		perflog("ECR unknown message");                // Acknowledged: well framed, ignored
+		break;
+	}
+}
+
+static word EcrTask(void) {
+	byte ucChr;
+	char cPort;
+	int iLen, ret;
+
+	while (1) {
+		if (pvEcr == NULL) {
+			cPort = ecrPort();
+			if (cPort == 0)                            // Link switched off
+				break;
+			pvEcr = ecrOpen(cPort);
+			if (pvEcr == NULL) {
+				Telium_Ttestall(0, ECR_REOPEN);
+				continue;
+			}
+		}
+
+		if (ucSale == ecrDone) {                       // Result of the sale task
+			ucSale = ecrIdle;
+			iTxTry = 0;
+		}
+		if ((iTxTry == 0) || ((iTxTry > 0) && (GTL_StdTimer_GetCurrent() - ulTxTck >= ECR_ACK_TMO)))
+			ecrSend();
+		if (pvEcr == NULL)
+			continue;
+
+		ret = comReadLL(pvEcr, &ucChr, 1, ((ucSale != ecrIdle) || (iTxTry >= 0)) ? ECR_POLL : ECR_IDLE);
+		if (ret < 0) {
+			ecrClose();
+			continue;
+		}
+		if (ret == 0)
+			continue;
+
+		switch (ucChr) {
+		case ECR_ACK:
+			if (ucTxLast)
+				iTxTry = -1;
+			break;
+		case ECR_NAK:
+			if (ucTxLast && (iTxTry > 0))
+				ecrSend();
+			break;
+		case ECR_STX:
+			tucRx[0] = ucChr;
+			iLen = ecrFrame();
+			if (iLen == -2) {
+				ecrClose();
+			} else if (iLen < 0) {
+				perflog("ECR NAK sent");
+				ecrCtl(ECR_NAK);
+			} else {
+				ecrCtl(ECR_ACK);
+				if (pvEcr)
+					ecrDispatch((word)iLen);
+			}
+			break;
+		default:                                       // Noise between two frames
+			break;
+		}
+	}
+
+	ucTaskOn = 0;
+	return 0;                                          // Kill the ECR task
+}
+
+//****************************************************************************
+//                          void ecrStart (void)
+//  This function forks the task of the cash register link when a port is
+//  set in appEcrPort and the task is not running yet.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void ecrStart(void) {
+	t_topstack *hTsk = NULL;
+	byte dum1;
+	int dum2 = 0;
+
+	if (ucTaskOn || (ecrPort() == 0))
+		return;
+
+	hTsk = Telium_Fork(EcrTask, &dum1, dum2);
+	CHECK(hTsk!=NULL, lblKO);
+	ucTaskOn = 1;
+
+	lblKO:;
+}
+
+//****************************************************************************
+//                         void ecrSaleEnd (void)
+//  This function takes the result of a sale asked by the cash register,
+//  before the transaction data are reset. Other transactions are ignored.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void ecrSaleEnd(void) {
+	char tcRsp[lenRspCod + 1];
+	char tcStan[lenSTAN + 1];
+	char tcAut[lenAutCod + 1];
+	char tcAmt[lenTotAmt + 1];
+
+	if ((ucSale != ecrRunning) || (Telium_CurrentTask() != usSaleTask))
+		return;
+
+	memset(tcRsp, 0, sizeof(tcRsp));
+	memset(tcStan, 0, sizeof(tcStan));
+	memset(tcAut, 0, sizeof(tcAut));
+	memset(tcAmt, 0, sizeof(tcAmt));
+	mapGet(traRspCod, tcRsp, lenRspCod);
+	mapGet(traSTAN, tcStan, lenSTAN);
+	mapGet(traAutCod, tcAut, lenAutCod);
+	mapGet(traTotAmt, tcAmt, lenTotAmt);
+
+	if (tcRsp[0] == 0)                                 // No answer, or stopped before sending
+		strcpy(tcRsp, "XC");
+	ecrResult(tcRsp, tcStan, tcAut, tcAmt);
+}
@@ -1179,6 +1179,14 @@ int CLESS_ServiceManager_AfterReset(NO_SEGMENT appliId, S_TRANSOUT *paramOut) {
 	//	hSemS = OSL_Semaphore_Create("SEM_S", 0, OSL_OPEN_CREATE, OSL_SECURITY_SHARED);     // Create a semaphore object (security shared)
 	//	hSemS2 = OSL_Semaphore_Create("SEM_S2", 0, OSL_OPEN_CREATE, OSL_SECURITY_SHARED);   // Create a second semaphore object used for mutex (security shared)
 
+	// Reversals armed when the terminal went down are due
+	// ***************************************************
+	revQueueRecover();
+
+	// Cash register link, when a port is set
+	// **************************************
+	ecrStart();
+
 	// Fork a task used for IAM
 	// ************************
 	usMainTaskNbr = Telium_CurrentTask();          // Retrieve main task number
@@ -2405,8 +2413,11 @@ int time_function(NO_SEGMENT no, void *p1, void *p2) {
 				//fncAutoSettlementChecker();
 
 				TaskSimSlot();
+
+				TaskStoreForward();      // Drain the reversal and advice queues
 			}
 		}
+		ecrStart();                      // Cash register port set by a parameter download
 		if(LocalDisplay == 1){
 			Telium_Fclose(hDsp);                    // Close "display" peripheral
 			hDsp=NULL;
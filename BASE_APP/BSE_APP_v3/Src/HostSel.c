@@ -0,0 +1,250 @@
+/*
+ * HostSel.c
+ *
+ *  Host selection between the primary and secondary acquirer endpoints.
+ *  Each endpoint keeps a smoothed round trip time and a failure count;
+ *  the transports ask for the best candidate, report the outcome, and a
+ *  failed host is parked for a back-off period before it is probed again.
+ */
+#include <globals.h>
+#include "perf_log.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define HOST_MAX           2
+#define HOST_RTT_INIT      2000        // Assumed RTT (ms) before any sample
+#define HOST_FAIL_PENALTY  5000        // Score added per consecutive failure (ms)
+#define HOST_FAIL_MAX      8
+#define HOST_BACKOFF_MIN   (30*100)    // First back-off (10ms ticks)
+#define HOST_BACKOFF_MAX   (10*60*100) // Back-off ceiling (10ms ticks)
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	char tcIp[lenGprsIpRemote+1];
+	char tcPort[lenGprsPort+1];
+	card ulRtt;                        // Smoothed RTT in ms
+	byte ucSampled;                    // At least one RTT sample taken
+	byte ucFail;                       // Consecutive failures
+	card ulRetry;                      // Tick before which the host is parked
+} tHostSel;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tHostSel tzHost[HOST_MAX];
+static byte ucHostNbr = 0;
+static int iHostForce = -1;            // Host the next pick must return (re-probe)
+
+static int hostSelParked(const tHostSel *pxHost, card ulNow) {
+	if (pxHost->ucFail == 0)
+		return 0;
+	return ((long)(pxHost->ulRetry - ulNow) > 0);
+}
+
+static card hostSelScore(const tHostSel *pxHost) {
+	return pxHost->ulRtt + (card)pxHost->ucFail * HOST_FAIL_PENALTY;
+}
+
+static void hostSelSet(byte ucIdx, const char *pcIp, const char *pcPort) {
+	tHostSel *pxHost = &tzHost[ucIdx];
+
+	if ((strcmp(pxHost->tcIp, pcIp) == 0) && (strcmp(pxHost->tcPort, pcPort) == 0))
+		return;                                        // Same endpoint, keep its history
+
+	memset(pxHost, 0, sizeof(*pxHost));
+	strncpy(pxHost->tcIp, pcIp, lenGprsIpRemote);
+	strncpy(pxHost->tcPort, pcPort, lenGprsPort);
+	pxHost->ulRtt = HOST_RTT_INIT;
+}
+
+static int hostSelValid(const char *pcIp, const char *pcPort) {
+	if ((pcIp[0] == 0) || (strcmp(pcIp, "null") == 0))
+		return 0;
+	if ((pcPort[0] == 0) || (atoi(pcPort) == 0))
+		return 0;
+	return 1;
+}
+
+//****************************************************************************
+//          int hostSelLoad (const char *pcIp, const char *pcPort)
+//  This function loads the endpoint table: the primary host is given by the
+//  calling transport, the secondary one is read from the app parameters.
+//  Statistics of an endpoint are kept as long as its address is unchanged.
+//  This function has parameters.
+//    pcIp (I-) : Primary host IP address
+//    pcPort (I-) : Primary host port
+//  This function has return value
+//    Number of usable hosts
+//****************************************************************************
+int hostSelLoad(const char *pcIp, const char *pcPort) {
+	char tcIp[lenGprsIpRemote+1];
+	char tcPort[lenGprsPort+1];
+	int iRet;
+
+	ucHostNbr = 0;
+	if (hostSelValid(pcIp, pcPort))
+		hostSelSet(ucHostNbr++, pcIp, pcPort);
+
+	memset(tcIp, 0, sizeof(tcIp));
+	memset(tcPort, 0, sizeof(tcPort));
+	iRet = appGet(appHostIpSecondary, tcIp, lenGprsIpRemote+1);
+	CHECK(iRet>=0, lblEnd);
+	iRet = appGet(appHostPortSecondary, tcPort, lenGprsPort+1);
+	CHECK(iRet>=0, lblEnd);
+
+	if (hostSelValid(tcIp, tcPort) && ((ucHostNbr == 0) || (strcmp(tcIp, pcIp) != 0) || (strcmp(tcPort, pcPort) != 0)))
+		hostSelSet(ucHostNbr++, tcIp, tcPort);
+
+	lblEnd:
+	return ucHostNbr;
+}
+
+//****************************************************************************
+//     int hostSelPick (byte *pucTried, char *pcIp, char *pcPort)
+//  This function returns the best host not tried yet during this exchange.
+//  Hosts in back-off are skipped while a healthy one remains; when all of
+//  them are parked, the one whose back-off ends first is re-probed.
+//  A host configured by name is given by its cached address (DnsCache.c).
+//  This function has parameters.
+//    pucTried (IO) : Bit mask of the hosts already tried (0 on first call)
+//    pcIp (-O) : Host IP address (lenGprsIpRemote+1)
+//    pcPort (-O) : Host port (lenGprsPort+1)
+//  This function has return value
+//    >=0 : Index of the host to dial
+//     <0 : No host left
+//****************************************************************************
+int hostSelPick(byte *pucTried, char *pcIp, char *pcPort) {
+	card ulNow = GTL_StdTimer_GetCurrent();
+	int iIdx, iBest = -1, iParked = -1;
+
+	if ((iHostForce >= 0) && (iHostForce < ucHostNbr) && !(*pucTried & (1 << iHostForce))) {
+		iBest = iHostForce;
+		iHostForce = -1;
+		goto lblPick;
+	}
+	iHostForce = -1;
+
+	for (iIdx=0; iIdx<ucHostNbr; iIdx++) {
+		if (*pucTried & (1 << iIdx))
+			continue;
+		if (hostSelParked(&tzHost[iIdx], ulNow)) {
+			if ((iParked < 0) || ((long)(tzHost[iIdx].ulRetry - tzHost[iParked].ulRetry) < 0))
+				iParked = iIdx;
+			continue;
+		}
+		if ((iBest < 0) || (hostSelScore(&tzHost[iIdx]) < hostSelScore(&tzHost[iBest])))
+			iBest = iIdx;
+	}
+
+	if (iBest < 0)
+		iBest = iParked;
+	if (iBest < 0)
+		return -1;
+
+	lblPick:
+	if (iBest != 0)
+		perflog("HOSTSEL use secondary");
+	if (tzHost[iBest].ucFail != 0)
+		perflog("HOSTSEL re-probe");
+
+	*pucTried |= (byte)(1 << iBest);
+	if (dnsCacheResolve(tzHost[iBest].tcIp, pcIp, lenGprsIpRemote+1) < 0)
+		strcpy(pcIp, tzHost[iBest].tcIp);              // No address known: the link layer resolves the name
+	strcpy(pcPort, tzHost[iBest].tcPort);
+	return iBest;
+}
+
+//****************************************************************************
+//            void hostSelOk (int iIdx, card ulRtt)
+//  This function records a successful exchange with a host and folds the
+//  measured round trip into its smoothed RTT (1/8 weight, as TCP does).
+//  This function has parameters.
+//    iIdx (I-) : Host index returned by hostSelPick
+//    ulRtt (I-) : Measured round trip time in ms
+//  This function has no return value
+//****************************************************************************
+void hostSelOk(int iIdx, card ulRtt) {
+	tHostSel *pxHost;
+
+	if ((iIdx < 0) || (iIdx >= ucHostNbr))
+		return;
+
+	pxHost = &tzHost[iIdx];
+	if (pxHost->ucFail != 0)
+		perflog("HOSTSEL host recovered");
+	pxHost->ucFail = 0;
+	pxHost->ulRetry = 0;
+
+	if (pxHost->ucSampled == 0) {
+		pxHost->ulRtt = ulRtt;
+		pxHost->ucSampled = 1;
+	} else
+		pxHost->ulRtt = (pxHost->ulRtt * 7 + ulRtt) / 8;
+}
+
+//****************************************************************************
+//                   void hostSelFail (int iIdx)
+//  This function records a failed exchange with a host and parks it for an
+//  exponential back-off (30s doubling up to 10 minutes).
+//  This function has parameters.
+//    iIdx (I-) : Host index returned by hostSelPick
+//  This function has no return value
+//****************************************************************************
+void hostSelFail(int iIdx) {
+	tHostSel *pxHost;
+	card ulBackOff;
+
+	if ((iIdx < 0) || (iIdx >= ucHostNbr))
+		return;
+
+	pxHost = &tzHost[iIdx];
+	if (pxHost->ucFail < HOST_FAIL_MAX)
+		pxHost->ucFail++;
+
+	ulBackOff = HOST_BACKOFF_MIN << (pxHost->ucFail - 1);
+	if (ulBackOff > HOST_BACKOFF_MAX)
+		ulBackOff = HOST_BACKOFF_MAX;
+	pxHost->ulRetry = GTL_StdTimer_GetCurrent() + ulBackOff;
+
+	if (iIdx == 0) {
+		perflog("HOSTSEL primary failed");
+	} else {
+		perflog("HOSTSEL secondary failed");
+	}
+}
+
+//****************************************************************************
+//                    int hostSelProbeDue (void)
+//  This function returns a failed host whose back-off is over. Such a host
+//  keeps its failure penalty in the score and would not be chosen while
+//  another one works, so the echo scheduler probes it on purpose.
+//  This function has no parameters.
+//  This function has return value
+//    >=0 : Index of the host to probe
+//     <0 : No host to probe
+//****************************************************************************
+int hostSelProbeDue(void) {
+	card ulNow = GTL_StdTimer_GetCurrent();
+	int iIdx;
+
+	for (iIdx=0; iIdx<ucHostNbr; iIdx++) {
+		if ((tzHost[iIdx].ucFail != 0) && !hostSelParked(&tzHost[iIdx], ulNow))
+			return iIdx;
+	}
+	return -1;
+}
+
+//****************************************************************************
+//                   void hostSelForce (int iIdx)
+//  This function makes the next hostSelPick return the given host first,
+//  whatever its score. The outcome is reported as usual.
+//  This function has parameters.
+//    iIdx (I-) : Host index returned by hostSelProbeDue
+//  This function has no return value
+//****************************************************************************
+void hostSelForce(int iIdx) {
+	iHostForce = iIdx;
+}
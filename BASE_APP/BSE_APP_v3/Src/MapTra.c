@@ -231,6 +231,9 @@ static const ST_TRANS_ROW tzTra[traEnd-traBeg] = {
 		{ traBillerRef,                     50,                        ""}, // Reference or name of person making the payment
 		{ traSurchargeAmt,                  50,                        ""}, // Reference or name of person making the payment
 		{ traBillerPaymentDetails,          2048,                      ""}, // Reference or name of person making the payment
+
+		{ traNetTiming,                     lenNetTim,                 ""}, // Per stage timing of the online exchange (ms)
+		{ traAdviceBuild,                   2,                         ""}, // Request built for the advice queue
 };
 
 static const char zTraTab[] = "traTSLTab.par";
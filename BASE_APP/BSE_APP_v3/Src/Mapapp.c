@@ -183,6 +183,28 @@ static const ST_PARAM_ROW tzApp[appEnd-appBeg] = {
 		{ appBillerSurcharge,             6,                            "0" },
 		{ appTerminalMode,                6,                            "" },
 
+		///HOST SELECTION
+		{ appHostIpSecondary,             lenGprsIpRemote,              "" },
+		{ appHostPortSecondary,           lenGprsPort,                  "" },
+
+		///ECHO SCHEDULER
+		{ appEchoPeriod,                  6,                            "5" },
+
+		///DNS CACHE
+		{ appDnsTtl,                      6,                            "300" },
+
+		///RECEIVE TIMEOUT
+		{ appRcvTmoMin,                   3,                            "30" },
+		{ appRcvTmoMax,                   3,                            "60" },
+
+		///BATCH UPLOAD
+		{ appBatchWindow,                 2,                            "4" },
+		{ appBatchUpAck,                  lenTID + 1 + 10,              "" },
+
+		///CASH REGISTER
+		{ appEcrPort,                     1,                            "" },
+		{ appEcrInit,                     lenSerialInit,                "8N1115200" },
+
 };
 
 static const char zAppTab[] = "appTSLTab.par";
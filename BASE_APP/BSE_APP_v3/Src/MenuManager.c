@@ -115,219 +115,224 @@ static const char *appMenuContent[] = {
 		NULL
 };
 
+//// Menu tree //////////////////////////////////////////////////
+
+// Menu item as defined, written into AppMenus by Generate_Menu_Content
+typedef struct {
+	word Id;                   // Menu item, mnuXxx
+	const char *Name;          // Text shown
+	word Parent;               // Menu item holding it, 0 for the main menu
+	byte Hidden;               // 1 when not shown
+	byte Secure;               // 1 when protected by a password
+	byte Level;                // Password asked, see fncSecurityPassword
+	const char *DrCr;          // "D" debit, "C" credit, " " neither
+	const char *Icon;          // Icon of the icon menu
+} tMnuDef;
+
+// Menus written on a new software or a reset of the terminal; the items of
+// a menu are shown in the order of the table.
+static const tMnuDef tzMnuDef[] = {
+#ifdef ICONMENU
+		// Customer menu
+		{mnuCustomer, "Transaction>        ", 0, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/customers.png"},
+		{mnuSale, "Sale             ", mnuCustomer, 0, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/purchasing.png"},
+		{mnuSaleCB, "Sale + CASHBACK  ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/purchasecb.png"},
+		{mnuDeposit, "Deposit          ", mnuCustomer, 1, 0, 1, "C", "file://flash/HOST/TU.TAR/icones/deposit.png"},
+		{mnuWithdrawal, "Withdrawal       ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/withdrawal.png"},
+		{mnuPreaut, "Preauth          ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/preauth.png"},
+		{mnuCompletion, "Completion       ", mnuCustomer, 0, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/completion.png"},
+		{mnuBalanceEnquiry, "Balance Inq      ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/balanceinquiry.png"},
+		{mnuMiniStatement, "Mini stat        ", mnuCustomer, 1, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/ministatement.png"},
+		{mnuRefund, "Refund           ", mnuCustomer, 0, 1, 1, "C", "file://flash/HOST/TU.TAR/icones/refund.png"},
+		{mnuBiller, "Pay Bill         ", mnuCustomer, 0, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/agent.png"},
+		{mnuOffline, "Offline          ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/offline.png"},
+		{mnuVoid, "Void             ", mnuCustomer, 0, 0, 1, "C", "file://flash/HOST/TU.TAR/icones/void.png"},
+		{mnuAdjust, "Adjust           ", mnuCustomer, 1, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/adjust.png"},
+		{mnuReversal, "Reversal         ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/reversal.png"},
+		{mnuLogOn, "Logon           ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/logon.png"},
+		{mnuEchoTest, "Echo Test        ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/echotest.png"},
+		{mnuCustSettlement, "Settlement       ", mnuCustomer, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/settlement.png"},
+
+		// Merchant menu
+		{mnuMerchant, "Merchant>        ", 0, 0, 1, 2, " ", "file://flash/HOST/TU.TAR/icones/merchant.png"},
+		{mnuSettlement, "Settlement       ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/settlement.png"},
+		{mnuDetailedReport, "Detailed rpt     ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/report.png"},
+		{mnuSummaryReport, "Summary rpt      ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/summaryreport.png"},
+		{mnuDuplicateReceipt, "Dupl Receipt     ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/detailreport.png"},
+		{mnuReprintReceipt, "Reprint Receipt  ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/detailreport.png"},
+		{mnuAdmChgPwd, "Admin Pass       ", mnuMerchant, 0, 0, 5, " ", "file://flash/HOST/TU.TAR/icones/adminpwd.png"},
+		{mnuMrcChgPwd, "Merch Pass       ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/merchantpwd.png"},
+		{mnuMrcReset, "DEL Batch        ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/batchclear.png"},
+		{mnuMrcResetRev, "DEL Reversal     ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/deletereversal.png"},
+		{mnuMngUsers, "Manage Users     ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+		{mnuBillerResend, "Biller Resend Adv", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/agent.png"},
+
+		// Agent menu
+		{mnuAgent, "Agent>           ", 0, 1, 0, 4, " ", "file://flash/HOST/TU.TAR/icones/agent.png"},
+		{mnuAgencyDeposit, "Agency deposit   ", mnuAgent, 0, 0, 1, "C", "file://flash/HOST/TU.TAR/icones/deposit.png"},
+
+		// Supervisor menu
+		{mnuSupervisor, "Supervisor>       ", 0, 1, 0, 3, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+
+		// Admin menu
+		{mnuAdmin, "Admin>           ", 0, 0, 1, 5, " ", "file://flash/HOST/TU.TAR/icones/administrator.png"},
+		{mnuTerminalMode, "Terminal Mode  Sel.", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/clessmode.png"},
+		{mnuTerminalPar, "Terminal Parameters", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/parameters.png"},
+		{mnuBillerConfig, "Biller Configure   ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/adjust.png"},
+		{mnuTMKey, "Loaded Keys Check  ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/pinkey.png"},
+		{mnuGenerateTLSkey, "Generate TLS key   ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/pinkey.png"},
+		{mnuCmmIS, "IP Setup           ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/IP.png"},
+		{mnuClessModeOff, "CLESS Mode Off     ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/clessmode.png"},
+		{mnuConnMode, "Connection Mode    ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/connection.png"},
+		{mnuControlPanel, "Show Control Panel ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/controlpanel.png"},
+		{mnuSwapSimSlot, "Manual SIM Slot Swap", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+		{mnuCvmMode, "Force PIN CVM      ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/cvm.png"},
+		{mnuUsbTraces, "Trace Cless to USB ", mnuAdmin, 1, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/1.png"},
+		{mnuNetTiming, "Network Timing     ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/connection.png"},
+		{mnuLogExport, "Export Log         ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+#else
+		// Customer menu
+		{mnuCustomer, "TRANSACTION>        ", 0, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/customers.png"},
+		{mnuSale, "SALE             ", mnuCustomer, 0, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/purchasing.png"},
+		{mnuSaleCB, "SALE and CASHBACK", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/purchasecb.png"},
+		{mnuDeposit, "DEPOSIT          ", mnuCustomer, 1, 0, 1, "C", "file://flash/HOST/TU.TAR/icones/deposit.png"},
+		{mnuWithdrawal, "WITHDRAWAL       ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/withdrawal.png"},
+		{mnuPreaut, "PREAUTHORIZATION ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/preauth.png"},
+		{mnuCompletion, "COMPLETION       ", mnuCustomer, 0, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/completion.png"},
+		{mnuBalanceEnquiry, "BALANCE ENQUIRY  ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/balanceinquiry.png"},
+		{mnuMiniStatement, "MINI STATEMENT   ", mnuCustomer, 1, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/ministatement.png"},
+		{mnuRefund, "REFUND           ", mnuCustomer, 0, 1, 1, "C", "file://flash/HOST/TU.TAR/icones/refund.png"},
+		{mnuBiller, "PAY BILL         ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/agent.png"},
+		{mnuOffline, "OFFLINE          ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/offline.png"},
+		{mnuVoid, "VOID             ", mnuCustomer, 0, 0, 1, "C", "file://flash/HOST/TU.TAR/icones/void.png"},
+		{mnuAdjust, "ADJUST           ", mnuCustomer, 1, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/adjust.png"},
+		{mnuReversal, "REVERSAL         ", mnuCustomer, 1, 0, 1, "D", "file://flash/HOST/TU.TAR/icones/reversal.png"},
+		{mnuLogOn, "LOG ON           ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/logon.png"},
+		{mnuEchoTest, "ECHO TEST        ", mnuCustomer, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/echotest.png"},
+		{mnuCustSettlement, "SETTLEMENT       ", mnuCustomer, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/settlement.png"},
+
+		// Merchant menu
+		{mnuMerchant, "MERCHANT>        ", 0, 0, 1, 2, " ", "file://flash/HOST/TU.TAR/icones/merchant.png"},
+		{mnuSettlement, "SETTLEMENT       ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/settlement.png"},
+		{mnuDetailedReport, "DETAILED REPORT  ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/report.png"},
+		{mnuSummaryReport, "SUMMARY REPORT   ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/summaryreport.png"},
+		{mnuDuplicateReceipt, "DUPLICATE RECEIPT", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/detailreport.png"},
+		{mnuReprintReceipt, "REPPRINT RECEIPT ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/detailreport.png"},
+		{mnuAdmChgPwd, "ADMIN PASSWORD   ", mnuMerchant, 0, 0, 5, " ", "file://flash/HOST/TU.TAR/icones/adminpwd.png"},
+		{mnuMrcChgPwd, "MERCH PASSWORD   ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/merchantpwd.png"},
+		{mnuMrcReset, "DELETE BATCH     ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/batchclear.png"},
+		{mnuMrcResetRev, "DELETE REVERSAL  ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/deletereversal.png"},
+		{mnuMngUsers, "MANAGE USERS     ", mnuMerchant, 0, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+		{mnuBillerResend, "BILLER RESEND ADV", mnuMerchant, 1, 0, 2, " ", "file://flash/HOST/TU.TAR/icones/agent.png"},
+
+		// Agent menu
+		{mnuAgent, "AGENT>           ", 0, 1, 0, 4, " ", "file://flash/HOST/TU.TAR/icones/agent.png"},
+		{mnuAgencyDeposit, "AGENCY DEPOSIT   ", mnuAgent, 0, 0, 1, "C", "file://flash/HOST/TU.TAR/icones/deposit.png"},
+
+		// Supervisor menu
+		{mnuSupervisor, "SUPERVISOR>       ", 0, 1, 0, 3, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+
+		// Admin menu
+		{mnuAdmin, "ADMIN>           ", 0, 0, 1, 5, " ", "file://flash/HOST/TU.TAR/icones/administrator.png"},
+		{mnuTerminalMode, "Terminal Mode  Sel.", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/clessmode.png"},
+		{mnuTerminalPar, "Terminal Parameters", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/parameters.png"},
+		{mnuBillerConfig, "Biller Configure   ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/adjust.png"},
+		{mnuTMKey, "Loaded Keys Check  ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/pinkey.png"},
+		{mnuGenerateTLSkey, "Generate TLS keys  ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/pinkey.png"},
+		{mnuCmmIS, "IP Setup           ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/IP.png"},
+		{mnuClessModeOff, "CLESS Mode Off     ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/clessmode.png"},
+		{mnuConnMode, "Connection Mode    ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/connection.png"},
+		{mnuControlPanel, "Show Control Panel ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/controlpanel.png"},
+		{mnuSwapSimSlot, "Manual SIM Slot Swap", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+		{mnuCvmMode, "Force PIN CVM      ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/cvm.png"},
+		{mnuUsbTraces, "Trace Cless to USB ", mnuAdmin, 1, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/1.png"},
+		{mnuNetTiming, "Network Timing     ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/connection.png"},
+		{mnuLogExport, "Export Log         ", mnuAdmin, 0, 0, 1, " ", "file://flash/HOST/TU.TAR/icones/supervisor.png"},
+#endif
+};
+
+// Menu item read from AppMenus, with the changes of the terminal mode
+#define MNU_TREE_MAX    64
+#define lenMnuName      32
+#define lenMnuIcon      64
+typedef struct {
+	word Id;
+	word Parent;
+	byte Hidden;
+	byte Secure;
+	byte Level;
+	char Name[lenMnuName + 1];
+	char Icon[lenMnuIcon + 1];
+} tMnuItem;
+
 //// Global variables ///////////////////////////////////////////
 
+static tMnuItem tzMnuTree[MNU_TREE_MAX];   // Menu tree, read once from AppMenus
+static int iMnuTreeCnt = -1;               // Items in tzMnuTree, -1 to read it again
+
 //// Functions //////////////////////////////////////////////////
-static void ResetMenuVars(void){
-
-	memset(var_MnuCustomer, 0, sizeof(var_MnuCustomer));
-	memset(var_MnuSale, 0, sizeof(var_MnuSale));
-	memset(var_MnuSaleCB, 0, sizeof(var_MnuSaleCB));
-	memset(var_MnuDeposit, 0, sizeof(var_MnuDeposit));
-	memset(var_MnuWithdrawal, 0, sizeof(var_MnuWithdrawal));
-	memset(var_MnuPreaut, 0, sizeof(var_MnuPreaut));
-	memset(var_MnuCompletion, 0, sizeof(var_MnuCompletion));
-	memset(var_MnuBalanceInquiry, 0, sizeof(var_MnuBalanceInquiry));
-	memset(var_MnuMiniSatement, 0, sizeof(var_MnuMiniSatement));
-	memset(var_MnuRefund, 0, sizeof(var_MnuRefund));
-	memset(var_MnuOffline , 0, sizeof(var_MnuOffline ));
-	memset(var_MnuBiller , 0, sizeof(var_MnuBiller ));
-	memset(var_MnuVoid, 0, sizeof(var_MnuVoid));
-	memset(var_MnuAdjust, 0, sizeof(var_MnuAdjust));
-	memset(var_MnuReversal, 0, sizeof(var_MnuReversal));
-	memset(var_MnuLogOn , 0, sizeof(var_MnuLogOn ));
-	memset(var_MnuEchoTest, 0, sizeof(var_MnuEchoTest));
-	memset(var_MnuCustSettlement, 0, sizeof(var_MnuCustSettlement));
-
-	memset(var_MnuAgent , 0, sizeof(var_MnuAgent ));
-	memset(var_MnuAgencyDeposit , 0, sizeof(var_MnuAgencyDeposit ));
-
-	memset(var_MnuMerchant, 0, sizeof(var_MnuMerchant));
-	memset(var_MnuSettlement, 0, sizeof(var_MnuSettlement));
-	memset(var_MnuDetailedRpt , 0, sizeof(var_MnuDetailedRpt ));
-	memset(var_MnuSummaryRpt , 0, sizeof(var_MnuSummaryRpt ));
-	memset(var_MnuDuplicateReceipt, 0, sizeof(var_MnuDuplicateReceipt));
-	memset(var_MnuReprintReceipt, 0, sizeof(var_MnuReprintReceipt));
-	memset(var_MnuAdmChgPwd , 0, sizeof(var_MnuAdmChgPwd ));
-	memset(var_MnuMrcChgPwd , 0, sizeof(var_MnuMrcChgPwd ));
-	memset(var_MnuMrcReset, 0, sizeof(var_MnuMrcReset));
-	memset(var_MnuMrcResetRev , 0, sizeof(var_MnuMrcResetRev));
-	memset(var_MnuMngUsers , 0, sizeof(var_MnuMngUsers));
-	memset(var_MnuBillerResend , 0, sizeof(var_MnuBillerResend));
-
-	memset(var_MnuSupervisor , 0, sizeof(var_MnuSupervisor));
-
-	memset(var_MnuAdmin , 0, sizeof(var_MnuAdmin ));
-	memset(var_MnuTerminalPar , 0, sizeof(var_MnuTerminalPar ));
-	memset(var_MnuBillerConfig , 0, sizeof(var_MnuBillerConfig ));
-	memset(var_MnuTMKey , 0, sizeof(var_MnuTMKey ));
-	memset(var_MnuGenerateTLSkey , 0, sizeof(var_MnuGenerateTLSkey ));
-	memset(var_MnuCmmIS , 0, sizeof(var_MnuCmmIS ));
-	memset(var_MnuClessModeOff , 0, sizeof(var_MnuClessModeOff ));
-	memset(var_MnuConnMode , 0, sizeof(var_MnuConnMode));
-	memset(var_MnuControlPanel , 0, sizeof(var_MnuControlPanel));
-	memset(var_MnuSwapSimSlot , 0, sizeof(var_MnuSwapSimSlot));
-	memset(var_MnuCvmMode , 0, sizeof(var_MnuCvmMode));
-	memset(var_MnuTraces , 0, sizeof(var_MnuTraces));
-	memset(var_MnuTerminalMode, 0, sizeof(var_MnuTerminalMode));
-}
 
+//! \brief Write the menus of tzMnuDef into AppMenus, by one commit.
+//! Called by SqliteDB_Init on a new software or a reset of the terminal.
 void Generate_Menu_Content(void){
-	ResetMenuVars();
+	int ret = 1;
+	int i;
 
-#ifdef ICONMENU
-	//-- Customer Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuCustomer,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Transaction>        ', '0', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/customers.png');",       mnuCustomer);             // CUSTOMER>
-	/// level 1
-	Telium_Sprintf(var_MnuSale,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Sale             ', '%d', '0','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/purchasing.png');",     mnuSale,mnuCustomer);
-	Telium_Sprintf(var_MnuSaleCB,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Sale + CASHBACK  ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/purchasecb.png');",     mnuSaleCB,mnuCustomer);                 // SALE
-	Telium_Sprintf(var_MnuDeposit,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Deposit          ', '%d', '1','0' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/deposit.png');",        mnuDeposit,mnuCustomer);              // DEPOSIT
-	Telium_Sprintf(var_MnuWithdrawal,     "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Withdrawal       ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/withdrawal.png');",     mnuWithdrawal,mnuCustomer);           // WITHDRAWAL
-	Telium_Sprintf(var_MnuPreaut,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Preauth          ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/preauth.png');",        mnuPreaut,mnuCustomer);               // PREAUTHORIZATION
-	Telium_Sprintf(var_MnuCompletion,     "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Completion       ', '%d', '0','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/completion.png');",     mnuCompletion,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuBalanceInquiry, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Balance Inq      ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/balanceinquiry.png');", mnuBalanceEnquiry,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuMiniSatement,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Mini stat        ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/ministatement.png');",  mnuMiniStatement,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuPayment,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Payment          ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/payment.png');",        mnuPayment,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuRefund,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Refund           ', '%d', '0','1' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/refund.png');",         mnuRefund,mnuCustomer);               // REFUND
-	Telium_Sprintf(var_MnuOffline,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Offline          ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/offline.png');",        mnuOffline,mnuCustomer);              // OFFLINE
-	Telium_Sprintf(var_MnuBiller,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Pay Bill         ', '%d', '0','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/agent.png');",        mnuBiller,mnuCustomer);              // OFFLINE
-	Telium_Sprintf(var_MnuVoid,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Void             ', '%d', '0','0' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/void.png');",           mnuVoid,mnuCustomer);                 // VOID
-	Telium_Sprintf(var_MnuAdjust,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Adjust           ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/adjust.png');",         mnuAdjust,mnuCustomer);               // ADJUST
-	Telium_Sprintf(var_MnuReversal,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Reversal         ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/reversal.png');",       mnuReversal,mnuCustomer);             // REVERSAL
-	Telium_Sprintf(var_MnuLogOn,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Logon           ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/logon.png');",          mnuLogOn,mnuCustomer);                // LOG ON
-	Telium_Sprintf(var_MnuEchoTest,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Echo Test        ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/echotest.png');",       mnuEchoTest,mnuCustomer);                // LOG ON
-	Telium_Sprintf(var_MnuCustSettlement, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Settlement       ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/settlement.png');",     mnuCustSettlement,mnuCustomer);           // SETTLEMENT
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Merchant Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuMerchant,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Merchant>        ', '0', '0','1' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/merchant.png');",        mnuMerchant);             // MERCHANT>
-	/// level 1
-	Telium_Sprintf(var_MnuSettlement,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Settlement       ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/settlement.png');",     mnuSettlement,mnuMerchant);           // SETTLEMENT
-	Telium_Sprintf(var_MnuDetailedRpt,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Detailed rpt     ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/report.png');",         mnuDetailedReport,mnuMerchant);       // DETAILED REPORT
-	Telium_Sprintf(var_MnuSummaryRpt,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Summary rpt      ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/summaryreport.png');",  mnuSummaryReport,mnuMerchant);        // SUMMARY REPORT
-	Telium_Sprintf(var_MnuDuplicateReceipt,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Dupl Receipt     ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/detailreport.png');",   mnuDuplicateReceipt,mnuMerchant);     // DUPLICATE RECEIPT
-	Telium_Sprintf(var_MnuReprintReceipt,     "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Reprint Receipt  ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/detailreport.png');",   mnuReprintReceipt,mnuMerchant);       // REPRINT RECEIPT
-	Telium_Sprintf(var_MnuAdmChgPwd,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Admin Pass       ', '%d', '0','0' ,'5', ' ', 'file://flash/HOST/TU.TAR/icones/adminpwd.png');",       mnuAdmChgPwd,mnuMerchant);            // ADMIN PASSWORD
-	Telium_Sprintf(var_MnuMrcChgPwd,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Merch Pass       ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/merchantpwd.png');",    mnuMrcChgPwd,mnuMerchant);            // MERCH PASSWORD
-	Telium_Sprintf(var_MnuMrcReset,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'DEL Batch        ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/batchclear.png');",     mnuMrcReset,mnuMerchant);             // DELETE BATCH
-	Telium_Sprintf(var_MnuMrcResetRev,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'DEL Reversal     ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/deletereversal.png');", mnuMrcResetRev,mnuMerchant);          // DELETE REVERSAL
-	Telium_Sprintf(var_MnuMngUsers,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Manage Users     ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/supervisor.png');",     mnuMngUsers,mnuMerchant);             // MANAGE USERS
-	Telium_Sprintf(var_MnuBillerResend,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Biller Resend Adv', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/agent.png');",          mnuBillerResend,mnuMerchant);         // BILLER RESEND ADVICE
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Supervisor Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuSupervisor,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Supervisor>       ', '0', '1','0' ,'3', ' ', 'file://flash/HOST/TU.TAR/icones/supervisor.png');",     mnuSupervisor);                      // SUPERVISOR>
-
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Agent Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuAgent,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Agent>           ', '0', '1','0' ,'4', ' ', 'file://flash/HOST/TU.TAR/icones/agent.png');",         mnuAgent);                            // AGENT>
-	/// level 1
-	Telium_Sprintf(var_MnuAgencyDeposit, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Agency deposit   ', '%d', '0','0' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/deposit.png');",      mnuAgencyDeposit,mnuAgent);          // SETTLEMENT
-
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Admin Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuAdmin,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Admin>           ', '0', '0','1' ,'5', ' ', 'file://flash/HOST/TU.TAR/icones/administrator.png');",  mnuAdmin);                            // ADMIN>
-	/// level 1
-	Telium_Sprintf(var_MnuTerminalMode,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Terminal Mode  Sel.', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/clessmode.png');",   mnuTerminalMode,mnuAdmin);
-	Telium_Sprintf(var_MnuTerminalPar,    "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Terminal Parameters', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/parameters.png');",  mnuTerminalPar,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuBillerConfig,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Biller Configure   ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/adjust.png');",      mnuBillerConfig,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuTMKey,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Loaded Keys Check  ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/pinkey.png');",      mnuTMKey,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuGenerateTLSkey, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Generate TLS key   ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/pinkey.png');",      mnuGenerateTLSkey,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuCmmIS,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'IP Setup           ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/IP.png');",          mnuCmmIS,mnuAdmin);
-	Telium_Sprintf(var_MnuClessModeOff,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'CLESS Mode Off     ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/clessmode.png');",   mnuClessModeOff,mnuAdmin);
-	Telium_Sprintf(var_MnuConnMode,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Connection Mode    ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/connection.png');",  mnuConnMode,mnuAdmin);
-	Telium_Sprintf(var_MnuControlPanel,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Show Control Panel ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/controlpanel.png');",mnuControlPanel,mnuAdmin);
-	Telium_Sprintf(var_MnuSwapSimSlot,    "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Manual SIM Slot Swap', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/supervisor.png');", mnuSwapSimSlot,mnuAdmin);
-	Telium_Sprintf(var_MnuCvmMode,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Force PIN CVM      ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/cvm.png');",         mnuCvmMode,mnuAdmin);
-	Telium_Sprintf(var_MnuTraces,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Trace Cless to USB ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/1.png');",           mnuUsbTraces,mnuAdmin);
-
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+	sqlite_Txn_Begin();
+	for (i = 0; (i < sizeof(tzMnuDef) / sizeof(tzMnuDef[0])) && (ret > 0); i++)
+		ret = Sqlite_Put_Menu(tzMnuDef[i].Id, tzMnuDef[i].Name, tzMnuDef[i].Parent, tzMnuDef[i].Hidden, tzMnuDef[i].Secure, tzMnuDef[i].Level, tzMnuDef[i].DrCr, tzMnuDef[i].Icon);
+	sqlite_Txn_End(ret > 0);
+	Menu_Tree_Drop();
+}
 
-#else
+//! \brief Forget the menu tree: it is read again from AppMenus before the
+//! next menu is shown. Called each time AppMenus is written.
+void Menu_Tree_Drop(void){
+	iMnuTreeCnt = -1;
+}
 
-	//-- Customer Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuCustomer,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'TRANSACTION>        ', '0', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/customers.png');",       mnuCustomer);             // CUSTOMER>
-	/// level 1
-	Telium_Sprintf(var_MnuSale,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'SALE             ', '%d', '0','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/purchasing.png');",     mnuSale,mnuCustomer);
-	Telium_Sprintf(var_MnuSaleCB,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'SALE and CASHBACK', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/purchasecb.png');",     mnuSaleCB,mnuCustomer);                 // SALE
-	Telium_Sprintf(var_MnuDeposit,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'DEPOSIT          ', '%d', '1','0' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/deposit.png');",        mnuDeposit,mnuCustomer);              // DEPOSIT
-	Telium_Sprintf(var_MnuWithdrawal,     "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'WITHDRAWAL       ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/withdrawal.png');",     mnuWithdrawal,mnuCustomer);           // WITHDRAWAL
-	Telium_Sprintf(var_MnuPreaut,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'PREAUTHORIZATION ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/preauth.png');",        mnuPreaut,mnuCustomer);               // PREAUTHORIZATION
-	Telium_Sprintf(var_MnuCompletion,     "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'COMPLETION       ', '%d', '0','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/completion.png');",     mnuCompletion,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuBalanceInquiry, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'BALANCE ENQUIRY  ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/balanceinquiry.png');", mnuBalanceEnquiry,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuMiniSatement,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'MINI STATEMENT   ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/ministatement.png');",  mnuMiniStatement,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuPayment,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'PAYMENT          ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/payment.png');",        mnuPayment,mnuCustomer);                 // COMPLETION
-	Telium_Sprintf(var_MnuRefund,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'REFUND           ', '%d', '0','1' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/refund.png');",         mnuRefund,mnuCustomer);               // REFUND
-	Telium_Sprintf(var_MnuBiller,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'PAY BILL         ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/agent.png');",          mnuBiller,mnuCustomer);              // OFFLINE
-	Telium_Sprintf(var_MnuOffline,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'OFFLINE          ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/offline.png');",        mnuOffline,mnuCustomer);              // OFFLINE
-	Telium_Sprintf(var_MnuVoid,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'VOID             ', '%d', '0','0' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/void.png');",           mnuVoid,mnuCustomer);                 // VOID
-	Telium_Sprintf(var_MnuAdjust,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'ADJUST           ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/adjust.png');",         mnuAdjust,mnuCustomer);               // ADJUST
-	Telium_Sprintf(var_MnuReversal,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'REVERSAL         ', '%d', '1','0' ,'1', 'D', 'file://flash/HOST/TU.TAR/icones/reversal.png');",       mnuReversal,mnuCustomer);             // REVERSAL
-	Telium_Sprintf(var_MnuLogOn,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'LOG ON           ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/logon.png');",          mnuLogOn,mnuCustomer);                // LOG ON
-	Telium_Sprintf(var_MnuEchoTest,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'ECHO TEST        ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/echotest.png');",       mnuEchoTest,mnuCustomer);                // LOG ON
-	Telium_Sprintf(var_MnuCustSettlement, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'SETTLEMENT       ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/settlement.png');",     mnuCustSettlement,mnuCustomer);           // SETTLEMENT
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Merchant Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuMerchant,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'MERCHANT>        ', '0', '0','1' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/merchant.png');",        mnuMerchant);             // MERCHANT>
-	/// level 1
-	Telium_Sprintf(var_MnuSettlement,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'SETTLEMENT       ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/settlement.png');",     mnuSettlement,mnuMerchant);           // SETTLEMENT
-	Telium_Sprintf(var_MnuDetailedRpt,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'DETAILED REPORT  ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/report.png');",         mnuDetailedReport,mnuMerchant);       // DETAILED REPORT
-	Telium_Sprintf(var_MnuSummaryRpt,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'SUMMARY REPORT   ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/summaryreport.png');",  mnuSummaryReport,mnuMerchant);        // SUMMARY REPORT
-	Telium_Sprintf(var_MnuDuplicateReceipt,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'DUPLICATE RECEIPT', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/detailreport.png');",   mnuDuplicateReceipt,mnuMerchant);     // DUPLICATE RECEIPT
-	Telium_Sprintf(var_MnuReprintReceipt,     "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'REPPRINT RECEIPT ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/detailreport.png');",   mnuReprintReceipt,mnuMerchant);       // REPRINT RECEIPT
-	Telium_Sprintf(var_MnuAdmChgPwd,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'ADMIN PASSWORD   ', '%d', '0','0' ,'5', ' ', 'file://flash/HOST/TU.TAR/icones/adminpwd.png');",       mnuAdmChgPwd,mnuMerchant);            // ADMIN PASSWORD
-	Telium_Sprintf(var_MnuMrcChgPwd,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'MERCH PASSWORD   ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/merchantpwd.png');",    mnuMrcChgPwd,mnuMerchant);            // MERCH PASSWORD
-	Telium_Sprintf(var_MnuMrcReset,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'DELETE BATCH     ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/batchclear.png');",     mnuMrcReset,mnuMerchant);             // DELETE BATCH
-	Telium_Sprintf(var_MnuMrcResetRev,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'DELETE REVERSAL  ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/deletereversal.png');", mnuMrcResetRev,mnuMerchant);          // DELETE REVERSAL
-	Telium_Sprintf(var_MnuMngUsers,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'MANAGE USERS     ', '%d', '0','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/supervisor.png');",     mnuMngUsers,mnuMerchant);             // MANAGE USERS
-	Telium_Sprintf(var_MnuBillerResend,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'BILLER RESEND ADV', '%d', '1','0' ,'2', ' ', 'file://flash/HOST/TU.TAR/icones/agent.png');",          mnuBillerResend,mnuMerchant);         // Biller Resend Advice
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Supervisor Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuSupervisor,           "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'SUPERVISOR>       ', '0', '1','0' ,'3', ' ', 'file://flash/HOST/TU.TAR/icones/supervisor.png');",     mnuSupervisor);                      // SUPERVISOR>
-
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Agent Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuAgent,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'AGENT>           ', '0', '1','0' ,'4', ' ', 'file://flash/HOST/TU.TAR/icones/agent.png');",         mnuAgent);                            // AGENT>
-	/// level 1
-	Telium_Sprintf(var_MnuAgencyDeposit, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'AGENCY DEPOSIT   ', '%d', '0','0' ,'1', 'C', 'file://flash/HOST/TU.TAR/icones/deposit.png');",      mnuAgencyDeposit,mnuAgent);          // SETTLEMENT
-
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
-	//-- Admin Menu --
-	/// level 0
-	Telium_Sprintf(var_MnuAdmin,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'ADMIN>           ', '0', '0','1' ,'5', ' ', 'file://flash/HOST/TU.TAR/icones/administrator.png');",  mnuAdmin);                            // ADMIN>
-	/// level 1
-	Telium_Sprintf(var_MnuTerminalMode,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Terminal Mode  Sel.', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/clessmode.png');",   mnuTerminalMode,mnuAdmin);
-	Telium_Sprintf(var_MnuTerminalPar,    "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Terminal Parameters', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/parameters.png');",  mnuTerminalPar,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuBillerConfig,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Biller Configure   ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/adjust.png');",      mnuBillerConfig,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuTMKey,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Loaded Keys Check  ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/pinkey.png');",      mnuTMKey,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuGenerateTLSkey, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Generate TLS keys  ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/pinkey.png');",      mnuGenerateTLSkey,mnuAdmin);    	           // Master key load
-	Telium_Sprintf(var_MnuCmmIS,          "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'IP Setup           ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/IP.png');",          mnuCmmIS,mnuAdmin);
-	Telium_Sprintf(var_MnuClessModeOff,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'CLESS Mode Off     ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/clessmode.png');",   mnuClessModeOff,mnuAdmin);
-	Telium_Sprintf(var_MnuConnMode,       "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Connection Mode    ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/connection.png');",  mnuConnMode,mnuAdmin);
-	Telium_Sprintf(var_MnuControlPanel,   "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Show Control Panel ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/controlpanel.png');",mnuControlPanel,mnuAdmin);
-	Telium_Sprintf(var_MnuSwapSimSlot,    "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Manual SIM Slot Swap', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/supervisor.png');", mnuSwapSimSlot,mnuAdmin);
-	Telium_Sprintf(var_MnuCvmMode,        "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Force PIN CVM      ', '%d', '0','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/cvm.png');",         mnuCvmMode,mnuAdmin);
-	Telium_Sprintf(var_MnuTraces,         "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', 'Trace Cless to USB ', '%d', '1','0' ,'1', ' ', 'file://flash/HOST/TU.TAR/icones/1.png');",           mnuUsbTraces,mnuAdmin);
-
-	//^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^^
+// Item of the menu tree, for each row given by sqlite_Menu_Each.
+static int mnuTreeRow(const tSqlRow *Row, void *Ctx){
+	tMnuItem *pxItm;
+
+	CHECK(iMnuTreeCnt < MNU_TREE_MAX, lblKO);
+	pxItm = &tzMnuTree[iMnuTreeCnt++];
+	memset(pxItm, 0, sizeof(*pxItm));
+	pxItm->Id = (word)Row->Int[mnuRowId];
+	pxItm->Parent = (word)Row->Int[mnuRowParent];
+	pxItm->Hidden = (byte)Row->Int[mnuRowHidden];
+	pxItm->Secure = (byte)Row->Int[mnuRowSecure];
+	pxItm->Level = (byte)Row->Int[mnuRowLevel];
+	strncpy(pxItm->Name, Row->Text[mnuRowName], lenMnuName);
+	strncpy(pxItm->Icon, Row->Text[mnuRowIcon], lenMnuIcon);
+	return 1;
 
-#endif
+	lblKO:
+	return -1;
+}
+
+//! \brief Give the items shown in a menu, from the menu tree; the tree is
+//! read from AppMenus first when dropped.
+//! \param[in] Parent Menu item holding them, 0 for the main menu.
+//! \param[out] Child Items, in the order of AppMenus.
+//! \param[in] Max Size of Child.
+//! \return Number of items, -1 when AppMenus cannot be read.
+static int mnuTreeChildren(word Parent, const tMnuItem **Child, int Max){
+	int iCnt = 0;
+	int i;
+
+	if (iMnuTreeCnt < 0) {
+		iMnuTreeCnt = 0;
+		if (sqlite_Menu_Each(mnuTreeRow, NULL) < 0) {
+			iMnuTreeCnt = -1;
+			return -1;
+		}
+	}
+	for (i = 0; (i < iMnuTreeCnt) && (iCnt < Max); i++) {
+		if ((tzMnuTree[i].Parent == Parent) && !tzMnuTree[i].Hidden)
+			Child[iCnt++] = &tzMnuTree[i];
+	}
+	return iCnt;
 }
 
 
@@ -1726,6 +1731,7 @@ static int Manual_PAN_Entry(void){
 
 void All_AfterTransaction(void){
 	int ret = 0;
+	byte ucApproved;
 	card MnuItm = 0;
 	char DspData[1024];
 
@@ -1737,13 +1743,20 @@ void All_AfterTransaction(void){
 
 	memset(DspData, 0, sizeof(DspData)); //reset used field
 	//AB: return code processing and reversal check to be done here
-	if(MnuItm != mnuOffline) {
-		ret = valRspCod();
-		CHECK(ret > 0, lblDeclined);
-	}
+	ucApproved = 1;
+	if(MnuItm != mnuOffline)
+		ucApproved = (valRspCod() > 0);
 
-	ret = logSave();         // Save transaction into log table (Batch)
+	// The log record and the advice: one commit
+	sqlite_Txn_Begin();
+	ret = 1;
+	if (ucApproved)
+		ret = logSave();         // Save transaction into log table (Batch)
+	if (ret > 0)
+		AdviseTransactionManager(); // (2) Manage Advice Messages
+	sqlite_Txn_End(ret > 0);
 	CHECK(ret > 0, lblKO);
+	CHECK(ucApproved, lblDeclined);
 
 	// TODO: Customise if required
 	// TODO: Reversal, Online Advice, display transaction status, print ticket...
@@ -1763,9 +1776,6 @@ void All_AfterTransaction(void){
 	ret = PrintReceipt();
 	CHECK(ret > 0, lblKO);    // Print transaction receipt
 
-	// (2) Manage Advice Messages
-	AdviseTransactionManager();
-
 	ret = incCard(appSTAN); //Increment Trace number even if its an Offline Transaction
 	CHECK(ret >= 0, lblKO);
 
@@ -2398,33 +2408,21 @@ int Application_Card_Transaction(void){
 }
 
 int Manage_Application_Menu(T_GL_HGRAPHIC_LIB handleGoal){
-	int ret = 0, MenuSelected = TRUE, rec = 0, MnuRec = 0;
-	int numberOfColumns = 0, LastMenuSelected = 0;
-	char menuBuffer[32 * 5 * 80];
-	char parentMenuSTR[3];
+	int ret = 0, MenuSelected = TRUE, MnuRec = 0;
+	int LastMenuSelected = 0;
 	card key = 0,keyLog[256];
 	int numberOfMenus = 0,keyLogCounter = 0;
-	char *Raw_Record;
-	char *Menu_Record_Array[100];
-	char Menu_Column_Buffer[512];
-	char *Menu_Column;
-	char *Menu_Column_Array[40];
-	char tempBuffer[100];
-	char temp[100];
-	char MenuContent[40][100];
-	char MenuIcon[40][100];
-	char MenuSecurity[40][5];
+	const tMnuItem *MenuItems[40];
 	char MenuSelectedName[100];
-	char MenuContent_ID[40][5];
-	char MenuSecurityLevel[40][5];
+	char MenuSecurityLevel[5];
 	char TraMenuItem[5];
-	char SecuredMenu[2];
 	char Amount[lenAmt + 1];
 	int MenuProcessingResult = 0;
 	int refreshed = 0;
 
 
 	memset(MenuSelectedName, 0, sizeof(MenuSelectedName));
+	memset(TraMenuItem, 0, sizeof(TraMenuItem));
 	memset(Amount, 0, sizeof(Amount));
 	memset(keyLog, 0, sizeof(keyLog));
 
@@ -2442,12 +2440,9 @@ int Manage_Application_Menu(T_GL_HGRAPHIC_LIB handleGoal){
 	do{
 		/// ======== start menu management loop =========
 
-		memset(parentMenuSTR, 0, sizeof(parentMenuSTR));
-		memset(menuBuffer, 0, sizeof(menuBuffer));
-		num2dec(parentMenuSTR, key,0);
-
-		//menu management
-		numberOfMenus = Sqlite_Get_Menu(parentMenuSTR, menuBuffer);
+		//menu management, from the menu tree in RAM
+		numberOfMenus = mnuTreeChildren((word)key, MenuItems, sizeof(MenuItems) / sizeof(MenuItems[0]) - 1);
+		CHECK(numberOfMenus >= 0, lblDB_Corrupt);
 		if(numberOfMenus == 0){// NO CHILDREN MENUS
 			//Trying to sort issue when button is pressed and nothing happens
 			if ((key == 0) && (numberOfMenus == 0)) {
@@ -2467,136 +2462,6 @@ int Manage_Application_Menu(T_GL_HGRAPHIC_LIB handleGoal){
 
 			goto RE_DSP_MENU;
 		}
-		numberOfColumns = count_chars(menuBuffer,';') / numberOfMenus;
-		/*
-		 * menuBuffer{} structure =
-		 * tableColumnName1,columnData1;tableColumnName2,columnData2;#tableColumnName1,columnData1;tableColumnName2,columnData2;#
-		 */
-		//// ----------- split the records into an array ---------------
-		Raw_Record = strtok(menuBuffer,"#");//record separator
-		Menu_Record_Array[0] = Raw_Record;
-
-		for(rec = 1;rec < numberOfMenus;rec++){
-			if(Raw_Record == NULL){
-				break;
-			}
-			Raw_Record = strtok(NULL,"#");
-			Menu_Record_Array[rec] = Raw_Record;
-		}
-
-		///--------------------- get the menu ID, Menu Name and Icon name -------------------
-		for(rec = 0;rec < numberOfMenus; rec++){
-			memset(Menu_Column_Buffer, 0, sizeof(Menu_Column_Buffer));
-			strcpy(Menu_Column_Buffer, Menu_Record_Array[rec]);
-
-			//++++++++++++ Treat first record ++++++++++++++
-			Menu_Column = strtok(Menu_Column_Buffer,";");//record separator
-			Menu_Column_Array[0] = Menu_Column;
-
-			memset(tempBuffer, 0, sizeof(tempBuffer));
-			ret = fmtTok(tempBuffer, Menu_Column_Array[0], ",");    //extract first token
-			Menu_Column_Array[0]+=ret;//skip data
-			Menu_Column_Array[0]++;   //skip separator
-
-			if (strncmp(tempBuffer,"MenuId", 6) == 0) { ///Id of menu
-				memset(MenuContent_ID[rec], 0, sizeof(MenuContent_ID[rec]));
-				memset(temp, 0, sizeof(temp));
-				memset(tempBuffer, 0, sizeof(tempBuffer));
-				ret = fmtTok(tempBuffer, Menu_Column_Array[0], ",");    //extract second token
-				strcpy(temp, tempBuffer);
-				strcpy(MenuContent_ID[rec], temp);
-			} else if(strncmp(tempBuffer,"MenuName", 8) == 0){ ///Name of menu
-				memset(MenuContent[rec], 0, sizeof(MenuContent[rec]));
-				memset(temp, 0, sizeof(temp));
-				memset(tempBuffer, 0, sizeof(tempBuffer));
-
-				ret = fmtTok(tempBuffer, Menu_Column_Array[0], ",");    //extract second token "Menu Name"
-				strcpy(temp, tempBuffer);
-				strcpy(MenuContent[rec], temp);
-
-			} else if(strncmp(tempBuffer,"IconPathName", 12) == 0){ ///Icon Menu Name
-				memset(MenuIcon[rec], 0, sizeof(MenuIcon[rec]));
-
-				memset(temp, 0, sizeof(temp));
-				memset(tempBuffer, 0, sizeof(tempBuffer));
-				ret = fmtTok(tempBuffer, Menu_Column_Array[0], ",");
-				strcpy(temp, tempBuffer);
-				strcpy(MenuIcon[rec], temp);
-			} else if(strncmp(tempBuffer,"SecureMenuLevel", 15) == 0){ ///Menu Security Level
-				memset(MenuSecurityLevel[rec], 0, sizeof(MenuSecurityLevel[rec]));
-
-				memset(temp, 0, sizeof(temp));
-				memset(tempBuffer, 0, sizeof(tempBuffer));
-				ret = fmtTok(tempBuffer, Menu_Column_Array[0], ",");
-				strcpy(temp, tempBuffer);
-				strcpy(MenuSecurityLevel[rec], temp);
-			} else if(strncmp(tempBuffer,"SecureMenu", 10) == 0){ ///Menu is Secured
-				memset(MenuSecurity[rec], 0, sizeof(MenuSecurity[rec]));
-
-				memset(temp, 0, sizeof(temp));
-				memset(tempBuffer, 0, sizeof(tempBuffer));
-				ret = fmtTok(tempBuffer, Menu_Column_Array[0], ",");
-				strcpy(temp, tempBuffer);
-				strcpy(MenuSecurity[rec], temp);
-			}
-
-
-			//+++++++++++++++++  Treat other records +++++++++++++
-			for(MnuRec = 1;MnuRec < numberOfColumns;MnuRec++){
-				if(Menu_Column == NULL){
-					break;
-				}
-				Menu_Column = strtok(NULL,";");
-				Menu_Column_Array[MnuRec] = Menu_Column;
-
-				memset(tempBuffer, 0, sizeof(tempBuffer));
-				ret = fmtTok(tempBuffer, Menu_Column_Array[MnuRec], ",");    //extract first token
-				Menu_Column_Array[MnuRec]+=ret;//skip data
-				Menu_Column_Array[MnuRec]++;   //skip separator
-
-				if (strncmp(tempBuffer,"MenuId", 6) == 0) { ///Id of menu
-					memset(MenuContent_ID[rec], 0, sizeof(MenuContent_ID[rec]));
-					memset(temp, 0, sizeof(temp));
-					memset(tempBuffer, 0, sizeof(tempBuffer));
-					ret = fmtTok(tempBuffer, Menu_Column_Array[MnuRec], ",");    //extract second token
-					strcpy(temp, tempBuffer);
-					strcpy(MenuContent_ID[rec], temp);
-				} else if(strncmp(tempBuffer,"MenuName", 8) == 0){ ///Name of menu
-					memset(MenuContent[rec], 0, sizeof(MenuContent[rec]));
-					memset(temp, 0, sizeof(temp));
-					memset(tempBuffer, 0, sizeof(tempBuffer));
-					ret = fmtTok(tempBuffer, Menu_Column_Array[MnuRec], ",");    //extract second token
-					strcpy(temp, tempBuffer);
-					strcpy(MenuContent[rec], temp);
-				} else if(strncmp(tempBuffer,"IconPathName", 12) == 0){ ///Name of Icon
-					memset(MenuIcon[rec], 0, sizeof(MenuIcon[rec]));
-					memset(temp, 0, sizeof(temp));
-					memset(tempBuffer, 0, sizeof(tempBuffer));
-					ret = fmtTok(tempBuffer, Menu_Column_Array[MnuRec], ",");    //extract second token
-					strcpy(temp, tempBuffer);
-					strcpy(MenuIcon[rec], temp);
-				} else if(strncmp(tempBuffer,"SecureMenuLevel", 15) == 0){ ///Menu security level
-					memset(MenuSecurityLevel[rec], 0, sizeof(MenuSecurityLevel[rec]));
-					memset(temp, 0, sizeof(temp));
-					memset(tempBuffer, 0, sizeof(tempBuffer));
-					ret = fmtTok(tempBuffer, Menu_Column_Array[MnuRec], ",");    //extract second token
-					strcpy(temp, tempBuffer);
-					strcpy(MenuSecurityLevel[rec], temp);
-				} else if(strncmp(tempBuffer,"SecureMenu", 10) == 0){ ///Menu security check
-					memset(MenuSecurity[rec], 0, sizeof(MenuSecurity[rec]));
-					memset(temp, 0, sizeof(temp));
-					memset(tempBuffer, 0, sizeof(tempBuffer));
-					ret = fmtTok(tempBuffer, Menu_Column_Array[MnuRec], ",");    //extract second token
-					strcpy(temp, tempBuffer);
-					strcpy(MenuSecurity[rec], temp);
-				}
-			}
-		}
-		memset(MenuIcon[numberOfMenus], 0, sizeof(MenuIcon[numberOfMenus]));
-		memset(MenuContent[numberOfMenus], 0, sizeof(MenuContent[numberOfMenus]));
-		memset(MenuSecurity[numberOfMenus], 0, sizeof(MenuSecurity[numberOfMenus]));
-		memset(MenuContent_ID[numberOfMenus], 0, sizeof(MenuContent_ID[numberOfMenus]));
-		memset(MenuSecurityLevel[numberOfMenus], 0, sizeof(MenuSecurityLevel[numberOfMenus]));
 
 		///--------------------------------------------------------------------------
 		MAPPUTSTR(appAppLoggedName, "----", lblKO);
@@ -2606,9 +2471,9 @@ int Manage_Application_Menu(T_GL_HGRAPHIC_LIB handleGoal){
 		int MenuSync = 0;
 		for (MnuRec = 0; MnuRec < (numberOfMenus*2); MnuRec+=2) {
 			//menu name
-			appMenuContent[MnuRec] = MenuContent[MenuSync];
+			appMenuContent[MnuRec] = MenuItems[MenuSync]->Name;
 			//menu icon
-			appMenuContent[MnuRec+1] = MenuIcon[MenuSync];
+			appMenuContent[MnuRec+1] = MenuItems[MenuSync]->Icon;
 
 			MenuSync++;
 		}
@@ -2625,7 +2490,7 @@ int Manage_Application_Menu(T_GL_HGRAPHIC_LIB handleGoal){
 #else
 		//--- Normal List menu
 		for (MnuRec = 0; MnuRec < numberOfMenus; MnuRec++) {
-			appMenuContent[MnuRec] = MenuContent[MnuRec];
+			appMenuContent[MnuRec] = MenuItems[MnuRec]->Name;
 		}
 		appMenuContent[numberOfMenus] = NULL;
 
@@ -2639,24 +2504,24 @@ int Manage_Application_Menu(T_GL_HGRAPHIC_LIB handleGoal){
 
 			//Save the Selected menu Item name for next header
 			memset(MenuSelectedName, 0, sizeof(MenuSelectedName));
-			strcpy(MenuSelectedName, MenuContent[LastMenuSelected]);
+			strcpy(MenuSelectedName, MenuItems[LastMenuSelected]->Name);
 
 			//first save the current menu just in case the user wants to go back to previous menu
 			keyLog[keyLogCounter] = key;
 			keyLogCounter++;
 
 			//Save the Menu Selected ID
-			MAPPUTSTR(traMnuItm, MenuContent_ID[LastMenuSelected], lblKO);
+			key = MenuItems[LastMenuSelected]->Id;
 			memset(TraMenuItem, 0, sizeof(TraMenuItem));
-			strcpy(TraMenuItem, MenuContent_ID[LastMenuSelected]);
-			dec2num(&key, MenuContent_ID[LastMenuSelected],0);
+			num2dec(TraMenuItem, key, 0);
+			MAPPUTSTR(traMnuItm, TraMenuItem, lblKO);
 			MenuSelected = TRUE;
 
 			// password checking
-			memset(SecuredMenu, 0, sizeof(SecuredMenu));
-			strncpy(SecuredMenu, MenuSecurity[LastMenuSelected],1);
-			if (strncmp(SecuredMenu,"1", 1) == 0) {
-				if(fncSecurityPassword(MenuSecurityLevel[LastMenuSelected]) == 0){
+			if (MenuItems[LastMenuSelected]->Secure == 1) {
+				memset(MenuSecurityLevel, 0, sizeof(MenuSecurityLevel));
+				num2dec(MenuSecurityLevel, MenuItems[LastMenuSelected]->Level, 0);
+				if(fncSecurityPassword(MenuSecurityLevel) == 0){
 					// Case where the password was wrong
 					if(keyLogCounter > 0)
 						keyLogCounter--;
@@ -53,6 +53,12 @@ static const char *tzSLLModeMenu[] = {
 		NULL
 };
 
+static const char *tzLogExportMenu[] = {
+		"Changes since last",
+		"Whole log",
+		NULL
+};
+
 
 static const char *tzShortCutMenuBiller[] = {
 		"PAY BILL",
@@ -543,6 +549,26 @@ static void ChangeConnectionMode(void){
 
 }
 
+// Export the log to HOST/TSLDELTA.BIN, the changes since the last export
+// the host acknowledged or the whole log, see sqlite_Export.
+static void ExportLog(void){
+	tSqlExp xExp;
+	char tcTxt[128];
+	int ret;
+
+	ret = GL_Dialog_Menu(hGoal, "EXPORT LOG", tzLogExportMenu, 0, GL_BUTTON_ALL, GL_KEY_0, GL_TIME_MINUTE);
+	if ((ret != 0) && (ret != 1))
+		return;
+
+	GL_Dialog_Message(hGoal, NULL, "Exporting...", GL_ICON_NONE, GL_BUTTON_NONE, 0);
+	if (sqlite_Export(ret, &xExp) > 0) {
+		Telium_Sprintf(tcTxt, "%s to\nHOST/TSLDELTA.BIN\n%ld rows %ld deleted\n%ld bytes", xExp.Full ? "Whole log" : "Changes",
+				xExp.Rows, xExp.Deletes, xExp.Bytes);
+		GL_Dialog_Message(hGoal, NULL, tcTxt, GL_ICON_INFORMATION, GL_BUTTON_VALID, 5*1000);
+	} else
+		GL_Dialog_Message(hGoal, NULL, "Export FAILED", GL_ICON_ERROR, GL_BUTTON_VALID, 3*1000);
+}
+
 
 int MenuProcessingSelect(word MnuItm) {
 	int ret = 0, CardTransaction = FALSE;
@@ -558,6 +584,7 @@ int MenuProcessingSelect(word MnuItm) {
 	byte ConnDetails = 0;
 	char InvoiceNum[12];
 	char VoidedSTAN_Val[lenSTAN + 1];
+	tSqlCap xCap;
 
 	memset(buf, 0, sizeof(buf));
 	memset(InvoiceNum, 0, sizeof(InvoiceNum));
@@ -737,7 +764,7 @@ int MenuProcessingSelect(word MnuItm) {
 	case mnuMrcResetRev:
 		NoCard_But_Online = FALSE;
 		CardTransaction = FALSE;
-		//          fncRevReset();
+		revQueueReset();
 		break;
 	case mnuMngUsers:
 		NoCard_But_Online = FALSE;
@@ -759,6 +786,16 @@ int MenuProcessingSelect(word MnuItm) {
 		CardTransaction = FALSE;
 		applicationTraces();
 		break;
+	case mnuNetTiming:
+		NoCard_But_Online = FALSE;
+		CardTransaction = FALSE;
+		netTimMenu();
+		break;
+	case mnuLogExport:
+		NoCard_But_Online = FALSE;
+		CardTransaction = FALSE;
+		ExportLog();
+		break;
 
 		// *** Items regarding administrator ***
 		// *** Items regarding Terminal ***
@@ -875,6 +912,17 @@ int MenuProcessingSelect(word MnuItm) {
 		break;
 	}
 
+	// Disk of the log nearly full: the merchant asked to settle, then the sales wait for it
+	if ((CardTransaction || NoCard_But_Online) && OnlineSaveLog) {
+		ret = sqlite_Capacity(&xCap);
+		if (ret == capFull) {
+			GL_Dialog_Message(hGoal, NULL, "Memory full""\n""Please settle first", GL_ICON_ERROR, GL_BUTTON_VALID, 30*1000);
+			goto lblKO;
+		}
+		if (ret == capWarn)
+			GL_Dialog_Message(hGoal, NULL, "Memory low""\n""Please settle soon", GL_ICON_WARNING, GL_BUTTON_NONE, 3*1000);
+	}
+
 	if ((CardTransaction || NoCard_But_Online) && (!No_Currency)) {
 		retWord = ApplicationSelectCurrency();
 		ret = (int)retWord;
@@ -928,10 +976,15 @@ int MenuProcessingSelect(word MnuItm) {
 			CHECK(ret > 0, lblDeclined);
 		}
 
-		if (OnlineSaveLog) {
+		// The log record and the void flag of the original: one commit
+		sqlite_Txn_Begin();
+		ret = 1;
+		if (OnlineSaveLog)
 			ret = logSave();         // Save transaction into log table (Batch)
-			CHECK(ret > 0, lblKO);
-		}
+		if ((ret > 0) && (MnuItm == mnuVoid))
+			sqlite_CloseVoid(VoidedSTAN_Val);
+		sqlite_Txn_End(ret > 0);
+		CHECK(ret > 0, lblKO);
 
 		//GOVT Biller payments
 		if(MnuItm == mnuBiller) {
@@ -950,8 +1003,6 @@ int MenuProcessingSelect(word MnuItm) {
 		if(MnuItm != mnuVoid) {
 			ret = incCard(appInvNum);   //Increment Invoice number / ROC when trx is approved
 			CHECK(ret > 0, lblKO);
-		} else {
-			sqlite_CloseVoid(VoidedSTAN_Val);
 		}
 
 
@@ -972,6 +1023,8 @@ int MenuProcessingSelect(word MnuItm) {
 
 	lblEnd:
 
+	ecrSaleEnd(); //Result to the cash register when the sale was asked by it
+
 	//Clear the transaction Buffers of the transaction
 	traReset();
 	fncWriteStatusOfConnection('0');//Notify TMS transaction is in session
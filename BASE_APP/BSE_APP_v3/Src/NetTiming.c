@@ -0,0 +1,285 @@
+/*
+ * NetTiming.c
+ *
+ *  Per stage timing of the online exchanges.
+ *  performOlineTransaction opens a measure, the transports and the framed
+ *  receiver mark the end of each stage they go through, and the breakdown
+ *  of the exchange is kept with the transaction (traNetTiming -> log row).
+ *  The receive timeout chosen for the exchange (RecvTmo.c) is kept with it.
+ *  The last exchanges are also kept in a rolling window from which the
+ *  percentiles per stage are shown on the terminal or exported to HOST.
+ */
+#include <globals.h>
+
+//****************************************************************************
+//      EXTERN
+//****************************************************************************
+extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define NET_TIM_WINDOW  64                 // Exchanges kept for the percentiles
+#define NET_TIM_FILE    "/HOST/NETTIM.CSV" // Export file
+
+static const char *tzStgName[netStgEnd] = {
+		"BLD", "ATT", "DNS", "TCP", "TLS", "SND", "HST", "RCV"
+};
+
+static const char *tzNetTimMenu[] = {
+		"VIEW PERCENTILES",
+		"EXPORT TO HOST",
+		NULL
+};
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static card tulCur[netStgEnd];                    // Exchange in progress (ms)
+static card tulWin[NET_TIM_WINDOW][netStgEnd];    // Rolling window (ms)
+static card ulTmoCur;                             // Receive timeout of the exchange (ms)
+static card tulTmoWin[NET_TIM_WINDOW];
+static word usWinNbr = 0;                         // Samples in the window
+static word usWinPos = 0;                         // Next slot to overwrite
+static card ulLast = 0;                           // Tick of the last mark
+static byte ucActive = 0;
+
+//****************************************************************************
+//                        void netTimBegin (void)
+//  This function opens the measure of an online exchange.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void netTimBegin(void) {
+	memset(tulCur, 0, sizeof(tulCur));
+	ulTmoCur = 0;
+	ulLast = GTL_StdTimer_GetCurrent();
+	ucActive = 1;
+}
+
+//****************************************************************************
+//                       void netTimMark (int iStg)
+//  This function closes a stage: the time elapsed since the previous mark
+//  is added to it, so a stage done twice (failover) is counted twice.
+//  Marks outside an opened measure (background senders) are ignored.
+//  This function has parameters.
+//    iStg (I-) : Stage (netStgBuild..netStgRecv)
+//  This function has no return value
+//****************************************************************************
+void netTimMark(int iStg) {
+	card ulNow;
+
+	if ((ucActive == 0) || (iStg < 0) || (iStg >= netStgEnd))
+		return;
+
+	ulNow = GTL_StdTimer_GetCurrent();
+	tulCur[iStg] += (ulNow - ulLast) * 10;
+	ulLast = ulNow;
+}
+
+//****************************************************************************
+//             void netTimCharge (int iStg, card ulFrom)
+//  This function moves the time elapsed since ulFrom to a stage, out of the
+//  stage in progress. Used for a step that may or may not happen inside
+//  another stage (name resolution before the attach).
+//  This function has parameters.
+//    iStg (I-) : Stage
+//    ulFrom (I-) : Tick at which the step started (after the last mark)
+//  This function has no return value
+//****************************************************************************
+void netTimCharge(int iStg, card ulFrom) {
+	card ulSpent;
+
+	if ((ucActive == 0) || (iStg < 0) || (iStg >= netStgEnd))
+		return;
+
+	ulSpent = GTL_StdTimer_GetCurrent() - ulFrom;
+	tulCur[iStg] += ulSpent * 10;
+	ulLast += ulSpent;
+}
+
+//****************************************************************************
+//                   void netTimTimeout (card ulTmo)
+//  This function records the receive timeout used by the exchange.
+//  This function has parameters.
+//    ulTmo (I-) : Timeout (ms)
+//  This function has no return value
+//****************************************************************************
+void netTimTimeout(card ulTmo) {
+	if (ucActive)
+		ulTmoCur = ulTmo;
+}
+
+//****************************************************************************
+//            int netTimEnd (char *pcTim, word usDim)
+//  This function closes the measure, adds it to the rolling window and
+//  formats the breakdown as "bld,att,dns,tcp,tls,snd,hst,rcv,tmo" in ms.
+//  This function has parameters.
+//    pcTim (-O) : Breakdown (lenNetTim+1)
+//    usDim (I-) : Size of pcTim
+//  This function has return value
+//    Length of the breakdown
+//****************************************************************************
+int netTimEnd(char *pcTim, word usDim) {
+	char tcStg[12+1];
+	int iStg, iLen = 0;
+
+	ucActive = 0;
+	memcpy(tulWin[usWinPos], tulCur, sizeof(tulCur));
+	tulTmoWin[usWinPos] = ulTmoCur;
+	usWinPos = (usWinPos + 1) % NET_TIM_WINDOW;
+	if (usWinNbr < NET_TIM_WINDOW)
+		usWinNbr++;
+
+	*pcTim = 0;
+	for (iStg=0; iStg<=netStgEnd; iStg++) {
+		Telium_Sprintf(tcStg, iStg ? ",%lu" : "%lu", (unsigned long)((iStg < netStgEnd) ? tulCur[iStg] : ulTmoCur));
+		if (iLen + strlen(tcStg) >= usDim)
+			break;
+		strcpy(pcTim + iLen, tcStg);
+		iLen += strlen(tcStg);
+	}
+	return iLen;
+}
+
+//****************************************************************************
+//                   card netTimStage (int iStg)
+//  This function returns the duration of a stage in the last exchange
+//  measured; it stays valid after netTimEnd.
+//  This function has parameters.
+//    iStg (I-) : Stage
+//  This function has return value
+//    Duration in ms
+//****************************************************************************
+card netTimStage(int iStg) {
+	if ((iStg < 0) || (iStg >= netStgEnd))
+		return 0;
+	return tulCur[iStg];
+}
+
+//****************************************************************************
+//              card netTimPercentile (int iStg, int iPct)
+//  This function returns a percentile of a stage over the rolling window
+//  (nearest rank).
+//  This function has parameters.
+//    iStg (I-) : Stage
+//    iPct (I-) : Percentile (1..100)
+//  This function has return value
+//    Duration in ms (0 when no sample)
+//****************************************************************************
+card netTimPercentile(int iStg, int iPct) {
+	card tulVal[NET_TIM_WINDOW], ulTmp;
+	int iIdx, iPos, iRank;
+
+	if ((usWinNbr == 0) || (iStg < 0) || (iStg >= netStgEnd))
+		return 0;
+
+	for (iIdx=0; iIdx<usWinNbr; iIdx++) {                  // Insertion sort, 64 values at most
+		ulTmp = tulWin[iIdx][iStg];
+		for (iPos=iIdx; (iPos > 0) && (tulVal[iPos-1] > ulTmp); iPos--)
+			tulVal[iPos] = tulVal[iPos-1];
+		tulVal[iPos] = ulTmp;
+	}
+
+	iRank = (iPct * usWinNbr + 99) / 100;
+	if (iRank < 1)
+		iRank = 1;
+	return tulVal[iRank-1];
+}
+
+static void netTimView(void) {
+	char tcTxt[512+1];
+	card ulScr, ulSav;
+	int iStg, iLen;
+
+	if (usWinNbr == 0) {
+		GL_Dialog_Message(hGoal, NULL, "No online exchange\nmeasured yet", GL_ICON_INFORMATION, GL_BUTTON_VALID, 3*1000);
+		return;
+	}
+
+	iLen = Telium_Sprintf(tcTxt, "%d exchanges (ms)\nSTG   P50   P90   P99\n", usWinNbr);
+	for (iStg=0; iStg<netStgEnd; iStg++)
+		iLen += Telium_Sprintf(tcTxt + iLen, "%s %5lu %5lu %5lu\n", tzStgName[iStg],
+				(unsigned long)netTimPercentile(iStg, 50),
+				(unsigned long)netTimPercentile(iStg, 90),
+				(unsigned long)netTimPercentile(iStg, 99));
+	if (comStaCost(&ulScr, &ulSav) > 0)                                // Progress screen cost
+		Telium_Sprintf(tcTxt + iLen, "SCR %5lu ms\nSAV %5lu ms/exchange\n", (unsigned long)ulScr, (unsigned long)ulSav);
+
+	GL_Dialog_Message(hGoal, "NETWORK TIMING", tcTxt, GL_ICON_NONE, GL_BUTTON_VALID, GL_TIME_MINUTE);
+}
+
+static int netTimExport(void) {
+	S_FS_FILE *hFile = NULL;
+	char tcLine[128+1];
+	card ulScr, ulSav;
+	unsigned int uiMode;
+	int iStg, iIdx, iLen, iRet = -1;
+
+	CHECK(FS_mount("/HOST", &uiMode) == FS_OK, lblEnd);
+	FS_unlink(NET_TIM_FILE);
+	hFile = FS_open(NET_TIM_FILE, "a");
+	CHECK(hFile != NULL, lblEnd);
+
+	iLen = Telium_Sprintf(tcLine, "stage,p50,p90,p99,samples\n");
+	CHECK(FS_write(tcLine, 1, iLen, hFile) == iLen, lblEnd);
+	for (iStg=0; iStg<netStgEnd; iStg++) {
+		iLen = Telium_Sprintf(tcLine, "%s,%lu,%lu,%lu,%d\n", tzStgName[iStg],
+				(unsigned long)netTimPercentile(iStg, 50),
+				(unsigned long)netTimPercentile(iStg, 90),
+				(unsigned long)netTimPercentile(iStg, 99), usWinNbr);
+		CHECK(FS_write(tcLine, 1, iLen, hFile) == iLen, lblEnd);
+	}
+
+	if (comStaCost(&ulScr, &ulSav) > 0) {                              // Progress screen cost
+		iLen = Telium_Sprintf(tcLine, "screen,%lu\nsaved,%lu\n", (unsigned long)ulScr, (unsigned long)ulSav);
+		CHECK(FS_write(tcLine, 1, iLen, hFile) == iLen, lblEnd);
+	}
+
+	iLen = Telium_Sprintf(tcLine, "\nbld,att,dns,tcp,tls,snd,hst,rcv,tmo\n");
+	CHECK(FS_write(tcLine, 1, iLen, hFile) == iLen, lblEnd);
+	for (iIdx=0; iIdx<usWinNbr; iIdx++) {                  // Oldest sample first
+		int iPos = (usWinPos + NET_TIM_WINDOW - usWinNbr + iIdx) % NET_TIM_WINDOW;
+		card *pulSmp = tulWin[iPos];
+
+		iLen = 0;
+		for (iStg=0; iStg<netStgEnd; iStg++)
+			iLen += Telium_Sprintf(tcLine + iLen, iStg ? ",%lu" : "%lu", (unsigned long)pulSmp[iStg]);
+		iLen += Telium_Sprintf(tcLine + iLen, ",%lu", (unsigned long)tulTmoWin[iPos]);
+		tcLine[iLen++] = '\n';
+		CHECK(FS_write(tcLine, 1, iLen, hFile) == iLen, lblEnd);
+	}
+	iRet = usWinNbr;
+
+	lblEnd:
+	if (hFile != NULL)
+		FS_close(hFile);
+	return iRet;
+}
+
+//****************************************************************************
+//                        void netTimMenu (void)
+//  This function shows the percentiles per stage or exports them, with the
+//  samples of the window, to HOST/NETTIM.CSV.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void netTimMenu(void) {
+	ulong ulResult;
+
+	ulResult = GL_Dialog_Menu(hGoal, "NETWORK TIMING", tzNetTimMenu, 0, GL_BUTTON_ALL, GL_KEY_0, GL_TIME_MINUTE);
+
+	switch (ulResult) {
+	case 0:
+		netTimView();
+		break;
+	case 1:
+		if (netTimExport() >= 0)
+			GL_Dialog_Message(hGoal, NULL, "Exported to\nHOST/NETTIM.CSV", GL_ICON_INFORMATION, GL_BUTTON_VALID, 3*1000);
+		else
+			GL_Dialog_Message(hGoal, NULL, "Export FAILED", GL_ICON_ERROR, GL_BUTTON_VALID, 3*1000);
+		break;
+	default:
+		break;
+	}
+}
@@ -3,6 +3,7 @@
 #include "GTL_Assert.h"
 #include "EMV_Support.h"
 #include "SSL_.h"
+#include "LinkLayer.h"
 
 //****************************************************************************
 //      EXTERN
@@ -99,67 +100,35 @@ int Cless_FinancialCommunication_ManageAuthorisation (T_SHARED_DATA_STRUCT * pSh
 }
 
 /*****
- *
- *
+ * Insert the 2 byte length and the TPDU in front of an ISO message.
+ * \param    req:tBuffer* (I/O) ISO message, framed on return.
+ * \return length of the frame if OK, negative otherwise.
  */
-int performOlineTransaction(void){
-	byte CommRoute = 0;
-	byte TLS_Enabled = 0;
+static int onlFrame(tBuffer *req){
 	byte bcdLReq[lenBCDMsg];
 	byte bcdNii[lenNii + 1];
 	char Nii[6 + 1];
 	char tpduHead[4 + 1];
-	//	char tpduModem[8 + 1];
 	char tpduTCPIP[10 + 1];
-	//	char tpduRS232[8 + 1];
 	char strTPDU[64 + 1];
-	tBuffer bReq;    // Request Buffer
-	byte dReq[(1024 * 3) + 1]; // Request data
-	tBuffer bRsp;    // Response Buffer
-	byte dRsp[(1024 * 3) + 3]; // Response data
 	tBuffer bTPDUReq;// TPDU Request Buffer
 	byte dTPDUReq[lenTPDU + lenBCDMsg + 1];
 	byte bytTPDU[6 + 1];
 	int ret = 0;
-	word TLS_SSL = 0;
-	byte byteTemp = 0;
-	word wordTemp = 0;
-	T_GL_HWIDGET hScreen=NULL;    // Screen handle
 
-	hScreen = GoalCreateScreen(hGoal, txGPRS, NUMBER_OF_LINES(txGPRS), GL_ENCODING_UTF8);
-	CHECK(hScreen!=NULL, lblKO);                                    // Create screen and clear it
-
-	ret = GoalClrScreen(hScreen, GL_COLOR_BLACK, KEY_CANCEL, false);
-	CHECK(ret>=0, lblKO);
-
-	memset(dRsp, 0, sizeof(dRsp));
-	memset(dReq, 0, sizeof(dReq));
 	memset(bytTPDU, 0, sizeof(bytTPDU));
 	memset(strTPDU, 0, sizeof(strTPDU));
 	memset(dTPDUReq, 0, sizeof(dTPDUReq));
 	memset(tpduHead, 0, sizeof(tpduHead));
+	memset(tpduTCPIP, 0, sizeof(tpduTCPIP));
 
-	//initialize request buffer
-	bufInit(&bRsp, dRsp, sizeof(dRsp));
-	bufInit(&bReq, dReq, sizeof(dReq));
 	bufInit(&bTPDUReq, dTPDUReq, sizeof(dTPDUReq));
 
-	ret = GoalDspLine(hScreen, 2, "Building Request...", &txGPRS[3], 0, true);
-	CHECK(ret>=0, lblKO);
-	//Telium_Ttestall(0, 2*100);
-
 	MAPGET(appNII, Nii, lblKO);
 	fmtPad(Nii, -(lenNII + 1), '0');
 	hex2bin(bcdNii, Nii, 0);
 
-	MAPPUTSTR(traRspCod, "100", lblKO);
-	ret = reqBuild(&bReq);
-	CHECK(ret > 0, lblKO);
-
-	// Prepare for any reversal if need be
-	isReversibleSend();
-
-	num2bin(bcdLReq, bufLen(&bReq) + 5 , sizeof(bcdLReq));
+	num2bin(bcdLReq, bufLen(req) + 5 , sizeof(bcdLReq));
 	ret = bufApp(&bTPDUReq, bcdLReq, 2);  //Message Length
 
 	//Build TPDU
@@ -174,6 +143,28 @@ int performOlineTransaction(void){
 	hex2bin(bytTPDU,strTPDU,5);  //Standard
 	ret = bufApp(&bTPDUReq, bytTPDU, 5);    //append bin data
 
+	ret = bufIns(req, 0, bufPtr(&bTPDUReq), bufLen(&bTPDUReq));
+	CHECK(ret > 0, lblKO);
+
+	return bufLen(req);
+	lblKO:
+	return -1;
+}
+
+/*****
+ * Frame an ISO message with the 2 byte length and the TPDU, send it over the
+ * configured route and strip the same header from the response.
+ * Shared by the online transaction and the background senders.
+ * \param    req:tBuffer* (I) ISO message without header.
+ * \param    rsp:tBuffer* (O) ISO response without header.
+ * \return length of the response if OK, negative otherwise.
+ */
+int onlSendRaw(tBuffer *req, tBuffer *rsp){
+	byte CommRoute = 0;
+	byte TLS_Enabled = 0;
+	int ret = 0;
+	word TLS_SSL = 0;
+
 	///Get the communication route
 	mapGetByte(appCommRoute,CommRoute);
 
@@ -183,88 +174,247 @@ int performOlineTransaction(void){
 	switch (TLS_Enabled) {
 	case 'Y':
 		TLS_SSL = 1;
-//		///----------------------------------
-//		switch (CommRoute) {
-//		case 'T':
-//			CommRoute = 'S';
-//			break;
-//		default:
-//			break;
-//		}
-//		///----------------------------------
 		break;
-		default:
-			break;
+	default:
+		break;
 	}
 
-
 	//make sure the SSL configs are okay
 	comCheckSslProfile();
 
-	ret = GoalDspLine(hScreen, 2, "Please Wait...", &txGPRS[3], 0, true);
-	CHECK(ret>=0, lblKO);
-
-	if (hScreen)
-		GoalDestroyScreen(&hScreen);                                  // Destroy screen
-
-	ret = bufIns(&bReq, 0, bufPtr(&bTPDUReq), bufLen(&bTPDUReq));
+	ret = onlFrame(req);
 	CHECK(ret > 0, lblKO);
 
 	/// Perform the transaction by route
 	switch (CommRoute) {
 	case 'T'://Ethernet or TCP/IP
 
-		ret = ComEthernet(&bReq,&bRsp, TLS_SSL);
+		ret = ComEthernet(req,rsp, TLS_SSL);
 		CHECK(ret >= 10, lblKO);
 
 		break;
 	case 'P'://PPP
 
-		ret = ComPPP(&bReq,&bRsp, TLS_SSL);
-		CHECK(ret == bufLen(&bReq), lblKO);
+		ret = ComPPP(req,rsp, TLS_SSL);
+		CHECK(ret == bufLen(req), lblKO);
 
 		break;
 	case 'M'://Modem
 
-		ret = ComModem(&bReq,&bRsp, TLS_SSL);
+		ret = ComModem(req,rsp, TLS_SSL);
 		CHECK(ret >= 10, lblKO);
 
 		break;
 	case 'R'://Serial
 
-		ret = ComSerial(&bReq,&bRsp, TLS_SSL);
+		ret = ComSerial(req,rsp, TLS_SSL);
 		CHECK(ret >= 10, lblKO);
 
 		break;
 	case 'U'://USB
 
-		ret = ComUSB(&bReq,&bRsp, TLS_SSL);
-		CHECK(ret == bufLen(&bReq), lblKO);
+		ret = ComUSB(req,rsp, TLS_SSL);
+		CHECK(ret == bufLen(req), lblKO);
 
 		break;
 	case 'S'://SSL
 
-		ret = ComSSL(&bReq,&bRsp);
+		ret = ComSSL(req,rsp);
 		CHECK(ret >= 10, lblKO);
 
 		break;
 	case 'W'://WIFI
 
-		ret = comWifiConnect(&bReq,&bRsp, TLS_SSL);
+		ret = comWifiConnect(req,rsp, TLS_SSL);
 		CHECK(ret >= 10, lblKO);
 
 		break;
 	case 'G': //GPRS
 	default:  //GPRS
 
-		ret = ComGPRS(&bReq,&bRsp, TLS_SSL);
+		ret = ComGPRS(req,rsp, TLS_SSL);
 		CHECK(ret >= 10, lblKO);
 
 		break;
 	}
 
-	ret = bufDel(&bRsp, 0, lenBCDMsg + lenTPDU);  //remove Message Length and TPDU from the message
+	ret = bufDel(rsp, 0, lenBCDMsg + lenTPDU);  //remove Message Length and TPDU from the message
 	CHECK(ret >= 0, lblKO);
+	echoSchedTraffic();                        // The link is proven, the echo can wait
+
+	return bufLen(rsp);
+
+	lblKO:
+	return -1;
+}
+
+/*****
+ * Batch session: one connection carrying several exchanges, the next
+ * requests sent before the previous answers came back (settlement batch
+ * upload). Only the GPRS and Ethernet routes keep a session open; on the
+ * other routes each request is exchanged alone and its answer held until
+ * asked for.
+ */
+static void *pvBatch = NULL;                 // Session of the batch in progress
+static byte ucBatchRoute = 0;
+static char tcBatchHost[128 + 1];            // "ip|port" dialled, for the receive timeout
+static tBuffer bBatchRsp;
+static byte dBatchRsp[(1024 * 3) + 3];       // Frame received, or answer held on the other routes
+static byte ucBatchHeld = 0;
+
+/** \return 1:session open, requests can be pipelined, 0:one exchange at a time on this route, -1:no host reached */
+int onlBatchOpen(void){
+	byte TLS_Enabled = 0;
+	word TLS_SSL = 0;
+
+	onlBatchClose();
+
+	mapGetByte(appCommRoute, ucBatchRoute);
+	mapGetByte(appCommSSL, TLS_Enabled);
+	if (TLS_Enabled == 'Y')
+		TLS_SSL = 1;
+	comCheckSslProfile();
+	memset(tcBatchHost, 0, sizeof(tcBatchHost));
+
+	switch (ucBatchRoute) {
+	case 'P':
+	case 'M':
+	case 'R':
+	case 'U':
+	case 'S':
+	case 'W':
+		return 0;
+	case 'T'://Ethernet or TCP/IP
+		pvBatch = comEthSessionOpen(TLS_SSL, tcBatchHost);
+		break;
+	case 'G': //GPRS
+	default:  //GPRS
+		ucBatchRoute = 'G';
+		pvBatch = comGprsSessionOpen(TLS_SSL, tcBatchHost);
+		break;
+	}
+	CHECK(pvBatch != NULL, lblKO);
+
+	return 1;
+	lblKO:
+	return -1;
+}
+
+/** \return length sent if OK, negative otherwise */
+int onlBatchSend(tBuffer *req){
+	int ret = 0;
+
+	if (pvBatch == NULL) {                   // No session: exchange now, answer kept for onlBatchRecv
+		CHECK(ucBatchHeld == 0, lblKO);
+		bufInit(&bBatchRsp, dBatchRsp, sizeof(dBatchRsp));
+		ret = onlSendRaw(req, &bBatchRsp);
+		CHECK(ret >= 0, lblKO);
+		ucBatchHeld = 1;
+		return ret;
+	}
+
+	ret = onlFrame(req);
+	CHECK(ret > 0, lblKO);
+	ret = comSendLL(pvBatch, bufPtr(req), bufLen(req));
+	CHECK(ret == bufLen(req), lblKO);
+
+	return ret;
+	lblKO:
+	return -1;
+}
+
+/** Next answer of the session, in the order the host sends them. \return length of the answer without header if OK, negative otherwise */
+int onlBatchRecv(tBuffer *rsp){
+	int ret = 0;
+
+	if (pvBatch == NULL) {
+		CHECK(ucBatchHeld != 0, lblKO);
+		ucBatchHeld = 0;
+		ret = bufApp(rsp, bufPtr(&bBatchRsp), bufLen(&bBatchRsp));
+		CHECK(ret >= 0, lblKO);
+		return bufLen(rsp);
+	}
+
+	ret = comRecvFrame(comReadLL, pvBatch, NULL, dBatchRsp, sizeof(dBatchRsp), rcvTmoGet(ucBatchRoute, tcBatchHost));
+	if (ret == LL_ERROR_TIMEOUT)
+		rcvTmoExpired(ucBatchRoute, tcBatchHost);
+	CHECK(ret > lenBCDMsg + lenTPDU, lblKO);
+
+	ret = bufApp(rsp, dBatchRsp + lenBCDMsg + lenTPDU, ret - (lenBCDMsg + lenTPDU));  //without Message Length and TPDU
+	CHECK(ret >= 0, lblKO);
+	echoSchedTraffic();
+
+	return bufLen(rsp);
+	lblKO:
+	return -1;
+}
+
+void onlBatchClose(void){
+	if (pvBatch) {
+		if (ucBatchRoute == 'T')
+			comEthSessionClose(pvBatch);
+		else
+			comGprsSessionClose(pvBatch);
+	}
+	pvBatch = NULL;
+	ucBatchHeld = 0;
+}
+
+/*****
+ *
+ *
+ */
+int performOlineTransaction(void){
+	tBuffer bReq;    // Request Buffer
+	byte dReq[(1024 * 3) + 1]; // Request data
+	tBuffer bRsp;    // Response Buffer
+	byte dRsp[(1024 * 3) + 3]; // Response data
+	int ret = 0;
+	byte byteTemp = 0;
+	word wordTemp = 0;
+	T_GL_HWIDGET hScreen=NULL;    // Screen handle
+	char tcTim[lenNetTim + 1];
+	int iCancel = -1;
+
+	hScreen = comStaOpen();                                         // One screen for the whole exchange
+	CHECK(hScreen!=NULL, lblKO);
+
+	memset(dRsp, 0, sizeof(dRsp));
+	memset(dReq, 0, sizeof(dReq));
+
+	//initialize request buffer
+	bufInit(&bRsp, dRsp, sizeof(dRsp));
+	bufInit(&bReq, dReq, sizeof(dReq));
+
+	comStaShow(comStaBuild);
+	//Telium_Ttestall(0, 2*100);
+
+	MAPPUTSTR(traRspCod, "100", lblKO);
+
+	// A reversal still pending for this card or STAN goes first
+	ret = revQueueCheck();
+	CHECK(ret > 0, lblKO);
+
+	netTimBegin();
+	ret = reqBuild(&bReq);
+	CHECK(ret > 0, lblKO);
+
+	// Prepare for any reversal if need be: stored before the request leaves
+	if (isReversibleSend() == 1)
+		revQueueArm();
+	netTimMark(netStgBuild);
+
+	ret = onlBgWait();                                              // A background exchange may hold the link
+	if (ret >= 0)                                                   // Not cancelled
+		ret = onlSendRaw(&bReq, &bRsp);
+	iCancel = comStaCancelled();
+	comStaClose();
+	netTimEnd(tcTim, sizeof(tcTim));                                // Breakdown saved with the log row
+	mapPutStr(traNetTiming, tcTim);
+	if (iCancel < 0)                                                // A cancel says nothing of the link
+		DualSimNote(netTimStage(netStgAttach), netTimStage(netStgConnect) + netTimStage(netStgTls), ret >= 0);
+	CHECK(ret >= 0, lblNoAnswer);
+	revQueueDisarm();                                               // Answered, no reversal needed
 
 	ret = rspParse(bufPtr(&bRsp), bufLen(&bRsp));   //parse response message
 	//CHECK(ret >= 0, lblKO); // AJ note: dont know why this is commented out
@@ -276,7 +426,17 @@ int performOlineTransaction(void){
 	mapPutWord(appShowControlPanel, wordTemp); ///Make sure the CPANEL is hidden from user No error
 	return TRUE;
 
+	lblNoAnswer:
+	if ((iCancel >= 0) && (iCancel < comStaSend)) {                 // Cancelled before the request left: nothing to reverse
+		revQueueDisarm();
+		mapPutByte(appReversalFlag, 0);
+	}                                                               // Otherwise the armed reversal goes as on a timeout
+	if (iCancel >= 0)
+		GL_Dialog_Message(hGoal, NULL, "Transaction Cancelled!!!", GL_ICON_ERROR, GL_BUTTON_NONE, 2 * GL_TIME_SECOND);
+	goto lblKO;
+
 	lblKO:
+	comStaClose();
 	wordTemp = 0;
 	mapPutWord(appShowControlPanel, wordTemp); ///Make sure the CPANEL is hidden from user even with error
 	return FALSE;
@@ -51,6 +51,8 @@ extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
 #define FONT_GOAL_LATIN_BI   0x3E7ACD7 // Domain(0x3E7=999) AppliType=ACD7 (Ingenico Font)
 #endif
 
+#define PRN_LOG_LINES        100       // Report lines per printed document, see prnLogPage
+
 
 const char *ISO_Resp[] = {
 		"Approved",
@@ -420,6 +422,14 @@ static const ST_PADDING xPadding = {4, 0, 4, 0};              // Padding propert
 static const ST_BORDER xBorder = {4, 4, 4, 4, GL_COLOR_BLACK}; // Border properties
 static const ST_MARGIN xMargin = {1, 10, 1, 10};               // Margin properties
 
+// Report printed from a log cursor: the document being built, printed and
+// made again every PRN_LOG_LINES lines
+typedef struct {
+	T_GL_HWIDGET *pxDocument;
+	T_GL_HWIDGET *pxLayout;
+	byte *pxLine;
+} tPrnLog;
+
 //****************************************************************************
 //      PRIVATE DATA                                                        
 //****************************************************************************
@@ -1620,34 +1630,93 @@ static void prnMapTransactionName(card MenuItem, char *NameOfTxn){
 
 }
 
+// Print the lines built so far and go on in a new document, so that the
+// widgets kept do not grow with the number of records.
+static int prnLogPage(tPrnLog *pxLog){
+	int ret;
+
+	if (*pxLog->pxLine < PRN_LOG_LINES)
+		return 1;
+
+	ret = GoalPrnDocument(*pxLog->pxDocument);
+	CHECK(ret >= 0, lblKO);
+	GoalDestroyDocument(pxLog->pxDocument);
+	*pxLog->pxDocument = GoalCreateDocument(hGoal, GL_ENCODING_UTF8);
+	CHECK(*pxLog->pxDocument != NULL, lblKO);
+	*pxLog->pxLayout = GL_Layout_Create(*pxLog->pxDocument);
+	*pxLog->pxLine = 0;
+	return 1;
+
+	lblKO:
+	return -1;
+}
+
+// Line of the detailed report, for each record given by sqlite_Log_Each.
+static int prnLogRecord(const tSqlRow *Row, void *Ctx){
+	tPrnLog *pxLog = (tPrnLog *)Ctx;
+	T_GL_HWIDGET xPrint;
+	char PrintData[256 + 1];
+	char amount[20 + 1];
+	char date[16 + 1];
+	char transactionName[100];
+	const char *DatTim;
+
+	memset(transactionName, 0, sizeof(transactionName));
+	memset(amount, 0, sizeof(amount));
+	memset(date, 0, sizeof(date));
+
+	fmtAmt(amount, Row->Text[logRowAmount], 2, ".,");
+	DatTim = Row->Text[logRowDatTim];                    // transaction date - CCYYMMDDhhmmss
+	if (strlen(DatTim) >= 12) {
+		strncpy(date, &DatTim[8], 2); strcat(date, ":");
+		strncpy(&date[3], &DatTim[10], 2);
+	}
+	prnMapTransactionName((card)Row->Int[logRowMenuItem], transactionName);
+
+	//date and transaction name
+	memset(PrintData, 0, sizeof(PrintData));
+	strcpy(PrintData, date);               strcat(PrintData,"     ");
+	strncat(PrintData,transactionName,8);
+	xPrint = GL_Print_Create    (*pxLog->pxLayout);
+	GL_Widget_SetText      (xPrint, PrintData);
+	GL_Widget_SetItem      (xPrint, 0, *pxLog->pxLine);
+	GL_Widget_SetMargins   (xPrint, 0, 0, 0, 0, GL_UNIT_PIXEL);
+	GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
+	GL_Widget_SetBackAlign (xPrint, GL_ALIGN_LEFT);
+
+	memset(PrintData, 0, sizeof(PrintData));
+	strncpy(PrintData, Row->Text[logRowAutCod], lenAutCod);
+	xPrint = GL_Print_Create    (*pxLog->pxLayout);
+	GL_Widget_SetText      (xPrint, PrintData);
+	GL_Widget_SetItem      (xPrint, 0, *pxLog->pxLine);
+	GL_Widget_SetMargins   (xPrint, 39, 0, 0, 0, GL_UNIT_PIXEL);
+	GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
+	GL_Widget_SetBackAlign (xPrint, GL_ALIGN_CENTER);
+
+	memset(PrintData, 0, sizeof(PrintData));
+	strcpy(PrintData,amount);
+	xPrint = GL_Print_Create    (*pxLog->pxLayout);
+	GL_Widget_SetText      (xPrint, PrintData);
+	GL_Widget_SetItem      (xPrint, 0, (*pxLog->pxLine)++);
+	GL_Widget_SetMargins   (xPrint, 0, 0, 3, 0, GL_UNIT_PIXEL);
+	GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
+	GL_Widget_SetBackAlign (xPrint, GL_ALIGN_RIGHT);
+
+	return prnLogPage(pxLog);
+}
+
 int PrintDetailedLog(void){
 	// Local variables
 	// ***************
 	T_GL_HWIDGET xDocument = NULL;
 	T_GL_HWIDGET xLayout;
 	T_GL_HWIDGET xPrint;
-	char PrintData[256 + 1];
+	tPrnLog xPrnLog;
 	byte xline = 0;
 	int ret = 0;
-	int var = 0, rec = 0, var2 = 0;
-	char Statement[512];
-	char DataResponse[10240];
-	int NumOfRecords = 0;
-	int NumberOfColumns = 0;
-	char *Raw_Columns;
-	char *Columns_Array[40];
-	char *EntryData;
-	char *EntryArray[40];
-	char Single_Column_Buffer[256];
-	char Column_Name[32];
-	char Column_Data[32];
+	int var2 = 0;
 	///----------------
 	char amount[20 + 1];
-	char date[16 + 1];
-	char aprv[8 + 1];
-	char CardNumber[lenPan + 1];
-	char transactionName[100];
-	card mnuItm = 0;
 	char CurrencyAlpha[64 + 1];
 	char CurrencyNumeric[64 + 1];
 	char Dr[lenAmt + 1], Cr[lenAmt + 1];
@@ -1664,15 +1733,12 @@ int PrintDetailedLog(void){
 	memset(DrRev, 0, sizeof(DrRev));
 	memset(CrRev, 0, sizeof(CrRev));
 	memset(Totals, 0, sizeof(Totals));
-	memset(CardNumber, 0, sizeof(CardNumber));
 	memset(CurrencyAlpha, 0, sizeof(CurrencyAlpha));
 	memset(CurrencyNumeric, 0, sizeof(CurrencyNumeric));
-	memset(DataResponse, 0, sizeof(DataResponse));
-	memset(Statement, 0, sizeof(Statement));
-	memset(transactionName, 0, sizeof(transactionName));
 	memset(amount, 0, sizeof(amount));
-	memset(date, 0, sizeof(date));
-	memset(aprv, 0, sizeof(aprv));
+	xPrnLog.pxDocument = &xDocument;
+	xPrnLog.pxLayout = &xLayout;
+	xPrnLog.pxLine = &xline;
 
 	OpenPeripherals();
 
@@ -1743,115 +1809,9 @@ int PrintDetailedLog(void){
 
 		///&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&
 
-		///get number of records
-		strcpy(Statement,"SELECT COUNT(*) FROM log;");
-		ret = Sqlite_Run_Statement(Statement,DataResponse);
-		CHECK(ret > 0,lblKO);
-		NumOfRecords = atoi(DataResponse) + 1;
-
-		for (var = 1; var < NumOfRecords; var++) {
-			memset(Statement, 0, sizeof(Statement));
-
-			///------ get record by order of entry -------
-			Telium_Sprintf(Statement,"SELECT isoField002, isoField004, isoField007, isoField038, MenuItem FROM log WHERE isoField039 = '00' AND id = '%d' AND isoField049 = '%s' AND MenuItem != '%d';", var, CurrencyNumeric, mnuBalanceEnquiry);
-			ret = Sqlite_Run_Statement_MultiRecord(Statement, DataResponse);
-
-			/////------- check if its a valid record ------------
-			if (strlen(DataResponse) > 9) {
-				//Clear Data for printing Buffer readiness
-				memset(transactionName, 0, sizeof(transactionName));
-				memset(amount, 0, sizeof(amount));
-				memset(date, 0, sizeof(date));
-				memset(aprv, 0, sizeof(aprv));
-
-				NumberOfColumns = count_chars(DataResponse,';');
-
-				//// ----------- split the columns into an array ---------------
-				Raw_Columns = strtok(DataResponse,";");//column separator
-				Columns_Array[0] = Raw_Columns;
-
-				for(rec = 1;rec < NumberOfColumns; rec++){
-					if(Raw_Columns == NULL)break;
-
-					Raw_Columns = strtok(NULL,";");
-					Columns_Array[rec] = Raw_Columns;
-				}
-
-				//look for the column data
-				for(rec = 0;rec < NumberOfColumns; rec++){
-					memset(Single_Column_Buffer, 0, sizeof(Single_Column_Buffer));
-					memset(Column_Name, 0, sizeof(Column_Name));
-					memset(Column_Data, 0, sizeof(Column_Data));
-					strcpy(Single_Column_Buffer, Columns_Array[rec]);
-
-					EntryData = strtok(Single_Column_Buffer,",");//column data separator
-					EntryArray[0] = EntryData;
-					strcpy(Column_Name, EntryArray[0]);
-
-					EntryData = strtok(NULL,",");
-					if (EntryData != NULL) {
-						EntryArray[1] = EntryData;
-						strcpy(Column_Data, EntryArray[1]);
-					}
-
-					if (strncmp(Column_Name,"isoField004",11) == 0) {////amount
-						fmtAmt(&amount[0],Column_Data,2,".,");
-					} else if (strncmp(Column_Name,"isoField007",11) == 0) {////transaction date - CCYYMMDDhhmmss
-						strncpy(date,&Column_Data[8],2); strcat(date,":");
-						strncpy(&date[3],&Column_Data[10],2);
-					} else if (strncmp(Column_Name,"isoField038",11) == 0) {
-						strcpy(aprv,Column_Data);
-					} else if (strncmp(Column_Name,"isoField002",11) == 0) {
-						MaskPan_Other(Column_Data, CardNumber);
-					} else if (strncmp(Column_Name,"MenuItem",8) == 0) {
-						memset(transactionName, 0, sizeof(transactionName));
-						memset(Statement, 0, sizeof(Statement));
-						dec2num(&mnuItm, Column_Data,0);
-						prnMapTransactionName(mnuItm, transactionName);
-					}
-				}
-
-				//date and transaction name
-				memset(PrintData, 0, sizeof(PrintData));
-				strcpy(PrintData, date);               strcat(PrintData,"     ");
-				strncat(PrintData,transactionName,8);
-				xPrint = GL_Print_Create    (xLayout);
-				GL_Widget_SetText      (xPrint, PrintData);
-				GL_Widget_SetItem      (xPrint, 0, xline);
-				GL_Widget_SetMargins   (xPrint, 0, 0, 0, 0, GL_UNIT_PIXEL);
-				GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
-				GL_Widget_SetBackAlign (xPrint, GL_ALIGN_LEFT);
-
-				//				//card number masked
-				//				xPrint = GL_Print_Create    (xLayout);
-				//				GL_Widget_SetText      (xPrint, CardNumber);
-				//				GL_Widget_SetItem      (xPrint, 0, xline++);
-				//				GL_Widget_SetMargins   (xPrint, 0, 0, 3, 0, GL_UNIT_PIXEL);
-				//				GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
-				//				GL_Widget_SetBackAlign (xPrint, GL_ALIGN_RIGHT);
-
-
-				memset(PrintData, 0, sizeof(PrintData));
-				strcpy(PrintData,aprv);
-				xPrint = GL_Print_Create    (xLayout);
-				GL_Widget_SetText      (xPrint, PrintData);
-				GL_Widget_SetItem      (xPrint, 0, xline);
-				GL_Widget_SetMargins   (xPrint, 39, 0, 0, 0, GL_UNIT_PIXEL);
-				GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
-				GL_Widget_SetBackAlign (xPrint, GL_ALIGN_CENTER);
-
-
-				memset(PrintData, 0, sizeof(PrintData));
-				strcpy(PrintData,amount);
-				xPrint = GL_Print_Create    (xLayout);
-				GL_Widget_SetText      (xPrint, PrintData);
-				GL_Widget_SetItem      (xPrint, 0, xline++);
-				GL_Widget_SetMargins   (xPrint, 0, 0, 3, 0, GL_UNIT_PIXEL);
-				GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
-				GL_Widget_SetBackAlign (xPrint, GL_ALIGN_RIGHT);
-			}
-			memset(CardNumber, 0, sizeof(CardNumber));
-		}
+		///------ the records one at a time, printed in pages -------
+		ret = sqlite_Log_Each(CurrencyNumeric, prnLogRecord, &xPrnLog);
+		CHECK(ret >= 0, lblKO);
 
 		xPrint = GL_Print_Create    (xLayout);
 		GL_Widget_SetText      (xPrint, "-------------------------------------------");
@@ -2070,6 +2030,51 @@ int PrintDuplicateReceipt(void){
 }
 
 
+// Line of the summary report, for each menu item given by sqlite_Log_Groups.
+static int prnLogGroup(const tSqlRow *Row, void *Ctx){
+	tPrnLog *pxLog = (tPrnLog *)Ctx;
+	T_GL_HWIDGET xPrint;
+	char PrintData[25 + 1];
+	char MenuName[20 + 1];
+	char GroupTotals[20 + 1];
+
+	memset(MenuName, 0, sizeof(MenuName));
+	memset(GroupTotals, 0, sizeof(GroupTotals));
+	strncpy(MenuName, Row->Text[logGrpName], 20);
+
+	xPrint = GL_Print_Create    (*pxLog->pxLayout);
+	GL_Widget_SetText      (xPrint, MenuName);
+	GL_Widget_SetItem      (xPrint, 0, *pxLog->pxLine);
+	GL_Widget_SetMargins   (xPrint, 0, 0, 0, 0, GL_UNIT_PIXEL);
+	GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
+	GL_Widget_SetBackAlign (xPrint, GL_ALIGN_LEFT);
+	GL_Widget_SetWrap(xPrint, FALSE);
+
+	memset(PrintData, 0, sizeof(PrintData));
+	strncpy(PrintData, Row->Text[logGrpCount], 4);
+	xPrint = GL_Print_Create    (*pxLog->pxLayout);
+	GL_Widget_SetText      (xPrint, PrintData);
+	GL_Widget_SetItem      (xPrint, 0, *pxLog->pxLine);
+	GL_Widget_SetMargins   (xPrint, 20, 0, 0, 0, GL_UNIT_PIXEL);
+	GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
+	GL_Widget_SetBackAlign (xPrint, GL_ALIGN_CENTER);
+	GL_Widget_SetWrap(xPrint, FALSE);
+
+	fmtAmt(GroupTotals, Row->Text[logGrpAmount], 2, ".,");
+
+	memset(PrintData, 0, sizeof(PrintData));
+	strcpy(PrintData,GroupTotals);
+	xPrint = GL_Print_Create    (*pxLog->pxLayout);
+	GL_Widget_SetText      (xPrint, PrintData);
+	GL_Widget_SetItem      (xPrint, 0, (*pxLog->pxLine)++);
+	GL_Widget_SetMargins   (xPrint, 0, 0, 10, 0, GL_UNIT_PIXEL);
+	GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
+	GL_Widget_SetBackAlign (xPrint, GL_ALIGN_RIGHT);
+	GL_Widget_SetWrap(xPrint, FALSE);
+
+	return prnLogPage(pxLog);
+}
+
 int PrintSummaryLog(void){
 	// Local variables
 	// ***************
@@ -2077,22 +2082,14 @@ int PrintSummaryLog(void){
 	T_GL_HWIDGET xLayout;
 	T_GL_HWIDGET xPrint;
 	char PrintData[25 + 1];
+	tPrnLog xPrnLog;
 
 	byte xline = 0;
 	int ret = 0;
 
-	char menuWordArray[100][100];
-	char *Raw_Menus;
-	card CurrentMenuSelected = 0;
-	char CurrentMenuStrSelected[4 + 1];
-	char CurrentMenuCount[4 + 1];
-	char MenuName[20 + 1];
-	int var = 0, var2 = 0;
+	int var2 = 0;
 	char Statement[256];
-	char DataResponse[256];
-	int NumOfRecords = 0;
 	///----------------
-	char GroupTotals[20 + 1];
 	char Dr[lenAmt + 1], Cr[lenAmt + 1];
 	char DrCount[lenAmt + 1], CrCount[lenAmt + 1];
 	char DrRev[lenAmt + 1], CrRev[lenAmt + 1];
@@ -2108,6 +2105,9 @@ int PrintSummaryLog(void){
 	memset(Totals, 0, sizeof(Totals));
 	memset(CurrencyAlpha, 0, sizeof(CurrencyAlpha));
 	memset(CurrencyNumeric, 0, sizeof(CurrencyNumeric));
+	xPrnLog.pxDocument = &xDocument;
+	xPrnLog.pxLayout = &xLayout;
+	xPrnLog.pxLine = &xline;
 
 	OpenPeripherals();
 
@@ -2120,7 +2120,6 @@ int PrintSummaryLog(void){
 	CHECK(xDocument!=NULL, lblKO);                  // Create texts document
 
 	xLayout = GL_Layout_Create(xDocument); //set the document layout
-	memset(DataResponse, 0, sizeof(DataResponse));
 
 	///&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&   Print Logo    &&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&
 	xline = printLogo(xLayout, xline);
@@ -2172,92 +2171,9 @@ int PrintSummaryLog(void){
 
 		///&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&&
 
-		///get number of records
-		logGetUniqueTransactionRecordMenus(DataResponse);
-		NumOfRecords = count_chars(DataResponse,'#') + 1;
-
-		if(strlen(DataResponse)<1)
-			NumOfRecords = 0;
-
-		memset(menuWordArray[0], 0, sizeof(menuWordArray[0]));
-		Raw_Menus = strtok(DataResponse,"#");//column separator
-
-		if(Raw_Menus != NULL)
-			strcpy(menuWordArray[0], Raw_Menus);
-
-		for (var = 1; var < NumOfRecords; var++) {
-			memset(menuWordArray[var], 0, sizeof(menuWordArray[var]));
-			Raw_Menus = strtok(NULL,"#");//column separator
-			strcpy(menuWordArray[var], Raw_Menus);
-		}
-		memset(menuWordArray[var], 0, sizeof(menuWordArray[var]));
-
-		//=================== start looping for transactions ======================
-		for (var = 0; var < NumOfRecords; var++) {
-			memset(MenuName, 0, sizeof(MenuName));
-			memset(GroupTotals, 0, sizeof(GroupTotals));
-			memset(CurrentMenuCount, 0, sizeof(CurrentMenuCount));
-
-			memset(CurrentMenuStrSelected, 0, sizeof(CurrentMenuStrSelected));
-			strcpy(CurrentMenuStrSelected, menuWordArray[var]);
-			dec2num(&CurrentMenuSelected, menuWordArray[var], 0);
-
-			if (CurrentMenuSelected == mnuBalanceEnquiry) {
-				continue;
-			}
-
-
-			///------ get name of selected first group of transactions(Menu) -------
-			memset(DataResponse, 0, sizeof(DataResponse));
-			memset(Statement, 0, sizeof(Statement));
-			Telium_Sprintf(Statement, "SELECT MenuName FROM AppMenus WHERE MenuId = '%d';", CurrentMenuSelected);
-			ret = Sqlite_Run_Statement_MultiRecord(Statement,DataResponse);
-			strncpy(MenuName, DataResponse, 20);
-
-			xPrint = GL_Print_Create    (xLayout);
-			GL_Widget_SetText      (xPrint, MenuName);
-			GL_Widget_SetItem      (xPrint, 0, xline);
-			GL_Widget_SetMargins   (xPrint, 0, 0, 0, 0, GL_UNIT_PIXEL);
-			GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
-			GL_Widget_SetBackAlign (xPrint, GL_ALIGN_LEFT);
-			GL_Widget_SetWrap(xPrint, FALSE);
-
-
-
-			///------ get Count of selected group of transactions(Menu) -------
-			memset(DataResponse, 0, sizeof(DataResponse));
-			memset(Statement, 0, sizeof(Statement));
-			Telium_Sprintf(Statement,"SELECT count(*) FROM log WHERE isoField039 = '00' AND MenuItem = '%s' AND isoField049 = '%s';",CurrentMenuStrSelected, CurrencyNumeric);
-			ret = Sqlite_Run_Statement_MultiRecord(Statement,DataResponse);
-			strncpy(CurrentMenuCount, DataResponse, strlen(DataResponse));
-
-			xPrint = GL_Print_Create    (xLayout);
-			GL_Widget_SetText      (xPrint, CurrentMenuCount);
-			GL_Widget_SetItem      (xPrint, 0, xline);
-			GL_Widget_SetMargins   (xPrint, 20, 0, 0, 0, GL_UNIT_PIXEL);
-			GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
-			GL_Widget_SetBackAlign (xPrint, GL_ALIGN_CENTER);
-			GL_Widget_SetWrap(xPrint, FALSE);
-
-			///------ get amount of selected group of transactions(Menu) -------
-			memset(DataResponse, 0, sizeof(DataResponse));
-			memset(Statement, 0, sizeof(Statement));
-			Telium_Sprintf(Statement,"SELECT SUM(isoField004) FROM log WHERE isoField039 = '00' AND MenuItem = '%d' AND isoField049 = '%s';",CurrentMenuSelected, CurrencyNumeric);
-			ret = Sqlite_Run_Statement_MultiRecord(Statement,DataResponse);
-
-			fmtAmt(GroupTotals,DataResponse,2,".,");
-			//		fmtPad(GroupTotals,18,' ');
-
-			memset(PrintData, 0, sizeof(PrintData));
-			strcpy(PrintData,GroupTotals);
-			xPrint = GL_Print_Create    (xLayout);
-			GL_Widget_SetText      (xPrint, PrintData);
-			GL_Widget_SetItem      (xPrint, 0, xline++);
-			GL_Widget_SetMargins   (xPrint, 0, 0, 10, 0, GL_UNIT_PIXEL);
-			GL_Widget_SetFontScale (xPrint, GL_SCALE_SMALL);
-			GL_Widget_SetBackAlign (xPrint, GL_ALIGN_RIGHT);
-			GL_Widget_SetWrap(xPrint, FALSE);
-		}
+		///------ totals of each transaction type (menu) -------
+		ret = sqlite_Log_Groups(CurrencyNumeric, prnLogGroup, &xPrnLog);
+		CHECK(ret >= 0, lblKO);
 
 		xPrint = GL_Print_Create    (xLayout);
 		GL_Widget_SetText      (xPrint, "-------------------------------------------");
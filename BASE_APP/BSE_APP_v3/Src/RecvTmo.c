@@ -0,0 +1,185 @@
+/*
+ * RecvTmo.c
+ *
+ *  Receive timeout of the online exchanges, estimated per transport and
+ *  host from the round trips measured, the way TCP computes its RTO
+ *  (RFC 6298): smoothed RTT plus four times its mean deviation, kept
+ *  between the floor and ceiling set in appRcvTmoMin/appRcvTmoMax.
+ *  Unlike TCP a timeout does not double the next one: each exchange is a
+ *  new transaction, and a dead host would be waited for longer and longer.
+ *  It only brings the timeout back to the former fixed 30s; above that it
+ *  grows from measured answers only.
+ *  A timeout too short turns a late approval into a reversal, hence the
+ *  floor, which must stay above the time the host may take to get the
+ *  issuer answer: by default the former fixed 30s, so the estimator only
+ *  ever waits longer than the fixed timeout did, for a host measured slow.
+ */
+#include <globals.h>
+#include "perf_log.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define RTO_SLOTS      8               // Transport + host pairs followed
+#define RTO_INIT       30000           // Before any sample: the former fixed timeout (ms)
+#define RTO_MIN_DFT    30              // Floor when appRcvTmoMin is not set (s)
+#define RTO_MAX_DFT    60              // Ceiling when appRcvTmoMax is not set (s)
+#define RTO_GRANULE    1000            // Smallest variance term (ms)
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	byte ucRoute;                      // appCommRoute of the transport
+	char tcHost[lenGprsIpRemote+lenGprsPort+1+1];   // "ip|port"
+	card ulSrtt;                       // Smoothed RTT (ms)
+	card ulVar;                        // Mean deviation of the RTT (ms)
+	card ulRto;                        // Next timeout (ms)
+	byte ucSampled;                    // At least one RTT sample
+	card ulUsed;                       // Use counter (replacement)
+	byte ucClamp;                      // Bound applied to the last timeout given (rtoXxx)
+} tRecvTmo;
+
+enum {                                 // Bound applied by rcvTmoClamp
+	rtoFree,
+	rtoFloor,
+	rtoCeiling,
+};
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tRecvTmo tzRto[RTO_SLOTS];
+static card ulUseCnt = 0;
+
+static card rcvTmoParam(int iKey, int iDft) {
+	char tcVal[6 + 1];
+	int iVal = 0;
+
+	memset(tcVal, 0, sizeof(tcVal));
+	if (appGet(iKey, tcVal, sizeof(tcVal)) >= 0)
+		iVal = atoi(tcVal);
+	if ((iVal <= 0) || (iVal > 254))                   // 0xFF means infinite to the receivers
+		iVal = iDft;
+	return (card)iVal * 1000;
+}
+
+// Timeout of a host kept between the floor and the ceiling. Logged when
+// the bound applied changes, not on every exchange.
+static card rcvTmoClamp(tRecvTmo *pxRto) {
+	card ulMin = rcvTmoParam(appRcvTmoMin, RTO_MIN_DFT);
+	card ulMax = rcvTmoParam(appRcvTmoMax, RTO_MAX_DFT);
+	card ulRto = pxRto->ulRto;
+	byte ucClamp = rtoFree;
+
+	if (ulMax < ulMin)
+		ulMax = ulMin;
+	if (ulRto < ulMin) {
+		ulRto = ulMin;
+		ucClamp = rtoFloor;
+	} else if (ulRto > ulMax) {
+		ulRto = ulMax;
+		ucClamp = rtoCeiling;
+	}
+
+	if (ucClamp != pxRto->ucClamp) {
+		if (ucClamp == rtoFloor)
+			perflog("RCVTMO floor");
+		else if (ucClamp == rtoCeiling)
+			perflog("RCVTMO ceiling");
+		else
+			perflog("RCVTMO estimated");
+		pxRto->ucClamp = ucClamp;
+	}
+	return ulRto;
+}
+
+static tRecvTmo *rcvTmoFind(byte ucRoute, const char *pcHost) {
+	tRecvTmo *pxOld = &tzRto[0];
+	int iIdx;
+
+	ulUseCnt++;
+	for (iIdx=0; iIdx<RTO_SLOTS; iIdx++) {
+		if ((tzRto[iIdx].ucRoute == ucRoute) && (strcmp(tzRto[iIdx].tcHost, pcHost) == 0)) {
+			tzRto[iIdx].ulUsed = ulUseCnt;
+			return &tzRto[iIdx];
+		}
+		if (tzRto[iIdx].ulUsed < pxOld->ulUsed)
+			pxOld = &tzRto[iIdx];                      // Free slots have ulUsed 0
+	}
+
+	memset(pxOld, 0, sizeof(*pxOld));
+	pxOld->ucRoute = ucRoute;
+	strncpy(pxOld->tcHost, pcHost, sizeof(pxOld->tcHost) - 1);
+	pxOld->ulRto = RTO_INIT;
+	pxOld->ulUsed = ulUseCnt;
+	return pxOld;
+}
+
+//****************************************************************************
+//          byte rcvTmoGet (byte ucRoute, const char *pcHost)
+//  This function gives the receive timeout to use for the next exchange
+//  with a host, and records it with the net timing of the exchange and,
+//  for a background sender, as the bound of the foreground waiting for it.
+//  This function has parameters.
+//    ucRoute (I-) : Transport (appCommRoute)
+//    pcHost (I-) : Host as "ip|port"
+//  This function has return value
+//    Timeout in seconds
+//****************************************************************************
+byte rcvTmoGet(byte ucRoute, const char *pcHost) {
+	card ulRto = rcvTmoClamp(rcvTmoFind(ucRoute, pcHost));
+	byte ucTmo = (byte)((ulRto + 999) / 1000);
+
+	netTimTimeout(ulRto);
+	onlBgExpect(ucTmo * 1000);
+	return ucTmo;
+}
+
+//****************************************************************************
+//     void rcvTmoSample (byte ucRoute, const char *pcHost, card ulRtt)
+//  This function folds a measured round trip into the estimate of a host:
+//  RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - RTT|, SRTT = 7/8 SRTT + 1/8 RTT,
+//  RTO = SRTT + max(1s, 4 RTTVAR).
+//  This function has parameters.
+//    ucRoute (I-) : Transport (appCommRoute)
+//    pcHost (I-) : Host as "ip|port"
+//    ulRtt (I-) : Request sent -> answer received (ms)
+//  This function has no return value
+//****************************************************************************
+void rcvTmoSample(byte ucRoute, const char *pcHost, card ulRtt) {
+	tRecvTmo *pxRto = rcvTmoFind(ucRoute, pcHost);
+	card ulDev, ulK;
+
+	if (!pxRto->ucSampled) {
+		pxRto->ulSrtt = ulRtt;
+		pxRto->ulVar = ulRtt / 2;
+		pxRto->ucSampled = 1;
+	} else {
+		ulDev = (pxRto->ulSrtt > ulRtt) ? (pxRto->ulSrtt - ulRtt) : (ulRtt - pxRto->ulSrtt);
+		pxRto->ulVar = (pxRto->ulVar * 3 + ulDev) / 4;
+		pxRto->ulSrtt = (pxRto->ulSrtt * 7 + ulRtt) / 8;
+	}
+
+	ulK = pxRto->ulVar * 4;
+	if (ulK < RTO_GRANULE)
+		ulK = RTO_GRANULE;
+	pxRto->ulRto = pxRto->ulSrtt + ulK;
+}
+
+//****************************************************************************
+//         void rcvTmoExpired (byte ucRoute, const char *pcHost)
+//  This function records that a host did not answer in time: the next
+//  timeout is at least the former fixed one until an answer comes back.
+//  This function has parameters.
+//    ucRoute (I-) : Transport (appCommRoute)
+//    pcHost (I-) : Host as "ip|port"
+//  This function has no return value
+//****************************************************************************
+void rcvTmoExpired(byte ucRoute, const char *pcHost) {
+	tRecvTmo *pxRto = rcvTmoFind(ucRoute, pcHost);
+
+	perflog("RCVTMO expired");
+	if (pxRto->ulRto < RTO_INIT)
+		pxRto->ulRto = RTO_INIT;
+}
@@ -0,0 +1,210 @@
+/*
+ * SimPred.c
+ *
+ *  Link quality history of the two SIM slots and choice of the SIM to use.
+ *  Each SIM keeps smoothed radio level, attach time, connect time and
+ *  failure rate. The expected cost of an exchange on each SIM is derived
+ *  from them, old history fades back to a neutral prior so a SIM left aside
+ *  gets another chance, and a switch needs a clear gain plus a minimum
+ *  dwell time, since the switch itself costs a new attach.
+ *  No terminal API is used here: times are given by the caller, so the same
+ *  code runs in the host simulation (Tools/SimPred).
+ */
+#include <globals.h>
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define SIMP_NBR         2
+#define SIMP_PRIOR_ATT   3000          // Prior attach time (ms)
+#define SIMP_PRIOR_CNX   1500          // Prior connect time (ms)
+#define SIMP_PRIOR_FAIL  100           // Prior failure rate (per 1000)
+#define SIMP_PRIOR_RADIO 3
+#define SIMP_FAIL_COST   30000         // A failure costs a receive timeout (ms)
+#define SIMP_RADIO_GOOD  3             // Level from which the radio adds no risk
+#define SIMP_RADIO_COST  2000          // Cost per level below SIMP_RADIO_GOOD (ms)
+#define SIMP_STALE       (30*60*1000L) // History fully faded after 30 minutes
+#define SIMP_GAIN_PCT    75            // Other SIM must cost less than 75% ...
+#define SIMP_GAIN_MIN    2000          // ... and at least 2s less
+#define SIMP_DWELL       (10*60*1000L) // Minimum time between two switches
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	card ulRadio;                      // Smoothed radio level x 100
+	card ulAttach;                     // Smoothed attach time (ms)
+	card ulConnect;                    // Smoothed connect time (ms)
+	card ulFail;                       // Smoothed failure rate (per 1000)
+	card ulLast;                       // Time of the last sample (ms)
+	word usSamples;
+} tSimPred;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tSimPred tzSim[SIMP_NBR];
+static byte ucInit = 0;
+static card ulSwitched = 0;            // Time of the last switch (ms)
+static byte ucSwitchedSet = 0;
+
+static card simPredAvg(card ulOld, card ulNew) { // 1/4 weight to the new sample
+	return (ulOld * 3 + ulNew) / 4;
+}
+
+static card simPredAvgSlow(card ulOld, card ulNew) { // 1/8: one failure alone is no trend
+	return (ulOld * 7 + ulNew) / 8;
+}
+
+//****************************************************************************
+//                        void simPredInit (void)
+//  This function resets the history of both SIMs to the prior.
+//  This function has no parameters.
+//  This function has no return value
+//****************************************************************************
+void simPredInit(void) {
+	int iSim;
+
+	for (iSim=0; iSim<SIMP_NBR; iSim++) {
+		tzSim[iSim].ulRadio = SIMP_PRIOR_RADIO * 100;
+		tzSim[iSim].ulAttach = SIMP_PRIOR_ATT;
+		tzSim[iSim].ulConnect = SIMP_PRIOR_CNX;
+		tzSim[iSim].ulFail = SIMP_PRIOR_FAIL;
+		tzSim[iSim].ulLast = 0;
+		tzSim[iSim].usSamples = 0;
+	}
+	ucSwitchedSet = 0;
+	ucInit = 1;
+}
+
+//****************************************************************************
+//       void simPredRadio (int iSim, int iRadio, card ulNow)
+//  This function records a radio level reading of the SIM in use.
+//  This function has parameters.
+//    iSim (I-) : SIM (0..1)
+//    iRadio (I-) : Radio level as reported by the GPRS driver
+//    ulNow (I-) : Current time (ms)
+//  This function has no return value
+//****************************************************************************
+void simPredRadio(int iSim, int iRadio, card ulNow) {
+	if ((iSim < 0) || (iSim >= SIMP_NBR) || (iRadio < 0))
+		return;
+	if (!ucInit)
+		simPredInit();
+	tzSim[iSim].ulRadio = simPredAvg(tzSim[iSim].ulRadio, (card)iRadio * 100);
+	tzSim[iSim].ulLast = ulNow;
+	if (tzSim[iSim].usSamples < 0xFFFF)
+		tzSim[iSim].usSamples++;
+}
+
+//****************************************************************************
+// void simPredSample (int iSim, card ulAttach, card ulConnect, int iOk, card ulNow)
+//  This function records the outcome of an exchange on the SIM in use.
+//  This function has parameters.
+//    iSim (I-) : SIM (0..1)
+//    ulAttach (I-) : Attach time (ms), 0 when not measured
+//    ulConnect (I-) : Connect time (ms), 0 when not measured
+//    iOk (I-) : 1 when the host answered
+//    ulNow (I-) : Current time (ms)
+//  This function has no return value
+//****************************************************************************
+void simPredSample(int iSim, card ulAttach, card ulConnect, int iOk, card ulNow) {
+	tSimPred *pxSim;
+
+	if ((iSim < 0) || (iSim >= SIMP_NBR))
+		return;
+	if (!ucInit)
+		simPredInit();
+
+	pxSim = &tzSim[iSim];
+	if (ulAttach)
+		pxSim->ulAttach = simPredAvg(pxSim->ulAttach, ulAttach);
+	if (ulConnect)
+		pxSim->ulConnect = simPredAvg(pxSim->ulConnect, ulConnect);
+	pxSim->ulFail = simPredAvgSlow(pxSim->ulFail, iOk ? 0 : 1000);
+	pxSim->ulLast = ulNow;
+	if (pxSim->usSamples < 0xFFFF)
+		pxSim->usSamples++;
+}
+
+//****************************************************************************
+//            card simPredScore (int iSim, card ulNow)
+//  This function returns the expected cost of an exchange on a SIM, in ms:
+//  attach + connect + failure rate x timeout + weak radio penalty. The
+//  older the history, the closer the cost to the one of the prior.
+//  This function has parameters.
+//    iSim (I-) : SIM (0..1)
+//    ulNow (I-) : Current time (ms)
+//  This function has return value
+//    Expected cost (ms)
+//****************************************************************************
+card simPredScore(int iSim, card ulNow) {
+	const tSimPred *pxSim;
+	card ulCost, ulPrior, ulAge;
+	long lRadio;
+
+	if ((iSim < 0) || (iSim >= SIMP_NBR))
+		return 0xFFFFFFFF;
+	if (!ucInit)
+		simPredInit();
+
+	pxSim = &tzSim[iSim];
+	lRadio = SIMP_RADIO_GOOD * 100 - (long)pxSim->ulRadio;
+	ulCost = pxSim->ulAttach + pxSim->ulConnect
+			+ (pxSim->ulFail * SIMP_FAIL_COST) / 1000
+			+ ((lRadio > 0) ? (card)(lRadio * SIMP_RADIO_COST / 100) : 0);
+	ulPrior = SIMP_PRIOR_ATT + SIMP_PRIOR_CNX + (SIMP_PRIOR_FAIL * SIMP_FAIL_COST) / 1000;
+
+	if (pxSim->usSamples == 0)
+		return ulPrior;
+	ulAge = ulNow - pxSim->ulLast;
+	if (ulAge >= SIMP_STALE)
+		return ulPrior;
+
+	// Linear fade to the prior, in seconds: costs stay far below 2^21 ms so
+	// the products fit in 32 bits
+	ulAge /= 1000;
+	return (ulCost * (SIMP_STALE / 1000 - ulAge) + ulPrior * ulAge) / (SIMP_STALE / 1000);
+}
+
+//****************************************************************************
+//             int simPredChoose (int iCur, card ulNow)
+//  This function tells which SIM should carry the next exchanges. The other
+//  SIM is chosen only when clearly cheaper and when the last switch is old
+//  enough; the caller performs the switch and reports it with
+//  simPredSwitched.
+//  This function has parameters.
+//    iCur (I-) : SIM in use (0..1)
+//    ulNow (I-) : Current time (ms)
+//  This function has return value
+//    SIM to use (0..1)
+//****************************************************************************
+int simPredChoose(int iCur, card ulNow) {
+	card ulCur, ulOther;
+	int iOther;
+
+	if ((iCur < 0) || (iCur >= SIMP_NBR))
+		return 0;
+	if (ucSwitchedSet && ((ulNow - ulSwitched) < SIMP_DWELL))
+		return iCur;
+
+	iOther = (iCur + 1) % SIMP_NBR;
+	ulCur = simPredScore(iCur, ulNow);
+	ulOther = simPredScore(iOther, ulNow);
+
+	if ((ulOther * 100 < ulCur * SIMP_GAIN_PCT) && (ulCur - ulOther >= SIMP_GAIN_MIN))
+		return iOther;
+	return iCur;
+}
+
+//****************************************************************************
+//                 void simPredSwitched (card ulNow)
+//  This function records that the SIM was just switched.
+//  This function has parameters.
+//    ulNow (I-) : Current time (ms)
+//  This function has no return value
+//****************************************************************************
+void simPredSwitched(card ulNow) {
+	ulSwitched = ulNow;
+	ucSwitchedSet = 1;
+}
@@ -30,18 +30,90 @@ char DataBaseName[100];
  *		PRIVATE DATA
  ****************************************************************************/
 sqlite3 *handle;
-sqlite3_stmt *stmt;
 static int bCallBack;
 
 /****************************************************************************
  *		PRIVATE CONSTANTS
  ****************************************************************************/
+// Store-and-forward advice queue (Status: 0 pending, 2 retries exhausted)
+#define ADVICE_TABLE "CREATE TABLE IF NOT EXISTS advice (id INTEGER PRIMARY KEY AUTOINCREMENT, DateTimeStamp TEXT DEFAULT CURRENT_TIMESTAMP, STAN TEXT NOT NULL UNIQUE, MenuItem TEXT, Request TEXT NOT NULL, Retries INTEGER DEFAULT 0, Status INTEGER DEFAULT 0);"
+// Reversal queue (Status: 0 to send, 1 armed while the original request is in flight)
+#define REVERSAL_TABLE "CREATE TABLE IF NOT EXISTS reversal (id INTEGER PRIMARY KEY AUTOINCREMENT, DateTimeStamp TEXT DEFAULT CURRENT_TIMESTAMP, STAN TEXT NOT NULL UNIQUE, CardKey TEXT, Request TEXT NOT NULL, Retries INTEGER DEFAULT 0, Status INTEGER DEFAULT 1);"
+
+/*
+ * Transaction log: the fields read back (lookups, totals, receipts, batch
+ * upload) in trn, typed, the others in trn_ext. The view log gives the
+ * records with the former isoFieldNNN columns, amounts padded to 12 and
+ * STAN to 6 digits, EMV data in hex; an insert in log fills both tables.
+ */
+#define LOG_INT(x)       "CAST(NULLIF(" x ", '') AS INTEGER)"
+#define LOG_PAD(x, z, n) "CASE WHEN " x " IS NULL THEN '' ELSE substr('" z "' || " x ", -" n ", " n ") END"
+#define LOG_TRN_TABLE "CREATE TABLE IF NOT EXISTS trn (id INTEGER PRIMARY KEY AUTOINCREMENT, DateTimeStamp TEXT DEFAULT CURRENT_TIMESTAMP, MenuItem INTEGER, InvoiceNo TEXT, BatchNo INTEGER, Pan TEXT, Amount INTEGER, CashbackAmt INTEGER, TrnDateTime INTEGER, Stan INTEGER, Rrn TEXT, AutCod TEXT, RspCod TEXT, Tid TEXT, Currency TEXT, DrCr TEXT, Voided INTEGER NOT NULL DEFAULT 0);"
+#define LOG_EXT_TABLE "CREATE TABLE IF NOT EXISTS trn_ext (id INTEGER PRIMARY KEY, Mti TEXT, PrcCod TEXT, ExpDat TEXT, PosEntMod TEXT, CrdSeq TEXT, Nii TEXT, ConCode TEXT, Trk2 TEXT, Mid TEXT, Emv BLOB, Field062 TEXT, Field063 TEXT, NetTiming TEXT);"
+#define LOG_INDEXES "CREATE INDEX IF NOT EXISTS trn_stan ON trn (Stan); CREATE INDEX IF NOT EXISTS trn_rrn ON trn (Rrn); CREATE INDEX IF NOT EXISTS trn_autcod ON trn (AutCod); CREATE INDEX IF NOT EXISTS trn_batch ON trn (BatchNo);"
+#define LOG_VIEW "CREATE VIEW IF NOT EXISTS log AS SELECT t.id AS id, t.DateTimeStamp AS DateTimeStamp, t.MenuItem AS MenuItem, t.InvoiceNo AS InvoiceNo, t.BatchNo AS BatchNo, e.Mti AS isoField000, t.Pan AS isoField002, e.PrcCod AS isoField003, " LOG_PAD("t.Amount", "000000000000", "12") " AS isoField004, IFNULL(t.TrnDateTime, '') AS isoField007, " LOG_PAD("t.Stan", "000000", "6") " AS isoField011, e.ExpDat AS isoField014, e.PosEntMod AS isoField022, e.CrdSeq AS isoField023, e.Nii AS isoField024, e.ConCode AS isoField025, e.Trk2 AS isoField035, t.Rrn AS isoField037, t.AutCod AS isoField038, t.RspCod AS isoField039, t.Tid AS isoField041, e.Mid AS isoField042, t.Currency AS isoField049, " LOG_PAD("t.CashbackAmt", "000000000000", "12") " AS isoField054, hex(e.Emv) AS isoField055, e.Field062 AS isoField062, e.Field063 AS isoField063, t.DrCr AS isoDrCr, t.Voided AS isoVoided, e.NetTiming AS NetTiming FROM trn t LEFT JOIN trn_ext e ON e.id = t.id;"
+#define LOG_TRIGGER "CREATE TRIGGER IF NOT EXISTS log_insert INSTEAD OF INSERT ON log BEGIN " \
+	"INSERT INTO trn (id, DateTimeStamp, MenuItem, InvoiceNo, BatchNo, Pan, Amount, CashbackAmt, TrnDateTime, Stan, Rrn, AutCod, RspCod, Tid, Currency, DrCr, Voided) VALUES (NEW.id, IFNULL(NEW.DateTimeStamp, CURRENT_TIMESTAMP), " LOG_INT("NEW.MenuItem") ", NEW.InvoiceNo, " LOG_INT("NEW.BatchNo") ", NEW.isoField002, " LOG_INT("NEW.isoField004") ", " LOG_INT("NEW.isoField054") ", " LOG_INT("NEW.isoField007") ", " LOG_INT("NEW.isoField011") ", NEW.isoField037, NEW.isoField038, NEW.isoField039, NEW.isoField041, NEW.isoField049, NEW.isoDrCr, IFNULL(" LOG_INT("NEW.isoVoided") ", 0)); " \
+	"INSERT INTO trn_ext (id, Mti, PrcCod, ExpDat, PosEntMod, CrdSeq, Nii, ConCode, Trk2, Mid, Emv, Field062, Field063, NetTiming) VALUES (last_insert_rowid(), NEW.isoField000, NEW.isoField003, NEW.isoField014, NEW.isoField022, NEW.isoField023, NEW.isoField024, NEW.isoField025, NEW.isoField035, NEW.isoField042, CASE WHEN typeof(NEW.isoField055) = 'blob' THEN NEW.isoField055 END, NEW.isoField062, NEW.isoField063, NEW.NetTiming); END;"
+
+/**
+ * Running totals of the approved debits and credits in trn_tot, one row per
+ * \n batch, currency, debit or credit and menu item, kept by the triggers of
+ * \n trn in the transaction of the insert, update or delete: the totals of a
+ * \n batch are read from a few rows. LOG_TOT_FILL gives them again from the
+ * \n log.
+ */
+#define LOG_TOT_KEY(t)   "IFNULL(" t "BatchNo, 0), IFNULL(" t "Currency, ''), " t "DrCr, IFNULL(" t "MenuItem, -1)"
+#define LOG_TOT_IS(t)    t "RspCod = '00' AND " t "DrCr IN ('D', 'C')"
+#define LOG_TOT_ROW(t)   "BatchNo = IFNULL(" t "BatchNo, 0) AND Currency = IFNULL(" t "Currency, '') AND DrCr = " t "DrCr AND MenuItem = IFNULL(" t "MenuItem, -1)"
+#define LOG_TOT_ADD(t)   "INSERT OR IGNORE INTO trn_tot VALUES (" LOG_TOT_KEY(t) ", 0, 0); UPDATE trn_tot SET Cnt = Cnt + 1, Amount = Amount + IFNULL(" t "Amount, 0) WHERE " LOG_TOT_ROW(t) "; "
+#define LOG_TOT_SUB(t)   "UPDATE trn_tot SET Cnt = Cnt - 1, Amount = Amount - IFNULL(" t "Amount, 0) WHERE " LOG_TOT_ROW(t) "; "
+#define LOG_TOT_TABLE "CREATE TABLE IF NOT EXISTS trn_tot (BatchNo INTEGER NOT NULL, Currency TEXT NOT NULL, DrCr TEXT NOT NULL, MenuItem INTEGER NOT NULL, Cnt INTEGER NOT NULL, Amount INTEGER NOT NULL, PRIMARY KEY (BatchNo, Currency, DrCr, MenuItem));"
+#define LOG_TOT_TRIGGERS "CREATE TRIGGER IF NOT EXISTS trn_tot_insert AFTER INSERT ON trn WHEN " LOG_TOT_IS("NEW.") " BEGIN " LOG_TOT_ADD("NEW.") "END; " \
+	"CREATE TRIGGER IF NOT EXISTS trn_tot_update_old AFTER UPDATE OF BatchNo, Currency, DrCr, MenuItem, Amount, RspCod ON trn WHEN " LOG_TOT_IS("OLD.") " BEGIN " LOG_TOT_SUB("OLD.") "END; " \
+	"CREATE TRIGGER IF NOT EXISTS trn_tot_update_new AFTER UPDATE OF BatchNo, Currency, DrCr, MenuItem, Amount, RspCod ON trn WHEN " LOG_TOT_IS("NEW.") " BEGIN " LOG_TOT_ADD("NEW.") "END; " \
+	"CREATE TRIGGER IF NOT EXISTS trn_tot_delete AFTER DELETE ON trn WHEN " LOG_TOT_IS("OLD.") " BEGIN " LOG_TOT_SUB("OLD.") "END;"
+#define LOG_TOT_SUM   "SELECT " LOG_TOT_KEY("") ", COUNT(*), IFNULL(SUM(Amount), 0) FROM trn WHERE " LOG_TOT_IS("") " GROUP BY 1, 2, 3, 4"
+#define LOG_TOT_FILL  "DELETE FROM trn_tot; INSERT INTO trn_tot " LOG_TOT_SUM ";"
+
+/**
+ * Batches closed by a settlement, in the order they were closed. Their
+ * \n records stay in trn, out of the open batch read by the queries, until
+ * \n sqlite_Log_Prune() removes them; a record deleted from trn takes its
+ * \n trn_ext row with it.
+ */
+#define LOG_BATCH_TABLE  "CREATE TABLE IF NOT EXISTS trn_closed (id INTEGER PRIMARY KEY AUTOINCREMENT, BatchNo INTEGER NOT NULL UNIQUE, Closed TEXT DEFAULT CURRENT_TIMESTAMP);"
+#define LOG_DELETE       "CREATE TRIGGER IF NOT EXISTS trn_delete AFTER DELETE ON trn BEGIN DELETE FROM trn_ext WHERE id = OLD.id; END;"
+#define LOG_BATCH_SCHEMA LOG_BATCH_TABLE LOG_DELETE LOG_TOT_TRIGGERS
+
+/**
+ * Changes of the log tables since the last export acknowledged by the host,
+ * \n see sqlite_Export: one row per table (tbl, the order of tzExpTbl) and
+ * \n row changed, given a new seq at each change. The triggers note nothing
+ * \n until an export made the row of exp_cur: Seq the last change
+ * \n acknowledged, -1 until a full export is, Sent and Crc those of the
+ * \n last export. The delete before the insert keeps the new seq under the
+ * \n OR IGNORE of a statement firing the trigger.
+ */
+#define EXP_ON           "EXISTS (SELECT 1 FROM exp_cur)"
+#define EXP_CHG(n, r)    "DELETE FROM exp_chg WHERE tbl = " n " AND rid = " r ".rowid; INSERT INTO exp_chg (tbl, rid) VALUES (" n ", " r ".rowid); "
+#define EXP_TRIGGERS(t, n) "CREATE TRIGGER IF NOT EXISTS " t "_exp_insert AFTER INSERT ON " t " WHEN " EXP_ON " BEGIN " EXP_CHG(n, "NEW") "END; " \
+	"CREATE TRIGGER IF NOT EXISTS " t "_exp_update AFTER UPDATE ON " t " WHEN " EXP_ON " BEGIN " EXP_CHG(n, "NEW") "END; " \
+	"CREATE TRIGGER IF NOT EXISTS " t "_exp_delete AFTER DELETE ON " t " WHEN " EXP_ON " BEGIN " EXP_CHG(n, "OLD") "END; "
+#define LOG_EXP_SCHEMA "CREATE TABLE IF NOT EXISTS exp_chg (seq INTEGER PRIMARY KEY AUTOINCREMENT, tbl INTEGER NOT NULL, rid INTEGER NOT NULL, UNIQUE (tbl, rid));" \
+	"CREATE TABLE IF NOT EXISTS exp_cur (id INTEGER PRIMARY KEY CHECK (id = 1), Seq INTEGER NOT NULL, Sent INTEGER NOT NULL, Crc INTEGER NOT NULL);" \
+	EXP_TRIGGERS("trn", "0") EXP_TRIGGERS("trn_ext", "1") EXP_TRIGGERS("trn_tot", "2") EXP_TRIGGERS("trn_closed", "3")
+#define LOG_SCHEMA LOG_TRN_TABLE LOG_EXT_TABLE LOG_INDEXES LOG_VIEW LOG_TRIGGER LOG_TOT_TABLE LOG_TOT_TRIGGERS LOG_BATCH_TABLE LOG_DELETE LOG_EXP_SCHEMA
+
 // Create Tables
 static const char *tabCreate[] = {
+		"PRAGMA auto_vacuum = INCREMENTAL;", // Before the first table, see sqlite_Vacuum_Step
 		"CREATE TABLE IF NOT EXISTS AppMenus ( TableId INTEGER DEFAULT 0 PRIMARY KEY AUTOINCREMENT, MenuId INTEGER DEFAULT 0, MenuName TEXT, MenuIdParent INTEGER, Hidden INTEGER DEFAULT 0, SecureMenu INTEGER DEFAULT 0, SecureMenuLevel INTEGER DEFAULT 1,DrCr TEXT ,IconPathName TEXT );",
 		"CREATE TABLE IF NOT EXISTS aid ( id INTEGER PRIMARY KEY AUTOINCREMENT, emvAidName TEXT, emvAid TEXT, emvTACDft TEXT, emvTACDen TEXT, emvTACOnl TEXT, emvThrVal TEXT, emvTarPer TEXT, emvMaxTarPer TEXT, emvDftValDDOL TEXT, emvDftValTDOL TEXT, emvTrmAvn TEXT, emvAcqId TEXT, emvTrmFlrLim TEXT, emvTCC TEXT, emvAidTxnType TEXT);",
-		"CREATE TABLE IF NOT EXISTS log (id INTEGER PRIMARY KEY AUTOINCREMENT, DateTimeStamp TEXT DEFAULT CURRENT_TIMESTAMP, MenuItem TEXT, InvoiceNo TEXT, isoField000 TEXT, isoField001 TEXT, isoField002 TEXT, isoField003 TEXT, isoField004 TEXT, isoField005 TEXT, isoField006 TEXT, isoField007 TEXT, isoField008 TEXT, isoField009 TEXT, isoField010 TEXT, isoField011 TEXT, isoField012 TEXT, isoField013 TEXT, isoField014 TEXT, isoField015 TEXT, isoField016 TEXT, isoField017 TEXT, isoField018 TEXT, isoField019 TEXT, isoField020 TEXT, isoField021 TEXT, isoField022 TEXT, isoField023 TEXT, isoField024 TEXT, isoField025 TEXT, isoField026 TEXT, isoField027 TEXT, isoField028 TEXT, isoField029 TEXT, isoField030 TEXT, isoField031 TEXT, isoField032 TEXT, isoField033 TEXT, isoField034 TEXT, isoField035 TEXT, isoField036 TEXT, isoField037 TEXT, isoField038 TEXT, isoField039 TEXT, isoField040 TEXT, isoField041 TEXT, isoField042 TEXT, isoField043 TEXT, isoField044 TEXT, isoField045 TEXT, isoField046 TEXT, isoField047 TEXT, isoField048 TEXT, isoField049 TEXT, isoField050 TEXT, isoField051 TEXT, isoField052 TEXT, isoField053 TEXT, isoField054 TEXT, isoField055 TEXT, isoField056 TEXT, isoField057 TEXT, isoField058 TEXT, isoField059 TEXT, isoField060 TEXT, isoField061 TEXT, isoField062 TEXT, isoField063 TEXT, isoField064 TEXT, isoField065 TEXT, isoField066 TEXT, isoField067 TEXT, isoField068 TEXT, isoField069 TEXT, isoField070 TEXT, isoField071 TEXT, isoField072 TEXT, isoField073 TEXT, isoField074 TEXT, isoField075 TEXT, isoField076 TEXT, isoField077 TEXT, isoField078 TEXT, isoField079 TEXT, isoField080 TEXT, isoField081 TEXT, isoField082 TEXT, isoField083 TEXT, isoField084 TEXT, isoField085 TEXT, isoField086 TEXT, isoField087 TEXT, isoField088 TEXT, isoField089 TEXT, isoField090 TEXT, isoField091 TEXT, isoField092 TEXT, isoField093 TEXT, isoField094 TEXT, isoField095 TEXT, isoField096 TEXT, isoField097 TEXT, isoField098 TEXT, isoField099 TEXT, isoField100 TEXT, isoField101 TEXT, isoField102 TEXT, isoField103 TEXT, isoField104 TEXT, isoField105 TEXT, isoField106 TEXT, isoField107 TEXT, isoField108 TEXT, isoField109 TEXT, isoField110 TEXT, isoField111 TEXT, isoField112 TEXT, isoField113 TEXT, isoField114 TEXT, isoField115 TEXT, isoField116 TEXT, isoField117 TEXT, isoField118 TEXT, isoField119 TEXT, isoField120 TEXT, isoField121 TEXT, isoField122 TEXT, isoField123 TEXT, isoField124 TEXT, isoField125 TEXT, isoField126 TEXT, isoField127 TEXT, isoField128 TEXT, isoDrCr TEXT, isoVoided TEXT);"
+		LOG_SCHEMA,
 		"CREATE TABLE IF NOT EXISTS Users (id INTEGER PRIMARY KEY AUTOINCREMENT, userName TEXT NOT NULL, password TEXT NOT NULL);",
+		ADVICE_TABLE,
+		REVERSAL_TABLE,
 };
 
 // Insert rqs Data
@@ -73,60 +145,6 @@ static void refreshDBName(void){
 
 }
 
-// Insert mnu Data
-static const char *tabInsert_Menu[] = {
-		/// NB.: You must edit menus in the function "Generate_Menu_Content()" and in "resetMenuVars()"
-		var_MnuCustomer,
-		var_MnuSale,
-		var_MnuSaleCB,
-		var_MnuDeposit,
-		var_MnuWithdrawal,
-		var_MnuPreaut,
-		var_MnuCompletion,
-		var_MnuBalanceInquiry,
-		var_MnuMiniSatement,
-		var_MnuRefund,
-		var_MnuBiller,
-		var_MnuOffline,
-		var_MnuVoid,
-		var_MnuAdjust,
-		var_MnuReversal,
-		var_MnuLogOn,
-		var_MnuEchoTest,
-		var_MnuCustSettlement,
-
-		var_MnuMerchant,
-		var_MnuSettlement,
-		var_MnuDetailedRpt,
-		var_MnuSummaryRpt,
-		var_MnuDuplicateReceipt,
-		var_MnuReprintReceipt,
-		var_MnuAdmChgPwd,
-		var_MnuMrcChgPwd,
-		var_MnuMrcReset,
-		var_MnuMrcResetRev,
-		var_MnuMngUsers,
-		var_MnuBillerResend,
-
-		var_MnuAgent,
-		var_MnuAgencyDeposit,
-
-		var_MnuSupervisor,
-
-		var_MnuAdmin,
-		var_MnuTerminalMode,
-		var_MnuTerminalPar,
-		var_MnuBillerConfig,
-		var_MnuTMKey,
-		var_MnuGenerateTLSkey,
-		var_MnuCmmIS,
-		var_MnuClessModeOff,
-		var_MnuConnMode,
-		var_MnuControlPanel,
-		var_MnuSwapSimSlot,
-		var_MnuCvmMode,
-		var_MnuTraces,
-};
 
 
 
@@ -320,6 +338,495 @@ int Sqlite_Exec(sqlite3 *handle, char *zSql){
 	return errCnt;
 }
 
+/**
+ * Shared database handle.
+ * \n The database is opened at the first query after power up and kept open;
+ * \n the queries with a fixed SQL text are compiled once and kept in a small
+ * \n cache, their values bound as parameters. The foreground and the
+ * \n background tasks (reversal and advice senders, cash register) take turns
+ * \n on the handle: it is held from sqlite_Lock() to sqlite_Unlock(). The task
+ * \n holding it may lock it again, so that a transaction opened by
+ * \n sqlite_Txn_Begin() spans the queries made until sqlite_Txn_End().
+ */
+#define SQL_CACHE_MAX   16             // Compiled statements kept
+#define SQL_BUSY_TMO    2000           // ms to wait for a lock held by another handle
+#define SQL_WAL_PAGES   1000           // WAL pages written back by a commit when the idle checkpoint has not run
+#define CAP_RESERVE_PAGES 32           // Room kept for the WAL of a sale and for the prune of the settlement
+#define CAP_RECORD_BYTES  1024         // Bytes of a record until the log holds CAP_MIN_RECORDS
+#define CAP_MIN_RECORDS   50
+#define CAP_DAYS_MAX      999          // Days left when no record was made of late
+
+typedef struct {
+	const char *pcSql;                 // SQL text, a string constant
+	sqlite3_stmt *hStmt;
+} tSqlStmt;
+
+static sqlite3 *hSqlDb = NULL;
+static T_OSL_HMUTEX hSqlMtx = NULL;
+static tSqlStmt tzSqlCache[SQL_CACHE_MAX];
+static int iSqlCache = 0;              // Statements in the cache
+static int iSqlEvict = 0;              // Next one replaced when the cache is full
+static sqlite3_stmt *hBatchStmt = NULL; // Batch upload cursor, see sqlite_Batch_Open
+static word usSqlOwner = 0;            // Task holding the handle
+static int iSqlDepth = 0;              // Locks it took, 0: handle free
+static int iSqlTxn = 0;                // sqlite_Txn_Begin() calls not ended
+static byte bSqlTxn = 0;               // Their transaction is open
+static byte bSqlWal = 0;               // Database in WAL mode
+
+/**
+ * Last records saved by sqlite_Log_Save, kept in RAM so that the reprint,
+ * \n the duplicate of the last receipt and the void find a recent record
+ * \n without SQLite; see sqlite_Ring_Put. Emptied when the log may differ
+ * \n from it: transaction rolled back, batch closed, database released.
+ */
+#define LOG_RING_SIZE   16             // Records kept
+#define LOG_RING_DATA   768            // Columns of a record, each length then text
+
+#define LOG_RING_BATCH  0x01           // NULL columns of a record
+#define LOG_RING_MENU   0x02
+#define LOG_RING_STAN   0x04
+
+typedef struct {
+	sqlite3_int64 llId;                // Record id
+	sqlite3_int64 llBatch;             // Columns searched by sqlite_Get_LOG_Record
+	sqlite3_int64 llMenu;
+	sqlite3_int64 llStan;
+	char zRrn[lenRrn + 1];
+	char zAutCod[lenAutCod + 1];
+	byte bNull;                        // LOG_RING_xxx
+	byte bVoided;
+	byte bServed;                      // 0: not copied as the view gives it, left to SQLite
+	word usLen;
+	byte tbData[LOG_RING_DATA];        // Columns of tzLogRingCol
+} tLogRing;
+
+static tLogRing tzLogRing[LOG_RING_SIZE];
+static int iRingPos = 0;               // Next slot written
+static int iRingCnt = 0;               // Records in the ring
+
+/**
+ * Parameters kept in RAM, read once from SQLite: the parameters table
+ * \n (Sqlite_Get_Parameter) and the aid table (sqlite_Aid_Get), read 11
+ * \n times by each EMV transaction. Sqlite_Update_Parameter writes SQLite
+ * \n and the cache, then tells the functions given to sqlite_Param_Watch.
+ * \n Read again when SQLite may differ from it: transaction rolled back,
+ * \n database released, aid table written.
+ */
+#define SQL_PARAM_SIZE  32             // Rows of the parameters table kept
+#define SQL_PARAM_NAME  32             // Longest name kept
+#define SQL_PARAM_VALUE 64             // Longest value kept, longer ones read from SQLite
+#define SQL_PARAM_WATCH 4              // Functions told of a change
+#define SQL_AID_SIZE    24             // Rows of the aid table kept
+#define SQL_AID_COLS    15             // Columns of tzAidCol
+#define SQL_AID_DATA    384            // Columns of a row, each text then zero
+#define SQL_AID_NULL    0xFFFF         // Offset of a NULL column
+
+typedef struct {
+	char Name[SQL_PARAM_NAME + 1];
+	char Value[SQL_PARAM_VALUE + 1];
+	byte bNull;                        // details NULL: the read leaves the buffer as it is
+	byte bLong;                        // Value too long, read from SQLite
+} tSqlParam;
+
+typedef struct {
+	word tusOff[SQL_AID_COLS];         // Column texts in tcData, SQL_AID_NULL for NULL
+	char tcData[SQL_AID_DATA];
+} tSqlAid;
+
+static tSqlParam tzSqlParam[SQL_PARAM_SIZE];
+static int iParamCnt = -1;             // Rows in tzSqlParam, -1 to read them again
+static byte bParamAll = 0;             // All rows of the table in tzSqlParam, else read from SQLite
+static byte bParamTxn = 0;             // Parameter updated in the open transaction
+static tSqlAid tzSqlAid[SQL_AID_SIZE];
+static int iAidCnt = -1;               // Rows in tzSqlAid, -1 to read them again
+static byte bAidAll = 0;               // All rows of the table in tzSqlAid, else read from SQLite
+static tSqlParamFn tpfParamWatch[SQL_PARAM_WATCH];
+static tSqlParamStat xParamStat;
+
+/**
+ * Drop the parameters kept in RAM, the next read takes them from SQLite.
+ * \n Called with the handle locked; sqlite_Param_Tell(NULL, NULL) is due
+ * \n once it is unlocked.
+ */
+static void sqlite_Param_Drop(void){
+	iParamCnt = -1;
+	iAidCnt = -1;
+	bParamTxn = 0;
+}
+
+/**
+ * Tell the functions given to sqlite_Param_Watch of a change. Called with
+ * \n the handle unlocked, so that they may read the parameters again.
+ * \param    Name:const char* (I) Parameter changed, NULL: all of them may have
+ * \param    Value:const char* (I) Its new value, NULL with Name NULL
+ */
+static void sqlite_Param_Tell(const char *Name, const char *Value){
+	int iIdx;
+
+	for (iIdx = 0; iIdx < SQL_PARAM_WATCH; iIdx++) {
+		if (tpfParamWatch[iIdx])
+			tpfParamWatch[iIdx](Name, Value);
+	}
+}
+
+static void sqlite_Lock(void){
+	if (iSqlDepth && (usSqlOwner == Telium_CurrentTask())) {
+		iSqlDepth++;                   // Already held by this task
+		return;
+	}
+	if (hSqlMtx == NULL)               // First query, made at power up before the tasks are forked
+		hSqlMtx = OSL_Mutex_Create(0, OSL_SECURITY_LOCAL);
+	if (hSqlMtx)
+		OSL_Mutex_Lock(hSqlMtx, OSL_TIMEOUT_INFINITE);
+	usSqlOwner = Telium_CurrentTask(); // Owner before depth: another task never sees itself as owner
+	iSqlDepth = 1;
+}
+
+static void sqlite_Unlock(void){
+	if (--iSqlDepth > 0)
+		return;
+	if (hSqlMtx)
+		OSL_Mutex_Unlock(hSqlMtx);
+}
+
+/**
+ * Move the records of a log table made before the typed schema into trn
+ * \n and trn_ext, through the insert trigger of the view, keeping their ids.
+ * \n They all belong to the open batch. The EMV data, kept in hex, is stored
+ * \n in binary. All or nothing: on error the former table is left as it was.
+ * \return 1:OK, -1:error
+ */
+#define LOG_V1_FIELDS "MenuItem, InvoiceNo, isoField000, isoField002, isoField003, isoField004, isoField007, isoField011, isoField014, isoField022, isoField023, isoField024, isoField025, isoField035, isoField037, isoField038, isoField039, isoField041, isoField042, isoField049, isoField054, isoField062, isoField063, isoDrCr, isoVoided, NetTiming"
+
+static int sqlite_Log_Migrate(void){
+	sqlite3_stmt *hRead = NULL;
+	sqlite3_stmt *hWrite = NULL;
+	char BatchNo[lenBatNum + 3];
+	byte Emv[512];
+	const char *pcHex;
+	int iLen;
+	int iRet;
+
+	memset(BatchNo, 0, sizeof(BatchNo));
+	mapGet(appBatchNumber, BatchNo, sizeof(BatchNo) - 1);
+
+	iRet = sqlite3_exec(hSqlDb, "BEGIN; ALTER TABLE log RENAME TO log_v1; " LOG_SCHEMA, NULL, NULL, NULL);
+	CHECK(iRet == SQLITE_OK, lblKO);
+
+	iRet = sqlite3_prepare_v2(hSqlDb, "INSERT INTO log (id, DateTimeStamp, BatchNo, " LOG_V1_FIELDS ") SELECT id, DateTimeStamp, ?, " LOG_V1_FIELDS " FROM log_v1 ORDER BY id;", -1, &hWrite, 0);
+	CHECK(iRet == SQLITE_OK, lblKO);
+	sqlite3_bind_text(hWrite, 1, BatchNo, -1, SQLITE_STATIC);
+	CHECK(sqlite3_step(hWrite) == SQLITE_DONE, lblKO);
+	sqlite3_finalize(hWrite);
+	hWrite = NULL;
+
+	iRet = sqlite3_prepare_v2(hSqlDb, "SELECT id, isoField055 FROM log_v1 WHERE isoField055 != '';", -1, &hRead, 0);
+	CHECK(iRet == SQLITE_OK, lblKO);
+	iRet = sqlite3_prepare_v2(hSqlDb, "UPDATE trn_ext SET Emv = ? WHERE id = ?;", -1, &hWrite, 0);
+	CHECK(iRet == SQLITE_OK, lblKO);
+	while ((iRet = sqlite3_step(hRead)) == SQLITE_ROW) {
+		pcHex = (const char *)sqlite3_column_text(hRead, 1);
+		iLen = (int)strlen(pcHex);
+		if ((iLen % 2) || (iLen / 2 > (int)sizeof(Emv)) || (hex2bin(Emv, pcHex, iLen / 2) != iLen / 2))
+			continue;                  // Not hex: left out, as the former receipts did not use it
+		sqlite3_bind_blob(hWrite, 1, Emv, iLen / 2, SQLITE_STATIC);
+		sqlite3_bind_int64(hWrite, 2, sqlite3_column_int64(hRead, 0));
+		CHECK(sqlite3_step(hWrite) == SQLITE_DONE, lblKO);
+		sqlite3_reset(hWrite);
+	}
+	CHECK(iRet == SQLITE_DONE, lblKO);
+	sqlite3_finalize(hRead);
+	sqlite3_finalize(hWrite);
+	hRead = NULL;
+	hWrite = NULL;
+
+	iRet = sqlite3_exec(hSqlDb, "DROP TABLE log_v1; COMMIT;", NULL, NULL, NULL);
+	CHECK(iRet == SQLITE_OK, lblKO);
+	return 1;
+
+	lblKO:
+	if (hRead)
+		sqlite3_finalize(hRead);
+	if (hWrite)
+		sqlite3_finalize(hWrite);
+	sqlite3_exec(hSqlDb, "ROLLBACK;", NULL, NULL, NULL);
+	return -1;
+}
+
+/**
+ * Compare the running totals with the totals recomputed from the log. The
+ * \n totals found to differ are given again from the log. Called locked.
+ * \return number of totals that had drifted, 0 if none, -1 on error
+ */
+static const char zLogDrift[] = "SELECT COUNT(*) FROM (SELECT 1 FROM (SELECT BatchNo, Currency, DrCr, MenuItem, -Cnt AS Cnt, -Amount AS Amount FROM trn_tot UNION ALL " LOG_TOT_SUM ") GROUP BY BatchNo, Currency, DrCr, MenuItem HAVING SUM(Cnt) != 0 OR SUM(Amount) != 0);";
+
+static int sqlite_Log_Drift(void){
+	sqlite3_stmt *hStmt = NULL;
+	int iRet = -1;
+
+	CHECK(sqlite3_prepare_v2(hSqlDb, zLogDrift, -1, &hStmt, 0) == SQLITE_OK, lblEnd);
+	CHECK(sqlite3_step(hStmt) == SQLITE_ROW, lblEnd);
+	iRet = sqlite3_column_int(hStmt, 0);
+	if (iRet > 0) {
+		if (sqlite3_exec(hSqlDb, "BEGIN; " LOG_TOT_FILL " COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+			sqlite3_exec(hSqlDb, "ROLLBACK;", NULL, NULL, NULL);
+			iRet = -1;
+		}
+	}
+
+	lblEnd:
+	if (hStmt)
+		sqlite3_finalize(hStmt);
+	return iRet;
+}
+
+/**
+ * Put the database in WAL mode. A commit then appends the pages to the WAL
+ * \n and syncs it once, instead of saving them in a rollback journal and
+ * \n syncing the journal and the database. WAL needs shared memory from the
+ * \n file system, or else the exclusive locking mode, which the single shared
+ * \n handle allows. A library built without WAL keeps the rollback journal.
+ * \return 1:WAL, 0:rollback journal
+ */
+static byte sqlite_Wal_Set(void){
+	sqlite3_stmt *hStmt = NULL;
+	const char *pcMode;
+	byte bWal = 0;
+
+	if (sqlite3_prepare_v2(hSqlDb, "PRAGMA journal_mode = WAL;", -1, &hStmt, 0) == SQLITE_OK) {
+		if (sqlite3_step(hStmt) == SQLITE_ROW) {
+			pcMode = (const char *)sqlite3_column_text(hStmt, 0);
+			bWal = (pcMode != NULL) && (strcmp(pcMode, "wal") == 0);
+		}
+		sqlite3_finalize(hStmt);
+	}
+	return bWal;
+}
+
+static void sqlite_Wal(void){
+	bSqlWal = sqlite_Wal_Set();
+	if (!bSqlWal) {                    // No shared memory: retried with the exclusive locking mode
+		sqlite3_exec(hSqlDb, "PRAGMA locking_mode = EXCLUSIVE;", NULL, NULL, NULL);
+		bSqlWal = sqlite_Wal_Set();
+		if (!bSqlWal)
+			sqlite3_exec(hSqlDb, "PRAGMA locking_mode = NORMAL;", NULL, NULL, NULL);
+	}
+	if (bSqlWal)
+		sqlite3_wal_autocheckpoint(hSqlDb, SQL_WAL_PAGES);
+}
+
+/**
+ * Integer of the first column of a query of one row, a pragma reading a
+ * \n setting or a count. Compiled at each call, out of the statement cache
+ * \n which it would take from the queries of the sales. Called locked.
+ * \return the integer, -1 on error
+ */
+static long sqlite_Int(const char *pcSql){
+	sqlite3_stmt *hStmt = NULL;
+	long lRet = -1;
+
+	if (sqlite3_prepare_v2(hSqlDb, pcSql, -1, &hStmt, 0) != SQLITE_OK)
+		return -1;
+	if (sqlite3_step(hStmt) == SQLITE_ROW)
+		lRet = (long)sqlite3_column_int64(hStmt, 0);
+	sqlite3_finalize(hStmt);
+	return lRet;
+}
+
+/**
+ * Put the database in incremental auto-vacuum, so that the pages freed by
+ * \n sqlite_Log_Prune can be given back to the disk by sqlite_Vacuum_Step.
+ * \n New databases get it from tabCreate. Older ones are rebuilt once by a
+ * \n VACUUM, tried again at the next start if the disk lacks the room.
+ */
+static void sqlite_Vacuum_Set(void){
+	if (sqlite_Int("PRAGMA auto_vacuum;") == 2) // Incremental
+		return;
+	sqlite3_exec(hSqlDb, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", NULL, NULL, NULL);
+}
+
+/**
+ * Give the shared handle, opening the database if needed. Called locked.
+ * \n At the first open the log is brought to the current schema and its
+ * \n running totals checked.
+ * \return the handle, NULL if the database cannot be opened
+ */
+static sqlite3 *sqlite_Db(void){
+	sqlite3_stmt *hStmt = NULL;
+	const char *pcName;
+	byte bLog = 0;
+	byte bTrn = 0;
+	byte bTot = 0;
+	int iRet;
+
+	if (hSqlDb)
+		return hSqlDb;
+
+	refreshDBName();
+	iRet = Sqlite_Open(DataBaseName, &hSqlDb);
+	if (iRet != SQLITE_OK) {
+		if (hSqlDb)
+			sqlite3_close(hSqlDb);
+		hSqlDb = NULL;
+		return NULL;
+	}
+	sqlite3_busy_timeout(hSqlDb, SQL_BUSY_TMO);
+	sqlite_Vacuum_Set();               // Before WAL: an empty database is given its mode at once
+	sqlite_Wal();
+	sqlite3_exec(hSqlDb, ADVICE_TABLE REVERSAL_TABLE, NULL, NULL, NULL); // Terminals created before the queues existed
+	if (sqlite3_prepare_v2(hSqlDb, "SELECT name FROM sqlite_master WHERE type = 'table' AND name IN ('log', 'trn', 'trn_tot');", -1, &hStmt, 0) == SQLITE_OK) {
+		while (sqlite3_step(hStmt) == SQLITE_ROW) {
+			pcName = (const char *)sqlite3_column_text(hStmt, 0);
+			bLog |= (strcmp(pcName, "log") == 0);
+			bTrn |= (strcmp(pcName, "trn") == 0);
+			bTot |= (strcmp(pcName, "trn_tot") == 0);
+		}
+		sqlite3_finalize(hStmt);
+	}
+	if (bLog) {
+		sqlite_Log_Migrate();          // Terminals created before the typed log; tried again at next start if it fails
+	} else if (bTrn && !bTot) {        // Typed log without running totals: given from the records
+		if (sqlite3_exec(hSqlDb, "BEGIN; " LOG_TOT_TABLE LOG_TOT_TRIGGERS LOG_TOT_FILL " COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+			sqlite3_exec(hSqlDb, "ROLLBACK;", NULL, NULL, NULL);
+	} else if (bTot) {
+		sqlite_Log_Drift();            // Totals changed outside the triggers given again
+	}
+	if (bTrn)                          // Typed log made before the batches were kept, or before the export
+		sqlite3_exec(hSqlDb, LOG_BATCH_SCHEMA LOG_EXP_SCHEMA, NULL, NULL, NULL);
+	return hSqlDb;
+}
+
+/**
+ * Give the compiled statement of an SQL text, compiling it at its first use.
+ * \n The cache is keyed by the address of the text, which must be a string
+ * \n constant. When full, the oldest statement is replaced. Called locked;
+ * \n hand the statement back with sqlite_Done().
+ * \param    pcSql:char* (I) SQL text, values given as ? parameters.
+ * \return the statement, NULL on error
+ */
+static sqlite3_stmt *sqlite_Stmt(const char *pcSql){
+	sqlite3_stmt *hStmt = NULL;
+	int iIdx;
+
+	for (iIdx = 0; iIdx < iSqlCache; iIdx++) {
+		if (tzSqlCache[iIdx].pcSql == pcSql)
+			return tzSqlCache[iIdx].hStmt;
+	}
+
+	if (sqlite_Db() == NULL)
+		return NULL;
+	if (sqlite3_prepare_v2(hSqlDb, pcSql, -1, &hStmt, 0) != SQLITE_OK) {
+		if (hStmt)
+			sqlite3_finalize(hStmt);
+		return NULL;
+	}
+
+	if (iSqlCache < SQL_CACHE_MAX) {
+		iIdx = iSqlCache++;
+	} else {
+		iIdx = iSqlEvict;
+		iSqlEvict = (iSqlEvict + 1) % SQL_CACHE_MAX;
+		sqlite3_finalize(tzSqlCache[iIdx].hStmt);
+	}
+	tzSqlCache[iIdx].pcSql = pcSql;
+	tzSqlCache[iIdx].hStmt = hStmt;
+	return hStmt;
+}
+
+/**
+ * Hand a cached statement back: reset it, which ends its read of the
+ * \n database, and unbind its values.
+ */
+static void sqlite_Done(sqlite3_stmt *hStmt){
+	sqlite3_reset(hStmt);
+	sqlite3_clear_bindings(hStmt);
+}
+
+/**
+ * Close the shared handle and drop the compiled statements, before the
+ * \n database file is removed. The next query opens it again.
+ */
+static void sqlite_Release(void){
+	int iIdx;
+
+	sqlite_Lock();
+	for (iIdx = 0; iIdx < iSqlCache; iIdx++)
+		sqlite3_finalize(tzSqlCache[iIdx].hStmt);
+	iSqlCache = 0;
+	iSqlEvict = 0;
+	if (hBatchStmt)
+		sqlite3_finalize(hBatchStmt);
+	hBatchStmt = NULL;
+	if (hSqlDb)
+		Sqlite_Close(hSqlDb);
+	hSqlDb = NULL;
+	bSqlWal = 0;
+	iRingCnt = 0;
+	sqlite_Param_Drop();
+	sqlite_Unlock();
+	sqlite_Param_Tell(NULL, NULL);     // Database made again
+}
+
+/**
+ * Open the transaction of a sale: its writes (log row and running totals,
+ * \n void flag, advice) are made durable together by one commit in
+ * \n sqlite_Txn_End(). The handle stays with the calling task until then,
+ * \n the background tasks wait. Calls may be nested, the outer one commits.
+ * \return 1:OK, -1:transaction not opened (each write then commits alone);
+ * \n sqlite_Txn_End() is due in both cases
+ */
+int sqlite_Txn_Begin(void){
+	sqlite_Lock();
+	if (iSqlTxn++ == 0)
+		bSqlTxn = (sqlite_Db() != NULL) && (sqlite3_exec(hSqlDb, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK);
+	return bSqlTxn ? 1 : -1;
+}
+
+/**
+ * End the transaction opened by sqlite_Txn_Begin() and give the handle back.
+ * \param    Ok:int (I) 1 to commit, 0 to roll back the writes of the sale.
+ * \return 1:committed, 0:rolled back, -1:commit failed and rolled back
+ */
+int sqlite_Txn_End(int Ok){
+	int iRet = Ok ? 1 : 0;
+	byte bTell = 0;
+
+	if ((--iSqlTxn == 0) && bSqlTxn) {
+		if (!Ok || (sqlite3_exec(hSqlDb, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)) {
+			sqlite3_exec(hSqlDb, "ROLLBACK;", NULL, NULL, NULL);
+			iRingCnt = 0;              // Records of the sale undone
+			bTell = bParamTxn;
+			if (bParamTxn)             // Parameters updated undone
+				sqlite_Param_Drop();
+			iRet = Ok ? -1 : 0;
+		}
+		bSqlTxn = 0;
+		bParamTxn = 0;
+	}
+	sqlite_Unlock();
+	if (bTell)
+		sqlite_Param_Tell(NULL, NULL);
+	return iRet;
+}
+
+/**
+ * Write the WAL back into the database and empty it. Called while the
+ * \n terminal is idle, so that the commits of a sale do not wait for a
+ * \n checkpoint and the WAL stays small on the disk; the automatic
+ * \n checkpoint after SQL_WAL_PAGES pages is left for a terminal never idle.
+ * \n Left to the next call while a transaction is open.
+ * \return 1:done, 0:nothing to do, -1:error
+ */
+int sqlite_Checkpoint(void){
+	int iRet = 0;
+
+	sqlite_Lock();
+	if (bSqlWal && hSqlDb && (iSqlTxn == 0))
+		iRet = (sqlite3_wal_checkpoint_v2(hSqlDb, NULL, SQLITE_CHECKPOINT_TRUNCATE, NULL, NULL) == SQLITE_OK) ? 1 : -1;
+	sqlite_Unlock();
+	return iRet;
+}
+
 /**
  * 	Open and create table
  */
@@ -359,257 +866,496 @@ void SqliteApp_Insert(void){
 		for (ii = 0; ii < sizeof(tabInsert) / sizeof(tabInsert[0]); ii++){
 			Sqlite_Exec(handle, (char *)tabInsert[ii]);
 		}
-		// Insert rows into table AppMenus
-		for (ii = 0; ii < sizeof(tabInsert_Menu) / sizeof(tabInsert_Menu[0]); ii++){
-			Sqlite_Exec(handle, (char *)tabInsert_Menu[ii]);
-		}
 
 		Sqlite_Close(handle);
 	}
+	sqlite_Lock();                     // aid table written on another handle
+	sqlite_Param_Drop();
+	sqlite_Unlock();
+	sqlite_Param_Tell(NULL, NULL);
 }
 
 /**
  * 	Run statement
  */
 int Sqlite_Run_Statement(const char * statement,char * data){
+	sqlite3_stmt *hStmt = NULL;
 	int iRet;
 	int col;
 	int cols;
 
-	//Make sure DB Name is correct
-	refreshDBName();
-
-	// select query from the table UsersMenu
-
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		iRet = sqlite3_prepare_v2(handle, (char *)statement, -1, &stmt, 0);
-		if (iRet){
-			goto lblErr;
-		}
-		// Read the number of rows fetched
-		cols = sqlite3_column_count(stmt);
-		while(1){
-			// fetch a row's status
-			iRet = sqlite3_step(stmt);
-
-			if (iRet == SQLITE_ROW){
-				// SQLITE_ROW means fetched a row
-				// sqlite3_column_text returns a const void* , typecast it to const char*
-				for (col = 0 ; col < cols; col++){
-					const char *val = (const char*)sqlite3_column_text(stmt,col);
-					strcpy(data,"#");
+	sqlite_Lock();
+	CHECK(sqlite_Db() != NULL, lblErr);
+
+	iRet = sqlite3_prepare_v2(hSqlDb, (char *)statement, -1, &hStmt, 0);
+	CHECK(iRet == SQLITE_OK, lblErr);
+
+	// Read the number of rows fetched
+	cols = sqlite3_column_count(hStmt);
+	while(1){
+		// fetch a row's status
+		iRet = sqlite3_step(hStmt);
+
+		if (iRet == SQLITE_ROW){
+			// SQLITE_ROW means fetched a row
+			// sqlite3_column_text returns a const void* , typecast it to const char*
+			for (col = 0 ; col < cols; col++){
+				const char *val = (const char*)sqlite3_column_text(hStmt,col);
+				strcpy(data,"#");
+				if (val != NULL)
 					strcpy(data,val);
-				}
-			} else if (iRet == SQLITE_DONE) {
-				// All rows finished
-				break;
-			} else {
-				// Some error encountered
-				break;
 			}
+		} else {
+			// All rows finished, or some error encountered
+			break;
 		}
-		sqlite3_finalize(stmt);
-		Sqlite_Close(handle);
-
-
 	}
+	sqlite3_finalize(hStmt);
+	sqlite_Unlock();
 	return 1;
+
 	lblErr:
-	Sqlite_Close(handle);
+	if (hStmt)
+		sqlite3_finalize(hStmt);
+	sqlite_Unlock();
 	return -1;
 }
 
 /**
- * 	Run statement
+ * Read the parameters table into tzSqlParam, once. A name found twice keeps
+ * \n the value of its last row not NULL, as the query of Sqlite_Get_Parameter
+ * \n gave it.
+ * \n Called with the handle locked.
+ * \return 1:OK, -1:error, the reads are then left to SQLite
  */
-int Sqlite_Update_Parameter(const char * parameter,char * data){
+static int sqlite_Param_Load(void){
+	sqlite3_stmt *hStmt;
+	tSqlParam *pxPar;
+	const char *pcName;
+	const char *pcVal;
+	int iIdx;
 	int iRet;
-	char statement[100];
 
-	memset(statement,0,sizeof(statement));
+	if (iParamCnt >= 0)
+		return 1;
+	if (sqlite_Db() == NULL)
+		return -1;
+	if (sqlite3_prepare_v2(hSqlDb, "SELECT paramName, details FROM parameters ORDER BY rowid;", -1, &hStmt, NULL) != SQLITE_OK)
+		return -1;
+	xParamStat.Queries++;
+	iParamCnt = 0;
+	bParamAll = 1;
+	while ((iRet = sqlite3_step(hStmt)) == SQLITE_ROW) {
+		pcName = (const char *) sqlite3_column_text(hStmt, 0);
+		if ((pcName == NULL) || (strlen(pcName) > SQL_PARAM_NAME))
+			continue;                  // Never found by a name kept, see Sqlite_Get_Parameter
+		for (iIdx = 0; iIdx < iParamCnt; iIdx++) {
+			if (strcmp(tzSqlParam[iIdx].Name, pcName) == 0)
+				break;
+		}
+		if (iIdx == SQL_PARAM_SIZE) {
+			bParamAll = 0;             // Table too large
+			break;
+		}
+		pxPar = &tzSqlParam[iIdx];
+		pcVal = (const char *) sqlite3_column_text(hStmt, 1);
+		if (iIdx == iParamCnt) {
+			strcpy(pxPar->Name, pcName);
+			iParamCnt++;
+		} else if (pcVal == NULL)
+			continue;                  // Value of the row before kept
+		pxPar->bNull = (pcVal == NULL);
+		pxPar->bLong = (pcVal != NULL) && (strlen(pcVal) > SQL_PARAM_VALUE);
+		strcpy(pxPar->Value, "");
+		if (pcVal && !pxPar->bLong)
+			strcpy(pxPar->Value, pcVal);
+	}
+	sqlite3_finalize(hStmt);
+	if (iRet == SQLITE_ROW)            // Stopped on a full cache
+		iRet = SQLITE_DONE;
+	if (iRet != SQLITE_DONE) {
+		iParamCnt = -1;
+		return -1;
+	}
+	return 1;
+}
 
-	//Create the Query
-	Telium_Sprintf (statement, "UPDATE parameters SET details = '%s' where paramName = '%s';", data, parameter);
+static tSqlParam *sqlite_Param_Find(const char *pcName){
+	int iIdx;
 
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		Sqlite_Exec(handle, (char *)statement);
+	for (iIdx = 0; iIdx < iParamCnt; iIdx++) {
+		if (strcmp(tzSqlParam[iIdx].Name, pcName) == 0)
+			return &tzSqlParam[iIdx];
 	}
-	Sqlite_Close(handle);
-	return 1;
+	return NULL;
 }
 
 /**
- * 	Run statement
+ * Update a parameter in SQLite and in RAM, then tell the functions given to
+ * \n sqlite_Param_Watch.
+ * \param    parameter:const char* (I) Name of the parameter
+ * \param    data:char* (I) Its new value
+ * \return 1:OK, -1:error
  */
-int Sqlite_Get_Parameter(const char * parameter,char * data){
-	int iRet;
-	//	int cols;
-	char statement[300];
-
-	memset(statement,0,sizeof(statement));
-
-	//Create the Query
-	Telium_Sprintf (statement, "SELECT * FROM parameters WHERE paramName = '%s';", parameter);
-
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		iRet = sqlite3_prepare_v2(handle, (char *)statement, -1, &stmt, 0);
-		if (iRet){
-			Sqlite_Close(handle);
-			return -1;
+int Sqlite_Update_Parameter(const char * parameter,char * data){
+	sqlite3_stmt *hStmt;
+	tSqlParam *pxPar;
+	byte bTell = 0;
+	int iRet = -1;
+
+	sqlite_Lock();
+	hStmt = sqlite_Stmt("UPDATE parameters SET details = ? WHERE paramName = ?;");
+	if (hStmt) {
+		sqlite3_bind_text(hStmt, 1, data, -1, SQLITE_STATIC);
+		sqlite3_bind_text(hStmt, 2, parameter, -1, SQLITE_STATIC);
+		iRet = (sqlite3_step(hStmt) == SQLITE_DONE) ? 1 : -1;
+		sqlite_Done(hStmt);
+		bTell = (iRet > 0) && (sqlite3_changes(hSqlDb) > 0);
+	}
+	if (bTell) {
+		pxPar = (iParamCnt >= 0) ? sqlite_Param_Find(parameter) : NULL;
+		if (pxPar) {
+			pxPar->bNull = (data == NULL);
+			pxPar->bLong = (data != NULL) && (strlen(data) > SQL_PARAM_VALUE);
+			strcpy(pxPar->Value, "");
+			if (data && !pxPar->bLong)
+				strcpy(pxPar->Value, data);
 		}
-		//		// Read the number of rows fetched
-		//		cols = sqlite3_column_count(stmt);
-		while(1){
-			// fetch a row's status
-			iRet = sqlite3_step(stmt);
+		if (iSqlTxn)                   // Undone by a rollback, see sqlite_Txn_End
+			bParamTxn = 1;
+	}
+	sqlite_Unlock();
+	if (bTell)
+		sqlite_Param_Tell(parameter, data);
+	return iRet;
+}
 
-			if (iRet == SQLITE_ROW){
-				// SQLITE_ROW means fetched a row
-				const char *val = (const char*)sqlite3_column_text(stmt,2);
-				strcpy(data,val);
-			} else if (iRet == SQLITE_DONE) {
-				// All rows finished
-				break;
-			} else {
-				// Some error encountered
-			}
+/**
+ * Read a parameter, from RAM once the table is read. Left to SQLite for a
+ * \n table or a value too large for the cache.
+ * \param    parameter:const char* (I) Name of the parameter
+ * \param    data:char* (O) Its value, left as it is when not found or NULL
+ * \return 1:OK, -1:error
+ */
+int Sqlite_Get_Parameter(const char * parameter,char * data){
+	sqlite3_stmt *hStmt;
+	tSqlParam *pxPar;
+	const char *val;
+
+	sqlite_Lock();
+	if ((sqlite_Param_Load() > 0) && bParamAll && (strlen(parameter) <= SQL_PARAM_NAME)) {
+		pxPar = sqlite_Param_Find(parameter);
+		if ((pxPar == NULL) || !pxPar->bLong) {
+			if (pxPar && !pxPar->bNull)
+				strcpy(data, pxPar->Value);
+			xParamStat.Hits++;
+			xParamStat.Avoided++;
+			sqlite_Unlock();
+			return 1;
 		}
-		sqlite3_finalize(stmt);
-		Sqlite_Close(handle);
-
 	}
+	hStmt = sqlite_Stmt("SELECT * FROM parameters WHERE paramName = ?;");
+	if (hStmt == NULL) {
+		sqlite_Unlock();
+		return -1;
+	}
+	xParamStat.Queries++;
+	sqlite3_bind_text(hStmt, 1, parameter, -1, SQLITE_STATIC);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		val = (const char*)sqlite3_column_text(hStmt,2);
+		if (val != NULL)
+			strcpy(data,val);
+	}
+	sqlite_Done(hStmt);
+	sqlite_Unlock();
 	return 1;
 }
 
+// Columns of the aid table kept by sqlite_Aid_Load, those sqlite_Aid_Get reads
+static const char *tzAidCol[SQL_AID_COLS] = {
+	"emvAidName", "emvAid", "emvTACDft", "emvTACDen", "emvTACOnl",
+	"emvThrVal", "emvTarPer", "emvMaxTarPer", "emvDftValDDOL", "emvDftValTDOL",
+	"emvTrmAvn", "emvAcqId", "emvTrmFlrLim", "emvTCC", "emvAidTxnType"
+};
+#define SQL_AID_KEY     1              // emvAid, searched by sqlite_Aid_Get
+
+// Query of each column of tzAidCol, for a table too large for tzSqlAid: one
+// constant text each, as sqlite_Stmt keys its cache by the address
+#define AID_SQL(c) "SELECT " c " FROM aid WHERE emvAid LIKE ?;"
+static const char *tzAidSql[SQL_AID_COLS] = {
+	AID_SQL("emvAidName"), AID_SQL("emvAid"), AID_SQL("emvTACDft"), AID_SQL("emvTACDen"), AID_SQL("emvTACOnl"),
+	AID_SQL("emvThrVal"), AID_SQL("emvTarPer"), AID_SQL("emvMaxTarPer"), AID_SQL("emvDftValDDOL"), AID_SQL("emvDftValTDOL"),
+	AID_SQL("emvTrmAvn"), AID_SQL("emvAcqId"), AID_SQL("emvTrmFlrLim"), AID_SQL("emvTCC"), AID_SQL("emvAidTxnType")
+};
 
 /**
- * 	Run statement
+ * Read the aid table into tzSqlAid, once. Called with the handle locked.
+ * \return 1:OK, -1:error, the reads are then left to SQLite
  */
-int Sqlite_Get_Menu(const char * parentID,char * data){
+static int sqlite_Aid_Load(void){
+	sqlite3_stmt *hStmt;
+	tSqlAid *pxAid;
+	const char *pcVal;
+	int iCol;
+	int iOff;
+	int iLen;
 	int iRet;
-	int cols;
-	int col;
-	char statement[1024];
-	int returnVal = 0;
-	char columnName[100];
 
-	memset(statement,0,sizeof(statement));
-
-	//Create the Query
-	Telium_Sprintf (statement, "SELECT MenuId,MenuName,SecureMenu,SecureMenuLevel,IconPathName FROM AppMenus WHERE Hidden = '0' and MenuIdParent = '%s';", parentID);
-
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		iRet = sqlite3_prepare_v2(handle, (char *)statement, -1, &stmt, 0);
-		if (iRet){
-			Sqlite_Close(handle);
-			return -1;
+	if (iAidCnt >= 0)
+		return 1;
+	if (sqlite_Db() == NULL)
+		return -1;
+	if (sqlite3_prepare_v2(hSqlDb,
+			"SELECT emvAidName, emvAid, emvTACDft, emvTACDen, emvTACOnl,"
+			" emvThrVal, emvTarPer, emvMaxTarPer, emvDftValDDOL, emvDftValTDOL,"
+			" emvTrmAvn, emvAcqId, emvTrmFlrLim, emvTCC, emvAidTxnType"
+			" FROM aid ORDER BY rowid;", -1, &hStmt, NULL) != SQLITE_OK)
+		return -1;
+	xParamStat.Queries++;
+	iAidCnt = 0;
+	bAidAll = 1;
+	while (bAidAll && ((iRet = sqlite3_step(hStmt)) == SQLITE_ROW)) {
+		if (iAidCnt == SQL_AID_SIZE) {
+			bAidAll = 0;               // Table too large
+			break;
 		}
-		// Read the number of rows fetched
-		cols = sqlite3_column_count(stmt);
-		while(1){
-			// fetch a row's status
-			iRet = sqlite3_step(stmt);
-
-			if (iRet == SQLITE_ROW){
-				// SQLITE_ROW means fetched a row
-				// sqlite3_column_text returns a const void* , typecast it to const char*
-				for (col = 0 ; col < cols; col++) {
-					memset(columnName, 0, sizeof(columnName));
-					const char *val = (const char*)sqlite3_column_text(stmt, col);
-					strcpy(columnName,sqlite3_column_name(stmt,col));
-					strcat(data,columnName);
-					strcat(data, ",");
-					strcat(data, val);
-					strcat(data, ";");
-
-				}
-				strcat(data, "#");
-				returnVal++;
-			} else if (iRet == SQLITE_DONE) {
-				// All rows finished
+		pxAid = &tzSqlAid[iAidCnt];
+		iOff = 0;
+		for (iCol = 0; iCol < SQL_AID_COLS; iCol++) {
+			pcVal = (const char *) sqlite3_column_text(hStmt, iCol);
+			if (pcVal == NULL) {
+				pxAid->tusOff[iCol] = SQL_AID_NULL;
+				continue;
+			}
+			iLen = strlen(pcVal);
+			if (iOff + iLen + 1 > SQL_AID_DATA) {
+				bAidAll = 0;           // Row too long
 				break;
-			} else {
-				// Some error encountered
 			}
+			pxAid->tusOff[iCol] = iOff;
+			memcpy(&pxAid->tcData[iOff], pcVal, iLen + 1);
+			iOff += iLen + 1;
 		}
-		sqlite3_finalize(stmt);
-		Sqlite_Close(handle);
-
+		iAidCnt++;
 	}
-	return returnVal;
+	sqlite3_finalize(hStmt);
+	if (!bAidAll)
+		iRet = SQLITE_DONE;
+	if (iRet != SQLITE_DONE) {
+		iAidCnt = -1;
+		return -1;
+	}
+	return 1;
 }
 
+// Text of pcKey contains pcSub, ASCII case ignored as LIKE '%pcSub%' does
+static int sqlite_Aid_Like(const char *pcKey, const char *pcSub){
+	int iIdx;
 
+	for (; ; pcKey++) {
+		for (iIdx = 0; pcSub[iIdx]; iIdx++) {
+			if (toupper((byte) pcKey[iIdx]) != toupper((byte) pcSub[iIdx]))
+				break;
+		}
+		if (pcSub[iIdx] == 0)
+			return 1;
+		if (*pcKey == 0)
+			return 0;
+	}
+}
 
 /**
- * 	Run statement for users
+ * Column iCol of the last row of tzSqlAid whose emvAid contains pcAid, as
+ * \n the query of the former statement gave it: "#" for NULL, "" for none.
  */
-int Sqlite_Get_UserDetails(int UserID,char * data){
-	int iRet;
-	int cols;
-	int col;
-	char statement[1024];
-	int returnVal = 0;
-	char columnName[100];
+static const char *sqlite_Aid_Find(int iCol, const char *pcAid){
+	const char *pcVal = "";
+	tSqlAid *pxAid;
+	int iIdx;
+
+	for (iIdx = 0; iIdx < iAidCnt; iIdx++) {
+		pxAid = &tzSqlAid[iIdx];
+		if (pxAid->tusOff[SQL_AID_KEY] == SQL_AID_NULL)
+			continue;                  // NULL LIKE: no row
+		if (!sqlite_Aid_Like(&pxAid->tcData[pxAid->tusOff[SQL_AID_KEY]], pcAid))
+			continue;
+		pcVal = (pxAid->tusOff[iCol] == SQL_AID_NULL) ? "#" : &pxAid->tcData[pxAid->tusOff[iCol]];
+	}
+	return pcVal;
+}
 
-	memset(statement,0,sizeof(statement));
+// Former query of the aid table, for a table too large for tzSqlAid
+static void sqlite_Aid_Query(int iCol, const char *pcAid, char *pcData, int iDim){
+	sqlite3_stmt *hStmt;
+	const char *pcVal;
+	char tcLike[lenAID + 2 + 1];
+
+	Telium_Sprintf(tcLike, "%%%.*s%%", lenAID, pcAid);
+	hStmt = sqlite_Stmt(tzAidSql[iCol]);
+	if (hStmt == NULL)
+		return;
+	xParamStat.Queries++;
+	sqlite3_bind_text(hStmt, 1, tcLike, -1, SQLITE_STATIC);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		pcVal = (const char *) sqlite3_column_text(hStmt, 0);
+		strncpy(pcData, pcVal ? pcVal : "#", iDim - 1);
+		pcData[iDim - 1] = 0;
+	}
+	sqlite_Done(hStmt);
+}
 
-	if (UserID == 0) {
-		//Create the Query
-		Telium_Sprintf (statement, "SELECT id, userName, password  FROM Users;");
+/**
+ * Read a column of the aid table for the AID selected, from RAM once the
+ * \n table is read. The row is the last one whose emvAid contains Aid, else
+ * \n the last one containing its first 10 digits.
+ * \param    Col:const char* (I) Column name, emvTACDft...
+ * \param    Aid:const char* (I) AID selected, in hex
+ * \param    Data:char* (O) Column value, "#" for NULL, "" when not found
+ * \param    iDim:int (I) Size of Data
+ * \return length of Data
+ */
+int sqlite_Aid_Get(const char *Col, const char *Aid, char *Data, int iDim){
+	char tcAid[10 + 1];
+	int iCol;
+	int iTry;
+
+	memset(Data, 0, iDim);
+	for (iCol = 0; iCol < SQL_AID_COLS; iCol++) {
+		if (strcmp(tzAidCol[iCol], Col) == 0)
+			break;
+	}
+	if (iCol == SQL_AID_COLS)
+		return 0;                      // Not a column: the former statement failed
+
+	memset(tcAid, 0, sizeof(tcAid));
+	strncpy(tcAid, Aid, sizeof(tcAid) - 1);
+	sqlite_Lock();
+	if ((sqlite_Aid_Load() > 0) && bAidAll) {
+		for (iTry = 0; (iTry < 2) && (*Data == 0); iTry++) {
+			strncpy(Data, sqlite_Aid_Find(iCol, iTry ? tcAid : Aid), iDim - 1);
+			xParamStat.Avoided++;
+		}
+		xParamStat.Hits++;
 	} else {
-		//Create the Query
-		Telium_Sprintf (statement, "SELECT userName, password  FROM Users WHERE id = '%d';", UserID);
+		sqlite_Aid_Query(iCol, Aid, Data, iDim);
+		if (*Data == 0)
+			sqlite_Aid_Query(iCol, tcAid, Data, iDim);
 	}
+	sqlite_Unlock();
+	return strlen(Data);
+}
 
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		iRet = sqlite3_prepare_v2(handle, (char *)statement, -1, &stmt, 0);
-		if (iRet){
-			Sqlite_Close(handle);
-			return -1;
+/**
+ * Give a function told of each parameter changed by Sqlite_Update_Parameter,
+ * \n with Name NULL when all of them may have changed (update rolled back,
+ * \n database made again); it rebuilds there what it derives from them.
+ * \param    Fn:tSqlParamFn (I) Function, called with the handle unlocked
+ * \return 1:OK, -1:no slot left
+ */
+int sqlite_Param_Watch(tSqlParamFn Fn){
+	int iIdx;
+	int iRet = -1;
+
+	sqlite_Lock();
+	for (iIdx = 0; iIdx < SQL_PARAM_WATCH; iIdx++) {
+		if ((tpfParamWatch[iIdx] == NULL) || (tpfParamWatch[iIdx] == Fn)) {
+			tpfParamWatch[iIdx] = Fn;
+			iRet = 1;
+			break;
 		}
-		// Read the number of rows fetched
-		cols = sqlite3_column_count(stmt);
-		while(1){
-			// fetch a row's status
-			iRet = sqlite3_step(stmt);
+	}
+	sqlite_Unlock();
+	return iRet;
+}
 
-			if (iRet == SQLITE_ROW){
-				// SQLITE_ROW means fetched a row
-				// sqlite3_column_text returns a const void* , typecast it to const char*
-				for (col = 0 ; col < cols; col++) {
-					memset(columnName, 0, sizeof(columnName));
-					const char *val = (const char*)sqlite3_column_text(stmt, col);
-					strcpy(columnName,sqlite3_column_name(stmt,col));
-					strcat(data,columnName);
-					strcat(data, ",");
-					strcat(data, val);
-					strcat(data, ";");
+/**
+ * Counters of the parameter reads since power up.
+ * \param    Stat:tSqlParamStat* (O) Reads served from RAM, queries avoided
+ * \n and queries made
+ */
+void sqlite_Param_Stats(tSqlParamStat *Stat){
+	sqlite_Lock();
+	*Stat = xParamStat;
+	sqlite_Unlock();
+}
 
-				}
-				strcat(data, "#");
-				returnVal++;
-			} else if (iRet == SQLITE_DONE) {
-				// All rows finished
-				break;
-			} else {
-				// Some error encountered
-			}
-		}
-		sqlite3_finalize(stmt);
-		Sqlite_Close(handle);
+/**
+ * Write a menu item into AppMenus, see Generate_Menu_Content.
+ * \n Called between sqlite_Txn_Begin() and sqlite_Txn_End(), so that the
+ * \n whole menu is written by one commit.
+ * \param    Id:word (I) menu item, mnuXxx.
+ * \param    Name:char* (I) text shown.
+ * \param    Parent:word (I) menu item holding it, 0 for the main menu.
+ * \param    Hidden:byte (I) 1 when not shown.
+ * \param    Secure:byte (I) 1 when protected by a password.
+ * \param    Level:byte (I) password asked, see fncSecurityPassword.
+ * \param    DrCr:char* (I) "D" debit, "C" credit, " " neither.
+ * \param    Icon:char* (I) icon of the icon menu.
+ * \return 1:OK, -1:error
+ */
+int Sqlite_Put_Menu(word Id, const char *Name, word Parent, byte Hidden, byte Secure, byte Level, const char *DrCr, const char *Icon){
+	sqlite3_stmt *hStmt;
+	int iRet = -1;
+
+	sqlite_Lock();
+	hStmt = sqlite_Stmt("INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES (?, ?, ?, ?, ?, ?, ?, ?);");
+	if (hStmt) {
+		sqlite3_bind_int(hStmt, 1, Id);
+		sqlite3_bind_text(hStmt, 2, Name, -1, SQLITE_STATIC);
+		sqlite3_bind_int(hStmt, 3, Parent);
+		sqlite3_bind_int(hStmt, 4, Hidden);
+		sqlite3_bind_int(hStmt, 5, Secure);
+		sqlite3_bind_int(hStmt, 6, Level);
+		sqlite3_bind_text(hStmt, 7, DrCr, -1, SQLITE_STATIC);
+		sqlite3_bind_text(hStmt, 8, Icon, -1, SQLITE_STATIC);
+		iRet = (sqlite3_step(hStmt) == SQLITE_DONE) ? 1 : -1;
+		sqlite_Done(hStmt);
+	}
+	sqlite_Unlock();
+	return iRet;
+}
+
+
+
+/**
+ * 	Run statement for users
+ */
+int Sqlite_Get_UserDetails(int UserID,char * data){
+	sqlite3_stmt *hStmt;
+	int cols;
+	int col;
+	int returnVal = 0;
+
+	sqlite_Lock();
+	if (UserID == 0) {
+		hStmt = sqlite_Stmt("SELECT id, userName, password  FROM Users;");
+	} else {
+		hStmt = sqlite_Stmt("SELECT userName, password  FROM Users WHERE id = ?;");
+		if (hStmt)
+			sqlite3_bind_int(hStmt, 1, UserID);
+	}
+	if (hStmt == NULL) {
+		sqlite_Unlock();
+		return -1;
+	}
 
+	// Read the number of rows fetched
+	cols = sqlite3_column_count(hStmt);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		// sqlite3_column_text returns a const void* , typecast it to const char*
+		for (col = 0 ; col < cols; col++) {
+			const char *val = (const char*)sqlite3_column_text(hStmt, col);
+			strcat(data, sqlite3_column_name(hStmt,col));
+			strcat(data, ",");
+			if (val != NULL)
+				strcat(data, val);
+			strcat(data, ";");
+		}
+		strcat(data, "#");
+		returnVal++;
 	}
+	sqlite_Done(hStmt);
+	sqlite_Unlock();
 	return returnVal;
 }
 
@@ -620,34 +1366,27 @@ int Sqlite_Get_UserDetails(int UserID,char * data){
  * 	Run statement
  */
 int Sqlite_Run_Statement_MultiRecord(const char * SqlStatement,char * data){
+	sqlite3_stmt *hStmt = NULL;
 	int iRet;
 	int cols;
 	int col;
-	char statement[1024];
 	int returnVal = 0;
 	char columnName[100];
 
-	memset(statement,0,sizeof(statement));
-
-	//Make sure DB Name is correct
-	refreshDBName();
-
-	//Create the Query
-	Telium_Sprintf (statement, "%s", SqlStatement);
-
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		iRet = sqlite3_prepare_v2(handle, (char *)statement, -1, &stmt, 0);
+	sqlite_Lock();
+	if (sqlite_Db() != NULL){
+		iRet = sqlite3_prepare_v2(hSqlDb, SqlStatement, -1, &hStmt, 0);
 		if (iRet){
-			Sqlite_Close(handle);
+			if (hStmt)
+				sqlite3_finalize(hStmt);
+			sqlite_Unlock();
 			return -1;
 		}
 		// Read the number of rows fetched
-		cols = sqlite3_column_count(stmt);
+		cols = sqlite3_column_count(hStmt);
 		while(1){
 			// fetch a row's status
-			iRet = sqlite3_step(stmt);
+			iRet = sqlite3_step(hStmt);
 
 			if (iRet == SQLITE_ROW){
 
@@ -658,8 +1397,8 @@ int Sqlite_Run_Statement_MultiRecord(const char * SqlStatement,char * data){
 				// sqlite3_column_text returns a const void* , typecast it to const char*
 				for (col = 0 ; col < cols; col++) {
 					memset(columnName, 0, sizeof(columnName));
-					const char *val = (const char*)sqlite3_column_text(stmt, col);
-					strcpy(columnName,sqlite3_column_name(stmt,col));
+					const char *val = (const char*)sqlite3_column_text(hStmt, col);
+					strcpy(columnName,sqlite3_column_name(hStmt,col));
 
 					if (cols > 1) {
 						strcat(data,columnName);
@@ -677,12 +1416,12 @@ int Sqlite_Run_Statement_MultiRecord(const char * SqlStatement,char * data){
 				break;
 			} else {
 				// Some error encountered
+				break;
 			}
 		}
-		sqlite3_finalize(stmt);
-		Sqlite_Close(handle);
-
+		sqlite3_finalize(hStmt);
 	}
+	sqlite_Unlock();
 	return returnVal;
 }
 
@@ -692,34 +1431,27 @@ int Sqlite_Run_Statement_MultiRecord(const char * SqlStatement,char * data){
  * 	Run statement
  */
 int Sqlite_Run_Statement_MultiRecord_NoColumnName(const char * SqlStatement,char * data){
+	sqlite3_stmt *hStmt = NULL;
 	int iRet;
 	int cols;
 	int col;
-	char statement[1024];
 	int returnVal = 0;
 	char columnName[100];
 
-	memset(statement,0,sizeof(statement));
-
-	//Create the Query
-	Telium_Sprintf (statement, "%s", SqlStatement);
-
-	//Make sure DB Name is correct
-	refreshDBName();
-
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		iRet = sqlite3_prepare_v2(handle, (char *)statement, -1, &stmt, 0);
+	sqlite_Lock();
+	if (sqlite_Db() != NULL){
+		iRet = sqlite3_prepare_v2(hSqlDb, SqlStatement, -1, &hStmt, 0);
 		if (iRet){
-			Sqlite_Close(handle);
+			if (hStmt)
+				sqlite3_finalize(hStmt);
+			sqlite_Unlock();
 			return -1;
 		}
 		// Read the number of rows fetched
-		cols = sqlite3_column_count(stmt);
+		cols = sqlite3_column_count(hStmt);
 		while(1){
 			// fetch a row's status
-			iRet = sqlite3_step(stmt);
+			iRet = sqlite3_step(hStmt);
 
 			if (iRet == SQLITE_ROW){
 
@@ -730,7 +1462,7 @@ int Sqlite_Run_Statement_MultiRecord_NoColumnName(const char * SqlStatement,char
 				// sqlite3_column_text returns a const void* , typecast it to const char*
 				for (col = 0 ; col < cols; col++) {
 					memset(columnName, 0, sizeof(columnName));
-					const char *val = (const char*)sqlite3_column_text(stmt, col);
+					const char *val = (const char*)sqlite3_column_text(hStmt, col);
 
 					if(val != NULL)
 						strcat(data, val);
@@ -743,12 +1475,12 @@ int Sqlite_Run_Statement_MultiRecord_NoColumnName(const char * SqlStatement,char
 				break;
 			} else {
 				// Some error encountered
+				break;
 			}
 		}
-		sqlite3_finalize(stmt);
-		Sqlite_Close(handle);
-
+		sqlite3_finalize(hStmt);
 	}
+	sqlite_Unlock();
 	return returnVal;
 }
 
@@ -757,12 +1489,18 @@ int Sqlite_Run_Statement_MultiRecord_NoColumnName(const char * SqlStatement,char
  *
  */
 int SqliteApp_DropDataBase(void) {
+	char tcWal[sizeof(DataBaseName) + 4];
 	int iRet;
 
+	sqlite_Release();
 	iRet = DiskMount(DISK_PATH, 16);
 	if (iRet == SQLITE_OK) {
 		//		iRet = FS_unlink(DISK_PATH"/""TSLDb");
 		iRet = FS_unlink(DataBaseName);
+		Telium_Sprintf(tcWal, "%s-wal", DataBaseName); // Left by a power failure, it would be replayed into the new database
+		FS_unlink(tcWal);
+		Telium_Sprintf(tcWal, "%s-shm", DataBaseName);
+		FS_unlink(tcWal);
 	}
 	FS_unmount(DISK_PATH);
 	FS_dskkill(DISK_PATH);
@@ -780,7 +1518,9 @@ int SqliteApp_CopyFileToHost(void) {
 	S_FS_FILE *hSrcFile = NULL;
 	S_FS_FILE *hDestFile = NULL;
 	char *bufFile = NULL;
+	char tcHost[100 + 8];
 
+	sqlite_Checkpoint();               // The database file alone holds every commit
 	iRet = DiskMount(DISK_PATH, 16);
 	if (iRet == SQLITE_OK) {
 		//		hSrcFile = FS_open(DISK_PATH"/""TSLDb", "r");
@@ -797,10 +1537,9 @@ int SqliteApp_CopyFileToHost(void) {
 	}
 	if (iRet == SQLITE_OK) {
 
-		//		FS_unlink(DISK_HOST"/""TSLDb");
-		FS_unlink((const char *)refreshDBName);
-		//		hDestFile = FS_open(DISK_HOST"/""TSLDb", "a");
-		hDestFile = FS_open((const char *)refreshDBName, "a");
+		Telium_Sprintf(tcHost, "%s%s", DISK_HOST, strrchr(DataBaseName, '/')); // Same name on the host disk
+		FS_unlink(tcHost);
+		hDestFile = FS_open(tcHost, "a");
 		if (hDestFile == NULL) {
 			iRet = -1;
 		}
@@ -844,12 +1583,12 @@ int SqliteDB_Init(void){
 	// Create the database
 	SqliteApp_Create();
 
-	//prepare App data
-	Generate_Menu_Content();
-
 	//Insert temporary data
 	SqliteApp_Insert();
 
+	//Write the menu
+	Generate_Menu_Content();
+
 	return ret;
 }
 
@@ -1000,136 +1739,1602 @@ static void Sqlite_SaveTo_tra(char * columnName, char * DataToSave){
 	lblKO:;
 }
 
-int sqlite_CloseVoid(char * STAN){
+/**
+ * Columns of the log that Sqlite_SaveTo_tra() puts into the data map, in
+ * \n the order of the view, with the field each is saved from and its form
+ * \n in the view: text as saved, integer column (LOG_RING_INT), or integer
+ * \n padded by LOG_PAD to that many digits. isoField055 is taken from
+ * \n traEMVDATA by Sqlite_SaveTo_tra(), no column is kept.
+ */
+#define LOG_RING_TXT    0
+#define LOG_RING_INT    1
+#define LOG_RING_NONE   2
+
+typedef struct {
+	const char *pcCol;
+	word usKey;
+	byte bFmt;
+} tLogRingCol;
+
+static const tLogRingCol tzLogRingCol[] = {
+		{"MenuItem", traMnuItm, LOG_RING_INT}, {"InvoiceNo", traInvNum, LOG_RING_TXT}, {"isoField002", traPan, LOG_RING_TXT},
+		{"isoField003", traRqsProcessingCode, LOG_RING_TXT}, {"isoField004", traAmt, 12}, {"isoField007", traDatTim, LOG_RING_INT},
+		{"isoField011", traSTAN, 6}, {"isoField014", traExpDat, LOG_RING_TXT}, {"isoField022", traPosEntMod, LOG_RING_TXT},
+		{"isoField023", traCrdSeq, LOG_RING_TXT}, {"isoField025", traConCode, LOG_RING_TXT}, {"isoField035", traTrk2, LOG_RING_TXT},
+		{"isoField037", traRrn, LOG_RING_TXT}, {"isoField038", traAutCod, LOG_RING_TXT}, {"isoField039", traRspCod, LOG_RING_TXT},
+		{"isoField049", emvTrnCurCod, LOG_RING_TXT}, {"isoField054", traCashbackAmt, 12}, {"isoField055", 0, LOG_RING_NONE},
+		{"isoField062", traBillerPaymentDetails, LOG_RING_TXT}, {"isoField063", traField063, LOG_RING_TXT},
+};
+
+static char zLogVal[2048 + 1];         // One map field (Field 62 the largest), used locked
+
+/**
+ * Read a field saved into an integer column, as SQLite stores it: an
+ * \n integer when the text is one, NULL when empty, the text otherwise.
+ * \param    usKey:word (I) Field of the data map
+ * \param    pllVal:sqlite3_int64* (O) Integer
+ * \param    pcDec:char* (O) Its decimal text as SQLite prints it, 24 bytes
+ * \return 1:integer, 0:NULL, -1:other text, not kept in the ring
+ */
+static int sqlite_Ring_Int(word usKey, sqlite3_int64 *pllVal, char *pcDec){
+	const char *pc = zLogVal;
+	sqlite3_int64 llVal = 0;
+	int iDig = 0;
+	byte bNeg;
+
+	if (mapGet(usKey, zLogVal, sizeof(zLogVal) - 1) < 0)
+		zLogVal[0] = 0;
+	if (zLogVal[0] == 0)
+		return 0;
+	bNeg = (*pc == '-');
+	if ((*pc == '-') || (*pc == '+'))
+		pc++;
+	for (; (pc[iDig] >= '0') && (pc[iDig] <= '9'); iDig++)
+		llVal = llVal * 10 + (pc[iDig] - '0');
+	if ((iDig == 0) || (iDig > 18) || (pc[iDig] != 0))
+		return -1;
+
+	while ((*pc == '0') && (pc[1] != 0))
+		pc++;
+	*pllVal = bNeg ? -llVal : llVal;
+	Telium_Sprintf(pcDec, "%s%s", (bNeg && llVal) ? "-" : "", pc);
+	return 1;
+}
 
+/**
+ * Keep the record just saved, with id llId, at the head of the ring: the
+ * \n columns searched, then the columns read back, as the view gives them,
+ * \n from the data map still holding the transaction. A record whose
+ * \n columns cannot be given without SQLite is kept unserved, so that a
+ * \n lookup reaching it asks SQLite.
+ */
+static void sqlite_Ring_Put(sqlite3_int64 llId){
+	tLogRing *pxRec = &tzLogRing[iRingPos];
+	sqlite3_int64 llVal;
+	char tcDec[24];
+	char tcPad[12 + 24];
+	const char *pcVal;
+	int iCol;
+	int iLen;
 	int iRet;
-	char statement[100];
 
-	memset(statement,0,sizeof(statement));
+	memset(pxRec, 0, sizeof(*pxRec));
+	pxRec->llId = llId;
+	pxRec->bServed = 1;
+
+	iRet = sqlite_Ring_Int(appBatchNumber, &pxRec->llBatch, tcDec);
+	pxRec->bNull |= (iRet == 0) ? LOG_RING_BATCH : 0;
+	pxRec->bServed &= (iRet >= 0);
+	iRet = sqlite_Ring_Int(traMnuItm, &pxRec->llMenu, tcDec);
+	pxRec->bNull |= (iRet == 0) ? LOG_RING_MENU : 0;
+	pxRec->bServed &= (iRet >= 0);
+	iRet = sqlite_Ring_Int(traSTAN, &pxRec->llStan, tcDec);
+	pxRec->bNull |= (iRet == 0) ? LOG_RING_STAN : 0;
+	pxRec->bServed &= (iRet >= 0);
+	if (mapGet(traRrn, zLogVal, sizeof(zLogVal) - 1) < 0)
+		zLogVal[0] = 0;
+	pxRec->bServed &= (strlen(zLogVal) <= lenRrn);
+	strncpy(pxRec->zRrn, zLogVal, lenRrn);
+	if (mapGet(traAutCod, zLogVal, sizeof(zLogVal) - 1) < 0)
+		zLogVal[0] = 0;
+	pxRec->bServed &= (strlen(zLogVal) <= lenAutCod);
+	strncpy(pxRec->zAutCod, zLogVal, lenAutCod);
+
+	for (iCol = 0; pxRec->bServed && (iCol < (int)(sizeof(tzLogRingCol) / sizeof(tzLogRingCol[0]))); iCol++) {
+		pcVal = "";
+		if (tzLogRingCol[iCol].bFmt == LOG_RING_TXT) {
+			if (mapGet(tzLogRingCol[iCol].usKey, zLogVal, sizeof(zLogVal) - 1) < 0)
+				zLogVal[0] = 0;
+			pcVal = zLogVal;
+		} else if (tzLogRingCol[iCol].bFmt != LOG_RING_NONE) {
+			iRet = sqlite_Ring_Int(tzLogRingCol[iCol].usKey, &llVal, tcDec);
+			pxRec->bServed &= (iRet >= 0);
+			if ((iRet > 0) && (tzLogRingCol[iCol].bFmt == LOG_RING_INT))
+				pcVal = tcDec;
+			else if (iRet > 0) {       // substr(zeros || value, -n, n)
+				memset(tcPad, '0', tzLogRingCol[iCol].bFmt);
+				strcpy(&tcPad[tzLogRingCol[iCol].bFmt], tcDec);
+				pcVal = &tcPad[strlen(tcPad) - tzLogRingCol[iCol].bFmt];
+			}
+		}
+		iLen = strlen(pcVal);
+		if (iLen > 255)                // As read back by sqlite_Get_LOG_Record
+			iLen = 255;
+		if (pxRec->usLen + 1 + iLen > LOG_RING_DATA) {
+			pxRec->bServed = 0;
+			break;
+		}
+		pxRec->tbData[pxRec->usLen++] = (byte)iLen;
+		memcpy(&pxRec->tbData[pxRec->usLen], pcVal, iLen);
+		pxRec->usLen += iLen;
+	}
 
-	//Create the Query
-	Telium_Sprintf (statement, "UPDATE log SET isoVoided = '1' WHERE isoField011 = '%s';", STAN);
+	iRingPos = (iRingPos + 1) % LOG_RING_SIZE;
+	if (iRingCnt < LOG_RING_SIZE)
+		iRingCnt++;
+}
 
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		Sqlite_Exec(handle, (char *)statement);
+/**
+ * Search the ring from the newest record, as tzLogFind searches the log.
+ * \n The ring holds the last records saved, so the first one matching is
+ * \n the one SQLite would give.
+ * \return the record, NULL when the ring cannot tell: to be asked to SQLite
+ */
+static const tLogRing *sqlite_Ring_Find(int iKey, const char *pcRrn, const char *pcAutCod, int iStan, int iBatch){
+	const tLogRing *pxRec;
+	int iIdx;
+
+	for (iIdx = 1; iIdx <= iRingCnt; iIdx++) {
+		pxRec = &tzLogRing[(iRingPos + LOG_RING_SIZE - iIdx) % LOG_RING_SIZE];
+		if (!pxRec->bServed)
+			return NULL;
+		if ((pxRec->bNull & (LOG_RING_BATCH | LOG_RING_MENU)) || (pxRec->llBatch != iBatch) || pxRec->bVoided)
+			continue;
+		if ((pxRec->llMenu == mnuVoid) || (pxRec->llMenu == mnuReversal) || ((iKey == 0) && (pxRec->llMenu == mnuBalanceEnquiry)))
+			continue;
+		if ((iKey & 1) && (strcmp(pxRec->zRrn, pcRrn) != 0))
+			continue;
+		if ((iKey & 2) && (strcmp(pxRec->zAutCod, pcAutCod) != 0))
+			continue;
+		if ((iKey & 4) && ((pxRec->bNull & LOG_RING_STAN) || (pxRec->llStan != iStan)))
+			continue;
+		return pxRec;
 	}
-	Sqlite_Close(handle);
-	return 1;
+	return NULL;
+}
 
+/**
+ * Put a record of the ring into the data map, column by column as
+ * \n sqlite_Get_LOG_Record does from the view.
+ */
+static void sqlite_Ring_Get(const tLogRing *pxRec){
+	char data[256];
+	const byte *pbCol = pxRec->tbData;
+	int iCol;
+
+	for (iCol = 0; iCol < (int)(sizeof(tzLogRingCol) / sizeof(tzLogRingCol[0])); iCol++) {
+		memset(data, 0, sizeof(data));
+		memcpy(data, &pbCol[1], pbCol[0]);
+		pbCol += 1 + pbCol[0];
+		Sqlite_SaveTo_tra((char *)tzLogRingCol[iCol].pcCol, data);
+	}
+}
 
+int sqlite_CloseVoid(char * STAN){
+	sqlite3_stmt *hStmt;
+	tLogRing *pxRec;
+	int iIdx;
+	int iRet = -1;
+
+	sqlite_Lock();
+	hStmt = sqlite_Stmt("UPDATE trn SET Voided = 1 WHERE Stan = ?;");
+	if (hStmt) {
+		sqlite3_bind_int(hStmt, 1, atoi(STAN));
+		iRet = (sqlite3_step(hStmt) == SQLITE_DONE) ? 1 : -1;
+		sqlite_Done(hStmt);
+	}
+	for (iIdx = 1; (iRet > 0) && (iIdx <= iRingCnt); iIdx++) {
+		pxRec = &tzLogRing[(iRingPos + LOG_RING_SIZE - iIdx) % LOG_RING_SIZE];
+		if (!(pxRec->bNull & LOG_RING_STAN) && (pxRec->llStan == atoi(STAN)))
+			pxRec->bVoided = 1;        // Kept as the log
+	}
+	sqlite_Unlock();
+	return iRet;
 }
 
+/**
+ * Queries of sqlite_Get_LOG_Record, by the keys given: bit 0 RRN (?1),
+ * \n bit 1 approval code (?2), bit 2 STAN (?3). ?4 and ?5 are the void and
+ * \n reversal menu items; without key the balance enquiries (?6) are left
+ * \n out too. Only the open batch (?7) is searched. The record is found on
+ * \n the index of its key, or of the batch without key, then read whole from
+ * \n the view. A recent record is found in the ring first.
+ */
+#define LOG_FIND        "SELECT * FROM log WHERE id = (SELECT id FROM trn WHERE "
+#define LOG_FIND_LAST   " AND +BatchNo = ?7 AND Voided != 1 AND MenuItem != ?4 AND MenuItem != ?5 ORDER BY id DESC LIMIT 1);"
+static const char *tzLogFind[8] = {
+		LOG_FIND "BatchNo = ?7 AND MenuItem != ?6 AND MenuItem != ?4 AND MenuItem != ?5 AND Voided != 1 ORDER BY id DESC LIMIT 1);",
+		LOG_FIND "Rrn = ?1" LOG_FIND_LAST,
+		LOG_FIND "AutCod = ?2" LOG_FIND_LAST,
+		LOG_FIND "Rrn = ?1 AND AutCod = ?2" LOG_FIND_LAST,
+		LOG_FIND "Stan = ?3" LOG_FIND_LAST,
+		LOG_FIND "Rrn = ?1 AND Stan = ?3" LOG_FIND_LAST,
+		LOG_FIND "AutCod = ?2 AND Stan = ?3" LOG_FIND_LAST,
+		LOG_FIND "Rrn = ?1 AND AutCod = ?2 AND Stan = ?3" LOG_FIND_LAST,
+};
+
 int sqlite_Get_LOG_Record(word RRN,word APPRVCODE,word STAN){
+	sqlite3_stmt *hStmt = NULL;
+	const tLogRing *pxRec;
 	int ret = 0;
-	int whereClause = 0;
-	int iRet;
+	int iKey = 0;
 	int cols;
 	int col;
-	char PreparedStatement[300];
-	char Statement[300];
-	int returnVal = 0;
 	char columnName[256];
 	char data[256];
 	char RRN_Val[lenRrn + 1];
 	char APPRVCODE_Val[lenAutCod + 1];
 	char STAN_Val[lenSTAN + 3];
+	char BatchNo[lenBatNum + 3];
 
+	memset(BatchNo, 0, sizeof(BatchNo));
+	mapGet(appBatchNumber, BatchNo, sizeof(BatchNo) - 1);
 	memset(RRN_Val,0,sizeof(RRN_Val));
 	memset(STAN_Val,0,sizeof(STAN_Val));
-	memset(Statement,0,sizeof(Statement));
 	memset(APPRVCODE_Val,0,sizeof(APPRVCODE_Val));
-	memset(PreparedStatement,0,sizeof(PreparedStatement));
-
-	//Create the query
-	strcpy(Statement,"SELECT * FROM log WHERE ");
 
 	if (RRN > 0){
 		MAPGET(RRN, RRN_Val, lblKO);
-		strcat(Statement,"isoField037 = '");
-		strcat(Statement,RRN_Val);
-		strcat(Statement,"' ");
-		whereClause = 1;
+		iKey |= 1;
 	}
-
 	if (APPRVCODE > 0){
-		MAPGET(RRN, APPRVCODE_Val, lblKO);
-		if (whereClause == 1)
-			strcat(Statement,"AND ");
-		strcat(Statement,"isoField038 = '");
-		strcat(Statement,APPRVCODE_Val);
-		strcat(Statement,"' ");
-		whereClause = 1;
+		MAPGET(APPRVCODE, APPRVCODE_Val, lblKO);
+		iKey |= 2;
 	}
-
 	if (STAN > 0){
 		MAPGET(STAN, STAN_Val, lblKO);
-		if (whereClause == 1)
-			strcat(Statement,"AND ");
-		strcat(Statement,"isoField011 = '");
-		strcat(Statement,STAN_Val);
-		strcat(Statement,"' ");
-		whereClause = 1;
-	}
-
-	if (whereClause == 0) {
-		//Telium_Sprintf(PreparedStatement, "id = (SELECT MAX(id) FROM log)");
-		Telium_Sprintf(PreparedStatement, "MenuItem != '%d' AND MenuItem != '%d' AND MenuItem != '%d' AND isoVoided != '1' ORDER BY id DESC LIMIT 1", mnuBalanceEnquiry, mnuVoid, mnuReversal);
-		strcat(Statement,PreparedStatement);
-	}else{
-		Telium_Sprintf(PreparedStatement, "AND isoVoided != '1' AND MenuItem != '%d' AND MenuItem != '%d' ORDER BY id DESC LIMIT 1 ", mnuVoid, mnuReversal);
-		strcat(Statement,PreparedStatement);
-		//strcat(Statement,"AND isoVoided != '1' ");
-	}
-	strcat(Statement,";");
-
-	//finish creating query
+		iKey |= 4;
+	}
+
 	ret = -1;
-	//	iRet = Sqlite_Open(DISK_PATH"/""TSLDb", &handle);
-	iRet = Sqlite_Open(DataBaseName, &handle);
-	if (iRet == SQLITE_OK){
-		iRet = sqlite3_prepare_v2(handle, (char *)Statement, -1, &stmt, 0);
-		if (iRet){
-			Sqlite_Close(handle);
+	sqlite_Lock();
+	pxRec = sqlite_Ring_Find(iKey, RRN_Val, APPRVCODE_Val, atoi(STAN_Val), atoi(BatchNo));
+	if (pxRec) {
+		sqlite_Ring_Get(pxRec);
+		sqlite_Unlock();
+		return 1;
+	}
+	hStmt = sqlite_Stmt(tzLogFind[iKey]);
+	if (hStmt == NULL) {
+		sqlite_Unlock();
+		return -1;
+	}
+	if (iKey & 1)
+		sqlite3_bind_text(hStmt, 1, RRN_Val, -1, SQLITE_STATIC);
+	if (iKey & 2)
+		sqlite3_bind_text(hStmt, 2, APPRVCODE_Val, -1, SQLITE_STATIC);
+	if (iKey & 4)
+		sqlite3_bind_int(hStmt, 3, atoi(STAN_Val));
+	sqlite3_bind_int(hStmt, 4, mnuVoid);
+	sqlite3_bind_int(hStmt, 5, mnuReversal);
+	if (iKey == 0)
+		sqlite3_bind_int(hStmt, 6, mnuBalanceEnquiry);
+	sqlite3_bind_int(hStmt, 7, atoi(BatchNo));
+
+	// Read the number of rows fetched
+	cols = sqlite3_column_count(hStmt);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		// sqlite3_column_text returns a const void* , typecast it to const char*
+		for (col = 0 ; col < cols; col++) {
+			const char *val = (const char*)sqlite3_column_text(hStmt, col);
+
+			memset(data, 0, sizeof(data));
+			memset(columnName, 0, sizeof(columnName));
+			strncpy(columnName, sqlite3_column_name(hStmt,col), sizeof(columnName) - 1);
+			if (val != NULL)
+				strncpy(data, val, sizeof(data) - 1);
+
+			Sqlite_SaveTo_tra(columnName, data);
+			ret = 1;
+		}
+	}
+	sqlite_Done(hStmt);
+	sqlite_Unlock();
+
+	return ret;
+	lblKO:
+	return -1;
+}
+
+/**
+ * Columns of the log saved by sqlite_Log_Save, bound from the data map in
+ * \n the order of the insert parameters. An integer column empty in the map
+ * \n is stored NULL; otherwise the text is converted by the column type.
+ */
+typedef struct {
+	word usKey;
+	byte bInt;
+} tLogCol;
+
+static const tLogCol tzLogTrn[] = {
+		{traMnuItm, 1}, {traInvNum, 0}, {appBatchNumber, 1}, {traPan, 0}, {traAmt, 1}, {traCashbackAmt, 1}, {traDatTim, 1},
+		{traSTAN, 1}, {traRrn, 0}, {traAutCod, 0}, {traRspCod, 0}, {appTID, 0}, {emvTrnCurCod, 0}, {traDrCr, 0},
+};
+static const tLogCol tzLogExt[] = {
+		{traRqsMTI, 0}, {traRqsProcessingCode, 0}, {traExpDat, 0}, {traPosEntMod, 0}, {traCrdSeq, 0}, {appNII, 0},
+		{traConCode, 0}, {traTrk2, 0}, {appMID, 0}, {traBillerPaymentDetails, 0}, {traField063, 0}, {traNetTiming, 0},
+};
+#define LOG_SAVE_TRN    "INSERT INTO trn (MenuItem, InvoiceNo, BatchNo, Pan, Amount, CashbackAmt, TrnDateTime, Stan, Rrn, AutCod, RspCod, Tid, Currency, DrCr) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);"
+#define LOG_SAVE_EXT    "INSERT INTO trn_ext (Mti, PrcCod, ExpDat, PosEntMod, CrdSeq, Nii, ConCode, Trk2, Mid, Field062, Field063, NetTiming, Emv, id) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);"
+#define LOG_SAVE_EMV    (sizeof(tzLogExt) / sizeof(tzLogExt[0]) + 1)
+
+static int sqlite_Log_Bind(sqlite3_stmt *hStmt, const tLogCol *pxCol, int iCnt){
+	int iIdx;
+	int iRet;
+
+	for (iIdx = 0; iIdx < iCnt; iIdx++) {
+		if (mapGet(pxCol[iIdx].usKey, zLogVal, sizeof(zLogVal) - 1) < 0)
+			zLogVal[0] = 0;
+		if (pxCol[iIdx].bInt && (zLogVal[0] == 0))
+			iRet = sqlite3_bind_null(hStmt, iIdx + 1);
+		else
+			iRet = sqlite3_bind_text(hStmt, iIdx + 1, zLogVal, -1, SQLITE_TRANSIENT);
+		if (iRet != SQLITE_OK)
 			return -1;
+	}
+	return 1;
+}
+
+/**
+ * Save the transaction in the log, its columns bound from the data map
+ * \n into the compiled inserts of trn and trn_ext; no SQL text is built.
+ * \n The EMV data is taken from isoField055, where the request builder left
+ * \n it in hex. Both rows are written or none; inside sqlite_Txn_Begin() they
+ * \n are committed with the other writes of the sale. The record is then
+ * \n kept in the ring of the recent records.
+ * \return 1:OK, -1:error
+ */
+int sqlite_Log_Save(void){
+	sqlite3_stmt *hTrn;
+	sqlite3_stmt *hExt;
+	sqlite3_int64 llId;
+	int iLen;
+	int iRet = -1;
+
+	sqlite_Lock();
+	hTrn = sqlite_Stmt(LOG_SAVE_TRN);
+	hExt = sqlite_Stmt(LOG_SAVE_EXT);
+	CHECK((hTrn != NULL) && (hExt != NULL), lblEnd);
+	CHECK(sqlite3_exec(hSqlDb, "SAVEPOINT logSave;", NULL, NULL, NULL) == SQLITE_OK, lblEnd);
+
+	CHECK(sqlite_Log_Bind(hTrn, tzLogTrn, sizeof(tzLogTrn) / sizeof(tzLogTrn[0])) > 0, lblKO);
+	CHECK(sqlite3_step(hTrn) == SQLITE_DONE, lblKO);
+	llId = sqlite3_last_insert_rowid(hSqlDb);
+
+	CHECK(sqlite_Log_Bind(hExt, tzLogExt, sizeof(tzLogExt) / sizeof(tzLogExt[0])) > 0, lblKO);
+	iLen = (int)strlen(isoField055) / 2;
+	if ((strlen(isoField055) % 2) || (iLen > (int)sizeof(zLogVal)) || (iLen && (hex2bin((byte *)zLogVal, isoField055, iLen) != iLen)))
+		iLen = 0;                      // Stored in binary: only hex is kept
+	sqlite3_bind_blob(hExt, LOG_SAVE_EMV, zLogVal, iLen, SQLITE_TRANSIENT);
+	sqlite3_bind_int64(hExt, LOG_SAVE_EMV + 1, llId);
+	CHECK(sqlite3_step(hExt) == SQLITE_DONE, lblKO);
+
+	CHECK(sqlite3_exec(hSqlDb, "RELEASE logSave;", NULL, NULL, NULL) == SQLITE_OK, lblKO);
+	sqlite_Ring_Put(llId);
+	iRet = 1;
+	goto lblEnd;
+
+	lblKO:
+	sqlite_Done(hTrn);
+	sqlite_Done(hExt);
+	sqlite3_exec(hSqlDb, "ROLLBACK TO logSave; RELEASE logSave;", NULL, NULL, NULL);
+	lblEnd:
+	if (hTrn)
+		sqlite_Done(hTrn);
+	if (hExt)
+		sqlite_Done(hExt);
+	sqlite_Unlock();
+	return iRet;
+}
+
+/**
+ * Close the open batch after its settlement. Its records stay in the log,
+ * \n out of the open batch read by the lookups, totals, reports and batch
+ * \n upload, until sqlite_Log_Prune() removes them: the cutover writes one
+ * \n row whatever the size of the batch. The record ids go on.
+ * \return 1:OK, -1:error
+ */
+int sqlite_Log_Close(void){
+	sqlite3_stmt *hStmt;
+	char BatchNo[lenBatNum + 3];
+	int iRet = -1;
+
+	memset(BatchNo, 0, sizeof(BatchNo));
+	mapGet(appBatchNumber, BatchNo, sizeof(BatchNo) - 1);
+
+	sqlite_Lock();
+	hStmt = sqlite_Stmt("INSERT OR REPLACE INTO trn_closed (BatchNo) VALUES (?);");
+	if (hStmt) {
+		sqlite3_bind_int(hStmt, 1, atoi(BatchNo));
+		iRet = (sqlite3_step(hStmt) == SQLITE_DONE) ? 1 : -1;
+		sqlite_Done(hStmt);
+	}
+	iRingCnt = 0;                      // Records of the batch closed
+	sqlite_Unlock();
+	return iRet;
+}
+
+/**
+ * Queries of sqlite_Log_Prune: the oldest closed batch beyond the Keep (?1)
+ * \n most recent, never the open batch (?2); a chunk of its records; its
+ * \n totals and its row once it is empty.
+ */
+static const char zLogPruneBatch[] = "SELECT BatchNo FROM (SELECT id, BatchNo FROM trn_closed WHERE BatchNo != ?2 ORDER BY id DESC LIMIT -1 OFFSET ?1) ORDER BY id LIMIT 1;";
+static const char zLogPruneRows[] = "DELETE FROM trn WHERE id IN (SELECT id FROM trn WHERE BatchNo = ?1 ORDER BY id LIMIT ?2);";
+static const char zLogPruneTot[] = "DELETE FROM trn_tot WHERE BatchNo = ?;";
+static const char zLogPruneEnd[] = "DELETE FROM trn_closed WHERE BatchNo = ?;";
+
+/**
+ * Remove old batches from the log, a chunk of records per call so that the
+ * \n handle is never held long: called while the terminal is idle, again
+ * \n until it returns 0. The delete triggers take the running totals and
+ * \n the trn_ext rows with the records.
+ * \param    Keep:int (I) closed batches kept, the most recent.
+ * \param    Rows:int (I) records removed at most.
+ * \return records removed (1 for an empty batch forgotten), 0 if nothing is
+ * \n left to prune, -1 on error
+ */
+int sqlite_Log_Prune(int Keep, int Rows){
+	sqlite3_stmt *hStmt = NULL;
+	char BatchNo[lenBatNum + 3];
+	int iBatch, iDel = 0;
+	int iRet = -1;
+
+	memset(BatchNo, 0, sizeof(BatchNo));
+	mapGet(appBatchNumber, BatchNo, sizeof(BatchNo) - 1);
+
+	sqlite_Lock();
+	hStmt = sqlite_Stmt(zLogPruneBatch);
+	CHECK(hStmt != NULL, lblEnd);
+	sqlite3_bind_int(hStmt, 1, Keep);
+	sqlite3_bind_int(hStmt, 2, atoi(BatchNo));
+	iRet = 0;
+	CHECK(sqlite3_step(hStmt) == SQLITE_ROW, lblEnd); // Nothing beyond the retention
+	iBatch = sqlite3_column_int(hStmt, 0);
+	sqlite_Done(hStmt);
+	hStmt = NULL;
+
+	iRet = -1;
+	CHECK(sqlite3_exec(hSqlDb, "SAVEPOINT logPrune;", NULL, NULL, NULL) == SQLITE_OK, lblEnd);
+	hStmt = sqlite_Stmt(zLogPruneRows);
+	CHECK(hStmt != NULL, lblKO);
+	sqlite3_bind_int(hStmt, 1, iBatch);
+	sqlite3_bind_int(hStmt, 2, Rows);
+	CHECK(sqlite3_step(hStmt) == SQLITE_DONE, lblKO);
+	iDel = sqlite3_changes(hSqlDb);
+	sqlite_Done(hStmt);
+	hStmt = NULL;
+
+	if (iDel < Rows) {                 // Last records of the batch: the batch goes with them
+		hStmt = sqlite_Stmt(zLogPruneTot);
+		CHECK(hStmt != NULL, lblKO);
+		sqlite3_bind_int(hStmt, 1, iBatch);
+		CHECK(sqlite3_step(hStmt) == SQLITE_DONE, lblKO);
+		sqlite_Done(hStmt);
+		hStmt = sqlite_Stmt(zLogPruneEnd);
+		CHECK(hStmt != NULL, lblKO);
+		sqlite3_bind_int(hStmt, 1, iBatch);
+		CHECK(sqlite3_step(hStmt) == SQLITE_DONE, lblKO);
+		sqlite_Done(hStmt);
+		hStmt = NULL;
+	}
+	CHECK(sqlite3_exec(hSqlDb, "RELEASE logPrune;", NULL, NULL, NULL) == SQLITE_OK, lblKO);
+	iRet = (iDel > 0) ? iDel : 1;
+	goto lblEnd;
+
+	lblKO:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	hStmt = NULL;
+	sqlite3_exec(hSqlDb, "ROLLBACK TO logPrune; RELEASE logPrune;", NULL, NULL, NULL);
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return iRet;
+}
+
+/**
+ * Give free pages of the database back to the disk, a few per call so that
+ * \n the handle is never held long: called while the terminal is idle, after
+ * \n sqlite_Log_Prune, again until it returns 0. In WAL mode the file
+ * \n shrinks at the next sqlite_Checkpoint(). Left to the next call while a
+ * \n transaction is open.
+ * \param    Pages:int (I) pages given back at most.
+ * \return pages given back, 0 if none is free, -1 on error
+ */
+int sqlite_Vacuum_Step(int Pages){
+	char tcSql[40];
+	long lFree;
+	long lLeft;
+	int iRet = -1;
+
+	sqlite_Lock();
+	CHECK(sqlite_Db() != NULL, lblEnd);
+	iRet = 0;
+	CHECK(iSqlTxn == 0, lblEnd);
+	lFree = sqlite_Int("PRAGMA freelist_count;");
+	CHECK(lFree > 0, lblEnd);          // Nothing free, or error: left to the next pass
+
+	iRet = -1;
+	Telium_Sprintf(tcSql, "PRAGMA incremental_vacuum(%d);", Pages);
+	CHECK(sqlite3_exec(hSqlDb, tcSql, NULL, NULL, NULL) == SQLITE_OK, lblEnd);
+	lLeft = sqlite_Int("PRAGMA freelist_count;");
+	CHECK(lLeft >= 0, lblEnd);
+	iRet = (int)(lFree - lLeft);       // 0 when the database is not in incremental mode
+
+	lblEnd:
+	sqlite_Unlock();
+	return iRet;
+}
+
+/**
+ * Queries of sqlite_Capacity: the records of the log, and the records a day
+ * \n over the last days given (?), rounded up, a day at least.
+ */
+static const char zCapRecords[] = "SELECT COUNT(*) FROM trn;";
+static const char zCapRate[] = "SELECT CAST(COUNT(*) / MAX(1.0, julianday('now') - MIN(julianday(DateTimeStamp))) + 0.999 AS INTEGER) FROM trn WHERE DateTimeStamp >= datetime('now', ?);";
+
+/**
+ * Forecast the room left for the log on the database disk: the free space
+ * \n of the disk and the free pages of the database, less the room the WAL
+ * \n of a sale and the prune of the settlement need (CAP_RESERVE_PAGES),
+ * \n divided by the bytes a record takes.
+ * \n The days left are those before the sales are held, the records left
+ * \n over CAP_FULL_RECORDS divided by the records a day over the last
+ * \n CAP_RATE_DAYS days; the merchant is asked to settle with
+ * \n CAP_WARN_DAYS of them left. The bytes of a record are those of the
+ * \n whole database over its records, which overstates them while the log
+ * \n is small. The WAL of the sales made since the terminal was last idle
+ * \n is not free space: below capOk the room is measured again once after
+ * \n a checkpoint, the WAL going back to the disk.
+ * \param    Cap:tSqlCap* (O) room, rate and days left.
+ * \return capOk, capWarn (the merchant asked to settle), capFull (the sales
+ * \n wait for a settlement), -1 on error
+ */
+int sqlite_Capacity(tSqlCap *Cap){
+	sqlite3_stmt *hStmt = NULL;
+	char tcDays[16];
+	long lPage;
+	long lPages;
+	long lFree;
+	int iTry;
+	int iRet = -1;
+
+	sqlite_Lock();
+	CHECK(sqlite_Db() != NULL, lblEnd);
+	for (iTry = 0; ; iTry++) {
+		memset(Cap, 0, sizeof(*Cap));
+		Cap->DiskFree = FS_dskfree(DISK_PATH);
+		if (Cap->DiskFree < 0)
+			Cap->DiskFree = 0;
+		lPage = sqlite_Int("PRAGMA page_size;");
+		lPages = sqlite_Int("PRAGMA page_count;");
+		lFree = sqlite_Int("PRAGMA freelist_count;");
+		Cap->Records = sqlite_Int(zCapRecords);
+		CHECK((lPage > 0) && (lPages >= 0) && (lFree >= 0) && (Cap->Records >= 0), lblEnd);
+
+		CHECK(sqlite3_prepare_v2(hSqlDb, zCapRate, -1, &hStmt, 0) == SQLITE_OK, lblEnd);
+		Telium_Sprintf(tcDays, "-%d days", CAP_RATE_DAYS);
+		sqlite3_bind_text(hStmt, 1, tcDays, -1, SQLITE_STATIC);
+		if (sqlite3_step(hStmt) == SQLITE_ROW)
+			Cap->PerDay = sqlite3_column_int(hStmt, 0);
+		sqlite3_finalize(hStmt);
+
+		Cap->DbFree = lFree * lPage;
+		Cap->RecordBytes = CAP_RECORD_BYTES;
+		if (Cap->Records >= CAP_MIN_RECORDS)
+			Cap->RecordBytes = ((lPages - lFree) * lPage) / Cap->Records;
+		Cap->Room = Cap->DiskFree + Cap->DbFree - CAP_RESERVE_PAGES * lPage;
+		if (Cap->Room < 0)
+			Cap->Room = 0;
+		Cap->RecordsLeft = Cap->Room / Cap->RecordBytes;
+		Cap->DaysLeft = CAP_DAYS_MAX;
+		if (Cap->RecordsLeft < CAP_FULL_RECORDS)
+			Cap->DaysLeft = 0;
+		else if ((Cap->PerDay > 0) && ((Cap->RecordsLeft - CAP_FULL_RECORDS) / Cap->PerDay < CAP_DAYS_MAX))
+			Cap->DaysLeft = (int)((Cap->RecordsLeft - CAP_FULL_RECORDS) / Cap->PerDay);
+
+		Cap->Level = capOk;
+		if ((Cap->RecordsLeft < CAP_WARN_RECORDS) || (Cap->DaysLeft <= CAP_WARN_DAYS))
+			Cap->Level = capWarn;
+		if (Cap->RecordsLeft < CAP_FULL_RECORDS)
+			Cap->Level = capFull;
+
+		// Sales in a row without the idle task: the WAL may hold the room
+		if ((Cap->Level == capOk) || (iTry > 0) || (sqlite_Checkpoint() <= 0))
+			break;
+	}
+	iRet = Cap->Level;
+
+	lblEnd:
+	sqlite_Unlock();
+	return iRet;
+}
+
+/**
+ * Totals of the approved transactions of a currency in the open batch,
+ * \n balance enquiries left out, read from the running totals: count and sum
+ * \n of the debits, the debit reversals, the credits and the credit reversals.
+ * \param    Curr:char* (I) currency code, as in the records.
+ * \param    Tot:tLogTot* (O) logTotEnd totals, in the order of the enum. The
+ * \n sum is left empty when there is no transaction.
+ * \return 1:OK, -1:error
+ */
+static const char zLogTotals[] = "SELECT DrCr, MenuItem = ?1, SUM(Cnt), SUM(Amount) FROM trn_tot WHERE BatchNo = ?4 AND Currency = ?3 AND MenuItem != ?2 GROUP BY 1, 2 HAVING SUM(Cnt) > 0;";
+
+int sqlite_Log_Totals(const char *Curr, tLogTot *Tot){
+	sqlite3_stmt *hStmt;
+	char BatchNo[lenBatNum + 3];
+	const char *pcSum;
+	int iRet = -1;
+	int iIdx;
+
+	for (iIdx = 0; iIdx < logTotEnd; iIdx++) {
+		strcpy(Tot[iIdx].Count, "0");
+		Tot[iIdx].Sum[0] = 0;
+	}
+	memset(BatchNo, 0, sizeof(BatchNo));
+	mapGet(appBatchNumber, BatchNo, sizeof(BatchNo) - 1);
+
+	sqlite_Lock();
+	hStmt = sqlite_Stmt(zLogTotals);
+	if (hStmt) {
+		sqlite3_bind_int(hStmt, 1, mnuReversal);
+		sqlite3_bind_int(hStmt, 2, mnuBalanceEnquiry);
+		sqlite3_bind_text(hStmt, 3, Curr, -1, SQLITE_STATIC);
+		sqlite3_bind_int(hStmt, 4, atoi(BatchNo));
+		while ((iRet = sqlite3_step(hStmt)) == SQLITE_ROW) {
+			iIdx = (*sqlite3_column_text(hStmt, 0) == 'D') ? logTotDebit : logTotCredit;
+			iIdx += sqlite3_column_int(hStmt, 1); // Reversal next to its transaction
+			strncpy(Tot[iIdx].Count, (const char *)sqlite3_column_text(hStmt, 2), sizeof(Tot[iIdx].Count) - 1);
+			pcSum = (const char *)sqlite3_column_text(hStmt, 3);
+			if (pcSum)
+				strncpy(Tot[iIdx].Sum, pcSum, sizeof(Tot[iIdx].Sum) - 1);
 		}
-		// Read the number of rows fetched
-		cols = sqlite3_column_count(stmt);
-		while(1){
-			// fetch a row's status
-			iRet = sqlite3_step(stmt);
+		iRet = (iRet == SQLITE_DONE) ? 1 : -1;
+		sqlite_Done(hStmt);
+	}
+	sqlite_Unlock();
+	return iRet;
+}
 
-			if (iRet == SQLITE_ROW){
+/**
+ * Check the running totals against the log, recomputed in one pass over
+ * \n trn; totals found to differ are given again from the log. Also made at
+ * \n the first open of the database.
+ * \return number of totals that had drifted, 0 if none, -1 on error
+ */
+int sqlite_Log_Check(void){
+	int iRet = -1;
 
+	sqlite_Lock();
+	if (sqlite_Db() != NULL)
+		iRet = sqlite_Log_Drift();
+	sqlite_Unlock();
+	return iRet;
+}
 
-				// SQLITE_ROW means fetched a row
-				// sqlite3_column_text returns a const void* , typecast it to const char*
-				for (col = 0 ; col < cols; col++) {
-					memset(data, 0, sizeof(data));
-					memset(columnName, 0, sizeof(columnName));
-					const char *val = (const char*)sqlite3_column_text(stmt, col);
-					strcpy(columnName,sqlite3_column_name(stmt,col));
-					strcat(data, val);
+/**
+ * Export of the log tables to the host disk: a header, the schema of the
+ * \n tables for a full export, one frame per row written or deleted, and an
+ * \n end frame giving the CRC-32 of all the bytes before it. A frame is its
+ * \n type, the length of its payload and the payload. Integers are LEB128
+ * \n varints, zigzag encoded when signed. See Tools/SqlExport.
+ */
+#define EXP_VERSION     1
+#define EXP_BUF         1024           // Bytes written to the host disk at once
+#define EXP_FILE_NAME   DISK_HOST "/TSLDELTA.BIN"
+#define EXP_ACK_NAME    DISK_HOST "/TSLDELTA.ACK"
+
+enum {                                 // Frames
+	expHead = 'H',                     // Version, full, from, to, tables and their names
+	expSchema = 'S',                   // SQL text of a table, index or view
+	expRow = 'R',                      // Table, rowid, columns and their values
+	expDel = 'D',                      // Table, rowid
+	expEnd = 'E'                       // Frames before it, CRC-32 on 4 bytes
+};
 
-					Sqlite_SaveTo_tra(columnName, data);
-					ret = 1;
-				}
-				returnVal++;
-			} else if (iRet == SQLITE_DONE) {
-				// All rows finished
+enum {                                 // Values of a row
+	expNull,
+	expInt,                            // Zigzag varint
+	expReal,                           // IEEE 754 on 8 bytes
+	expText,                           // Length, bytes
+	expBlob                            // Length, bytes
+};
+
+static const char *tzExpTbl[] = { "trn", "trn_ext", "trn_tot", "trn_closed" }; // tbl of exp_chg
+
+typedef struct {
+	S_FS_FILE *hFile;
+	card ulCrc;
+	long lBytes;
+	long lFrames;
+	int iLen;
+	byte bErr;
+	byte tbBuf[EXP_BUF];
+} tExpOut;
+
+static tExpOut xExpOut;
+
+static const card tulExpCrc[16] = { // CRC-32 (0xEDB88320), four bits at a time
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static void sqlite_Exp_Flush(void){
+	if (xExpOut.iLen && !xExpOut.bErr && (FS_write(xExpOut.tbBuf, 1, xExpOut.iLen, xExpOut.hFile) != xExpOut.iLen))
+		xExpOut.bErr = 1;
+	xExpOut.iLen = 0;
+}
+
+static void sqlite_Exp_Put(const void *pvData, long lLen){
+	const byte *pucData = (const byte *)pvData;
+	card ulCrc = xExpOut.ulCrc;
+
+	xExpOut.lBytes += lLen;
+	while (lLen-- > 0) {
+		ulCrc ^= *pucData;
+		ulCrc = (ulCrc >> 4) ^ tulExpCrc[ulCrc & 0x0F];
+		ulCrc = (ulCrc >> 4) ^ tulExpCrc[ulCrc & 0x0F];
+		if (xExpOut.iLen == EXP_BUF)
+			sqlite_Exp_Flush();
+		xExpOut.tbBuf[xExpOut.iLen++] = *pucData++;
+	}
+	xExpOut.ulCrc = ulCrc;
+}
+
+static int sqlite_Exp_VarLen(sqlite3_uint64 ullVal){
+	int iLen = 1;
+
+	while (ullVal >= 0x80) {
+		ullVal >>= 7;
+		iLen++;
+	}
+	return iLen;
+}
+
+static void sqlite_Exp_Var(sqlite3_uint64 ullVal){
+	byte tucVar[10];
+	int iLen = 0;
+
+	while (ullVal >= 0x80) {
+		tucVar[iLen++] = (byte)(ullVal | 0x80);
+		ullVal >>= 7;
+	}
+	tucVar[iLen++] = (byte)ullVal;
+	sqlite_Exp_Put(tucVar, iLen);
+}
+
+static sqlite3_uint64 sqlite_Exp_Zigzag(sqlite3_int64 llVal){
+	return ((sqlite3_uint64)llVal << 1) ^ (sqlite3_uint64)(llVal >> 63);
+}
+
+static void sqlite_Exp_Frame(byte bType, long lLen){
+	sqlite_Exp_Put(&bType, 1);
+	sqlite_Exp_Var((sqlite3_uint64)lLen);
+	xExpOut.lFrames++;
+}
+
+/**
+ * Write the rows of a query as frames: the rowid in its first column, 0 in
+ * \n the second for a row deleted, the columns of the row after them.
+ * \param    hStmt:sqlite3_stmt* (I) query, bound.
+ * \param    Tbl:int (I) table, index in tzExpTbl.
+ * \param    Exp:tSqlExp* (I/O) rows and deletes counted.
+ * \return 1:OK, -1:error
+ */
+static int sqlite_Exp_Rows(sqlite3_stmt *hStmt, int Tbl, tSqlExp *Exp){
+	sqlite3_uint64 ullReal;
+	sqlite3_int64 llRid;
+	double dReal;
+	byte tucReal[8];
+	byte bTag;
+	long lLen;
+	int iCols;
+	int iCol;
+	int iIdx;
+	int iRet;
+
+	iCols = sqlite3_column_count(hStmt) - 2;
+	while ((iRet = sqlite3_step(hStmt)) == SQLITE_ROW) {
+		llRid = sqlite3_column_int64(hStmt, 0);
+		if (sqlite3_column_int(hStmt, 1) == 0) {
+			sqlite_Exp_Frame(expDel, sqlite_Exp_VarLen(Tbl) + sqlite_Exp_VarLen(llRid));
+			sqlite_Exp_Var(Tbl);
+			sqlite_Exp_Var(llRid);
+			Exp->Deletes++;
+			continue;
+		}
+
+		lLen = sqlite_Exp_VarLen(Tbl) + sqlite_Exp_VarLen(llRid) + sqlite_Exp_VarLen(iCols);
+		for (iCol = 2; iCol < iCols + 2; iCol++) {
+			switch (sqlite3_column_type(hStmt, iCol)) {
+			case SQLITE_INTEGER:
+				lLen += 1 + sqlite_Exp_VarLen(sqlite_Exp_Zigzag(sqlite3_column_int64(hStmt, iCol)));
+				break;
+			case SQLITE_FLOAT:
+				lLen += 1 + 8;
+				break;
+			case SQLITE_TEXT:
+			case SQLITE_BLOB:
+				lLen += 1 + sqlite_Exp_VarLen(sqlite3_column_bytes(hStmt, iCol)) + sqlite3_column_bytes(hStmt, iCol);
+				break;
+			default:
+				lLen += 1;
 				break;
-			} else {
-				// Some error encountered
 			}
 		}
-		sqlite3_finalize(stmt);
-		Sqlite_Close(handle);
 
+		sqlite_Exp_Frame(expRow, lLen);
+		sqlite_Exp_Var(Tbl);
+		sqlite_Exp_Var(llRid);
+		sqlite_Exp_Var(iCols);
+		for (iCol = 2; iCol < iCols + 2; iCol++) {
+			switch (sqlite3_column_type(hStmt, iCol)) {
+			case SQLITE_INTEGER:
+				bTag = expInt;
+				sqlite_Exp_Put(&bTag, 1);
+				sqlite_Exp_Var(sqlite_Exp_Zigzag(sqlite3_column_int64(hStmt, iCol)));
+				break;
+			case SQLITE_FLOAT:
+				bTag = expReal;
+				sqlite_Exp_Put(&bTag, 1);
+				dReal = sqlite3_column_double(hStmt, iCol);
+				memcpy(&ullReal, &dReal, sizeof(ullReal));
+				for (iIdx = 0; iIdx < 8; iIdx++)
+					tucReal[iIdx] = (byte)(ullReal >> (8 * iIdx)); // Little endian
+				sqlite_Exp_Put(tucReal, 8);
+				break;
+			case SQLITE_TEXT:
+			case SQLITE_BLOB:
+				bTag = (sqlite3_column_type(hStmt, iCol) == SQLITE_TEXT) ? expText : expBlob;
+				sqlite_Exp_Put(&bTag, 1);
+				sqlite_Exp_Var(sqlite3_column_bytes(hStmt, iCol));
+				sqlite_Exp_Put(sqlite3_column_blob(hStmt, iCol), sqlite3_column_bytes(hStmt, iCol));
+				break;
+			default:
+				bTag = expNull;
+				sqlite_Exp_Put(&bTag, 1);
+				break;
+			}
+		}
+		Exp->Rows++;
+	}
+	return (iRet == SQLITE_DONE) ? 1 : -1;
+}
+
+/**
+ * Apply the acknowledgement left by the host on its disk (EXP_ACK_NAME):
+ * \n the last change and the CRC of the export it applied. When they are
+ * \n those of the last export, its changes are no longer kept. Read once,
+ * \n then removed. Called locked.
+ * \return 1:acknowledged, 0:none or not the last export
+ */
+static const char zExpAck[] = "UPDATE exp_cur SET Seq = Sent WHERE Sent = ?1 AND Crc = ?2;";
+static const char zExpAckChg[] = "DELETE FROM exp_chg WHERE seq <= ?;";
+
+static int sqlite_Exp_Ack(void){
+	sqlite3_stmt *hStmt = NULL;
+	S_FS_FILE *hFile;
+	char tcAck[32];
+	char *pcEnd;
+	unsigned long ulTo;
+	unsigned long ulCrc;
+	int iLen;
+	int iRet = 0;
+
+	hFile = FS_open(EXP_ACK_NAME, "r");
+	CHECK(hFile != NULL, lblEnd);
+	iLen = FS_read(tcAck, 1, sizeof(tcAck) - 1, hFile);
+	FS_close(hFile);
+	FS_unlink(EXP_ACK_NAME);
+	CHECK(iLen > 0, lblEnd);
+	tcAck[iLen] = 0;
+	ulTo = strtoul(tcAck, &pcEnd, 10);   // "<to> <crc in hex>"
+	ulCrc = strtoul(pcEnd, NULL, 16);
+
+	CHECK(sqlite3_prepare_v2(hSqlDb, zExpAck, -1, &hStmt, 0) == SQLITE_OK, lblEnd);
+	sqlite3_bind_int64(hStmt, 1, (sqlite3_int64)ulTo);
+	sqlite3_bind_int64(hStmt, 2, (sqlite3_int64)ulCrc);
+	CHECK(sqlite3_step(hStmt) == SQLITE_DONE, lblEnd);
+	CHECK(sqlite3_changes(hSqlDb) == 1, lblEnd);
+	sqlite3_finalize(hStmt);
+	hStmt = NULL;
+
+	CHECK(sqlite3_prepare_v2(hSqlDb, zExpAckChg, -1, &hStmt, 0) == SQLITE_OK, lblEnd);
+	sqlite3_bind_int64(hStmt, 1, (sqlite3_int64)ulTo);
+	if (sqlite3_step(hStmt) == SQLITE_DONE)
+		iRet = 1;
+
+	lblEnd:
+	if (hStmt)
+		sqlite3_finalize(hStmt);
+	return iRet;
+}
+
+/**
+ * Queries of sqlite_Export: the last change noted, the schema of the log
+ * \n tables and of the view log, the rows of a table (%s) for a full export,
+ * \n the rows of a table (%s, %d) changed between two changes (?1, ?2].
+ */
+static const char zExpSeq[] = "SELECT IFNULL((SELECT seq FROM sqlite_sequence WHERE name = 'exp_chg'), 0);";
+static const char zExpSchema[] = "SELECT sql FROM sqlite_master WHERE tbl_name IN ('trn', 'trn_ext', 'trn_tot', 'trn_closed', 'log') AND type IN ('table', 'index', 'view') AND sql IS NOT NULL ORDER BY type = 'index', type = 'view', rowid;";
+static const char zExpFull[] = "SELECT rowid, 1, * FROM %s ORDER BY rowid;";
+static const char zExpDelta[] = "SELECT c.rid, t.rowid IS NOT NULL, t.* FROM exp_chg c LEFT JOIN %s t ON t.rowid = c.rid WHERE c.tbl = %d AND c.seq > ?1 AND c.seq <= ?2 ORDER BY c.seq;";
+
+/**
+ * Export the log tables to the host disk (EXP_FILE_NAME) for the
+ * \n diagnostics and the backup, instead of the whole database file: the
+ * \n rows changed since the last export acknowledged, or every row when
+ * \n none was or when asked. The host applies it with sqlimport, which
+ * \n checks its CRC and leaves its acknowledgement for the next call
+ * \n (EXP_ACK_NAME). An export lost or not acknowledged is made again from
+ * \n the same change at the next call, with the changes made since: the
+ * \n host applies either. The handle is held along the export, the sales
+ * \n wait; not called during a sale.
+ * \param    Full:int (I) 1 for every row, 0 for the changes.
+ * \param    Exp:tSqlExp* (O) changes, rows, bytes and CRC of the export.
+ * \return 1:OK, -1:error, the last export acknowledged kept
+ */
+int sqlite_Export(int Full, tSqlExp *Exp){
+	sqlite3_stmt *hStmt = NULL;
+	char tcSql[256];
+	unsigned int uiMode;
+	const char *pcSql;
+	byte tucCrc[4];
+	long lFrames;
+	long lSeq;
+	int iTbl;
+	int iIdx;
+	int iRet = -1;
+
+	memset(Exp, 0, sizeof(*Exp));
+	memset(&xExpOut, 0, sizeof(xExpOut));
+	if (FS_mount(DISK_HOST, &uiMode) != FS_OK)
+		return -1;
+	sqlite_Lock();
+	CHECK((sqlite_Db() != NULL) && (iSqlTxn == 0), lblEnd);
+	Exp->Acked = (byte)sqlite_Exp_Ack();
+	lSeq = sqlite_Int("SELECT Seq FROM exp_cur;"); // -1: no row, or a full export not acknowledged
+	Exp->Full = (byte)(Full || (lSeq < 0));
+	CHECK(sqlite3_exec(hSqlDb, "BEGIN IMMEDIATE;", NULL, NULL, NULL) == SQLITE_OK, lblEnd);
+	if (Exp->Full) {                   // Changes noted from now on
+		CHECK(sqlite3_exec(hSqlDb, "DELETE FROM exp_chg; INSERT OR REPLACE INTO exp_cur VALUES (1, -1, 0, 0);", NULL, NULL, NULL) == SQLITE_OK, lblKO);
+		lSeq = 0;
+	}
+	Exp->From = lSeq;
+	Exp->To = sqlite_Int(zExpSeq);
+	CHECK(Exp->To >= Exp->From, lblKO);
+
+	FS_unlink(EXP_FILE_NAME);
+	xExpOut.ulCrc = 0xFFFFFFFF;
+	xExpOut.hFile = FS_open(EXP_FILE_NAME, "a");
+	CHECK(xExpOut.hFile != NULL, lblKO);
+
+	iIdx = sqlite_Exp_VarLen(EXP_VERSION) + sqlite_Exp_VarLen(Exp->Full) + sqlite_Exp_VarLen(Exp->From) + sqlite_Exp_VarLen(Exp->To) + sqlite_Exp_VarLen(sizeof(tzExpTbl) / sizeof(tzExpTbl[0]));
+	for (iTbl = 0; iTbl < (int)(sizeof(tzExpTbl) / sizeof(tzExpTbl[0])); iTbl++)
+		iIdx += sqlite_Exp_VarLen(strlen(tzExpTbl[iTbl])) + strlen(tzExpTbl[iTbl]);
+	sqlite_Exp_Frame(expHead, iIdx);
+	sqlite_Exp_Var(EXP_VERSION);
+	sqlite_Exp_Var(Exp->Full);
+	sqlite_Exp_Var(Exp->From);
+	sqlite_Exp_Var(Exp->To);
+	sqlite_Exp_Var(sizeof(tzExpTbl) / sizeof(tzExpTbl[0]));
+	for (iTbl = 0; iTbl < (int)(sizeof(tzExpTbl) / sizeof(tzExpTbl[0])); iTbl++) {
+		sqlite_Exp_Var(strlen(tzExpTbl[iTbl]));
+		sqlite_Exp_Put(tzExpTbl[iTbl], strlen(tzExpTbl[iTbl]));
+	}
+
+	if (Exp->Full) {                   // The host makes the tables again
+		CHECK(sqlite3_prepare_v2(hSqlDb, zExpSchema, -1, &hStmt, 0) == SQLITE_OK, lblKO);
+		while (sqlite3_step(hStmt) == SQLITE_ROW) {
+			pcSql = (const char *)sqlite3_column_text(hStmt, 0);
+			sqlite_Exp_Frame(expSchema, strlen(pcSql));
+			sqlite_Exp_Put(pcSql, strlen(pcSql));
+		}
+		sqlite3_finalize(hStmt);
+		hStmt = NULL;
+	}
+
+	for (iTbl = 0; iTbl < (int)(sizeof(tzExpTbl) / sizeof(tzExpTbl[0])); iTbl++) {
+		if (Exp->Full)
+			Telium_Sprintf(tcSql, zExpFull, tzExpTbl[iTbl]);
+		else
+			Telium_Sprintf(tcSql, zExpDelta, tzExpTbl[iTbl], iTbl);
+		CHECK(sqlite3_prepare_v2(hSqlDb, tcSql, -1, &hStmt, 0) == SQLITE_OK, lblKO);
+		if (!Exp->Full) {
+			sqlite3_bind_int64(hStmt, 1, Exp->From);
+			sqlite3_bind_int64(hStmt, 2, Exp->To);
+		}
+		CHECK(sqlite_Exp_Rows(hStmt, iTbl, Exp) > 0, lblKO);
+		sqlite3_finalize(hStmt);
+		hStmt = NULL;
+		CHECK(xExpOut.bErr == 0, lblKO);
+	}
+
+	Exp->Crc = ~xExpOut.ulCrc;         // Of the bytes before the end frame
+	for (iIdx = 0; iIdx < 4; iIdx++)
+		tucCrc[iIdx] = (byte)(Exp->Crc >> (8 * iIdx));
+	lFrames = xExpOut.lFrames;         // Frames before this one
+	sqlite_Exp_Frame(expEnd, sqlite_Exp_VarLen(lFrames) + 4);
+	sqlite_Exp_Var(lFrames);
+	sqlite_Exp_Put(tucCrc, 4);
+	sqlite_Exp_Flush();
+	CHECK(xExpOut.bErr == 0, lblKO);
+	Exp->Bytes = xExpOut.lBytes;
+
+	CHECK(sqlite3_prepare_v2(hSqlDb, "UPDATE exp_cur SET Sent = ?, Crc = ?;", -1, &hStmt, 0) == SQLITE_OK, lblKO);
+	sqlite3_bind_int64(hStmt, 1, Exp->To);
+	sqlite3_bind_int64(hStmt, 2, (sqlite3_int64)Exp->Crc);
+	CHECK(sqlite3_step(hStmt) == SQLITE_DONE, lblKO);
+	sqlite3_finalize(hStmt);
+	hStmt = NULL;
+	CHECK(sqlite3_exec(hSqlDb, "COMMIT;", NULL, NULL, NULL) == SQLITE_OK, lblKO);
+	iRet = 1;
+	goto lblEnd;
+
+	lblKO:
+	if (hStmt)
+		sqlite3_finalize(hStmt);
+	hStmt = NULL;
+	sqlite3_exec(hSqlDb, "ROLLBACK;", NULL, NULL, NULL);
+	lblEnd:
+	if (xExpOut.hFile)
+		FS_close(xExpOut.hFile);
+	xExpOut.hFile = NULL;
+	sqlite_Unlock();
+	return iRet;
+}
+
+/**
+ * Stop noting the changes of the log for the export and forget them, when
+ * \n the disk is short: the next export gives every row.
+ */
+void sqlite_Export_Stop(void){
+	sqlite_Lock();
+	if ((sqlite_Db() != NULL) && (iSqlTxn == 0))
+		sqlite3_exec(hSqlDb, "DELETE FROM exp_cur; DELETE FROM exp_chg;", NULL, NULL, NULL);
+	sqlite_Unlock();
+}
+
+/**
+ * Copy the current row of a statement into a cursor row. Called locked.
+ */
+static void sqlite_Row(sqlite3_stmt *hStmt, tSqlRow *pxRow){
+	const char *pcVal;
+	char *pcDst = pxRow->Data;
+	int iFree = sizeof(pxRow->Data);
+	int iLen;
+	int iCol;
+
+	pxRow->Cols = sqlite3_column_count(hStmt);
+	if (pxRow->Cols > SQL_ROW_COLS)
+		pxRow->Cols = SQL_ROW_COLS;
+	for (iCol = 0; iCol < pxRow->Cols; iCol++) {
+		pxRow->Int[iCol] = sqlite3_column_int64(hStmt, iCol);
+		pcVal = (const char *)sqlite3_column_text(hStmt, iCol);
+		if (iFree == 0) {              // No space left: the next texts are empty
+			pxRow->Text[iCol] = "";
+			continue;
+		}
+		iLen = pcVal ? (int)strlen(pcVal) : 0;
+		if (iLen > iFree - 1)
+			iLen = iFree - 1;
+		if (iLen > 0)
+			memcpy(pcDst, pcVal, iLen);
+		pcDst[iLen] = 0;
+		pxRow->Text[iCol] = pcDst;
+		pcDst += iLen + 1;
+		iFree -= iLen + 1;
+	}
+}
+
+/**
+ * Give the rows of a prepared statement one at a time to the callback,
+ * \n through one row buffer, so the memory used does not depend on the
+ * \n number of rows. The database is unlocked while the callback runs,
+ * \n which may query it in turn. The statement is finalized.
+ * \param    hStmt:sqlite3_stmt* (I) statement, bound; NULL on error.
+ * \param    Row:tSqlRowFn (I) called for each row.
+ * \param    Ctx:void* (I) given to the callback.
+ * \return number of rows given, -1 on error
+ */
+static int sqlite_Cursor(sqlite3_stmt *hStmt, tSqlRowFn Row, void *Ctx){
+	tSqlRow xRow;
+	int iCnt = 0;
+	int iRet;
+
+	CHECK(hStmt != NULL, lblKO);
+	while (1) {
+		sqlite_Lock();
+		iRet = sqlite3_step(hStmt);
+		if (iRet == SQLITE_ROW)
+			sqlite_Row(hStmt, &xRow);
+		sqlite_Unlock();
+		if (iRet == SQLITE_DONE)
+			break;
+		CHECK(iRet == SQLITE_ROW, lblKO);
+
+		iCnt++;
+		iRet = Row(&xRow, Ctx);
+		CHECK(iRet >= 0, lblKO);
+		if (iRet == 0)
+			break;
+	}
+	goto lblEnd;
+
+	lblKO:
+	iCnt = -1;
+	lblEnd:
+	sqlite_Lock();
+	if (hStmt)
+		sqlite3_finalize(hStmt);
+	sqlite_Unlock();
+	return iCnt;
+}
+
+/**
+ * Run a query of the log as a cursor, see sqlite_Cursor.
+ * \param    pcSql:char* (I) query: ?1 batch, ?2 currency, ?3 balance enquiry.
+ * \param    Curr:char* (I) currency code, as in the records.
+ * \param    Row:tSqlRowFn (I) called for each row.
+ * \param    Ctx:void* (I) given to the callback.
+ * \return number of rows given, -1 on error
+ */
+static int sqlite_Log_Cursor(const char *pcSql, const char *Curr, tSqlRowFn Row, void *Ctx){
+	sqlite3_stmt *hStmt = NULL;
+	char BatchNo[lenBatNum + 3];
+
+	memset(BatchNo, 0, sizeof(BatchNo));
+	mapGet(appBatchNumber, BatchNo, sizeof(BatchNo) - 1);
+
+	sqlite_Lock();
+	if ((sqlite_Db() != NULL) && (sqlite3_prepare_v2(hSqlDb, pcSql, -1, &hStmt, 0) == SQLITE_OK)) {
+		sqlite3_bind_int(hStmt, 1, atoi(BatchNo));
+		sqlite3_bind_text(hStmt, 2, Curr, -1, SQLITE_TRANSIENT);
+		sqlite3_bind_int(hStmt, 3, mnuBalanceEnquiry);
 	}
+	sqlite_Unlock();
+	return sqlite_Cursor(hStmt, Row, Ctx);
+}
+
+/**
+ * Give the approved transactions of a currency in the open batch, balance
+ * \n enquiries left out, in the order they were made; columns logRowXxx.
+ * \param    Curr:char* (I) currency code, as in the records.
+ * \param    Row:tSqlRowFn (I) called for each transaction.
+ * \param    Ctx:void* (I) given to the callback.
+ * \return number of transactions given, -1 on error
+ */
+int sqlite_Log_Each(const char *Curr, tSqlRowFn Row, void *Ctx){
+	return sqlite_Log_Cursor("SELECT MenuItem, Amount, TrnDateTime, AutCod FROM trn WHERE BatchNo = ?1 AND Currency = ?2 AND MenuItem != ?3 AND RspCod = '00' ORDER BY id;", Curr, Row, Ctx);
+}
+
+/**
+ * Give the totals of a currency in the open batch by menu item, from the
+ * \n running totals, balance enquiries left out; columns logGrpXxx, the menu
+ * \n name taken from AppMenus.
+ * \param    Curr:char* (I) currency code, as in the records.
+ * \param    Row:tSqlRowFn (I) called for each menu item.
+ * \param    Ctx:void* (I) given to the callback.
+ * \return number of menu items given, -1 on error
+ */
+int sqlite_Log_Groups(const char *Curr, tSqlRowFn Row, void *Ctx){
+	return sqlite_Log_Cursor("SELECT MenuItem, IFNULL((SELECT MenuName FROM AppMenus WHERE MenuId = g.MenuItem LIMIT 1), ''), SUM(Cnt), SUM(Amount) FROM trn_tot g WHERE BatchNo = ?1 AND Currency = ?2 AND MenuItem != ?3 GROUP BY MenuItem HAVING SUM(Cnt) > 0 ORDER BY MenuItem;", Curr, Row, Ctx);
+}
+
+/**
+ * Give the menu items in the order they were written, hidden ones
+ * \n included; columns mnuRowXxx. Read once into the menu tree of
+ * \n MenuManager.c, the navigation then runs from RAM.
+ * \param    Row:tSqlRowFn (I) called for each menu item.
+ * \param    Ctx:void* (I) given to the callback.
+ * \return number of menu items given, -1 on error
+ */
+int sqlite_Menu_Each(tSqlRowFn Row, void *Ctx){
+	sqlite3_stmt *hStmt = NULL;
+
+	sqlite_Lock();
+	if (sqlite_Db() != NULL)
+		sqlite3_prepare_v2(hSqlDb, "SELECT MenuId, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, MenuName, IconPathName FROM AppMenus ORDER BY TableId;", -1, &hStmt, 0);
+	sqlite_Unlock();
+	return sqlite_Cursor(hStmt, Row, Ctx);
+}
+
+/**
+ * Queue an advice.
+ * \n An advice already queued for the same STAN is left untouched, so
+ * \n replaying the enqueue after a power failure never duplicates it.
+ * \n Parked advices (retries exhausted) count in MaxEntries: they are kept
+ * \n until the host takes them, never dropped to make room.
+ * \param    STAN:char* (I) STAN of the advised transaction.
+ * \param    MenuItem:char* (I) menu item of the advised transaction.
+ * \param    Request:char* (I) ISO message in hex, without length nor TPDU.
+ * \param    MaxEntries:int (I) maximum number of queued advices.
+ * \return 1:queued or already queued, 0:queue full, -1:error
+ */
+int sqlite_Advice_Put(const char *STAN, const char *MenuItem, const char *Request, int MaxEntries){
+	sqlite3_stmt *hStmt = NULL;
+	int iRet, ret = -1;
+	int count = 0;
+
+	sqlite_Lock();
+
+	hStmt = sqlite_Stmt("SELECT COUNT(*) FROM advice;");
+	CHECK(hStmt != NULL, lblEnd);
+	if (sqlite3_step(hStmt) == SQLITE_ROW)
+		count = sqlite3_column_int(hStmt, 0);
+	sqlite_Done(hStmt);
+	hStmt = NULL;
+
+	ret = 0;
+	CHECK(count < MaxEntries, lblEnd);
+
+	ret = -1;
+	hStmt = sqlite_Stmt("INSERT OR IGNORE INTO advice (STAN, MenuItem, Request) VALUES (?, ?, ?);");
+	CHECK(hStmt != NULL, lblEnd);
+	sqlite3_bind_text(hStmt, 1, STAN, -1, SQLITE_STATIC);
+	sqlite3_bind_text(hStmt, 2, MenuItem, -1, SQLITE_STATIC);
+	sqlite3_bind_text(hStmt, 3, Request, -1, SQLITE_STATIC);
+	iRet = sqlite3_step(hStmt);
+	CHECK(iRet == SQLITE_DONE, lblEnd);
+	ret = 1;
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
 
+/**
+ * Count the parked advices: refused by the host until their retries were
+ * \n exhausted, kept in the queue but no longer sent.
+ * \return number of parked advices, -1:error
+ */
+int sqlite_Advice_Parked(void){
+	sqlite3_stmt *hStmt = NULL;
+	int ret = -1;
 
+	sqlite_Lock();
+
+	hStmt = sqlite_Stmt("SELECT COUNT(*) FROM advice WHERE Status = 2;");
+	CHECK(hStmt != NULL, lblEnd);
+	if (sqlite3_step(hStmt) == SQLITE_ROW)
+		ret = sqlite3_column_int(hStmt, 0);
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
+
+/**
+ * Read the oldest pending advice.
+ * \param    STAN:char* (O) STAN of the advice (lenSTAN + 1).
+ * \param    Request:char* (O) ISO message in hex.
+ * \param    iDim:int (I) size of Request.
+ * \return 1:advice found, 0:queue empty, -1:error
+ */
+int sqlite_Advice_Peek(char *STAN, char *Request, int iDim){
+	sqlite3_stmt *hStmt = NULL;
+	const char *val;
+	int iRet, ret = -1;
+
+	sqlite_Lock();
+
+	hStmt = sqlite_Stmt("SELECT STAN, Request FROM advice WHERE Status = 0 ORDER BY id LIMIT 1;");
+	CHECK(hStmt != NULL, lblEnd);
+
+	iRet = sqlite3_step(hStmt);
+	ret = 0;
+	CHECK(iRet == SQLITE_ROW, lblEnd);
+
+	val = (const char *)sqlite3_column_text(hStmt, 0);
+	strncpy(STAN, val ? val : "", lenSTAN);
+	STAN[lenSTAN] = 0;
+	val = (const char *)sqlite3_column_text(hStmt, 1);
+	strncpy(Request, val ? val : "", iDim - 1);
+	Request[iDim - 1] = 0;
+	ret = 1;
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
+
+/**
+ * Record the outcome of an advice delivery attempt.
+ * \param    STAN:char* (I) STAN of the advice.
+ * \param    Delivered:int (I) 1 to remove the advice, 0 to count a retry.
+ * \param    MaxRetries:int (I) retries after which the advice is parked.
+ * \return 1:OK, -1:error
+ */
+int sqlite_Advice_Update(const char *STAN, int Delivered, int MaxRetries){
+	sqlite3_stmt *hStmt = NULL;
+	int iRet, ret = -1;
+
+	sqlite_Lock();
+
+	if (Delivered) {
+		hStmt = sqlite_Stmt("DELETE FROM advice WHERE STAN = ?;");
+		CHECK(hStmt != NULL, lblEnd);
+		sqlite3_bind_text(hStmt, 1, STAN, -1, SQLITE_STATIC);
+	} else {
+		hStmt = sqlite_Stmt("UPDATE advice SET Retries = Retries + 1, Status = CASE WHEN Retries + 1 >= ? THEN 2 ELSE 0 END WHERE STAN = ?;");
+		CHECK(hStmt != NULL, lblEnd);
+		sqlite3_bind_int(hStmt, 1, MaxRetries);
+		sqlite3_bind_text(hStmt, 2, STAN, -1, SQLITE_STATIC);
+	}
+	iRet = sqlite3_step(hStmt);
+	CHECK(iRet == SQLITE_DONE, lblEnd);
+	ret = 1;
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
+
+/**
+ * Store the reversal of a transaction.
+ * \n A reversal is armed before the original request goes out, so a power
+ * \n failure while waiting for the answer cannot lose it. A reversal already
+ * \n stored for the same STAN is replaced.
+ * \param    STAN:char* (I) STAN of the transaction to reverse.
+ * \param    CardKey:char* (I) truncated PAN of the card (see revCardKey).
+ * \param    Request:char* (I) 0400 message in hex, without length nor TPDU.
+ * \param    Status:int (I) 1:armed, 0:to send.
+ * \return 1:OK, -1:error
+ */
+int sqlite_Reversal_Put(const char *STAN, const char *CardKey, const char *Request, int Status){
+	sqlite3_stmt *hStmt = NULL;
+	int iRet, ret = -1;
+
+	sqlite_Lock();
+
+	hStmt = sqlite_Stmt("INSERT OR REPLACE INTO reversal (STAN, CardKey, Request, Status) VALUES (?, ?, ?, ?);");
+	CHECK(hStmt != NULL, lblEnd);
+	sqlite3_bind_text(hStmt, 1, STAN, -1, SQLITE_STATIC);
+	sqlite3_bind_text(hStmt, 2, CardKey, -1, SQLITE_STATIC);
+	sqlite3_bind_text(hStmt, 3, Request, -1, SQLITE_STATIC);
+	sqlite3_bind_int(hStmt, 4, Status);
+	iRet = sqlite3_step(hStmt);
+	CHECK(iRet == SQLITE_DONE, lblEnd);
+	ret = 1;
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
 	return ret;
+}
+
+/**
+ * Release armed reversals so the sender picks them up.
+ * \param    STAN:char* (I) STAN of the reversal, NULL for all of them (power up).
+ * \return number of reversals released, -1:error
+ */
+int sqlite_Reversal_Release(const char *STAN){
+	sqlite3_stmt *hStmt = NULL;
+	int iRet, ret = -1;
+
+	sqlite_Lock();
+
+	hStmt = sqlite_Stmt("UPDATE reversal SET Status = 0 WHERE Status = 1 AND (?1 IS NULL OR STAN = ?1);");
+	CHECK(hStmt != NULL, lblEnd);
+	if (STAN)
+		sqlite3_bind_text(hStmt, 1, STAN, -1, SQLITE_STATIC);
+	iRet = sqlite3_step(hStmt);
+	CHECK(iRet == SQLITE_DONE, lblEnd);
+	ret = sqlite3_changes(hSqlDb);
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
+
+/**
+ * Read the oldest reversal to send.
+ * \param    STAN:char* (O) STAN of the reversal (lenSTAN + 1).
+ * \param    Request:char* (O) 0400 message in hex.
+ * \param    iDim:int (I) size of Request.
+ * \param    Retries:int* (O) sends counted so far, >0: the host may have it already.
+ * \return 1:reversal found, 0:queue empty, -1:error
+ */
+int sqlite_Reversal_Peek(char *STAN, char *Request, int iDim, int *Retries){
+	sqlite3_stmt *hStmt = NULL;
+	const char *val;
+	int iRet, ret = -1;
+
+	sqlite_Lock();
+
+	hStmt = sqlite_Stmt("SELECT STAN, Request, Retries FROM reversal WHERE Status = 0 ORDER BY id LIMIT 1;");
+	CHECK(hStmt != NULL, lblEnd);
+
+	iRet = sqlite3_step(hStmt);
+	ret = 0;
+	CHECK(iRet == SQLITE_ROW, lblEnd);
+
+	val = (const char *)sqlite3_column_text(hStmt, 0);
+	strncpy(STAN, val ? val : "", lenSTAN);
+	STAN[lenSTAN] = 0;
+	val = (const char *)sqlite3_column_text(hStmt, 1);
+	strncpy(Request, val ? val : "", iDim - 1);
+	Request[iDim - 1] = 0;
+	*Retries = sqlite3_column_int(hStmt, 2);
+	ret = 1;
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
+
+/**
+ * Record the outcome of a reversal, or drop it.
+ * \n Reversals are never parked: they are retried until the host answers.
+ * \param    STAN:char* (I) STAN of the reversal, NULL with Delivered to empty the queue.
+ * \param    Delivered:int (I) 1 to remove the reversal, 0 to count a send.
+ * \return 1:OK, -1:error
+ */
+int sqlite_Reversal_Update(const char *STAN, int Delivered){
+	sqlite3_stmt *hStmt = NULL;
+	int iRet, ret = -1;
+
+	sqlite_Lock();
+
+	if (Delivered)
+		hStmt = sqlite_Stmt("DELETE FROM reversal WHERE ?1 IS NULL OR STAN = ?1;");
+	else
+		hStmt = sqlite_Stmt("UPDATE reversal SET Retries = Retries + 1 WHERE STAN = ?1;");
+	CHECK(hStmt != NULL, lblEnd);
+	if (STAN)
+		sqlite3_bind_text(hStmt, 1, STAN, -1, SQLITE_STATIC);
+	iRet = sqlite3_step(hStmt);
+	CHECK(iRet == SQLITE_DONE, lblEnd);
+	ret = 1;
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
+
+/**
+ * Count the reversals still to send for a card or a STAN.
+ * \param    STAN:char* (I) STAN about to be used.
+ * \param    CardKey:char* (I) truncated PAN of the card, empty if unknown.
+ * \return number of pending reversals, -1:error
+ */
+int sqlite_Reversal_Pending(const char *STAN, const char *CardKey){
+	sqlite3_stmt *hStmt = NULL;
+	int iRet, ret = -1;
+
+	sqlite_Lock();
+
+	hStmt = sqlite_Stmt("SELECT COUNT(*) FROM reversal WHERE Status = 0 AND (STAN = ?1 OR (?2 != '' AND CardKey = ?2));");
+	CHECK(hStmt != NULL, lblEnd);
+	sqlite3_bind_text(hStmt, 1, STAN, -1, SQLITE_STATIC);
+	sqlite3_bind_text(hStmt, 2, CardKey, -1, SQLITE_STATIC);
+	iRet = sqlite3_step(hStmt);
+	CHECK(iRet == SQLITE_ROW, lblEnd);
+	ret = sqlite3_column_int(hStmt, 0);
+
+	lblEnd:
+	if (hStmt)
+		sqlite_Done(hStmt);
+	sqlite_Unlock();
+	return ret;
+}
+
+/**
+ * Batch upload cursor: the approved records of a terminal, oldest first,
+ * read one at a time so the batch is never held whole in memory. Its
+ * statement is kept out of the cache, where it could be replaced while
+ * the upload runs.
+ */
+
+/**
+ * Close the batch upload cursor.
+ */
+void sqlite_Batch_Close(void){
+	sqlite_Lock();
+	if (hBatchStmt)
+		sqlite3_finalize(hBatchStmt);
+	hBatchStmt = NULL;
+	sqlite_Unlock();
+}
+
+/**
+ * Open the batch upload cursor on the records of the open batch.
+ * \param    TID:char* (I) terminal whose records are uploaded.
+ * \param    AfterId:long (I) records up to this id are already acknowledged.
+ * \return 1:OK, -1:error
+ */
+int sqlite_Batch_Open(const char *TID, long AfterId){
+	char Statement[300];
+	char BatchNo[lenBatNum + 3];
+	int iRet;
+
+	sqlite_Batch_Close();
+	memset(Statement, 0, sizeof(Statement));
+	memset(BatchNo, 0, sizeof(BatchNo));
+	mapGet(appBatchNumber, BatchNo, sizeof(BatchNo) - 1);
+
+	Telium_Sprintf(Statement, "SELECT * FROM log WHERE BatchNo = ? AND id > ? AND isoField041 = ? AND isoField039 = '00' AND isoVoided != '1' AND MenuItem != '%d' AND MenuItem != '%d' AND MenuItem != '%d' ORDER BY id;", mnuBalanceEnquiry, mnuVoid, mnuReversal);
+	sqlite_Lock();
+	CHECK(sqlite_Db() != NULL, lblKO);
+	iRet = sqlite3_prepare_v2(hSqlDb, Statement, -1, &hBatchStmt, 0);
+	CHECK(iRet == SQLITE_OK, lblKO);
+	sqlite3_bind_int(hBatchStmt, 1, atoi(BatchNo));
+	sqlite3_bind_int64(hBatchStmt, 2, AfterId);
+	sqlite3_bind_text(hBatchStmt, 3, TID, -1, SQLITE_TRANSIENT);
+	sqlite_Unlock();
+
+	return 1;
+	lblKO:
+	sqlite_Unlock();
+	sqlite_Batch_Close();
+	return -1;
+}
+
+/**
+ * Load the next record of the batch upload cursor into the transaction.
+ * \param    Id:long* (O) id of the record loaded.
+ * \return 1:record loaded, 0:no more records, -1:error
+ */
+int sqlite_Batch_Next(long *Id){
+	char columnName[64];
+	char data[256];
+	const char *val;
+	int iRet, cols, col;
+
+	sqlite_Lock();
+	CHECK(hBatchStmt != NULL, lblKO);
+
+	iRet = sqlite3_step(hBatchStmt);
+	if (iRet == SQLITE_DONE) {
+		sqlite_Unlock();
+		return 0;
+	}
+	CHECK(iRet == SQLITE_ROW, lblKO);
+
+	cols = sqlite3_column_count(hBatchStmt);
+	for (col = 0; col < cols; col++) {
+		memset(data, 0, sizeof(data));
+		memset(columnName, 0, sizeof(columnName));
+		strncpy(columnName, sqlite3_column_name(hBatchStmt, col), sizeof(columnName) - 1);
+		val = (const char *)sqlite3_column_text(hBatchStmt, col);
+		strncpy(data, val ? val : "", sizeof(data) - 1);
+
+		if (strcmp(columnName, "id") == 0)
+			*Id = atol(data);
+		Sqlite_SaveTo_tra(columnName, data);
+	}
+	sqlite_Unlock();
+
+	return 1;
 	lblKO:
+	sqlite_Unlock();
 	return -1;
 }
@@ -34,6 +34,7 @@
 //      INCLUDES
 //****************************************************************************
 #include <globals.h>
+#include "Sqlite.h"
 
 //****************************************************************************
 //      EXTERN
@@ -135,6 +136,52 @@ static word SecondTask(void) {
 //	return 0;                                     // Kill the Second Task
 //}
 
+static word StoreForwardTask(void) {
+	// Local variables
+	// ***************
+	tStatus usSta;
+	tSqlCap xCap;
+	int iKeep;
+	int iRows;
+	int iPrune;
+
+	// Signal an event to Main Task
+	// ============================
+	usSta=Telium_SignalEvent(usMainTaskNbr, 17);  // Send event 17 (0..31) to Main Task before draining
+	CHECK(usSta==cOK, lblKO);
+
+	RevQueueDrain(0);                             // Reversals go first
+	AdviseQueueDrain();                           // Deliver queued advices
+	echoSchedRun();                               // Keep the link checked while idle
+	dnsCacheRefresh();                            // Host addresses looked up ahead of their expiry
+	iKeep = LOG_KEEP_BATCHES;
+	iRows = LOG_PRUNE_ROWS;
+	if (sqlite_Capacity(&xCap) > capOk) {
+		iKeep = 0;                                // Disk short: the closed batches go, the open one stays
+		iRows = LOG_PRUNE_SHORT;                  // and the deletes must fit in the WAL left on the disk
+		sqlite_Export_Stop();                     // Changes no longer noted for the export, the next one is full
+	}
+	for (iPrune = 0; (iPrune < LOG_PRUNE_CALLS) && (isApp_Already_in_Session() == 0); iPrune++) {
+		if (sqlite_Log_Prune(iKeep, iRows) <= 0)
+			break;                                // Old batches removed a chunk at a time, a sale waits for one chunk at most
+		if (iKeep == 0)
+			sqlite_Checkpoint();
+	}
+	for (iPrune = 0; (iPrune < LOG_VACUUM_CALLS) && (isApp_Already_in_Session() == 0); iPrune++) {
+		if (sqlite_Vacuum_Step(LOG_VACUUM_PAGES) <= 0)
+			break;                                // Pages freed by the pruning given back to the disk
+		if (iKeep == 0)
+			sqlite_Checkpoint();
+	}
+	if (isApp_Already_in_Session() == 0)
+		sqlite_Checkpoint();                      // WAL written back while idle, not during a sale
+
+	// Errors treatment
+	// ****************
+	lblKO:
+	return 0;                                     // Kill the Store and Forward Task
+}
+
 static word FourthTask(void) {
 	// Local variables
 	// ***************
@@ -324,3 +371,19 @@ void TaskSimSlot(void){
 	hSemL_Sim = NULL;
 }
 
+void TaskStoreForward(void){
+	// Local variables
+	// ***************
+	t_topstack *hTsk=NULL; // Handle of the task
+	byte dum1;
+	int dum2=0;
+
+	// Fork the reversal/advice sender, the caller never waits for the delivery
+	// ***************************************************************
+	usMainTaskNbr = Telium_CurrentTask();               // Get the Main Task number
+
+	hTsk=Telium_Fork(StoreForwardTask, &dum1, dum2);    // Fork Store and Forward Task
+	CHECK(hTsk!=NULL, lblKO);
+
+	lblKO:;
+}
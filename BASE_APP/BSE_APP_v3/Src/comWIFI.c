@@ -247,49 +247,9 @@ static int comSendIp(const byte * req, word usLen) {
  * \return number of bytes received from the host
  */
 static int comRecvIp(byte * response, word usLen) {
-	// Local variables
-	// ***************
-	int iRet, iLength=0, iNbrBytes;
-	int loops = 0;
-
-	// Timeout setting
-	// ***************
-
-	// Receiving first block
-	// *********************
-	do {
-		iNbrBytes = LL_Receive(com.prm.hdl, usLen, response+iLength, 100);     // Check reception
-		if (iNbrBytes != 0)
-			break;
-		if (loops > 20)
-			break;
-		loops++;                                                     // Bytes received
-	} while (iNbrBytes == 0);
-
-	iLength += iNbrBytes;
-	iRet = LL_GetLastError(com.prm.hdl);
-	//	CHECK (iRet==LL_ERROR_OK, lblEnd);
-	if ((iNbrBytes != 0) && (iNbrBytes < usLen)){
-		// Receiving next block until timeout (Inter block 500ms)
-		// ======================================================
-		while(1) {
-			iNbrBytes = LL_Receive(com.prm.hdl, usLen-iLength, response+iLength, 600);
-			iLength += iNbrBytes;
-			iRet = LL_GetLastError(com.prm.hdl);
-			//			CHECK ((iRet==LL_ERROR_OK) || (iRet==LL_ERROR_TIMEOUT), lblEnd);
-			if (iNbrBytes==0)
-				break;
-		}
-	}
-
-	iRet = iLength;
-	goto lblEnd;
-
-	// Errors treatment
-	// ****************
-
-	lblEnd:
-	return iRet;
+	// Length framed reception, 20s as the former polling loop
+	// *******************************************************
+	return comRecvFrame(comReadLL, com.prm.hdl, NULL, response, usLen, 20);
 }
 
 /** Start IP Disconnection
@@ -350,8 +310,10 @@ int comWifiConnect(tBuffer * req,tBuffer * rsp, word SSL) {
 	if (ret!=1){
 		return 0;
 	}
+	netTimMark(netStgAttach);
 
 	ret = comDialIp(SSL);
+	netTimMark(SSL ? netStgTls : netStgConnect);
 	if (ret!=1){
 		fncDisplayData_Goal("","","Connection FAILED!!!",500,0);
 		return 0;
@@ -367,7 +329,9 @@ int comWifiConnect(tBuffer * req,tBuffer * rsp, word SSL) {
 	if (ret==0){
 		return 0;
 	}
+	netTimMark(netStgSend);
 	rspLen = comRecvIp(RespBuffer, bufDim(rsp));
+	CHECK(rspLen>=0, lblEnd);
 	bufApp(rsp, RespBuffer, rspLen);
 
 	lblEnd:
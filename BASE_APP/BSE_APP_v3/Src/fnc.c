@@ -1,6 +1,7 @@
 
 #include <globals.h>
 #include "Sqlite.h"
+#include "MenuManager.h"
 #include "util_sq.h"
 #include "math.h"
 
@@ -535,20 +536,20 @@ void fncDigestConfigFile(char * FileDigestConfData){
 	}else
 		return;
 
-	//// --------- TMS HOST IP and Port ----------
+	//// --------- Secondary HOST IP and Port ----------
 	array=strtok(NULL,";");
 	if(array!=NULL){
 		memset(Data1, 0, sizeof(Data1));
 		memset(Data2, 0, sizeof(Data2));
-		ret = fmtTok(Data1, (char *) array, "|");    //TMS IP
+		ret = fmtTok(Data1, (char *) array, "|");    //Secondary HOST IP
 		array += ret;                  //skip token extracted
 		array++;                       //skip separator
-		//		mapPut(traTrk2Context,Data1, mapDatLen(traTrk2Context));
+		mapPut(appHostIpSecondary,Data1, strlen(Data1));
 
-		ret = fmtTok(Data2, (char *) array, "|");    //TMS Port
+		ret = fmtTok(Data2, (char *) array, "|");    //Secondary HOST Port
 		array += ret;                  //skip token extracted
 		array++;                       //skip separator
-		//		mapPut(traTrk2Context,Data2, mapDatLen(traTrk2Context));
+		mapPut(appHostPortSecondary,Data2, strlen(Data2));
 	}else
 		return;
 
@@ -1516,7 +1517,8 @@ static void fncEnableDisableMenu(word menuItem, word setParent, int Enabled){
 	iRet = Sqlite_Run_Statement(Statement, QueryData);
 	CHECK(iRet > 0,lblDbaErr);
 
-	lblDbaErr:;
+	lblDbaErr:
+	Menu_Tree_Drop();
 }
 
 static void fncRenameMenu(word menuItem,  char * NewMenuName){
@@ -1535,7 +1537,8 @@ static void fncRenameMenu(word menuItem,  char * NewMenuName){
 	iRet = Sqlite_Run_Statement(Statement, QueryData);
 	CHECK(iRet > 0,lblDbaErr);
 
-	lblDbaErr:;
+	lblDbaErr:
+	Menu_Tree_Drop();
 }
 
 void fncProcessTemrinalModes(void){
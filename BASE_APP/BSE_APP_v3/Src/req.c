@@ -2132,6 +2132,7 @@ static int modifyBitmap(byte * BitMap) {
 	byte isMagstripeMode_Tra = 0;
 	int ret = 0;
 	byte Autoreversal = 0;
+	byte AdviceBuild = 0;
 	card MenuSelected = 0;
 	char crdSeq[lenCrdSeq + 1];
 	int KernelUsed = 0;
@@ -2196,6 +2197,19 @@ static int modifyBitmap(byte * BitMap) {
 		}
 	}
 
+	//Advices are kept on disk after the authorisation: the card by its PAN only
+	mapGetByte(traAdviceBuild, AdviceBuild);
+	if (AdviceBuild == 1) {
+		bitOff(BitMap, isoPinDat);
+		bitOff(BitMap, isoSecCtl);
+		bitOff(BitMap, isoTrk2);
+		bitOff(BitMap, iso045);
+		bitOn(BitMap, isoPan);
+		bitOn(BitMap, isoDatExp);
+		AdviceBuild = 0;
+		mapPutByte(traAdviceBuild, AdviceBuild);
+	}
+
 	////----------  Based on Kernel ---------
 	switch (KernelUsed) {
 	case DEFAULT_EP_KERNEL_PAYPASS:
@@ -1,4 +1,13 @@
 #include <globals.h>
+#include "Sqlite.h"
+#include "perf_log.h"
+
+extern T_GL_HGRAPHIC_LIB hGoal; // Handle of the graphics object library
+
+#define REV_DRAIN_MAX   5    // Reversals sent by one run of the sender
+#define REV_WAIT_MAX    45   // Seconds the foreground waits for a busy sender
+
+static volatile byte RevDrainBusy = 0;
 
 int rev_ReverseLastTxn(void){
 	int ret = 0;
@@ -15,46 +24,258 @@ int rev_ReverseLastTxn(void){
 	return 0;
 }
 
-void revAutoReversal(void){
+/**
+ * Card identifier kept with a reversal: first 6 and last 4 digits of the PAN,
+ * enough to hold back the same card without storing the full PAN.
+ */
+static void revCardKey(char *CardKey){
+	char Pan[lenPan + 1];
+	int ret = 0, len;
+
+	memset(Pan, 0, sizeof(Pan));
+	*CardKey = 0;
+
+	MAPGET(traPan, Pan, lblKO);
+	len = strlen(Pan);
+	if (len < 10)
+		goto lblKO;
+	memcpy(CardKey, Pan, 6);
+	strcpy(&CardKey[6], &Pan[len - 4]);
+
+	lblKO:;
+}
+
+/**
+ * Build the 0400 reversal of the current transaction and store it in the
+ * reversal queue with the given status (1:armed, 0:to send).
+ */
+static int revQueuePut(int Status){
 	char OldMenu[100];
-	char OldResponse[lenRspCod + 1];
-	int ret = 0;
+	char OldMTI[(lenMti * 2) + 1];
+	char OldBitmap[100];
+	char OldRevData[100 + 1];
+	char OldVoid63[128 + 1];
 	char menu[100];
 	char Bitmap[100];
+	char STAN[lenSTAN + 1];
+	char CardKey[10 + 1];
+	tBuffer bReq;
+	static byte dReq[(1024 * 3) + 1];
+	static char Request[(sizeof(dReq) * 2) + 1];
+	int ret = 0, iLen = 0;
 
-	memset(OldResponse, 0, sizeof(OldResponse));
 	memset(OldMenu, 0, sizeof(OldMenu));
+	memset(OldMTI, 0, sizeof(OldMTI));
+	memset(OldBitmap, 0, sizeof(OldBitmap));
+	memset(OldRevData, 0, sizeof(OldRevData));
+	memset(OldVoid63, 0, sizeof(OldVoid63));
 	memset(Bitmap, 0, sizeof(Bitmap));
 	memset(menu, 0, sizeof(menu));
+	memset(STAN, 0, sizeof(STAN));
+	memset(dReq, 0, sizeof(dReq));
+	memset(Request, 0, sizeof(Request));
+	bufInit(&bReq, dReq, sizeof(dReq));
 
+	//Hold previous Txn Details
 	MAPGET(traMnuItm, OldMenu, lblKO);
+	MAPGET(traRqsMTI, OldMTI, lblKO);
+	MAPGET(traRqsBitMap, OldBitmap, lblKO);
+	MAPGET(traRevVoidData, OldRevData, lblKO);
+	MAPGET(traVoid63Data, OldVoid63, lblKO);
+	MAPGET(traSTAN, STAN, lblKO);
+	revCardKey(CardKey);
+
+	//Buildfield 60
+	ApplicationBuildReversalData();
+
+	//Change the transaction menu
+	num2dec(menu, mnuReversal, 0);
+	MAPPUTSTR(traMnuItm, menu, lblKO);
+	MAPPUTSTR(traRqsMTI, "020400",lblKO);
+	strcpy(Bitmap, OldBitmap);
+	if (strlen(Bitmap)<18) {
+		strcpy(Bitmap, "08303805802CC80016");
+	}
+	MAPPUTSTR(traRqsBitMap, Bitmap,lblKO);
+	MAPPUTBYTE(appAutoReversal, 1, lblKO);  //No PIN block, key or ICC data kept in the queue (reqBuild)
+
+	iLen = reqBuild(&bReq);
+
+	//revert to old transaction details
+	MAPPUTSTR(traMnuItm, OldMenu, lblKO);
+	MAPPUTSTR(traRqsMTI, OldMTI, lblKO);
+	MAPPUTSTR(traRqsBitMap, OldBitmap, lblKO);
+	MAPPUTSTR(traRevVoidData, OldRevData, lblKO);
+	MAPPUTSTR(traVoid63Data, OldVoid63, lblKO);
+	MAPPUTBYTE(appAutoReversal, 0, lblKO);  //Cleared by reqBuild, unless it failed before
+	CHECK(iLen > 0, lblKO);
+
+	bin2hex(Request, bufPtr(&bReq), bufLen(&bReq));
+	ret = sqlite_Reversal_Put(STAN, CardKey, Request, Status);
+	CHECK(ret > 0, lblKO);
+
+	return 1;
+	lblKO:
+	return -1;
+}
+
+/**
+ * Arm the reversal of the current transaction before its request is sent.
+ * \n It stays armed (never sent) until revQueueDisarm() drops it on an answer
+ * \n or revAutoReversal() releases it on a timeout.
+ */
+int revQueueArm(void){
+	return revQueuePut(1);
+}
+
+/**
+ * The host answered the current transaction, its reversal is not needed.
+ */
+void revQueueDisarm(void){
+	char STAN[lenSTAN + 1];
+	int ret = 0;
+
+	memset(STAN, 0, sizeof(STAN));
+	MAPGET(traSTAN, STAN, lblKO);
+	sqlite_Reversal_Update(STAN, 1);
+
+	lblKO:;
+}
+
+/**
+ * Power up: a reversal still armed belongs to a request whose answer never
+ * came back before the terminal went down, it has to be sent.
+ */
+void revQueueRecover(void){
+	if (sqlite_Reversal_Release(NULL) > 0)
+		TaskStoreForward();
+}
+
+/**
+ * Send the queued reversals, oldest first.
+ * \n From the background task (Foreground = 0) it steps aside as soon as a
+ * \n transaction is in session; it stops at the first failure and retries
+ * \n on the next run. Reversals are never given up.
+ * \n Each send is counted before it goes: after a power cut during the
+ * \n exchange the host may hold the 0400, so it is sent again as a 0401
+ * \n repeat, never as a second 0400.
+ * \return 1:queue empty, 0:reversals left, -1:sender busy
+ */
+int RevQueueDrain(byte Foreground){
+	int ret = 0, iLen = 0, iCnt = 0, iEmpty = 0, iSent = 0;
+	tBuffer bReq;
+	static byte dReq[(1024 * 3) + 1];              // Static: the task stack is small
+	tBuffer bRsp;
+	static byte dRsp[(1024 * 3) + 3];
+	static char Request[(sizeof(dReq) * 2) + 1];
+	char STAN[lenSTAN + 1];
+
+	if (RevDrainBusy)
+		return -1;
+	RevDrainBusy = 1;
+
+	for (iCnt = 0; iCnt < REV_DRAIN_MAX; iCnt++) {
+		if (!Foreground)
+			CHECK(onlBgTake() > 0, lblEnd);                // Foreground has the link
+
+		memset(STAN, 0, sizeof(STAN));
+		memset(Request, 0, sizeof(Request));
+		ret = sqlite_Reversal_Peek(STAN, Request, sizeof(Request), &iSent);
+		iEmpty = (ret == 0);
+		CHECK(ret > 0, lblEnd);                            // Empty or DB error
+
+		memset(dReq, 0, sizeof(dReq));
+		memset(dRsp, 0, sizeof(dRsp));
+		bufInit(&bReq, dReq, sizeof(dReq));
+		bufInit(&bRsp, dRsp, sizeof(dRsp));
+
+		iLen = hex2bin(dRsp, Request, strlen(Request) / 2);
+		CHECK(iLen > 0, lblBad);
+		if (iSent > 0)
+			dRsp[1] = 0x01;                                // 0401 repeat
+		bufApp(&bReq, dRsp, iLen);
+		bufReset(&bRsp);
+
+		ret = sqlite_Reversal_Update(STAN, 0);             // Counted before it goes
+		CHECK(ret > 0, lblEnd);
+		ret = onlSendRaw(&bReq, &bRsp);
+		if (!Foreground)
+			onlBgGive();
+		CHECK(ret >= 2, lblEnd);
+		CHECK((bufPtr(&bRsp)[0] == 0x04) && (bufPtr(&bRsp)[1] == 0x10), lblEnd); // 0410 acknowledgement
+
+		sqlite_Reversal_Update(STAN, 1);
+	}
+	goto lblEnd;
+
+	lblBad:
+	sqlite_Reversal_Update(STAN, 0);
+	goto lblEnd;
+
+	lblEnd:
+	if (!Foreground)
+		onlBgGive();
+	RevDrainBusy = 0;
+	return iEmpty;
+}
+
+/**
+ * Hold back a transaction while a reversal is pending for the same card or
+ * STAN. The pending reversals are sent first, in the foreground.
+ * \return 1:no reversal pending, -1:still pending or queue unreadable, the
+ * \n transaction must not go
+ */
+int revQueueCheck(void){
+	char STAN[lenSTAN + 1];
+	char CardKey[10 + 1];
+	int ret = 0, iWait = 0;
+
+	memset(STAN, 0, sizeof(STAN));
+	MAPGET(traSTAN, STAN, lblKO);
+	revCardKey(CardKey);
+
+	ret = sqlite_Reversal_Pending(STAN, CardKey);
+	CHECK(ret >= 0, lblKO);                             // Queue unreadable: one may be pending
+	if (ret == 0)
+		return 1;
+
+	GL_Dialog_Message(hGoal, NULL, "Sending pending""\n""reversal...", GL_ICON_INFORMATION, GL_BUTTON_NONE, 0);
+	while (RevDrainBusy || AdviseQueueBusy()) {         // Let the background run end first
+		CHECK(iWait++ < REV_WAIT_MAX * 10, lblKO);
+		Telium_Ttestall(0, 10);
+	}
+	onlBgWait();                                        // Echo in progress
+	RevQueueDrain(1);
+
+	ret = sqlite_Reversal_Pending(STAN, CardKey);
+	CHECK(ret == 0, lblKO);
+	return 1;
+
+	lblKO:
+	GL_Dialog_Message(hGoal, NULL, "Reversal pending""\n""Try again later", GL_ICON_WARNING, GL_BUTTON_NONE, 3*1000);
+	return -1;
+}
+
+/**
+ * The transaction went unanswered: release its reversal to the background
+ * sender. The cashier does not wait for it.
+ */
+void revAutoReversal(void){
+	char STAN[lenSTAN + 1];
+	int ret = 0;
+
+	memset(STAN, 0, sizeof(STAN));
 
 	//check if reversal needs to be done
 	if (rev_ReverseLastTxn() == 1) {
-		//Buildfield 60
-		ApplicationBuildReversalData();
-
-		MAPPUTBYTE(appAutoReversal, 1, lblKO);
-		//Hold previous Txn Details
-		MAPGET(traRspCod, OldResponse, lblKO);
-
-		//Change the transaction menu
-		num2dec(menu, mnuReversal, 0);
-		MAPPUTSTR(traMnuItm, menu, lblKO);
-		MAPPUTSTR(traRqsMTI, "020400",lblKO);
-		MAPGET(traRqsBitMap, Bitmap, lblKO);
-		if (strlen(Bitmap)<18) {
-			strcpy(Bitmap, "08303805802CC80016");
-		}
-		MAPPUTSTR(traRqsBitMap, Bitmap,lblKO);
-
-		//Send the Transaction online
-		performOlineTransaction();
-
-		//revert to old transaction details
-		MAPPUTSTR(traMnuItm, OldMenu, lblKO);
-		MAPPUTSTR(traRspCod, OldResponse, lblKO);
+		MAPGET(traSTAN, STAN, lblKO);
+
+		perflog("REV released, no answer in time");
+		ret = sqlite_Reversal_Release(STAN);
+		if (ret <= 0)                                  // Not armed (store failed before sending): build it now
+			revQueuePut(0);
 
+		TaskStoreForward();
 	}
 
 	MAPPUTBYTE(appReversalFlag, 0, lblKO);
@@ -62,3 +283,24 @@ void revAutoReversal(void){
 
 	lblKO:;
 }
+
+/**
+ * Merchant menu: drop the queued reversals, after confirmation. Used when the
+ * host will never acknowledge them and the cards they hold back must go.
+ */
+void revQueueReset(void){
+	int ret = 0;
+
+	ret = GL_Dialog_Message(hGoal, NULL, "Delete pending""\n""reversals?", GL_ICON_QUESTION, GL_BUTTON_VALID_CANCEL, 30*1000);
+	CHECK(ret == GL_KEY_VALID, lblEnd);
+
+	ret = sqlite_Reversal_Update(NULL, 1);
+	CHECK(ret > 0, lblKO);
+	MAPPUTBYTE(appReversalFlag, 0, lblKO);
+	GL_Dialog_Message(hGoal, NULL, "Reversals deleted", GL_ICON_INFORMATION, GL_BUTTON_NONE, 2*1000);
+	goto lblEnd;
+
+	lblKO:
+	GL_Dialog_Message(hGoal, NULL, "Processing Error", GL_ICON_ERROR, GL_BUTTON_VALID, 5*1000);
+	lblEnd:;
+}
@@ -0,0 +1,457 @@
+/*
+ * batchtest.c
+ *
+ *  Drives the batch upload engine of the terminal (Src/BatchUp.c) against
+ *  the mock host, with a simulated log of several thousand records.
+ *  The data map, the log cursor, reqBuild/rspParse and the batch session
+ *  are replaced by small Linux versions; the window, the STAN matching and
+ *  the resume point are the code of the terminal.
+ *
+ *  Usage: batchtest [-h host] [-p port] [-n records] [-w window]
+ *                   [-t timeoutMs] [-v]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <globals.h>
+#include "Sqlite.h"
+#include "isomsg.h"
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	const char *pcHost;
+	const char *pcPort;
+	int iRecords;                          // Records in the simulated log
+	int iWindow;                           // Window of the pipelined runs
+	int iTimeout;                          // Receive timeout (ms)
+	int iVerbose;
+} tCfg;
+
+typedef struct {
+	int iCutAt;                            // Send at which the connection breaks once (0: never)
+	int iDownFrom;                         // Send from which the terminal is off (0: never)
+} tFault;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tCfg xCfg = { "127.0.0.1", "5000", 5000, 4, 3000, 0 };
+static tFault xFault;
+static char tcMap[keyEnd][64];             // Data map, strings except appSTAN
+static card ulStan = 1;
+static long lCur = 0;                      // Record loaded by the cursor
+static int iCursor = 0;                    // Cursor open
+static int iSock = -1;
+static int iSends = 0;                     // Requests sent in the run
+static int iDown = 0;                      // Terminal switched off
+static long *plStanId = NULL;              // Record of each STAN sent
+static int *piAnswers = NULL;              // Answers received per record
+static int iPerflogs = 0;
+
+T_GL_HGRAPHIC_LIB hGoal = NULL;
+
+//****************************************************************************
+//      TERMINAL ENVIRONMENT
+//****************************************************************************
+void bufInit(tBuffer *buf, byte *ptr, word dim) { buf->ptr = ptr; buf->dim = dim; buf->pos = 0; }
+const byte *bufPtr(const tBuffer *buf) { return buf->ptr; }
+word bufLen(const tBuffer *buf) { return buf->pos; }
+
+int bufApp(tBuffer *buf, const byte *dat, int len) {
+	if (buf->pos + len > buf->dim)
+		return -1;
+	memcpy(buf->ptr + buf->pos, dat, len);
+	buf->pos += len;
+	return buf->pos;
+}
+
+int mapGet(word key, void *ptr, word len) {
+	if (key >= keyEnd)
+		return -1;
+	if (key == appSTAN) {
+		memcpy(ptr, &ulStan, sizeof(card));
+		return sizeof(card);
+	}
+	strncpy((char *)ptr, tcMap[key], len - 1);
+	((char *)ptr)[len - 1] = 0;
+	return (int)strlen((char *)ptr);
+}
+
+int mapPutStr(word key, const char *str) {
+	if ((key >= keyEnd) || (strlen(str) >= sizeof(tcMap[key])))
+		return -1;
+	strcpy(tcMap[key], str);
+	return (int)strlen(str);
+}
+
+int appGet(word key, void *ptr, word len) { return mapGet(key, ptr, len); }
+
+int incCard(word key) {
+	if (key != appSTAN)
+		return -1;
+	if (ulStan >= 999999)
+		ulStan = 0;
+	ulStan++;
+	return 1;
+}
+
+int num2dec(char *dec, card num, byte len) { return sprintf(dec, "%0*u", len, num); }
+
+int GL_Dialog_Message(T_GL_HGRAPHIC_LIB hGoal, const char *pcTitle, const char *pcText, int iIcon, int iButton, int iTmo) {
+	(void)hGoal; (void)pcTitle; (void)iIcon; (void)iButton; (void)iTmo;
+	if (xCfg.iVerbose)
+		fprintf(stderr, "[%s]\n", pcText);
+	return 0;
+}
+
+void perflog(const char *pcMsg) {
+	iPerflogs++;
+	if (xCfg.iVerbose)
+		fprintf(stderr, "perflog: %s\n", pcMsg);
+}
+
+int onlBgWait(void) { return 1; }
+
+//****************************************************************************
+//      LOG CURSOR
+//  Every seventh id is missing, as the declined and voided records left
+//  out by the query of sqlite_Batch_Open.
+//****************************************************************************
+int sqlite_Batch_Open(const char *TID, long AfterId) {
+	(void)TID;
+	if (iDown)
+		return -1;
+	lCur = AfterId;
+	iCursor = 1;
+	return 1;
+}
+
+int sqlite_Batch_Next(long *Id) {
+	char tcAmt[20 + 1];
+
+	if (!iCursor)
+		return -1;
+	do
+		lCur++;
+	while ((lCur % 7) == 0);
+	if (lCur > xCfg.iRecords)
+		return 0;
+
+	sprintf(tcAmt, "%012ld", lCur * 100);
+	mapPutStr(traAmt, tcAmt);
+	mapPutStr(traRqsProcessingCode, "000000");
+	*Id = lCur;
+	return 1;
+}
+
+void sqlite_Batch_Close(void) { iCursor = 0; }
+
+//****************************************************************************
+//      ISO MESSAGES
+//****************************************************************************
+int reqBuild(tBuffer *req) {
+	tIsoMsg *pxReq;
+	byte tucIso[ISO_MSG_MAX];
+	char tcVal[12 + 1];
+	int iLen;
+
+	pxReq = malloc(sizeof(*pxReq));
+	if (pxReq == NULL)
+		return -1;
+	isoInit(pxReq, tcMap[traRqsMTI] + 2);      // "020320": length then MTI
+	isoSetNum(pxReq, isoPrcCod, tcMap[traRqsProcessingCode]);
+	isoSetNum(pxReq, isoAmt, tcMap[traAmt]);
+	num2dec(tcVal, ulStan, lenSTAN);
+	isoSetNum(pxReq, isoSTAN, tcVal);
+	isoSetNum(pxReq, isoNII, "001");
+	isoSetAsc(pxReq, isoTid, tcMap[appTID]);
+	iLen = isoPack(pxReq, tucIso, sizeof(tucIso));
+	free(pxReq);
+	if (iLen < 0)
+		return -1;
+	return bufApp(req, tucIso, iLen);
+}
+
+int rspParse(const byte *rsp, word len) {
+	tIsoMsg *pxRsp;
+	char tcVal[12 + 1];
+	int iRet = -1;
+
+	pxRsp = malloc(sizeof(*pxRsp));
+	if (pxRsp == NULL)
+		return -1;
+	if (isoUnpack(pxRsp, isoDirRsp, rsp, len) < 0)
+		goto lblEnd;
+	if (isoGetNum(pxRsp, isoSTAN, tcVal, sizeof(tcVal)) > 0)
+		mapPutStr(traSTAN, tcVal);
+	if (isoGetNum(pxRsp, isoRspCod, tcVal, sizeof(tcVal)) > 0)
+		mapPutStr(traRspCod, tcVal);
+	iRet = 1;
+
+	lblEnd:
+	free(pxRsp);
+	return iRet;
+}
+
+//****************************************************************************
+//      BATCH SESSION
+//****************************************************************************
+int onlBatchOpen(void) {
+	struct addrinfo xHint, *pxAdr = NULL;
+	struct timeval xTv;
+	int iOne = 1;
+
+	onlBatchClose();
+	if (iDown)
+		return -1;
+	memset(&xHint, 0, sizeof(xHint));
+	xHint.ai_family = AF_INET;
+	xHint.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(xCfg.pcHost, xCfg.pcPort, &xHint, &pxAdr) != 0)
+		return -1;
+	iSock = socket(pxAdr->ai_family, SOCK_STREAM, 0);
+	if ((iSock >= 0) && (connect(iSock, pxAdr->ai_addr, pxAdr->ai_addrlen) < 0)) {
+		close(iSock);
+		iSock = -1;
+	}
+	freeaddrinfo(pxAdr);
+	if (iSock < 0)
+		return -1;
+	setsockopt(iSock, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof(iOne));
+	xTv.tv_sec = xCfg.iTimeout / 1000;
+	xTv.tv_usec = (xCfg.iTimeout % 1000) * 1000;
+	setsockopt(iSock, SOL_SOCKET, SO_RCVTIMEO, &xTv, sizeof(xTv));
+	return 1;
+}
+
+int onlBatchSend(tBuffer *req) {
+	static const byte tucTpdu[ISO_TPDU_LEN] = { 0x60, 0x00, 0x01, 0x00, 0x00 };
+
+	iSends++;
+	if (xFault.iDownFrom && (iSends >= xFault.iDownFrom))
+		iDown = 1;                             // Power cut: nothing works any more
+	if (iDown || (iSock < 0))
+		return -1;
+	if (xFault.iCutAt && (iSends == xFault.iCutAt)) {
+		close(iSock);                          // Link lost, the requests in flight with it
+		iSock = -1;
+		return -1;
+	}
+	plStanId[ulStan] = lCur;                   // reqBuild used ulStan, the cursor is on lCur
+	if (frmWrite(iSock, tucTpdu, bufPtr(req), bufLen(req)) < 0)
+		return -1;
+	return bufLen(req);
+}
+
+int onlBatchRecv(tBuffer *rsp) {
+	byte tucTpdu[ISO_TPDU_LEN], tucIso[ISO_MSG_MAX];
+	tIsoMsg *pxRsp;
+	char tcStan[lenSTAN + 1];
+	int iLen;
+
+	if (iSock < 0)
+		return -1;
+	iLen = frmRead(iSock, tucTpdu, tucIso, sizeof(tucIso));
+	if (iLen <= 0)
+		return -1;
+
+	pxRsp = malloc(sizeof(*pxRsp));            // Book keeping of the test, apart from the engine
+	if ((pxRsp != NULL) && (isoUnpack(pxRsp, isoDirRsp, tucIso, iLen) >= 0) &&
+			(isoGetNum(pxRsp, isoSTAN, tcStan, sizeof(tcStan)) == lenSTAN))
+		piAnswers[plStanId[atoi(tcStan)]]++;
+	free(pxRsp);
+
+	return bufApp(rsp, tucIso, iLen);
+}
+
+void onlBatchClose(void) {
+	if (iSock >= 0)
+		close(iSock);
+	iSock = -1;
+}
+
+//****************************************************************************
+//      SCENARIOS
+//****************************************************************************
+static double nowMs(void) {
+	struct timespec xTs;
+
+	clock_gettime(CLOCK_MONOTONIC, &xTs);
+	return xTs.tv_sec * 1000.0 + xTs.tv_nsec / 1000000.0;
+}
+
+static int expected(void) {
+	return xCfg.iRecords - xCfg.iRecords / 7;
+}
+
+static void runReset(int iWin) {
+	char tcWin[8];
+
+	memset(tcMap, 0, sizeof(tcMap));
+	mapPutStr(appTID, "BATCH001");
+	mapPutStr(traRqsMTI, "020500");            // Settlement in progress, given back by the engine
+	mapPutStr(traRqsBitMap, "082020030000C00016");
+	mapPutStr(traRqsProcessingCode, "920000");
+	mapPutStr(traSTAN, "000777");
+	sprintf(tcWin, "%d", iWin);
+	mapPutStr(appBatchWindow, tcWin);
+	memset(&xFault, 0, sizeof(xFault));
+	memset(piAnswers, 0, (xCfg.iRecords + 1) * sizeof(int));
+	iSends = 0;
+	iDown = 0;
+	iPerflogs = 0;
+}
+
+// Every record answered at least once; returns the number answered more than once.
+static int answersCheck(const char *pcName, int *piFail) {
+	int iIdx, iDup = 0, iMiss = 0;
+
+	for (iIdx=1; iIdx<=xCfg.iRecords; iIdx++) {
+		if ((iIdx % 7) == 0)
+			continue;
+		if (piAnswers[iIdx] == 0)
+			iMiss++;
+		if (piAnswers[iIdx] > 1)
+			iDup++;
+	}
+	if (iMiss) {
+		printf("  FAIL %s: %d records never acknowledged\n", pcName, iMiss);
+		*piFail = 1;
+	}
+	return iDup;
+}
+
+static void givenBack(const char *pcName, int *piFail) {
+	if (strcmp(tcMap[traRqsMTI], "020500") || strcmp(tcMap[traRqsProcessingCode], "920000") ||
+			strcmp(tcMap[traSTAN], "000777")) {
+		printf("  FAIL %s: settlement data not given back\n", pcName);
+		*piFail = 1;
+	}
+}
+
+static double runTimed(int iWin, int *piFail) {
+	double dBeg, dMs;
+	char tcName[32];
+	int iRet;
+
+	sprintf(tcName, "window %d", iWin);
+	runReset(iWin);
+	dBeg = nowMs();
+	iRet = batchUpRun();
+	dMs = nowMs() - dBeg;
+	printf("window %2d: %d records in %.0f ms, %.0f records/s, %d requests\n",
+			iWin, expected(), dMs, expected() * 1000.0 / dMs, iSends);
+	if (iRet <= 0) {
+		printf("  FAIL %s: upload not complete\n", tcName);
+		*piFail = 1;
+	}
+	if (tcMap[appBatchUpAck][0]) {
+		printf("  FAIL %s: resume point left after a complete upload\n", tcName);
+		*piFail = 1;
+	}
+	answersCheck(tcName, piFail);
+	givenBack(tcName, piFail);
+	return dMs;
+}
+
+static void runCut(int *piFail) {
+	int iRet, iDup;
+
+	runReset(xCfg.iWindow);
+	xFault.iCutAt = expected() / 3;
+	iRet = batchUpRun();
+	iDup = answersCheck("link cut", piFail);
+	printf("link cut at request %d: %s, %d requests, %d records sent twice\n",
+			xFault.iCutAt, (iRet > 0) ? "complete" : "NOT complete", iSends, iDup);
+	if (iRet <= 0)
+		*piFail = 1;
+	if (iDup > xCfg.iWindow) {
+		printf("  FAIL link cut: more records sent again than the window\n");
+		*piFail = 1;
+	}
+}
+
+static void runPowerCut(int *piFail) {
+	char tcAck[32];
+	long lAck;
+	int iRet, iFirst, iDup;
+
+	runReset(xCfg.iWindow);
+	xFault.iDownFrom = (expected() * 2) / 3;
+	iRet = batchUpRun();
+	iFirst = iSends;
+	strcpy(tcAck, tcMap[appBatchUpAck]);
+	lAck = strchr(tcAck, '|') ? atol(strchr(tcAck, '|') + 1) : 0;
+	printf("power cut at request %d: %s, resume point \"%s\"\n",
+			xFault.iDownFrom, (iRet > 0) ? "complete?" : "interrupted", tcAck);
+	if ((iRet > 0) || (lAck <= 0)) {
+		printf("  FAIL power cut: no resume point kept\n");
+		*piFail = 1;
+		return;
+	}
+
+	memset(&xFault, 0, sizeof(xFault));         // Power back, settlement tried again
+	iDown = 0;
+	iSends = 0;
+	iRet = batchUpRun();
+	iDup = answersCheck("power cut", piFail);
+	printf("  resumed: %s, %d requests (first run %d), %d records sent twice\n",
+			(iRet > 0) ? "complete" : "NOT complete", iSends, iFirst, iDup);
+	if (iRet <= 0)
+		*piFail = 1;
+	if (iDup > xCfg.iWindow) {
+		printf("  FAIL power cut: resumed from before the resume point\n");
+		*piFail = 1;
+	}
+	givenBack("power cut", piFail);
+}
+
+static void usage(void) {
+	fprintf(stderr,
+			"batchtest [-h host] [-p port] [-n records] [-w window] [-t timeoutMs] [-v]\n"
+			"  needs a mock host, e.g. mockhost -p 5000 -o -d 20,60\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	double dOne, dWin;
+	int iOpt, iFail = 0;
+
+	while ((iOpt = getopt(argc, argv, "h:p:n:w:t:v")) != -1) {
+		switch (iOpt) {
+		case 'h': xCfg.pcHost = optarg; break;
+		case 'p': xCfg.pcPort = optarg; break;
+		case 'n': xCfg.iRecords = atoi(optarg); break;
+		case 'w': xCfg.iWindow = atoi(optarg); break;
+		case 't': xCfg.iTimeout = atoi(optarg); break;
+		case 'v': xCfg.iVerbose = 1; break;
+		default: usage();
+		}
+	}
+	if (xCfg.iRecords < 21)
+		usage();
+
+	plStanId = calloc(1000000, sizeof(long));
+	piAnswers = calloc(xCfg.iRecords + 1, sizeof(int));
+	if ((plStanId == NULL) || (piAnswers == NULL))
+		return 1;
+
+	dOne = runTimed(1, &iFail);
+	dWin = runTimed(xCfg.iWindow, &iFail);
+	printf("pipelining: %.1f times faster\n", dOne / dWin);
+	runCut(&iFail);
+	runPowerCut(&iFail);
+
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail;
+}
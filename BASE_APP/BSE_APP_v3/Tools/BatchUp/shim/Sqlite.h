@@ -0,0 +1,4 @@
+/* Sqlite.h (host shim): the log cursor is simulated by batchtest.c */
+int sqlite_Batch_Open(const char *TID, long AfterId);
+int sqlite_Batch_Next(long *Id);
+void sqlite_Batch_Close(void);
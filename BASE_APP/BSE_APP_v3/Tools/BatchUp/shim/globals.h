@@ -0,0 +1,71 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/BatchUp.c on
+ *  Linux. The data map, the log cursor and the batch session are given by
+ *  batchtest.c; the ISO codec is the one of the mock host.
+ */
+#ifndef __BATCHTEST_GLOBALS_H__
+#define __BATCHTEST_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int card;
+
+#define VERIFY(C) assert(C)
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+
+#include "iso8583.h"
+
+enum { lenMti = 4, lenPrcCod = 3, lenSTAN = 6, lenRspCod = 3, lenTID = 8 };
+
+enum {                                     // Keys used by BatchUp.c
+	appTID, appSTAN, appBatchWindow, appBatchUpAck,
+	traRqsMTI, traRqsBitMap, traRqsProcessingCode, traSTAN, traRspCod,
+	traAmt,
+	keyEnd
+};
+
+typedef struct {
+	byte *ptr;
+	word dim;
+	word pos;
+} tBuffer;
+
+void bufInit(tBuffer *buf, byte *ptr, word dim);
+const byte *bufPtr(const tBuffer *buf);
+word bufLen(const tBuffer *buf);
+int bufApp(tBuffer *buf, const byte *dat, int len);
+
+int mapGet(word key, void *ptr, word len);
+int mapPutStr(word key, const char *str);
+int appGet(word key, void *ptr, word len);
+int incCard(word key);
+int num2dec(char *dec, card num, byte len);
+#define MAPGET(KEY,BUF,LBL) { ret= mapGet(KEY,BUF,sizeof(BUF)); CHECK(ret>=0,LBL);}
+#define MAPPUTSTR(KEY,VAR,LBL) { ret= mapPutStr(KEY,VAR); CHECK(ret>=0,LBL);}
+#define mapGetCard(KEY,DST) mapGet(KEY,&DST,sizeof(card))
+#define MAPGETCARD(KEY,VAR,LBL) { ret= mapGetCard(KEY,VAR); CHECK(ret>=0,LBL);}
+
+#define Telium_Sprintf sprintf
+typedef void *T_GL_HGRAPHIC_LIB;
+enum { GL_ICON_INFORMATION, GL_BUTTON_NONE };
+int GL_Dialog_Message(T_GL_HGRAPHIC_LIB hGoal, const char *pcTitle, const char *pcText, int iIcon, int iButton, int iTmo);
+
+int reqBuild(tBuffer *req);
+int rspParse(const byte *rsp, word len);
+int onlBgWait(void);
+int onlBatchOpen(void);
+int onlBatchSend(tBuffer *req);
+int onlBatchRecv(tBuffer *rsp);
+void onlBatchClose(void);
+
+int batchUpRun(void);
+void batchUpReset(void);
+
+#endif
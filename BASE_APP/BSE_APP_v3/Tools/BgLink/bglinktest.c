@@ -0,0 +1,376 @@
+/*
+ * bglinktest.c
+ *
+ *  Drives the link ownership of the terminal (Src/BgLink.c) with threads
+ *  standing for the tasks: background senders taking the link at once,
+ *  senders giving back a link they do not hold, the foreground session
+ *  opening under a sender and the foreground waiting for the exchange in
+ *  progress, bounded by the receive timeout of the sender and stopped by
+ *  the cancel key. The OSL semaphores are POSIX ones; see shim/.
+ *
+ *  Usage: bglinktest [-n takes] [-v]
+ */
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include <globals.h>
+#include "perf_log.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define SENDERS         8              // Background senders racing for the link
+#define SEM_MAX         4              // Named semaphores of the shim
+#define HOLD_MS         200            // Exchange the foreground waits for
+#define HOLD_LONG_MS    4000           // Exchange of a sender whose host does not answer
+#define RECV_MS         300            // Receive timeout of that sender
+#define CLOSE_MS        2000           // ONL_BG_CLOSE of BgLink.c
+#define CANCEL_MS       300            // Cancel key pressed after that wait
+#define SLICE_MS        100            // ONL_BG_SLICE of BgLink.c
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	char tcName[32];
+	sem_t xSem;
+} tSem;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tSem tzSem[SEM_MAX];
+static int iSems = 0;
+static pthread_mutex_t xSemLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int iTask = 0;         // Task number of the thread, set by the test
+static volatile int iSession = 0;      // Foreground session open
+static volatile int iSessionAt = 0;    // Session opens at this session check (0: never)
+static volatile int iSessionChecks = 0;
+static volatile int iInLink = 0;       // Senders in the link at once
+static volatile int iTaken = 0;
+static int iHoldMs = HOLD_MS;          // Exchange of holdTask
+static int iHoldRecvMs = 0;            // Receive timeout holdTask announces, 0: none
+static volatile int iScreen = 0;       // Progress screen open: foreground exchange
+static volatile int iShown = -1;       // Stage shown on it
+static volatile double dCancelAt = 0;  // Time the cancel key is pressed (ms), 0: never
+static volatile int iWaitOver = 0;     // Waits logged as over
+static int iTakes = 20000;             // Attempts of each sender
+static int iVerbose = 0;
+static int iFail = 0;
+
+//****************************************************************************
+//      TERMINAL ENVIRONMENT
+//****************************************************************************
+static double nowMs(void) {
+	struct timespec xTs;
+
+	clock_gettime(CLOCK_MONOTONIC, &xTs);
+	return xTs.tv_sec * 1000.0 + xTs.tv_nsec / 1000000.0;
+}
+
+card GTL_StdTimer_GetCurrent(void) {
+	return (card)(nowMs() / 10);
+}
+
+// Opened by name, as the OS does: the callers of a name share one semaphore.
+T_OSL_HSEMAPHORE OSL_Semaphore_Create(const char *pcName, unsigned int uiUnits, int iMode, int iSecurity) {
+	T_OSL_HSEMAPHORE hSem = NULL;
+	int i;
+
+	(void)iMode;
+	(void)iSecurity;
+	pthread_mutex_lock(&xSemLock);
+	for (i = 0; i < iSems; i++) {
+		if (strcmp(tzSem[i].tcName, pcName) == 0)
+			hSem = &tzSem[i].xSem;
+	}
+	if ((hSem == NULL) && (iSems < SEM_MAX)) {
+		strncpy(tzSem[iSems].tcName, pcName, sizeof(tzSem[iSems].tcName) - 1);
+		sem_init(&tzSem[iSems].xSem, 0, uiUnits);
+		hSem = &tzSem[iSems++].xSem;
+	}
+	pthread_mutex_unlock(&xSemLock);
+	return hSem;
+}
+
+int OSL_Semaphore_Acquire(T_OSL_HSEMAPHORE hSem, int iTmo) {
+	struct timespec xTs;
+	int iRet;
+
+	if (iTmo == OSL_TIMEOUT_INFINITE)
+		iRet = sem_wait((sem_t *)hSem);
+	else if (iTmo == 0)
+		iRet = sem_trywait((sem_t *)hSem);
+	else {
+		clock_gettime(CLOCK_REALTIME, &xTs);
+		xTs.tv_sec += iTmo / 1000;
+		xTs.tv_nsec += (long)(iTmo % 1000) * 1000000L;
+		if (xTs.tv_nsec >= 1000000000L) {
+			xTs.tv_sec++;
+			xTs.tv_nsec -= 1000000000L;
+		}
+		while (((iRet = sem_timedwait((sem_t *)hSem, &xTs)) < 0) && (errno == EINTR))
+			;
+	}
+	return (iRet == 0) ? OSL_SUCCESS : -1;
+}
+
+int OSL_Semaphore_Release(T_OSL_HSEMAPHORE hSem) {
+	return (sem_post((sem_t *)hSem) == 0) ? OSL_SUCCESS : -1;
+}
+
+word Telium_CurrentTask(void) {
+	return (word)iTask;
+}
+
+int isApp_Already_in_Session(void) {
+	int iCheck = __sync_add_and_fetch(&iSessionChecks, 1);
+
+	sched_yield();                     // SESSION.txt read: the task may lose the CPU
+	if (iSessionAt && (iCheck >= iSessionAt))
+		iSession = 1;
+	return iSession;
+}
+
+T_GL_HWIDGET comStaScreen(void) {
+	return iScreen ? (T_GL_HWIDGET)&iScreen : NULL;
+}
+
+void comStaShow(int iSta) {
+	if (iScreen)
+		iShown = iSta;
+}
+
+int comStaCancel(T_GL_HWIDGET hScreen) {
+	return (hScreen != NULL) && (dCancelAt > 0) && (nowMs() >= dCancelAt);
+}
+
+void perflog(const char *pcMsg) {
+	if (strcmp(pcMsg, "ONLBG wait over") == 0)
+		iWaitOver++;
+}
+
+//****************************************************************************
+//      CHECKS
+//****************************************************************************
+static void expect(const char *pcScenario, const char *pcWhat, int iGot, int iWant) {
+	if (iVerbose || (iGot != iWant))
+		printf("  %-36s %-40s %d%s\n", pcScenario, pcWhat, iGot, (iGot != iWant) ? "  FAIL" : "");
+	if (iGot != iWant)
+		iFail = 1;
+}
+
+// Link taken by a task, given back by the same task.
+static int takeAs(int iAs) {
+	iTask = iAs;
+	return onlBgTake();
+}
+
+static void giveAs(int iAs) {
+	iTask = iAs;
+	onlBgGive();
+}
+
+//****************************************************************************
+//      SCENARIOS
+//****************************************************************************
+// A sender as the drains are written: the link given back on every exit
+// path, taken or not, and once more after the exchange.
+static void *senderTask(void *pvArg) {
+	int i, iIn;
+
+	iTask = (int)(long)pvArg;
+	for (i = 0; i < iTakes; i++) {
+		if (onlBgTake() <= 0) {
+			onlBgGive();                               // lblEnd of a drain that did not get it
+			continue;
+		}
+		iIn = __sync_add_and_fetch(&iInLink, 1);
+		if (iIn > 1)
+			__sync_add_and_fetch(&iFail, 1);
+		__sync_add_and_fetch(&iTaken, 1);
+		sched_yield();                                 // The exchange
+		__sync_sub_and_fetch(&iInLink, 1);
+		onlBgGive();
+		onlBgGive();                                   // Given again on the way out
+		sched_yield();                                 // Until the next drain
+	}
+	return NULL;
+}
+
+static void raceRun(void) {
+	const char *pcScenario = "background senders racing";
+	pthread_t tzThr[SENDERS];
+	int i, iBefore = iFail;
+
+	iTaken = 0;
+	for (i = 0; i < SENDERS; i++)
+		pthread_create(&tzThr[i], NULL, senderTask, (void *)(long)(i + 1));
+	for (i = 0; i < SENDERS; i++)
+		pthread_join(tzThr[i], NULL);
+
+	printf("  %-36s %d takes of %d, %d with two senders in the link\n",
+			pcScenario, iTaken, SENDERS * iTakes, iFail - iBefore);
+	if (iFail != iBefore)
+		iFail = 1;
+	expect(pcScenario, "link free afterwards", takeAs(1), 1);
+	giveAs(1);
+	if (iTaken == 0)
+		expect(pcScenario, "takes", iTaken, SENDERS * iTakes);
+}
+
+static void giveRun(void) {
+	const char *pcScenario = "give by a task not holding the link";
+
+	expect(pcScenario, "task 1 takes", takeAs(1), 1);
+	giveAs(2);                                         // Its own take failed
+	expect(pcScenario, "task 3 takes while task 1 holds it", takeAs(3), 0);
+	giveAs(1);
+	expect(pcScenario, "task 3 takes once task 1 gave it", takeAs(3), 1);
+	giveAs(3);
+}
+
+static void sessionRun(void) {
+	const char *pcScenario = "foreground session";
+
+	iSession = 1;
+	expect(pcScenario, "take while the session is open", takeAs(1), 0);
+	iSession = 0;
+	iSessionChecks = 0;
+	iSessionAt = 2;                                    // Opens between the two checks of onlBgTake
+	expect(pcScenario, "take while the session opens", takeAs(1), 0);
+	iSessionAt = 0;
+	iSession = 0;
+	expect(pcScenario, "take once the session is closed", takeAs(2), 1);
+	giveAs(2);
+}
+
+static void *holdTask(void *pvArg) {
+	(void)pvArg;
+	if (takeAs(9) > 0) {
+		if (iHoldRecvMs)
+			onlBgExpect(iHoldRecvMs);                  // Request sent, the answer awaited
+		iTaken = 1;
+		usleep(iHoldMs * 1000);
+		iTaken = 2;
+		onlBgGive();
+	}
+	return NULL;
+}
+
+// holdTask started, the foreground waiting once it holds the link. Returns
+// what onlBgWait returned, *pdMs the time it waited.
+static int holdWait(int iHold, int iRecv, pthread_t *pxThr, double *pdMs) {
+	double dBeg;
+	int iRet;
+
+	iHoldMs = iHold;
+	iHoldRecvMs = iRecv;
+	iTaken = 0;
+	pthread_create(pxThr, NULL, holdTask, NULL);
+	while (iTaken == 0)
+		usleep(1000);
+	iTask = 0;                                         // The foreground task
+	dBeg = nowMs();
+	if (dCancelAt > 0)
+		dCancelAt = dBeg + CANCEL_MS;
+	iRet = onlBgWait();
+	*pdMs = nowMs() - dBeg;
+	return iRet;
+}
+
+static void waitRun(void) {
+	const char *pcScenario = "foreground waits";
+	pthread_t xThr;
+	double dBeg, dMs;
+
+	iTask = 0;                                         // The foreground task
+	dBeg = nowMs();
+	expect(pcScenario, "link free", onlBgWait(), 1);
+	dMs = nowMs() - dBeg;
+	expect(pcScenario, "link free: wait under 50 ms", dMs < 50, 1);
+
+	expect(pcScenario, "link given back", holdWait(HOLD_MS, 0, &xThr, &dMs), 1);
+	expect(pcScenario, "wait over once the sender gave it", iTaken, 2);
+	expect(pcScenario, "no wait past the give, 500 ms at most", dMs < HOLD_MS + 500, 1);
+	pthread_join(xThr, NULL);
+	if (iVerbose)
+		printf("  %-36s waited %.0f ms for a %d ms exchange\n", pcScenario, dMs, HOLD_MS);
+	expect(pcScenario, "link free after the wait", takeAs(1), 1);
+	giveAs(1);
+}
+
+// The host of the sender does not answer: the foreground waits for its
+// receive timeout, not for the whole exchange.
+static void boundRun(void) {
+	const char *pcScenario = "foreground waits, host silent";
+	pthread_t xThr;
+	double dMs;
+	int iRet;
+
+	iScreen = 1;
+	iShown = -1;
+	iWaitOver = 0;
+	iRet = holdWait(HOLD_LONG_MS, RECV_MS, &xThr, &dMs);
+	expect(pcScenario, "link still held when the wait is over", iRet, 0);
+	expect(pcScenario, "wait shown on the progress screen", iShown, comStaWait);
+	expect(pcScenario, "wait over logged", iWaitOver, 1);
+	expect(pcScenario, "no wait past the receive timeout", (dMs > RECV_MS + CLOSE_MS - 50) && (dMs < RECV_MS + CLOSE_MS + 300), 1);
+	if (iVerbose || (iRet != 0))
+		printf("  %-36s waited %.0f ms for a %d ms receive timeout and %d ms to hang up\n", pcScenario, dMs, RECV_MS, CLOSE_MS);
+	pthread_join(xThr, NULL);
+	iScreen = 0;
+}
+
+static void cancelRun(void) {
+	const char *pcScenario = "foreground waits, cancelled";
+	pthread_t xThr;
+	double dMs;
+
+	iScreen = 1;
+	dCancelAt = 1;                                     // Set once the wait begins
+	expect(pcScenario, "wait cancelled", holdWait(HOLD_LONG_MS / 2, 0, &xThr, &dMs), -1);
+	expect(pcScenario, "stopped at the cancel key", dMs < CANCEL_MS + SLICE_MS + 100, 1);
+	if (iVerbose)
+		printf("  %-36s waited %.0f ms, cancel after %d ms\n", pcScenario, dMs, CANCEL_MS);
+	dCancelAt = 0;
+	iScreen = 0;
+	pthread_join(xThr, NULL);
+
+	expect(pcScenario, "no cancel without a progress screen", holdWait(HOLD_MS, 0, &xThr, &dMs), 1);
+	pthread_join(xThr, NULL);
+	expect(pcScenario, "link free after the wait", takeAs(1), 1);
+	giveAs(1);
+}
+
+static void usage(void) {
+	fprintf(stderr, "usage: bglinktest [-n takes] [-v]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	int iOpt;
+
+	while ((iOpt = getopt(argc, argv, "n:v")) != -1) {
+		switch (iOpt) {
+		case 'n': iTakes = atoi(optarg); break;
+		case 'v': iVerbose = 1; break;
+		default: usage();
+		}
+	}
+	if (iTakes <= 0)
+		usage();
+
+	raceRun();
+	giveRun();
+	sessionRun();
+	waitRun();
+	boundRun();
+	cancelRun();
+
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/BgLink.c on
+ *  Linux: the OSL semaphores over POSIX ones, a task number for each
+ *  thread, the foreground session flag and the progress screen driven by
+ *  the test, the ticks of the monotonic clock.
+ */
+#ifndef __BGLINKTEST_GLOBALS_H__
+#define __BGLINKTEST_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned long card;            // As on the terminal: (long) of a tick difference gives its sign
+typedef void *T_GL_HWIDGET;
+
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+
+typedef void *T_OSL_HSEMAPHORE;
+enum { OSL_SUCCESS = 0, OSL_OPEN_CREATE = 1, OSL_SECURITY_LOCAL = 0, OSL_TIMEOUT_INFINITE = -1 };
+
+T_OSL_HSEMAPHORE OSL_Semaphore_Create(const char *pcName, unsigned int uiUnits, int iMode, int iSecurity);
+int OSL_Semaphore_Acquire(T_OSL_HSEMAPHORE hSem, int iTmo);
+int OSL_Semaphore_Release(T_OSL_HSEMAPHORE hSem);
+
+word Telium_CurrentTask(void);
+int isApp_Already_in_Session(void);
+card GTL_StdTimer_GetCurrent(void);
+
+enum { comStaBuild, comStaWait, comStaAttach, comStaConnect, comStaSend, comStaRecv, comStaEnd };
+T_GL_HWIDGET comStaScreen(void);
+void comStaShow(int iSta);
+int comStaCancel(T_GL_HWIDGET hScreen);
+
+int onlBgTake(void);
+void onlBgGive(void);
+void onlBgExpect(card ulTmo);
+int onlBgWait(void);
+
+#endif
@@ -0,0 +1,255 @@
+/*
+ * frametest.c
+ *
+ *  Drives the length framed reception of the terminal (Src/ComFrame.c)
+ *  through a stub tComRead. The stub host sends its bytes at given times,
+ *  in chunks or one by one, on a clock driven by the test: a read waits
+ *  for the next chunk or for its own timeout, whichever comes first.
+ *  The checks are that comRecvFrame reads no byte past the frame, asks
+ *  for none, writes none past what it returns, and waits neither past
+ *  the last byte nor past its timeout. Timer0 is restarted on every read,
+ *  as the card readers and the file system sharing it do, and must not
+ *  move that timeout.
+ *
+ *  Usage: frametest [-v]
+ */
+#include <unistd.h>
+
+#include <globals.h>
+#include "LinkLayer.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define MSG_DIM         1024           // Buffer given to comRecvFrame
+#define CANARY          0xA5           // Fill of the buffer before a reception
+#define TIMER0_MS       60000          // Delay the stub card reader gives Timer0
+#define CLOCK_MAX       600000         // Test clock the reader fails past: a reception never timing out
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {                       // Stub host behind the reader
+	byte tucDat[2 * MSG_DIM];          // Bytes the host sends
+	int iLen;
+	int iPos;                          // Bytes read so far
+	int iChunk;                        // Bytes given at most by one read
+	long lGap;                         // Time between two chunks (ms)
+	long lNext;                        // Time the next chunk is there (ms)
+	int iFrameEnd;                     // End of the frame being received
+	int iAskedPast;                    // Reads asking for bytes past the frame
+	int iReads;
+} tHost;
+
+typedef struct {
+	const char *pcName;
+	word usBody;                       // Length announced by the header
+	int iBody;                         // Bytes of the body the host sends
+	int iChunk;
+	long lFirst;                       // Time of the first byte (ms)
+	long lGap;
+	byte ucDly;                        // Timeout given to comRecvFrame (s)
+	int iRet;                          // Result expected
+	long lEnd;                         // Time comRecvFrame must return at (ms)
+} tScenario;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static const tScenario tzScenario[] = {
+	// Name                          announced  sent   chunk  first  gap  dly  result                           end
+	{ "whole frame at once",              200,   200,  4096,   150,   0,  30, 202,                              150 },
+	{ "drip fed, one byte per 20 ms",     200,   200,     1,   150,  20,  30, 202,                     150 + 201 * 20 },
+	{ "drip fed past the timeout",        200,   200,     1,   150, 500,   5, LL_ERROR_TIMEOUT,                5000 },
+	{ "host silent after the header",     200,     0,     2,   300,   0,   2, LL_ERROR_TIMEOUT,                2000 },
+	{ "zero length header",                 0,     0,  4096,   150,   0,  30, LL_ERROR_PHYSICAL_FRAMING,         150 },
+	{ "frame longer than the buffer",    5000,   200,  4096,   150,   0,  30, LL_ERROR_OUTPUT_BUFFER_TOO_SHORT,  150 },
+};
+
+static tHost xHost;
+static long lTimerEnd = 0;
+static int iVerbose = 0;
+static int iFail = 0;
+
+long lTstNow = 0;
+
+//****************************************************************************
+//      TERMINAL ENVIRONMENT
+//****************************************************************************
+void ResetPeripherals(unsigned int uiEvents) { (void)uiEvents; }
+void netTimMark(int iStg) { (void)iStg; }
+int comStaCancel(T_GL_HWIDGET hScreen) { (void)hScreen; return 0; }
+
+card GTL_StdTimer_GetCurrent(void) {
+	return (card)(lTstNow / 10);
+}
+
+long TimerStart(byte ucTimerNbr, long lDelay) {
+	(void)ucTimerNbr;
+	lTimerEnd = lTstNow + lDelay;
+	return lDelay;
+}
+
+long TimerGet(byte ucTimerNbr) {
+	(void)ucTimerNbr;
+	return (lTimerEnd > lTstNow) ? lTimerEnd - lTstNow : 0;
+}
+
+int TimerStop(byte ucTimerNbr) {
+	(void)ucTimerNbr;
+	return 0;
+}
+
+int LL_Receive(LL_HANDLE hSession, unsigned int uiLen, void *pvBuf, unsigned int uiTmo) {
+	(void)hSession; (void)uiLen; (void)pvBuf; (void)uiTmo;
+	return 0;
+}
+
+int LL_Send(LL_HANDLE hSession, unsigned int uiLen, const void *pvBuf, unsigned int uiTmo) {
+	(void)hSession; (void)uiLen; (void)pvBuf; (void)uiTmo;
+	return 0;
+}
+
+int LL_GetLastError(LL_HANDLE hSession) {
+	(void)hSession;
+	return LL_ERROR_NOT_CONNECTED;
+}
+
+//****************************************************************************
+//      STUB READER
+//****************************************************************************
+// The tComRead of the test: the next chunk if it comes within lTmo (10ms
+// ticks), else nothing once lTmo is over.
+static int hostRead(void *pvSession, byte *pucDst, word usLen, long lTmo) {
+	tHost *pxHost = (tHost *)pvSession;
+	int iNbr;
+
+	pxHost->iReads++;
+	TimerStart(0, TIMER0_MS);                          // A card reader sharing Timer0
+	if (lTstNow > CLOCK_MAX)
+		return LL_ERROR_NOT_CONNECTED;
+	if (pxHost->iPos + usLen > pxHost->iFrameEnd)
+		pxHost->iAskedPast++;
+	if ((pxHost->iPos >= pxHost->iLen) || (pxHost->lNext > lTstNow + lTmo * 10)) {
+		lTstNow += lTmo * 10;
+		return 0;
+	}
+
+	if (pxHost->lNext > lTstNow)
+		lTstNow = pxHost->lNext;
+	iNbr = pxHost->iLen - pxHost->iPos;
+	if (iNbr > pxHost->iChunk)
+		iNbr = pxHost->iChunk;
+	if (iNbr > usLen)
+		iNbr = usLen;
+	memcpy(pucDst, &pxHost->tucDat[pxHost->iPos], iNbr);
+	pxHost->iPos += iNbr;
+	pxHost->lNext = lTstNow + pxHost->lGap;
+	return iNbr;
+}
+
+// Frame of usBody bytes announced, iBody of them sent, at the end of the
+// host data.
+static int hostFrame(word usBody, int iBody) {
+	int i, iBeg = xHost.iLen;
+
+	xHost.tucDat[xHost.iLen++] = (byte)(usBody >> 8);
+	xHost.tucDat[xHost.iLen++] = (byte)usBody;
+	for (i = 0; i < iBody; i++)
+		xHost.tucDat[xHost.iLen++] = (byte)(iBeg + i);
+	return iBeg;
+}
+
+//****************************************************************************
+//      CHECKS
+//****************************************************************************
+static void fail(const char *pcName, const char *pcWhat, long lGot, long lWant) {
+	printf("  FAIL %s: %s %ld, expected %ld\n", pcName, pcWhat, lGot, lWant);
+	iFail = 1;
+}
+
+// One comRecvFrame of the frame at iBeg, iFrame bytes long as far as the
+// reception may read, with the checks common to every reception.
+static int recvCheck(const char *pcName, int iBeg, int iFrame, byte ucDly, int iRet, long lEnd) {
+	byte tucMsg[MSG_DIM + 16];
+	long lStart = lTstNow;
+	int iGot, iConsumed, i;
+
+	xHost.iFrameEnd = iBeg + iFrame;
+	xHost.iAskedPast = 0;
+	xHost.iReads = 0;
+	memset(tucMsg, CANARY, sizeof(tucMsg));
+	iGot = comRecvFrame(hostRead, &xHost, NULL, tucMsg, MSG_DIM, ucDly);
+	iConsumed = xHost.iPos - iBeg;
+
+	if (iVerbose)
+		printf("  %-32s %5d after %5ld ms, %4d bytes read in %4d reads\n",
+				pcName, iGot, lTstNow - lStart, iConsumed, xHost.iReads);
+	if (iGot != iRet)
+		fail(pcName, "result", iGot, iRet);
+	if ((iRet > 0) && (iConsumed != iRet))             // Overrun: bytes of the next frame taken
+		fail(pcName, "bytes read", iConsumed, iRet);
+	if (xHost.iAskedPast)
+		fail(pcName, "reads asking past the frame", xHost.iAskedPast, 0);
+	if ((iGot > 0) && (memcmp(tucMsg, &xHost.tucDat[iBeg], iGot) != 0))
+		fail(pcName, "frame received differs, first byte", tucMsg[0], xHost.tucDat[iBeg]);
+	for (i = (iGot > 0) ? iGot : iConsumed; i < (int)sizeof(tucMsg); i++) {
+		if (tucMsg[i] != CANARY) {
+			fail(pcName, "byte written past the reception at", i, (iGot > 0) ? iGot : iConsumed);
+			break;
+		}
+	}
+	if (lTstNow - lStart != lEnd)                      // No wait past the last byte or the timeout
+		fail(pcName, "returned after ms", lTstNow - lStart, lEnd);
+	return iGot;
+}
+
+static void scenarioRun(const tScenario *pxSce) {
+	int iBeg, iFrame = lenBCDMsg + pxSce->usBody;
+
+	memset(&xHost, 0, sizeof(xHost));
+	lTstNow = 0;
+	iBeg = hostFrame(pxSce->usBody, pxSce->iBody);
+	xHost.iChunk = pxSce->iChunk;
+	xHost.lGap = pxSce->lGap;
+	xHost.lNext = pxSce->lFirst;
+	if (pxSce->iRet == LL_ERROR_OUTPUT_BUFFER_TOO_SHORT)
+		iFrame = lenBCDMsg;                            // Nothing to read after the header
+	recvCheck(pxSce->pcName, iBeg, iFrame, pxSce->ucDly, pxSce->iRet, pxSce->lEnd);
+}
+
+// Two frames sent at once: each reception takes its own frame only.
+static void backToBackRun(void) {
+	const char *pcName = "two frames back to back";
+	int iFirst, iSecond;
+
+	memset(&xHost, 0, sizeof(xHost));
+	lTstNow = 0;
+	iFirst = hostFrame(300, 300);
+	iSecond = hostFrame(40, 40);
+	xHost.iChunk = 4096;
+	xHost.lNext = 150;
+	recvCheck(pcName, iFirst, 302, 30, 302, 150);
+	recvCheck(pcName, iSecond, 42, 30, 42, 0);
+}
+
+int main(int argc, char **argv) {
+	int iOpt;
+	unsigned int i;
+
+	while ((iOpt = getopt(argc, argv, "v")) != -1) {
+		switch (iOpt) {
+		case 'v': iVerbose = 1; break;
+		default:
+			fprintf(stderr, "usage: frametest [-v]\n");
+			return 2;
+		}
+	}
+
+	for (i = 0; i < sizeof(tzScenario) / sizeof(tzScenario[0]); i++)
+		scenarioRun(&tzScenario[i]);
+	backToBackRun();
+
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail;
+}
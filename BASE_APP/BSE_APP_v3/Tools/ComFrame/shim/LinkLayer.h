@@ -0,0 +1,23 @@
+/*
+ * LinkLayer.h (host shim)
+ *
+ *  The Link Layer calls and error codes Src/ComFrame.c uses. The test
+ *  drives comRecvFrame through its own reader: the calls fail.
+ */
+#ifndef __FRAMETEST_LINKLAYER_H__
+#define __FRAMETEST_LINKLAYER_H__
+
+typedef void *LL_HANDLE;
+
+#define LL_INFINITE                       0xFFFFFFFF
+#define LL_ERROR_OK                       0
+#define LL_ERROR_TIMEOUT                  (-1)
+#define LL_ERROR_OUTPUT_BUFFER_TOO_SHORT  (-2)
+#define LL_ERROR_PHYSICAL_FRAMING         (-3)
+#define LL_ERROR_NOT_CONNECTED            (-4)
+
+int LL_Receive(LL_HANDLE hSession, unsigned int uiLen, void *pvBuf, unsigned int uiTmo);
+int LL_Send(LL_HANDLE hSession, unsigned int uiLen, const void *pvBuf, unsigned int uiTmo);
+int LL_GetLastError(LL_HANDLE hSession);
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/ComFrame.c on
+ *  Linux: the tick counter on a clock driven by the test, Timer0 that
+ *  the stub card reader restarts, the cancel key and the network timing
+ *  marks.
+ */
+#ifndef __FRAMETEST_GLOBALS_H__
+#define __FRAMETEST_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned long card;            // As on the terminal: (long) of a tick difference gives its sign
+typedef void *T_GL_HGRAPHIC_LIB;
+typedef void *T_GL_HWIDGET;
+
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+
+enum { lenBCDMsg = 2 };
+enum { netStgHost, netStgRecv };
+#define KEYBOARD 0x01
+#define TSCREEN  0x02
+
+extern long lTstNow;                   // Test clock (ms)
+
+void ResetPeripherals(unsigned int uiEvents);
+card GTL_StdTimer_GetCurrent(void);
+long TimerStart(byte ucTimerNbr, long lDelay);
+long TimerGet(byte ucTimerNbr);
+int TimerStop(byte ucTimerNbr);
+void netTimMark(int iStg);
+int comStaCancel(T_GL_HWIDGET hScreen);
+
+typedef int (*tComRead)(void *pvSession, byte *pucDst, word usLen, long lTmo);
+int comReadLL(void *pvSession, byte *pucDst, word usLen, long lTmo);
+int comRecvFrame(tComRead pfRead, void *pvSession, T_GL_HWIDGET hScreen, byte *pucMsg, word usLen, byte ucDly);
+int comSendLL(void *pvSession, const byte *pucMsg, word usLen);
+
+#endif
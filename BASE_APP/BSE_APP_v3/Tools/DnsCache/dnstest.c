@@ -0,0 +1,117 @@
+/*
+ * dnstest.c
+ *
+ *  Drives Src/DnsCache.c with a stub resolver and a simulated clock, and
+ *  counts the lookups the cache saves. A day of traffic is played: one
+ *  transaction every few minutes alternating two hosts given by name, the
+ *  background refresh once a minute, and a resolver outage in the middle.
+ *  Without the cache, every connection would do a lookup.
+ *
+ *  The run fails (exit code 1) when:
+ *    - a transaction waits for the resolver once the address of its host is
+ *      known (the background refresh renews it, the outage is ridden on the
+ *      last good address),
+ *    - a transaction gets no address during the outage although one was
+ *      known before it,
+ *    - a refreshed address is not picked up.
+ */
+#include "globals.h"
+
+#define TICK_MIN      (60*100)
+#define DAY_MIN       (24*60)
+#define TXN_EVERY     3                // Minutes between two transactions
+#define OUTAGE_FROM   (10*60)          // Resolver down from 10:00 ...
+#define OUTAGE_TO     (11*60)          // ... to 11:00
+#define RENUMBER_AT   (15*60)          // Primary host moves at 15:00
+
+card ulTstNow = 0;
+
+static int iBgLookups = 0;             // Lookups from the background refresh
+static int iFgLookups = 0;             // Lookups a transaction waited for
+static int iInBg = 0;
+static int iDown = 0;
+static int iRenumbered = 0;
+static int iStale = 0;
+
+int appGet(int iKey, char *pcVal, int iLen) {
+	(void)iKey;
+	strncpy(pcVal, "300", iLen);
+	return 3;
+}
+
+int onlBgTake(void) { iInBg = 1; return 1; }
+void onlBgGive(void) { iInBg = 0; }
+void netTimCharge(int iStg, card ulFrom) { (void)iStg; (void)ulFrom; }
+
+void perflog(const char *pcMsg) {
+	if (strstr(pcMsg, "last good"))
+		iStale++;
+}
+
+int DNS_GetIpAddress(char *pcName, unsigned int *puiAddr, unsigned int uiTimeout) {
+	byte *pucAddr = (byte *)puiAddr;
+
+	(void)uiTimeout;
+	if (iInBg)
+		iBgLookups++;
+	else
+		iFgLookups++;
+	if (iDown)
+		return -1;
+
+	pucAddr[0] = 10;
+	pucAddr[1] = 0;
+	pucAddr[2] = (strcmp(pcName, "primary.acquirer.test") == 0) ? 1 : 2;
+	pucAddr[3] = iRenumbered ? 20 : 10;
+	return 0;
+}
+
+int main(int argc, char **argv) {
+	const char *tpcHost[2] = { "primary.acquirer.test", "secondary.acquirer.test" };
+	char tcIp[lenGprsIpRemote + 1];
+	int iMin, iTxn = 0, iRet, iErr = 0, iVerbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+	int iFgOutside = 0;
+
+	for (iMin = 0; iMin < DAY_MIN; iMin++) {
+		ulTstNow = (card)iMin * TICK_MIN;
+		iDown = (iMin >= OUTAGE_FROM) && (iMin < OUTAGE_TO);
+		iRenumbered = (iMin >= RENUMBER_AT);
+
+		if ((iMin % TXN_EVERY) == 0) {
+			int iFgBefore = iFgLookups;
+
+			ulTstNow += 100;                   // Transactions land between two refresh runs
+			iRet = dnsCacheResolve(tpcHost[iTxn % 2], tcIp, sizeof(tcIp));
+			if (iVerbose)
+				printf("%02d:%02d %-24s %d %s\n", iMin / 60, iMin % 60, tpcHost[iTxn % 2], iRet, tcIp);
+			if ((iRet < 0) && (iTxn >= 2)) {
+				printf("%02d:%02d no address for %s\n", iMin / 60, iMin % 60, tpcHost[iTxn % 2]);
+				iErr++;
+			}
+			if ((iFgLookups > iFgBefore) && (iTxn >= 2))
+				iFgOutside++;
+			iTxn++;
+			ulTstNow -= 100;
+		}
+
+		dnsCacheRefresh();
+		if ((iMin == RENUMBER_AT + 10) && (strcmp(tcIp, "10.0.1.20") != 0) && (strcmp(tcIp, "10.0.2.20") != 0)) {
+			printf("renumbered address not picked up: %s\n", tcIp);
+			iErr++;
+		}
+	}
+
+	if (iFgOutside > 0) {
+		printf("%d transactions waited for the resolver outside the outage\n", iFgOutside);
+		iErr++;
+	}
+
+	printf("transactions              %d\n", iTxn);
+	printf("lookups without cache     %d\n", iTxn);
+	printf("lookups in transactions   %d\n", iFgLookups);
+	printf("lookups in background     %d\n", iBgLookups);
+	printf("lookups saved             %d\n", iTxn - iFgLookups);
+	printf("last good address used    %d\n", iStale);
+	printf("%s\n", iErr ? "FAILED" : "OK");
+	return iErr ? 1 : 0;
+}
@@ -0,0 +1,2 @@
+/* IP_.h (host shim): stub resolver of the test */
+int DNS_GetIpAddress(char *pcName, unsigned int *puiAddr, unsigned int uiTimeout);
@@ -0,0 +1,37 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/DnsCache.c on
+ *  Linux: a clock driven by the test, a stub resolver and the app
+ *  parameter holding the TTL.
+ */
+#ifndef __DNSTEST_GLOBALS_H__
+#define __DNSTEST_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned long card;         // As on the terminal: (long) of a tick difference gives its sign
+
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+#define Telium_Sprintf sprintf
+
+enum { lenGprsIpRemote = 32 };
+enum { appDnsTtl };
+enum { netStgDns = 2 };
+
+extern card ulTstNow;                  // Test clock (10ms ticks)
+#define GTL_StdTimer_GetCurrent() (ulTstNow)
+
+int appGet(int iKey, char *pcVal, int iLen);
+int onlBgTake(void);
+void onlBgGive(void);
+void netTimCharge(int iStg, card ulFrom);
+
+int dnsCacheResolve(const char *pcHost, char *pcIp, word usDim);
+void dnsCacheRefresh(void);
+
+#endif
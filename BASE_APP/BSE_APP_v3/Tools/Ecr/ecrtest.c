@@ -0,0 +1,503 @@
+/*
+ * ecrtest.c
+ *
+ *  Drives the cash register link (Src/Ecr.c) through a pseudo-terminal
+ *  pair: the terminal side runs the code of the terminal on the slave, the
+ *  test plays the register on the master.
+ *  Measures:
+ *    - echo round trip (frame sent -> ACK -> echo back), small frames,
+ *    - throughput with full frames,
+ *    - sale round trip (amount in -> result out), the sale itself taking
+ *      no time, so only the link and the hand-over between the tasks count.
+ *  Checks the protocol: NAK and resend of a corrupted request, result sent
+ *  again when its ACK is lost, a sale asked twice run once, busy and bad
+ *  requests refused, the amount given to the sale unchanged.
+ *  The run fails (exit code 1) when a check fails.
+ */
+#define _GNU_SOURCE
+#include "globals.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STX 0x02
+#define ETX 0x03
+#define ACK 0x06
+#define NAK 0x15
+
+static int iMaster = -1;               // Register side
+static char tcSlave[64];               // Terminal side
+
+static int iFail = 0;
+#define EXPECT(CND, MSG) do { if (!(CND)) { printf("  FAIL %s\n", MSG); iFail++; } } while (0)
+
+//----------------------------------------------------------------------------
+// Terminal environment
+//----------------------------------------------------------------------------
+static pthread_mutex_t xMap = PTHREAD_MUTEX_INITIALIZER;
+static char tzMap[keyEnd][32];
+
+int appGet(word key, void *ptr, word len) {
+	const char *pcVal = (key == appEcrPort) ? "0" : "8N1115200";
+
+	snprintf(ptr, len, "%s", pcVal);
+	return strlen(ptr);
+}
+
+int mapGet(word key, void *ptr, word len) {
+	size_t iLen;
+
+	pthread_mutex_lock(&xMap);
+	iLen = strnlen(tzMap[key], len);
+	memcpy(ptr, tzMap[key], iLen);
+	((char *)ptr)[iLen] = 0;
+	pthread_mutex_unlock(&xMap);
+	return iLen;
+}
+
+int mapPut(word key, const void *ptr, word len) {
+	if (len == 0)                                  // mapPutStr
+		len = strlen(ptr);
+	pthread_mutex_lock(&xMap);
+	if (len >= sizeof(tzMap[key]))
+		len = sizeof(tzMap[key]) - 1;
+	memcpy(tzMap[key], ptr, len);
+	tzMap[key][len] = 0;
+	pthread_mutex_unlock(&xMap);
+	return len;
+}
+
+byte num2dec(char *dec, card num, byte len) {
+	return (byte)sprintf(dec, "%0*u", len, num);
+}
+
+int ComputeTotAmt(void) {
+	char tcAmt[lenAmt + 1];
+
+	mapGet(traAmt, tcAmt, lenAmt);
+	return mapPut(traTotAmt, tcAmt, strlen(tcAmt));
+}
+
+static volatile int iSaleMs = 0;       // Time a sale takes
+static volatile int iSales = 0;        // Sales run
+static volatile int iPrompted = 0;     // Sales that would have asked the amount
+static volatile int iNoMenu = 0;       // Sales run without traMnuItm of the sale
+static char tcSaleAmt[lenAmt + 1];     // Amount of the last sale
+static card ulStan = 0;
+
+int MenuProcessingSelect(word MnuItm) {
+	char tcBuf[32];
+	int iKey;
+
+	mapGet(traTotAmt, tcSaleAmt, lenAmt);
+	if (tcSaleAmt[0] == 0)
+		iPrompted++;
+	mapGet(traMnuItm, tcBuf, sizeof(tcBuf) - 1);
+	if ((MnuItm != mnuSale) || (atoi(tcBuf) != mnuSale))
+		iNoMenu++;
+	if (iSaleMs)
+		usleep(iSaleMs * 1000);
+
+	snprintf(tcBuf, sizeof(tcBuf), "%06u", ++ulStan);
+	mapPut(traSTAN, tcBuf, strlen(tcBuf));
+	snprintf(tcBuf, sizeof(tcBuf), "A%05u", ulStan);
+	mapPut(traAutCod, tcBuf, strlen(tcBuf));
+	mapPut(traRspCod, "00", 2);
+	iSales++;
+
+	ecrSaleEnd();
+	for (iKey = 0; iKey < keyEnd; iKey++)              // traReset()
+		mapPut(iKey, "", 0);
+	return 1;
+}
+
+int isApp_Already_in_Session(void) { return 0; }
+void perflog(const char *pcMsg) { (void)pcMsg; }
+
+static __thread word usTask = 0;
+static word usTaskNext = 1;
+
+typedef struct { word (*pfTask)(void); word usNbr; } tTask;
+
+static void *taskRun(void *pvArg) {
+	tTask xTask = *(tTask *)pvArg;
+
+	free(pvArg);
+	usTask = xTask.usNbr;
+	xTask.pfTask();
+	return NULL;
+}
+
+t_topstack *Telium_Fork(word (*pfTask)(void), byte *pucPrm, int iLen) {
+	static t_topstack xTop;
+	tTask *pxTask = malloc(sizeof(*pxTask));
+	pthread_t hThr;
+
+	(void)pucPrm;
+	(void)iLen;
+	pxTask->pfTask = pfTask;
+	pxTask->usNbr = __sync_fetch_and_add(&usTaskNext, 1);
+	if (pthread_create(&hThr, NULL, taskRun, pxTask) != 0)
+		return NULL;
+	pthread_detach(hThr);
+	return &xTop;
+}
+
+word Telium_CurrentTask(void) { return usTask; }
+
+int Telium_Ttestall(int iEvt, int iTmo) {
+	(void)iEvt;
+	usleep(iTmo * 10000);
+	return 0;
+}
+
+static double now(void) {                          // ms
+	struct timespec xTs;
+
+	clock_gettime(CLOCK_MONOTONIC, &xTs);
+	return xTs.tv_sec * 1000.0 + xTs.tv_nsec / 1e6;
+}
+
+card GTL_StdTimer_GetCurrent(void) { return (card)(now() / 10); }
+
+static int fdRead(int iFd, byte *pucDst, int iLen, int iTmoMs) {
+	struct pollfd xPfd = { iFd, POLLIN, 0 };
+	int iRet;
+
+	iRet = poll(&xPfd, 1, iTmoMs);
+	if (iRet <= 0)
+		return iRet;
+	iRet = read(iFd, pucDst, iLen);
+	return (iRet < 0) ? -1 : iRet;
+}
+
+int comReadLL(void *pvSession, byte *pucDst, word usLen, long lTmo) {
+	return fdRead((int)(long)pvSession, pucDst, usLen, lTmo * 10);
+}
+
+int comSendLL(void *pvSession, const byte *pucMsg, word usLen) {
+	int iDone = 0, iRet;
+
+	while (iDone < usLen) {
+		iRet = write((int)(long)pvSession, pucMsg + iDone, usLen - iDone);
+		if (iRet <= 0)
+			return -1;
+		iDone += iRet;
+	}
+	return iDone;
+}
+
+void *comSerialOpen(const char *pcInit, byte ucChn) {
+	struct termios xTio;
+	int iFd = open(tcSlave, O_RDWR | O_NOCTTY);
+
+	(void)pcInit;
+	(void)ucChn;
+	if (iFd < 0)
+		return NULL;
+	tcgetattr(iFd, &xTio);
+	cfmakeraw(&xTio);
+	tcsetattr(iFd, TCSANOW, &xTio);
+	return (void *)(long)iFd;
+}
+
+void comSerialClose(void *pvSession) { close((int)(long)pvSession); }
+void *comUsbOpen(void) { return NULL; }
+
+//----------------------------------------------------------------------------
+// Register
+//----------------------------------------------------------------------------
+static byte lrc(const byte *pucDat, int iLen) {
+	byte ucLrc = 0;
+
+	while (iLen--)
+		ucLrc ^= *pucDat++;
+	return ucLrc;
+}
+
+static void regWrite(const byte *pucDat, int iLen) {
+	if (write(iMaster, pucDat, iLen) != iLen) {
+		perror("write");
+		exit(2);
+	}
+}
+
+static void regFrame(const char *pcDat, int iLen, int iCorrupt) {
+	byte tucFrm[300];
+
+	tucFrm[0] = STX;
+	tucFrm[1] = (byte)(iLen >> 8);
+	tucFrm[2] = (byte)iLen;
+	memcpy(&tucFrm[3], pcDat, iLen);
+	tucFrm[3 + iLen] = ETX;
+	tucFrm[4 + iLen] = lrc(&tucFrm[1], iLen + 3) ^ (iCorrupt ? 0x5A : 0);
+	regWrite(tucFrm, iLen + 5);
+}
+
+static void regCtl(byte ucCtl) {
+	regWrite(&ucCtl, 1);
+}
+
+static int regExact(byte *pucDst, int iLen, int iTmoMs) {
+	int iGot = 0, iRet;
+
+	while (iGot < iLen) {
+		iRet = fdRead(iMaster, pucDst + iGot, iLen - iGot, iTmoMs);
+		if (iRet <= 0)
+			return -1;
+		iGot += iRet;
+	}
+	return iGot;
+}
+
+// Next byte: ACK, NAK or the STX of a frame read into pcDat. -1 on timeout.
+static int regNext(char *pcDat, int *piLen, int iTmoMs) {
+	byte tucHdr[2], tucEnd[2], ucChr;
+
+	if (regExact(&ucChr, 1, iTmoMs) < 0)
+		return -1;
+	if (ucChr != STX)
+		return ucChr;
+	if (regExact(tucHdr, 2, 500) < 0)
+		return -1;
+	*piLen = (tucHdr[0] << 8) | tucHdr[1];
+	if ((regExact((byte *)pcDat, *piLen, 500) < 0) || (regExact(tucEnd, 2, 500) < 0))
+		return -1;
+	if (tucEnd[0] != ETX)
+		return -1;
+	ucChr = lrc(tucHdr, 2) ^ lrc((byte *)pcDat, *piLen) ^ ETX;
+	if (ucChr != tucEnd[1])
+		return -1;
+	pcDat[*piLen] = 0;
+	return STX;
+}
+
+// Send a frame until it is acknowledged.
+static int regSend(const char *pcDat, int iLen) {
+	char tcDat[300];
+	int iTry, iRet, iDum;
+
+	for (iTry = 0; iTry < 3; iTry++) {
+		regFrame(pcDat, iLen, 0);
+		iRet = regNext(tcDat, &iDum, 1000);
+		if (iRet == ACK)
+			return 1;
+	}
+	return -1;
+}
+
+// Wait for a frame, acknowledge it.
+static int regRecv(char *pcDat, int iTmoMs) {
+	int iLen = 0, iRet;
+
+	while ((iRet = regNext(pcDat, &iLen, iTmoMs)) != STX) {
+		if (iRet < 0)
+			return -1;
+	}
+	regCtl(ACK);
+	return iLen;
+}
+
+static void regFlush(void) {
+	byte tucBuf[512];
+
+	while (fdRead(iMaster, tucBuf, sizeof(tucBuf), 50) > 0);
+}
+
+static int cmpDbl(const void *pvA, const void *pvB) {
+	double dA = *(const double *)pvA, dB = *(const double *)pvB;
+
+	return (dA > dB) - (dA < dB);
+}
+
+static void report(const char *pcName, double *pdRtt, int iCnt) {
+	qsort(pdRtt, iCnt, sizeof(double), cmpDbl);
+	printf("  %-10s n=%-5d p50 %7.3f ms  p99 %7.3f ms  max %7.3f ms\n", pcName, iCnt,
+			pdRtt[iCnt / 2], pdRtt[(iCnt * 99) / 100], pdRtt[iCnt - 1]);
+}
+
+static void sale(char *pcReq, const char *pcRef, const char *pcAmt) {
+	sprintf(pcReq, "S%-8.8s%012ld", pcRef, atol(pcAmt));
+}
+
+//----------------------------------------------------------------------------
+// Scenarios
+//----------------------------------------------------------------------------
+static void tstEcho(int iCnt) {
+	static double tdRtt[10000];
+	char tcReq[32], tcRsp[300];
+	int iIdx, iLen;
+	double dBeg;
+
+	printf("echo (16 bytes)\n");
+	for (iIdx = 0; iIdx < iCnt; iIdx++) {
+		sprintf(tcReq, "E%015d", iIdx);
+		dBeg = now();
+		EXPECT(regSend(tcReq, 16) > 0, "echo not acknowledged");
+		iLen = regRecv(tcRsp, 1000);
+		tdRtt[iIdx] = now() - dBeg;
+		EXPECT((iLen == 16) && (memcmp(tcReq, tcRsp, 16) == 0), "echo not sent back");
+	}
+	report("rtt", tdRtt, iCnt);
+}
+
+static void tstThroughput(int iCnt) {
+	char tcReq[300], tcRsp[300];
+	int iIdx, iLen, iData = 255;
+	double dBeg, dMs;
+
+	printf("throughput (%d byte frames)\n", iData);
+	memset(tcReq, 'x', sizeof(tcReq));
+	tcReq[0] = 'E';
+	dBeg = now();
+	for (iIdx = 0; iIdx < iCnt; iIdx++) {
+		EXPECT(regSend(tcReq, iData) > 0, "frame not acknowledged");
+		iLen = regRecv(tcRsp, 1000);
+		EXPECT(iLen == iData, "frame not sent back");
+	}
+	dMs = now() - dBeg;
+	printf("  %d frames in %.0f ms: %.0f frames/s, %.0f kB/s each way\n", iCnt, dMs,
+			iCnt * 1000.0 / dMs, iCnt * (iData + 5) / dMs);
+	printf("  wire time of one frame + ACK: %.1f ms at 115200, %.1f ms at 9600\n",
+			(iData + 6) * 10 * 1000.0 / 115200, (iData + 6) * 10 * 1000.0 / 9600);
+}
+
+static void tstSales(int iCnt) {
+	static double tdRtt[10000];
+	char tcReq[32], tcRsp[300], tcRef[9], tcAmt[16];
+	int iIdx, iLen, iBeg = iSales;
+	double dBeg;
+
+	printf("sale (amount in -> result out)\n");
+	for (iIdx = 0; iIdx < iCnt; iIdx++) {
+		sprintf(tcRef, "T%07d", iIdx);
+		sprintf(tcAmt, "%d", 100 + iIdx * 7);
+		sale(tcReq, tcRef, tcAmt);
+		dBeg = now();
+		EXPECT(regSend(tcReq, 21) > 0, "sale not acknowledged");
+		iLen = regRecv(tcRsp, 2000);
+		tdRtt[iIdx] = now() - dBeg;
+		EXPECT((iLen == 35) && (tcRsp[0] == 'R'), "no result");
+		EXPECT(memcmp(&tcRsp[1], tcRef, 8) == 0, "result of another sale");
+		EXPECT(memcmp(&tcRsp[9], "00", 2) == 0, "sale not approved");
+		EXPECT(atol(&tcRsp[23]) == atol(tcAmt), "amount changed");
+		EXPECT(strcmp(tcSaleAmt, tcAmt) == 0, "amount given to the sale changed");
+	}
+	report("rtt", tdRtt, iCnt);
+	EXPECT(iSales - iBeg == iCnt, "sales run");
+	EXPECT(iPrompted == 0, "amount asked at the terminal");
+	EXPECT(iNoMenu == 0, "sale run without its menu item in traMnuItm");
+}
+
+static void tstNak(void) {
+	char tcReq[32], tcRsp[300];
+	int iBeg = iSales, iLen = 0, iRet;
+
+	printf("corrupted request\n");
+	sale(tcReq, "NAK00001", "1500");
+	regFrame(tcReq, 21, 1);
+	iRet = regNext(tcRsp, &iLen, 1000);
+	EXPECT(iRet == NAK, "no NAK");
+	EXPECT(regSend(tcReq, 21) > 0, "resend not acknowledged");
+	iLen = regRecv(tcRsp, 2000);
+	EXPECT((iLen == 35) && (memcmp(&tcRsp[1], "NAK00001", 8) == 0), "no result");
+	EXPECT(iSales - iBeg == 1, "sale run more than once");
+	printf("  NAK, resent, one sale\n");
+}
+
+static void tstLostAck(void) {
+	char tcReq[32], tcRsp[300], tcFirst[300];
+	int iLen = 0, iRet, iCopies = 1;
+	double dBeg, dGap;
+
+	printf("result ACK lost\n");
+	sale(tcReq, "ACK00001", "2500");
+	EXPECT(regSend(tcReq, 21) > 0, "sale not acknowledged");
+	iRet = regNext(tcFirst, &iLen, 2000);                   // Not acknowledged
+	EXPECT(iRet == STX, "no result");
+	dBeg = now();
+	iRet = regNext(tcRsp, &iLen, 3000);
+	dGap = now() - dBeg;
+	EXPECT((iRet == STX) && (strcmp(tcRsp, tcFirst) == 0), "result not sent again");
+	if (iRet == STX)
+		iCopies++;
+	regCtl(ACK);
+	iRet = regNext(tcRsp, &iLen, 1500);
+	EXPECT(iRet < 0, "result sent after its ACK");
+	printf("  %d copies, sent again after %.0f ms\n", iCopies, dGap);
+}
+
+static void tstRepeat(void) {
+	char tcReq[32], tcRsp[300];
+	int iBeg = iSales, iLen;
+
+	printf("sale asked twice\n");
+	sale(tcReq, "REP00001", "3500");
+	EXPECT(regSend(tcReq, 21) > 0, "sale not acknowledged");
+	iLen = regRecv(tcRsp, 2000);
+	EXPECT(iLen == 35, "no result");
+	EXPECT(regSend(tcReq, 21) > 0, "repeat not acknowledged");
+	iLen = regRecv(tcRsp, 2000);
+	EXPECT((iLen == 35) && (memcmp(&tcRsp[1], "REP00001", 8) == 0) && (memcmp(&tcRsp[9], "00", 2) == 0), "result not given again");
+	EXPECT(iSales - iBeg == 1, "sale run twice");
+	printf("  %d sale, result given twice\n", iSales - iBeg);
+}
+
+static void tstBusy(void) {
+	char tcReq[32], tcRsp[300];
+	int iLen;
+
+	printf("busy and bad requests\n");
+	iSaleMs = 300;
+	sale(tcReq, "BSY00001", "4500");
+	EXPECT(regSend(tcReq, 21) > 0, "sale not acknowledged");
+	sale(tcReq, "BSY00002", "4600");
+	EXPECT(regSend(tcReq, 21) > 0, "second sale not acknowledged");
+	iLen = regRecv(tcRsp, 200);
+	EXPECT((iLen == 35) && (memcmp(&tcRsp[1], "BSY00002", 8) == 0) && (memcmp(&tcRsp[9], "XB", 2) == 0), "second sale not refused busy");
+	EXPECT(atol(&tcRsp[23]) == 4600, "busy answer amount");
+	iLen = regRecv(tcRsp, 2000);
+	EXPECT((iLen == 35) && (memcmp(&tcRsp[1], "BSY00001", 8) == 0) && (memcmp(&tcRsp[9], "00", 2) == 0), "first sale result");
+	iSaleMs = 0;
+
+	EXPECT(regSend("S00000001ABCDEFGHIJKL", 21) > 0, "bad sale not acknowledged");
+	iLen = regRecv(tcRsp, 500);
+	EXPECT((iLen == 35) && (memcmp(&tcRsp[9], "XF", 2) == 0), "bad amount not refused");
+	EXPECT(regSend("S0000", 5) > 0, "short sale not acknowledged");
+	iLen = regRecv(tcRsp, 500);
+	EXPECT((iLen == 35) && (memcmp(&tcRsp[9], "XF", 2) == 0), "short request not refused");
+	printf("  busy and bad requests refused\n");
+}
+
+int main(int argc, char **argv) {
+	struct termios xTio;
+	int iCnt = (argc > 1) ? atoi(argv[1]) : 2000;
+
+	iMaster = posix_openpt(O_RDWR | O_NOCTTY);
+	if ((iMaster < 0) || (grantpt(iMaster) < 0) || (unlockpt(iMaster) < 0)) {
+		perror("pty");
+		return 2;
+	}
+	snprintf(tcSlave, sizeof(tcSlave), "%s", ptsname(iMaster));
+	tcgetattr(iMaster, &xTio);
+	cfmakeraw(&xTio);
+	tcsetattr(iMaster, TCSANOW, &xTio);
+
+	ecrStart();
+	usleep(100 * 1000);
+
+	tstEcho(iCnt);
+	tstThroughput(iCnt / 2);
+	tstSales(iCnt / 4);
+	tstNak();
+	tstLostAck();
+	tstRepeat();
+	tstBusy();
+	regFlush();
+
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail ? 1 : 0;
+}
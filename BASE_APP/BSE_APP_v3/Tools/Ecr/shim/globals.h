@@ -0,0 +1,54 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/Ecr.c on Linux.
+ *  Tasks are threads, the port is one side of a pseudo-terminal pair and
+ *  the sale is simulated by ecrtest.c.
+ */
+#ifndef __ECRTEST_GLOBALS_H__
+#define __ECRTEST_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int card;
+
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+
+enum { lenAmt = 12, lenTotAmt = 16, lenSTAN = 6, lenAutCod = 6, lenRspCod = 3, lenSerialInit = 16, lenMnu = 4 };
+
+enum {                                     // Keys used by Ecr.c
+	appEcrPort, appEcrInit,
+	traAmt, traTotAmt, traRspCod, traSTAN, traAutCod, traMnuItm,
+	keyEnd
+};
+enum { mnuSale = 1 };
+
+int appGet(word key, void *ptr, word len);
+int mapGet(word key, void *ptr, word len);
+int mapPut(word key, const void *ptr, word len);
+#define mapPutStr(KEY,SRC) mapPut(KEY,SRC,0)
+byte num2dec(char *dec, card num, byte len);
+int ComputeTotAmt(void);
+int MenuProcessingSelect(word MnuItm);
+int isApp_Already_in_Session(void);
+
+typedef struct { int dummy; } t_topstack;
+t_topstack *Telium_Fork(word (*pfTask)(void), byte *pucPrm, int iLen);
+word Telium_CurrentTask(void);
+int Telium_Ttestall(int iEvt, int iTmo);
+card GTL_StdTimer_GetCurrent(void);
+
+int comReadLL(void *pvSession, byte *pucDst, word usLen, long lTmo);
+int comSendLL(void *pvSession, const byte *pucMsg, word usLen);
+void *comSerialOpen(const char *pcInit, byte ucChn);
+void comSerialClose(void *pvSession);
+void *comUsbOpen(void);
+
+void ecrStart(void);
+void ecrSaleEnd(void);
+
+#endif
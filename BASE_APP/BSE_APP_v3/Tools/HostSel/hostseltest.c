@@ -0,0 +1,329 @@
+/*
+ * hostseltest.c
+ *
+ *  Drives the host selection of the terminal (Src/HostSel.c) against two
+ *  mock hosts. The primary one refuses the connections, the secondary one
+ *  answers slowly. Each exchange dials as ComGPRS.c does: the best host
+ *  not tried yet, the next one when the connection fails. The clock of
+ *  the back-off is simulated, the round trips are real.
+ *
+ *  Usage: hostseltest [-m mockhost] [-p port] [-v]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <globals.h>
+#include "isomsg.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define TICK_S          100            // 10ms ticks per second
+#define BACKOFF_MIN     (30*TICK_S)    // HOST_BACKOFF_MIN of HostSel.c
+#define SLOW_DELAY      "200,300"      // Processing time of the slow host (ms)
+#define RCV_TMO         3000           // Receive timeout (ms)
+#define BACKOFF_TXNS    5              // Exchanges made while the primary is parked
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	const char *pcMock;                // Mock host program
+	int iPort;                         // Port of the primary, the secondary is the next one
+	int iVerbose;
+} tCfg;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tCfg xCfg = { "../MockHost/mockhost", 5000, 0 };
+static char tcPort[2][lenGprsPort + 1];
+static char tcDials[16];               // Hosts dialled by the last exchange, in order
+static card ulRtt;                     // Round trip of the last answer (ms)
+static int iStan = 0;
+static int iFail = 0;
+
+card ulTstNow = 0;
+
+//****************************************************************************
+//      TERMINAL ENVIRONMENT
+//****************************************************************************
+int appGet(int iKey, char *pcVal, int iLen) {
+	const char *pcSrc = (iKey == appHostIpSecondary) ? "127.0.0.1" : tcPort[1];
+
+	strncpy(pcVal, pcSrc, iLen);
+	return strlen(pcVal);
+}
+
+int dnsCacheResolve(const char *pcHost, char *pcIp, word usDim) {
+	(void)pcHost;
+	(void)pcIp;
+	(void)usDim;
+	return -1;                         // Addresses given as such
+}
+
+void perflog(const char *pcMsg) {
+	if (xCfg.iVerbose)
+		printf("    %s\n", pcMsg);
+}
+
+//****************************************************************************
+//      MOCK HOSTS
+//****************************************************************************
+static double nowMs(void) {
+	struct timespec xTs;
+
+	clock_gettime(CLOCK_MONOTONIC, &xTs);
+	return xTs.tv_sec * 1000.0 + xTs.tv_nsec / 1000000.0;
+}
+
+static int sockOpen(const char *pcIp, const char *pcPort) {
+	struct sockaddr_in xAdr;
+	struct timeval xTv;
+	int iSock, iOne = 1;
+
+	memset(&xAdr, 0, sizeof(xAdr));
+	xAdr.sin_family = AF_INET;
+	xAdr.sin_port = htons((unsigned short)atoi(pcPort));
+	if (inet_pton(AF_INET, pcIp, &xAdr.sin_addr) != 1)
+		return -1;
+	iSock = socket(AF_INET, SOCK_STREAM, 0);
+	if (iSock < 0)
+		return -1;
+	if (connect(iSock, (struct sockaddr *)&xAdr, sizeof(xAdr)) < 0) {
+		close(iSock);
+		return -1;
+	}
+	setsockopt(iSock, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof(iOne));
+	xTv.tv_sec = RCV_TMO / 1000;
+	xTv.tv_usec = (RCV_TMO % 1000) * 1000;
+	setsockopt(iSock, SOL_SOCKET, SO_RCVTIMEO, &xTv, sizeof(xTv));
+	return iSock;
+}
+
+// Mock host on the given port, once it takes connections.
+static pid_t mockStart(int iHost, const char *pcDelay) {
+	pid_t xPid;
+	int iTry, iSock, iNull;
+
+	xPid = fork();
+	if (xPid < 0)
+		return -1;
+	if (xPid == 0) {
+		if (!xCfg.iVerbose) {
+			iNull = open("/dev/null", O_WRONLY);
+			dup2(iNull, STDOUT_FILENO);
+			dup2(iNull, STDERR_FILENO);
+		}
+		execl(xCfg.pcMock, xCfg.pcMock, "-p", tcPort[iHost], "-d", pcDelay, (char *)NULL);
+		_exit(127);
+	}
+
+	for (iTry = 0; iTry < 200; iTry++) {
+		iSock = sockOpen("127.0.0.1", tcPort[iHost]);
+		if (iSock >= 0) {
+			close(iSock);
+			return xPid;
+		}
+		if (waitpid(xPid, NULL, WNOHANG) == xPid)
+			break;
+		usleep(10000);
+	}
+	fprintf(stderr, "%s does not take connections on port %s\n", xCfg.pcMock, tcPort[iHost]);
+	kill(xPid, SIGKILL);
+	waitpid(xPid, NULL, 0);
+	return -1;
+}
+
+static void mockStop(pid_t xPid) {
+	if (xPid <= 0)
+		return;
+	kill(xPid, SIGINT);
+	waitpid(xPid, NULL, 0);
+}
+
+// Echo test on an open connection, as EchoSched.c sends it.
+static int echoRun(int iSock) {
+	static const byte tucTpdu[ISO_TPDU_LEN] = { 0x60, 0x00, 0x01, 0x00, 0x00 };
+	static tIsoMsg xMsg;
+	byte tucTpduRsp[ISO_TPDU_LEN], tucIso[ISO_MSG_MAX];
+	char tcStan[16], tcRsp[6 + 1];
+	int iLen;
+
+	sprintf(tcStan, "%06d", ++iStan);
+	isoInit(&xMsg, "0800");
+	isoSetNum(&xMsg, isoPrcCod, "990000");
+	isoSetNum(&xMsg, isoSTAN, tcStan);
+	isoSetNum(&xMsg, isoNII, "001");
+	isoSetAsc(&xMsg, isoTid, "HOSTSEL1");
+	iLen = isoPack(&xMsg, tucIso, sizeof(tucIso));
+	CHECK(iLen > 0, lblKO);
+	CHECK(frmWrite(iSock, tucTpdu, tucIso, iLen) >= 0, lblKO);
+
+	iLen = frmRead(iSock, tucTpduRsp, tucIso, sizeof(tucIso));
+	CHECK(iLen > 0, lblKO);
+	CHECK(isoUnpack(&xMsg, isoDirRsp, tucIso, iLen) >= 0, lblKO);
+	CHECK((xMsg.tucMti[0] == 0x08) && (xMsg.tucMti[1] == 0x10), lblKO);
+	CHECK(isoGetNum(&xMsg, isoSTAN, tcRsp, sizeof(tcRsp)) >= 0, lblKO);
+	CHECK(strcmp(tcStan, tcRsp) == 0, lblKO);
+	return 1;
+
+	lblKO:
+	return -1;
+}
+
+//****************************************************************************
+//      EXCHANGES
+//****************************************************************************
+// One exchange as ComGPRS.c makes it: a refused connection fails over to
+// the next host, a missing answer does not. Returns the host that answered.
+static int exchange(void) {
+	char tcIp[lenGprsIpRemote + 1], tcHostPort[lenGprsPort + 1];
+	byte ucTried = 0;
+	double dBeg;
+	int iHost, iSock, iRet;
+
+	memset(tcDials, 0, sizeof(tcDials));
+	hostSelLoad("127.0.0.1", tcPort[0]);
+
+	lblNextHost:
+	iHost = hostSelPick(&ucTried, tcIp, tcHostPort);
+	CHECK(iHost >= 0, lblKO);
+	tcDials[strlen(tcDials)] = (char)('0' + iHost);
+	iSock = sockOpen(tcIp, tcHostPort);
+	if (iSock < 0) {                                   // Host side failure, try the next one
+		hostSelFail(iHost);
+		goto lblNextHost;
+	}
+
+	dBeg = nowMs();
+	iRet = echoRun(iSock);
+	close(iSock);
+	if (iRet < 0) {                                    // Request already sent, no failover
+		hostSelFail(iHost);
+		goto lblKO;
+	}
+	ulRtt = (card)(nowMs() - dBeg);
+	hostSelOk(iHost, ulRtt);
+	return iHost;
+
+	lblKO:
+	return -1;
+}
+
+// The background echo of EchoSched.c: a host due for a re-probe is dialled
+// first.
+static int echoProbe(void) {
+	int iProbe, iRet;
+
+	iProbe = hostSelProbeDue();
+	if (iProbe >= 0)
+		hostSelForce(iProbe);
+	iRet = exchange();
+	hostSelForce(-1);
+	return iRet;
+}
+
+static void expect(const char *pcScenario, const char *pcDials, int iAnswer, int iGot) {
+	const char *pcOk = ((strcmp(tcDials, pcDials) == 0) && (iGot == iAnswer)) ? "" : "  FAIL";
+
+	printf("  %-36s dialled %-3s answered by %2d, expected %-3s and %2d%s\n",
+			pcScenario, tcDials, iGot, pcDials, iAnswer, pcOk);
+	if (*pcOk)
+		iFail = 1;
+}
+
+static void expectProbe(const char *pcWhen, int iProbe) {
+	int iGot = hostSelProbeDue();
+
+	if (iGot == iProbe)
+		return;
+	printf("  FAIL %s: host due for a re-probe %d, expected %d\n", pcWhen, iGot, iProbe);
+	iFail = 1;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+			"hostseltest [-m mockhost] [-p port] [-v]\n"
+			"  starts the mock hosts on port and port+1\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	pid_t xPrimary = -1, xSecondary;
+	card ulFailAt;
+	int iOpt, i, iRet;
+
+	while ((iOpt = getopt(argc, argv, "m:p:v")) != -1) {
+		switch (iOpt) {
+		case 'm': xCfg.pcMock = optarg; break;
+		case 'p': xCfg.iPort = atoi(optarg); break;
+		case 'v': xCfg.iVerbose = 1; break;
+		default: usage();
+		}
+	}
+	if ((xCfg.iPort <= 0) || (xCfg.iPort >= 65535))
+		usage();
+	sprintf(tcPort[0], "%d", xCfg.iPort);
+	sprintf(tcPort[1], "%d", xCfg.iPort + 1);
+
+	xSecondary = mockStart(1, SLOW_DELAY);
+	if (xSecondary < 0)
+		return 2;
+	printf("primary on port %s refusing, secondary on port %s answering in %s ms\n",
+			tcPort[0], tcPort[1], SLOW_DELAY);
+
+	iRet = exchange();                                 // Clock 0: nothing known yet
+	expect("primary refused", "01", 1, iRet);
+	ulFailAt = ulTstNow;
+	printf("  slow host round trip %lu ms\n", ulRtt);
+
+	for (i = 1; i <= BACKOFF_TXNS; i++) {              // Primary parked: not dialled
+		ulTstNow = ulFailAt + (card)i * (BACKOFF_MIN / (BACKOFF_TXNS + 1));
+		iRet = exchange();
+		expect("primary in back-off", "1", 1, iRet);
+	}
+	expectProbe("before the back-off is over", -1);
+
+	ulTstNow = ulFailAt + BACKOFF_MIN;                 // Back-off over, the failure still counts
+	expectProbe("once the back-off is over", 0);
+	iRet = exchange();
+	expect("back-off over, transaction", "1", 1, iRet);
+
+	iRet = echoProbe();
+	expect("re-probe, primary still refused", "01", 1, iRet);
+	ulFailAt = ulTstNow;
+	ulTstNow = ulFailAt + 2 * BACKOFF_MIN - 1;         // Second failure: back-off doubled
+	expectProbe("before the doubled back-off is over", -1);
+	iRet = exchange();
+	expect("primary in doubled back-off", "1", 1, iRet);
+
+	xPrimary = mockStart(0, "0");
+	if (xPrimary < 0) {
+		mockStop(xSecondary);
+		return 2;
+	}
+	ulTstNow = ulFailAt + 2 * BACKOFF_MIN;
+	expectProbe("once the doubled back-off is over", 0);
+	iRet = echoProbe();
+	expect("re-probe, primary back", "0", 0, iRet);
+	expectProbe("after the primary answered", -1);
+
+	iRet = exchange();                                 // Faster than the slow secondary
+	expect("primary preferred again", "0", 0, iRet);
+
+	mockStop(xPrimary);
+	mockStop(xSecondary);
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail;
+}
@@ -0,0 +1,42 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/HostSel.c on
+ *  Linux: a clock driven by the test, the app parameters holding the
+ *  secondary host and the field formats of Src/iso8583.c for the echo
+ *  tests sent to the mock hosts.
+ */
+#ifndef __HOSTSELTEST_GLOBALS_H__
+#define __HOSTSELTEST_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned long card;         // As on the terminal: (long) of a tick difference gives its sign
+
+#define VERIFY(C) assert(C)
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+
+#include "iso8583.h"
+
+enum { lenGprsIpRemote = 32, lenGprsPort = 12 };
+enum { appHostIpSecondary, appHostPortSecondary };
+
+extern card ulTstNow;                  // Test clock (10ms ticks)
+#define GTL_StdTimer_GetCurrent() (ulTstNow)
+
+int appGet(int iKey, char *pcVal, int iLen);
+int dnsCacheResolve(const char *pcHost, char *pcIp, word usDim);
+
+int hostSelLoad(const char *pcIp, const char *pcPort);
+int hostSelPick(byte *pucTried, char *pcIp, char *pcPort);
+void hostSelOk(int iIdx, card ulRtt);
+void hostSelFail(int iIdx);
+int hostSelProbeDue(void);
+void hostSelForce(int iIdx);
+
+#endif
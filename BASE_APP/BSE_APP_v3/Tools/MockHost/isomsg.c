@@ -0,0 +1,370 @@
+/*
+ * isomsg.c
+ *
+ *  ISO8583 codec and length framing of the terminal dialect, host side.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "isomsg.h"
+
+//****************************************************************************
+//      PRIVATE FUNCTIONS
+//****************************************************************************
+static int bitGet(const byte *pucMap, byte ucBit) {
+	return (pucMap[(ucBit - 1) / 8] & (0x80 >> ((ucBit - 1) % 8))) != 0;
+}
+
+static void bitSet(byte *pucMap, byte ucBit) {
+	pucMap[(ucBit - 1) / 8] |= (byte)(0x80 >> ((ucBit - 1) % 8));
+}
+
+static int isRaw(byte ucBit, int iDir) {   // Fixed fields sent as is (req.c getLen_, rsp.c rspGetLen_)
+	switch (ucBit) {
+	case 37: case 38: case 39: case 41:
+	case 42: case 43: case 53:
+		return 1;
+	case 52:
+		return iDir == isoDirReq;
+	default:
+		return 0;
+	}
+}
+
+static int isNibble(byte ucBit, int iDir) { // LLVAR fields whose length counts digits
+	switch (ucBit) {
+	case 2: case 35:
+		return 1;
+	case 32:
+		return iDir == isoDirRsp;
+	default:
+		return 0;
+	}
+}
+
+static int pfxLen(int iFmt) {              // LLBCD: 1 byte, LLLBCD: 2 bytes
+	return (-iFmt <= 2) ? 1 : 2;
+}
+
+static int fixLen(byte ucBit, int iDir) {
+	int iFmt = isoFmt(ucBit);
+
+	return isRaw(ucBit, iDir) ? iFmt : (iFmt + 1) / 2;
+}
+
+static byte nibble(char cDig) {
+	if ((cDig >= '0') && (cDig <= '9'))
+		return (byte)(cDig - '0');
+	if ((cDig >= 'A') && (cDig <= 'F'))
+		return (byte)(cDig - 'A' + 10);
+	if ((cDig >= 'a') && (cDig <= 'f'))
+		return (byte)(cDig - 'a' + 10);
+	if (cDig == '=')                       // Track 2 separator
+		return 0x0D;
+	return 0x0F;
+}
+
+static void bcdPack(byte *pucDst, const char *pcDig, int iNbr) {  // Left aligned, F padded
+	int iIdx;
+
+	memset(pucDst, 0, (iNbr + 1) / 2);
+	for (iIdx=0; iIdx<iNbr; iIdx++)
+		pucDst[iIdx / 2] |= (byte)(nibble(pcDig[iIdx]) << ((iIdx & 1) ? 0 : 4));
+	if (iNbr & 1)
+		pucDst[iNbr / 2] |= 0x0F;
+}
+
+static byte *valAlloc(tIsoMsg *pxMsg, byte ucBit, word usLen) {
+	byte *pucVal;
+
+	if (pxMsg->usUsed + usLen > sizeof(pxMsg->tucBuf))
+		return NULL;
+	pucVal = &pxMsg->tucBuf[pxMsg->usUsed];
+	pxMsg->usUsed += usLen;
+	pxMsg->tpucVal[ucBit] = pucVal;
+	pxMsg->tusLen[ucBit] = usLen;
+	bitSet(pxMsg->tucBitmap, ucBit);
+	if (ucBit > 64)
+		bitSet(pxMsg->tucBitmap, 1);
+	return pucVal;
+}
+
+//****************************************************************************
+//      MESSAGE BUILDING
+//****************************************************************************
+void isoInit(tIsoMsg *pxMsg, const char *pcMti) {
+	memset(pxMsg, 0, sizeof(*pxMsg));
+	bcdPack(pxMsg->tucMti, pcMti, 4);
+}
+
+int isoHas(const tIsoMsg *pxMsg, byte ucBit) {
+	return (ucBit >= 2) && (ucBit <= 128) && (pxMsg->tpucVal[ucBit] != NULL);
+}
+
+// Numeric value: BCD right aligned on fixed fields, digits on LLVAR nibble
+// fields, characters on raw and other LLVAR fields.
+int isoSetNum(tIsoMsg *pxMsg, byte ucBit, const char *pcDigits) {
+	char tcPad[256 + 1];
+	int iFmt = isoFmt(ucBit), iLen = (int)strlen(pcDigits);
+	byte *pucVal;
+
+	if (iFmt < 0) {
+		if (!isNibble(ucBit, isoDirReq))
+			return isoSetAsc(pxMsg, ucBit, pcDigits);
+		pucVal = valAlloc(pxMsg, ucBit, (word)((iLen + 1) / 2));
+		if (pucVal == NULL)
+			return -1;
+		bcdPack(pucVal, pcDigits, iLen);
+		pxMsg->tusVarLen[ucBit] = (word)iLen;
+		return 0;
+	}
+
+	if (isRaw(ucBit, isoDirReq) || isRaw(ucBit, isoDirRsp))
+		return isoSetAsc(pxMsg, ucBit, pcDigits);
+
+	if ((iLen > iFmt) || (iFmt > 256))
+		return -1;
+	memset(tcPad, '0', iFmt - iLen);       // Right aligned, zero filled
+	strcpy(tcPad + iFmt - iLen, pcDigits);
+	if (iFmt & 1) {                        // Odd number of digits: leading zero nibble
+		memmove(tcPad + 1, tcPad, iFmt + 1);
+		tcPad[0] = '0';
+		iFmt++;
+	}
+	pucVal = valAlloc(pxMsg, ucBit, (word)(iFmt / 2));
+	if (pucVal == NULL)
+		return -1;
+	bcdPack(pucVal, tcPad, iFmt);
+	return 0;
+}
+
+int isoSetAsc(tIsoMsg *pxMsg, byte ucBit, const char *pcTxt) {
+	int iFmt = isoFmt(ucBit), iLen = (int)strlen(pcTxt);
+	byte *pucVal;
+
+	if (iFmt < 0)
+		return isoSetBin(pxMsg, ucBit, (const byte *)pcTxt, (word)iLen);
+
+	if (iLen > iFmt)
+		iLen = iFmt;
+	pucVal = valAlloc(pxMsg, ucBit, (word)iFmt);
+	if (pucVal == NULL)
+		return -1;
+	memset(pucVal, ' ', iFmt);             // Left aligned, space filled
+	memcpy(pucVal, pcTxt, iLen);
+	return 0;
+}
+
+int isoSetBin(tIsoMsg *pxMsg, byte ucBit, const byte *pucVal, word usLen) {
+	byte *pucDst;
+
+	if ((isoFmt(ucBit) > 0) && (usLen != fixLen(ucBit, isoDirReq)))
+		return -1;
+	pucDst = valAlloc(pxMsg, ucBit, usLen);
+	if (pucDst == NULL)
+		return -1;
+	memcpy(pucDst, pucVal, usLen);
+	pxMsg->tusVarLen[ucBit] = usLen;
+	return 0;
+}
+
+// Value as a string: BCD is expanded to digits, raw data copied as is.
+int isoGetNum(const tIsoMsg *pxMsg, byte ucBit, char *pcDigits, int iDim) {
+	static const char tcHex[] = "0123456789ABCDEF";
+	int iIdx, iNbr, iFmt;
+	const byte *pucVal;
+
+	*pcDigits = 0;
+	if (!isoHas(pxMsg, ucBit))
+		return -1;
+
+	iFmt = isoFmt(ucBit);
+	pucVal = pxMsg->tpucVal[ucBit];
+	if ((iFmt > 0) && isRaw(ucBit, isoDirReq) && (pxMsg->tusLen[ucBit] == (word)iFmt)) {  // Raw field
+		iNbr = (pxMsg->tusLen[ucBit] < iDim) ? pxMsg->tusLen[ucBit] : iDim - 1;
+		memcpy(pcDigits, pucVal, iNbr);
+		pcDigits[iNbr] = 0;
+		return iNbr;
+	}
+	if ((iFmt < 0) && (pxMsg->tusVarLen[ucBit] == pxMsg->tusLen[ucBit])) {  // Byte counted LLVAR
+		iNbr = (pxMsg->tusLen[ucBit] < iDim) ? pxMsg->tusLen[ucBit] : iDim - 1;
+		memcpy(pcDigits, pucVal, iNbr);
+		pcDigits[iNbr] = 0;
+		return iNbr;
+	}
+
+	iNbr = (iFmt < 0) ? pxMsg->tusVarLen[ucBit] : pxMsg->tusLen[ucBit] * 2;
+	if (iNbr >= iDim)
+		iNbr = iDim - 1;
+	for (iIdx=0; iIdx<iNbr; iIdx++)
+		pcDigits[iIdx] = tcHex[(pucVal[iIdx / 2] >> ((iIdx & 1) ? 0 : 4)) & 0x0F];
+	pcDigits[iNbr] = 0;
+	return iNbr;
+}
+
+//****************************************************************************
+//      WIRE FORMAT
+//****************************************************************************
+int isoPack(const tIsoMsg *pxMsg, byte *pucDst, int iDim) {
+	char tcPfx[8 + 1];
+	byte tucPfx[2];
+	int iMap, iPos, iFmt, iPfx;
+	byte ucBit;
+
+	iMap = bitGet(pxMsg->tucBitmap, 1) ? 16 : 8;
+	if (iDim < 2 + iMap)
+		return -1;
+	memcpy(pucDst, pxMsg->tucMti, 2);
+	memcpy(pucDst + 2, pxMsg->tucBitmap, iMap);
+	iPos = 2 + iMap;
+
+	for (ucBit=2; ucBit<=iMap*8; ucBit++) {
+		if (!bitGet(pxMsg->tucBitmap, ucBit))
+			continue;
+		if (pxMsg->tpucVal[ucBit] == NULL)
+			return -1;
+
+		iFmt = isoFmt(ucBit);
+		if (iFmt < 0) {                    // LLVAR / LLLVAR prefix
+			iPfx = pfxLen(iFmt);
+			if (iPos + iPfx > iDim)
+				return -1;
+			sprintf(tcPfx, "%0*u", iPfx * 2, pxMsg->tusVarLen[ucBit]);
+			bcdPack(tucPfx, tcPfx, iPfx * 2);
+			memcpy(pucDst + iPos, tucPfx, iPfx);
+			iPos += iPfx;
+		}
+		if (iPos + pxMsg->tusLen[ucBit] > iDim)
+			return -1;
+		memcpy(pucDst + iPos, pxMsg->tpucVal[ucBit], pxMsg->tusLen[ucBit]);
+		iPos += pxMsg->tusLen[ucBit];
+	}
+	return iPos;
+}
+
+static int bcdNum(const byte *pucSrc, int iBytes) {
+	int iIdx, iVal = 0;
+
+	for (iIdx=0; iIdx<iBytes; iIdx++)
+		iVal = iVal * 100 + (pucSrc[iIdx] >> 4) * 10 + (pucSrc[iIdx] & 0x0F);
+	return iVal;
+}
+
+// Returns the number of bytes parsed, -1 if the message is malformed.
+int isoUnpack(tIsoMsg *pxMsg, int iDir, const byte *pucSrc, int iLen) {
+	int iMap, iPos, iFmt, iPfx, iVar, iVal;
+	byte ucBit;
+
+	memset(pxMsg, 0, sizeof(*pxMsg));
+	if (iLen < 2 + 8)
+		return -1;
+	memcpy(pxMsg->tucMti, pucSrc, 2);
+	iMap = bitGet(pucSrc + 2, 1) ? 16 : 8;
+	if (iLen < 2 + iMap)
+		return -1;
+	memcpy(pxMsg->tucBitmap, pucSrc + 2, iMap);
+	iPos = 2 + iMap;
+
+	for (ucBit=2; ucBit<=iMap*8; ucBit++) {
+		if (!bitGet(pxMsg->tucBitmap, ucBit))
+			continue;
+
+		iFmt = isoFmt(ucBit);
+		iVar = 0;
+		if (iFmt < 0) {
+			iPfx = pfxLen(iFmt);
+			if (iPos + iPfx > iLen)
+				return -1;
+			iVar = bcdNum(pucSrc + iPos, iPfx);
+			iPos += iPfx;
+			iVal = isNibble(ucBit, iDir) ? (iVar + 1) / 2 : iVar;
+		} else
+			iVal = fixLen(ucBit, iDir);
+
+		if (iPos + iVal > iLen)
+			return -1;
+		if (pxMsg->usUsed + iVal > (int)sizeof(pxMsg->tucBuf))
+			return -1;
+		pxMsg->tpucVal[ucBit] = &pxMsg->tucBuf[pxMsg->usUsed];
+		memcpy(pxMsg->tpucVal[ucBit], pucSrc + iPos, iVal);
+		pxMsg->usUsed += iVal;
+		pxMsg->tusLen[ucBit] = (word)iVal;
+		pxMsg->tusVarLen[ucBit] = (word)iVar;
+		iPos += iVal;
+	}
+	return iPos;
+}
+
+//****************************************************************************
+//      FRAMING (2 bytes binary length + TPDU + ISO, see onlSendRaw)
+//****************************************************************************
+int sockReadAll(int iSock, byte *pucDst, int iLen) {
+	int iGot = 0, iRet;
+
+	while (iGot < iLen) {
+		iRet = (int)recv(iSock, pucDst + iGot, iLen - iGot, 0);
+		if (iRet == 0)
+			return iGot;                   // Peer closed
+		if (iRet < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		iGot += iRet;
+	}
+	return iGot;
+}
+
+int sockWriteAll(int iSock, const byte *pucSrc, int iLen) {
+	int iSent = 0, iRet;
+
+	while (iSent < iLen) {
+		iRet = (int)send(iSock, pucSrc + iSent, iLen - iSent, MSG_NOSIGNAL);
+		if (iRet < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		iSent += iRet;
+	}
+	return iSent;
+}
+
+// Returns the ISO length, 0 when the peer closed between frames, -1 on error
+// or timeout, -2 when the frame header is not acceptable.
+int frmRead(int iSock, byte *pucTpdu, byte *pucIso, int iDim) {
+	byte tucHdr[ISO_HDR_LEN];
+	int iLen, iRet;
+
+	iRet = sockReadAll(iSock, tucHdr, ISO_HDR_LEN);
+	if (iRet == 0)
+		return 0;
+	if (iRet != ISO_HDR_LEN)
+		return -1;
+
+	iLen = (tucHdr[0] << 8) | tucHdr[1];
+	if ((iLen < ISO_TPDU_LEN) || (iLen - ISO_TPDU_LEN > iDim))
+		return -2;
+	if (sockReadAll(iSock, pucTpdu, ISO_TPDU_LEN) != ISO_TPDU_LEN)
+		return -1;
+	iLen -= ISO_TPDU_LEN;
+	if (sockReadAll(iSock, pucIso, iLen) != iLen)
+		return -1;
+	return iLen;
+}
+
+int frmWrite(int iSock, const byte *pucTpdu, const byte *pucIso, int iLen) {
+	byte tucFrm[ISO_HDR_LEN + ISO_TPDU_LEN + ISO_MSG_MAX];
+
+	if (iLen > ISO_MSG_MAX)
+		return -1;
+	tucFrm[0] = (byte)((iLen + ISO_TPDU_LEN) >> 8);
+	tucFrm[1] = (byte)(iLen + ISO_TPDU_LEN);
+	memcpy(tucFrm + ISO_HDR_LEN, pucTpdu, ISO_TPDU_LEN);
+	memcpy(tucFrm + ISO_HDR_LEN + ISO_TPDU_LEN, pucIso, iLen);
+	return sockWriteAll(iSock, tucFrm, ISO_HDR_LEN + ISO_TPDU_LEN + iLen);
+}
@@ -0,0 +1,48 @@
+/*
+ * isomsg.h
+ *
+ *  ISO8583 codec of the terminal dialect for the host tools.
+ *  Field formats come from Src/iso8583.c (isoFmt); the length rules mirror
+ *  appFld()/getLen_() in req.c for requests and getFld()/rspGetLen_() in
+ *  rsp.c for responses, which differ on a few fields (2, 32, 35, 52).
+ */
+#ifndef __ISOMSG_H__
+#define __ISOMSG_H__
+
+#include <globals.h>
+
+#define ISO_MSG_MAX   4096                 // Largest message handled
+#define ISO_HDR_LEN   2                    // Binary length header
+#define ISO_TPDU_LEN  5
+
+enum {                                     // Side of the exchange the message belongs to
+	isoDirReq,                             // Terminal -> host (req.c rules)
+	isoDirRsp                              // Host -> terminal (rsp.c rules)
+};
+
+typedef struct {
+	byte tucMti[2];                        // BCD, "0200" -> 02 00
+	byte tucBitmap[16];
+	word tusLen[129];                      // Bytes of the value on the wire
+	word tusVarLen[129];                   // Length announced by a LLVAR/LLLVAR prefix
+	byte *tpucVal[129];                    // Value, points into tucBuf
+	byte tucBuf[ISO_MSG_MAX];
+	word usUsed;
+} tIsoMsg;
+
+void isoInit(tIsoMsg *pxMsg, const char *pcMti);
+int isoSetNum(tIsoMsg *pxMsg, byte ucBit, const char *pcDigits);
+int isoSetAsc(tIsoMsg *pxMsg, byte ucBit, const char *pcTxt);
+int isoSetBin(tIsoMsg *pxMsg, byte ucBit, const byte *pucVal, word usLen);
+int isoGetNum(const tIsoMsg *pxMsg, byte ucBit, char *pcDigits, int iDim);
+int isoHas(const tIsoMsg *pxMsg, byte ucBit);
+
+int isoPack(const tIsoMsg *pxMsg, byte *pucDst, int iDim);
+int isoUnpack(tIsoMsg *pxMsg, int iDir, const byte *pucSrc, int iLen);
+
+int frmRead(int iSock, byte *pucTpdu, byte *pucIso, int iDim);
+int frmWrite(int iSock, const byte *pucTpdu, const byte *pucIso, int iLen);
+int sockReadAll(int iSock, byte *pucDst, int iLen);
+int sockWriteAll(int iSock, const byte *pucSrc, int iLen);
+
+#endif
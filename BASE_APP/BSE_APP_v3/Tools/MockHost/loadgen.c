@@ -0,0 +1,316 @@
+/*
+ * loadgen.c
+ *
+ *  Load generator for the mock acquirer (or any host speaking the terminal
+ *  dialect). Sends sales (0200) and echo tests (0800) built with the same
+ *  field formats as req.c, from several concurrent connections at a given
+ *  rate, and reports throughput, outcomes and latency percentiles.
+ *
+ *  Usage: loadgen [-h host] [-p port] [-c concurrency] [-n total] [-r rate/s]
+ *                 [-t timeoutMs] [-k] [-e echo%] [-a amountCents] [-v]
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "isomsg.h"
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	const char *pcHost;
+	const char *pcPort;
+	int iConc;                             // Concurrent connections
+	int iTotal;                            // Transactions to send
+	int iRate;                             // Transactions per second (0: as fast as possible)
+	int iTimeout;                          // Receive timeout (ms)
+	int iKeep;                             // Keep the connection between transactions
+	int iEcho;                             // % of echo tests in the mix
+	long lAmount;                          // Amount of the sales (cents)
+	int iVerbose;
+} tCfg;
+
+enum {                                     // Outcome of one transaction
+	resApproved,
+	resDeclined,
+	resConnect,                            // Connection refused or failed
+	resSend,
+	resTimeout,
+	resClosed,                             // Host closed before answering
+	resMalformed,                          // Bad frame, unparsable or mismatching answer
+	resEnd
+};
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tCfg xCfg = { "127.0.0.1", "5000", 4, 1000, 0, 5000, 0, 0, 1000, 0 };
+static const char *tzRes[resEnd] = {
+	"approved", "declined", "connect", "send", "timeout", "closed", "malformed"
+};
+static pthread_mutex_t xLock = PTHREAD_MUTEX_INITIALIZER;
+static struct addrinfo *pxAdr = NULL;
+static int iNext = 0;                      // Next transaction to send
+static unsigned long tulRes[resEnd];
+static double *pdLat = NULL;               // Latency of the answered transactions (ms)
+static int iLatNbr = 0;
+static double dStart;
+
+static double nowMs(void) {
+	struct timespec xTs;
+
+	clock_gettime(CLOCK_MONOTONIC, &xTs);
+	return xTs.tv_sec * 1000.0 + xTs.tv_nsec / 1000000.0;
+}
+
+static void msSleep(double dMs) {
+	struct timespec xTs;
+
+	if (dMs <= 0)
+		return;
+	xTs.tv_sec = (time_t)(dMs / 1000);
+	xTs.tv_nsec = (long)((dMs - xTs.tv_sec * 1000.0) * 1000000.0);
+	nanosleep(&xTs, NULL);
+}
+
+static int sockOpen(void) {
+	struct timeval xTv;
+	int iSock, iOne = 1;
+
+	iSock = socket(pxAdr->ai_family, SOCK_STREAM, 0);
+	if (iSock < 0)
+		return -1;
+	if (connect(iSock, pxAdr->ai_addr, pxAdr->ai_addrlen) < 0) {
+		close(iSock);
+		return -1;
+	}
+	setsockopt(iSock, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof(iOne));
+	xTv.tv_sec = xCfg.iTimeout / 1000;
+	xTv.tv_usec = (xCfg.iTimeout % 1000) * 1000;
+	setsockopt(iSock, SOL_SOCKET, SO_RCVTIMEO, &xTv, sizeof(xTv));
+	return iSock;
+}
+
+// Sale or echo test with the fields req.c puts in them.
+static int reqBuild(int iTxn, int iEcho, byte *pucIso, int iDim) {
+	tIsoMsg *pxReq;
+	char tcVal[40 + 1];
+	time_t ulNow = time(NULL);
+	struct tm xTm;
+	int iRet;
+
+	pxReq = malloc(sizeof(*pxReq));
+	if (pxReq == NULL)
+		return -1;
+	localtime_r(&ulNow, &xTm);
+	sprintf(tcVal, "%06d", iTxn % 999999 + 1);
+
+	if (iEcho) {
+		isoInit(pxReq, "0800");
+		isoSetNum(pxReq, isoPrcCod, "990000");
+		isoSetNum(pxReq, isoSTAN, tcVal);
+		isoSetNum(pxReq, isoNII, "001");
+		isoSetAsc(pxReq, isoTid, "LOADGEN1");
+	} else {
+		isoInit(pxReq, "0200");
+		isoSetNum(pxReq, isoPrcCod, "000000");
+		isoSetNum(pxReq, isoSTAN, tcVal);
+		sprintf(tcVal, "%012ld", xCfg.lAmount);
+		isoSetNum(pxReq, isoAmt, tcVal);
+		strftime(tcVal, sizeof(tcVal), "%H%M%S", &xTm);
+		isoSetNum(pxReq, isoTim, tcVal);
+		strftime(tcVal, sizeof(tcVal), "%m%d", &xTm);
+		isoSetNum(pxReq, isoDat, tcVal);
+		isoSetNum(pxReq, isoPosEntMod, "0021");
+		isoSetNum(pxReq, isoNII, "001");
+		isoSetNum(pxReq, isoPosCndCod, "00");
+		isoSetNum(pxReq, isoTrk2, "4761739001010010D25122011143878089");
+		isoSetAsc(pxReq, isoTid, "LOADGEN1");
+		isoSetAsc(pxReq, isoMid, "000000000000001");
+		isoSetNum(pxReq, isoCur, "0504");
+	}
+
+	iRet = isoPack(pxReq, pucIso, iDim);
+	free(pxReq);
+	return iRet;
+}
+
+// One exchange on an open connection; the connection is to be dropped
+// unless the result is an answer.
+static int txnRun(int iSock, int iTxn, int iEcho) {
+	static const byte tucTpdu[ISO_TPDU_LEN] = { 0x60, 0x00, 0x01, 0x00, 0x00 };
+	byte tucTpduRsp[ISO_TPDU_LEN], tucIso[ISO_MSG_MAX];
+	tIsoMsg *pxRsp;
+	char tcRc[2 + 1], tcReq[8 + 1], tcRsp[8 + 1];
+	int iLen, iRes;
+
+	iLen = reqBuild(iTxn, iEcho, tucIso, sizeof(tucIso));
+	if (iLen < 0)
+		return resSend;
+	memcpy(tcReq, tucIso, 2);              // MTI of the request, kept for matching
+	if (frmWrite(iSock, tucTpdu, tucIso, iLen) < 0)
+		return resSend;
+
+	iLen = frmRead(iSock, tucTpduRsp, tucIso, sizeof(tucIso));
+	if (iLen == 0)
+		return resClosed;
+	if (iLen == -1)
+		return (errno == EAGAIN || errno == EWOULDBLOCK) ? resTimeout : resClosed;
+	if (iLen < 0)
+		return resMalformed;
+
+	pxRsp = malloc(sizeof(*pxRsp));
+	if (pxRsp == NULL)
+		return resMalformed;
+	iRes = resMalformed;
+	if (isoUnpack(pxRsp, isoDirRsp, tucIso, iLen) < 0)
+		goto lblEnd;
+	if ((pxRsp->tucMti[0] != (byte)tcReq[0]) || (pxRsp->tucMti[1] != (byte)(tcReq[1] + 0x10)))
+		goto lblEnd;                       // Not the answer of this request
+	sprintf(tcReq, "%06d", iTxn % 999999 + 1);
+	if ((isoGetNum(pxRsp, isoSTAN, tcRsp, sizeof(tcRsp)) < 0) || strcmp(tcReq, tcRsp))
+		goto lblEnd;
+	if (isoGetNum(pxRsp, isoRspCod, tcRc, sizeof(tcRc)) != 2)
+		goto lblEnd;
+	iRes = strcmp(tcRc, "00") ? resDeclined : resApproved;
+	if (xCfg.iVerbose)
+		fprintf(stderr, "txn %d: rc %s\n", iTxn, tcRc);
+
+	lblEnd:
+	free(pxRsp);
+	return iRes;
+}
+
+static void *workTask(void *pvArg) {
+	unsigned int uiSeed = (unsigned int)(long)pvArg ^ (unsigned int)time(NULL);
+	double dBeg, dLat;
+	int iSock = -1, iTxn, iRes, iEcho;
+
+	for (;;) {
+		pthread_mutex_lock(&xLock);
+		iTxn = iNext++;
+		pthread_mutex_unlock(&xLock);
+		if (iTxn >= xCfg.iTotal)
+			break;
+
+		if (xCfg.iRate > 0)                // Paced on the global schedule
+			msSleep(dStart + iTxn * 1000.0 / xCfg.iRate - nowMs());
+		iEcho = (int)(rand_r(&uiSeed) % 100) < xCfg.iEcho;
+
+		dBeg = nowMs();
+		iRes = resConnect;
+		if (iSock < 0)
+			iSock = sockOpen();
+		if (iSock >= 0)
+			iRes = txnRun(iSock, iTxn, iEcho);
+		dLat = nowMs() - dBeg;
+
+		if ((iSock >= 0) && (!xCfg.iKeep || (iRes > resDeclined))) {
+			close(iSock);
+			iSock = -1;
+		}
+
+		pthread_mutex_lock(&xLock);
+		tulRes[iRes]++;
+		if (iRes <= resDeclined)
+			pdLat[iLatNbr++] = dLat;
+		pthread_mutex_unlock(&xLock);
+	}
+
+	if (iSock >= 0)
+		close(iSock);
+	return NULL;
+}
+
+static int latCmp(const void *pvA, const void *pvB) {
+	double dA = *(const double *)pvA, dB = *(const double *)pvB;
+
+	return (dA > dB) - (dA < dB);
+}
+
+static double latPct(int iPct) {           // Nearest rank
+	int iIdx;
+
+	if (iLatNbr == 0)
+		return 0;
+	iIdx = (iLatNbr * iPct + 99) / 100 - 1;
+	return pdLat[iIdx < 0 ? 0 : iIdx];
+}
+
+static void usage(void) {
+	fprintf(stderr,
+			"loadgen [-h host] [-p port] [-c concurrency] [-n total] [-r rate/s]\n"
+			"        [-t timeoutMs] [-k] [-e echo%%] [-a amountCents] [-v]\n"
+			"  -k  keep the connection open between transactions\n"
+			"  -e  share of echo tests (0800) in the mix, the rest are sales (0200)\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	struct addrinfo xHint;
+	pthread_t *pxThr;
+	double dDur;
+	int iOpt, iIdx;
+
+	while ((iOpt = getopt(argc, argv, "h:p:c:n:r:t:ke:a:v")) != -1) {
+		switch (iOpt) {
+		case 'h': xCfg.pcHost = optarg; break;
+		case 'p': xCfg.pcPort = optarg; break;
+		case 'c': xCfg.iConc = atoi(optarg); break;
+		case 'n': xCfg.iTotal = atoi(optarg); break;
+		case 'r': xCfg.iRate = atoi(optarg); break;
+		case 't': xCfg.iTimeout = atoi(optarg); break;
+		case 'k': xCfg.iKeep = 1; break;
+		case 'e': xCfg.iEcho = atoi(optarg); break;
+		case 'a': xCfg.lAmount = atol(optarg); break;
+		case 'v': xCfg.iVerbose = 1; break;
+		default: usage();
+		}
+	}
+	if ((xCfg.iConc <= 0) || (xCfg.iTotal <= 0))
+		usage();
+
+	signal(SIGPIPE, SIG_IGN);
+	memset(&xHint, 0, sizeof(xHint));
+	xHint.ai_family = AF_UNSPEC;
+	xHint.ai_socktype = SOCK_STREAM;
+	if (getaddrinfo(xCfg.pcHost, xCfg.pcPort, &xHint, &pxAdr) != 0) {
+		fprintf(stderr, "cannot resolve %s\n", xCfg.pcHost);
+		return 1;
+	}
+	pdLat = calloc(xCfg.iTotal, sizeof(*pdLat));
+	pxThr = calloc(xCfg.iConc, sizeof(*pxThr));
+	if ((pdLat == NULL) || (pxThr == NULL))
+		return 1;
+
+	dStart = nowMs();
+	for (iIdx=0; iIdx<xCfg.iConc; iIdx++)
+		pthread_create(&pxThr[iIdx], NULL, workTask, (void *)(long)iIdx);
+	for (iIdx=0; iIdx<xCfg.iConc; iIdx++)
+		pthread_join(pxThr[iIdx], NULL);
+	dDur = nowMs() - dStart;
+
+	qsort(pdLat, iLatNbr, sizeof(*pdLat), latCmp);
+	printf("%d transactions in %.0f ms over %d connections%s: %.1f tps\n",
+			xCfg.iTotal, dDur, xCfg.iConc, xCfg.iKeep ? " (kept)" : "",
+			dDur > 0 ? xCfg.iTotal * 1000.0 / dDur : 0);
+	for (iIdx=0; iIdx<resEnd; iIdx++)
+		printf("  %-10s %lu\n", tzRes[iIdx], tulRes[iIdx]);
+	printf("latency ms: p50 %.1f, p90 %.1f, p99 %.1f, max %.1f\n",
+			latPct(50), latPct(90), latPct(99), iLatNbr ? pdLat[iLatNbr - 1] : 0);
+
+	freeaddrinfo(pxAdr);
+	free(pxThr);
+	free(pdLat);
+	return (tulRes[resApproved] + tulRes[resDeclined] == (unsigned long)xCfg.iTotal) ? 0 : 2;
+}
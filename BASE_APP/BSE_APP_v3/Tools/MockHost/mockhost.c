@@ -0,0 +1,444 @@
+/*
+ * mockhost.c
+ *
+ *  Mock acquirer for the online path of the terminal.
+ *  Accepts TCP connections, reads length framed requests (2 bytes binary
+ *  length + TPDU + ISO8583, see onlSendRaw) and answers them according to
+ *  the configured mix of approvals, declines, delays, missing answers and
+ *  malformed responses. Several requests may be sent on one connection,
+ *  answered one after the other or, with -o, each after its own delay so
+ *  the answers overlap and may come back out of order.
+ *
+ *  Usage: mockhost [-p port] [-a approve%] [-c declineRc] [-A]
+ *                  [-d minMs[,maxMs]] [-n noAnswer%] [-m malformed%]
+ *                  [-s chunk] [-g gapMs] [-o] [-v]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "isomsg.h"
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	int iPort;
+	int iApprove;                          // % of approvals
+	char tcDeclineRc[2 + 1];               // Response code of the declines
+	int iAmountRc;                         // Cents of the amount select the response code
+	int iDelayMin, iDelayMax;              // Host processing time (ms)
+	int iNoAnswer;                         // % of requests left unanswered
+	int iMalformed;                        // % of malformed answers
+	int iChunk;                            // Drip feed the answer by chunks (0: one write)
+	int iGap;                              // Gap between chunks (ms)
+	int iOverlap;                          // Requests of a connection processed in parallel
+	int iVerbose;
+} tCfg;
+
+typedef struct {
+	int iSock;
+	int iRefs;                             // Reader + answers in progress
+	pthread_mutex_t xWr;                   // One answer written at a time
+} tConn;
+
+typedef struct {                           // Request answered by its own thread (-o)
+	tConn *pxConn;
+	byte tucTpdu[ISO_TPDU_LEN];
+	byte tucIso[ISO_MSG_MAX];
+	int iLen;
+	unsigned int uiSeed;
+} tJob;
+
+typedef struct {
+	unsigned long ulConn, ulReq, ulApproved, ulDeclined;
+	unsigned long ulNoAnswer, ulMalformed, ulBadReq;
+} tStats;
+
+enum {                                     // Malformed answer variants
+	malLongHeader,                         // Header announces more than what is sent
+	malTruncated,                          // Bitmap announces fields that are missing
+	malOversized,                          // Header bigger than any terminal buffer
+	malGarbage,                            // Random bytes after a valid header
+	malEnd
+};
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tCfg xCfg = { 5000, 100, "05", 0, 0, 0, 0, 0, 0, 50, 0, 0 };
+static tStats xStats;
+static pthread_mutex_t xLock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long ulRrn = 0;
+
+#define STAT_INC(F) { pthread_mutex_lock(&xLock); xStats.F++; pthread_mutex_unlock(&xLock); }
+
+static void msSleep(int iMs) {
+	struct timespec xTs;
+
+	if (iMs <= 0)
+		return;
+	xTs.tv_sec = iMs / 1000;
+	xTs.tv_nsec = (long)(iMs % 1000) * 1000000L;
+	nanosleep(&xTs, NULL);
+}
+
+static void statsDump(int iSig) {
+	(void)iSig;
+	fprintf(stderr, "\nconnections %lu, requests %lu: approved %lu, declined %lu, "
+			"unanswered %lu, malformed %lu, bad requests %lu\n",
+			xStats.ulConn, xStats.ulReq, xStats.ulApproved, xStats.ulDeclined,
+			xStats.ulNoAnswer, xStats.ulMalformed, xStats.ulBadReq);
+	if (iSig == SIGINT)
+		_exit(0);
+}
+
+static void hexDump(const char *pcTag, const byte *pucBuf, int iLen) {
+	int iIdx;
+
+	fprintf(stderr, "%s (%d):", pcTag, iLen);
+	for (iIdx=0; iIdx<iLen; iIdx++)
+		fprintf(stderr, "%s%02X", (iIdx % 32) ? " " : "\n  ", pucBuf[iIdx]);
+	fprintf(stderr, "\n");
+}
+
+// Sends a frame, by chunks when drip feeding is configured.
+static int rspSend(int iSock, const byte *pucFrm, int iLen) {
+	int iPos, iNbr;
+
+	if (xCfg.iChunk <= 0)
+		return sockWriteAll(iSock, pucFrm, iLen);
+
+	for (iPos=0; iPos<iLen; iPos+=iNbr) {
+		iNbr = (iLen - iPos < xCfg.iChunk) ? iLen - iPos : xCfg.iChunk;
+		if (sockWriteAll(iSock, pucFrm + iPos, iNbr) != iNbr)
+			return -1;
+		if (iPos + iNbr < iLen)
+			msSleep(xCfg.iGap);
+	}
+	return iLen;
+}
+
+static void rspRc(const tIsoMsg *pxReq, unsigned int *puiSeed, char *pcRc) {
+	char tcAmt[12 + 1];
+	int iLen;
+
+	strcpy(pcRc, "00");
+	if (xCfg.iAmountRc && (isoGetNum(pxReq, isoAmt, tcAmt, sizeof(tcAmt)) > 0)) {
+		iLen = (int)strlen(tcAmt);     // Cents other than 00 are the response code
+		if ((iLen >= 2) && strcmp(tcAmt + iLen - 2, "00"))
+			strcpy(pcRc, tcAmt + iLen - 2);
+		return;
+	}
+	if ((int)(rand_r(puiSeed) % 100) >= xCfg.iApprove)
+		strcpy(pcRc, xCfg.tcDeclineRc);
+}
+
+// Builds the answer of a request: MTI + 10, echoed keys, RRN, approval
+// code when approved and response code.
+static int rspBuild(const tIsoMsg *pxReq, const char *pcRc, byte *pucIso, int iDim) {
+	static const byte tucEcho[] = { isoPrcCod, isoAmt, isoSTAN, isoTim, isoDat, isoNII, isoTid, isoMid };
+	tIsoMsg *pxRsp;
+	char tcVal[64 + 1];
+	unsigned long ulRef;
+	int iIdx, iRet;
+
+	pxRsp = malloc(sizeof(*pxRsp));
+	if (pxRsp == NULL)
+		return -1;
+	isoInit(pxRsp, "0000");
+	pxRsp->tucMti[0] = pxReq->tucMti[0];
+	pxRsp->tucMti[1] = (byte)(pxReq->tucMti[1] + 0x10);
+
+	for (iIdx=0; iIdx<(int)sizeof(tucEcho); iIdx++) {
+		if (!isoHas(pxReq, tucEcho[iIdx]))
+			continue;
+		isoGetNum(pxReq, tucEcho[iIdx], tcVal, sizeof(tcVal));
+		isoSetNum(pxRsp, tucEcho[iIdx], tcVal);
+	}
+
+	pthread_mutex_lock(&xLock);
+	ulRef = ++ulRrn;
+	pthread_mutex_unlock(&xLock);
+	sprintf(tcVal, "%012lu", ulRef);
+	isoSetAsc(pxRsp, isoRrn, tcVal);
+	if (strcmp(pcRc, "00") == 0) {
+		sprintf(tcVal, "%06lu", ulRef % 1000000);
+		isoSetAsc(pxRsp, isoAutCod, tcVal);
+	}
+	isoSetAsc(pxRsp, isoRspCod, pcRc);
+
+	iRet = isoPack(pxRsp, pucIso, iDim);
+	free(pxRsp);
+	return iRet;
+}
+
+// Sends one of the malformed variants; the connection is closed afterwards.
+static void rspMalformed(int iSock, const byte *pucIso, int iLen, unsigned int *puiSeed) {
+	byte tucFrm[ISO_HDR_LEN + ISO_TPDU_LEN + ISO_MSG_MAX];
+	int iIdx, iVar = (int)(rand_r(puiSeed) % malEnd);
+
+	memset(tucFrm + ISO_HDR_LEN, 0x60, ISO_TPDU_LEN);
+	memcpy(tucFrm + ISO_HDR_LEN + ISO_TPDU_LEN, pucIso, iLen);
+	iLen += ISO_TPDU_LEN;
+
+	switch (iVar) {
+	case malLongHeader:
+		tucFrm[0] = (byte)((iLen + 40) >> 8);
+		tucFrm[1] = (byte)(iLen + 40);
+		break;
+	case malTruncated:
+		iLen -= (iLen > ISO_TPDU_LEN + 14) ? 6 : 0;
+		tucFrm[0] = (byte)(iLen >> 8);
+		tucFrm[1] = (byte)iLen;
+		break;
+	case malOversized:
+		tucFrm[0] = 0xFF;
+		tucFrm[1] = 0xFF;
+		break;
+	default:
+		for (iIdx=ISO_HDR_LEN+ISO_TPDU_LEN; iIdx<ISO_HDR_LEN+iLen; iIdx++)
+			tucFrm[iIdx] = (byte)rand_r(puiSeed);
+		tucFrm[0] = (byte)(iLen >> 8);
+		tucFrm[1] = (byte)iLen;
+		break;
+	}
+	if (xCfg.iVerbose)
+		fprintf(stderr, "malformed answer, variant %d\n", iVar);
+	rspSend(iSock, tucFrm, ISO_HDR_LEN + iLen);
+}
+
+static void connRelease(tConn *pxConn) {
+	int iLast;
+
+	pthread_mutex_lock(&xLock);
+	iLast = (--pxConn->iRefs == 0);
+	pthread_mutex_unlock(&xLock);
+	if (!iLast)
+		return;
+	close(pxConn->iSock);
+	pthread_mutex_destroy(&pxConn->xWr);
+	free(pxConn);
+}
+
+// Answers one request. Negative when the connection is to be dropped.
+static int rspAnswer(tConn *pxConn, const byte *pucTpdu, const byte *pucIso, int iLen, unsigned int *puiSeed) {
+	byte tucIso[ISO_MSG_MAX];
+	byte tucFrm[ISO_HDR_LEN + ISO_TPDU_LEN + ISO_MSG_MAX];
+	tIsoMsg *pxReq = NULL;
+	char tcRc[2 + 1];
+	int iRoll, iDly, iRet = -1;
+
+	pxReq = malloc(sizeof(*pxReq));
+	if (pxReq == NULL)
+		goto lblEnd;
+	if (isoUnpack(pxReq, isoDirReq, pucIso, iLen) < 0) {
+		STAT_INC(ulBadReq);
+		fprintf(stderr, "request does not parse, closing\n");
+		goto lblEnd;
+	}
+
+	iDly = xCfg.iDelayMin;                 // Host processing time
+	if (xCfg.iDelayMax > xCfg.iDelayMin)
+		iDly += (int)(rand_r(puiSeed) % (unsigned)(xCfg.iDelayMax - xCfg.iDelayMin + 1));
+	msSleep(iDly);
+
+	iRoll = (int)(rand_r(puiSeed) % 100);
+	if (iRoll < xCfg.iNoAnswer) {
+		STAT_INC(ulNoAnswer);
+		iRet = 0;                          // Let the terminal time out
+		goto lblEnd;
+	}
+
+	rspRc(pxReq, puiSeed, tcRc);
+	iLen = rspBuild(pxReq, tcRc, tucIso, sizeof(tucIso));
+	if (iLen < 0)
+		goto lblEnd;
+
+	if (iRoll < xCfg.iNoAnswer + xCfg.iMalformed) {
+		STAT_INC(ulMalformed);
+		pthread_mutex_lock(&pxConn->xWr);
+		rspMalformed(pxConn->iSock, tucIso, iLen, puiSeed);
+		pthread_mutex_unlock(&pxConn->xWr);
+		goto lblEnd;
+	}
+
+	tucFrm[0] = (byte)((iLen + ISO_TPDU_LEN) >> 8);
+	tucFrm[1] = (byte)(iLen + ISO_TPDU_LEN);
+	tucFrm[2] = pucTpdu[0];                // TPDU with source and destination swapped
+	tucFrm[3] = pucTpdu[3];
+	tucFrm[4] = pucTpdu[4];
+	tucFrm[5] = pucTpdu[1];
+	tucFrm[6] = pucTpdu[2];
+	memcpy(tucFrm + ISO_HDR_LEN + ISO_TPDU_LEN, tucIso, iLen);
+	if (xCfg.iVerbose)
+		hexDump("response", tucIso, iLen);
+	pthread_mutex_lock(&pxConn->xWr);
+	iRet = rspSend(pxConn->iSock, tucFrm, ISO_HDR_LEN + ISO_TPDU_LEN + iLen);
+	pthread_mutex_unlock(&pxConn->xWr);
+	if (iRet < 0)
+		goto lblEnd;
+
+	iRet = 0;
+	if (strcmp(tcRc, "00") == 0) {
+		STAT_INC(ulApproved);
+	} else {
+		STAT_INC(ulDeclined);
+	}
+
+	lblEnd:
+	free(pxReq);
+	return iRet;
+}
+
+static void *answerTask(void *pvArg) {
+	tJob *pxJob = (tJob *)pvArg;
+
+	if (rspAnswer(pxJob->pxConn, pxJob->tucTpdu, pxJob->tucIso, pxJob->iLen, &pxJob->uiSeed) < 0)
+		shutdown(pxJob->pxConn->iSock, SHUT_RDWR);    // The reader sees the end, the socket is closed by the last one
+	connRelease(pxJob->pxConn);
+	free(pxJob);
+	return NULL;
+}
+
+static void *connTask(void *pvArg) {
+	byte tucTpdu[ISO_TPDU_LEN], tucIso[ISO_MSG_MAX];
+	tConn *pxConn = (tConn *)pvArg;
+	tJob *pxJob;
+	pthread_t xThr;
+	struct timespec xTs;
+	unsigned int uiSeed;
+	int iLen;
+
+	clock_gettime(CLOCK_MONOTONIC, &xTs);  // Sockets are reused, seed on the clock too
+	uiSeed = (unsigned int)xTs.tv_nsec ^ ((unsigned int)pxConn->iSock << 20);
+
+	for (;;) {
+		iLen = frmRead(pxConn->iSock, tucTpdu, tucIso, sizeof(tucIso));
+		if (iLen == 0)
+			break;                         // Terminal closed the connection
+		if (iLen < 0) {
+			STAT_INC(ulBadReq);
+			break;
+		}
+		STAT_INC(ulReq);
+		if (xCfg.iVerbose)
+			hexDump("request", tucIso, iLen);
+
+		if (!xCfg.iOverlap) {
+			if (rspAnswer(pxConn, tucTpdu, tucIso, iLen, &uiSeed) < 0)
+				break;
+			continue;
+		}
+
+		pxJob = malloc(sizeof(*pxJob));
+		if (pxJob == NULL)
+			break;
+		pxJob->pxConn = pxConn;
+		memcpy(pxJob->tucTpdu, tucTpdu, ISO_TPDU_LEN);
+		memcpy(pxJob->tucIso, tucIso, iLen);
+		pxJob->iLen = iLen;
+		pxJob->uiSeed = (unsigned int)rand_r(&uiSeed);
+		pthread_mutex_lock(&xLock);
+		pxConn->iRefs++;
+		pthread_mutex_unlock(&xLock);
+		if (pthread_create(&xThr, NULL, answerTask, pxJob) != 0) {
+			connRelease(pxConn);
+			free(pxJob);
+			break;
+		}
+		pthread_detach(xThr);
+	}
+
+	connRelease(pxConn);
+	return NULL;
+}
+
+static void usage(void) {
+	fprintf(stderr,
+			"mockhost [-p port] [-a approve%%] [-c declineRc] [-A] [-d minMs[,maxMs]]\n"
+			"         [-n noAnswer%%] [-m malformed%%] [-s chunk] [-g gapMs] [-o] [-v]\n"
+			"  -A  amount driven: cents other than 00 are returned as response code\n"
+			"  -s  drip feed the answers by chunks of that many bytes, -g ms apart\n"
+			"  -o  overlap: each request answered after its own delay, maybe out of order\n"
+			"  SIGUSR1 dumps the counters, SIGINT dumps them and exits\n");
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	struct sockaddr_in xAdr;
+	pthread_t xThr;
+	tConn *pxConn;
+	int iOpt, iSrv, iSock, iOne = 1;
+
+	while ((iOpt = getopt(argc, argv, "p:a:c:Ad:n:m:s:g:ov")) != -1) {
+		switch (iOpt) {
+		case 'p': xCfg.iPort = atoi(optarg); break;
+		case 'a': xCfg.iApprove = atoi(optarg); break;
+		case 'c': strncpy(xCfg.tcDeclineRc, optarg, 2); break;
+		case 'A': xCfg.iAmountRc = 1; break;
+		case 'd':
+			if (sscanf(optarg, "%d,%d", &xCfg.iDelayMin, &xCfg.iDelayMax) < 2)
+				xCfg.iDelayMax = xCfg.iDelayMin;
+			break;
+		case 'n': xCfg.iNoAnswer = atoi(optarg); break;
+		case 'm': xCfg.iMalformed = atoi(optarg); break;
+		case 's': xCfg.iChunk = atoi(optarg); break;
+		case 'g': xCfg.iGap = atoi(optarg); break;
+		case 'o': xCfg.iOverlap = 1; break;
+		case 'v': xCfg.iVerbose = 1; break;
+		default: usage();
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, statsDump);
+	signal(SIGUSR1, statsDump);
+
+	iSrv = socket(AF_INET, SOCK_STREAM, 0);
+	if (iSrv < 0) {
+		perror("socket");
+		return 1;
+	}
+	setsockopt(iSrv, SOL_SOCKET, SO_REUSEADDR, &iOne, sizeof(iOne));
+	memset(&xAdr, 0, sizeof(xAdr));
+	xAdr.sin_family = AF_INET;
+	xAdr.sin_addr.s_addr = htonl(INADDR_ANY);
+	xAdr.sin_port = htons((unsigned short)xCfg.iPort);
+	if ((bind(iSrv, (struct sockaddr *)&xAdr, sizeof(xAdr)) < 0) || (listen(iSrv, 256) < 0)) {
+		perror("bind/listen");
+		return 1;
+	}
+	fprintf(stderr, "mockhost listening on %d: approve %d%%, decline rc %s, delay %d-%d ms, "
+			"no answer %d%%, malformed %d%%\n", xCfg.iPort, xCfg.iApprove, xCfg.tcDeclineRc,
+			xCfg.iDelayMin, xCfg.iDelayMax, xCfg.iNoAnswer, xCfg.iMalformed);
+
+	for (;;) {
+		iSock = accept(iSrv, NULL, NULL);
+		if (iSock < 0)
+			continue;
+		setsockopt(iSock, IPPROTO_TCP, TCP_NODELAY, &iOne, sizeof(iOne));
+		STAT_INC(ulConn);
+		pxConn = malloc(sizeof(*pxConn));
+		if (pxConn == NULL) {
+			close(iSock);
+			continue;
+		}
+		pxConn->iSock = iSock;
+		pxConn->iRefs = 1;
+		pthread_mutex_init(&pxConn->xWr, NULL);
+		if (pthread_create(&xThr, NULL, connTask, pxConn) != 0) {
+			connRelease(pxConn);
+			continue;
+		}
+		pthread_detach(xThr);
+	}
+	return 0;
+}
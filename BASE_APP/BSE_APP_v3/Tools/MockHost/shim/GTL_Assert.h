@@ -0,0 +1,5 @@
+/*
+ * GTL_Assert.h (host shim)
+ *
+ *  VERIFY is provided by the shim globals.h.
+ */
@@ -0,0 +1,21 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/iso8583.c on
+ *  Linux, so the mock host and the load generator share the field format
+ *  table of the application instead of a copy of it.
+ */
+#ifndef __MOCK_GLOBALS_H__
+#define __MOCK_GLOBALS_H__
+
+#include <assert.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int card;
+
+#define VERIFY(C) assert(C)
+
+#include "iso8583.h"
+
+#endif
@@ -0,0 +1,184 @@
+/*
+ * rtotest.c
+ *
+ *  Drives the receive timeout estimator (Src/RecvTmo.c) with synthetic
+ *  delay traces and compares it with the former fixed 30 s timeout.
+ *
+ *  Each trace is a list of host answer delays in ms, 0 meaning the host
+ *  never answers. For each exchange the test asks for the timeout, then
+ *  reports an answer (delay < timeout) or a timeout, as the transports do.
+ *  It counts:
+ *    - the answers lost because the timeout was too short (each one a
+ *      reversal of a transaction the host processed),
+ *    - the time waited on the exchanges without answer.
+ *
+ *  The run fails (exit code 1) when, in the default range, the estimator
+ *  loses an answer the fixed timeout would have kept, when a timeout leaves
+ *  the floor/ceiling range, or when the bound applied is logged again
+ *  without having changed.
+ */
+#include "globals.h"
+
+#define FIXED_TMO  30000
+#define TRACE_LEN  400
+
+static int iMin = 30;                  // appRcvTmoMin (s)
+static int iMax = 60;                  // appRcvTmoMax (s)
+static card ulLastTmo;
+static int iFloor = 0, iCeiling = 0, iExpired = 0;
+static int iBoundLogs = 0, iBoundRepeats = 0;
+static const char *pcLastBound = NULL; // Last bound logged in the run
+
+int appGet(int iKey, char *pcVal, int iLen) {
+	return snprintf(pcVal, iLen, "%d", (iKey == appRcvTmoMin) ? iMin : iMax);
+}
+
+void netTimTimeout(card ulTmo) { ulLastTmo = ulTmo; }
+void onlBgExpect(card ulTmo) { (void)ulTmo; }
+
+void perflog(const char *pcMsg) {
+	if (strcmp(pcMsg, "RCVTMO expired") == 0) {
+		iExpired++;
+		return;
+	}
+	if (strcmp(pcMsg, "RCVTMO floor") == 0)
+		iFloor++;
+	else if (strcmp(pcMsg, "RCVTMO ceiling") == 0)
+		iCeiling++;
+	iBoundLogs++;
+	if (pcLastBound && (strcmp(pcMsg, pcLastBound) == 0))
+		iBoundRepeats++;               // Logged though the bound applied did not change
+	pcLastBound = pcMsg;
+}
+
+static unsigned int uiSeed = 1;
+static card rnd(card ulFrom, card ulTo) {   // Deterministic, same traces on every run
+	uiSeed = uiSeed * 1103515245u + 12345u;
+	return ulFrom + ((uiSeed >> 8) % (ulTo - ulFrom + 1));
+}
+
+// Healthy GPRS link, 1 host out of 50 never answers
+static void trcHealthy(card *pulDly) {
+	int iIdx;
+	for (iIdx = 0; iIdx < TRACE_LEN; iIdx++)
+		pulDly[iIdx] = (rnd(0, 49) == 0) ? 0 : rnd(900, 2200);
+}
+
+// Healthy, then 100 exchanges of congestion (5 to 25 s), then healthy again
+static void trcCongestion(card *pulDly) {
+	int iIdx;
+	for (iIdx = 0; iIdx < TRACE_LEN; iIdx++)
+		pulDly[iIdx] = ((iIdx >= 150) && (iIdx < 250)) ? rnd(5000, 25000) : rnd(900, 2200);
+}
+
+// Issuer slow for a while: answers in 18 to 28 s, some never
+static void trcSlowIssuer(card *pulDly) {
+	int iIdx;
+	for (iIdx = 0; iIdx < TRACE_LEN; iIdx++) {
+		if ((iIdx >= 100) && (iIdx < 160))
+			pulDly[iIdx] = (rnd(0, 9) == 0) ? 0 : rnd(18000, 28000);
+		else
+			pulDly[iIdx] = rnd(1500, 4000);
+	}
+}
+
+// Host down for 20 exchanges in the middle of a healthy trace
+static void trcOutage(card *pulDly) {
+	int iIdx;
+	for (iIdx = 0; iIdx < TRACE_LEN; iIdx++)
+		pulDly[iIdx] = ((iIdx >= 200) && (iIdx < 220)) ? 0 : rnd(900, 2200);
+}
+
+typedef struct {
+	int iLost;                         // Answers that came after the timeout
+	int iNoAns;                        // Exchanges without answer
+	unsigned long long ullWait;        // Time waited on them (ms)
+	card ulTmoMin, ulTmoMax;
+} tStat;
+
+static void play(const card *pulDly, const char *pcHost, tStat *pxAdp, tStat *pxFix) {
+	card ulTmo;
+	int iIdx;
+
+	memset(pxAdp, 0, sizeof(*pxAdp));
+	memset(pxFix, 0, sizeof(*pxFix));
+	pxAdp->ulTmoMin = 0xFFFFFFFF;
+	for (iIdx = 0; iIdx < TRACE_LEN; iIdx++) {
+		card ulDly = pulDly[iIdx];
+
+		ulTmo = (card)rcvTmoGet('G', pcHost) * 1000;
+		if (ulLastTmo < pxAdp->ulTmoMin) pxAdp->ulTmoMin = ulLastTmo;
+		if (ulLastTmo > pxAdp->ulTmoMax) pxAdp->ulTmoMax = ulLastTmo;
+		if ((ulDly == 0) || (ulDly >= ulTmo)) {
+			rcvTmoExpired('G', pcHost);
+			pxAdp->iNoAns++;
+			pxAdp->ullWait += ulTmo;
+			if (ulDly)
+				pxAdp->iLost++;
+		} else
+			rcvTmoSample('G', pcHost, ulDly);
+
+		if ((ulDly == 0) || (ulDly >= FIXED_TMO)) {
+			pxFix->iNoAns++;
+			pxFix->ullWait += FIXED_TMO;
+			if (ulDly)
+				pxFix->iLost++;
+		}
+	}
+}
+
+static int run(const char *pcName, void (*pfTrace)(card *), int iFloorS, int iCeilS, int iStrict) {
+	static card tulDly[TRACE_LEN];
+	char tcHost[32];
+	tStat xAdp, xFix;
+	int iErr = 0;
+
+	iMin = iFloorS;
+	iMax = iCeilS;
+	pcLastBound = NULL;
+	pfTrace(tulDly);
+	snprintf(tcHost, sizeof(tcHost), "%s|%d%d", pcName, iFloorS, iCeilS);   // Fresh estimator per run
+	play(tulDly, tcHost, &xAdp, &xFix);
+
+	printf("%-12s %3d-%-3d %6lu-%-6lu %5d %5d %9.1f %9.1f\n", pcName, iFloorS, iCeilS,
+			xAdp.ulTmoMin, xAdp.ulTmoMax, xAdp.iLost, xFix.iLost,
+			xAdp.ullWait / 1000.0, xFix.ullWait / 1000.0);
+
+	if ((xAdp.ulTmoMin < (card)iFloorS * 1000) || (xAdp.ulTmoMax > (card)iCeilS * 1000)) {
+		printf("  timeout out of the floor/ceiling range\n");
+		iErr++;
+	}
+	if (iStrict && (xAdp.iLost > xFix.iLost)) {
+		printf("  answers lost that the fixed timeout kept\n");
+		iErr++;
+	}
+	return iErr;
+}
+
+int main(void) {
+	int iErr = 0;
+
+	printf("%-12s %-7s %-13s %5s %5s %9s %9s\n", "trace", "range", "timeout (ms)", "lost", "lost", "waited", "waited");
+	printf("%-12s %-7s %-13s %5s %5s %9s %9s\n", "", "(s)", "adaptive", "adp", "30s", "adp (s)", "30s (s)");
+
+	// Default range: the floor keeps every answer the fixed timeout kept
+	iErr += run("healthy", trcHealthy, 30, 60, 1);
+	iErr += run("congestion", trcCongestion, 30, 60, 1);
+	iErr += run("slowissuer", trcSlowIssuer, 30, 60, 1);
+	iErr += run("outage", trcOutage, 30, 60, 1);
+
+	// Low floor: shows the estimator itself (not for production without a host agreement)
+	iErr += run("healthy", trcHealthy, 5, 60, 1);
+	iErr += run("congestion", trcCongestion, 5, 60, 0);
+	iErr += run("slowissuer", trcSlowIssuer, 5, 60, 0);
+	iErr += run("outage", trcOutage, 5, 60, 1);
+
+	printf("bound logged %d times in %d exchanges (floor %d, ceiling %d), expired %d\n",
+			iBoundLogs, 8 * TRACE_LEN, iFloor, iCeiling, iExpired);
+	if (iBoundRepeats) {
+		printf("  bound logged %d times without a change\n", iBoundRepeats);
+		iErr++;
+	}
+	printf("%s\n", iErr ? "FAILED" : "OK");
+	return iErr ? 1 : 0;
+}
@@ -0,0 +1,29 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/RecvTmo.c on
+ *  Linux: the floor and ceiling parameters are set by the test.
+ */
+#ifndef __RTOTEST_GLOBALS_H__
+#define __RTOTEST_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned long card;
+
+enum { lenGprsIpRemote = 32, lenGprsPort = 6 };
+enum { appRcvTmoMin, appRcvTmoMax };
+
+int appGet(int iKey, char *pcVal, int iLen);
+void netTimTimeout(card ulTmo);
+void onlBgExpect(card ulTmo);
+
+byte rcvTmoGet(byte ucRoute, const char *pcHost);
+void rcvTmoSample(byte ucRoute, const char *pcHost, card ulRtt);
+void rcvTmoExpired(byte ucRoute, const char *pcHost);
+
+#endif
@@ -0,0 +1,2 @@
+/* perf_log.h (host shim) */
+void perflog(const char *pcMsg);
@@ -0,0 +1,21 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/SimPred.c on
+ *  Linux. card is 32 bits as on the terminal, so time wrap behaves the same.
+ */
+#ifndef __SIMPRED_GLOBALS_H__
+#define __SIMPRED_GLOBALS_H__
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int card;
+
+void simPredInit(void);
+void simPredRadio(int iSim, int iRadio, card ulNow);
+void simPredSample(int iSim, card ulAttach, card ulConnect, int iOk, card ulNow);
+card simPredScore(int iSim, card ulNow);
+int simPredChoose(int iCur, card ulNow);
+void simPredSwitched(card ulNow);
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * simpred.c
+ *
+ *  Replays a recorded link trace of both SIM slots through the SIM predictor
+ *  of the terminal (Src/SimPred.c) and compares its cost with other policies.
+ *
+ *  Each trace row is one transaction: for each SIM the radio level, attach
+ *  time, connect time (ms) and whether the host answered. Like the terminal,
+ *  the predictor only sees the row of the SIM in use. A failed transaction
+ *  costs a receive timeout and a switch costs a new attach on the new SIM.
+ *
+ *  Policies:
+ *    predictive  Src/SimPred.c, checked after each transaction
+ *    stay        SIM 1 all the time
+ *    reactive    switch after 3 failed or weak radio (< 2) checks in a row,
+ *                as the former AutoSwitchSimSlots did
+ *    oracle      best SIM of each row, switches for free (lower bound)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "globals.h"
+
+#define FAIL_COST      30000   // Receive timeout (ms), same as SIMP_FAIL_COST
+#define REACTIVE_LOOPS 3
+#define ROW_MAX        100000
+
+typedef struct {
+	card ulTime;               // ms
+	int tiRadio[2];
+	card tulAttach[2];
+	card tulConnect[2];
+	int tiOk[2];
+} tRow;
+
+typedef struct {
+	const char *pcName;
+	unsigned long long ullCost;
+	int iFail;
+	int iSwitch;
+} tRes;
+
+static tRow tzRow[ROW_MAX];
+
+static card rowCost(const tRow *pxRow, int iSim) {
+	return pxRow->tulAttach[iSim] + pxRow->tulConnect[iSim] + (pxRow->tiOk[iSim] ? 0 : FAIL_COST);
+}
+
+static int traceLoad(const char *pcFile) {
+	FILE *hFile;
+	char tcLine[256];
+	unsigned long ulSec;
+	tRow *pxRow;
+	int iNbr = 0;
+
+	hFile = fopen(pcFile, "r");
+	if (hFile == NULL) {
+		perror(pcFile);
+		return -1;
+	}
+	while (fgets(tcLine, sizeof(tcLine), hFile) && (iNbr < ROW_MAX)) {
+		pxRow = &tzRow[iNbr];
+		if (sscanf(tcLine, "%lu,%d,%u,%u,%d,%d,%u,%u,%d", &ulSec,
+				&pxRow->tiRadio[0], &pxRow->tulAttach[0], &pxRow->tulConnect[0], &pxRow->tiOk[0],
+				&pxRow->tiRadio[1], &pxRow->tulAttach[1], &pxRow->tulConnect[1], &pxRow->tiOk[1]) != 9)
+			continue;                          // Header or comment
+		pxRow->ulTime = (card)(ulSec * 1000);
+		iNbr++;
+	}
+	fclose(hFile);
+	return iNbr;
+}
+
+static void account(tRes *pxRes, const tRow *pxRow, int iSim) {
+	pxRes->ullCost += rowCost(pxRow, iSim);
+	if (!pxRow->tiOk[iSim])
+		pxRes->iFail++;
+}
+
+static void runPredictive(tRes *pxRes, int iNbr, card ulBase, int iVerbose) {
+	int iRow, iCur = 0, iBest;
+	card ulNow;
+
+	simPredInit();
+	for (iRow = 0; iRow < iNbr; iRow++) {
+		const tRow *pxRow = &tzRow[iRow];
+
+		ulNow = ulBase + pxRow->ulTime;
+		account(pxRes, pxRow, iCur);
+		simPredRadio(iCur, pxRow->tiRadio[iCur], ulNow);
+		simPredSample(iCur, pxRow->tulAttach[iCur], pxRow->tulConnect[iCur], pxRow->tiOk[iCur], ulNow);
+
+		iBest = simPredChoose(iCur, ulNow);
+		if (iBest != iCur) {
+			if (iVerbose)
+				printf("  t=%6lus switch SIM%d -> SIM%d (cost %u vs %u)\n", (unsigned long)(pxRow->ulTime / 1000),
+						iCur + 1, iBest + 1, simPredScore(iCur, ulNow), simPredScore(iBest, ulNow));
+			iCur = iBest;
+			simPredSwitched(ulNow);
+			pxRes->ullCost += pxRow->tulAttach[iCur];
+			pxRes->iSwitch++;
+		}
+	}
+}
+
+static void runStay(tRes *pxRes, int iNbr) {
+	int iRow;
+
+	for (iRow = 0; iRow < iNbr; iRow++)
+		account(pxRes, &tzRow[iRow], 0);
+}
+
+static void runReactive(tRes *pxRes, int iNbr) {
+	int iRow, iCur = 0, iBad = 0;
+
+	for (iRow = 0; iRow < iNbr; iRow++) {
+		const tRow *pxRow = &tzRow[iRow];
+
+		account(pxRes, pxRow, iCur);
+		if (!pxRow->tiOk[iCur] || (pxRow->tiRadio[iCur] < 2))
+			iBad++;
+		else
+			iBad = 0;
+		if (iBad >= REACTIVE_LOOPS) {
+			iCur = 1 - iCur;
+			iBad = 0;
+			pxRes->ullCost += pxRow->tulAttach[iCur];
+			pxRes->iSwitch++;
+		}
+	}
+}
+
+static void runOracle(tRes *pxRes, int iNbr) {
+	int iRow, iSim;
+
+	for (iRow = 0; iRow < iNbr; iRow++) {
+		iSim = (rowCost(&tzRow[iRow], 1) < rowCost(&tzRow[iRow], 0)) ? 1 : 0;
+		account(pxRes, &tzRow[iRow], iSim);
+	}
+}
+
+int main(int argc, char **argv) {
+	tRes tzRes[4] = { { "predictive", 0, 0, 0 }, { "stay SIM1", 0, 0, 0 }, { "reactive", 0, 0, 0 }, { "oracle", 0, 0, 0 } };
+	int iNbr, iIdx, iVerbose = 0;
+	card ulBase = 0;
+
+	for (iIdx = 1; iIdx < argc - 1; iIdx++) {
+		if (strcmp(argv[iIdx], "-v") == 0)
+			iVerbose = 1;
+		else if (strcmp(argv[iIdx], "-w") == 0)        // Start near the 32-bit wrap of the terminal clock
+			ulBase = 0xFFFFFFFFu - 3600u * 1000u;
+	}
+	if (argc < 2) {
+		fprintf(stderr, "usage: simpred [-v] [-w] trace.csv\n");
+		return 2;
+	}
+
+	iNbr = traceLoad(argv[argc - 1]);
+	if (iNbr <= 0)
+		return 1;
+
+	runPredictive(&tzRes[0], iNbr, ulBase, iVerbose);
+	runStay(&tzRes[1], iNbr);
+	runReactive(&tzRes[2], iNbr);
+	runOracle(&tzRes[3], iNbr);
+
+	printf("%d transactions\n", iNbr);
+	printf("%-12s %12s %10s %8s %8s\n", "policy", "total (s)", "mean (ms)", "failed", "switches");
+	for (iIdx = 0; iIdx < 4; iIdx++)
+		printf("%-12s %12.1f %10llu %8d %8d\n", tzRes[iIdx].pcName, tzRes[iIdx].ullCost / 1000.0,
+				tzRes[iIdx].ullCost / iNbr, tzRes[iIdx].iFail, tzRes[iIdx].iSwitch);
+	return 0;
+}
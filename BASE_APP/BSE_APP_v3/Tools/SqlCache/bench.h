@@ -0,0 +1,113 @@
+/*
+ * bench.h
+ *
+ *  Bench core shared by the runs of sqlbench: the environment of the
+ *  terminal, the simulated disk, the measures and the log records.
+ *  sqlbench.c holds them; each run has its own file.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sqlite3.h>
+
+#include <globals.h>
+#include "Sqlite.h"
+#include "expfile.h"
+
+//****************************************************************************
+//      CONSTANTS
+//****************************************************************************
+#define VOID_EVERY      10             // One record in ten is a void
+#define CREDIT_EVERY    7              // One record in seven is a credit
+#define CURRENCY        "0566"
+#define ADVICE_MAX      1000000        // Advice queue never full in the runs
+#define FILL_COMMIT     1000           // Records per commit when a batch is filled
+#define MIX_MS          2000           // Length of the run with the advice thread
+
+//****************************************************************************
+//      TYPES
+//****************************************************************************
+typedef struct {
+	const char *pcDir;
+	int iRecords;                      // Records in the log
+	int iQueries;                      // Queries per lookup run
+	int iVerbose;
+} tCfg;
+
+typedef struct {
+	double *pdUs;                      // Time of each call (us)
+	int iCnt;
+	int iDim;
+} tRun;
+
+//****************************************************************************
+//      DATA
+//****************************************************************************
+extern tCfg xCfg;
+extern char tzMap[keyEnd][1024];       // Data map of the transaction
+extern int iOpens;                     // Database opens made by Sqlite.c
+extern volatile int iSyncs;            // File syncs made by SQLite
+extern volatile int iCommits;          // Transactions committed
+extern int iFail;
+extern volatile int bMixStop;
+extern int iMixErr;
+extern int iMixOps;
+extern long lSimSize;                  // Bytes of the disk, 0: not held
+extern sqlite3_int64 llSimShift;       // ms added to the clock
+extern int iSimFull;                   // Writes refused for the room
+extern char DataBaseName[100];
+
+//****************************************************************************
+//      BENCH CORE
+//****************************************************************************
+int benchOpen(const char *pcFile, sqlite3 **phDb);
+void benchPath(char *pcPath, size_t len, const char *pcFile);
+void benchExec(sqlite3 *hDb, const char *pcSql);
+void simInit(void);
+double nowUs(void);
+void runInit(tRun *pxRun, int iDim);
+void runAdd(tRun *pxRun, double dUs);
+void runReport(const char *pcName, tRun *pxRun, int iOpen);
+void check(int bOk, const char *pcWhat);
+void recStan(char *pcStan, int iRec);
+void recRrn(char *pcRrn, int iRec);
+int recVoid(int iRec);
+int recAmount(int iRec);
+void recEmv(char *pcEmv, int iRec);
+void recMap(int iRec);
+void recInsert(char *pcSql, int iRec);
+int recLast(int iRecords);
+int logCount(void);
+int rowCount(const char *pcSql);
+int adviceCount(void);
+void batchFill(int iFrom, int iRecords, const char *pcBatch);
+int saleSave(int iRec, int bGroup, int bCommit);
+void *mixAdvice(void *pvArg);
+void runLogSave(int iFrom, int iTo, tRun *pxRun);
+void runFindStan(int iRecords, int iQueries, tRun *pxRun);
+void runFindRrn(int iRecords, int iQueries, tRun *pxRun);
+
+//****************************************************************************
+//      RUNS
+//****************************************************************************
+void lookupBench(const char *pcArg);
+void schemaBench(const char *pcArg);
+void cursorBench(const char *pcArg);
+void commitBench(const char *pcArg);
+void settleBench(const char *pcArg);
+void reprintBench(const char *pcArg);
+void menuBench(const char *pcArg);
+void paramBench(const char *pcArg);
+void fillBench(const char *pcArg);
+void exportBench(const char *pcArg);
+
+#endif
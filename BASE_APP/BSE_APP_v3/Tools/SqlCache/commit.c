@@ -0,0 +1,100 @@
+/*
+ * commit.c
+ *
+ *  Run of -w: that many sales saved with the rollback journal, then in WAL
+ *  mode, one commit per write and then one per sale, with the syncs and
+ *  commits of each sale counted.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      COMMIT RUN
+//****************************************************************************
+static int iSales = 0;                 // Sales of each run
+
+static long walBytes(void) {
+	char tcFile[128], tcPath[512];
+	struct stat xStat;
+
+	snprintf(tcFile, sizeof(tcFile), "%s-wal", DataBaseName);
+	benchPath(tcPath, sizeof(tcPath), tcFile);
+	return (stat(tcPath, &xStat) == 0) ? (long)xStat.st_size : 0;
+}
+
+static void saleRun(const char *pcName, const char *pcJournal, int bGroup) {
+	char tcRsp[256];
+	tRun xRun;
+	double dBeg;
+	int iSync, iCommit, iRec;
+
+	SqliteDB_Init();
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement(pcJournal, tcRsp);
+	printf("%-22s journal %s\n", pcName, tcRsp);
+
+	runInit(&xRun, iSales);
+	iSync = iSyncs;
+	iCommit = iCommits;
+	for (iRec = 0; iRec < iSales; iRec++) {
+		dBeg = nowUs();
+		if (saleSave(iRec, bGroup, 1) <= 0)
+			iFail++;
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport(pcName, &xRun, 0);
+	printf("%-22s %8.2f syncs  %5.2f commits per sale\n", "", (double)(iSyncs - iSync) / iSales, (double)(iCommits - iCommit) / iSales);
+	check((logCount() == iSales) && (adviceCount() == iSales), "every sale saved");
+}
+
+// Sales in WAL mode, one commit each, then the checks of the transaction.
+static void commitRun(void) {
+	char tcRsp[256];
+	pthread_t hMix;
+	tRun xRun;
+	double dBeg, dEnd;
+	long lWal;
+	int iRec;
+
+	saleRun("rollback journal", "PRAGMA journal_mode = DELETE;", 0);
+	saleRun("WAL, commit per write", "PRAGMA journal_mode;", 0);
+	saleRun("WAL, commit per sale", "PRAGMA journal_mode;", 1);
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement("PRAGMA journal_mode;", tcRsp);
+	check(strcmp(tcRsp, "wal") == 0, "database opened in WAL mode");
+
+	// Idle checkpoint: the WAL written back and emptied
+	lWal = walBytes();
+	dBeg = nowUs();
+	check(sqlite_Checkpoint() == 1, "idle checkpoint");
+	printf("%-22s %8.1f ms  WAL %ld bytes, then %ld\n", "idle checkpoint", (nowUs() - dBeg) / 1000, lWal, walBytes());
+	check(walBytes() == 0, "WAL emptied by the idle checkpoint");
+
+	// A sale rolled back leaves neither its record nor its advice
+	iRec = iSales;
+	check(saleSave(iRec, 1, 0) < 0, "sale rolled back");
+	check((logCount() == iSales) && (adviceCount() == iSales), "nothing left by the sale rolled back");
+
+	// The sales hold the handle while the background sender works the queue
+	bMixStop = 0;
+	iMixErr = 0;
+	iMixOps = 0;
+	pthread_create(&hMix, NULL, mixAdvice, NULL);
+	runInit(&xRun, 1000000);
+	dEnd = nowUs() + MIX_MS * 1000.0;
+	for (iRec = iSales + 1; nowUs() < dEnd; iRec++) {
+		dBeg = nowUs();
+		if (saleSave(iRec, 1, 1) <= 0)
+			iMixErr++;
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	bMixStop = 1;
+	pthread_join(hMix, NULL);
+	printf("%-22s %6d advices queued, read and delivered meanwhile\n", "", iMixOps);
+	runReport("sales + advices", &xRun, 0);
+	check((iMixErr == 0) && (logCount() == iRec - 1), "sales beside the advice thread");
+}
+
+void commitBench(const char *pcArg) {
+	iSales = (atoi(pcArg) > VOID_EVERY) ? atoi(pcArg) : VOID_EVERY;
+	commitRun();
+}
@@ -0,0 +1,177 @@
+/*
+ * cursor.c
+ *
+ *  Run of -c: a batch of that many records printed through the cursors of
+ *  the detailed and summary reports, and through the former queries, with
+ *  the memory sampled along the cursor.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define CURSOR_SAMPLE   5000           // Rows between two memory samples of the cursor
+#define CURSOR_NESTED   100            // Rows between two queries made from the callback
+#define CURSOR_GROWTH   (64 * 1024)    // SQLite memory growth allowed along the cursor (bytes)
+#define CURSOR_RSS      (256 * 1024)   // Resident growth allowed along the cursor (bytes)
+
+//****************************************************************************
+//      CURSOR RUN
+//****************************************************************************
+typedef struct {
+	int iRows;
+	int iBad;
+	long long llSum;
+	long lMem0, lRss0;                 // Memory at the first sample
+	long lMemUp, lRssUp;               // Largest growth since then
+} tCur;
+
+static long rssBytes(void) {
+	FILE *pxFile = fopen("/proc/self/statm", "r");
+	long lSize = 0, lRss = 0;
+
+	if (pxFile) {
+		if (fscanf(pxFile, "%ld %ld", &lSize, &lRss) != 2)
+			lRss = 0;
+		fclose(pxFile);
+	}
+	return lRss * sysconf(_SC_PAGESIZE);
+}
+
+// Detailed report line: the row checked, the memory sampled, and now and
+// then a query of its own, as the name of a menu item is read.
+static int curRecord(const tSqlRow *Row, void *Ctx) {
+	tCur *pxCur = (tCur *)Ctx;
+	char tcAmt[32], tcRsp[64];
+	long lMem, lRss;
+
+	pxCur->iRows++;
+	sprintf(tcAmt, "%lld", Row->Int[logRowAmount]);
+	pxCur->iBad += (Row->Cols != logRowEnd) || strcmp(tcAmt, Row->Text[logRowAmount]) || (strlen(Row->Text[logRowAutCod]) != lenAutCod);
+	pxCur->llSum += Row->Int[logRowAmount];
+	if ((pxCur->iRows % CURSOR_NESTED) == 0) {
+		memset(tcRsp, 0, sizeof(tcRsp));
+		pxCur->iBad += (Sqlite_Run_Statement("SELECT COUNT(*) FROM trn_tot;", tcRsp) <= 0);
+	}
+	if ((pxCur->iRows % CURSOR_SAMPLE) == 0) {
+		lMem = (long)sqlite3_memory_used();
+		lRss = rssBytes();
+		if (pxCur->iRows == CURSOR_SAMPLE) {
+			pxCur->lMem0 = lMem;
+			pxCur->lRss0 = lRss;
+		}
+		if (lMem - pxCur->lMem0 > pxCur->lMemUp)
+			pxCur->lMemUp = lMem - pxCur->lMem0;
+		if (lRss - pxCur->lRss0 > pxCur->lRssUp)
+			pxCur->lRssUp = lRss - pxCur->lRss0;
+	}
+	return 1;
+}
+
+static int curGroup(const tSqlRow *Row, void *Ctx) {
+	tCur *pxCur = (tCur *)Ctx;
+
+	pxCur->iRows++;
+	pxCur->iBad += (Row->Cols != logGrpEnd) || ((Row->Int[logGrpMenuItem] != mnuSale) && (Row->Int[logGrpMenuItem] != mnuVoid));
+	pxCur->llSum += Row->Int[logGrpAmount];
+	return 1;
+}
+
+// Former detailed report: one query per record id, the row parsed from text.
+static void v1Detailed(int iRecords, tCur *pxCur) {
+	static char tcRsp[10240];
+	char tcSql[512];
+	char *pc;
+	int iId;
+
+	for (iId = 1; iId <= iRecords; iId++) {
+		memset(tcRsp, 0, sizeof(tcRsp));
+		sprintf(tcSql, "SELECT isoField002, isoField004, isoField007, isoField038, MenuItem FROM log WHERE isoField039 = '00' AND id = '%d' AND isoField049 = '%s' AND MenuItem != '%d';", iId, CURRENCY, mnuBalanceEnquiry);
+		Sqlite_Run_Statement_MultiRecord(tcSql, tcRsp);
+		if (strlen(tcRsp) <= 9)
+			continue;
+		pxCur->iRows++;
+		pc = strstr(tcRsp, "isoField004,");
+		if (pc)
+			pxCur->llSum += atoll(pc + 12);
+	}
+}
+
+// Former summary report: the menu items, then a count and a sum for each.
+static void v1Summary(tCur *pxCur) {
+	char tcRsp[256], tcSql[512], tcMnu[256];
+	char *pcMnu, *pcNext;
+
+	memset(tcMnu, 0, sizeof(tcMnu));
+	Sqlite_Run_Statement_MultiRecord("SELECT DISTINCT MenuItem FROM log WHERE isoField039 = '00' AND isoVoided != '1';", tcMnu);
+	for (pcMnu = tcMnu; pcMnu && *pcMnu; pcMnu = pcNext) {
+		pcNext = strchr(pcMnu, '#');
+		if (pcNext)
+			*pcNext++ = 0;
+		if (atoi(pcMnu) == mnuBalanceEnquiry)
+			continue;
+		memset(tcRsp, 0, sizeof(tcRsp));
+		sprintf(tcSql, "SELECT count(*) FROM log WHERE isoField039 = '00' AND MenuItem = '%s' AND isoField049 = '%s';", pcMnu, CURRENCY);
+		Sqlite_Run_Statement_MultiRecord(tcSql, tcRsp);
+		memset(tcRsp, 0, sizeof(tcRsp));
+		sprintf(tcSql, "SELECT SUM(isoField004) FROM log WHERE isoField039 = '00' AND MenuItem = '%s' AND isoField049 = '%s';", pcMnu, CURRENCY);
+		Sqlite_Run_Statement_MultiRecord(tcSql, tcRsp);
+		pxCur->iRows++;
+		pxCur->llSum += atoll(tcRsp);
+	}
+}
+
+// Batch of iRecords printed by the reports, through the cursors and the
+// former queries.
+static void cursorRun(int iRecords) {
+	tCur xCur, xV1;
+	long long llSum = 0;
+	double dBeg;
+	int iRec, iRet;
+
+	SqliteDB_Init();
+	mapPutStr(appBatchNumber, "000001");
+	dBeg = nowUs();
+	for (iRec = 0; iRec < iRecords; iRec++) {
+		recMap(iRec);
+		llSum += recAmount(iRec);
+		if (sqlite_Log_Save() <= 0)
+			iFail++;
+	}
+	printf("database %s, %d records saved in %.1f s\n", xCfg.pcDir, iRecords, (nowUs() - dBeg) / 1e6);
+
+	memset(&xCur, 0, sizeof(xCur));
+	dBeg = nowUs();
+	iRet = sqlite_Log_Each(CURRENCY, curRecord, &xCur);
+	printf("%-22s %8.1f ms  %d rows\n", "detailed cursor", (nowUs() - dBeg) / 1000, xCur.iRows);
+	printf("%-22s %8ld bytes SQLite, %ld bytes resident after row %d\n", "memory growth", xCur.lMemUp, xCur.lRssUp, CURSOR_SAMPLE);
+	check((iRet == iRecords) && (xCur.iRows == iRecords) && (xCur.llSum == llSum) && (xCur.iBad == 0), "detailed cursor gives every record");
+	check((xCur.lMemUp <= CURSOR_GROWTH) && (xCur.lRssUp <= CURSOR_RSS), "memory flat along the cursor");
+
+	memset(&xV1, 0, sizeof(xV1));
+	dBeg = nowUs();
+	v1Detailed(iRecords, &xV1);
+	printf("%-22s %8.1f ms  %d rows\n", "detailed former", (nowUs() - dBeg) / 1000, xV1.iRows);
+	check((xV1.iRows == iRecords) && (xV1.llSum == llSum), "former detailed report");
+
+	memset(&xCur, 0, sizeof(xCur));
+	dBeg = nowUs();
+	iRet = sqlite_Log_Groups(CURRENCY, curGroup, &xCur);
+	printf("%-22s %8.1f ms  %d rows\n", "summary cursor", (nowUs() - dBeg) / 1000, xCur.iRows);
+	check((iRet == 2) && (xCur.llSum == llSum) && (xCur.iBad == 0), "summary cursor gives each menu item");
+
+	memset(&xV1, 0, sizeof(xV1));
+	dBeg = nowUs();
+	v1Summary(&xV1);
+	printf("%-22s %8.1f ms  %d rows\n", "summary former", (nowUs() - dBeg) / 1000, xV1.iRows);
+	check((xV1.iRows == 2) && (xV1.llSum == llSum), "former summary report");
+
+	// The callback stops the cursor
+	memset(&xCur, 0, sizeof(xCur));
+	check(sqlite_Log_Each("XXXX", curRecord, &xCur) == 0, "no record in another currency");
+}
+
+void cursorBench(const char *pcArg) {
+	if (atoi(pcArg) > 0)
+		cursorRun(atoi(pcArg));
+}
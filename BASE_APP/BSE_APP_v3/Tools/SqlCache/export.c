@@ -0,0 +1,238 @@
+/*
+ * export.c
+ *
+ *  Run of -x: a log of that many records copied to the host disk as a
+ *  file, then exported by sqlite_Export, whole and then a day of changes
+ *  at a time, and applied to a database of the host by Tools/SqlExport;
+ *  the tables compared, and the exports lost, damaged or stopped followed.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define EXP_PER_DAY     200            // Sales a day in the export run
+#define EXP_LINK_BPS    11520.0        // Bytes a second of a serial link at 115200 bd
+
+//****************************************************************************
+//      EXPORT RUN
+//****************************************************************************
+static const char *tzExpTables[] = { "trn", "trn_ext", "trn_tot", "trn_closed" };
+static int iExpRec = 0;                // Next sale saved
+
+static long hostFile(const char *pcFile) {
+	char tcPath[512];
+	struct stat xSt;
+
+	snprintf(tcPath, sizeof(tcPath), "%s/host/%s", xCfg.pcDir, pcFile);
+	return (stat(tcPath, &xSt) == 0) ? (long)xSt.st_size : 0;
+}
+
+static unsigned char *expRead(long *plLen) {
+	char tcPath[512];
+	unsigned char *pucBuf;
+	FILE *pxFile;
+
+	snprintf(tcPath, sizeof(tcPath), "%s/host/TSLDELTA.BIN", xCfg.pcDir);
+	pxFile = fopen(tcPath, "rb");
+	if (pxFile == NULL)
+		return NULL;
+	fseek(pxFile, 0, SEEK_END);
+	*plLen = ftell(pxFile);
+	fseek(pxFile, 0, SEEK_SET);
+	pucBuf = malloc(*plLen + 1);
+	if (fread(pucBuf, 1, *plLen, pxFile) != (size_t)*plLen)
+		*plLen = 0;
+	fclose(pxFile);
+	return pucBuf;
+}
+
+// The export applied to the database of the host as sqlimport does, the
+// acknowledgement left on the host disk when bAck. pfnHurt damages the file
+// read before.
+static int expImport(tExpInfo *pxInfo, int bAck, long (*pfnHurt)(unsigned char *, long), double *pdUs) {
+	char tcPath[512];
+	unsigned char *pucBuf;
+	sqlite3 *hDb = NULL;
+	double dBeg;
+	long lLen = 0;
+	int iRet;
+
+	pucBuf = expRead(&lLen);
+	if (pucBuf == NULL)
+		return expBad;
+	if (pfnHurt)
+		lLen = pfnHurt(pucBuf, lLen);
+	benchOpen("import.db", &hDb);
+	dBeg = nowUs();
+	iRet = expApply(hDb, pucBuf, lLen, pxInfo);
+	if (pdUs)
+		*pdUs = nowUs() - dBeg;
+	sqlite3_close(hDb);
+	free(pucBuf);
+	if ((iRet >= 0) && bAck) {
+		snprintf(tcPath, sizeof(tcPath), "%s/host/TSLDELTA.ACK", xCfg.pcDir);
+		expAck(tcPath, pxInfo);
+	}
+	return iRet;
+}
+
+static long expTruncate(unsigned char *pucBuf, long lLen) { (void)pucBuf; return lLen - 3; }
+static long expFlip(unsigned char *pucBuf, long lLen) { pucBuf[lLen / 2] ^= 0x10; return lLen; }
+
+// Rows of the log tables that differ between the terminal and the host,
+// both ways; -1 when a table cannot be read.
+static int expDiff(void) {
+	char tcSql[600], tcPath[512];
+	sqlite3 *hDb = NULL;
+	sqlite3_stmt *hStmt;
+	size_t i;
+	int iDiff = 0;
+
+	benchOpen(DataBaseName, &hDb);
+	benchPath(tcPath, sizeof(tcPath), "import.db");
+	snprintf(tcSql, sizeof(tcSql), "ATTACH '%s' AS imp;", tcPath);
+	sqlite3_exec(hDb, tcSql, NULL, NULL, NULL);
+	for (i = 0; i < sizeof(tzExpTables) / sizeof(tzExpTables[0]); i++) {
+		sprintf(tcSql, "SELECT (SELECT COUNT(*) FROM (SELECT rowid, * FROM main.%s EXCEPT SELECT rowid, * FROM imp.%s))"
+		        " + (SELECT COUNT(*) FROM (SELECT rowid, * FROM imp.%s EXCEPT SELECT rowid, * FROM main.%s));",
+		        tzExpTables[i], tzExpTables[i], tzExpTables[i], tzExpTables[i]);
+		if ((sqlite3_prepare_v2(hDb, tcSql, -1, &hStmt, 0) != SQLITE_OK) || (sqlite3_step(hStmt) != SQLITE_ROW))
+			iDiff = -1;
+		else if (iDiff >= 0)
+			iDiff += sqlite3_column_int(hStmt, 0);
+		sqlite3_finalize(hStmt);
+	}
+	sqlite3_close(hDb);
+	return iDiff;
+}
+
+static int expRows(const char *pcSql) {
+	char tcPath[512];
+	sqlite3 *hDb = NULL;
+	sqlite3_stmt *hStmt;
+	int iRows = -1;
+
+	benchPath(tcPath, sizeof(tcPath), "import.db");
+	if (sqlite3_open_v2(tcPath, &hDb, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK) {
+		if (sqlite3_prepare_v2(hDb, pcSql, -1, &hStmt, 0) == SQLITE_OK) {
+			if (sqlite3_step(hStmt) == SQLITE_ROW)
+				iRows = sqlite3_column_int(hStmt, 0);
+			sqlite3_finalize(hStmt);
+		}
+	}
+	sqlite3_close(hDb);
+	return iRows;
+}
+
+// A day of sales, one commit each, voids among them.
+static void expDay(int iSales, tRun *pxRun) {
+	double dBeg;
+	int i;
+
+	for (i = 0; i < iSales; i++) {
+		dBeg = nowUs();
+		if (saleSave(iExpRec++, 1, 1) <= 0)
+			iFail++;
+		if (pxRun)
+			runAdd(pxRun, nowUs() - dBeg);
+	}
+}
+
+static void expLine(const char *pcName, long lBytes, double dUs) {
+	printf("%-22s %8ld bytes  %8.1f ms  %6.1f s at 115200 bd\n", pcName, lBytes, dUs / 1000, lBytes / EXP_LINK_BPS);
+}
+
+// Log of iRecords exported whole, then a day at a time, and applied on the
+// host; compared with the copy of the database file.
+static void exportRun(int iRecords) {
+	char tcPath[512];
+	tSqlExp xExp;
+	tExpInfo xInfo;
+	tRun xRun;
+	double dBeg, dImp;
+	long lTo;
+	int iRet;
+
+	SqliteDB_Init();
+	benchPath(tcPath, sizeof(tcPath), "import.db");
+	unlink(tcPath);
+	batchFill(0, iRecords, "000001");
+	iExpRec = iRecords;
+	printf("database %s, %d records, %d sales a day\n", xCfg.pcDir, iRecords, EXP_PER_DAY);
+
+	// Sales before the changes are noted
+	runInit(&xRun, EXP_PER_DAY);
+	expDay(EXP_PER_DAY, &xRun);
+	runReport("sale", &xRun, 0);
+
+	dBeg = nowUs();
+	check(SqliteApp_CopyFileToHost() == 0, "database file copied");
+	expLine("copy of the file", hostFile(strrchr(DataBaseName, '/') + 1), nowUs() - dBeg);
+
+	// First export: every row, whatever asked
+	dBeg = nowUs();
+	check(sqlite_Export(0, &xExp) == 1, "first export");
+	expLine("export full", xExp.Bytes, nowUs() - dBeg);
+	check(xExp.Full && (xExp.Bytes == hostFile("TSLDELTA.BIN")), "first export full, its size given");
+	iRet = expImport(&xInfo, 1, NULL, &dImp);
+	printf("%-22s %8ld rows  %8.1f ms  changes %lld..%lld\n", "import full", xInfo.lRows, dImp / 1000, xInfo.llFrom, xInfo.llTo);
+	check((iRet == expApplied) && (xInfo.uiCrc == xExp.Crc), "full export applied");
+	check(expDiff() == 0, "host holds the log tables after the full export");
+
+	// A day noted: sales, a settlement and a prune chunk of the closed batch
+	runInit(&xRun, EXP_PER_DAY);
+	expDay(EXP_PER_DAY, &xRun);
+	runReport("sale, changes noted", &xRun, 0);
+	check(sqlite_Log_Close() > 0, "batch closed");
+	mapPutStr(appBatchNumber, "000002");
+	check(sqlite_Log_Prune(0, LOG_PRUNE_ROWS) > 0, "closed batch pruned");
+	expDay(EXP_PER_DAY / 10, NULL);
+
+	dBeg = nowUs();
+	check(sqlite_Export(0, &xExp) == 1, "delta export");
+	expLine("export day", xExp.Bytes, nowUs() - dBeg);
+	printf("%-22s %8ld rows  %8ld deleted  changes %ld..%ld\n", "", xExp.Rows, xExp.Deletes, xExp.From, xExp.To);
+	check(!xExp.Full && xExp.Acked && (xExp.From == xInfo.llTo), "delta from the change acknowledged");
+	check(xExp.Deletes >= LOG_PRUNE_ROWS, "pruned rows exported as deleted");
+
+	// Acknowledgement lost: the next export again from the same change
+	iRet = expImport(&xInfo, 0, NULL, &dImp);
+	printf("%-22s %8ld rows  %8.1f ms\n", "import day", xInfo.lRows, dImp / 1000);
+	check(iRet == expApplied, "delta applied");
+	check(expDiff() == 0, "host holds the log tables after the delta");
+	lTo = xExp.From;
+	expDay(EXP_PER_DAY / 10, NULL);
+	check(sqlite_Export(0, &xExp) == 1, "export after an acknowledgement lost");
+	check(!xExp.Full && !xExp.Acked && (xExp.From == lTo), "export made again from the change acknowledged");
+	check(expImport(&xInfo, 1, NULL, NULL) == expApplied, "export again applied over the one lost");
+	check(expDiff() == 0, "host holds the log tables after the export again");
+
+	// Nothing changed: an empty export, already applied, acknowledged again
+	check(sqlite_Export(0, &xExp) == 1, "export without change");
+	check(xExp.Acked && (xExp.From == xExp.To) && (xExp.Rows + xExp.Deletes == 0), "export without change empty");
+	check(expImport(&xInfo, 1, NULL, NULL) == expAlready, "empty export already applied");
+
+	// Export damaged on the way: rejected, the host left as it was
+	expDay(EXP_PER_DAY / 10, NULL);
+	check(sqlite_Export(0, &xExp) == 1, "export to damage");
+	iRet = expRows("SELECT COUNT(*) FROM trn;");
+	check(expImport(&xInfo, 1, expTruncate, NULL) == expBad, "truncated export rejected");
+	check(expImport(&xInfo, 1, expFlip, NULL) == expBad, "corrupted export rejected");
+	check((expRows("SELECT COUNT(*) FROM trn;") == iRet) && (hostFile("TSLDELTA.ACK") == 0), "host left as it was, no acknowledgement");
+	check(expImport(&xInfo, 1, NULL, NULL) == expApplied, "export whole applied");
+	check(expDiff() == 0, "host holds the log tables after the export whole");
+
+	// Changes no longer noted, as on a disk short: the next export full
+	sqlite_Export_Stop();
+	expDay(EXP_PER_DAY / 10, NULL);
+	check(sqlite_Export(0, &xExp) == 1, "export after the changes stopped");
+	check(xExp.Full, "export full after the changes stopped");
+	check(expImport(&xInfo, 1, NULL, NULL) == expApplied, "full export applied again");
+	check(expDiff() == 0, "host holds the log tables after the full export again");
+	check(sqlite_Export(0, &xExp) == 1 && xExp.Acked && !xExp.Full, "delta once the full export acknowledged");
+}
+
+void exportBench(const char *pcArg) {
+	exportRun((atoi(pcArg) > VOID_EVERY) ? atoi(pcArg) : VOID_EVERY);
+}
@@ -0,0 +1,197 @@
+/*
+ * fill.c
+ *
+ *  Run of -f: the database held to a disk of that many KB, as the flash
+ *  disk of the terminal, and filled day after day by sales settled each
+ *  day, then by sales never settled, until sqlite_Capacity holds them; the
+ *  warning, the forecast and the room given back by the settlement
+ *  checked.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define FILL_PER_DAY    40             // Sales a day in the fill run
+#define FILL_IDLE_EVERY 10             // Sales between two passes of the idle task
+#define FILL_SETTLED    30             // Days settled each evening before the settlements stop
+#define FILL_DAYS_MAX   400            // Days without settlement before the run gives up
+#define FILL_IDLE_NIGHT 8              // Passes of the idle task between the settlement and the next day
+
+//****************************************************************************
+//      FILL RUN
+//****************************************************************************
+static int iFillRec = 0;               // Next record saved
+static int iFillBatch = 1;             // Open batch
+static int iFillErr = 0;               // Sales not saved
+
+static long fillFile(void) {
+	char tcPath[512];
+	struct stat xSt;
+
+	benchPath(tcPath, sizeof(tcPath), DataBaseName);
+	return (stat(tcPath, &xSt) == 0) ? (long)xSt.st_size : 0;
+}
+
+static int fillVacuumMode(void) {
+	sqlite3 *hDb = NULL;
+	sqlite3_stmt *hStmt = NULL;
+	int iMode = -1;
+
+	benchOpen(DataBaseName, &hDb);
+	if (sqlite3_prepare_v2(hDb, "PRAGMA auto_vacuum;", -1, &hStmt, 0) == SQLITE_OK) {
+		if (sqlite3_step(hStmt) == SQLITE_ROW)
+			iMode = sqlite3_column_int(hStmt, 0);
+		sqlite3_finalize(hStmt);
+	}
+	sqlite3_close(hDb);
+	return iMode;
+}
+
+// Pass of the store and forward task while idle
+static void fillIdle(void) {
+	tSqlCap xCap;
+	int iKeep = LOG_KEEP_BATCHES, iRows = LOG_PRUNE_ROWS, i;
+
+	if (sqlite_Capacity(&xCap) > capOk) {
+		iKeep = 0;
+		iRows = LOG_PRUNE_SHORT;
+	}
+	for (i = 0; i < LOG_PRUNE_CALLS; i++) {
+		if (sqlite_Log_Prune(iKeep, iRows) <= 0)
+			break;
+		if (iKeep == 0)
+			sqlite_Checkpoint();
+	}
+	for (i = 0; i < LOG_VACUUM_CALLS; i++) {
+		if (sqlite_Vacuum_Step(LOG_VACUUM_PAGES) <= 0)
+			break;
+		if (iKeep == 0)
+			sqlite_Checkpoint();
+	}
+	sqlite_Checkpoint();
+}
+
+// A day of sales, each first asked to sqlite_Capacity as MenuProcessingSelect
+// does, the capacity of the first one given. Returns the sales held.
+static int fillDay(tSqlCap *pxCap) {
+	char tcBatch[12];
+	tSqlCap xCap;
+	int iHeld = 0, iRet, i;
+
+	llSimShift += 86400000LL;
+	sprintf(tcBatch, "%06d", iFillBatch);
+	for (i = 0; i < FILL_PER_DAY; i++) {
+		iRet = sqlite_Capacity(&xCap);
+		if (i == 0)
+			*pxCap = xCap;
+		if (iRet == capFull) {
+			iHeld++;
+			continue;
+		}
+		recMap(iFillRec++);
+		mapPutStr(appBatchNumber, tcBatch);
+		sqlite_Txn_Begin();
+		iRet = sqlite_Log_Save();
+		if ((sqlite_Txn_End(iRet > 0) != 1) || (iRet <= 0))
+			iFillErr++;
+		if ((i % FILL_IDLE_EVERY) == FILL_IDLE_EVERY - 1)
+			fillIdle();
+	}
+	return iHeld;
+}
+
+// Settlement in the evening: the batch closed, the next one opened.
+static void fillSettle(void) {
+	char tcBatch[12];
+	int i;
+
+	sprintf(tcBatch, "%06d", iFillBatch);
+	mapPutStr(appBatchNumber, tcBatch);
+	check(sqlite_Log_Close() > 0, "batch closed");
+	sprintf(tcBatch, "%06d", ++iFillBatch);
+	mapPutStr(appBatchNumber, tcBatch);
+	for (i = 0; i < FILL_IDLE_NIGHT; i++)
+		fillIdle();
+}
+
+static void fillLine(int iDay, const tSqlCap *pxCap) {
+	static const char *tzLevel[] = { "ok", "warn", "full" };
+
+	printf("  day %3d  records %5ld  file %5ld KB  disk free %5ld KB  room %5ld KB  %5ld bytes/record  %5ld records left  %3d a day  %3d days left  %s\n",
+	       iDay, pxCap->Records, fillFile() / 1024, pxCap->DiskFree / 1024, pxCap->Room / 1024, pxCap->RecordBytes, pxCap->RecordsLeft,
+	       pxCap->PerDay, pxCap->DaysLeft, tzLevel[pxCap->Level]);
+}
+
+static void fillRun(int iKb) {
+	sqlite3 *hDb = NULL;
+	tSqlCap xCap;
+	long lMax = 0, lFile;
+	int iBad = 0, iWarn = -1, iWarnLeft = 0, iFull = -1, iDay;
+
+	simInit();
+	SqliteDB_Init();
+	check(fillVacuumMode() == 2, "new database in incremental auto-vacuum");
+
+	// Database made before: full auto-vacuum off, given the mode at its first open
+	SqliteDB_Init();
+	benchOpen(DataBaseName, &hDb);
+	sqlite3_exec(hDb, "PRAGMA auto_vacuum = NONE; VACUUM;", NULL, NULL, NULL);
+	sqlite3_close(hDb);
+	check(fillVacuumMode() == 0, "older database without auto-vacuum");
+	sqlite_Vacuum_Step(LOG_VACUUM_PAGES); // First query after power up
+	check(fillVacuumMode() == 2, "older database in incremental auto-vacuum once opened");
+
+	SqliteDB_Init();
+	lSimSize = (long)iKb * 1024;
+	printf("database %s, disk %d KB, %d sales a day, idle pass every %d sales\n", xCfg.pcDir, iKb, FILL_PER_DAY, FILL_IDLE_EVERY);
+
+	// Settled each evening: the log stays the size of the retention
+	for (iDay = 1; iDay <= FILL_SETTLED; iDay++) {
+		iBad += (fillDay(&xCap) != 0) || (xCap.Level != capOk);
+		fillSettle();
+		lFile = fillFile();
+		if (lFile > lMax)
+			lMax = lFile;
+		if (xCfg.iVerbose)
+			fillLine(iDay, &xCap);
+	}
+	sqlite_Capacity(&xCap);
+	printf("%-22s %6d days  file %ld KB at most  %ld bytes/record  %d days left\n", "settled daily", FILL_SETTLED, lMax / 1024, xCap.RecordBytes, xCap.DaysLeft);
+	check((iBad == 0) && (iFillErr == 0), "sales of the days settled all saved, no warning");
+
+	// Settlements missed: warned, then the sales held before the disk is full
+	for (iDay = 1; (iDay <= FILL_DAYS_MAX) && (iFull < 0); iDay++) {
+		if (fillDay(&xCap) > 0)
+			iFull = iDay;
+		if ((iWarn < 0) && (xCap.Level >= capWarn)) {
+			iWarn = iDay;
+			iWarnLeft = xCap.DaysLeft;
+		}
+		if (xCfg.iVerbose || (iDay == iWarn) || (iDay == iFull))
+			fillLine(iDay, &xCap);
+	}
+	printf("%-22s day %d, %d days forecast  sales held day %d  %d records in the log\n", "not settled: warned", iWarn, iWarnLeft, iFull, logCount());
+	check(iFull > 0, "sales held on a full disk");
+	check((iWarn > 0) && (iFull - iWarn >= CAP_WARN_DAYS), "warned CAP_WARN_DAYS days before the sales are held");
+	check(iWarnLeft <= iFull - iWarn, "sales held no sooner than forecast");
+	check((iFillErr == 0) && (iSimFull == 0), "no write failed for the room");
+	check(sqlite_Log_Check() == 0, "running totals kept on a full disk");
+
+	// Settlement: closed batches pruned until the room is back, their pages
+	// given back to the disk
+	lFile = fillFile();
+	fillSettle();
+	fillIdle();
+	sqlite_Capacity(&xCap);
+	printf("%-22s file %ld KB -> %ld KB  disk free %ld KB  %s\n", "settled", lFile / 1024, fillFile() / 1024, xCap.DiskFree / 1024, (xCap.Level == capOk) ? "ok" : "short");
+	check(fillFile() < lFile, "file shrunk by the settlement");
+	check(xCap.Level == capOk, "room back after the settlement");
+	check((fillDay(&xCap) == 0) && (iFillErr == 0), "sales saved again");
+	lSimSize = 0;
+}
+
+void fillBench(const char *pcArg) {
+	if (atoi(pcArg) > 0)
+		fillRun(atoi(pcArg));
+}
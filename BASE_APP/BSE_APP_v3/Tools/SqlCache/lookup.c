@@ -0,0 +1,273 @@
+/*
+ * lookup.c
+ *
+ *  Default run: the insert of logSave, sqlite_Get_LOG_Record and
+ *  Sqlite_Get_Parameter timed on the shared handle. The insert bound from
+ *  the data map is compared with the former one built by sprintf, in time
+ *  and in peak stack. A second thread works the advice queue during the
+ *  last run, as the background sender does, to check the tasks sharing the
+ *  handle. The running totals are checked first.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define PARAMS          64             // Rows of the parameters table
+#define SAVE_RUN        500            // Inserts timed in each logSave run
+#define STACK_CALLS     50             // Calls in each stack measure
+#define STACK_SIZE      (256 * 1024)   // Stack of the thread running each measured call
+#define STACK_PAINT     0xA5
+
+//****************************************************************************
+//      LOOKUP RUNS
+//****************************************************************************
+// logSave before the bound insert: the fields read from the map into
+// globals, then one INSERT text built in 8 KB on the stack.
+static const word tzV1Key[] = {
+		traMnuItm, traInvNum, appBatchNumber, traRqsMTI, traPan, traRqsProcessingCode, traAmt, traDatTim,
+		traSTAN, traExpDat, traPosEntMod, traCrdSeq, appNII, traConCode, traTrk2, traRrn, traAutCod,
+		traRspCod, appTID, appMID, emvTrnCurCod, traCashbackAmt, traBillerPaymentDetails, traField063,
+		traDrCr, traNetTiming,
+};
+static char tzV1Fld[sizeof(tzV1Key) / sizeof(tzV1Key[0])][2048 + 1];
+
+static int v1LogSave(void) {
+	char Statement[8192];
+	char DataResponse[256];
+	const char *pcEmv = isoField055;
+	int i;
+
+	memset(DataResponse, 0, sizeof(DataResponse));
+	memset(Statement, 0, sizeof(Statement));
+	for (i = 0; i < (int)(sizeof(tzV1Key) / sizeof(tzV1Key[0])); i++)
+		mapGet(tzV1Key[i], tzV1Fld[i], sizeof(tzV1Fld[i]));
+	if ((strlen(isoField055) % 2) || (strspn(isoField055, "0123456789ABCDEFabcdef") != strlen(isoField055)))
+		pcEmv = "";
+	if (snprintf(Statement, sizeof(Statement), "INSERT INTO log (MenuItem, InvoiceNo, BatchNo, isoField000, isoField002, isoField003, isoField004, isoField007, isoField011, isoField014, isoField022, isoField023, isoField024, isoField025, isoField035, isoField037, isoField038, isoField039, isoField041, isoField042, isoField049, isoField054, isoField055, isoField062, isoField063, isoDrCr, isoVoided, NetTiming) VALUES ('%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,'%s' ,X'%s' ,'%s' ,'%s' ,'%s' ,'0' ,'%s');",
+	        tzV1Fld[0], tzV1Fld[1], tzV1Fld[2], tzV1Fld[3], tzV1Fld[4], tzV1Fld[5], tzV1Fld[6], tzV1Fld[7], tzV1Fld[8], tzV1Fld[9],
+	        tzV1Fld[10], tzV1Fld[11], tzV1Fld[12], tzV1Fld[13], tzV1Fld[14], tzV1Fld[15], tzV1Fld[16], tzV1Fld[17], tzV1Fld[18], tzV1Fld[19],
+	        tzV1Fld[20], tzV1Fld[21], pcEmv, tzV1Fld[22], tzV1Fld[23], tzV1Fld[24], tzV1Fld[25]) >= (int)sizeof(Statement))
+		return -1;
+	return Sqlite_Run_Statement(Statement, DataResponse);
+}
+
+static void runV1LogSave(int iFrom, int iTo, tRun *pxRun) {
+	double dBeg;
+	int iRec;
+
+	for (iRec = iFrom; iRec < iTo; iRec++) {
+		recMap(iRec);
+		dBeg = nowUs();
+		if (v1LogSave() <= 0)
+			iMixErr++;
+		runAdd(pxRun, nowUs() - dBeg);
+	}
+}
+
+// Peak stack of iCalls saves: each save runs in a thread on a stack painted
+// before it, and the part overwritten is measured after it, less what the
+// thread takes without a save.
+static unsigned char tucStack[STACK_SIZE] __attribute__((aligned(64)));
+static int (*pfnStackSave)(void) = NULL;
+
+static void *stackRun(void *pvArg) {
+	(void)pvArg;
+	if (pfnStackSave)
+		pfnStackSave();
+	return NULL;
+}
+
+static int stackUsed(int (*pfnSave)(void)) {
+	pthread_attr_t xAttr;
+	pthread_t hThread;
+	int i;
+
+	memset(tucStack, STACK_PAINT, sizeof(tucStack));
+	pfnStackSave = pfnSave;
+	pthread_attr_init(&xAttr);
+	pthread_attr_setstack(&xAttr, tucStack, sizeof(tucStack));
+	if (pthread_create(&hThread, &xAttr, stackRun, NULL) == 0)
+		pthread_join(hThread, NULL);
+	pthread_attr_destroy(&xAttr);
+	for (i = 0; (i < STACK_SIZE) && (tucStack[i] == STACK_PAINT); i++)
+		;
+	return STACK_SIZE - i;
+}
+
+static int stackPeak(int (*pfnSave)(void), int iFrom, int iCalls) {
+	int iBase, iPeak = 0, iUsed, i;
+
+	iBase = stackUsed(NULL);
+	for (i = 0; i < iCalls; i++) {
+		recMap(iFrom + i);
+		iUsed = stackUsed(pfnSave) - iBase;
+		if (iUsed > iPeak)
+			iPeak = iUsed;
+	}
+	return iPeak;
+}
+
+static void runFindLast(int iRecords, int iQueries, tRun *pxRun) {
+	char tcStan[16], tcGot[lenSTAN + 3];
+	double dBeg;
+	int i, iRet, iBad = 0;
+
+	recStan(tcStan, recLast(iRecords));
+	for (i = 0; i < iQueries; i++) {
+		mapPutStr(traSTAN, "");
+		dBeg = nowUs();
+		iRet = sqlite_Get_LOG_Record(0, 0, 0);
+		runAdd(pxRun, nowUs() - dBeg);
+
+		mapGet(traSTAN, tcGot, sizeof(tcGot));
+		iBad += (iRet <= 0) || (strcmp(tcGot, tcStan) != 0);
+	}
+	check(iBad == 0, "sqlite_Get_LOG_Record last");
+}
+
+static void runParam(int iQueries, tRun *pxRun) {
+	char tcName[32], tcWant[32], tcGot[256];
+	double dBeg;
+	int i, iPar, iBad = 0;
+
+	for (i = 0; i < iQueries; i++) {
+		iPar = rand() % PARAMS;
+		sprintf(tcName, "param%02d", iPar);
+		sprintf(tcWant, "value%02d", iPar);
+		memset(tcGot, 0, sizeof(tcGot));
+		dBeg = nowUs();
+		Sqlite_Get_Parameter(tcName, tcGot);
+		runAdd(pxRun, nowUs() - dBeg);
+		iBad += (strcmp(tcGot, tcWant) != 0);
+	}
+	check(iBad == 0, "Sqlite_Get_Parameter");
+}
+
+// Running totals added to a typed log made before them, then a drift made
+// behind the triggers found and repaired by the check.
+static void runTotals(void) {
+	tLogTot tzTot[logTotEnd];
+	sqlite3 *hDb = NULL;
+	char tcSql[512];
+
+	benchOpen(DataBaseName, &hDb);
+	benchExec(hDb, "DROP TRIGGER trn_tot_insert; DROP TRIGGER trn_tot_update_old; DROP TRIGGER trn_tot_update_new; DROP TRIGGER trn_tot_delete; DROP TABLE trn_tot;");
+	sprintf(tcSql, "INSERT INTO log (MenuItem, BatchNo, isoField004, isoField039, isoField049, isoDrCr) VALUES "
+	        "('%d', '1', '000000000100', '00', '" CURRENCY "', 'D'), ('%d', '1', '000000000250', '00', '" CURRENCY "', 'D'), "
+	        "('%d', '1', '000000000040', '00', '" CURRENCY "', 'C'), ('%d', '1', '000000000900', '05', '" CURRENCY "', 'D'), "
+	        "('%d', '2', '000000000700', '00', '" CURRENCY "', 'D');", mnuSale, mnuSale, mnuVoid, mnuSale, mnuSale);
+	benchExec(hDb, tcSql);
+	sqlite3_close(hDb);
+
+	mapPutStr(appBatchNumber, "000001");
+	sqlite_Log_Totals(CURRENCY, tzTot);    // First query: totals made from the records
+	check(!strcmp(tzTot[logTotDebit].Count, "2") && !strcmp(tzTot[logTotDebit].Sum, "350") &&
+	      !strcmp(tzTot[logTotCredit].Count, "1") && !strcmp(tzTot[logTotCredit].Sum, "40"), "running totals added to the log");
+
+	Sqlite_Run_Statement("DELETE FROM trn WHERE id = 1;", tcSql);
+	check(sqlite_Log_Check() == 0, "record deleted with its totals");
+	sprintf(tcSql, "UPDATE trn_tot SET Cnt = Cnt + 1, Amount = Amount + 100 WHERE BatchNo = 1 AND DrCr = 'D' AND MenuItem = %d;", mnuSale);
+	Sqlite_Run_Statement(tcSql, tcSql);
+	check(sqlite_Log_Check() == 1, "drift found by the check");
+	sqlite_Log_Totals(CURRENCY, tzTot);
+	check(!strcmp(tzTot[logTotDebit].Count, "1") && !strcmp(tzTot[logTotDebit].Sum, "250"), "totals given again from the log");
+	check(sqlite_Log_Check() == 0, "no drift after the repair");
+	SqliteDB_Init();
+}
+
+void lookupBench(const char *pcArg) {
+	char tcSql[256], tcRsp[256];
+	pthread_t hMix;
+	tRun xRun;
+	double dEnd;
+	int iOpen, iRecords, iMix, i;
+
+	(void)pcArg;
+	// Fresh database, as after a parameter download
+	SqliteDB_Init();
+	runTotals();
+	Sqlite_Run_Statement("CREATE TABLE IF NOT EXISTS parameters (id INTEGER PRIMARY KEY AUTOINCREMENT, paramName TEXT, details TEXT);", tcRsp);
+	for (i = 0; i < PARAMS; i++) {
+		sprintf(tcSql, "INSERT INTO parameters (paramName, details) VALUES ('param%02d', 'value%02d');", i, i);
+		Sqlite_Run_Statement(tcSql, tcRsp);
+	}
+	printf("database %s, %d records, %d queries per lookup run\n", xCfg.pcDir, xCfg.iRecords, xCfg.iQueries);
+
+	iRecords = xCfg.iRecords;
+	runInit(&xRun, iRecords);
+	iOpen = iOpens;
+	runLogSave(0, iRecords, &xRun);
+	runReport("logSave", &xRun, iOpens - iOpen);
+	check((logCount() == iRecords) && (iMixErr == 0), "log records saved");
+
+	runInit(&xRun, xCfg.iQueries);
+	iOpen = iOpens;
+	runFindStan(iRecords, xCfg.iQueries, &xRun);
+	runReport("Get_LOG_Record STAN", &xRun, iOpens - iOpen);
+
+	runInit(&xRun, xCfg.iQueries);
+	iOpen = iOpens;
+	runFindLast(iRecords, xCfg.iQueries, &xRun);
+	runReport("Get_LOG_Record last", &xRun, iOpens - iOpen);
+
+	runInit(&xRun, xCfg.iQueries);
+	iOpen = iOpens;
+	runParam(xCfg.iQueries, &xRun);
+	runReport("Get_Parameter", &xRun, iOpens - iOpen);
+
+	// Void the last record, the reprint must fall back to the one before
+	recStan(tcSql, iRecords - 1);
+	sqlite_CloseVoid(tcSql);
+	mapPutStr(traSTAN, tcSql);
+	check(sqlite_Get_LOG_Record(0, 0, traSTAN) <= 0, "voided record left out");
+
+	// Insert bound from the map against the former one built by sprintf
+	iMix = iRecords;
+	runInit(&xRun, SAVE_RUN);
+	runV1LogSave(iMix, iMix + SAVE_RUN, &xRun);
+	runReport("logSave sprintf", &xRun, 0);
+	iMix += SAVE_RUN;
+	runInit(&xRun, SAVE_RUN);
+	runLogSave(iMix, iMix + SAVE_RUN, &xRun);
+	runReport("logSave bound", &xRun, 0);
+	iMix += SAVE_RUN;
+	printf("%-22s %6d bytes\n", "stack logSave sprintf", stackPeak(v1LogSave, iMix, STACK_CALLS));
+	iMix += STACK_CALLS;
+	printf("%-22s %6d bytes\n", "stack logSave bound", stackPeak(sqlite_Log_Save, iMix, STACK_CALLS));
+	iMix += STACK_CALLS;
+	check((logCount() == iMix) && (iMixErr == 0), "log records saved by both inserts");
+
+	// A quote in a field: the text built by sprintf breaks, the bound one not
+	recMap(iMix);
+	mapPutStr(traBillerPaymentDetails, "O'BRIEN & SONS");
+	check(v1LogSave() <= 0, "sprintf insert broken by a quote");
+	check(sqlite_Log_Save() > 0, "bound insert with a quote");
+	iMix++;
+	memset(tcRsp, 0, sizeof(tcRsp));
+	sprintf(tcSql, "SELECT isoField062 FROM log WHERE id = %d;", iMix);
+	Sqlite_Run_Statement(tcSql, tcRsp);
+	check(strcmp(tcRsp, "O'BRIEN & SONS") == 0, "quote saved as given");
+
+	// Foreground saving and reading while the advice sender runs
+	bMixStop = 0;
+	pthread_create(&hMix, NULL, mixAdvice, NULL);
+	runInit(&xRun, 1000000);
+	dEnd = nowUs() + MIX_MS * 1000.0;
+	while (nowUs() < dEnd) {
+		runLogSave(iMix, iMix + 1, &xRun);
+		iMix++;
+		mapPutStr(traSTAN, "");
+		if (sqlite_Get_LOG_Record(0, 0, 0) <= 0)
+			iMixErr++;
+	}
+	bMixStop = 1;
+	pthread_join(hMix, NULL);
+	runReport("logSave + advices", &xRun, 0);
+	printf("%-22s %6d advices queued, read and delivered meanwhile\n", "", iMixOps);
+	check(logCount() == iMix, "log records saved beside the advices");
+	check(iMixErr == 0, "queries failed beside the advices");
+	check(sqlite_Log_Check() == 0, "running totals kept by logSave and the void");
+	if (xCfg.iVerbose)
+		printf("errors %d, log %d/%d\n", iMixErr, logCount(), iMix);
+}
@@ -0,0 +1,312 @@
+/*
+ * menu.c
+ *
+ *  Run of -m: the menus written into AppMenus statement by statement, as
+ *  before the menu tree, then bound in one commit, and the menus shown
+ *  through the former query and its parse, then from the menu tree.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define MENU_TOP        5              // Menus of the main menu
+#define MENU_WRITES     20             // Menu writes timed, as on a new software
+
+//****************************************************************************
+//      MENU RUN
+//****************************************************************************
+// Menus shaped as those of MenuManager.c: customer, merchant, agent,
+// supervisor (hidden) and admin menus, with that many items each
+static const int tiMenuItems[MENU_TOP] = { 18, 11, 1, 0, 12 };
+
+typedef struct {
+	word Id;
+	word Parent;
+	byte Hidden;
+	byte Secure;
+	byte Level;
+	char Name[20 + 1];
+	char Icon[64 + 1];
+} tMenuDef;
+
+static tMenuDef tzMenuDef[MENU_TOP * 20];
+static int iMenuDefs = 0;
+
+static void menuDefs(void) {
+	tMenuDef *pxDef;
+	int iTop, iItm;
+
+	iMenuDefs = 0;
+	for (iTop = 0; iTop < MENU_TOP; iTop++) {
+		for (iItm = -1; iItm < tiMenuItems[iTop]; iItm++) {
+			pxDef = &tzMenuDef[iMenuDefs++];
+			pxDef->Id = (word)((iTop + 1) * 100 + iItm + 1);
+			pxDef->Parent = (word)((iItm < 0) ? 0 : (iTop + 1) * 100);
+			pxDef->Hidden = (byte)((iItm < 0) ? (iTop == 3) : ((iItm % 4) == 1));
+			pxDef->Secure = (byte)((iItm < 0) && (iTop != 0));
+			pxDef->Level = (byte)(iTop + 1);
+			sprintf(pxDef->Name, "MENU %03d         ", pxDef->Id);
+			sprintf(pxDef->Icon, "file://flash/HOST/TU.TAR/icones/menu%03d.png", pxDef->Id);
+		}
+	}
+}
+
+// Former menu write: the statements built by sprintf, run one by one through
+// a handle of their own, each committed alone.
+static void v1MenuWrite(void) {
+	char tcSql[256];
+	sqlite3 *hDb = NULL;
+	int i;
+
+	benchOpen(DataBaseName, &hDb);
+	for (i = 0; i < iMenuDefs; i++) {
+		sprintf(tcSql, "INSERT INTO AppMenus (MenuId, MenuName, MenuIdParent, Hidden, SecureMenu, SecureMenuLevel, DrCr, IconPathName) VALUES ('%d', '%s', '%d', '%d','%d' ,'%d', ' ', '%s');",
+		        tzMenuDef[i].Id, tzMenuDef[i].Name, tzMenuDef[i].Parent, tzMenuDef[i].Hidden, tzMenuDef[i].Secure, tzMenuDef[i].Level, tzMenuDef[i].Icon);
+		benchExec(hDb, tcSql);
+	}
+	sqlite3_close(hDb);
+}
+
+// Menu write of Generate_Menu_Content: bound inserts, one commit.
+static void menuWrite(void) {
+	int iRet = 1, i;
+
+	sqlite_Txn_Begin();
+	for (i = 0; (i < iMenuDefs) && (iRet > 0); i++)
+		iRet = Sqlite_Put_Menu(tzMenuDef[i].Id, tzMenuDef[i].Name, tzMenuDef[i].Parent, tzMenuDef[i].Hidden, tzMenuDef[i].Secure, tzMenuDef[i].Level, " ", tzMenuDef[i].Icon);
+	check(sqlite_Txn_End(iRet > 0) == 1, "menu written");
+}
+
+static int v1TokLen(const char *pcSrc, char cSep) {
+	const char *pc = strchr(pcSrc, cSep);
+
+	return pc ? (int)(pc - pcSrc) : (int)strlen(pcSrc);
+}
+
+// fmtTok of globals.c, one separator
+static int v1Tok(char *pcDst, const char *pcSrc, char cSep) {
+	int iLen = v1TokLen(pcSrc, cSep);
+
+	memcpy(pcDst, pcSrc, iLen);
+	pcDst[iLen] = 0;
+	return iLen;
+}
+
+// Menu as Manage_Application_Menu held it before the menu tree
+typedef struct {
+	char tcId[40][5];
+	char tcName[40][100];
+	char tcIcon[40][100];
+	char tcSecure[40][5];
+	char tcLevel[40][5];
+} tV1Menu;
+
+// Former Sqlite_Get_Menu, the statement kept between calls as the cache did,
+// and the parse of its text by Manage_Application_Menu.
+static int v1Menu(sqlite3_stmt *hStmt, word usParent, tV1Menu *pxMnu) {
+	static char tcBuf[32 * 5 * 80];
+	char tcParent[8], tcRec[512], tcCol[100];
+	char *tpcRec[100], *pcCol, *pcVal;
+	const char *pcTxt;
+	int iCnt = 0, iRec, iCol;
+
+	memset(tcBuf, 0, sizeof(tcBuf));
+	sprintf(tcParent, "%d", usParent);
+	sqlite3_bind_text(hStmt, 1, tcParent, -1, SQLITE_STATIC);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		for (iCol = 0; iCol < sqlite3_column_count(hStmt); iCol++) {
+			pcTxt = (const char *)sqlite3_column_text(hStmt, iCol);
+			strcat(tcBuf, sqlite3_column_name(hStmt, iCol));
+			strcat(tcBuf, ",");
+			if (pcTxt)
+				strcat(tcBuf, pcTxt);
+			strcat(tcBuf, ";");
+		}
+		strcat(tcBuf, "#");
+		iCnt++;
+	}
+	sqlite3_reset(hStmt);
+
+	tpcRec[0] = strtok(tcBuf, "#");
+	for (iRec = 1; iRec < iCnt; iRec++)
+		tpcRec[iRec] = strtok(NULL, "#");
+	for (iRec = 0; iRec < iCnt; iRec++) {
+		strcpy(tcRec, tpcRec[iRec]);
+		for (pcCol = strtok(tcRec, ";"); pcCol; pcCol = strtok(NULL, ";")) {
+			pcVal = pcCol + v1Tok(tcCol, pcCol, ',') + 1;
+			if (strncmp(tcCol, "MenuId", 6) == 0)
+				v1Tok(pxMnu->tcId[iRec], pcVal, ',');
+			else if (strncmp(tcCol, "MenuName", 8) == 0)
+				v1Tok(pxMnu->tcName[iRec], pcVal, ',');
+			else if (strncmp(tcCol, "IconPathName", 12) == 0)
+				v1Tok(pxMnu->tcIcon[iRec], pcVal, ',');
+			else if (strncmp(tcCol, "SecureMenuLevel", 15) == 0)
+				v1Tok(pxMnu->tcLevel[iRec], pcVal, ',');
+			else if (strncmp(tcCol, "SecureMenu", 10) == 0)
+				v1Tok(pxMnu->tcSecure[iRec], pcVal, ',');
+		}
+	}
+	return iCnt;
+}
+
+// Menu tree of MenuManager.c
+typedef struct {
+	word Id;
+	word Parent;
+	byte Hidden;
+	byte Secure;
+	byte Level;
+	char Name[32 + 1];
+	char Icon[64 + 1];
+} tMenuItem;
+
+static tMenuItem tzMenuTree[64];
+static int iMenuTreeCnt = -1;
+
+static int menuTreeRow(const tSqlRow *Row, void *Ctx) {
+	tMenuItem *pxItm;
+
+	(void)Ctx;
+	if (iMenuTreeCnt >= (int)(sizeof(tzMenuTree) / sizeof(tzMenuTree[0])))
+		return -1;
+	pxItm = &tzMenuTree[iMenuTreeCnt++];
+	memset(pxItm, 0, sizeof(*pxItm));
+	pxItm->Id = (word)Row->Int[mnuRowId];
+	pxItm->Parent = (word)Row->Int[mnuRowParent];
+	pxItm->Hidden = (byte)Row->Int[mnuRowHidden];
+	pxItm->Secure = (byte)Row->Int[mnuRowSecure];
+	pxItm->Level = (byte)Row->Int[mnuRowLevel];
+	strncpy(pxItm->Name, Row->Text[mnuRowName], sizeof(pxItm->Name) - 1);
+	strncpy(pxItm->Icon, Row->Text[mnuRowIcon], sizeof(pxItm->Icon) - 1);
+	return 1;
+}
+
+static int menuTreeChildren(word usParent, const tMenuItem **pxChild, int iMax) {
+	int iCnt = 0, i;
+
+	if (iMenuTreeCnt < 0) {
+		iMenuTreeCnt = 0;
+		if (sqlite_Menu_Each(menuTreeRow, NULL) < 0) {
+			iMenuTreeCnt = -1;
+			return -1;
+		}
+	}
+	for (i = 0; (i < iMenuTreeCnt) && (iCnt < iMax); i++) {
+		if ((tzMenuTree[i].Parent == usParent) && !tzMenuTree[i].Hidden)
+			pxChild[iCnt++] = &tzMenuTree[i];
+	}
+	return iCnt;
+}
+
+static word menuParent(int i) {
+	return (word)((i % (MENU_TOP + 1)) * 100);
+}
+
+// Each menu shown from the tree as given by the former query and parse.
+static void menuCompare(sqlite3_stmt *hStmt, const char *pcWhat) {
+	static tV1Menu xV1;
+	const tMenuItem *tpxItm[40];
+	int iBad = 0, iItems = 0, iCnt, i, j;
+
+	for (i = 0; i <= MENU_TOP; i++) {
+		memset(&xV1, 0, sizeof(xV1));
+		iCnt = v1Menu(hStmt, menuParent(i), &xV1);
+		iBad += (menuTreeChildren(menuParent(i), tpxItm, 39) != iCnt);
+		for (j = 0; (j < iCnt) && (iBad == 0); j++) {
+			iBad += (atoi(xV1.tcId[j]) != tpxItm[j]->Id) || (strcmp(xV1.tcName[j], tpxItm[j]->Name) != 0);
+			iBad += (strcmp(xV1.tcIcon[j], tpxItm[j]->Icon) != 0);
+			iBad += (atoi(xV1.tcSecure[j]) != tpxItm[j]->Secure) || (atoi(xV1.tcLevel[j]) != tpxItm[j]->Level);
+		}
+		iItems += iCnt;
+	}
+	check((iBad == 0) && (iItems > 0), pcWhat);
+}
+
+static void menuRun(void) {
+	static tV1Menu xV1;
+	const tMenuItem *tpxItm[40];
+	sqlite3_stmt *hStmt = NULL;
+	sqlite3 *hDb = NULL;
+	tRun xRun;
+	double dBeg;
+	int iSync, iCommit, iCnt, i;
+
+	menuDefs();
+	SqliteDB_Init();
+	benchOpen(DataBaseName, &hDb);
+	printf("database %s, %d menu items, %d writes, %d menus shown per run\n", xCfg.pcDir, iMenuDefs, MENU_WRITES, xCfg.iQueries);
+
+	// Menu written on a new software: statement by statement, then bound in one commit
+	runInit(&xRun, MENU_WRITES);
+	for (i = 0; i < MENU_WRITES; i++) {
+		benchExec(hDb, "DELETE FROM AppMenus;");
+		iSync = iSyncs;
+		iCommit = iCommits;
+		dBeg = nowUs();
+		v1MenuWrite();
+		runAdd(&xRun, nowUs() - dBeg);
+		iSync = iSyncs - iSync;
+		iCommit = iCommits - iCommit;
+	}
+	runReport("menu write sprintf", &xRun, 0);
+	printf("%-22s %6d syncs  %d commits per write\n", "", iSync, iCommit);
+	check(rowCount("SELECT COUNT(*) FROM AppMenus;") == iMenuDefs, "menu written in full by the statements");
+	runInit(&xRun, MENU_WRITES);
+	for (i = 0; i < MENU_WRITES; i++) {
+		benchExec(hDb, "DELETE FROM AppMenus;");
+		iSync = iSyncs;
+		iCommit = iCommits;
+		dBeg = nowUs();
+		menuWrite();
+		runAdd(&xRun, nowUs() - dBeg);
+		iSync = iSyncs - iSync;
+		iCommit = iCommits - iCommit;
+	}
+	runReport("menu write bound", &xRun, 0);
+	printf("%-22s %6d syncs  %d commits per write\n", "", iSync, iCommit);
+	check(rowCount("SELECT COUNT(*) FROM AppMenus;") == iMenuDefs, "menu written in full");
+
+	// Menus shown: former query and parse, then the tree
+	sqlite3_prepare_v2(hDb, "SELECT MenuId,MenuName,SecureMenu,SecureMenuLevel,IconPathName FROM AppMenus WHERE Hidden = '0' and MenuIdParent = ?;", -1, &hStmt, 0);
+	menuCompare(hStmt, "menu tree gives what the query gives");
+	runInit(&xRun, MENU_WRITES);
+	for (i = 0; i < MENU_WRITES; i++) {
+		iMenuTreeCnt = -1;
+		dBeg = nowUs();
+		iCnt = menuTreeChildren(0, tpxItm, 39);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("menu tree read", &xRun, 0);
+	check(iCnt == MENU_TOP - 1, "main menu read from AppMenus");
+	runInit(&xRun, xCfg.iQueries);
+	for (i = 0; i < xCfg.iQueries; i++) {
+		memset(&xV1, 0, sizeof(xV1));
+		dBeg = nowUs();
+		v1Menu(hStmt, menuParent(i), &xV1);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("menu shown query", &xRun, 0);
+	runInit(&xRun, xCfg.iQueries);
+	for (i = 0; i < xCfg.iQueries; i++) {
+		dBeg = nowUs();
+		menuTreeChildren(menuParent(i), tpxItm, 39);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("menu shown tree", &xRun, 0);
+
+	// Terminal mode changed: items moved, shown, hidden and renamed, the tree read again
+	benchExec(hDb, "UPDATE AppMenus SET MenuIdParent = '100', Hidden = '0' WHERE MenuId = '202';");
+	benchExec(hDb, "UPDATE AppMenus SET Hidden = '1' WHERE MenuId = '101';");
+	benchExec(hDb, "UPDATE AppMenus SET MenuName = 'OTHER FUNCTIONS' WHERE MenuId = '200';");
+	iMenuTreeCnt = -1;
+	menuCompare(hStmt, "menu tree gives what the query gives after a change");
+
+	sqlite3_finalize(hStmt);
+	sqlite3_close(hDb);
+}
+
+void menuBench(const char *pcArg) {
+	(void)pcArg;
+	menuRun();
+}
@@ -0,0 +1,234 @@
+/*
+ * param.c
+ *
+ *  Run of -a: the parameters and the columns of the aid table read by an
+ *  EMV transaction read through the former queries, then from the cache,
+ *  the values compared, and the cache followed through updates, rollbacks
+ *  and tables too large for it.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define PARAM_ROWS      24             // Rows of the parameters table in the cache run
+#define PARAM_MORE      16             // Rows added past the cache
+#define AID_MORE        24             // Rows added to the aid table past the cache
+
+//****************************************************************************
+//      PARAMETER RUN
+//****************************************************************************
+// Columns read by __EMV_ServicesEmv_GetAidData for each transaction
+static const char *tzAidTxn[] = {
+	"emvTrmAvn", "emvTrmFlrLim", "emvThrVal", "emvTarPer", "emvMaxTarPer",
+	"emvTACDen", "emvTACOnl", "emvTACDft", "emvDftValDDOL", "emvDftValTDOL",
+	"emvAidName"
+};
+
+// Columns compared, with one the table has not
+static const char *tzAidAll[] = {
+	"emvAidName", "emvAid", "emvTACDft", "emvTACDen", "emvTACOnl",
+	"emvThrVal", "emvTarPer", "emvMaxTarPer", "emvDftValDDOL", "emvDftValTDOL",
+	"emvTrmAvn", "emvAcqId", "emvTrmFlrLim", "emvTCC", "emvAidTxnType", "emvNone"
+};
+
+static int iWatchCnt = 0;              // Calls of paramWatch
+static char tcWatchName[32];           // Name given by the last one, "*" for NULL
+
+static void paramWatch(const char *Name, const char *Value) {
+	(void)Value;
+	iWatchCnt++;
+	strcpy(tcWatchName, Name ? Name : "*");
+}
+
+// Former Sqlite_Get_Parameter: the statement kept between calls as the
+// statement cache did.
+static void v1Param(sqlite3_stmt *hStmt, const char *pcName, char *pcData) {
+	const char *pcVal;
+
+	sqlite3_reset(hStmt);
+	sqlite3_bind_text(hStmt, 1, pcName, -1, SQLITE_STATIC);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		pcVal = (const char *)sqlite3_column_text(hStmt, 2);
+		if (pcVal != NULL)
+			strcpy(pcData, pcVal);
+	}
+}
+
+// Former get_Bin_AID_Data: the statement built by sprintf, then again with
+// the first 10 digits of the AID when nothing was found.
+static void v1Aid(const char *pcCol, const char *pcAid, char *pcData) {
+	char tcSql[256], tcLike[lenAID + 3];
+
+	memset(pcData, 0, 256);
+	sprintf(tcLike, "%%%s%%", pcAid);
+	sprintf(tcSql, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", pcCol, tcLike);
+	Sqlite_Run_Statement(tcSql, pcData);
+	if (strlen(pcData) < 1) {
+		sprintf(tcLike, "%%%.10s%%", pcAid);
+		sprintf(tcSql, "SELECT %s FROM aid WHERE emvAid LIKE '%s';", pcCol, tcLike);
+		Sqlite_Run_Statement(tcSql, pcData);
+	}
+}
+
+// Each parameter and each column of each AID given, from the cache and by
+// the former queries: the same text.
+static void paramCompare(sqlite3_stmt *hStmt, int iRows, const char *pcWhat) {
+	static const char *tzAidKey[] = {
+		"A0000000031010", "a0000000041010", "A000000003", "A0000000039999", "B0000000041010", ""
+	};
+	char tcName[32], tcWant[256], tcGot[256];
+	int iBad = 0, i, j;
+
+	for (i = 0; i < iRows + 2; i++) {
+		sprintf(tcName, "param%02d", i);
+		strcpy(tcWant, "left");
+		strcpy(tcGot, "left");
+		v1Param(hStmt, tcName, tcWant);
+		Sqlite_Get_Parameter(tcName, tcGot);
+		iBad += (strcmp(tcWant, tcGot) != 0);
+		if (xCfg.iVerbose && strcmp(tcWant, tcGot))
+			printf("  %s: '%s' '%s'\n", tcName, tcWant, tcGot);
+	}
+	for (i = 0; i < (int)(sizeof(tzAidKey) / sizeof(tzAidKey[0])); i++) {
+		for (j = 0; j < (int)(sizeof(tzAidAll) / sizeof(tzAidAll[0])); j++) {
+			v1Aid(tzAidAll[j], tzAidKey[i], tcWant);
+			sqlite_Aid_Get(tzAidAll[j], tzAidKey[i], tcGot, sizeof(tcGot));
+			iBad += (strcmp(tcWant, tcGot) != 0);
+			if (xCfg.iVerbose && strcmp(tcWant, tcGot))
+				printf("  %s %s: '%s' '%s'\n", tzAidKey[i], tzAidAll[j], tcWant, tcGot);
+		}
+	}
+	check(iBad == 0, pcWhat);
+}
+
+static void paramRun(void) {
+	char tcSql[256], tcRsp[256], tcGot[256];
+	sqlite3_stmt *hStmt = NULL;
+	sqlite3 *hDb = NULL;
+	tSqlParamStat xBeg, xEnd;
+	tRun xRun;
+	double dBeg;
+	int iTxn, i, j;
+
+	SqliteDB_Init();
+	Sqlite_Run_Statement("CREATE TABLE IF NOT EXISTS parameters (id INTEGER PRIMARY KEY AUTOINCREMENT, paramName TEXT, details TEXT);", tcRsp);
+	for (i = 0; i < PARAM_ROWS; i++) {
+		sprintf(tcSql, "INSERT INTO parameters (paramName, details) VALUES ('param%02d', 'value%02d');", i, i);
+		Sqlite_Run_Statement(tcSql, tcRsp);
+	}
+	Sqlite_Run_Statement("INSERT INTO parameters (paramName, details) VALUES ('param03', 'again03');", tcRsp);
+	Sqlite_Run_Statement("INSERT INTO parameters (paramName, details) VALUES ('param05', NULL);", tcRsp);
+	check(sqlite_Param_Watch(paramWatch) == 1, "watch given");
+	benchOpen(DataBaseName, &hDb);
+	sqlite3_prepare_v2(hDb, "SELECT * FROM parameters WHERE paramName = ?;", -1, &hStmt, 0);
+	iTxn = sizeof(tzAidTxn) / sizeof(tzAidTxn[0]);
+	printf("database %s, %d parameters, %d aid reads per transaction, %d runs\n", xCfg.pcDir, PARAM_ROWS, iTxn, xCfg.iQueries);
+
+	paramCompare(hStmt, PARAM_ROWS, "cache gives what the queries give");
+
+	// Reads: the former queries, then the cache
+	runInit(&xRun, xCfg.iQueries);
+	for (i = 0; i < xCfg.iQueries; i++) {
+		sprintf(tcSql, "param%02d", rand() % PARAM_ROWS);
+		dBeg = nowUs();
+		v1Param(hStmt, tcSql, tcGot);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("parameter query", &xRun, 0);
+	sqlite_Param_Stats(&xBeg);
+	runInit(&xRun, xCfg.iQueries);
+	for (i = 0; i < xCfg.iQueries; i++) {
+		sprintf(tcSql, "param%02d", rand() % PARAM_ROWS);
+		dBeg = nowUs();
+		Sqlite_Get_Parameter(tcSql, tcGot);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("parameter cache", &xRun, 0);
+	runInit(&xRun, xCfg.iQueries);
+	for (i = 0; i < xCfg.iQueries; i++) {
+		dBeg = nowUs();
+		for (j = 0; j < iTxn; j++)
+			v1Aid(tzAidTxn[j], "A0000000041010", tcGot);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("aid reads query", &xRun, 0);
+	runInit(&xRun, xCfg.iQueries);
+	for (i = 0; i < xCfg.iQueries; i++) {
+		dBeg = nowUs();
+		for (j = 0; j < iTxn; j++)
+			sqlite_Aid_Get(tzAidTxn[j], "A0000000041010", tcGot, sizeof(tcGot));
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("aid reads cache", &xRun, 0);
+	sqlite_Param_Stats(&xEnd);
+	printf("%-22s %6u hits  %u queries avoided  %u queries made\n", "counters", xEnd.Hits - xBeg.Hits, xEnd.Avoided - xBeg.Avoided, xEnd.Queries - xBeg.Queries);
+	check(xEnd.Hits - xBeg.Hits == (card)(xCfg.iQueries * (1 + iTxn)), "each read counted");
+	check(xEnd.Avoided - xBeg.Avoided == (card)(xCfg.iQueries * (1 + iTxn)), "each query avoided counted");
+	check(xEnd.Queries == xBeg.Queries, "no query once the tables are read");
+
+	// Setter: SQLite and cache written, the watch told
+	iWatchCnt = 0;
+	check(Sqlite_Update_Parameter("param07", "changed07") == 1, "parameter updated");
+	strcpy(tcGot, "");
+	Sqlite_Get_Parameter("param07", tcGot);
+	check((strcmp(tcGot, "changed07") == 0) && (iWatchCnt == 1) && (strcmp(tcWatchName, "param07") == 0), "update in the cache and told");
+	Sqlite_Update_Parameter("paramXX", "none");
+	check(iWatchCnt == 1, "update of no row not told");
+	paramCompare(hStmt, PARAM_ROWS, "cache gives what the queries give after an update");
+
+	// Update rolled back: the cache read again, the watch told of all
+	sqlite_Txn_Begin();
+	Sqlite_Update_Parameter("param08", "undone08");
+	sqlite_Txn_End(0);
+	strcpy(tcGot, "");
+	Sqlite_Get_Parameter("param08", tcGot);
+	check((strcmp(tcGot, "value08") == 0) && (iWatchCnt == 3) && (strcmp(tcWatchName, "*") == 0), "update rolled back out of the cache and told");
+
+	// Table too large for the cache: the reads left to SQLite
+	for (i = PARAM_ROWS; i < PARAM_ROWS + PARAM_MORE; i++) {
+		sprintf(tcSql, "INSERT INTO parameters (paramName, details) VALUES ('param%02d', 'value%02d');", i, i);
+		Sqlite_Run_Statement(tcSql, tcRsp);
+	}
+	sqlite_Txn_Begin();                 // Cache dropped as by a rollback
+	Sqlite_Update_Parameter("param08", "undone08");
+	sqlite_Txn_End(0);
+	sqlite_Param_Stats(&xBeg);
+	paramCompare(hStmt, PARAM_ROWS + PARAM_MORE, "queries made for a table too large");
+	sqlite_Param_Stats(&xEnd);
+	check(xEnd.Queries - xBeg.Queries >= PARAM_ROWS + PARAM_MORE, "reads of a table too large left to SQLite");
+
+	// Aid table too large for the cache: each column read by its own query,
+	// one column read after another for the same AID
+	for (i = 0; i < AID_MORE; i++) {
+		sprintf(tcSql, "INSERT INTO aid (emvAidName, emvAid, emvTACDft, emvTACDen, emvTACOnl, emvTrmFlrLim) VALUES ('Aid%02d', '07A00000009%05d', 'DFT%02d', 'DEN%02d', 'ONL%02d', 'FLR%02d');", i, i, i, i, i, i);
+		Sqlite_Run_Statement(tcSql, tcRsp);
+	}
+	sqlite_Txn_Begin();
+	Sqlite_Update_Parameter("param08", "undone08");
+	sqlite_Txn_End(0);
+	sqlite_Param_Stats(&xBeg);
+	paramCompare(hStmt, PARAM_ROWS + PARAM_MORE, "queries made for an aid table too large");
+	sqlite_Param_Stats(&xEnd);
+	check(xEnd.Hits == xBeg.Hits, "reads of an aid table too large left to SQLite");
+	for (i = 0; i < AID_MORE; i += 5) {
+		sprintf(tcSql, "A00000009%05d", i);
+		sqlite_Aid_Get("emvAidName", tcSql, tcGot, sizeof(tcGot));
+		sprintf(tcRsp, "Aid%02d", i);
+		j = (strcmp(tcGot, tcRsp) == 0);
+		sqlite_Aid_Get("emvTACDen", tcSql, tcGot, sizeof(tcGot));
+		sprintf(tcRsp, "DEN%02d", i);
+		j = j && (strcmp(tcGot, tcRsp) == 0);
+		sqlite_Aid_Get("emvTrmFlrLim", tcSql, tcGot, sizeof(tcGot));
+		sprintf(tcRsp, "FLR%02d", i);
+		check(j && (strcmp(tcGot, tcRsp) == 0), "each column of an aid table too large from its own query");
+	}
+
+	sqlite3_finalize(hStmt);
+	sqlite3_close(hDb);
+}
+
+void paramBench(const char *pcArg) {
+	(void)pcArg;
+	paramRun();
+}
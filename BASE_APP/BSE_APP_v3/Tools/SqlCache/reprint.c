@@ -0,0 +1,202 @@
+/*
+ * reprint.c
+ *
+ *  Run of -r: the reprint, duplicate and completion lookups of a batch of
+ *  that many records made from the ring of the recent records, then asked
+ *  to SQLite, and the data maps they leave compared.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define RECENT_RECORDS  10             // Records of the reprint run found in the ring
+#define RECENT_CHECKS   40             // Records of the reprint run looked up both ways
+
+//****************************************************************************
+//      REPRINT RUN
+//****************************************************************************
+typedef struct {
+	int iRet;
+	char tzMap[keyEnd][1024];
+	char tcEmv[sizeof(isoField055)];
+} tSnap;
+
+// Lookup of the record iRec by the keys given (bits of tzLogFind), as the
+// reprint (STAN), the duplicate (none) and the completion (RRN and approval
+// code) make it, the map holding other values before. iRec < 0: no key.
+static int recFind(int iKey, int iRec, tSnap *pxSnap) {
+	char tc[32];
+	int iRet;
+	word k;
+
+	for (k = 0; k < keyEnd; k++)
+		mapPutStr(k, "#");
+	mapPutStr(appBatchNumber, "000001");
+	strcpy(isoField055, "#");
+	if (iKey & 1) {
+		recRrn(tc, iRec);
+		mapPutStr(traRrn, tc);
+	}
+	if (iKey & 2) {
+		sprintf(tc, "A%05d", iRec);
+		mapPutStr(traAutCod, tc);
+	}
+	if (iKey & 4) {
+		recStan(tc, iRec);
+		mapPutStr(traSTAN, tc);
+	}
+	iRet = sqlite_Get_LOG_Record((iKey & 1) ? traRrn : 0, (iKey & 2) ? traAutCod : 0, (iKey & 4) ? traSTAN : 0);
+	if (pxSnap) {
+		pxSnap->iRet = iRet;
+		memcpy(pxSnap->tzMap, tzMap, sizeof(tzMap));
+		memcpy(pxSnap->tcEmv, isoField055, sizeof(isoField055));
+	}
+	return iRet;
+}
+
+// Ring emptied as by a sale rolled back: the next lookups ask SQLite.
+static void ringDrop(void) {
+	sqlite_Txn_Begin();
+	sqlite_Txn_End(0);
+}
+
+// Lookups of the records before iLast, from the ring and from SQLite.
+static void recentCompare(int iLast, const char *pcWhat) {
+	tSnap *pxRing, *pxSql;
+	int iCnt = 0, iBad = 0, iFound = 0, iDiff, i;
+	word k;
+	int tiKey[RECENT_CHECKS + 4], tiRec[RECENT_CHECKS + 4];
+
+	for (i = 1; (i <= RECENT_CHECKS) && (iLast - i >= 0); i++, iCnt++) {
+		tiKey[iCnt] = 4;
+		tiRec[iCnt] = iLast - i;
+	}
+	tiKey[iCnt] = 0; tiRec[iCnt++] = -1;
+	tiKey[iCnt] = 3; tiRec[iCnt++] = iLast - 3;
+	tiKey[iCnt] = 3; tiRec[iCnt++] = iLast - RECENT_CHECKS + 2;
+	tiKey[iCnt] = 7; tiRec[iCnt++] = iLast - 4;
+
+	pxRing = calloc(iCnt, sizeof(tSnap));
+	pxSql = calloc(iCnt, sizeof(tSnap));
+	for (i = 0; i < iCnt; i++)
+		recFind(tiKey[i], tiRec[i], &pxRing[i]);
+	ringDrop();
+	for (i = 0; i < iCnt; i++) {
+		recFind(tiKey[i], tiRec[i], &pxSql[i]);
+		iDiff = (pxRing[i].iRet != pxSql[i].iRet) || (strcmp(pxRing[i].tcEmv, pxSql[i].tcEmv) != 0);
+		for (k = 0; k < keyEnd; k++) {
+			if (strcmp(pxRing[i].tzMap[k], pxSql[i].tzMap[k]) != 0)
+				iDiff++;
+			if (xCfg.iVerbose && (strcmp(pxRing[i].tzMap[k], pxSql[i].tzMap[k]) != 0))
+				printf("key %d record %d field %d: [%s] [%s]\n", tiKey[i], tiRec[i], k, pxRing[i].tzMap[k], pxSql[i].tzMap[k]);
+		}
+		iBad += (iDiff != 0);
+		iFound += (pxSql[i].iRet > 0);
+	}
+	free(pxRing);
+	free(pxSql);
+	check((iBad == 0) && (iFound > 0), pcWhat);
+}
+
+// Records iFrom to iFrom + iRecords saved one by one, as the sales do.
+static void recentSave(int iFrom, int iRecords) {
+	int iRec;
+
+	for (iRec = iFrom; iRec < iFrom + iRecords; iRec++) {
+		recMap(iRec);
+		if (sqlite_Log_Save() <= 0)
+			iFail++;
+	}
+}
+
+static void recentTime(const char *pcName, int iKey, int iLast) {
+	tRun xRun;
+	double dBeg;
+	int i, iRec, iBad = 0;
+
+	runInit(&xRun, xCfg.iQueries);
+	for (i = 0; i < xCfg.iQueries; i++) {
+		iRec = iLast - 1 - (i % RECENT_RECORDS);
+		if (recVoid(iRec))
+			iRec--;
+		dBeg = nowUs();
+		iBad += (recFind(iKey, iRec, NULL) <= 0);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport(pcName, &xRun, 0);
+	check(iBad == 0, "recent record found");
+}
+
+// Batch of iRecords, the last ones with the values the view gives in
+// another form than saved, then the lookups of the recent records made from
+// the ring and asked to SQLite: the same record, the same data map.
+static void reprintRun(int iRecords) {
+	char tcF62[300 + 1], tcStan[16];
+	int iLast = iRecords;
+
+	SqliteDB_Init();
+	batchFill(0, iRecords - RECENT_CHECKS, "000001");
+	ringDrop();
+	recentSave(iRecords - RECENT_CHECKS, RECENT_CHECKS);
+
+	recMap(iLast);                               // Zeros left of the integers, quote, 300 bytes
+	mapPutStr(traMnuItm, "0001");
+	mapPutStr(traDatTim, "0119101500");
+	mapPutStr(traCashbackAmt, "000000000500");
+	mapPutStr(traConCode, "1");
+	memset(tcF62, 'B', sizeof(tcF62) - 1);
+	tcF62[sizeof(tcF62) - 1] = 0;
+	tcF62[5] = '\'';
+	mapPutStr(traBillerPaymentDetails, tcF62);
+	check(sqlite_Log_Save() > 0, "record saved");
+	iLast++;
+	recMap(iLast);                               // Balance enquiry, left out of the duplicate
+	sprintf(tcF62, "%d", mnuBalanceEnquiry);
+	mapPutStr(traMnuItm, tcF62);
+	check(sqlite_Log_Save() > 0, "record saved");
+	iLast++;
+	recentCompare(iLast, "ring gives what SQLite gives");
+
+	// Voids: a record of the ring voided
+	recentSave(iLast, RECENT_RECORDS);
+	iLast += RECENT_RECORDS;
+	recStan(tcStan, iLast - 3);
+	check(sqlite_CloseVoid(tcStan) > 0, "record voided");
+	check(recFind(4, iLast - 3, NULL) <= 0, "voided record out of the ring");
+	recentSave(iLast, RECENT_RECORDS);
+	iLast += RECENT_RECORDS;
+	recentCompare(iLast, "ring gives what SQLite gives after a void");
+
+	// Sale rolled back: its record neither in the log nor in the ring
+	recentSave(iLast, RECENT_RECORDS);
+	iLast += RECENT_RECORDS;
+	sqlite_Txn_Begin();
+	recMap(iLast);
+	check(sqlite_Log_Save() > 0, "record saved");
+	sqlite_Txn_End(0);
+	check(recFind(4, iLast, NULL) <= 0, "sale rolled back out of the ring");
+
+	// Lookups timed from the ring, then asked to SQLite
+	recentSave(iLast, RECENT_RECORDS);
+	iLast += RECENT_RECORDS;
+	printf("database %s, %d records, %d queries per lookup run\n", xCfg.pcDir, iLast, xCfg.iQueries);
+	recentTime("reprint STAN ring", 4, iLast);
+	recentTime("duplicate last ring", 0, iLast);
+	recentTime("completion ring", 3, iLast);
+	ringDrop();
+	recentTime("reprint STAN SQLite", 4, iLast);
+	recentTime("duplicate last SQLite", 0, iLast);
+	recentTime("completion SQLite", 3, iLast);
+
+	// Batch closed: the ring no longer gives its records
+	recentSave(iLast, RECENT_RECORDS);
+	iLast += RECENT_RECORDS;
+	check(sqlite_Log_Close() > 0, "batch closed");
+	mapPutStr(appBatchNumber, "000002");
+	check(sqlite_Get_LOG_Record(0, 0, 0) <= 0, "closed batch out of the ring");
+}
+
+void reprintBench(const char *pcArg) {
+	reprintRun((atoi(pcArg) > 2 * RECENT_CHECKS) ? atoi(pcArg) : 2 * RECENT_CHECKS);
+}
@@ -0,0 +1,270 @@
+/*
+ * schema.c
+ *
+ *  Run of -s: the transaction log built in the former schema of 134 text
+ *  columns for each size given, timed, moved to the typed schema by
+ *  Sqlite.c and timed again, the settlement totals read from the running
+ *  totals.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define SCHEMA_INSERTS  500            // Single inserts timed in each schema
+#define SCHEMA_QUERIES  200            // Lookups timed in each schema
+#define SCHEMA_SETTLES  20             // Settlement totals timed in each schema
+#define CURRENCY2       "0840"         // Second currency of the settlement, no record
+
+//****************************************************************************
+//      SCHEMA RUNS
+//****************************************************************************
+// Lookups of sqlite_Get_LOG_Record before the typed log: every record read
+#define V1_FIND_STAN    "SELECT * FROM log WHERE isoField011 = ?3 AND isoVoided != '1' AND MenuItem != ?4 AND MenuItem != ?5 ORDER BY id DESC LIMIT 1;"
+#define V1_FIND_RRN     "SELECT * FROM log WHERE isoField037 = ?1 AND isoVoided != '1' AND MenuItem != ?4 AND MenuItem != ?5 ORDER BY id DESC LIMIT 1;"
+
+// Queries of logCalcTot before the typed log, count then sum of each total
+static const char *tzV1Totals[2 * logTotEnd] = {
+		"SELECT COUNT(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'D' AND MenuItem != '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+		"SELECT SUM(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'D' AND MenuItem != '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+		"SELECT COUNT(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'D' AND MenuItem = '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+		"SELECT SUM(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'D' AND MenuItem = '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+		"SELECT COUNT(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'C' AND MenuItem != '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+		"SELECT SUM(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'C' AND MenuItem != '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+		"SELECT COUNT(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'C' AND MenuItem = '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+		"SELECT SUM(isoField004) FROM log WHERE isoField039 = '00' AND isoDrCr = 'C' AND MenuItem = '%d' AND MenuItem != '%d' AND isoField049 = '%s';",
+};
+
+// Former sqlite_Get_LOG_Record: give the STAN and the RRN of the record found.
+static int v1Find(sqlite3_stmt *hStmt, int iKey, const char *pcKey, char *pcStan, char *pcRrn) {
+	char tcData[256];
+	const char *pcName, *pcVal;
+	int iRet = 0, iCol;
+
+	sqlite3_bind_text(hStmt, iKey, pcKey, -1, SQLITE_STATIC);
+	sqlite3_bind_int(hStmt, 4, mnuVoid);
+	sqlite3_bind_int(hStmt, 5, mnuReversal);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		for (iCol = 0; iCol < sqlite3_column_count(hStmt); iCol++) {
+			pcName = sqlite3_column_name(hStmt, iCol);
+			pcVal = (const char *)sqlite3_column_text(hStmt, iCol);
+			snprintf(tcData, sizeof(tcData), "%s", pcVal ? pcVal : "");
+			if (strcmp(pcName, "isoField011") == 0)
+				strcpy(pcStan, tcData);
+			else if (strcmp(pcName, "isoField037") == 0)
+				strcpy(pcRrn, tcData);
+		}
+		iRet = 1;
+	}
+	sqlite3_reset(hStmt);
+	return iRet;
+}
+
+static void v1FindRun(sqlite3 *hDb, const char *pcSql, int bRrn, int iRecords, tRun *pxRun) {
+	sqlite3_stmt *hStmt = NULL;
+	char tcStan[16], tcRrn[16], tcGotStan[16], tcGotRrn[16];
+	double dBeg;
+	int i, iRec, iRet, iBad = 0;
+
+	sqlite3_prepare_v2(hDb, pcSql, -1, &hStmt, 0);
+	for (i = 0; i < SCHEMA_QUERIES; i++) {
+		iRec = rand() % iRecords;
+		recStan(tcStan, iRec);
+		recRrn(tcRrn, iRec);
+		tcGotStan[0] = tcGotRrn[0] = 0;
+		dBeg = nowUs();
+		iRet = v1Find(hStmt, bRrn ? 1 : 3, bRrn ? tcRrn : tcStan, tcGotStan, tcGotRrn);
+		runAdd(pxRun, nowUs() - dBeg);
+		if (recVoid(iRec))
+			iBad += (iRet > 0);
+		else
+			iBad += (iRet <= 0) || (strcmp(tcGotStan, tcStan) != 0) || (strcmp(tcGotRrn, tcRrn) != 0);
+	}
+	sqlite3_finalize(hStmt);
+	check(iBad == 0, bRrn ? "former lookup by RRN" : "former lookup by STAN");
+}
+
+// Former logCalcTot: eight queries, compiled at each call.
+static void v1Totals(sqlite3 *hDb, const char *pcCurr, tLogTot *pxTot) {
+	sqlite3_stmt *hStmt;
+	char tcSql[512];
+	const char *pcVal;
+	int i;
+
+	memset(pxTot, 0, logTotEnd * sizeof(*pxTot));
+	for (i = 0; i < 2 * logTotEnd; i++) {
+		sprintf(tcSql, tzV1Totals[i], mnuReversal, mnuBalanceEnquiry, pcCurr);
+		hStmt = NULL;
+		sqlite3_prepare_v2(hDb, tcSql, -1, &hStmt, 0);
+		if (sqlite3_step(hStmt) == SQLITE_ROW) {
+			pcVal = (const char *)sqlite3_column_text(hStmt, 0);
+			if (pcVal)
+				strcpy((i % 2) ? pxTot[i / 2].Sum : pxTot[i / 2].Count, pcVal);
+		}
+		sqlite3_finalize(hStmt);
+	}
+}
+
+// Totals of logCalcTot before the running totals: one pass over trn.
+static const char zScanTotals[] = "SELECT DrCr, MenuItem = ?1, COUNT(*), SUM(Amount) FROM trn WHERE RspCod = '00' AND MenuItem != ?2 AND Currency = ?3 AND DrCr IN ('D', 'C') GROUP BY 1, 2;";
+
+static void scanTotals(sqlite3_stmt *hStmt, const char *pcCurr, tLogTot *pxTot) {
+	const char *pcSum;
+	int i;
+
+	for (i = 0; i < logTotEnd; i++) {
+		strcpy(pxTot[i].Count, "0");
+		pxTot[i].Sum[0] = 0;
+	}
+	sqlite3_bind_int(hStmt, 1, mnuReversal);
+	sqlite3_bind_int(hStmt, 2, mnuBalanceEnquiry);
+	sqlite3_bind_text(hStmt, 3, pcCurr, -1, SQLITE_STATIC);
+	while (sqlite3_step(hStmt) == SQLITE_ROW) {
+		i = ((*sqlite3_column_text(hStmt, 0) == 'D') ? logTotDebit : logTotCredit) + sqlite3_column_int(hStmt, 1);
+		strcpy(pxTot[i].Count, (const char *)sqlite3_column_text(hStmt, 2));
+		pcSum = (const char *)sqlite3_column_text(hStmt, 3);
+		if (pcSum)
+			strcpy(pxTot[i].Sum, pcSum);
+	}
+	sqlite3_reset(hStmt);
+}
+
+static int sameTotals(const tLogTot *pxA, const tLogTot *pxB) {
+	int i;
+
+	for (i = 0; i < logTotEnd; i++) {
+		if (strcmp(pxA[i].Count, pxB[i].Count) || strcmp(pxA[i].Sum, pxB[i].Sum))
+			return 0;
+	}
+	return 1;
+}
+
+// Log of iRecords in the former schema, timed, migrated, timed again.
+static void schemaRun(int iRecords) {
+	static char tcSql[8192];
+	char tcRsp[1024], tcWant[512], tcEmv[80];
+	tLogTot tzV1[logTotEnd], tzTot[logTotEnd], tzNone[logTotEnd];
+	sqlite3_stmt *hStmt = NULL;
+	sqlite3 *hDb = NULL;
+	char *pc;
+	tRun xRun;
+	double dBeg;
+	int iTotal, iRec, iFld, i;
+
+	printf("\n%d records\n", iRecords);
+
+	// Former table, filled by logSave before the typed schema
+	SqliteDB_Init();                   // Shared handle closed, database made again
+	benchOpen(DataBaseName, &hDb);
+	pc = tcSql;
+	pc += sprintf(pc, "DROP VIEW log; DROP TABLE trn_ext; DROP TABLE trn; DROP TABLE trn_tot; CREATE TABLE log (id INTEGER PRIMARY KEY AUTOINCREMENT, DateTimeStamp TEXT DEFAULT CURRENT_TIMESTAMP, MenuItem TEXT, InvoiceNo TEXT");
+	for (iFld = 0; iFld <= 128; iFld++)
+		pc += sprintf(pc, ", isoField%03d TEXT", iFld);
+	sprintf(pc, ", isoDrCr TEXT, isoVoided TEXT, NetTiming TEXT);");
+	benchExec(hDb, tcSql);
+	benchExec(hDb, "BEGIN;");
+	for (iRec = 0; iRec < iRecords; iRec++) {
+		recInsert(tcSql, iRec);
+		benchExec(hDb, tcSql);
+	}
+	benchExec(hDb, "COMMIT;");
+
+	runInit(&xRun, SCHEMA_INSERTS);
+	for (i = 0; i < SCHEMA_INSERTS; i++) {
+		recInsert(tcSql, iRecords + i);
+		dBeg = nowUs();
+		benchExec(hDb, tcSql);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("former insert", &xRun, 0);
+	iTotal = iRecords + SCHEMA_INSERTS;
+
+	runInit(&xRun, SCHEMA_QUERIES);
+	v1FindRun(hDb, V1_FIND_STAN, 0, iRecords, &xRun);
+	runReport("former lookup STAN", &xRun, 0);
+	runInit(&xRun, SCHEMA_QUERIES);
+	v1FindRun(hDb, V1_FIND_RRN, 1, iRecords, &xRun);
+	runReport("former lookup RRN", &xRun, 0);
+	runInit(&xRun, SCHEMA_SETTLES);
+	for (i = 0; i < SCHEMA_SETTLES; i++) {
+		dBeg = nowUs();
+		v1Totals(hDb, CURRENCY, tzV1);
+		v1Totals(hDb, CURRENCY2, tzNone);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("former settlement", &xRun, 0);
+	sqlite3_close(hDb);
+
+	// Migration, made by the first query of Sqlite.c
+	mapPutStr(appBatchNumber, "000001");
+	dBeg = nowUs();
+	i = logCount();
+	printf("%-22s %8.1f ms\n", "migration", (nowUs() - dBeg) / 1000);
+	check(i == iTotal, "records migrated");
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement("SELECT type FROM sqlite_master WHERE name = 'log';", tcRsp);
+	check(strcmp(tcRsp, "view") == 0, "log turned into a view");
+
+	// Migrated record, as the former table gave it
+	recEmv(tcEmv, 0);
+	sprintf(tcWant, "id,1;MenuItem,%d;isoField004,%012d;isoField007,1019101500;isoField011,000001;isoField037,000000700000;isoField055,%s;isoDrCr,D;isoVoided,0;BatchNo,1;", mnuSale, recAmount(0), tcEmv);
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement_MultiRecord("SELECT id, MenuItem, isoField004, isoField007, isoField011, isoField037, isoField055, isoDrCr, isoVoided, BatchNo FROM log WHERE id = 1;", tcRsp);
+	if (xCfg.iVerbose)
+		printf("%s\n%s\n", tcWant, tcRsp);
+	check(strcmp(tcRsp, tcWant) == 0, "record migrated");
+
+	runInit(&xRun, SCHEMA_QUERIES);
+	runFindStan(iRecords, SCHEMA_QUERIES, &xRun);
+	runReport("typed lookup STAN", &xRun, 0);
+	runInit(&xRun, SCHEMA_QUERIES);
+	runFindRrn(iRecords, SCHEMA_QUERIES, &xRun);
+	runReport("typed lookup RRN", &xRun, 0);
+	benchOpen(DataBaseName, &hDb);
+	sqlite3_prepare_v2(hDb, zScanTotals, -1, &hStmt, 0);
+	runInit(&xRun, SCHEMA_SETTLES);
+	for (i = 0; i < SCHEMA_SETTLES; i++) {
+		dBeg = nowUs();
+		scanTotals(hStmt, CURRENCY, tzTot);
+		scanTotals(hStmt, CURRENCY2, tzNone);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("one-pass settlement", &xRun, 0);
+	check(sameTotals(tzV1, tzTot), "one-pass totals as before");
+	sqlite3_finalize(hStmt);
+	sqlite3_close(hDb);
+	runInit(&xRun, SCHEMA_SETTLES);
+	for (i = 0; i < SCHEMA_SETTLES; i++) {
+		dBeg = nowUs();
+		sqlite_Log_Totals(CURRENCY, tzTot);
+		sqlite_Log_Totals(CURRENCY2, tzNone);
+		runAdd(&xRun, nowUs() - dBeg);
+	}
+	runReport("typed settlement", &xRun, 0);
+	check(sameTotals(tzV1, tzTot), "running totals as before");
+	check(strcmp(tzNone[logTotDebit].Count, "0") == 0, "no totals in the second currency");
+	dBeg = nowUs();
+	i = sqlite_Log_Check();
+	printf("%-22s %8.1f ms\n", "totals check", (nowUs() - dBeg) / 1000);
+	check(i == 0, "running totals match the log");
+
+	runInit(&xRun, SCHEMA_INSERTS);
+	runLogSave(iTotal, iTotal + SCHEMA_INSERTS, &xRun);
+	runReport("typed insert", &xRun, 0);
+	iTotal += SCHEMA_INSERTS;
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement("SELECT MAX(id) FROM log;", tcRsp);
+	check((logCount() == iTotal) && (atoi(tcRsp) == iTotal), "ids go on after the migration");
+	check(sqlite_Log_Check() == 0, "running totals kept by the inserts");
+}
+
+// Sizes given as "10000,50000": one schema run each.
+void schemaBench(const char *pcArg) {
+	const char *pcSize;
+
+	printf("database %s, %d lookups, %d settlements, %d inserts per schema\n", xCfg.pcDir, SCHEMA_QUERIES, SCHEMA_SETTLES, SCHEMA_INSERTS);
+	for (pcSize = pcArg; pcSize; pcSize = strchr(pcSize, ',') ? strchr(pcSize, ',') + 1 : NULL) {
+		if (atoi(pcSize) >= VOID_EVERY)
+			schemaRun(atoi(pcSize));
+	}
+}
@@ -0,0 +1,112 @@
+/*
+ * settle.c
+ *
+ *  Run of -p: a batch of each size given closed by the former settlement,
+ *  which emptied the log, then by closing the batch and pruning it later.
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define KEEP_RECORDS    30             // Records of each batch in the retention check
+
+//****************************************************************************
+//      CUTOVER RUN
+//****************************************************************************
+
+// Batch of iRecords closed by the former settlement, then by the cutover,
+// the next sale saved at once and the closed batch pruned afterwards.
+static void cutoverRun(int iRecords) {
+	static const char *tzV1Reset[] = {
+			"BEGIN;", "DELETE FROM trn_tot;", "DELETE FROM trn_ext;", "DELETE FROM trn;",
+			"DELETE FROM sqlite_sequence WHERE name = 'trn';", "COMMIT;", "VACUUM;",
+	};
+	char tcRsp[256], tcStan[16];
+	tRun xRun;
+	double dBeg, dCut;
+	int iRet;
+	size_t i;
+
+	// Former settlement: the log emptied in the rollback journal, then the file rewritten
+	SqliteDB_Init();
+	Sqlite_Run_Statement("PRAGMA journal_mode = DELETE;", tcRsp);
+	batchFill(0, iRecords, "000001");
+	Sqlite_Run_Statement("DROP TRIGGER trn_delete;", tcRsp);       // Not in the former schema
+	Sqlite_Run_Statement("DROP TRIGGER trn_tot_delete;", tcRsp);
+	dBeg = nowUs();
+	for (i = 0; i < sizeof(tzV1Reset) / sizeof(tzV1Reset[0]); i++)
+		Sqlite_Run_Statement(tzV1Reset[i], tcRsp);
+	dCut = nowUs() - dBeg;
+	check(logCount() == 0, "former settlement empties the log");
+
+	// Cutover: the batch closed, the next one opened in the data map
+	SqliteDB_Init();
+	batchFill(0, iRecords, "000001");
+	dBeg = nowUs();
+	check(sqlite_Log_Close() > 0, "batch closed");
+	mapPutStr(appBatchNumber, "000002");
+	printf("%-22s %8d records  former %8.1f ms  cutover %8.1f us\n", "settlement cutover", iRecords, dCut / 1000, nowUs() - dBeg);
+
+	dBeg = nowUs();
+	recMap(iRecords);
+	mapPutStr(appBatchNumber, "000002");
+	check(sqlite_Log_Save() > 0, "sale saved in the next batch");
+	printf("%-22s %8.1f us\n", "next sale", nowUs() - dBeg);
+	check(sqlite_Get_LOG_Record(0, 0, traSTAN) > 0, "sale of the next batch found");
+	recStan(tcStan, 0);
+	mapPutStr(traSTAN, tcStan);
+	check(sqlite_Get_LOG_Record(0, 0, traSTAN) <= 0, "closed batch out of the lookups");
+
+	// Closed batch pruned a chunk at a time, as the store and forward task does
+	runInit(&xRun, iRecords / LOG_PRUNE_ROWS + 2);
+	dBeg = nowUs();
+	while (1) {
+		dCut = nowUs();
+		iRet = sqlite_Log_Prune(0, LOG_PRUNE_ROWS);
+		if (iRet <= 0)
+			break;
+		runAdd(&xRun, nowUs() - dCut);
+	}
+	printf("%-22s %8.1f ms\n", "prune closed batch", (nowUs() - dBeg) / 1000);
+	runReport("prune chunk", &xRun, 0);
+	check(iRet == 0, "pruning ends");
+	check((logCount() == 1) && (rowCount("SELECT COUNT(*) FROM trn_ext;") == 1), "closed batch pruned with its extension rows");
+	check((rowCount("SELECT COUNT(*) FROM trn_closed;") == 0) && (rowCount("SELECT COUNT(*) FROM trn_tot WHERE BatchNo = 1;") == 0), "closed batch forgotten with its totals");
+	check(sqlite_Log_Check() == 0, "running totals kept by the pruning");
+}
+
+// Retention: the most recent closed batches kept, the open one never pruned.
+static void keepRun(void) {
+	char tcBatch[12];
+	int iBatch;
+
+	SqliteDB_Init();
+	for (iBatch = 1; iBatch <= 4; iBatch++) {
+		sprintf(tcBatch, "%06d", iBatch);
+		batchFill(iBatch * KEEP_RECORDS, KEEP_RECORDS, tcBatch);
+		if (iBatch < 4)
+			check(sqlite_Log_Close() > 0, "batch closed");
+	}
+	while (sqlite_Log_Prune(2, LOG_PRUNE_ROWS) > 0)
+		;
+	check((rowCount("SELECT COUNT(*) FROM trn WHERE BatchNo = 1;") == 0) && (logCount() == 3 * KEEP_RECORDS), "batches beyond the retention pruned");
+
+	// Batch closed but not yet incremented, as after a power failure in the settlement
+	check(sqlite_Log_Close() > 0, "open batch closed");
+	while (sqlite_Log_Prune(0, LOG_PRUNE_ROWS) > 0)
+		;
+	check((rowCount("SELECT COUNT(*) FROM trn WHERE BatchNo = 4;") == KEEP_RECORDS) && (logCount() == KEEP_RECORDS), "open batch never pruned");
+	check(sqlite_Log_Check() == 0, "running totals kept by the retention");
+}
+
+// Sizes given as "1000,10000": one cutover run each, after the retention check.
+void settleBench(const char *pcArg) {
+	const char *pcSize;
+
+	keepRun();
+	for (pcSize = pcArg; pcSize; pcSize = strchr(pcSize, ',') ? strchr(pcSize, ',') + 1 : NULL) {
+		if (atoi(pcSize) >= VOID_EVERY)
+			cutoverRun(atoi(pcSize));
+	}
+}
@@ -0,0 +1,88 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/Sqlite.c on
+ *  Linux against the SQLite of the host. The flash disk is a directory
+ *  (see Sqlite_Def.h), the data map a table of strings and the OSL mutex a
+ *  pthread mutex; all given by sqlbench.c.
+ */
+#ifndef __SQLBENCH_GLOBALS_H__
+#define __SQLBENCH_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int card;
+
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+
+#define _ING_APPLI_TELIUM_TETRA_PACKAGE_VERSION "030900"
+
+enum { lenMti = 4, lenAutCod = 6, lenRrn = 12, lenSTAN = 6, lenBatNum = 7, lenAID = 64 };
+
+enum {                                     // Menu items used by Sqlite.c
+	mnuSale = 1, mnuBalanceEnquiry, mnuVoid, mnuReversal
+};
+
+enum {                                     // Keys used by Sqlite.c
+	traMnuItmContext, traInvNum, traPan, traRqsProcessingCode, traAmt,
+	traDatTim, traSTAN, traExpDat, traPosEntMod, traCrdSeq, traConCode,
+	traTrk2, traRrn, traAutCod, traRspCod, traCashbackAmt, traEMVDATA,
+	traBillerPaymentDetails, traField063, appBatchNumber, traMnuItm,
+	traRqsMTI, appNII, appTID, appMID, emvTrnCurCod, traDrCr, traNetTiming,
+	keyEnd
+};
+
+extern char isoField055[512 + 1];
+
+int mapGet(word key, void *ptr, word len);
+int mapPutStr(word key, const char *str);
+int mapPutByte(word key, byte val);
+#define MAPGET(KEY,BUF,LBL) { ret= mapGet(KEY,BUF,sizeof(BUF)); CHECK(ret>=0,LBL);}
+#define MAPPUTSTR(KEY,VAR,LBL) { ret= mapPutStr(KEY,VAR); CHECK(ret>=0,LBL);}
+#define MAPPUTBYTE(KEY,VAR,LBL) { ret= mapPutByte(KEY,VAR); CHECK(ret>=0,LBL);}
+word ApplicationCurrencyFillAuto(char *Currency);
+int hex2bin(byte *bin, const char *hex, int len);
+
+#define Telium_Sprintf sprintf
+word Telium_CurrentTask(void);
+#define Telium_Fprintf fprintf
+#define Telium_Stdprt() stderr
+typedef void *T_GL_HGRAPHIC_LIB;
+
+// Flash file system
+typedef struct {
+	char Label[32];
+	unsigned int Mode;
+	unsigned int AccessMode;
+	unsigned int NbFichierMax;
+	unsigned int IdentZone;
+} S_FS_PARAM_CREATE;
+typedef FILE S_FS_FILE;
+enum { FS_OK = 0, FS_ERROR = -1, FS_WRITEONCE = 0, FS_WRTMOD = 0, FS_WO_ZONE_DATA = 0 };
+int FS_mount(const char *pcVol, unsigned int *puiMode);
+int FS_dskcreate(S_FS_PARAM_CREATE *pxCfg, unsigned long *pulSize);
+int FS_unmount(const char *pcVol);
+int FS_dskkill(const char *pcVol);
+int FS_unlink(const char *pcFile);
+long FS_dskfree(const char *pcVol);
+S_FS_FILE *FS_open(const char *pcFile, const char *pcMode);
+long FS_length(S_FS_FILE *hFile);
+int FS_read(void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile);
+int FS_write(const void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile);
+int FS_close(S_FS_FILE *hFile);
+#define umalloc malloc
+#define ufree free
+
+// OS layer mutex
+typedef void *T_OSL_HMUTEX;
+enum { OSL_SUCCESS = 0, OSL_SECURITY_LOCAL = 0, OSL_TIMEOUT_INFINITE = -1 };
+T_OSL_HMUTEX OSL_Mutex_Create(int iName, int iSecurity);
+int OSL_Mutex_Lock(T_OSL_HMUTEX hMutex, int iTmo);
+int OSL_Mutex_Unlock(T_OSL_HMUTEX hMutex);
+
+#endif
@@ -0,0 +1,690 @@
+/*
+ * sqlbench.c
+ *
+ *  Times the queries of the terminal database (Src/Sqlite.c) on the SQLite
+ *  of the host. This file is the bench core: the environment of the
+ *  terminal, the simulated disk, the measures and the log records, and the
+ *  choice of the run. Each run has its own file; lookup.c is the default.
+ *
+ *  Usage: sqlbench [-d dir] [-n records] [-q queries] [-s sizes] [-c rows] [-w sales] [-p sizes] [-r records] [-m] [-a] [-f kb] [-x records] [-v]
+ */
+#include "bench.h"
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	int iOpt;                          // Option of the run
+	void (*pfnBench)(const char *pcArg);
+} tBench;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static const tBench tzBench[] = {
+	{ 's', schemaBench }, { 'c', cursorBench }, { 'w', commitBench }, { 'p', settleBench },
+	{ 'r', reprintBench }, { 'm', menuBench }, { 'a', paramBench }, { 'f', fillBench },
+	{ 'x', exportBench },
+};
+static int iTaskNext = 0;              // Task numbers given by Telium_CurrentTask
+static __thread int iTask = 0;
+
+tCfg xCfg = { "db", 1000, 2000, 0 };
+char tzMap[keyEnd][1024];
+int iOpens = 0;
+volatile int iSyncs = 0;
+volatile int iCommits = 0;
+int iFail = 0;
+volatile int bMixStop = 0;
+int iMixErr = 0;
+int iMixOps = 0;
+char isoField055[512 + 1];
+
+//****************************************************************************
+//      TERMINAL ENVIRONMENT
+//****************************************************************************
+int mapGet(word key, void *ptr, word len) {
+	size_t n;
+
+	if (key >= keyEnd)
+		return -1;
+	n = strnlen(tzMap[key], sizeof(tzMap[key]) - 1);
+	if (n >= len)
+		n = len - 1;
+	memcpy(ptr, tzMap[key], n);
+	((char *)ptr)[n] = 0;
+	return (int)n;
+}
+
+int mapPutStr(word key, const char *str) {
+	size_t n;
+
+	if (key >= keyEnd)
+		return -1;
+	n = strlen(str);
+	if (n > sizeof(tzMap[key]) - 1)
+		n = sizeof(tzMap[key]) - 1;
+	memcpy(tzMap[key], str, n);
+	tzMap[key][n] = 0;
+	return (int)n;
+}
+
+int mapPutByte(word key, byte val) {
+	char tc[2] = { (char)val, 0 };
+	return mapPutStr(key, tc);
+}
+
+int hex2bin(byte *bin, const char *hex, int len) {
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1]))
+			return 0;
+		sscanf(&hex[2 * i], "%2hhx", &bin[i]);
+	}
+	return len;
+}
+
+word ApplicationCurrencyFillAuto(char *Currency) {
+	(void)Currency;
+	return 0;
+}
+
+void benchPath(char *pcPath, size_t len, const char *pcFile) {
+	const char *pcBase = strrchr(pcFile, '/');
+
+	snprintf(pcPath, len, "%s/%s", xCfg.pcDir, pcBase ? pcBase + 1 : pcFile);
+}
+
+static int benchCommit(void *pvArg) {
+	(void)pvArg;
+	__sync_fetch_and_add(&iCommits, 1);
+	return 0;
+}
+
+int benchOpen(const char *pcFile, sqlite3 **phDb) {
+	char tcPath[512];
+	int iRet;
+
+	iOpens++;
+	benchPath(tcPath, sizeof(tcPath), pcFile);
+	iRet = sqlite3_open(tcPath, phDb);
+	if (iRet == SQLITE_OK)
+		sqlite3_commit_hook(*phDb, benchCommit, NULL);
+	return iRet;
+}
+
+// Statement run on a handle of the bench, the failure counted.
+void benchExec(sqlite3 *hDb, const char *pcSql) {
+	if (sqlite3_exec(hDb, pcSql, NULL, NULL, NULL) != SQLITE_OK) {
+		printf("%s: %s\n", sqlite3_errmsg(hDb), pcSql);
+		iFail++;
+	}
+}
+
+// The syncs of SQLite, counted on their way to the C library.
+int fdatasync(int fd) {
+	static int (*pfnSync)(int) = NULL;
+
+	if (pfnSync == NULL)
+		pfnSync = (int (*)(int))dlsym(RTLD_NEXT, "fdatasync");
+	__sync_fetch_and_add(&iSyncs, 1);
+	return pfnSync(fd);
+}
+
+int fsync(int fd) {
+	static int (*pfnSync)(int) = NULL;
+
+	if (pfnSync == NULL)
+		pfnSync = (int (*)(int))dlsym(RTLD_NEXT, "fsync");
+	__sync_fetch_and_add(&iSyncs, 1);
+	return pfnSync(fd);
+}
+
+//****************************************************************************
+//      SIMULATED DISK
+//****************************************************************************
+// The files of the directory given held to a size, as on the flash disk of
+// the terminal: a write growing them past it fails with SQLITE_FULL. The
+// clock of SQLite moved on by the fill run, a day at a time.
+typedef struct {
+	sqlite3_file xBase;
+	sqlite3_file *pxReal;              // File of the host, right after
+	int bHeld;                         // File of the directory, counted
+} tSimFile;
+
+#define SIM_REAL(f) (((tSimFile *)(f))->pxReal)
+
+static sqlite3_vfs *pxHostVfs = NULL;
+static sqlite3_vfs xSimVfs;
+static sqlite3_io_methods xSimIo;
+long lSimSize = 0;                     // Bytes of the disk, 0: not held
+sqlite3_int64 llSimShift = 0;          // ms added to the clock
+int iSimFull = 0;                      // Writes refused for the room
+
+static long simUsed(void) {
+	char tcPath[512];
+	struct dirent *pxEnt;
+	struct stat xSt;
+	long lUsed = 0;
+	DIR *pxDir;
+
+	pxDir = opendir(xCfg.pcDir);
+	if (pxDir == NULL)
+		return 0;
+	while ((pxEnt = readdir(pxDir)) != NULL) {
+		snprintf(tcPath, sizeof(tcPath), "%s/%s", xCfg.pcDir, pxEnt->d_name);
+		if ((stat(tcPath, &xSt) == 0) && S_ISREG(xSt.st_mode))
+			lUsed += (long)xSt.st_size;
+	}
+	closedir(pxDir);
+	return lUsed;
+}
+
+static long simFree(void) {
+	return lSimSize ? lSimSize - simUsed() : 1L << 30;
+}
+
+static int simClose(sqlite3_file *f) { return SIM_REAL(f)->pMethods->xClose(SIM_REAL(f)); }
+static int simRead(sqlite3_file *f, void *p, int n, sqlite3_int64 o) { return SIM_REAL(f)->pMethods->xRead(SIM_REAL(f), p, n, o); }
+static int simTruncate(sqlite3_file *f, sqlite3_int64 n) { return SIM_REAL(f)->pMethods->xTruncate(SIM_REAL(f), n); }
+static int simSync(sqlite3_file *f, int fl) { return SIM_REAL(f)->pMethods->xSync(SIM_REAL(f), fl); }
+static int simFileSize(sqlite3_file *f, sqlite3_int64 *p) { return SIM_REAL(f)->pMethods->xFileSize(SIM_REAL(f), p); }
+static int simLock(sqlite3_file *f, int l) { return SIM_REAL(f)->pMethods->xLock(SIM_REAL(f), l); }
+static int simUnlock(sqlite3_file *f, int l) { return SIM_REAL(f)->pMethods->xUnlock(SIM_REAL(f), l); }
+static int simReserved(sqlite3_file *f, int *p) { return SIM_REAL(f)->pMethods->xCheckReservedLock(SIM_REAL(f), p); }
+static int simControl(sqlite3_file *f, int op, void *p) { return SIM_REAL(f)->pMethods->xFileControl(SIM_REAL(f), op, p); }
+static int simSector(sqlite3_file *f) { return SIM_REAL(f)->pMethods->xSectorSize(SIM_REAL(f)); }
+static int simDevice(sqlite3_file *f) { return SIM_REAL(f)->pMethods->xDeviceCharacteristics(SIM_REAL(f)); }
+static int simShmMap(sqlite3_file *f, int i, int n, int b, void volatile **pp) { return SIM_REAL(f)->pMethods->xShmMap(SIM_REAL(f), i, n, b, pp); }
+static int simShmLock(sqlite3_file *f, int o, int n, int fl) { return SIM_REAL(f)->pMethods->xShmLock(SIM_REAL(f), o, n, fl); }
+static void simShmBarrier(sqlite3_file *f) { SIM_REAL(f)->pMethods->xShmBarrier(SIM_REAL(f)); }
+static int simShmUnmap(sqlite3_file *f, int d) { return SIM_REAL(f)->pMethods->xShmUnmap(SIM_REAL(f), d); }
+static int simFetch(sqlite3_file *f, sqlite3_int64 o, int n, void **pp) { return SIM_REAL(f)->pMethods->xFetch(SIM_REAL(f), o, n, pp); }
+static int simUnfetch(sqlite3_file *f, sqlite3_int64 o, void *p) { return SIM_REAL(f)->pMethods->xUnfetch(SIM_REAL(f), o, p); }
+
+static int simWrite(sqlite3_file *f, const void *p, int n, sqlite3_int64 o) {
+	sqlite3_int64 llSize = 0;
+
+	if (lSimSize && ((tSimFile *)f)->bHeld && (simFileSize(f, &llSize) == SQLITE_OK)) {
+		if ((o + n > llSize) && (simUsed() + (o + n - llSize) > lSimSize)) {
+			iSimFull++;
+			return SQLITE_FULL;
+		}
+	}
+	return SIM_REAL(f)->pMethods->xWrite(SIM_REAL(f), p, n, o);
+}
+
+static int simOpen(sqlite3_vfs *pxVfs, const char *zName, sqlite3_file *f, int iFlags, int *piOut) {
+	tSimFile *pxFile = (tSimFile *)f;
+	int iRet;
+
+	(void)pxVfs;
+	pxFile->pxReal = (sqlite3_file *)&pxFile[1];
+	iRet = pxHostVfs->xOpen(pxHostVfs, zName, pxFile->pxReal, iFlags, piOut);
+	if (pxFile->pxReal->pMethods == NULL) {
+		f->pMethods = NULL;
+		return iRet;
+	}
+	pxFile->bHeld = (zName != NULL) && !(iFlags & (SQLITE_OPEN_TEMP_DB | SQLITE_OPEN_TEMP_JOURNAL | SQLITE_OPEN_TRANSIENT_DB | SQLITE_OPEN_SUBJOURNAL));
+	xSimIo.iVersion = (pxFile->pxReal->pMethods->iVersion < 3) ? pxFile->pxReal->pMethods->iVersion : 3;
+	f->pMethods = &xSimIo;
+	return iRet;
+}
+
+static int simTime(sqlite3_vfs *pxVfs, double *pdNow) {
+	int iRet = pxHostVfs->xCurrentTime(pxHostVfs, pdNow);
+
+	(void)pxVfs;
+	*pdNow += (double)llSimShift / 86400000.0;
+	return iRet;
+}
+
+static int simTime64(sqlite3_vfs *pxVfs, sqlite3_int64 *pllNow) {
+	int iRet = pxHostVfs->xCurrentTimeInt64(pxHostVfs, pllNow);
+
+	(void)pxVfs;
+	*pllNow += llSimShift;
+	return iRet;
+}
+
+// The simulated disk made the default VFS, for the handles opened after.
+void simInit(void) {
+	static const sqlite3_io_methods xIo = {
+		3, simClose, simRead, simWrite, simTruncate, simSync, simFileSize, simLock, simUnlock,
+		simReserved, simControl, simSector, simDevice, simShmMap, simShmLock, simShmBarrier,
+		simShmUnmap, simFetch, simUnfetch
+	};
+
+	if (pxHostVfs)
+		return;
+	pxHostVfs = sqlite3_vfs_find(NULL);
+	xSimIo = xIo;
+	xSimVfs = *pxHostVfs;
+	xSimVfs.zName = "simdisk";
+	xSimVfs.szOsFile = (int)sizeof(tSimFile) + pxHostVfs->szOsFile;
+	xSimVfs.xOpen = simOpen;
+	xSimVfs.xCurrentTime = simTime;
+	xSimVfs.xCurrentTimeInt64 = simTime64;
+	sqlite3_vfs_register(&xSimVfs, 1);
+}
+
+word Telium_CurrentTask(void) {
+	if (iTask == 0)
+		iTask = __sync_add_and_fetch(&iTaskNext, 1);
+	return (word)iTask;
+}
+
+// Files of the host disk in the subdirectory host, out of the room counted
+static void fsPath(char *pcPath, size_t len, const char *pcFile) {
+	if (strncmp(pcFile, "/HOST/", 6) == 0)
+		snprintf(pcPath, len, "%s/host/%s", xCfg.pcDir, pcFile + 6);
+	else
+		benchPath(pcPath, len, pcFile);
+}
+
+int FS_mount(const char *pcVol, unsigned int *puiMode) {
+	char tcPath[512];
+
+	(void)puiMode;
+	mkdir(xCfg.pcDir, 0755);
+	if (strcmp(pcVol, "/HOST") == 0) {
+		snprintf(tcPath, sizeof(tcPath), "%s/host", xCfg.pcDir);
+		mkdir(tcPath, 0755);
+	}
+	return FS_OK;
+}
+
+int FS_dskcreate(S_FS_PARAM_CREATE *pxCfg, unsigned long *pulSize) {
+	(void)pxCfg;
+	(void)pulSize;
+	return FS_OK;
+}
+
+long FS_dskfree(const char *pcVol) { (void)pcVol; return simFree(); }
+int FS_unmount(const char *pcVol) { (void)pcVol; return FS_OK; }
+int FS_dskkill(const char *pcVol) { (void)pcVol; return FS_OK; }
+
+int FS_unlink(const char *pcFile) {
+	char tcPath[512];
+
+	if ((strncmp(pcFile, "/TDISK/", 7) != 0) && (strncmp(pcFile, "/HOST/", 6) != 0))
+		return FS_ERROR;
+	fsPath(tcPath, sizeof(tcPath), pcFile);
+	unlink(tcPath);
+	return FS_OK;
+}
+
+S_FS_FILE *FS_open(const char *pcFile, const char *pcMode) {
+	char tcPath[512];
+
+	fsPath(tcPath, sizeof(tcPath), pcFile);
+	return fopen(tcPath, (*pcMode == 'r') ? "rb" : "ab");
+}
+
+long FS_length(S_FS_FILE *hFile) {
+	struct stat xSt;
+
+	return (fstat(fileno(hFile), &xSt) == 0) ? (long)xSt.st_size : FS_ERROR;
+}
+
+int FS_read(void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile) { return (int)fread(pvBuf, iSize, iNbr, hFile); }
+int FS_write(const void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile) { return (int)fwrite(pvBuf, iSize, iNbr, hFile); }
+int FS_close(S_FS_FILE *hFile) { return (fclose(hFile) == 0) ? FS_OK : FS_ERROR; }
+
+void Generate_Menu_Content(void) {
+}
+
+T_OSL_HMUTEX OSL_Mutex_Create(int iName, int iSecurity) {
+	pthread_mutex_t *pxMtx = malloc(sizeof(*pxMtx));
+
+	(void)iName;
+	(void)iSecurity;
+	if (pxMtx)
+		pthread_mutex_init(pxMtx, NULL);
+	return pxMtx;
+}
+
+int OSL_Mutex_Lock(T_OSL_HMUTEX hMutex, int iTmo) {
+	(void)iTmo;
+	return pthread_mutex_lock((pthread_mutex_t *)hMutex) == 0 ? OSL_SUCCESS : -1;
+}
+
+int OSL_Mutex_Unlock(T_OSL_HMUTEX hMutex) {
+	return pthread_mutex_unlock((pthread_mutex_t *)hMutex) == 0 ? OSL_SUCCESS : -1;
+}
+
+//****************************************************************************
+//      MEASURES
+//****************************************************************************
+double nowUs(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void runInit(tRun *pxRun, int iDim) {
+	pxRun->pdUs = calloc(iDim, sizeof(double));
+	pxRun->iCnt = 0;
+	pxRun->iDim = iDim;
+}
+
+void runAdd(tRun *pxRun, double dUs) {
+	if (pxRun->iCnt < pxRun->iDim)
+		pxRun->pdUs[pxRun->iCnt++] = dUs;
+}
+
+static int cmpDbl(const void *a, const void *b) {
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+void runReport(const char *pcName, tRun *pxRun, int iOpen) {
+	double dSum = 0;
+	int i;
+
+	if (pxRun->iCnt == 0)
+		return;
+	qsort(pxRun->pdUs, pxRun->iCnt, sizeof(double), cmpDbl);
+	for (i = 0; i < pxRun->iCnt; i++)
+		dSum += pxRun->pdUs[i];
+	printf("%-22s %6d calls  p50 %8.1f us  p99 %8.1f us  mean %8.1f us  %8.0f/s  opens %d\n",
+	       pcName, pxRun->iCnt, pxRun->pdUs[pxRun->iCnt / 2], pxRun->pdUs[(pxRun->iCnt * 99) / 100],
+	       dSum / pxRun->iCnt, pxRun->iCnt * 1e6 / dSum, iOpen);
+	free(pxRun->pdUs);
+}
+
+void check(int bOk, const char *pcWhat) {
+	if (bOk)
+		return;
+	iFail++;
+	printf("FAIL %s\n", pcWhat);
+}
+
+//****************************************************************************
+//      LOG RECORDS
+//****************************************************************************
+void recStan(char *pcStan, int iRec) { sprintf(pcStan, "%06d", iRec + 1); }
+void recRrn(char *pcRrn, int iRec) { sprintf(pcRrn, "%012d", 700000 + iRec); }
+int recVoid(int iRec) { return (iRec % VOID_EVERY) == VOID_EVERY - 1; }
+
+static int recCredit(int iRec) { return (iRec % CREDIT_EVERY) == CREDIT_EVERY - 4; }
+int recAmount(int iRec) { return 100 * (iRec + 1); }
+void recEmv(char *pcEmv, int iRec) { sprintf(pcEmv, "9F2608%016d9F2701809F100706010A03A0A0009F3704%08d", iRec, iRec); }
+
+// Transaction as logSave finds it: data map and the EMV data in hex.
+void recMap(int iRec) {
+	char tc[32];
+
+	sprintf(tc, "%d", recVoid(iRec) ? mnuVoid : mnuSale);
+	mapPutStr(traMnuItm, tc);
+	sprintf(tc, "%06d", iRec + 1);
+	mapPutStr(traInvNum, tc);
+	mapPutStr(appBatchNumber, "000001");
+	mapPutStr(traRqsMTI, "0200");
+	mapPutStr(traPan, "4761739001010119");
+	mapPutStr(traRqsProcessingCode, "000000");
+	sprintf(tc, "%012d", recAmount(iRec));
+	mapPutStr(traAmt, tc);
+	mapPutStr(traDatTim, "1019101500");
+	recStan(tc, iRec);
+	mapPutStr(traSTAN, tc);
+	mapPutStr(traExpDat, "2812");
+	mapPutStr(traPosEntMod, "051");
+	mapPutStr(traCrdSeq, "");
+	mapPutStr(appNII, "");
+	mapPutStr(traConCode, "");
+	mapPutStr(traTrk2, "");
+	recRrn(tc, iRec);
+	mapPutStr(traRrn, tc);
+	sprintf(tc, "A%05d", iRec);
+	mapPutStr(traAutCod, tc);
+	mapPutStr(traRspCod, "00");
+	mapPutStr(appTID, "TERM0001");
+	mapPutStr(appMID, "MERCHANT0000001");
+	mapPutStr(emvTrnCurCod, CURRENCY);
+	mapPutStr(traCashbackAmt, "");
+	mapPutStr(traBillerPaymentDetails, "");
+	mapPutStr(traField063, "");
+	mapPutStr(traDrCr, recCredit(iRec) ? "C" : "D");
+	mapPutStr(traNetTiming, "120,80,40");
+	recEmv(isoField055, iRec);
+}
+
+// Insert of logSave before the typed log: every column of the table.
+void recInsert(char *pcSql, int iRec) {
+	char tcStan[16], tcRrn[16], tcEmv[80];
+	char *pc = pcSql;
+	int iFld;
+
+	recStan(tcStan, iRec);
+	recRrn(tcRrn, iRec);
+	recEmv(tcEmv, iRec);
+	pc += sprintf(pc, "INSERT INTO log (MenuItem, InvoiceNo");
+	for (iFld = 0; iFld <= 128; iFld++)
+		pc += sprintf(pc, ", isoField%03d", iFld);
+	pc += sprintf(pc, ", isoDrCr, isoVoided, NetTiming) VALUES ('%d' ,'%06d'", recVoid(iRec) ? mnuVoid : mnuSale, iRec + 1);
+	for (iFld = 0; iFld <= 128; iFld++) {
+		switch (iFld) {
+		case 0: pc += sprintf(pc, " ,'0200'"); break;
+		case 2: pc += sprintf(pc, " ,'4761739001010119'"); break;
+		case 3: pc += sprintf(pc, " ,'000000'"); break;
+		case 4: pc += sprintf(pc, " ,'%012d'", recAmount(iRec)); break;
+		case 7: pc += sprintf(pc, " ,'1019101500'"); break;
+		case 11: pc += sprintf(pc, " ,'%s'", tcStan); break;
+		case 14: pc += sprintf(pc, " ,'2812'"); break;
+		case 22: pc += sprintf(pc, " ,'051'"); break;
+		case 37: pc += sprintf(pc, " ,'%s'", tcRrn); break;
+		case 38: pc += sprintf(pc, " ,'A%05d'", iRec); break;
+		case 39: pc += sprintf(pc, " ,'00'"); break;
+		case 41: pc += sprintf(pc, " ,'TERM0001'"); break;
+		case 42: pc += sprintf(pc, " ,'MERCHANT0000001'"); break;
+		case 49: pc += sprintf(pc, " ,'" CURRENCY "'"); break;
+		case 55: pc += sprintf(pc, " ,'%s'", tcEmv); break;
+		default: pc += sprintf(pc, " ,''"); break;
+		}
+	}
+	sprintf(pc, " ,'%c', '0', '120,80,40');", recCredit(iRec) ? 'C' : 'D');
+}
+
+// Last record the reprint would give: not a void, not a balance enquiry.
+int recLast(int iRecords) {
+	int iRec;
+
+	for (iRec = iRecords - 1; iRec >= 0; iRec--) {
+		if (!recVoid(iRec))
+			return iRec;
+	}
+	return -1;
+}
+
+//****************************************************************************
+//      LOG AND QUEUES
+//****************************************************************************
+int logCount(void) {
+	char tcRsp[256];
+
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement("SELECT COUNT(*) FROM log;", tcRsp);
+	return atoi(tcRsp);
+}
+
+int rowCount(const char *pcSql) {
+	char tcRsp[256];
+
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement(pcSql, tcRsp);
+	return atoi(tcRsp);
+}
+
+int adviceCount(void) {
+	char tcRsp[256];
+
+	memset(tcRsp, 0, sizeof(tcRsp));
+	Sqlite_Run_Statement("SELECT COUNT(*) FROM advice;", tcRsp);
+	return atoi(tcRsp);
+}
+
+// Records iFrom to iFrom + iRecords saved in the batch given.
+void batchFill(int iFrom, int iRecords, const char *pcBatch) {
+	int iRec;
+
+	for (iRec = iFrom; iRec < iFrom + iRecords; iRec++) {
+		if (((iRec - iFrom) % FILL_COMMIT) == 0) {
+			if (iRec > iFrom)
+				sqlite_Txn_End(1);
+			sqlite_Txn_Begin();
+		}
+		recMap(iRec);
+		mapPutStr(appBatchNumber, pcBatch);
+		if (sqlite_Log_Save() <= 0)
+			iFail++;
+	}
+	sqlite_Txn_End(1);
+}
+
+// Writes of a sale to the database: the log record with its running totals,
+// the advice, and for a void the flag of the original. bGroup: one commit.
+int saleSave(int iRec, int bGroup, int bCommit) {
+	char tcStan[16];
+	int iRet;
+
+	recMap(iRec);
+	recStan(tcStan, iRec);
+	if (bGroup)
+		sqlite_Txn_Begin();
+	iRet = sqlite_Log_Save();
+	if (iRet > 0)
+		iRet = sqlite_Advice_Put(tcStan, recVoid(iRec) ? "3" : "1", "0220DEADBEEF", ADVICE_MAX);
+	if ((iRet > 0) && recVoid(iRec)) {
+		recStan(tcStan, iRec - 1);
+		iRet = sqlite_CloseVoid(tcStan);
+	}
+	if (bGroup)
+		iRet = (sqlite_Txn_End((iRet > 0) && bCommit) > 0) ? iRet : -1;
+	return iRet;
+}
+
+// Background sender: queue an advice, read it back and deliver it.
+void *mixAdvice(void *pvArg) {
+	char tcStan[16], tcGot[lenSTAN + 1], tcReq[64];
+	int i = 0;
+
+	(void)pvArg;
+	while (!bMixStop) {
+		sprintf(tcStan, "9%05d", i++ % 100000);
+		if (sqlite_Advice_Put(tcStan, "1", "0220DEADBEEF", ADVICE_MAX) != 1)
+			iMixErr++;
+		if (sqlite_Advice_Peek(tcGot, tcReq, sizeof(tcReq)) != 1)
+			iMixErr++;
+		if (sqlite_Advice_Update(tcGot, 1, 3) != 1)
+			iMixErr++;
+		iMixOps++;
+	}
+	return NULL;
+}
+
+//****************************************************************************
+//      TIMED CALLS
+//****************************************************************************
+void runLogSave(int iFrom, int iTo, tRun *pxRun) {
+	double dBeg;
+	int iRec;
+
+	for (iRec = iFrom; iRec < iTo; iRec++) {
+		recMap(iRec);
+		dBeg = nowUs();
+		if (sqlite_Log_Save() <= 0)
+			iMixErr++;
+		if (pxRun)
+			runAdd(pxRun, nowUs() - dBeg);
+	}
+}
+
+void runFindStan(int iRecords, int iQueries, tRun *pxRun) {
+	char tcStan[16], tcRrn[16], tcGot[lenRrn + 1];
+	double dBeg;
+	int i, iRec, iRet, iBad = 0;
+
+	for (i = 0; i < iQueries; i++) {
+		iRec = rand() % iRecords;
+		recStan(tcStan, iRec);
+		recRrn(tcRrn, iRec);
+		mapPutStr(traSTAN, tcStan);
+		mapPutStr(traRrn, "");
+		dBeg = nowUs();
+		iRet = sqlite_Get_LOG_Record(0, 0, traSTAN);
+		runAdd(pxRun, nowUs() - dBeg);
+
+		mapGet(traRrn, tcGot, sizeof(tcGot));
+		if (recVoid(iRec))                       // Voids are left out
+			iBad += (iRet > 0);
+		else
+			iBad += (iRet <= 0) || (strcmp(tcGot, tcRrn) != 0);
+	}
+	check(iBad == 0, "sqlite_Get_LOG_Record by STAN");
+}
+
+void runFindRrn(int iRecords, int iQueries, tRun *pxRun) {
+	char tcStan[16], tcRrn[16], tcGot[lenSTAN + 3];
+	double dBeg;
+	int i, iRec, iRet, iBad = 0;
+
+	for (i = 0; i < iQueries; i++) {
+		iRec = rand() % iRecords;
+		recStan(tcStan, iRec);
+		recRrn(tcRrn, iRec);
+		mapPutStr(traRrn, tcRrn);
+		mapPutStr(traSTAN, "");
+		dBeg = nowUs();
+		iRet = sqlite_Get_LOG_Record(traRrn, 0, 0);
+		runAdd(pxRun, nowUs() - dBeg);
+
+		mapGet(traSTAN, tcGot, sizeof(tcGot));
+		if (recVoid(iRec))
+			iBad += (iRet > 0);
+		else
+			iBad += (iRet <= 0) || (strcmp(tcGot, tcStan) != 0);
+	}
+	check(iBad == 0, "sqlite_Get_LOG_Record by RRN");
+}
+
+//****************************************************************************
+//      MAIN
+//****************************************************************************
+static void usage(void) {
+	fprintf(stderr, "usage: sqlbench [-d dir] [-n records] [-q queries] [-s sizes] [-c rows] [-w sales] [-p sizes] [-r records] [-m] [-a] [-f kb] [-x records] [-v]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	void (*pfnBench)(const char *pcArg) = lookupBench;
+	const char *pcArg = NULL;
+	int iOpt, i;
+
+	while ((iOpt = getopt(argc, argv, "d:n:q:s:c:w:p:r:maf:x:v")) != -1) {
+		switch (iOpt) {
+		case 'd': xCfg.pcDir = optarg; break;
+		case 'n': xCfg.iRecords = atoi(optarg); break;
+		case 'q': xCfg.iQueries = atoi(optarg); break;
+		case 'v': xCfg.iVerbose = 1; break;
+		default:
+			for (i = 0; i < (int)(sizeof(tzBench) / sizeof(tzBench[0])); i++) {
+				if (tzBench[i].iOpt == iOpt)
+					break;
+			}
+			if (i == (int)(sizeof(tzBench) / sizeof(tzBench[0])))
+				usage();
+			pfnBench = tzBench[i].pfnBench;
+			pcArg = optarg ? optarg : "";
+		}
+	}
+	if ((xCfg.iRecords < VOID_EVERY) || (xCfg.iQueries <= 0))
+		usage();
+	srand(1);
+
+	pfnBench(pcArg);
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+/*
+ * expfile.c
+ *
+ *  Log export of the terminal, host side: frames, CRC-32 and the rows
+ *  applied to a database of the host. The format is written by
+ *  sqlite_Export in Src/Sqlite.c; see README.md.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "expfile.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+enum {                                     // Frames
+	expHead = 'H',
+	expSchema = 'S',
+	expRow = 'R',
+	expDel = 'D',
+	expEnd = 'E'
+};
+
+enum {                                     // Values of a row
+	expNull,
+	expInt,
+	expReal,
+	expText,
+	expBlob
+};
+
+#define EXP_STATE "CREATE TABLE IF NOT EXISTS exp_imp (id INTEGER PRIMARY KEY CHECK (id = 1), Seq INTEGER NOT NULL, Crc INTEGER NOT NULL);"
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	const unsigned char *pucCur;
+	const unsigned char *pucEnd;
+} tExpRd;
+
+//****************************************************************************
+//      PRIVATE FUNCTIONS
+//****************************************************************************
+static unsigned int expCrc(const unsigned char *pucBuf, long lLen) {
+	unsigned int uiCrc = 0xFFFFFFFF;
+	int iBit;
+
+	while (lLen-- > 0) {
+		uiCrc ^= *pucBuf++;
+		for (iBit = 0; iBit < 8; iBit++)
+			uiCrc = (uiCrc >> 1) ^ (0xEDB88320 & -(uiCrc & 1));
+	}
+	return ~uiCrc;
+}
+
+static int rdVar(tExpRd *pxRd, unsigned long long *pullVal) {
+	unsigned long long ullVal = 0;
+	int iShift = 0;
+
+	while (pxRd->pucCur < pxRd->pucEnd) {
+		unsigned char ucByte = *pxRd->pucCur++;
+
+		ullVal |= (unsigned long long)(ucByte & 0x7F) << iShift;
+		if ((ucByte & 0x80) == 0) {
+			*pullVal = ullVal;
+			return 0;
+		}
+		iShift += 7;
+		if (iShift > 63)
+			break;
+	}
+	return -1;
+}
+
+static int rdBytes(tExpRd *pxRd, const unsigned char **ppucVal, unsigned long long ullLen) {
+	if (ullLen > (unsigned long long)(pxRd->pucEnd - pxRd->pucCur))
+		return -1;
+	*ppucVal = pxRd->pucCur;
+	pxRd->pucCur += ullLen;
+	return 0;
+}
+
+// Next frame: its type and a reader of its payload
+static int rdFrame(tExpRd *pxRd, unsigned char *pucType, tExpRd *pxPay) {
+	unsigned long long ullLen;
+	const unsigned char *pucPay;
+
+	if (pxRd->pucCur >= pxRd->pucEnd)
+		return -1;
+	*pucType = *pxRd->pucCur++;
+	if ((rdVar(pxRd, &ullLen) < 0) || (rdBytes(pxRd, &pucPay, ullLen) < 0))
+		return -1;
+	pxPay->pucCur = pucPay;
+	pxPay->pucEnd = pucPay + ullLen;
+	return 0;
+}
+
+static int rdHead(tExpRd *pxPay, tExpInfo *pxInfo) {
+	unsigned long long ullVer, ullFull, ullFrom, ullTo, ullTbl, ullLen;
+	const unsigned char *pucName;
+	int iTbl;
+
+	if ((rdVar(pxPay, &ullVer) < 0) || (ullVer != EXP_VERSION))
+		return -1;
+	if ((rdVar(pxPay, &ullFull) < 0) || (rdVar(pxPay, &ullFrom) < 0) || (rdVar(pxPay, &ullTo) < 0) || (rdVar(pxPay, &ullTbl) < 0))
+		return -1;
+	if ((ullTbl > EXP_TABLES) || (ullFrom > ullTo))
+		return -1;
+	pxInfo->iFull = (int)ullFull;
+	pxInfo->llFrom = (long long)ullFrom;
+	pxInfo->llTo = (long long)ullTo;
+	pxInfo->iTables = (int)ullTbl;
+	for (iTbl = 0; iTbl < pxInfo->iTables; iTbl++) {
+		if ((rdVar(pxPay, &ullLen) < 0) || (ullLen >= sizeof(pxInfo->tzTable[0])) || (rdBytes(pxPay, &pucName, ullLen) < 0))
+			return -1;
+		memcpy(pxInfo->tzTable[iTbl], pucName, ullLen);
+		pxInfo->tzTable[iTbl][ullLen] = 0;
+	}
+	return 0;
+}
+
+// Statement writing the rows of a table by rowid, its columns in the order of the table
+static sqlite3_stmt *insPrepare(sqlite3 *hDb, const char *pcTbl, int *piCols) {
+	sqlite3_stmt *hInfo = NULL, *hIns = NULL;
+	char tcSql[4096];
+	int iLen, iCol = 0;
+
+	snprintf(tcSql, sizeof(tcSql), "PRAGMA table_info(\"%s\");", pcTbl);
+	if (sqlite3_prepare_v2(hDb, tcSql, -1, &hInfo, NULL) != SQLITE_OK)
+		return NULL;
+	iLen = snprintf(tcSql, sizeof(tcSql), "INSERT OR REPLACE INTO \"%s\" (rowid", pcTbl);
+	while ((sqlite3_step(hInfo) == SQLITE_ROW) && (iLen < (int)sizeof(tcSql) - 64)) {
+		iLen += snprintf(tcSql + iLen, sizeof(tcSql) - iLen, ", \"%s\"", sqlite3_column_text(hInfo, 1));
+		iCol++;
+	}
+	sqlite3_finalize(hInfo);
+	iLen += snprintf(tcSql + iLen, sizeof(tcSql) - iLen, ") VALUES (?");
+	for (*piCols = iCol; iCol > 0; iCol--)
+		iLen += snprintf(tcSql + iLen, sizeof(tcSql) - iLen, ", ?");
+	snprintf(tcSql + iLen, sizeof(tcSql) - iLen, ");");
+	if (*piCols == 0)
+		return NULL;
+	if (sqlite3_prepare_v2(hDb, tcSql, -1, &hIns, NULL) != SQLITE_OK)
+		return NULL;
+	return hIns;
+}
+
+static int applyRow(sqlite3 *hDb, tExpRd *pxPay, const tExpInfo *pxInfo, sqlite3_stmt **phIns, int *piCols) {
+	unsigned long long ullTbl, ullRid, ullCols, ullVal;
+	const unsigned char *pucVal;
+	long long llVal;
+	double dVal;
+	unsigned char ucTag;
+	int iCol, iIdx;
+
+	if ((rdVar(pxPay, &ullTbl) < 0) || (ullTbl >= (unsigned long long)pxInfo->iTables))
+		return -1;
+	if ((rdVar(pxPay, &ullRid) < 0) || (rdVar(pxPay, &ullCols) < 0))
+		return -1;
+	if (phIns[ullTbl] == NULL)
+		phIns[ullTbl] = insPrepare(hDb, pxInfo->tzTable[ullTbl], &piCols[ullTbl]);
+	if ((phIns[ullTbl] == NULL) || (ullCols != (unsigned long long)piCols[ullTbl]))
+		return -1;                         // Table missing, or not the columns of the terminal
+
+	sqlite3_reset(phIns[ullTbl]);
+	sqlite3_clear_bindings(phIns[ullTbl]);
+	sqlite3_bind_int64(phIns[ullTbl], 1, (sqlite3_int64)ullRid);
+	for (iCol = 0; iCol < (int)ullCols; iCol++) {
+		if (pxPay->pucCur >= pxPay->pucEnd)
+			return -1;
+		switch (ucTag = *pxPay->pucCur++) {
+		case expNull:
+			break;
+		case expInt:
+			if (rdVar(pxPay, &ullVal) < 0)
+				return -1;
+			llVal = (long long)(ullVal >> 1) ^ -(long long)(ullVal & 1);
+			sqlite3_bind_int64(phIns[ullTbl], iCol + 2, llVal);
+			break;
+		case expReal:
+			if (rdBytes(pxPay, &pucVal, 8) < 0)
+				return -1;
+			for (ullVal = 0, iIdx = 7; iIdx >= 0; iIdx--)
+				ullVal = (ullVal << 8) | pucVal[iIdx];
+			memcpy(&dVal, &ullVal, sizeof(dVal));
+			sqlite3_bind_double(phIns[ullTbl], iCol + 2, dVal);
+			break;
+		case expText:
+		case expBlob:
+			if ((rdVar(pxPay, &ullVal) < 0) || (rdBytes(pxPay, &pucVal, ullVal) < 0))
+				return -1;
+			if (ucTag == expText)
+				sqlite3_bind_text(phIns[ullTbl], iCol + 2, (const char *)pucVal, (int)ullVal, SQLITE_STATIC);
+			else
+				sqlite3_bind_blob(phIns[ullTbl], iCol + 2, pucVal, (int)ullVal, SQLITE_STATIC);
+			break;
+		default:
+			return -1;
+		}
+	}
+	if (pxPay->pucCur != pxPay->pucEnd)
+		return -1;
+	return (sqlite3_step(phIns[ullTbl]) == SQLITE_DONE) ? 0 : -1;
+}
+
+static int applyDel(sqlite3 *hDb, tExpRd *pxPay, const tExpInfo *pxInfo) {
+	unsigned long long ullTbl, ullRid;
+	sqlite3_stmt *hDel = NULL;
+	char tcSql[128];
+	int iRet;
+
+	if ((rdVar(pxPay, &ullTbl) < 0) || (ullTbl >= (unsigned long long)pxInfo->iTables) || (rdVar(pxPay, &ullRid) < 0))
+		return -1;
+	snprintf(tcSql, sizeof(tcSql), "DELETE FROM \"%s\" WHERE rowid = ?;", pxInfo->tzTable[ullTbl]);
+	if (sqlite3_prepare_v2(hDb, tcSql, -1, &hDel, NULL) != SQLITE_OK)
+		return -1;
+	sqlite3_bind_int64(hDel, 1, (sqlite3_int64)ullRid);
+	iRet = (sqlite3_step(hDel) == SQLITE_DONE) ? 0 : -1;
+	sqlite3_finalize(hDel);
+	return iRet;
+}
+
+// Tables and views of a full export made again; the state of the importer stays
+static int dropAll(sqlite3 *hDb) {
+	sqlite3_stmt *hStmt = NULL;
+	char tzDrop[64][80];
+	int iCnt = 0, iIdx;
+
+	if (sqlite3_prepare_v2(hDb, "SELECT type, name FROM sqlite_master WHERE type IN ('view', 'table') AND name NOT LIKE 'sqlite_%' AND name != 'exp_imp' ORDER BY type = 'table';", -1, &hStmt, NULL) != SQLITE_OK)
+		return -1;
+	while ((sqlite3_step(hStmt) == SQLITE_ROW) && (iCnt < 64))
+		snprintf(tzDrop[iCnt++], sizeof(tzDrop[0]), "DROP %s \"%s\";", strcmp((const char *)sqlite3_column_text(hStmt, 0), "view") ? "TABLE" : "VIEW", sqlite3_column_text(hStmt, 1));
+	sqlite3_finalize(hStmt);
+	for (iIdx = 0; iIdx < iCnt; iIdx++) {
+		if (sqlite3_exec(hDb, tzDrop[iIdx], NULL, NULL, NULL) != SQLITE_OK)
+			return -1;
+	}
+	return 0;
+}
+
+//****************************************************************************
+//      PUBLIC FUNCTIONS
+//****************************************************************************
+// Check the frames of an export and its CRC, and read its header.
+// Returns 0 when it is whole, -1 otherwise.
+int expCheck(const unsigned char *pucBuf, long lLen, tExpInfo *pxInfo) {
+	tExpRd xRd, xPay;
+	unsigned long long ullFrames;
+	const unsigned char *pucFrame;
+	unsigned char ucType;
+	unsigned int uiCrc;
+
+	memset(pxInfo, 0, sizeof(*pxInfo));
+	xRd.pucCur = pucBuf;
+	xRd.pucEnd = pucBuf + lLen;
+	if ((rdFrame(&xRd, &ucType, &xPay) < 0) || (ucType != expHead) || (rdHead(&xPay, pxInfo) < 0))
+		return -1;
+	for (pxInfo->lFrames = 1; ; pxInfo->lFrames++) {
+		pucFrame = xRd.pucCur;
+		if (rdFrame(&xRd, &ucType, &xPay) < 0)
+			return -1;                     // Truncated: no end frame
+		if (ucType == expEnd)
+			break;
+		pxInfo->lSchema += (ucType == expSchema);
+		pxInfo->lRows += (ucType == expRow);
+		pxInfo->lDeletes += (ucType == expDel);
+	}
+	if ((rdVar(&xPay, &ullFrames) < 0) || (ullFrames != (unsigned long long)pxInfo->lFrames) || (xPay.pucEnd - xPay.pucCur != 4))
+		return -1;
+	uiCrc = xPay.pucCur[0] | (xPay.pucCur[1] << 8) | (xPay.pucCur[2] << 16) | ((unsigned int)xPay.pucCur[3] << 24);
+	if ((xRd.pucCur != xRd.pucEnd) || (uiCrc != expCrc(pucBuf, pucFrame - pucBuf)))
+		return -1;
+	pxInfo->uiCrc = uiCrc;
+	return 0;
+}
+
+// Apply an export to a database of the host, in one transaction: a full
+// export makes the tables again, a delta needs the changes up to its From.
+// Returns expApplied, expAlready, or expBad, expGap, expDbErr with the
+// database as it was.
+int expApply(sqlite3 *hDb, const unsigned char *pucBuf, long lLen, tExpInfo *pxInfo) {
+	sqlite3_stmt *tphIns[EXP_TABLES] = { NULL };
+	int tiCols[EXP_TABLES];
+	sqlite3_stmt *hStmt = NULL;
+	tExpRd xRd, xPay;
+	unsigned char ucType;
+	long long llSeq = -1;
+	char *pcSql;
+	int iIdx, iRet = expDbErr;
+
+	if (expCheck(pucBuf, lLen, pxInfo) < 0)
+		return expBad;
+	if (sqlite3_exec(hDb, EXP_STATE, NULL, NULL, NULL) != SQLITE_OK)
+		return expDbErr;
+	if (sqlite3_prepare_v2(hDb, "SELECT Seq FROM exp_imp;", -1, &hStmt, NULL) != SQLITE_OK)
+		return expDbErr;
+	if (sqlite3_step(hStmt) == SQLITE_ROW)
+		llSeq = sqlite3_column_int64(hStmt, 0);
+	sqlite3_finalize(hStmt);
+	hStmt = NULL;
+	if (!pxInfo->iFull && ((llSeq < 0) || (llSeq < pxInfo->llFrom)))
+		return expGap;
+	if (!pxInfo->iFull && (pxInfo->llTo <= llSeq))
+		return expAlready;
+
+	if (sqlite3_exec(hDb, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK)
+		return expDbErr;
+	if (pxInfo->iFull && (dropAll(hDb) < 0))
+		goto lblKO;
+	xRd.pucCur = pucBuf;
+	xRd.pucEnd = pucBuf + lLen;
+	while ((rdFrame(&xRd, &ucType, &xPay) == 0) && (ucType != expEnd)) {
+		switch (ucType) {
+		case expSchema:
+			pcSql = sqlite3_mprintf("%.*s", (int)(xPay.pucEnd - xPay.pucCur), xPay.pucCur);
+			iIdx = sqlite3_exec(hDb, pcSql, NULL, NULL, NULL);
+			sqlite3_free(pcSql);
+			if (iIdx != SQLITE_OK)
+				goto lblKO;
+			break;
+		case expRow:
+			if (applyRow(hDb, &xPay, pxInfo, tphIns, tiCols) < 0)
+				goto lblKO;
+			break;
+		case expDel:
+			if (applyDel(hDb, &xPay, pxInfo) < 0)
+				goto lblKO;
+			break;
+		default:                           // Header, or a frame of a later version
+			break;
+		}
+	}
+
+	if (sqlite3_prepare_v2(hDb, "INSERT OR REPLACE INTO exp_imp VALUES (1, ?, ?);", -1, &hStmt, NULL) != SQLITE_OK)
+		goto lblKO;
+	sqlite3_bind_int64(hStmt, 1, pxInfo->llTo);
+	sqlite3_bind_int64(hStmt, 2, pxInfo->uiCrc);
+	if (sqlite3_step(hStmt) != SQLITE_DONE)
+		goto lblKO;
+	sqlite3_finalize(hStmt);
+	hStmt = NULL;
+	for (iIdx = 0; iIdx < EXP_TABLES; iIdx++)
+		sqlite3_finalize(tphIns[iIdx]);
+	if (sqlite3_exec(hDb, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+		sqlite3_exec(hDb, "ROLLBACK;", NULL, NULL, NULL);
+		return expDbErr;
+	}
+	return expApplied;
+
+lblKO:
+	sqlite3_finalize(hStmt);
+	for (iIdx = 0; iIdx < EXP_TABLES; iIdx++)
+		sqlite3_finalize(tphIns[iIdx]);
+	sqlite3_exec(hDb, "ROLLBACK;", NULL, NULL, NULL);
+	return iRet;
+}
+
+// Write the acknowledgement the terminal reads at its next export: the
+// last change and the CRC of the export applied.
+int expAck(const char *pcFile, const tExpInfo *pxInfo) {
+	FILE *pxFile = fopen(pcFile, "w");
+
+	if (pxFile == NULL)
+		return -1;
+	fprintf(pxFile, "%lld %08X\n", pxInfo->llTo, pxInfo->uiCrc);
+	return (fclose(pxFile) == 0) ? 0 : -1;
+}
@@ -0,0 +1,42 @@
+/*
+ * expfile.h
+ *
+ *  Reader of the log export of the terminal (sqlite_Export in Src/Sqlite.c)
+ *  for the host tools: checks the frames and the CRC-32 of an export, then
+ *  applies it to a database of the host, which holds the log tables as the
+ *  terminal does once the exports since the last full one are applied.
+ */
+#ifndef __EXPFILE_H__
+#define __EXPFILE_H__
+
+#include <sqlite3.h>
+
+#define EXP_VERSION   1
+#define EXP_TABLES    8                    // Tables an export may name
+
+enum {                                     // Outcome of expApply
+	expApplied = 1,
+	expAlready = 0,                        // Changes already applied, acknowledged again
+	expBad = -1,                           // Truncated, corrupted or of another version
+	expGap = -2,                           // Delta from a change the database does not have
+	expDbErr = -3
+};
+
+typedef struct {
+	int iFull;                             // Every row, the tables made again
+	long long llFrom;                      // Last change acknowledged by the host
+	long long llTo;                        // Last change exported
+	int iTables;
+	char tzTable[EXP_TABLES][32];          // Names, index given by the frames
+	long lFrames;
+	long lSchema;                          // Tables, indexes and views
+	long lRows;
+	long lDeletes;
+	unsigned int uiCrc;                    // Given back in the acknowledgement
+} tExpInfo;
+
+int expCheck(const unsigned char *pucBuf, long lLen, tExpInfo *pxInfo);
+int expApply(sqlite3 *hDb, const unsigned char *pucBuf, long lLen, tExpInfo *pxInfo);
+int expAck(const char *pcFile, const tExpInfo *pxInfo);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * sqlimport.c
+ *
+ *  Applies a log export of the terminal (HOST/TSLDELTA.BIN, see
+ *  sqlite_Export in Src/Sqlite.c) to a database of the host, then writes
+ *  the acknowledgement to copy back to the HOST disk of the terminal. A
+ *  truncated or corrupted export, or a delta the database lacks the changes
+ *  for, leaves the database as it was and writes no acknowledgement.
+ *
+ *  Usage: sqlimport [-a ack] [-v] db export
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "expfile.h"
+
+static void usage(void) {
+	fprintf(stderr, "usage: sqlimport [-a ack] [-v] db export\n");
+	exit(2);
+}
+
+static unsigned char *readFile(const char *pcFile, long *plLen) {
+	unsigned char *pucBuf;
+	FILE *pxFile = fopen(pcFile, "rb");
+
+	if (pxFile == NULL)
+		return NULL;
+	fseek(pxFile, 0, SEEK_END);
+	*plLen = ftell(pxFile);
+	fseek(pxFile, 0, SEEK_SET);
+	pucBuf = malloc(*plLen > 0 ? *plLen : 1);
+	if ((pucBuf != NULL) && (fread(pucBuf, 1, *plLen, pxFile) != (size_t)*plLen)) {
+		free(pucBuf);
+		pucBuf = NULL;
+	}
+	fclose(pxFile);
+	return pucBuf;
+}
+
+int main(int argc, char **argv) {
+	static const char *tzOutcome[] = { "database error", "gap: apply the exports before it, or export the whole log", "rejected: truncated or corrupted" };
+	tExpInfo xInfo;
+	sqlite3 *hDb = NULL;
+	unsigned char *pucBuf;
+	char tcAck[1024];
+	const char *pcAck = NULL;
+	const char *pcSlash;
+	long lLen;
+	int iOpt, iVerbose = 0, iRet;
+
+	while ((iOpt = getopt(argc, argv, "a:v")) != -1) {
+		switch (iOpt) {
+		case 'a': pcAck = optarg; break;
+		case 'v': iVerbose = 1; break;
+		default: usage();
+		}
+	}
+	if (argc - optind != 2)
+		usage();
+
+	if (pcAck == NULL) {                   // Next to the export, under the name the terminal reads
+		pcSlash = strrchr(argv[optind + 1], '/');
+		snprintf(tcAck, sizeof(tcAck), "%.*sTSLDELTA.ACK", pcSlash ? (int)(pcSlash - argv[optind + 1] + 1) : 0, argv[optind + 1]);
+		pcAck = tcAck;
+	}
+
+	pucBuf = readFile(argv[optind + 1], &lLen);
+	if (pucBuf == NULL) {
+		fprintf(stderr, "%s: cannot read\n", argv[optind + 1]);
+		return 1;
+	}
+	if (sqlite3_open(argv[optind], &hDb) != SQLITE_OK) {
+		fprintf(stderr, "%s: %s\n", argv[optind], sqlite3_errmsg(hDb));
+		return 1;
+	}
+
+	iRet = expApply(hDb, pucBuf, lLen, &xInfo);
+	if (iRet < 0) {
+		fprintf(stderr, "%s: %s\n", argv[optind + 1], tzOutcome[iRet - expDbErr]);
+		if ((iRet == expDbErr) && iVerbose)
+			fprintf(stderr, "%s\n", sqlite3_errmsg(hDb));
+	} else {
+		printf("%s %s changes %lld..%lld  %ld rows  %ld deleted  %ld bytes  crc %08X\n",
+				(iRet == expAlready) ? "already applied," : "applied,", xInfo.iFull ? "full" : "delta",
+				xInfo.llFrom, xInfo.llTo, xInfo.lRows, xInfo.lDeletes, lLen, xInfo.uiCrc);
+		if (expAck(pcAck, &xInfo) < 0) {
+			fprintf(stderr, "%s: cannot write\n", pcAck);
+			iRet = -1;
+		} else if (iVerbose)
+			printf("acknowledgement in %s\n", pcAck);
+	}
+	sqlite3_close(hDb);
+	free(pucBuf);
+	return (iRet < 0) ? 1 : 0;
+}
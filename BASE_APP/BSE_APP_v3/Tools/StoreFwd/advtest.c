@@ -0,0 +1,451 @@
+/*
+ * advtest.c
+ *
+ *  Order and power cuts of the advice queue of Src/AdviseMgr.c. The sales
+ *  queue their 0220 through AdviseTransactionManager, and the background
+ *  runs of AdviseQueueDrain deliver them. Each step is a process, as in
+ *  revtest.c. The host writes each advice it receives in host.log, with
+ *  its answer, and the checks read the order of the acknowledgements from
+ *  it.
+ *
+ *  Usage: advtest [-d dir] [-n advices] [-v]
+ */
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sqlite3.h>
+
+#include <globals.h>
+#include "Sqlite.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define CUT_EXIT        99             // Exit code of a step cut off by a power cut
+#define RETRY_MAX       20             // ADV_RETRY_MAX of AdviseMgr.c
+#define DRAIN_RUNS      500            // Background runs before a drain gives up
+#define FAIL_EVERY      7              // Advices the flaky host answers before it misses one
+#define POISON          5              // Advice the host always refuses in the parking scenario
+#define CUT_AT          4              // Advice at which the drain is cut
+#define KILL_ROUNDS     30             // Power cuts while the advices are queued
+#define KILL_US         3000           // Longest run of the enqueue before its power cut
+#define FULL_MAX        3              // Queue size of the full queue scenario
+
+enum {                                 // Power cut points of the drain
+	cutNone,
+	cutTake,                           // Sender taking the link for advice CUT_AT
+	cutSent,                           // Advice CUT_AT received by the host, 0230 not back yet
+};
+
+enum {                                 // Hosts
+	hstUp,                             // Answers every advice
+	hstFlaky,                          // Misses one advice in FAIL_EVERY
+	hstPoison,                         // Refuses advice POISON
+};
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static int iAdvices = 50;              // Advices of each scenario
+static int iCut = cutNone;             // Power cut point of the running step
+static int iHost = hstUp;
+static int iHostMsgs = 0;              // Advices received by the host in this step
+static int iTakes = 0;                 // Links taken by the sender in this step
+static int iVerbose = 0;
+static int iFail = 0;
+extern char DataBaseName[100];
+
+//****************************************************************************
+//      TRANSACTION AND LINK
+//****************************************************************************
+static void powerCut(int iAt) {
+	if (iCut == iAt)
+		_exit(CUT_EXIT);
+}
+
+// Request of the data map: MTI in BCD, the bitmap, then the STAN. The
+// card is swiped with a PIN: modifyBitmap (req.c) sets the PIN block, its
+// key and the track 1 data in every request, and takes them out with the
+// track 2 data when traAdviceBuild is set.
+int reqBuild(tBuffer *req) {
+	char tcMti[16], tcStan[lenSTAN + 1], tcMap[4 + lenBitmap * 4];
+	byte tucMti[2], tucMap[1 + lenBitmap];
+	byte ucAdv = 0;
+	int ret = 0;
+
+	MAPGET(traRqsMTI, tcMti, lblKO);
+	MAPGET(traSTAN, tcStan, lblKO);
+	MAPGET(traRqsBitMap, tcMap, lblKO);
+	CHECK(strlen(tcMti) >= lenMti, lblKO);
+	hex2bin(tucMti, &tcMti[strlen(tcMti) - lenMti], 2);
+	memset(tucMap, 0, sizeof(tucMap));
+	if (strlen(tcMap) >= 2 * sizeof(tucMap))
+		hex2bin(tucMap, tcMap, sizeof(tucMap));
+
+	bitOn(tucMap + 1, isoPinDat);
+	bitOn(tucMap + 1, isoSecCtl);
+	bitOn(tucMap + 1, iso045);
+	MAPGETBYTE(traAdviceBuild, ucAdv, lblKO);
+	if (ucAdv == 1) {
+		bitOff(tucMap + 1, isoPinDat);
+		bitOff(tucMap + 1, isoSecCtl);
+		bitOff(tucMap + 1, isoTrk2);
+		bitOff(tucMap + 1, iso045);
+		bitOn(tucMap + 1, isoPan);
+		bitOn(tucMap + 1, isoDatExp);
+		MAPPUTBYTE(traAdviceBuild, 0, lblKO);
+	}
+
+	bufApp(req, tucMti, 2);
+	bufApp(req, tucMap + 1, lenBitmap);
+	bufApp(req, (const byte *)tcStan, lenSTAN);
+	return bufLen(req);
+
+	lblKO:
+	return -1;
+}
+
+// The host: the advice and its answer written in host.log, followed by
+// the numbers of the card fields it should not carry.
+int onlSendRaw(tBuffer *req, tBuffer *rsp) {
+	static const byte tucAck[] = { 0x02, 0x30 };
+	static const byte tucCard[] = { isoTrk2, iso045, isoPinDat, isoSecCtl };
+	const byte *pucMap = bufPtr(req) + 2;
+	char tcPath[512];
+	int bOk = 1, iStan;
+	unsigned int i;
+	FILE *hLog;
+
+	if (bufLen(req) < 2 + lenBitmap + lenSTAN)
+		return -1;
+	iStan = atoi((const char *)bufPtr(req) + 2 + lenBitmap);
+	iHostMsgs++;
+	if ((iHost == hstFlaky) && ((iHostMsgs % FAIL_EVERY) == 0))
+		bOk = 0;
+	if ((iHost == hstPoison) && (iStan == POISON))
+		bOk = 0;
+
+	snprintf(tcPath, sizeof(tcPath), "%s/host.log", pcTermDir);
+	hLog = fopen(tcPath, "a");
+	if (hLog == NULL)
+		return -1;
+	fprintf(hLog, "%02X%02X %d %s", bufPtr(req)[0], bufPtr(req)[1], iStan, bOk ? "ok" : "refused");
+	for (i = 0; i < sizeof(tucCard); i++) {
+		if (bitTest(pucMap, tucCard[i]))
+			fprintf(hLog, " %d", tucCard[i]);
+	}
+	fprintf(hLog, "\n");
+	fclose(hLog);
+	if (iStan == CUT_AT)
+		powerCut(cutSent);
+	if (!bOk)
+		return -1;
+	bufApp(rsp, tucAck, sizeof(tucAck));
+	return bufLen(rsp);
+}
+
+int onlBgTake(void) {
+	if (++iTakes == CUT_AT)
+		powerCut(cutTake);
+	return 1;
+}
+
+void onlBgGive(void) {
+}
+
+int onlBgWait(void) {
+	return 1;
+}
+
+int isApp_Already_in_Session(void) {
+	return 1;                          // The sales run in the foreground session
+}
+
+void TaskStoreForward(void) {
+}
+
+void ApplicationBuildReversalData(void) {
+}
+
+//****************************************************************************
+//      STEPS
+//****************************************************************************
+// Sales 1 to iAdvices approved, each advice queued as performOlineTransaction
+// leaves it. Queued again after a power cut: the queue keeps one per STAN.
+// 3 if the transaction is left with the bitmap of the advice.
+static int saleRun(void) {
+	char tcStan[16], tcMap[64];
+	int i;
+
+	for (i = 1; i <= iAdvices; i++) {
+		sprintf(tcStan, "%06d", i);
+		mapPutStr(traSTAN, tcStan);
+		mapPutStr(traRspCod, "00");
+		mapPutStr(traRqsProcessingCode, "000000");
+		mapPutStr(traRqsMTI, "020200");
+		mapPutStr(traRqsBitMap, "087014078020C09A00");    // Sale of MenuProcessing.c: track 2
+		num2dec(isoMnuItm, mnuSale, 0);
+		AdviseTransactionManager();
+		mapGet(traRqsBitMap, tcMap, sizeof(tcMap));
+		if (strcmp(tcMap, "087014078020C09A00") != 0)
+			return 3;
+	}
+	return 0;
+}
+
+// Background runs of the sender until the queue is empty: 0, or 1 if not.
+static int drainRun(void) {
+	char tcStan[lenSTAN + 1], tcReq[256];
+	int i;
+
+	for (i = 0; i < DRAIN_RUNS; i++) {
+		if (sqlite_Advice_Peek(tcStan, tcReq, sizeof(tcReq)) == 0)
+			return 0;
+		AdviseQueueDrain();
+	}
+	return 1;
+}
+
+// Queue read behind Sqlite.c after the power cuts: 0 if sound with one
+// advice per sale, 1 if damaged, 2 if advices are lost or doubled.
+static int queueRun(void) {
+	char tcPath[512], tcStan[lenSTAN + 1], tcReq[256];
+	const char *pcBase;
+	sqlite3 *hDb = NULL;
+	sqlite3_stmt *hStmt = NULL;
+	int bOk = 0, iCnt = -1, iMin = 0, iMax = 0;
+
+	sqlite_Advice_Peek(tcStan, tcReq, sizeof(tcReq));    // Database opened, its name known
+	pcBase = strrchr(DataBaseName, '/');
+	snprintf(tcPath, sizeof(tcPath), "%s/%s", pcTermDir, pcBase ? pcBase + 1 : DataBaseName);
+	if (sqlite3_open_v2(tcPath, &hDb, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK) {
+		if (sqlite3_prepare_v2(hDb, "PRAGMA integrity_check;", -1, &hStmt, NULL) == SQLITE_OK) {
+			bOk = (sqlite3_step(hStmt) == SQLITE_ROW) && (strcmp((const char *)sqlite3_column_text(hStmt, 0), "ok") == 0);
+			sqlite3_finalize(hStmt);
+		}
+		if (sqlite3_prepare_v2(hDb, "SELECT COUNT(*), MIN(CAST(STAN AS INTEGER)), MAX(CAST(STAN AS INTEGER)) FROM advice;", -1, &hStmt, NULL) == SQLITE_OK) {
+			if (sqlite3_step(hStmt) == SQLITE_ROW) {
+				iCnt = sqlite3_column_int(hStmt, 0);
+				iMin = sqlite3_column_int(hStmt, 1);
+				iMax = sqlite3_column_int(hStmt, 2);
+			}
+			sqlite3_finalize(hStmt);
+		}
+	}
+	sqlite3_close(hDb);
+	if (!bOk)
+		return 1;
+	return ((iCnt == iAdvices) && (iMin == 1) && (iMax == iAdvices)) ? 0 : 2;
+}
+
+// Queue of FULL_MAX advices, the oldest parked, then one more advice: 0 if
+// it is refused and the parked one kept, 1 if not.
+static int fullRun(void) {
+	char tcStan[lenSTAN + 1], tcReq[256];
+	int i, iPut;
+
+	for (i = 1; i <= FULL_MAX; i++) {
+		sprintf(tcStan, "%06d", i);
+		if (sqlite_Advice_Put(tcStan, "1", "0220", FULL_MAX) != 1)
+			return 1;
+	}
+	for (i = 0; i < RETRY_MAX; i++)
+		sqlite_Advice_Update("000001", 0, RETRY_MAX);
+	iPut = sqlite_Advice_Put("000004", "1", "0220", FULL_MAX);
+	if ((iPut != 0) || (sqlite_Advice_Parked() != 1))
+		return 1;
+	for (i = 2; i <= FULL_MAX; i++) {                  // The pending ones go; the parked one stays
+		if (sqlite_Advice_Peek(tcStan, tcReq, sizeof(tcReq)) != 1)
+			return 1;
+		sqlite_Advice_Update(tcStan, 1, RETRY_MAX);
+	}
+	return (sqlite_Advice_Parked() == 1) && (sqlite_Advice_Put("000004", "1", "0220", FULL_MAX) == 1) ? 0 : 1;
+}
+
+// A step in a process of its own: its exit code, -1 if killed.
+static int stepRun(int (*pfnStep)(void), int iStepCut, int iStepHost, int iKillUs) {
+	int iRet = 0;
+	pid_t hPid;
+
+	fflush(stdout);
+	hPid = fork();
+	if (hPid < 0)
+		return -1;
+	if (hPid == 0) {
+		iCut = iStepCut;
+		iHost = iStepHost;
+		exit(pfnStep());
+	}
+	if (iKillUs > 0) {
+		usleep(iKillUs);
+		kill(hPid, SIGKILL);
+	}
+	if (waitpid(hPid, &iRet, 0) != hPid)
+		return -1;
+	return WIFEXITED(iRet) ? WEXITSTATUS(iRet) : -1;
+}
+
+//****************************************************************************
+//      CHECKS
+//****************************************************************************
+static void check(int bOk, const char *pcScenario, const char *pcWhat) {
+	if (bOk)
+		return;
+	iFail++;
+	printf("FAIL %s: %s\n", pcScenario, pcWhat);
+}
+
+static void fresh(void) {
+	char tcCmd[600];
+
+	snprintf(tcCmd, sizeof(tcCmd), "rm -rf '%s'", pcTermDir);
+	system(tcCmd);
+	termInit(pcTermDir);
+}
+
+// Order of the host: advices acknowledged in STAN order, each once but for
+// iTwice at most (sent again after a power cut), each refusal followed by
+// the same advice until it is acknowledged or parked.
+static void hostOrder(const char *pcScenario, int iSkip, int iTwice) {
+	char tcPath[512], tcLine[64], tcMti[8], tcAns[16], tcField[8];
+	int iNext = 1, iLast = 0, iRefused = 0, iTwiceSeen = 0, iStan, iParked = 0;
+	int bOrder = 1, bMti = 1, bCard = 1;
+	FILE *hLog;
+
+	snprintf(tcPath, sizeof(tcPath), "%s/host.log", pcTermDir);
+	hLog = fopen(tcPath, "r");
+	check(hLog != NULL, pcScenario, "host reached");
+	if (hLog == NULL)
+		return;
+	while (fgets(tcLine, sizeof(tcLine), hLog)) {
+		if (sscanf(tcLine, "%7s %d %15s", tcMti, &iStan, tcAns) != 3)
+			continue;
+		bMti &= (strcmp(tcMti, "0220") == 0);
+		bCard &= (sscanf(tcLine, "%*s %*d %*s %7s", tcField) != 1);
+		if (iStan == iSkip)
+			iParked += (strcmp(tcAns, "refused") == 0);
+		if (iRefused && (iStan != iRefused) && (iRefused != iSkip))
+			bOrder = 0;                // An advice overtook a refused one
+		iRefused = 0;
+		if (strcmp(tcAns, "refused") == 0) {
+			iRefused = iStan;
+			continue;
+		}
+		if ((iStan == iLast) && (iTwiceSeen < iTwice)) {
+			iTwiceSeen++;
+			continue;
+		}
+		if (iNext == iSkip)
+			iNext++;
+		bOrder &= (iStan == iNext);
+		iLast = iStan;
+		iNext++;
+	}
+	fclose(hLog);
+	if (iNext == iSkip)
+		iNext++;
+	check(bMti, pcScenario, "advices sent as 0220");
+	check(bCard, pcScenario, "advices without field 35, 45, 52 or 53");
+	check(bOrder, pcScenario, "advices acknowledged in order");
+	check(iNext == iAdvices + 1, pcScenario, "every advice acknowledged");
+	check(iTwiceSeen == iTwice, pcScenario, "advice in flight at the cut sent again");
+	if (iSkip)
+		check(iParked == RETRY_MAX, pcScenario, "refused advice parked after its retries");
+	printf("%-40s %d advices acknowledged, %d sent twice, %d refusals of the parked one\n", pcScenario,
+	       iNext - 1 - (iSkip ? 1 : 0), iTwiceSeen, iParked);
+	if (iVerbose) {
+		snprintf(tcPath, sizeof(tcPath), "cat '%s/host.log'", pcTermDir);
+		system(tcPath);
+	}
+}
+
+//****************************************************************************
+//      SCENARIOS
+//****************************************************************************
+static void orderRun(void) {
+	const char *pcName = "flaky host";
+
+	fresh();
+	check(stepRun(saleRun, cutNone, hstUp, 0) == 0, pcName, "sales");
+	check(stepRun(drainRun, cutNone, hstFlaky, 0) == 0, pcName, "queue emptied");
+	hostOrder(pcName, 0, 0);
+}
+
+static void parkRun(void) {
+	const char *pcName = "advice always refused";
+
+	fresh();
+	check(stepRun(saleRun, cutNone, hstUp, 0) == 0, pcName, "sales");
+	check(stepRun(drainRun, cutNone, hstPoison, 0) == 0, pcName, "queue emptied but the parked advice");
+	hostOrder(pcName, POISON, 0);
+}
+
+static void drainCutRun(const char *pcName, int iStepCut, int iTwice) {
+	fresh();
+	check(stepRun(saleRun, cutNone, hstUp, 0) == 0, pcName, "sales");
+	check(stepRun(drainRun, iStepCut, hstUp, 0) == CUT_EXIT, pcName, "drain cut");
+	check(stepRun(drainRun, cutNone, hstUp, 0) == 0, pcName, "queue emptied at power up");
+	hostOrder(pcName, 0, iTwice);
+}
+
+static void fullQueueRun(void) {
+	const char *pcName = "queue full of parked advices";
+
+	int iRet;
+
+	fresh();
+	iRet = stepRun(fullRun, cutNone, hstUp, 0);
+	check(iRet == 0, pcName, "new advice refused, parked advice kept");
+	printf("%-40s parked advice %s\n", pcName, (iRet == 0) ? "kept" : "lost or new advice taken");
+}
+
+static void saleCutRun(void) {
+	const char *pcName = "power cuts while the advices are queued";
+	int i, iCuts = 0;
+
+	fresh();
+	srand(1);
+	for (i = 0; i < KILL_ROUNDS; i++)
+		iCuts += (stepRun(saleRun, cutNone, hstUp, 1 + rand() % KILL_US) != 0);
+	check(stepRun(saleRun, cutNone, hstUp, 0) == 0, pcName, "sales after the cuts");
+	i = stepRun(queueRun, cutNone, hstUp, 0);
+	check(i != 1, pcName, "database sound after the power cuts");
+	check(i != 2, pcName, "one advice per sale queued");
+	check(stepRun(drainRun, cutNone, hstUp, 0) == 0, pcName, "queue emptied");
+	hostOrder(pcName, 0, 0);
+	if (iVerbose)
+		printf("%d of %d enqueue runs cut\n", iCuts, KILL_ROUNDS);
+}
+
+//****************************************************************************
+//      MAIN
+//****************************************************************************
+static void usage(void) {
+	fprintf(stderr, "usage: advtest [-d dir] [-n advices] [-v]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	int iOpt;
+
+	while ((iOpt = getopt(argc, argv, "d:n:v")) != -1) {
+		switch (iOpt) {
+		case 'd': pcTermDir = optarg; break;
+		case 'n': iAdvices = atoi(optarg); break;
+		case 'v': iVerbose = 1; break;
+		default: usage();
+		}
+	}
+	if ((iAdvices <= CUT_AT) || (iAdvices < POISON) || (iAdvices > 150))
+		usage();
+
+	orderRun();
+	parkRun();
+	drainCutRun("power cut before the send", cutTake, 0);
+	drainCutRun("power cut after the send", cutSent, 1);
+	saleCutRun();
+	fullQueueRun();
+
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail ? 1 : 0;
+}
@@ -0,0 +1,385 @@
+/*
+ * revtest.c
+ *
+ *  Power cuts around the reversal queue of Src/rev.c. Each step is a
+ *  process: a transaction, or a power up of the terminal. A power cut is
+ *  the process killing itself at a given point; the next step finds the
+ *  database as the disk kept it. The host writes each message it receives
+ *  in host.log, which survives the cuts, and the checks count the 0400 and
+ *  the 0401 it holds for each transaction.
+ *
+ *  Usage: revtest [-d dir] [-v]
+ */
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sqlite3.h>
+
+#include <globals.h>
+#include "Sqlite.h"
+
+//****************************************************************************
+//      PRIVATE CONSTANTS
+//****************************************************************************
+#define CUT_EXIT        99             // Exit code of a step cut off by a power cut
+#define HELD_EXIT       3              // Exit code of a transaction held back by revQueueCheck
+#define LEFT_EXIT       1              // Exit code of a power up leaving reversals queued
+#define STEP_MAX        4
+#define STAN_A          "000101"
+#define STAN_B          "000102"
+
+enum {                                 // Power cut points
+	cutNone,
+	cutArmed,                          // After revQueuePut, before the request goes
+	cutTake,                           // Sender taking the link, the reversal not read yet
+	cutSend,                           // Reversal counted, not on the line yet
+	cutSent,                           // Reversal received by the host, 0410 not back yet
+};
+
+enum {                                 // Steps
+	stpEnd,
+	stpTxn,                            // Transaction left without answer, then reversed
+	stpAnswered,                       // Transaction answered
+	stpPowerUp,                        // revQueueRecover, then the idle run of the sender
+	stpUnreadable,                     // Reversal queue made unreadable, then revQueueCheck
+};
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	int iStep;
+	const char *pcStan;
+	int iCut;
+	int bHostDown;
+	int iExit;                         // Exit code expected
+} tStep;
+
+typedef struct {
+	const char *pcName;
+	tStep tzStep[STEP_MAX];
+	int i400A, i401A;                  // Messages the host must hold for STAN_A
+	int i400B, i401B;                  // and for STAN_B
+} tScenario;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static const tScenario tzScenario[] = {
+	{ "answered",
+	  { { stpAnswered, STAN_A, cutNone, 0, 0 }, { stpPowerUp, NULL, cutNone, 0, 0 } }, 0, 0, 0, 0 },
+	{ "no answer",
+	  { { stpTxn, STAN_A, cutNone, 0, 0 }, { stpPowerUp, NULL, cutNone, 0, 0 } }, 1, 0, 0, 0 },
+	{ "power cut after revQueuePut",
+	  { { stpTxn, STAN_A, cutArmed, 0, CUT_EXIT }, { stpPowerUp, NULL, cutNone, 0, 0 } }, 1, 0, 0, 0 },
+	{ "power cut before the send",
+	  { { stpTxn, STAN_A, cutTake, 0, CUT_EXIT }, { stpPowerUp, NULL, cutNone, 0, 0 } }, 1, 0, 0, 0 },
+	{ "power cut on the send",
+	  { { stpTxn, STAN_A, cutSend, 0, CUT_EXIT }, { stpPowerUp, NULL, cutNone, 0, 0 } }, 0, 1, 0, 0 },
+	{ "power cut after the send",
+	  { { stpTxn, STAN_A, cutSent, 0, CUT_EXIT }, { stpPowerUp, NULL, cutNone, 0, 0 } }, 1, 1, 0, 0 },
+	{ "power cut at power up after the send",
+	  { { stpTxn, STAN_A, cutArmed, 0, CUT_EXIT }, { stpPowerUp, NULL, cutSent, 0, CUT_EXIT },
+	    { stpPowerUp, NULL, cutNone, 0, 0 } }, 1, 1, 0, 0 },
+	{ "pending reversal, host down",
+	  { { stpTxn, STAN_A, cutNone, 1, 0 }, { stpTxn, STAN_B, cutNone, 1, HELD_EXIT },
+	    { stpTxn, STAN_B, cutNone, 0, 0 }, { stpPowerUp, NULL, cutNone, 0, 0 } }, 0, 1, 1, 0 },
+	{ "reversal queue unreadable",
+	  { { stpTxn, STAN_A, cutNone, 1, 0 }, { stpUnreadable, STAN_B, cutNone, 0, HELD_EXIT } }, 0, 0, 0, 0 },
+};
+
+static int iCut = cutNone;             // Power cut point of the running step
+static int bHostDown = 0;
+static int iVerbose = 0;
+static int iFail = 0;
+extern char DataBaseName[100];
+
+//****************************************************************************
+//      TRANSACTION AND LINK
+//****************************************************************************
+static void powerCut(int iAt) {
+	if (iCut == iAt)
+		_exit(CUT_EXIT);
+}
+
+void ApplicationBuildReversalData(void) {
+}
+
+// Request of the data map: MTI in BCD, the bitmap, then the STAN. The
+// card is a chip card with PIN: modifyBitmap (req.c) sets the PIN block,
+// its key and the ICC data in every request, and takes them out of a
+// reversal when appAutoReversal is set.
+int reqBuild(tBuffer *req) {
+	char tcMti[16], tcStan[lenSTAN + 1], tcMnu[lenMnu + 1];
+	byte tucMti[2], tucMap[lenBitmap];
+	card ulMnu = 0;
+	byte ucAuto = 0;
+	int ret = 0;
+
+	MAPGET(traRqsMTI, tcMti, lblKO);
+	MAPGET(traSTAN, tcStan, lblKO);
+	MAPGET(traMnuItm, tcMnu, lblKO);
+	CHECK(strlen(tcMti) >= lenMti, lblKO);
+	hex2bin(tucMti, &tcMti[strlen(tcMti) - lenMti], 2);
+	dec2num(&ulMnu, tcMnu, 0);
+
+	memset(tucMap, 0, sizeof(tucMap));
+	bitOn(tucMap, isoPinDat);
+	bitOn(tucMap, isoSecCtl);
+	bitOn(tucMap, isoEmvPds);
+	if (ulMnu == mnuReversal) {
+		MAPGETBYTE(appAutoReversal, ucAuto, lblKO);
+		if (ucAuto == 1) {
+			bitOff(tucMap, isoPinDat);
+			bitOff(tucMap, isoSecCtl);
+			bitOff(tucMap, isoEmvPds);
+			MAPPUTBYTE(appAutoReversal, 0, lblKO);
+		}
+	}
+
+	bufApp(req, tucMti, 2);
+	bufApp(req, tucMap, lenBitmap);
+	bufApp(req, (const byte *)tcStan, lenSTAN);
+	return bufLen(req);
+
+	lblKO:
+	return -1;
+}
+
+// The host: the message written in host.log, answered by MTI + 10. A
+// reversal carrying a PIN block, its key or ICC data is marked with the
+// numbers of these fields.
+int onlSendRaw(tBuffer *req, tBuffer *rsp) {
+	char tcPath[512];
+	byte tucRsp[2 + lenSTAN];
+	const byte *pucReq = bufPtr(req);
+	int bRev = (pucReq[0] == 0x04);
+	FILE *hLog;
+
+	if (bRev)
+		powerCut(cutSend);
+	if (bHostDown || (bufLen(req) < 2 + lenBitmap + lenSTAN))
+		return -1;
+	snprintf(tcPath, sizeof(tcPath), "%s/host.log", pcTermDir);
+	hLog = fopen(tcPath, "a");
+	if (hLog == NULL)
+		return -1;
+	fprintf(hLog, "%02X%02X %.*s", pucReq[0], pucReq[1], lenSTAN, (const char *)pucReq + 2 + lenBitmap);
+	if (bRev && bitTest(pucReq + 2, isoPinDat))
+		fprintf(hLog, " 52");
+	if (bRev && bitTest(pucReq + 2, isoSecCtl))
+		fprintf(hLog, " 53");
+	if (bRev && bitTest(pucReq + 2, isoEmvPds))
+		fprintf(hLog, " 55");
+	fprintf(hLog, "\n");
+	fclose(hLog);
+	if (bRev)
+		powerCut(cutSent);
+
+	tucRsp[0] = pucReq[0];
+	tucRsp[1] = (pucReq[1] & 0xF0) + 0x10;
+	memcpy(&tucRsp[2], pucReq + 2 + lenBitmap, lenSTAN);
+	bufApp(rsp, tucRsp, sizeof(tucRsp));
+	return bufLen(rsp);
+}
+
+int onlBgTake(void) {
+	powerCut(cutTake);
+	return 1;
+}
+
+void onlBgGive(void) {
+}
+
+int onlBgWait(void) {
+	return 1;
+}
+
+int AdviseQueueBusy(void) {
+	return 0;
+}
+
+void TaskStoreForward(void) {
+	RevQueueDrain(0);
+}
+
+//****************************************************************************
+//      STEPS
+//****************************************************************************
+static void txnMap(const char *pcStan) {
+	mapPutStr(traSTAN, pcStan);
+	mapPutStr(traPan, "4761739001010119");
+	mapPutStr(traMnuItm, "1");
+	mapPutStr(traRqsMTI, "020200");
+	mapPutStr(traRqsBitMap, "");
+	mapPutStr(traRevVoidData, "");
+	mapPutStr(traVoid63Data, "");
+}
+
+// Reversal queue dropped behind Sqlite.c, as a damaged database.
+static void queueDrop(void) {
+	char tcPath[512];
+	const char *pcBase = strrchr(DataBaseName, '/');
+	sqlite3 *hDb = NULL;
+
+	snprintf(tcPath, sizeof(tcPath), "%s/%s", pcTermDir, pcBase ? pcBase + 1 : DataBaseName);
+	if (sqlite3_open_v2(tcPath, &hDb, SQLITE_OPEN_READWRITE, NULL) == SQLITE_OK)
+		sqlite3_exec(hDb, "DROP TABLE reversal;", NULL, NULL, NULL);
+	sqlite3_close(hDb);
+}
+
+// Foreground part of performOlineTransaction, without answer unless bAnswer.
+static int txnRun(const char *pcStan, int bAnswer) {
+	byte dReq[64], dRsp[64];
+	tBuffer bReq, bRsp;
+
+	txnMap(pcStan);
+	if (revQueueCheck() <= 0)
+		return HELD_EXIT;
+	bufInit(&bReq, dReq, sizeof(dReq));
+	bufInit(&bRsp, dRsp, sizeof(dRsp));
+	reqBuild(&bReq);
+	revQueueArm();
+	powerCut(cutArmed);
+	mapPutByte(appReversalFlag, 1);
+	if (bAnswer && (onlSendRaw(&bReq, &bRsp) > 0)) {
+		revQueueDisarm();
+		mapPutByte(appReversalFlag, 0);
+		return 0;
+	}
+	revAutoReversal();
+	return 0;
+}
+
+// A step in a process of its own: its exit code.
+static int stepRun(const tStep *pxStep) {
+	char tcStan[lenSTAN + 1], tcReq[256];
+	int iSent, iRet = 0;
+	pid_t hPid;
+
+	fflush(stdout);
+	hPid = fork();
+	if (hPid < 0)
+		return -1;
+	if (hPid == 0) {
+		iCut = pxStep->iCut;
+		bHostDown = pxStep->bHostDown;
+		revQueueRecover();
+		switch (pxStep->iStep) {
+		case stpTxn:
+			iRet = txnRun(pxStep->pcStan, 0);
+			break;
+		case stpAnswered:
+			iRet = txnRun(pxStep->pcStan, 1);
+			break;
+		case stpPowerUp:
+			RevQueueDrain(0);
+			iRet = (sqlite_Reversal_Peek(tcStan, tcReq, sizeof(tcReq), &iSent) == 0) ? 0 : LEFT_EXIT;
+			break;
+		case stpUnreadable:
+			queueDrop();
+			iRet = txnRun(pxStep->pcStan, 0);
+			break;
+		}
+		exit(iRet);
+	}
+	if (waitpid(hPid, &iRet, 0) != hPid)
+		return -1;
+	return WIFEXITED(iRet) ? WEXITSTATUS(iRet) : -1;
+}
+
+//****************************************************************************
+//      CHECKS
+//****************************************************************************
+static void check(int bOk, const char *pcScenario, const char *pcWhat) {
+	if (bOk)
+		return;
+	iFail++;
+	printf("FAIL %s: %s\n", pcScenario, pcWhat);
+}
+
+static int hostCount(const char *pcMti, const char *pcStan) {
+	char tcPath[512], tcLine[64], tcWant[64];
+	int iCnt = 0;
+	FILE *hLog;
+
+	snprintf(tcPath, sizeof(tcPath), "%s/host.log", pcTermDir);
+	snprintf(tcWant, sizeof(tcWant), "%s %s", pcMti, pcStan);
+	hLog = fopen(tcPath, "r");
+	if (hLog == NULL)
+		return 0;
+	while (fgets(tcLine, sizeof(tcLine), hLog))
+		iCnt += (strncmp(tcLine, tcWant, strlen(tcWant)) == 0);
+	fclose(hLog);
+	return iCnt;
+}
+
+// Reversals received with a PIN block, its key or ICC data.
+static int hostCardData(void) {
+	char tcPath[512], tcLine[64];
+	int iCnt = 0;
+	FILE *hLog;
+
+	snprintf(tcPath, sizeof(tcPath), "%s/host.log", pcTermDir);
+	hLog = fopen(tcPath, "r");
+	if (hLog == NULL)
+		return 0;
+	while (fgets(tcLine, sizeof(tcLine), hLog))
+		iCnt += ((strncmp(tcLine, "04", 2) == 0) && (strlen(tcLine) > 4 + 1 + lenSTAN + 1));
+	fclose(hLog);
+	return iCnt;
+}
+
+static void scenarioRun(const tScenario *pxScn) {
+	char tcCmd[600], tcWhat[128];
+	const tStep *pxStep;
+	int iExit, i;
+
+	snprintf(tcCmd, sizeof(tcCmd), "rm -rf '%s'", pcTermDir);
+	system(tcCmd);
+	termInit(pcTermDir);
+
+	for (i = 0; (i < STEP_MAX) && (pxScn->tzStep[i].iStep != stpEnd); i++) {
+		pxStep = &pxScn->tzStep[i];
+		iExit = stepRun(pxStep);
+		snprintf(tcWhat, sizeof(tcWhat), "step %d ended with %d, not %d", i + 1, iExit, pxStep->iExit);
+		check(iExit == pxStep->iExit, pxScn->pcName, tcWhat);
+	}
+
+	check(hostCount("0400", STAN_A) == pxScn->i400A, pxScn->pcName, "0400 of " STAN_A);
+	check(hostCount("0401", STAN_A) == pxScn->i401A, pxScn->pcName, "0401 of " STAN_A);
+	check(hostCount("0400", STAN_B) == pxScn->i400B, pxScn->pcName, "0400 of " STAN_B);
+	check(hostCount("0401", STAN_B) == pxScn->i401B, pxScn->pcName, "0401 of " STAN_B);
+	check(hostCardData() == 0, pxScn->pcName, "reversal with field 52, 53 or 55");
+	printf("%-40s 0400 %d  0401 %d\n", pxScn->pcName, hostCount("0400", STAN_A) + hostCount("0400", STAN_B),
+	       hostCount("0401", STAN_A) + hostCount("0401", STAN_B));
+	if (iVerbose) {
+		snprintf(tcCmd, sizeof(tcCmd), "cat '%s/host.log' 2>/dev/null", pcTermDir);
+		system(tcCmd);
+	}
+}
+
+//****************************************************************************
+//      MAIN
+//****************************************************************************
+static void usage(void) {
+	fprintf(stderr, "usage: revtest [-d dir] [-v]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	int iOpt, i;
+
+	while ((iOpt = getopt(argc, argv, "d:v")) != -1) {
+		switch (iOpt) {
+		case 'd': pcTermDir = optarg; break;
+		case 'v': iVerbose = 1; break;
+		default: usage();
+		}
+	}
+
+	for (i = 0; i < (int)(sizeof(tzScenario) / sizeof(tzScenario[0])); i++)
+		scenarioRun(&tzScenario[i]);
+
+	printf("%s\n", iFail ? "FAILED" : "OK");
+	return iFail ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+/*
+ * Sqlite_Def.h (host shim)
+ *
+ *  SQLite of the host. The database of the terminal (/TDISK/TSLDb...) is
+ *  opened in the directory given to termInit.
+ */
+#ifndef __STOREFWD_SQLITE_DEF_H__
+#define __STOREFWD_SQLITE_DEF_H__
+
+#include <sqlite3.h>
+
+int termOpen(const char *pcFile, sqlite3 **phDb);
+#define sqlite3_open termOpen
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * globals.h (host shim)
+ *
+ *  Just enough of the terminal environment to compile Src/rev.c,
+ *  Src/AdviseMgr.c and Src/Sqlite.c on Linux against the SQLite of the host. The flash disk is
+ *  a directory, the data map a table of byte strings and the OSL mutex a
+ *  pthread mutex; all given by termenv.c. The link and the host are
+ *  simulated by each test.
+ */
+#ifndef __STOREFWD_GLOBALS_H__
+#define __STOREFWD_GLOBALS_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef unsigned char byte;
+typedef unsigned short word;
+typedef unsigned int card;
+
+#include "iso8583.h"
+
+#define CHECK(CND,LBL) {if(!(CND)){goto LBL;}}
+
+#define _ING_APPLI_TELIUM_TETRA_PACKAGE_VERSION "030900"
+
+enum { lenMti = 4, lenAutCod = 6, lenRrn = 12, lenSTAN = 6, lenBatNum = 7, lenAID = 64, lenPan = 19,
+       lenPrcCod = 3, lenBitmap = 8, lenRspCod = 3, lenMnu = 4 };
+
+enum {                                     // Menu items used by Sqlite.c, rev.c and AdviseMgr.c
+	mnuSale = 1, mnuBalanceEnquiry, mnuVoid, mnuReversal, mnuCompletion, mnuOffline
+};
+
+enum {                                     // Keys used by Sqlite.c, rev.c and AdviseMgr.c
+	traMnuItmContext, traInvNum, traPan, traRqsProcessingCode, traAmt,
+	traDatTim, traSTAN, traExpDat, traPosEntMod, traCrdSeq, traConCode,
+	traTrk2, traRrn, traAutCod, traRspCod, traCashbackAmt, traEMVDATA,
+	traBillerPaymentDetails, traField063, appBatchNumber, traMnuItm,
+	traRqsMTI, appNII, appTID, appMID, emvTrnCurCod, traDrCr, traNetTiming,
+	traRqsBitMap, traRevVoidData, traVoid63Data, appReversalFlag, appAutoReversal,
+	traAdviceBuild,
+	keyEnd
+};
+
+extern char isoField055[512 + 1];
+extern char isoMnuItm[lenMnu + 1];         // Menu item of the transaction
+
+// Data map
+int mapGet(word key, void *ptr, word len);
+int mapPutStr(word key, const char *str);
+int mapPutByte(word key, byte val);
+#define mapGetByte(KEY,DST) mapGet(KEY,&DST,sizeof(byte))
+#define MAPGET(KEY,BUF,LBL) { ret= mapGet(KEY,BUF,sizeof(BUF)); CHECK(ret>=0,LBL);}
+#define MAPGETBYTE(KEY,VAR,LBL) { ret= mapGetByte(KEY,VAR); CHECK(ret>=0,LBL);}
+#define MAPPUTSTR(KEY,VAR,LBL) { ret= mapPutStr(KEY,VAR); CHECK(ret>=0,LBL);}
+#define MAPPUTBYTE(KEY,VAR,LBL) { ret= mapPutByte(KEY,VAR); CHECK(ret>=0,LBL);}
+word ApplicationCurrencyFillAuto(char *Currency);
+
+// Buffers and conversions
+typedef struct {
+	byte *ptr;
+	word dim;
+	word pos;
+} tBuffer;
+
+void bufInit(tBuffer *buf, byte *ptr, word dim);
+void bufReset(tBuffer *buf);
+const byte *bufPtr(const tBuffer *buf);
+word bufLen(const tBuffer *buf);
+int bufApp(tBuffer *buf, const byte *dat, int len);
+int hex2bin(byte *bin, const char *hex, int len);
+int bin2hex(char *hex, const byte *bin, int len);
+byte num2dec(char *dec, card num, byte len);
+byte dec2num(card *num, const char *dec, byte len);
+void bitOn(byte *buf, byte idx);
+void bitOff(byte *buf, byte idx);
+byte bitTest(const byte *buf, byte idx);
+
+#define Telium_Sprintf sprintf
+word Telium_CurrentTask(void);
+#define Telium_Fprintf fprintf
+#define Telium_Stdprt() stderr
+int Telium_Ttestall(int iEvents, int iTmo);
+
+// Display
+typedef void *T_GL_HGRAPHIC_LIB;
+enum { GL_ICON_INFORMATION, GL_ICON_WARNING, GL_ICON_ERROR, GL_ICON_QUESTION };
+enum { GL_BUTTON_NONE, GL_BUTTON_VALID, GL_BUTTON_VALID_CANCEL };
+enum { GL_KEY_VALID = 1 };
+int GL_Dialog_Message(T_GL_HGRAPHIC_LIB hGoal, const char *pcTitle, const char *pcText, int iIcon, int iButton, int iTmo);
+
+// Flash file system
+typedef struct {
+	char Label[32];
+	unsigned int Mode;
+	unsigned int AccessMode;
+	unsigned int NbFichierMax;
+	unsigned int IdentZone;
+} S_FS_PARAM_CREATE;
+typedef FILE S_FS_FILE;
+enum { FS_OK = 0, FS_ERROR = -1, FS_WRITEONCE = 0, FS_WRTMOD = 0, FS_WO_ZONE_DATA = 0 };
+int FS_mount(const char *pcVol, unsigned int *puiMode);
+int FS_dskcreate(S_FS_PARAM_CREATE *pxCfg, unsigned long *pulSize);
+int FS_unmount(const char *pcVol);
+int FS_dskkill(const char *pcVol);
+int FS_unlink(const char *pcFile);
+long FS_dskfree(const char *pcVol);
+S_FS_FILE *FS_open(const char *pcFile, const char *pcMode);
+long FS_length(S_FS_FILE *hFile);
+int FS_read(void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile);
+int FS_write(const void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile);
+int FS_close(S_FS_FILE *hFile);
+#define umalloc malloc
+#define ufree free
+
+// OS layer mutex
+typedef void *T_OSL_HMUTEX;
+enum { OSL_SUCCESS = 0, OSL_SECURITY_LOCAL = 0, OSL_TIMEOUT_INFINITE = -1 };
+T_OSL_HMUTEX OSL_Mutex_Create(int iName, int iSecurity);
+int OSL_Mutex_Lock(T_OSL_HMUTEX hMutex, int iTmo);
+int OSL_Mutex_Unlock(T_OSL_HMUTEX hMutex);
+
+// Transaction and link, given by each test
+void ApplicationBuildReversalData(void);
+int reqBuild(tBuffer *req);
+int onlSendRaw(tBuffer *req, tBuffer *rsp);
+int onlBgTake(void);
+void onlBgGive(void);
+int onlBgWait(void);
+int AdviseQueueBusy(void);
+int isApp_Already_in_Session(void);
+void TaskStoreForward(void);
+
+// Src/rev.c
+int revQueueArm(void);
+void revQueueDisarm(void);
+void revQueueRecover(void);
+int revQueueCheck(void);
+void revAutoReversal(void);
+int RevQueueDrain(byte Foreground);
+
+// Src/AdviseMgr.c
+void AdviseTransactionManager(void);
+void AdviseQueueDrain(void);
+
+// termenv.c
+extern const char *pcTermDir;              // Directory of the flash disk
+void termInit(const char *pcDir);
+
+#endif
@@ -0,0 +1,262 @@
+/*
+ * termenv.c
+ *
+ *  Terminal environment of the store and forward tests: the data map, the
+ *  buffers, the flash disk in a directory and the OSL mutex, as Src/Sqlite.c,
+ *  Src/rev.c and Src/AdviseMgr.c find them on the terminal. A process of a
+ *  test is a power cycle of the terminal: the database is what the disk
+ *  keeps of it.
+ */
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include <globals.h>
+#include "Sqlite_Def.h"
+
+//****************************************************************************
+//      PRIVATE TYPES
+//****************************************************************************
+typedef struct {
+	word usLen;
+	byte tucDat[1024];
+} tMapEnt;
+
+//****************************************************************************
+//      PRIVATE DATA
+//****************************************************************************
+static tMapEnt tzMap[keyEnd];          // Data map of the transaction
+static int iTaskNext = 0;              // Task numbers given by Telium_CurrentTask
+static __thread int iTask = 0;
+
+const char *pcTermDir = "sfdb";
+T_GL_HGRAPHIC_LIB hGoal = NULL;
+char isoField055[512 + 1];
+char isoMnuItm[lenMnu + 1];
+
+//****************************************************************************
+//      DATA MAP
+//****************************************************************************
+int mapGet(word key, void *ptr, word len) {
+	word n;
+
+	if (key >= keyEnd)
+		return -1;
+	n = (tzMap[key].usLen < len) ? tzMap[key].usLen : len;
+	memcpy(ptr, tzMap[key].tucDat, n);
+	if (n < len)
+		((byte *)ptr)[n] = 0;
+	return n;
+}
+
+int mapPutStr(word key, const char *str) {
+	size_t n;
+
+	if (key >= keyEnd)
+		return -1;
+	n = strlen(str);
+	if (n > sizeof(tzMap[key].tucDat) - 1)
+		n = sizeof(tzMap[key].tucDat) - 1;
+	memcpy(tzMap[key].tucDat, str, n);
+	tzMap[key].tucDat[n] = 0;
+	tzMap[key].usLen = (word)n;
+	return (int)n;
+}
+
+int mapPutByte(word key, byte val) {
+	if (key >= keyEnd)
+		return -1;
+	tzMap[key].tucDat[0] = val;
+	tzMap[key].usLen = 1;
+	return 1;
+}
+
+word ApplicationCurrencyFillAuto(char *Currency) {
+	(void)Currency;
+	return 0;
+}
+
+//****************************************************************************
+//      BUFFERS
+//****************************************************************************
+void bufInit(tBuffer *buf, byte *ptr, word dim) {
+	buf->ptr = ptr;
+	buf->dim = dim;
+	buf->pos = 0;
+}
+
+void bufReset(tBuffer *buf) {
+	memset(buf->ptr, 0, buf->dim);
+	buf->pos = 0;
+}
+
+const byte *bufPtr(const tBuffer *buf) { return buf->ptr; }
+word bufLen(const tBuffer *buf) { return buf->pos; }
+
+int bufApp(tBuffer *buf, const byte *dat, int len) {
+	if (buf->pos + len > buf->dim)
+		return -1;
+	memcpy(buf->ptr + buf->pos, dat, len);
+	buf->pos += len;
+	return buf->pos;
+}
+
+int hex2bin(byte *bin, const char *hex, int len) {
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (!isxdigit((unsigned char)hex[2 * i]) || !isxdigit((unsigned char)hex[2 * i + 1]))
+			return 0;
+		sscanf(&hex[2 * i], "%2hhx", &bin[i]);
+	}
+	return len;
+}
+
+int bin2hex(char *hex, const byte *bin, int len) {
+	int i;
+
+	for (i = 0; i < len; i++)
+		sprintf(&hex[2 * i], "%02X", bin[i]);
+	return 2 * len;
+}
+
+byte num2dec(char *dec, card num, byte len) {
+	if (len)
+		return (byte)sprintf(dec, "%0*u", len, num);
+	return (byte)sprintf(dec, "%u", num);
+}
+
+byte dec2num(card *num, const char *dec, byte len) {
+	byte i;
+
+	*num = 0;
+	for (i = 0; (len == 0 || i < len) && isdigit((unsigned char)dec[i]); i++)
+		*num = *num * 10 + (dec[i] - '0');
+	return i;
+}
+
+// Bits numbered from 1, left to right, as in globals.c.
+void bitOn(byte *buf, byte idx) {
+	buf[(idx - 1) / 8] |= (byte)(0x80 >> ((idx - 1) % 8));
+}
+
+void bitOff(byte *buf, byte idx) {
+	buf[(idx - 1) / 8] &= (byte)~(0x80 >> ((idx - 1) % 8));
+}
+
+byte bitTest(const byte *buf, byte idx) {
+	return (byte)((buf[(idx - 1) / 8] >> (7 - (idx - 1) % 8)) & 1);
+}
+
+//****************************************************************************
+//      SYSTEM
+//****************************************************************************
+word Telium_CurrentTask(void) {
+	if (iTask == 0)
+		iTask = __sync_add_and_fetch(&iTaskNext, 1);
+	return (word)iTask;
+}
+
+int Telium_Ttestall(int iEvents, int iTmo) {
+	(void)iEvents;
+	usleep(iTmo * 10000);
+	return 0;
+}
+
+int GL_Dialog_Message(T_GL_HGRAPHIC_LIB hGoal, const char *pcTitle, const char *pcText, int iIcon, int iButton, int iTmo) {
+	(void)hGoal; (void)pcTitle; (void)pcText; (void)iIcon; (void)iTmo;
+	return (iButton == GL_BUTTON_VALID_CANCEL) ? GL_KEY_VALID : 0;
+}
+
+void perflog(const char *pcMsg) {
+	(void)pcMsg;
+}
+
+void Generate_Menu_Content(void) {
+}
+
+//****************************************************************************
+//      FLASH DISK
+//****************************************************************************
+static void termPath(char *pcPath, size_t len, const char *pcFile) {
+	const char *pcBase = strrchr(pcFile, '/');
+
+	snprintf(pcPath, len, "%s/%s", pcTermDir, pcBase ? pcBase + 1 : pcFile);
+}
+
+void termInit(const char *pcDir) {
+	pcTermDir = pcDir;
+	mkdir(pcTermDir, 0755);
+	memset(tzMap, 0, sizeof(tzMap));
+}
+
+int termOpen(const char *pcFile, sqlite3 **phDb) {
+	char tcPath[512];
+
+	termPath(tcPath, sizeof(tcPath), pcFile);
+	return sqlite3_open_v2(tcPath, phDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_FULLMUTEX, NULL);
+}
+
+int FS_mount(const char *pcVol, unsigned int *puiMode) {
+	(void)pcVol;
+	(void)puiMode;
+	mkdir(pcTermDir, 0755);
+	return FS_OK;
+}
+
+int FS_dskcreate(S_FS_PARAM_CREATE *pxCfg, unsigned long *pulSize) {
+	(void)pxCfg;
+	(void)pulSize;
+	return FS_OK;
+}
+
+long FS_dskfree(const char *pcVol) { (void)pcVol; return 1L << 30; }
+int FS_unmount(const char *pcVol) { (void)pcVol; return FS_OK; }
+int FS_dskkill(const char *pcVol) { (void)pcVol; return FS_OK; }
+
+int FS_unlink(const char *pcFile) {
+	char tcPath[512];
+
+	termPath(tcPath, sizeof(tcPath), pcFile);
+	unlink(tcPath);
+	return FS_OK;
+}
+
+S_FS_FILE *FS_open(const char *pcFile, const char *pcMode) {
+	char tcPath[512];
+
+	termPath(tcPath, sizeof(tcPath), pcFile);
+	return fopen(tcPath, (*pcMode == 'r') ? "rb" : "ab");
+}
+
+long FS_length(S_FS_FILE *hFile) {
+	struct stat xSt;
+
+	return (fstat(fileno(hFile), &xSt) == 0) ? (long)xSt.st_size : FS_ERROR;
+}
+
+int FS_read(void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile) { return (int)fread(pvBuf, iSize, iNbr, hFile); }
+int FS_write(const void *pvBuf, int iSize, int iNbr, S_FS_FILE *hFile) { return (int)fwrite(pvBuf, iSize, iNbr, hFile); }
+int FS_close(S_FS_FILE *hFile) { return (fclose(hFile) == 0) ? FS_OK : FS_ERROR; }
+
+//****************************************************************************
+//      OS LAYER MUTEX
+//****************************************************************************
+T_OSL_HMUTEX OSL_Mutex_Create(int iName, int iSecurity) {
+	pthread_mutex_t *pxMtx = malloc(sizeof(*pxMtx));
+
+	(void)iName;
+	(void)iSecurity;
+	if (pxMtx)
+		pthread_mutex_init(pxMtx, NULL);
+	return pxMtx;
+}
+
+int OSL_Mutex_Lock(T_OSL_HMUTEX hMutex, int iTmo) {
+	(void)iTmo;
+	return pthread_mutex_lock((pthread_mutex_t *)hMutex) == 0 ? OSL_SUCCESS : -1;
+}
+
+int OSL_Mutex_Unlock(T_OSL_HMUTEX hMutex) {
+	return pthread_mutex_unlock((pthread_mutex_t *)hMutex) == 0 ? OSL_SUCCESS : -1;
+}